@@ -49,7 +49,7 @@ namespace {
 			AU.addRequired<AliasAnalysis>(); // transitive(?)
 			AU.setPreservesAll();
 		}
-		std::set< std::set<Value*> > getAliasSets() {
+		const std::set< std::set<Value*> >& getAliasSets() const {
 			return finalSets;
 		}
 	};
@@ -1,112 +1,150 @@
 #define DEBUG_TYPE "AliasSets"
-#include<AliasSets.h>
+
+#include "AliasSets.h"
+#include <algorithm>
+#include <vector>
 
 using namespace llvm;
 
+namespace {
+
+/*
+ * Union-find over the dense IDs of PADriver, with union by rank and path
+ * compression: building the partition is almost linear in the size of the
+ * points-to sets.
+ */
+class IdPartition {
+	std::vector<int> parent;
+	std::vector<unsigned char> rank;
+
+public:
+	void add(int x) {
+		if (x >= (int) parent.size()) {
+			parent.resize(x + 1, -1);
+			rank.resize(x + 1, 0);
+		}
+		if (parent[x] < 0)
+			parent[x] = x;
+	}
+
+	bool contains(int x) const {
+		return x >= 0 && x < (int) parent.size() && parent[x] >= 0;
+	}
+
+	int find(int x) {
+		int root = x;
+		while (parent[root] != root)
+			root = parent[root];
+		while (parent[x] != root) {
+			int next = parent[x];
+			parent[x] = root;
+			x = next;
+		}
+		return root;
+	}
+
+	void unite(int a, int b) {
+		a = find(a);
+		b = find(b);
+		if (a == b)
+			return;
+		if (rank[a] < rank[b])
+			std::swap(a, b);
+		parent[b] = a;
+		if (rank[a] == rank[b])
+			rank[a]++;
+	}
+
+	int size() const {
+		return parent.size();
+	}
+};
+
+}
+
 bool AliasSets::runOnModule(Module &M) {
 	PADriver &PD = getAnalysis<PADriver> ();
 	PointerAnalysis* PA = PD.pointerAnalysis;
+	unified = PD.isUnified();
 
 
-
-	std::map<int, std::set<int> > allPointsTo = PA->allPointsTo(); // sets of alias represented as ints
+	const SharedPtsMap& allPointsTo = PA->allPointsTo(); // sets of alias represented as ints
 	/*
 	 *   The sets represented by allPointsTo are not disjoint.
-	 * 		Thus, we will process them and create disjoint sets that are useful for many other analyses.
+	 * 		Thus, we will process them and create disjoint sets that are useful for many other analyses:
+	 * 		a pointer and everything it may point to end up in the same set.
 	 */
 
-	int count = 0;
+	IdPartition partition;
 
-	for (std::map<int, std::set<int> >::iterator i = allPointsTo.begin(), e =
+	for (SharedPtsMap::const_iterator i = allPointsTo.begin(), e =
 			allPointsTo.end(); i != e; ++i) {
 
-		bool found = false;
-		int disjointSetIndex;
-
-		//First, we discover the disjoint set that contains at least one of those values.
-		//if none of the values are contained in any existing set, we create a new one
-
-		if (!i->second.count(i->first)) {
-
-			if (disjointSet.count(i->first)) {
-				disjointSetIndex = disjointSet[i->first];
-				found = true;
-			}
-
-		}
-
-		if (!found){
-
-			for (std::set<int>::iterator ii = i->second.begin(), ee = i->second.end(); ii != ee; ++ii) {
-				if (disjointSet.count(*ii)) {
-					disjointSetIndex = disjointSet[*ii];
-					found = true;
-					break;
-				}
-			}
-
-			//Here we assign a new disjoint set index
-			if (!found) disjointSetIndex = ++count;
+		partition.add(i->first);
+		for (SharedPts::iterator ii = i->second.begin(), ee = i->second.end(); ii != ee; ++ii) {
+			partition.add(*ii);
+			partition.unite(i->first, *ii);
 		}
 
-		//Here we create a new disjoint set
-		if (!disjointSets.count(disjointSetIndex))  disjointSets[disjointSetIndex];
-
-
-		std::set<int> &selectedDisjointSet = disjointSets[disjointSetIndex];
-
-
-		//Finally, we insert the values in the selected disjoint set
-		if (!i->second.count(i->first)) {
+	}
 
-			if (!selectedDisjointSet.count(i->first)) {
-				selectedDisjointSet.insert(i->first);
-				disjointSet[i->first] = disjointSetIndex;
-			}
+	//The sets are numbered from 1 in the order of their smallest member;
+	//0 stands for no set
+	int count = 0;
+	std::vector<int> rootKeys(partition.size(), 0);
 
-		}
+	for (int id = 0; id < partition.size(); ++id) {
 
-		for (std::set<int>::iterator ii = i->second.begin(), ee = i->second.end(); ii != ee; ++ii) {
+		if (!partition.contains(id))
+			continue;
 
-			if (!selectedDisjointSet.count(*ii)) {
-				selectedDisjointSet.insert(*ii);
-				disjointSet[*ii] = disjointSetIndex;
-			}
+		int &key = rootKeys[partition.find(id)];
+		if (!key)
+			key = ++count;
+		disjointSet[id] = key;
 
+		//We translate the keys to Values as we go
+		if (Value* v = PD.getValue(id)) {
+			valueDisjointSet[v] = key;
 		}
 
 	}
+	numSets = count;
 
+	//printSets();
 
-	//Now, we translate the disjoint sets to Value* disjoint sets
+	return false;
+}
 
-	//First we translate the keys
-	for (llvm::DenseMap<int, int >::iterator i = disjointSet.begin(), e = disjointSet.end(); i != e; ++i) {
+//The tables of disjoint sets, built once from the keys of their members
+void AliasSets::buildSets() {
 
-		if (PD.int2value.count(i->first)) {
-			valueDisjointSet[PD.int2value[i->first]] = i->second;
-		}
+	if (setsBuilt)
+		return;
+	setsBuilt = true;
 
+	for (llvm::DenseMap<int, int>::iterator i = disjointSet.begin(), e = disjointSet.end(); i != e; ++i) {
+		disjointSets[i->second].insert(i->first);
+		valueDisjointSets[i->second];
 	}
 
-	//Finally we translate the disjoint sets
-	for (llvm::DenseMap<int, std::set<int> >::iterator i = disjointSets.begin(), e = disjointSets.end(); i != e; ++i) {
-
-		std::set<Value*> translatedValues;
-
-		for (std::set<int>::iterator ii = i->second.begin(), ee = i->second.end(); ii != ee; ++ii) {
-
-			if (PD.int2value.count(*ii)) {
-				translatedValues.insert(PD.int2value[*ii]);
-			}
-		}
-
-		valueDisjointSets[i->first] = translatedValues;
+	for (llvm::DenseMap<Value*, int>::iterator i = valueDisjointSet.begin(), e = valueDisjointSet.end(); i != e; ++i) {
+		valueDisjointSets[i->second].insert(i->first);
 	}
 
-	//printSets();
+}
 
-	return false;
+void AliasSets::releaseMemory() {
+	disjointSet.clear();
+	disjointSets.clear();
+	valueDisjointSet.clear();
+	valueDisjointSets.clear();
+	setsBuilt = false;
+	localSets.clear();
+	localSetsBuilt = false;
+	numSets = 0;
+	rangedSetKey.clear();
+	rangedSets.clear();
 }
 
 
@@ -116,6 +154,8 @@ void AliasSets::printSets() {
 		   << "							Alias sets:   				       \n"
 		   << "------------------------------------------------------------\n\n";
 
+	buildSets();
+
 	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = valueDisjointSets.begin(), e = valueDisjointSets.end(); i != e; ++i) {
 
 		errs() << "Set " << i->first << " :\n";
@@ -138,14 +178,27 @@ void AliasSets::getAnalysisUsage(AnalysisUsage &AU) const {
 	AU.setPreservesAll();
 }
 
-llvm::DenseMap<int, std::set<llvm::Value*> > AliasSets::getValueSets() {
+const llvm::DenseMap<int, std::set<llvm::Value*> >& AliasSets::getValueSets() {
+	buildSets();
 	return valueDisjointSets;
 }
 
-llvm::DenseMap<int, std::set<int> > AliasSets::getMemSets() {
+const llvm::DenseMap<int, std::set<int> >& AliasSets::getMemSets() {
+	buildSets();
 	return disjointSets;
 }
 
+const std::set<llvm::Value*>& AliasSets::getValueSet(int key) {
+	static const std::set<llvm::Value*> empty;
+	if (key > numSets) {
+		llvm::DenseMap<int, std::set<llvm::Value*> >::const_iterator i = rangedSets.find(key);
+		return i == rangedSets.end() ? empty : i->second;
+	}
+	buildSets();
+	llvm::DenseMap<int, std::set<llvm::Value*> >::const_iterator i = valueDisjointSets.find(key);
+	return i == valueDisjointSets.end() ? empty : i->second;
+}
+
 int AliasSets::getValueSetKey(Value* v) {
 
 	if (valueDisjointSet.count(v)) return valueDisjointSet[v];
@@ -163,6 +216,83 @@ int AliasSets::getMapSetKey(int m) {
 
 }
 
+void AliasSets::setRangedSets(const llvm::DenseMap<int, std::set<Value*> >& sets) {
+
+	rangedSetKey.clear();
+	rangedSets.clear();
+
+	//In key order, so the numbering doesn't depend on the hashing
+	std::vector<int> keys;
+	for (llvm::DenseMap<int, std::set<Value*> >::const_iterator i = sets.begin(), e = sets.end(); i != e; ++i) {
+		keys.push_back(i->first);
+	}
+	std::sort(keys.begin(), keys.end());
+
+	llvm::DenseMap<Value*, bool> shared;
+	for (unsigned k = 0; k < keys.size(); ++k) {
+
+		const std::set<Value*>& set = sets.find(keys[k])->second;
+		for (std::set<Value*>::const_iterator ii = set.begin(), ee = set.end(); ii != ee; ++ii) {
+
+			std::pair<llvm::DenseMap<Value*, int>::iterator, bool> entry =
+					rangedSetKey.insert(std::make_pair(*ii, numSets + 1 + (int) k));
+			if (!entry.second && entry.first->second != numSets + 1 + (int) k)
+				shared[*ii] = true;
+		}
+
+	}
+
+	for (llvm::DenseMap<Value*, bool>::iterator i = shared.begin(), e = shared.end(); i != e; ++i) {
+		rangedSetKey.erase(i->first);
+	}
+
+	for (llvm::DenseMap<Value*, int>::iterator i = rangedSetKey.begin(), e = rangedSetKey.end(); i != e; ++i) {
+		rangedSets[i->second].insert(i->first);
+	}
+
+}
+
+int AliasSets::getRangedSetKey(Value* v) const {
+
+	llvm::DenseMap<Value*, int>::const_iterator i = rangedSetKey.find(v);
+	return i == rangedSetKey.end() ? 0 : i->second;
+
+}
+
+const std::vector<int>& AliasSets::getLocalSets(const Function* F) {
+
+	if (!localSetsBuilt) {
+		localSetsBuilt = true;
+		buildSets();
+
+		for (llvm::DenseMap<int, std::set<Value*> >::iterator i = valueDisjointSets.begin(), e = valueDisjointSets.end(); i != e; ++i) {
+
+			if (i->second.size() <= 1) continue;
+
+			const Function* owner = NULL;
+			for (std::set<Value*>::iterator ii = i->second.begin(), ee = i->second.end(); ii != ee; ++ii) {
+				const Instruction* I = dyn_cast<Instruction>(*ii);
+				if (!I || (owner && I->getParent()->getParent() != owner)) {
+					owner = NULL;
+					break;
+				}
+				owner = I->getParent()->getParent();
+			}
+
+			if (owner) localSets[owner].push_back(i->first);
+		}
+
+		//Same order whatever the hashing of the table
+		for (llvm::DenseMap<const Function*, std::vector<int> >::iterator i = localSets.begin(), e = localSets.end(); i != e; ++i) {
+			std::sort(i->second.begin(), i->second.end());
+		}
+	}
+
+	static const std::vector<int> none;
+	llvm::DenseMap<const Function*, std::vector<int> >::const_iterator i = localSets.find(F);
+	return i == localSets.end() ? none : i->second;
+}
+
 char AliasSets::ID = 0;
 static RegisterPass<AliasSets> X("alias-sets",
 		"Get alias sets from pointer analysis pass", false, false);
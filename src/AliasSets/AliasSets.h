@@ -2,24 +2,25 @@
 #define __ALIAS_SETS_H__
 
 #include "llvm/Pass.h"
-#include "llvm/Function.h"
-#include "llvm/Instruction.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Analysis/AliasSetTracker.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/ADT/ilist.h"
 #include "llvm/ADT/DenseMap.h"
-#include "llvm/BasicBlock.h"
-#include "llvm/Function.h"
-#include "llvm/Module.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/InstIterator.h"
 #include "llvm/PassAnalysisSupport.h"
-#include "llvm/PADriver.h"
+#include "../PADriver/PADriver.h"
 #include "llvm/Support/Debug.h"
 
 
 #include <cassert>
 #include<set>
+#include<vector>
 #include<map>
 #include<queue>
 
@@ -36,21 +37,57 @@ private:
 		llvm::DenseMap<Value*, int> valueDisjointSet; // maps integers to the disjoint sets that contains the integer
 		llvm::DenseMap<int, std::set<Value*> > valueDisjointSets; // table of disjoint sets
 
+		// The points-to sets were unified by PADriver
+		bool unified;
+
+		// The sets are numbered from 1 to numSets
+		int numSets;
+
+		// The key of the ranged set of each value that is in exactly one,
+		// numbered after the alias sets, and the sets by key
+		llvm::DenseMap<Value*, int> rangedSetKey;
+		llvm::DenseMap<int, std::set<Value*> > rangedSets;
+
+		// The tables of disjoint sets are only built when asked for
+		bool setsBuilt;
+		void buildSets();
+
+		// The sets of more than one value that are all instructions of the
+		// same function, by function; built on the first getLocalSets
+		llvm::DenseMap<const Function*, std::vector<int> > localSets;
+		bool localSetsBuilt;
+
 		bool runOnModule(Module &M);
+		void releaseMemory();
 		void printSets();
 
 	public:
 		static char ID;
 		AliasSets() :
-				ModulePass(ID) {
+				ModulePass(ID), unified(false), numSets(0), setsBuilt(false), localSetsBuilt(false) {
 		}
 		;
 
 		void getAnalysisUsage(AnalysisUsage &AU) const;
-		llvm::DenseMap<int, std::set<Value*> > getValueSets();
-		llvm::DenseMap<int, std::set<int> > getMemSets();
+		const llvm::DenseMap<int, std::set<Value*> >& getValueSets();
+		const llvm::DenseMap<int, std::set<int> >& getMemSets();
+		// The values of one set, alias or ranged, empty for an unknown key
+		const std::set<Value*>& getValueSet(int key);
+		// The keys of the sets local to F, as defined above
+		const std::vector<int>& getLocalSets(const Function* F);
 		int getValueSetKey(Value* v);
 		int getMapSetKey(int m);
+		int getNumSets() const { return numSets; }
+		// Records the sets of RangedAliasSets, which split the alias sets
+		// by the ranges of memory their pointers access. A value gets the
+		// key of its ranged set if it is in exactly one, and 0 otherwise;
+		// the keys come after those of the alias sets.
+		void setRangedSets(const llvm::DenseMap<int, std::set<Value*> >& sets);
+		bool hasRangedSets() const { return !rangedSetKey.empty(); }
+		int getRangedSetKey(Value* v) const;
+		// Whether the sets come from the unification fallback of PADriver,
+		// and so are coarser than the inclusion-based analysis would give
+		bool isUnified() const { return unified; }
 	};
 }
 
@@ -0,0 +1,369 @@
+#include "AnalysisServer.h"
+#define DEBUG_TYPE "analysis-server"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "../PassProfile/PassProfile.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+STATISTIC(NumQueries, "The number of requests answered by the analysis server");
+STATISTIC(NumClients, "The number of clients of the analysis server");
+
+static cl::opt<std::string> SocketPath("server-socket",
+		cl::desc("Unix socket the analysis server listens on"),
+		cl::value_desc("path"), cl::init("ecosoc.sock"));
+
+static cl::opt<bool> ServeRanges("server-ranges",
+		cl::desc("Run the range analysis for the range requests of the analysis server"),
+		cl::init(true));
+
+static cl::opt<bool> ServeTaint("server-taint",
+		cl::desc("Run the tainted flow analysis for the tainted requests of the analysis server"),
+		cl::init(true));
+
+// The sources whose shortest paths the server keeps, for the clients that
+// ask for many sinks of the same source
+static const unsigned MaxCachedPaths = 64;
+
+AnalysisServer::AnalysisServer() :
+	ModulePass(ID), snapshot(NULL), depGraph(NULL), taint(NULL) {
+}
+
+void AnalysisServer::getAnalysisUsage(AnalysisUsage &AU) const {
+	AU.setPreservesAll();
+	AU.addRequired<PADriver> ();
+	AU.addRequired<moduleDepGraph> ();
+	if (ServeTaint)
+		AU.addRequired<TFA> ();
+	// Before the snapshot, so that it finds the ranges
+	if (ServeRanges)
+		AnalysisSnapshot::addRequiredRanges(AU);
+	AU.addRequired<AnalysisSnapshot> ();
+}
+
+bool AnalysisServer::runOnModule(Module &M) {
+	{
+		PassProfileScope scope("AnalysisServer::load", "server");
+		blockNames = getAnalysis<PADriver> ().getNames();
+		snapshot = &getAnalysis<AnalysisSnapshot> ().getSnapshot();
+		depGraph = &getAnalysis<moduleDepGraph> ();
+		if (ServeTaint)
+			taint = &getAnalysis<TFA> ();
+		nameValues(M);
+	}
+
+	errs() << "analysis-server: listening on " << SocketPath << "\n";
+	serve(SocketPath);
+	PassProfile::get().counter("queries", "server", NumQueries);
+	return false;
+}
+
+static std::string getValueName(Value* v) {
+	if (!v->hasName())
+		return "";
+	if (isa<GlobalValue> (v))
+		return "@" + v->getName().str();
+
+	Function* F = NULL;
+	if (Argument* A = dyn_cast<Argument> (v))
+		F = A->getParent();
+	else if (Instruction* I = dyn_cast<Instruction> (v))
+		F = I->getParent()->getParent();
+	if (!F)
+		return "";
+	return F->getName().str() + ":%" + v->getName().str();
+}
+
+void AnalysisServer::nameValues(Module &M) {
+	for (Module::global_iterator G = M.global_begin(), E = M.global_end(); G
+			!= E; ++G)
+		values["@" + G->getName().str()] = G;
+
+	for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+		values["@" + F->getName().str()] = F;
+		for (Function::arg_iterator A = F->arg_begin(), AE = F->arg_end(); A
+				!= AE; ++A)
+			if (A->hasName())
+				values[getValueName(A)] = A;
+		for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+			for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+				if (I->hasName())
+					values[getValueName(I)] = I;
+	}
+}
+
+Value* AnalysisServer::findValue(StringRef name, raw_ostream& reply) {
+	StringMap<Value*>::iterator it = values.find(name);
+	if (it == values.end()) {
+		reply << "error no value " << name;
+		return NULL;
+	}
+	return it->second;
+}
+
+std::string AnalysisServer::getNodeName(GraphNode* node) {
+	Value* v = NULL;
+	if (OpNode* op = dyn_cast<OpNode> (node))
+		v = op->getValue();
+	else if (VarNode* var = dyn_cast<VarNode> (node))
+		v = var->getValue();
+
+	std::string name = v ? getValueName(v) : "";
+	if (name.empty())
+		name = node->getLabel();
+	std::replace(name.begin(), name.end(), '\n', ' ');
+	return name;
+}
+
+bool AnalysisServer::answer(StringRef request, raw_ostream& reply) {
+	NumQueries++;
+
+	SmallVector<StringRef, 4> words;
+	SplitString(request, words);
+	if (words.empty()) {
+		reply << "error empty request";
+		return true;
+	}
+
+	StringRef command = words[0];
+	unsigned operands = command == "path" ? 2 : command == "pts" || command
+			== "range" || command == "tainted" ? 1 : 0;
+	if (words.size() != operands + 1) {
+		reply << "error usage: pts|range|tainted <value>, path <value> <value>, ping, shutdown";
+		return true;
+	}
+
+	if (command == "ping") {
+		reply << "ok";
+		return true;
+	}
+	if (command == "shutdown") {
+		reply << "ok";
+		return false;
+	}
+
+	Value* v = findValue(words[1], reply);
+	if (!v)
+		return true;
+
+	if (command == "pts") {
+		answerPointsTo(v, reply);
+	} else if (command == "range") {
+		if (!snapshot->hasRanges()) {
+			reply << "error the server runs with -server-ranges=false";
+			return true;
+		}
+		reply << "ok ";
+		snapshot->printRange(v, reply);
+	} else if (command == "tainted") {
+		if (!taint) {
+			reply << "error the server runs with -server-taint=false";
+			return true;
+		}
+		reply << (taint->isValueTainted(v) ? "ok yes" : "ok no");
+	} else {
+		Value* dst = findValue(words[2], reply);
+		if (dst)
+			answerPath(v, dst, reply);
+	}
+	return true;
+}
+
+void AnalysisServer::answerPointsTo(Value* v, raw_ostream& reply) {
+	// A value PADriver never numbered has no constraints
+	if (!snapshot->hasPointsTo(v)) {
+		reply << "error " << getValueName(v) << " is not a pointer";
+		return;
+	}
+
+	reply << "ok";
+	int id = snapshot->getID(v);
+	for (const int *i = snapshot->pointsToBegin(id), *e =
+			snapshot->pointsToEnd(id); i != e; ++i) {
+		std::map<int, std::string>::iterator name = blockNames.find(*i);
+		if (name != blockNames.end())
+			reply << " " << name->second;
+		else
+			reply << " #" << *i;
+	}
+}
+
+void AnalysisServer::answerPath(Value* src, Value* dst, raw_ostream& reply) {
+	std::map<Value*, Graph::DependencyPaths>::iterator it = paths.find(src);
+	if (it == paths.end()) {
+		if (paths.size() >= MaxCachedPaths)
+			paths.clear();
+		std::set<Value*> sources;
+		sources.insert(src);
+		it = paths.insert(std::make_pair(src,
+				depGraph->depGraph->getDependencyPaths(sources, false))).first;
+	}
+
+	std::vector<GraphNode*> path = it->second.getPath(dst);
+	if (path.empty()) {
+		reply << "ok none";
+		return;
+	}
+	reply << "ok ";
+	for (unsigned i = 0; i < path.size(); ++i)
+		reply << (i ? " -> " : "") << getNodeName(path[i]);
+}
+
+// A request line longer than this gets its client dropped; a client with
+// this much of replies it hasn't read yet isn't read from until it reads
+// them
+static const size_t MaxRequestLine = 64 * 1024;
+static const size_t MaxQueuedReplies = 1024 * 1024;
+
+namespace {
+// The partial request line of a client, and the replies it didn't read yet
+struct ServerClient {
+	std::string input;
+	std::string output;
+};
+}
+
+static bool setNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Sends as much of the queued replies as the socket takes without
+// blocking; false if the client went away
+static bool sendQueued(int fd, std::string& output) {
+	while (!output.empty()) {
+		ssize_t n = send(fd, output.data(), output.size(), MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		if (n <= 0)
+			return false;
+		output.erase(0, n);
+	}
+	return true;
+}
+
+bool AnalysisServer::serve(const std::string& path) {
+	struct sockaddr_un addr;
+	if (path.size() >= sizeof(addr.sun_path)) {
+		errs() << "analysis-server: socket path too long: " << path << "\n";
+		return false;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(path.c_str());
+	if (listener < 0 || bind(listener, (struct sockaddr*) &addr, sizeof(addr))
+			< 0 || listen(listener, 16) < 0 || !setNonBlocking(listener)) {
+		errs() << "analysis-server: can't listen on " << path << ": "
+				<< strerror(errno) << "\n";
+		if (listener >= 0)
+			close(listener);
+		return false;
+	}
+
+	// The listener first, then the clients. The sockets don't block: a
+	// client that doesn't send a whole line, or doesn't read its replies,
+	// only holds up itself.
+	std::vector<struct pollfd> fds(1);
+	fds[0].fd = listener;
+	fds[0].events = POLLIN;
+	std::map<int, ServerClient> clients;
+
+	bool running = true;
+	while (running) {
+		if (poll(&fds[0], fds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			errs() << "analysis-server: " << strerror(errno) << "\n";
+			break;
+		}
+
+		for (unsigned i = fds.size(); i-- > 1 && running;) {
+			short revents = fds[i].revents;
+			if (!revents)
+				continue;
+			int fd = fds[i].fd;
+			ServerClient& client = clients[fd];
+			bool alive = true;
+
+			if (revents & POLLIN) {
+				char buffer[4096];
+				ssize_t n = read(fd, buffer, sizeof(buffer));
+				if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN
+						&& errno != EWOULDBLOCK))
+					alive = false;
+				else if (n > 0)
+					client.input.append(buffer, n);
+
+				std::string& input = client.input;
+				size_t start = 0, end;
+				while (alive && running && (end = input.find('\n', start))
+						!= std::string::npos) {
+					raw_string_ostream reply(client.output);
+					running = answer(StringRef(input).slice(start, end).trim(), reply);
+					reply << "\n";
+					reply.flush();
+					start = end + 1;
+				}
+				input.erase(0, start);
+				if (input.size() > MaxRequestLine) {
+					errs() << "analysis-server: dropping a client whose request "
+							<< "is over " << MaxRequestLine << " bytes\n";
+					alive = false;
+				}
+			} else if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+				alive = false;
+			}
+
+			if (alive)
+				alive = sendQueued(fd, client.output);
+			if (!alive) {
+				close(fd);
+				clients.erase(fd);
+				fds.erase(fds.begin() + i);
+				continue;
+			}
+			fds[i].events = (client.output.size() < MaxQueuedReplies ? POLLIN : 0)
+					| (client.output.empty() ? 0 : POLLOUT);
+		}
+
+		if (running && fds[0].revents) {
+			int fd = accept(listener, NULL, NULL);
+			if (fd >= 0 && !setNonBlocking(fd)) {
+				close(fd);
+			} else if (fd >= 0) {
+				struct pollfd pfd;
+				pfd.fd = fd;
+				pfd.events = POLLIN;
+				fds.push_back(pfd);
+				NumClients++;
+			}
+		}
+	}
+
+	// What the sockets take of the last replies, the one to the shutdown
+	// request among them
+	for (unsigned i = 1; i < fds.size(); ++i)
+		sendQueued(fds[i].fd, clients[fds[i].fd].output);
+	for (unsigned i = 0; i < fds.size(); ++i)
+		close(fds[i].fd);
+	unlink(path.c_str());
+	return true;
+}
+
+char AnalysisServer::ID = 0;
+static RegisterPass<AnalysisServer> X("analysis-server",
+		"Answer points-to, range, taint and dependence queries over a socket");
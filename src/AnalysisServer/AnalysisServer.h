@@ -0,0 +1,90 @@
+#ifndef ANALYSISSERVER_H_
+#define ANALYSISSERVER_H_
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+#include "../DepGraph/DepGraph.h"
+#include "../AnalysisSnapshot/AnalysisSnapshot.h"
+#include "../PADriver/PADriver.h"
+#include "../TFA/TFA.h"
+#include <map>
+#include <string>
+
+namespace llvm {
+
+/*
+ * Class AnalysisServer
+ *
+ * Module pass that builds the points-to sets, the dependence graph, the
+ * tainted values and the ranges of the module once, and then answers
+ * questions about them over a Unix socket until it is told to stop, so
+ * that a client doesn't run opt again for each question.
+ *
+ *     opt -load ... -load AnalysisSnapshot.so -load AnalysisServer.so
+ *         -instnamer -analysis-server -server-socket=/tmp/prog.sock prog.bc
+ *
+ * The requests and the replies are lines. A value is @name for a global
+ * or a function, and function:%name for an argument or an instruction;
+ * -instnamer gives a name to the values that have none.
+ *
+ *     pts <value>            ok <memory block>...
+ *     range <value>          ok [l, u]
+ *     tainted <value>        ok yes | ok no
+ *     path <value> <value>   ok <node> -> ... -> <node> | ok none
+ *     ping                   ok
+ *     shutdown               ok, and the pass returns
+ *
+ * Anything else, or a value that isn't in the module, is answered with a
+ * line "error <reason>". The requests of all the clients are answered one
+ * at a time, in the order they arrive. A request line is at most 64 kB:
+ * a client that sends a longer one is dropped. A client isn't read from
+ * while 1 MB of its replies wait for it to read them. The points-to sets and the ranges
+ * come from the ModuleSnapshot of the module, so that a request is a few
+ * lookups in flat arrays; this also keeps the range analysis, whose
+ * headers clash with those of the dependence graph, out of the server.
+ */
+class AnalysisServer: public ModulePass {
+public:
+	static char ID;
+	AnalysisServer();
+	void getAnalysisUsage(AnalysisUsage &AU) const;
+	bool runOnModule(Module &M);
+
+	/*
+	 * Writes the reply to one request line, without the newline. Returns
+	 * false if the request was to shut the server down.
+	 */
+	bool answer(StringRef request, raw_ostream& reply);
+
+private:
+	// The values by the name the requests give them
+	StringMap<Value*> values;
+
+	const ModuleSnapshot* snapshot;
+	// The names of the points-to variables and memory blocks
+	std::map<int, std::string> blockNames;
+
+	moduleDepGraph* depGraph;
+	TFA* taint;
+
+	// The shortest paths from the sources of the last path requests
+	std::map<Value*, Graph::DependencyPaths> paths;
+
+	void nameValues(Module &M);
+	Value* findValue(StringRef name, raw_ostream& reply);
+	std::string getNodeName(GraphNode* node);
+
+	void answerPointsTo(Value* v, raw_ostream& reply);
+	void answerPath(Value* src, Value* dst, raw_ostream& reply);
+
+	// Accepts clients on path and answers them until a shutdown request
+	bool serve(const std::string& path);
+};
+
+}
+
+#endif /* ANALYSISSERVER_H_ */
@@ -0,0 +1,325 @@
+#define DEBUG_TYPE "analysis-snapshot"
+#include "AnalysisSnapshot.h"
+#include "../PADriver/PADriver.h"
+#include "../AliasSets/AliasSets.h"
+#include "../ArAnot/RangeAnalysis.h"
+#include "../PassProfile/PassProfile.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/DataTypes.h"
+#include "llvm/Support/InstIterator.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+STATISTIC(NumSnapshotIDs, "Number of IDs of the analysis snapshot");
+STATISTIC(NumSharedPts, "Number of points-to sets of the snapshot shared by several IDs");
+
+static cl::opt<bool> SnapshotRanges("snapshot-ranges",
+		cl::desc("Run the range analysis for the ranges of the analysis snapshot"),
+		cl::init(false));
+
+ModuleSnapshot::ModuleSnapshot() :
+	values(1, (const Value*) NULL), numPointsToIDs(0), unified(false),
+			numAliasSets(0), withRanges(false) {
+}
+
+int ModuleSnapshot::getID(const Value* v) const {
+	DenseMap<const Value*, int>::const_iterator i = ids.find(v);
+	return i == ids.end() ? 0 : i->second;
+}
+
+const Value* ModuleSnapshot::getValue(int id) const {
+	if (id <= 0 || id >= (int) values.size())
+		return NULL;
+	return values[id];
+}
+
+const int* ModuleSnapshot::pointsToBegin(int id) const {
+	if (id <= 0 || id > numPointsToIDs || ptsTargets.empty())
+		return NULL;
+	return &ptsTargets[0] + ptsBegin[id];
+}
+
+const int* ModuleSnapshot::pointsToEnd(int id) const {
+	if (id <= 0 || id > numPointsToIDs || ptsTargets.empty())
+		return NULL;
+	return &ptsTargets[0] + ptsEnd[id];
+}
+
+bool ModuleSnapshot::pointsTo(int id, int target) const {
+	return std::binary_search(pointsToBegin(id), pointsToEnd(id), target);
+}
+
+bool ModuleSnapshot::hasPointsTo(const Value* v) const {
+	int id = getID(v);
+	return id && id <= numPointsToIDs;
+}
+
+int ModuleSnapshot::getAliasSet(int id) const {
+	if (id <= 0 || id >= (int) aliasSet.size())
+		return 0;
+	return aliasSet[id];
+}
+
+const int* ModuleSnapshot::aliasSetBegin(int key) const {
+	if (key <= 0 || key > numAliasSets)
+		return NULL;
+	return &setMembers[0] + setBegin[key];
+}
+
+const int* ModuleSnapshot::aliasSetEnd(int key) const {
+	if (key <= 0 || key > numAliasSets)
+		return NULL;
+	return &setMembers[0] + setBegin[key + 1];
+}
+
+int ModuleSnapshot::getRangedSet(const Value* v) const {
+	int id = getID(v);
+	if (!id || id >= (int) rangedSet.size())
+		return 0;
+	return rangedSet[id];
+}
+
+bool ModuleSnapshot::mayAlias(const Value* a, const Value* b) const {
+	int setA = getAliasSet(a), setB = getAliasSet(b);
+	return !setA || !setB || setA == setB;
+}
+
+ModuleSnapshot::RangeKind ModuleSnapshot::getRange(const Value* v,
+		int64_t& lower, int64_t& upper) const {
+	int id = getID(v);
+	if (!id || id >= (int) rangeKind.size())
+		return UnknownRange;
+	lower = rangeLower[id];
+	upper = rangeUpper[id];
+	return (RangeKind) rangeKind[id];
+}
+
+void ModuleSnapshot::printRange(const Value* v, raw_ostream& OS) const {
+	int64_t lower = 0, upper = 0;
+	RangeKind kind = getRange(v, lower, upper);
+	if (kind == UnknownRange) {
+		OS << "Unknown";
+		return;
+	}
+	if (kind == EmptyRange) {
+		OS << "Empty";
+		return;
+	}
+
+	if (lower == INT64_MIN)
+		OS << "[-inf, ";
+	else
+		OS << "[" << lower << ", ";
+	if (upper == INT64_MAX)
+		OS << "+inf]";
+	else
+		OS << upper << "]";
+}
+
+size_t ModuleSnapshot::getMemoryUsage() const {
+	return ids.getMemorySize() + values.capacity() * sizeof(const Value*)
+			+ (ptsBegin.capacity() + ptsEnd.capacity()) * sizeof(unsigned)
+			+ ptsTargets.capacity() * sizeof(int) + aliasSet.capacity()
+			* sizeof(int) + setBegin.capacity() * sizeof(unsigned)
+			+ setMembers.capacity() * sizeof(int) + rangedSet.capacity()
+			* sizeof(int) + rangeKind.capacity() + (rangeLower.capacity()
+			+ rangeUpper.capacity()) * sizeof(int64_t);
+}
+
+int ModuleSnapshot::addValue(const Value* v) {
+	std::pair<DenseMap<const Value*, int>::iterator, bool> entry = ids.insert(
+			std::make_pair(v, (int) values.size()));
+	if (entry.second)
+		values.push_back(v);
+	return entry.first->second;
+}
+
+/*
+ * The IDs of PADriver and their points-to sets. The solution of PADriver
+ * is hash-consed, so the variables with the same set share one PtsSet; they
+ * share one slice of ptsTargets here too.
+ */
+void ModuleSnapshot::addPointsTo(PADriver& PD) {
+	PointerAnalysis* PA = PD.pointerAnalysis;
+	const SharedPtsMap& solution = PA->allPointsTo();
+	unified = PD.isUnified();
+
+	int last = std::max(PD.currInd, (int) PD.nextMemoryBlock - 1);
+	last = std::max(last, (int) PD.int2value.size() - 1);
+	if (!solution.empty())
+		last = std::max(last, solution.rbegin()->first);
+	for (SharedPtsMap::const_iterator i = solution.begin(), e = solution.end(); i
+			!= e; ++i)
+		if (!i->second.empty())
+			last = std::max(last, *std::max_element(i->second.begin(),
+					i->second.end()));
+
+	numPointsToIDs = last;
+	values.assign(last + 1, (const Value*) NULL);
+	for (int id = 1; id < (int) PD.int2value.size(); ++id)
+		if (const Value* v = PD.int2value[id]) {
+			values[id] = v;
+			ids[v] = id;
+		}
+
+	ptsBegin.assign(last + 1, 0);
+	ptsEnd.assign(last + 1, 0);
+	DenseMap<const PtsSet*, std::pair<unsigned, unsigned> > slices;
+	for (SharedPtsMap::const_iterator i = solution.begin(), e = solution.end(); i
+			!= e; ++i) {
+		if (i->first <= 0 || i->second.empty())
+			continue;
+
+		std::pair<DenseMap<const PtsSet*, std::pair<unsigned, unsigned> >::iterator,
+				bool> slice = slices.insert(std::make_pair(&i->second.get(),
+				std::make_pair(0u, 0u)));
+		if (slice.second) {
+			slice.first->second.first = ptsTargets.size();
+			ptsTargets.insert(ptsTargets.end(), i->second.begin(),
+					i->second.end());
+			slice.first->second.second = ptsTargets.size();
+		} else {
+			NumSharedPts++;
+		}
+		ptsBegin[i->first] = slice.first->second.first;
+		ptsEnd[i->first] = slice.first->second.second;
+	}
+}
+
+/*
+ * The alias set of each ID, and the members of each set, sorted by a
+ * counting sort over the IDs.
+ */
+void ModuleSnapshot::addAliasSets(PADriver& PD, AliasSets& AS) {
+	numAliasSets = AS.getNumSets();
+	aliasSet.assign(numPointsToIDs + 1, 0);
+	setBegin.assign(numAliasSets + 2, 0);
+	for (int id = 1; id <= numPointsToIDs; ++id) {
+		int key = AS.getMapSetKey(id);
+		if (key <= 0 || key > numAliasSets)
+			continue;
+		aliasSet[id] = key;
+		setBegin[key + 1]++;
+	}
+	for (int key = 1; key <= numAliasSets; ++key)
+		setBegin[key + 1] += setBegin[key];
+
+	setMembers.resize(setBegin[numAliasSets + 1]);
+	std::vector<unsigned> next(setBegin.begin(), setBegin.end() - 1);
+	for (int id = 1; id <= numPointsToIDs; ++id)
+		if (aliasSet[id])
+			setMembers[next[aliasSet[id]]++] = id;
+
+	if (!AS.hasRangedSets())
+		return;
+	rangedSet.assign(numPointsToIDs + 1, 0);
+	for (int id = 1; id <= numPointsToIDs; ++id)
+		if (Value* v = PD.getValue(id))
+			rangedSet[id] = AS.getRangedSetKey(v);
+}
+
+// A bound of the range analysis as an int64_t: the infinity, Min or Max,
+// and the bounds too wide saturate
+static int64_t toBound(const APInt& bound, const APInt& infinity) {
+	if (bound.eq(infinity) || bound.getMinSignedBits() > 64)
+		return bound.isNegative() ? INT64_MIN : INT64_MAX;
+	return bound.getSExtValue();
+}
+
+/*
+ * The ranges of the integer arguments and instructions. With -ra-demand,
+ * the range analysis finds them all at once, and getRange then only looks
+ * them up.
+ */
+void ModuleSnapshot::addRanges(Module& M, InterProceduralRACousot& RA) {
+	SmallVector<const Value*, 256> integers;
+	for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+		for (Function::arg_iterator A = F->arg_begin(), AE = F->arg_end(); A
+				!= AE; ++A)
+			if (A->getType()->isIntegerTy())
+				integers.push_back(A);
+		for (inst_iterator I = inst_begin(F), IE = inst_end(F); I != IE; ++I)
+			if (I->getType()->isIntegerTy())
+				integers.push_back(&*I);
+	}
+	RA.computeRanges(integers);
+
+	std::vector<std::pair<int, Range> > found;
+	for (unsigned i = 0; i < integers.size(); ++i) {
+		Range R = RA.getRange(integers[i]);
+		if (!R.isUnknown())
+			found.push_back(std::make_pair(addValue(integers[i]), R));
+	}
+
+	withRanges = true;
+	rangeKind.assign(values.size(), UnknownRange);
+	rangeLower.assign(values.size(), INT64_MIN);
+	rangeUpper.assign(values.size(), INT64_MAX);
+	APInt Min = RA.getMin(), Max = RA.getMax();
+	for (unsigned i = 0; i < found.size(); ++i) {
+		int id = found[i].first;
+		const Range& R = found[i].second;
+		if (R.isEmpty()) {
+			rangeKind[id] = EmptyRange;
+			continue;
+		}
+		rangeKind[id] = RegularRange;
+		rangeLower[id] = toBound(R.getLower(), Min);
+		rangeUpper[id] = toBound(R.getUpper(), Max);
+	}
+}
+
+void AnalysisSnapshot::getAnalysisUsage(AnalysisUsage &AU) const {
+	AU.setPreservesAll();
+	AU.addRequired<PADriver> ();
+	AU.addRequired<AliasSets> ();
+	if (SnapshotRanges)
+		AU.addRequired<InterProceduralRACousot> ();
+}
+
+void AnalysisSnapshot::addRequiredRanges(AnalysisUsage &AU) {
+	AU.addRequired<InterProceduralRACousot> ();
+}
+
+bool AnalysisSnapshot::runOnModule(Module &M) {
+	PassProfileScope scope("AnalysisSnapshot", "snapshot");
+	PADriver& PD = getAnalysis<PADriver> ();
+	AliasSets& AS = getAnalysis<AliasSets> ();
+
+	snapshot.reset(new ModuleSnapshot());
+	snapshot->addPointsTo(PD);
+	snapshot->addAliasSets(PD, AS);
+	if (InterProceduralRACousot* RA = getAnalysisIfAvailable<
+			InterProceduralRACousot> ())
+		snapshot->addRanges(M, *RA);
+
+	NumSnapshotIDs = snapshot->getNumIDs();
+	PassProfile& Profile = PassProfile::get();
+	Profile.counter("snapshot ids", "snapshot", snapshot->getNumIDs());
+	Profile.counter("snapshot bytes", "snapshot", snapshot->getMemoryUsage());
+	Profile.sampleRSS("snapshot");
+	return false;
+}
+
+void AnalysisSnapshot::releaseMemory() {
+	snapshot.reset();
+}
+
+void AnalysisSnapshot::print(raw_ostream& OS, const Module* M) const {
+	if (!snapshot)
+		return;
+	const ModuleSnapshot& S = *snapshot;
+	OS << "snapshot: " << S.getNumIDs() << " ids, " << S.getNumPointsToIDs()
+			<< " in the points-to graph, " << S.getNumAliasSets()
+			<< " alias sets, " << (S.hasRanges() ? "with" : "without")
+			<< " ranges, " << S.getMemoryUsage() << " bytes\n";
+}
+
+char AnalysisSnapshot::ID = 0;
+static RegisterPass<AnalysisSnapshot> X("analysis-snapshot",
+		"Read-only snapshot of the points-to sets, alias sets and ranges", false,
+		true);
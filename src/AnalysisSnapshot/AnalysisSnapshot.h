@@ -0,0 +1,154 @@
+#ifndef ANALYSISSNAPSHOT_H_
+#define ANALYSISSNAPSHOT_H_
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Value.h"
+#include "llvm/Support/raw_ostream.h"
+#include <stdint.h>
+#include <vector>
+
+class PADriver;
+class InterProceduralRACousot;
+
+namespace llvm {
+
+class AliasSets;
+
+/*
+ * Class ModuleSnapshot
+ *
+ * The points-to sets of PADriver, the alias sets of AliasSets and the
+ * ranges of the inter-procedural range analysis of a module, copied once
+ * into flat arrays indexed by dense IDs and never changed after. The
+ * queries are const, keep no cache and make no context current, unlike
+ * those of the analyses, so that one snapshot can be read by any number of
+ * clients, at the same time from several threads, for as long as the
+ * module isn't changed. Every query is an array lookup, or a binary search
+ * in a sorted array, after the lookup of the ID of a value.
+ *
+ * The IDs of the points-to graph are those of PADriver, from 1 to
+ * getNumPointsToIDs(): pointers and memory blocks. The integers with a
+ * range get the IDs after them, up to getNumIDs(). 0 is no ID.
+ */
+class ModuleSnapshot {
+public:
+	enum RangeKind { UnknownRange, RegularRange, EmptyRange };
+
+	ModuleSnapshot();
+
+	int getNumIDs() const { return values.size() - 1; }
+	int getNumPointsToIDs() const { return numPointsToIDs; }
+	int getID(const Value* v) const;
+	// NULL for a memory block
+	const Value* getValue(int id) const;
+
+	// The IDs that id may point to, in increasing order. The variables with
+	// the same points-to set share one copy of it.
+	const int* pointsToBegin(int id) const;
+	const int* pointsToEnd(int id) const;
+	bool pointsTo(int id, int target) const;
+	// Whether v is a variable of the points-to graph
+	bool hasPointsTo(const Value* v) const;
+	// Whether the points-to sets are those of the unification fallback
+	bool isUnified() const { return unified; }
+
+	// The alias set of id, from 1 to getNumAliasSets(), and 0 for none
+	int getNumAliasSets() const { return numAliasSets; }
+	int getAliasSet(int id) const;
+	int getAliasSet(const Value* v) const { return getAliasSet(getID(v)); }
+	// The IDs of alias set key, in increasing order
+	const int* aliasSetBegin(int key) const;
+	const int* aliasSetEnd(int key) const;
+	// The ranged set of v, if RangedAliasSets ran before the snapshot (see
+	// AliasSets::getRangedSetKey), and 0 otherwise
+	int getRangedSet(const Value* v) const;
+	// Whether a and b may alias: they are in the same alias set, or one of
+	// them isn't in any
+	bool mayAlias(const Value* a, const Value* b) const;
+
+	// Whether the snapshot has the ranges of the integers
+	bool hasRanges() const { return withRanges; }
+	// The range of v, UnknownRange for a value without one. The bounds
+	// INT64_MIN and INT64_MAX stand for -inf and +inf, and for the bounds
+	// that don't fit in 64 bits.
+	RangeKind getRange(const Value* v, int64_t& lower, int64_t& upper) const;
+	// Writes the range of v as Range::print does: "[l, u]", "Unknown" or
+	// "Empty"
+	void printRange(const Value* v, raw_ostream& OS) const;
+
+	// The bytes of the arrays and of the table of IDs
+	size_t getMemoryUsage() const;
+
+private:
+	friend class AnalysisSnapshot;
+
+	void addPointsTo(PADriver& PD);
+	void addAliasSets(PADriver& PD, AliasSets& AS);
+	void addRanges(Module& M, InterProceduralRACousot& RA);
+	int addValue(const Value* v);
+
+	DenseMap<const Value*, int> ids;
+	std::vector<const Value*> values;
+	int numPointsToIDs;
+	bool unified;
+
+	// The points-to set of id is ptsTargets[ptsBegin[id], ptsEnd[id])
+	std::vector<unsigned> ptsBegin, ptsEnd;
+	std::vector<int> ptsTargets;
+
+	int numAliasSets;
+	std::vector<int> aliasSet;
+	// The IDs of set key are setMembers[setBegin[key], setBegin[key + 1])
+	std::vector<unsigned> setBegin;
+	std::vector<int> setMembers;
+	std::vector<int> rangedSet;
+
+	bool withRanges;
+	std::vector<unsigned char> rangeKind;
+	std::vector<int64_t> rangeLower, rangeUpper;
+};
+
+/*
+ * Class AnalysisSnapshot
+ *
+ * Module pass that builds the ModuleSnapshot of the module, for the passes
+ * that only read the analyses: they require it instead of PADriver,
+ * AliasSets and the range analysis, and share the one snapshot by
+ * reference.
+ *
+ *     opt -load PADriver.so -load AliasSets.so -load ArAnot.so
+ *         -load AnalysisSnapshot.so -analysis-snapshot -snapshot-ranges
+ *         -analyze prog.bc
+ *
+ * The ranges are those of -ra-inter-cousot, which runs for the snapshot
+ * with -snapshot-ranges, or for a client that asks for them with
+ * addRequiredRanges; otherwise they are taken only if it ran already.
+ */
+class AnalysisSnapshot: public ModulePass {
+public:
+	static char ID;
+	AnalysisSnapshot() :
+		ModulePass(ID) {
+	}
+	void getAnalysisUsage(AnalysisUsage &AU) const;
+	bool runOnModule(Module &M);
+	void releaseMemory();
+	void print(raw_ostream& OS, const Module* M) const;
+
+	const ModuleSnapshot& getSnapshot() const { return *snapshot; }
+
+	// Makes the range analysis run before the snapshot P requires, so that
+	// the snapshot has the ranges; call it before AU.addRequired of the
+	// snapshot.
+	static void addRequiredRanges(AnalysisUsage &AU);
+
+private:
+	OwningPtr<ModuleSnapshot> snapshot;
+};
+
+}
+
+#endif /* ANALYSISSNAPSHOT_H_ */
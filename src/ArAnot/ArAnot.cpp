@@ -22,10 +22,13 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 
 #include "ArAnot.h"
+#include <algorithm>
 #include <string>
 
 using namespace llvm;
@@ -37,6 +40,22 @@ using std::ostream;
 static cl::opt<string> ClOutputFile("aranot-output",
                                          cl::Hidden, cl::desc("Output file"));
 
+static cl::opt<string> ClOutputDir("aranot-output-dir",
+                                        cl::Hidden,
+                                        cl::desc("Output directory for every annotated source file"));
+
+static cl::opt<string> ClReportFile("aranot-report",
+                                         cl::Hidden,
+                                         cl::desc("Write the comments as file:line:comment lines"));
+
+static cl::opt<bool> ClStripMetadata("aranot-strip-metadata",
+                                     cl::Hidden,
+                                     cl::desc("Remove the names of -aranot-metadata once annotated"),
+                                     cl::init(false));
+
+static const char *const NamesKind = "aranot";
+static const char *const StringTableName = "aranot.strings";
+
 void ArAnot::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<ASI>();
   AU.setPreservesAll();
@@ -52,11 +71,16 @@ int ArAnot::getLineNo(Value *V) {
 }
 
 // getFilename
-// Returns the file that the value is declared in.
+// Returns the path of the file that the value is declared in.
 string ArAnot::getFilename(Value *V) {
   if (Instruction *I = dyn_cast<Instruction>(V))
-    if (MDNode *N = I->getMetadata("dbg"))
-      return DILocation(N).getFilename();
+    if (MDNode *N = I->getMetadata("dbg")) {
+      DILocation Loc(N);
+      if (sys::path::is_absolute(Loc.getFilename()) ||
+          Loc.getDirectory().empty())
+        return Loc.getFilename();
+      return Loc.getDirectory().str() + "/" + Loc.getFilename().str();
+    }
   return string();
 }
 
@@ -97,28 +121,28 @@ string ArAnot::getSizeRepr(Value *V) {
   return string();
 }
 
+// getNameMetadata
+// Returns one of the names ArAnotMetadata attached to the instruction.
+string ArAnot::getNameMetadata(Instruction *I, unsigned Field) {
+  unsigned Names[ArAnotMetadata::NumNames];
+  if (!ArAnotMetadata::getNames(I, Names) || Names[Field] >= Strings.size())
+    return string();
+  return Strings[Names[Field]];
+}
+
 // getIndMetadata
 string ArAnot::getIndMetadata(Instruction *I) {
-  MDNode *IndexMd = I->getMetadata("ind_name");
-  if (MDString *IndexNameMd = dyn_cast<MDString>(IndexMd->getOperand(2)))
-    return IndexNameMd->getString();
-  return string();
+  return getNameMetadata(I, ArAnotMetadata::IndName);
 }
 
 // getPtrTypeMetadata
 string ArAnot::getPtrTypeMetadata(Instruction *I) {
-  MDNode *IndexMd = I->getMetadata("ptr_type");
-  if (MDString *IndexNameMd = dyn_cast<MDString>(IndexMd->getOperand(0)))
-    return IndexNameMd->getString();
-  return string();
+  return getNameMetadata(I, ArAnotMetadata::PtrType);
 }
 
 // getPtrMetadata
 string ArAnot::getPtrMetadata(Instruction *I) {
-  MDNode *PtrMd = I->getMetadata("ptr_name");
-  if (MDString *PtrNameMd = dyn_cast<MDString>(PtrMd->getOperand(2)))
-    return PtrNameMd->getString();
-  return string();
+  return getNameMetadata(I, ArAnotMetadata::PtrName);
 }
 
 // getPtrAccessRepr
@@ -144,24 +168,45 @@ string ArAnot::getPtrAccessRepr(Instruction *I) {
 }
 
 // addCommentToLine
-void ArAnot::addCommentToLine(string Comment, unsigned Line) {
-  if (!Comments.count(Line))
-    Comments[Line] = new std::vector<string>();
-  Comments[Line]->push_back(Comment);
+void ArAnot::addCommentToLine(string Comment, string File, unsigned Line) {
+  Comments[File].push_back(std::make_pair(Line, Comment));
+}
+
+static bool compareLines(const std::pair<unsigned, string> &A,
+                         const std::pair<unsigned, string> &B) {
+  return A.first < B.first;
 }
 
 // printToFile
-void ArAnot::printToFile(string Input, string Output) {
+// Copies Input to Output with FileComments above their lines. The comments
+// are sorted by line and merged with the lines as they are read, so only
+// one line of the input is held at a time.
+void ArAnot::printToFile(string Input, string Output,
+                         FileCommentsTy &FileComments) {
   ifstream Infile(Input.c_str());
+  if (!Infile) {
+    errs() << "Could not read " << Input << "\n";
+    return;
+  }
   string ErrorInfo;
   raw_fd_ostream File(Output.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << ErrorInfo << "\n";
+    return;
+  }
   errs() << "Writing output to file " << Output << "\n";
 
+  std::stable_sort(FileComments.begin(), FileComments.end(), compareLines);
+  FileCommentsTy::iterator Next = FileComments.begin();
+  FileCommentsTy::iterator Last = FileComments.end();
+
   string Line;
   unsigned LineNo = 1;
-  while (!Infile.eof()) {
-    std::getline(Infile, Line);
-    if (Comments.count(LineNo)) {
+  while (std::getline(Infile, Line)) {
+    // Skip the comments without a line.
+    while (Next != Last && Next->first < LineNo)
+      ++Next;
+    if (Next != Last && Next->first == LineNo) {
       string Start;
       // Gather all the blanks and tabs.
       for (string::iterator It = Line.begin(), E = Line.end(); It != E; ++It)
@@ -169,16 +214,16 @@ void ArAnot::printToFile(string Input, string Output) {
           Start += *It;
         else
           break;
-      std::vector<string> *Vec = Comments[LineNo];
+      FileCommentsTy::iterator End = Next;
       unsigned MaxLen = 0;
       // Get the maximum length of all the comments.
-      for (std::vector<string>::iterator It = Vec->begin(), E = Vec->end(); It != E; ++It)
-        if (MaxLen < (*It).length())
-          MaxLen = (*It).length();
+      for (; End != Last && End->first == LineNo; ++End)
+        if (MaxLen < End->second.length())
+          MaxLen = End->second.length();
       // Emit the comments.
-      for (std::vector<string>::iterator It = Vec->begin(), E = Vec->end(); It != E; ++It) {
-        File << Start << "/* " << *It << string(MaxLen - (*It).length(), ' ') << " */\n";
-      }
+      for (; Next != End; ++Next)
+        File << Start << "/* " << Next->second
+             << string(MaxLen - Next->second.length(), ' ') << " */\n";
     }
     File << Line << "\n";
     LineNo++;
@@ -186,16 +231,63 @@ void ArAnot::printToFile(string Input, string Output) {
   File.close();
 }
 
+// printReport
+// Writes one "file:line:comment" line per comment, in line order.
+void ArAnot::printReport(string Output) {
+  string ErrorInfo;
+  raw_fd_ostream File(Output.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << ErrorInfo << "\n";
+    return;
+  }
+  for (StringMap<FileCommentsTy>::iterator It = Comments.begin(),
+       E = Comments.end(); It != E; ++It) {
+    FileCommentsTy &FileComments = It->getValue();
+    std::stable_sort(FileComments.begin(), FileComments.end(), compareLines);
+    for (FileCommentsTy::iterator CI = FileComments.begin(),
+         CE = FileComments.end(); CI != CE; ++CI)
+      File << It->getKey() << ":" << CI->first << ":" << CI->second << "\n";
+  }
+  File.close();
+}
+
+// printToDir
+// Writes every annotated file under Dir, at its own path, one file at a
+// time, and drops its comments once it is written.
+void ArAnot::printToDir(string Dir) {
+  for (StringMap<FileCommentsTy>::iterator It = Comments.begin(),
+       E = Comments.end(); It != E; ++It) {
+    string Input = It->getKey();
+    string Relative = Input;
+    while (!Relative.empty() && Relative[0] == '/')
+      Relative.erase(0, 1);
+    SmallString<256> Output(Dir);
+    sys::path::append(Output, Relative);
+
+    bool Existed;
+    SmallString<256> Parent = sys::path::parent_path(Output);
+    if (!Parent.empty() && sys::fs::create_directories(Parent.str(), Existed)) {
+      errs() << "Could not create " << Parent << "\n";
+      continue;
+    }
+    printToFile(Input, Output.str(), It->getValue());
+    FileCommentsTy().swap(It->getValue());
+  }
+}
+
 // addComments
 // Add warning comments to GetElementPtrInst instructions.
 void ArAnot::addComments(GetElementPtrInst *GEP) {
+  string File = getFilename(GEP);
   unsigned Line = getLineNo(GEP);
+  if (File.empty())
+    return;
   string Comment;
   string PointerName = getPtrAccessRepr(GEP);
   raw_string_ostream Stream(Comment);
   if (PointerName.empty()) {
     Stream << "WARNING: Possibly unsafe access.";
-    addCommentToLine(Stream.str(), Line);
+    addCommentToLine(Stream.str(), File, Line);
     return;
   }
   Value *PointerByteSize = AS->getByteSize(GEP);
@@ -203,67 +295,162 @@ void ArAnot::addComments(GetElementPtrInst *GEP) {
   if (!AS->isValidSize(PointerByteSize) &&
       !AS->isValidSize(PointerIndexSize)) {
     Stream << "WARNING: Possibly unsafe memory access.";
-    addCommentToLine(Stream.str(), Line);
+    addCommentToLine(Stream.str(), File, Line);
     Comment.clear();
     Stream << "         Could not infer size for array `" << PointerName << "`.";
-    addCommentToLine(Stream.str(), Line);
+    addCommentToLine(Stream.str(), File, Line);
   } else {
     string PointerByteSizeRepr = getSizeRepr(PointerByteSize);
     string PointerIndexSizeRepr = getSizeRepr(PointerIndexSize);
     string PointerTypeRepr = getPtrTypeMetadata(GEP);
     if (!PointerIndexSizeRepr.empty() && !PointerTypeRepr.empty()) {
       Stream << "bytes(" << PointerName << ") = " << PointerIndexSizeRepr << " * sizeof(" << PointerTypeRepr << ")";
-      addCommentToLine(Stream.str(), Line);
+      addCommentToLine(Stream.str(), File, Line);
       Comment.clear();
       Stream << "index(" << PointerName << ") = " << PointerIndexSizeRepr;
-      addCommentToLine(Stream.str(), Line);
+      addCommentToLine(Stream.str(), File, Line);
       Comment.clear();
       Stream << "WARNING: Possibly unsafe access.";
-      addCommentToLine(Stream.str(), Line);
+      addCommentToLine(Stream.str(), File, Line);
       if (PointerIndexSizeRepr == "0") {
         Comment.clear();
         Stream << "         Off-by-one error.";
-        addCommentToLine(Stream.str(), Line);
+        addCommentToLine(Stream.str(), File, Line);
       }
       return;
     } else if (!PointerByteSizeRepr.empty()) {
       Stream << "bytes(" << PointerName << ") = " << PointerByteSizeRepr;
-      addCommentToLine(Stream.str(), Line);
+      addCommentToLine(Stream.str(), File, Line);
       Comment.clear();
     }
     Stream << "WARNING: Possibly unsafe access.";
-    addCommentToLine(Stream.str(), Line);
+    addCommentToLine(Stream.str(), File, Line);
   }
 }
 
 bool ArAnot::runOnModule(Module &M) {
   AS = &getAnalysis<ASI>();
+  ArAnotMetadata::getStringTable(M, Strings);
 
   for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
     if (F->isDeclaration() || F->isIntrinsic())
       continue;
+    // Ask ASI about all the GEPs of the function at once.
+    SmallVector<Value*, 32> GEPs;
     for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
       for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
         if (InputFile.empty())
           InputFile = getFilename(&(*I));
-        if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(&(*I)))
-          if (!AS->isSafe(GEP))
-            addComments(GEP);
+        if (isa<GetElementPtrInst>(&(*I)))
+          GEPs.push_back(&(*I));
       }
+    SmallVector<bool, 32> Safe;
+    AS->isSafe(GEPs, Safe);
+    for (unsigned Idx = 0; Idx < GEPs.size(); ++Idx)
+      if (!Safe[Idx])
+        addComments(cast<GetElementPtrInst>(GEPs[Idx]));
   }
 
+  if (!ClReportFile.empty())
+    printReport(ClReportFile);
   if (!InputFile.empty() && !ClOutputFile.empty())
-    printToFile(InputFile, ClOutputFile);
-  
+    printToFile(InputFile, ClOutputFile, Comments[InputFile]);
+  if (!ClOutputDir.empty())
+    printToDir(ClOutputDir);
+
+  if (ClStripMetadata)
+    return ArAnotMetadata::stripNames(M);
   return false;
 }
 
 char ArAnot::ID = 0;
 static RegisterPass<ArAnot> X("aranot", "Array annotator");
 
+// getStringId
+// Returns the id of an MDString in the string table, adding it if needed.
+unsigned ArAnotMetadata::getStringId(Value *Str) {
+  MDString *MDS = dyn_cast_or_null<MDString>(Str);
+  if (!MDS || MDS->getString().empty())
+    return 0;
+  StringMap<unsigned>::iterator It = StringIds.find(MDS->getString());
+  if (It != StringIds.end())
+    return It->getValue();
+  unsigned Id = StringTable->getNumOperands();
+  StringTable->addOperand(MDNode::get(MDS->getContext(), MDS));
+  StringIds[MDS->getString()] = Id;
+  return Id;
+}
+
+// setNames
+// Attaches the tuple of the names to the instruction.
+void ArAnotMetadata::setNames(Instruction *I, unsigned Names[NumNames]) {
+  MDNode *&Tuple = Tuples[std::make_pair(std::make_pair(Names[PtrName],
+                                                        Names[IndName]),
+                                         Names[PtrType])];
+  if (!Tuple) {
+    Type *Int32Ty = Type::getInt32Ty(I->getContext());
+    Value *Ops[NumNames];
+    for (unsigned Idx = 0; Idx < NumNames; ++Idx)
+      Ops[Idx] = ConstantInt::get(Int32Ty, Names[Idx]);
+    Tuple = MDNode::get(I->getContext(), Ops);
+  }
+  I->setMetadata(NamesKind, Tuple);
+}
+
+// getNames
+bool ArAnotMetadata::getNames(Instruction *I, unsigned Names[NumNames]) {
+  MDNode *Tuple = I->getMetadata(NamesKind);
+  if (!Tuple || Tuple->getNumOperands() != NumNames)
+    return false;
+  for (unsigned Idx = 0; Idx < NumNames; ++Idx) {
+    ConstantInt *CI = dyn_cast_or_null<ConstantInt>(Tuple->getOperand(Idx));
+    Names[Idx] = CI ? CI->getZExtValue() : 0;
+  }
+  return true;
+}
+
+// getStringTable
+void ArAnotMetadata::getStringTable(Module &M, vector<StringRef> &Strings) {
+  Strings.clear();
+  NamedMDNode *Table = M.getNamedMetadata(StringTableName);
+  if (!Table)
+    return;
+  for (unsigned Idx = 0; Idx < Table->getNumOperands(); ++Idx) {
+    MDNode *Entry = Table->getOperand(Idx);
+    MDString *Str = Entry->getNumOperands() ?
+      dyn_cast_or_null<MDString>(Entry->getOperand(0)) : NULL;
+    Strings.push_back(Str ? Str->getString() : StringRef());
+  }
+}
+
+// stripNames
+bool ArAnotMetadata::stripNames(Module &M) {
+  NamedMDNode *Table = M.getNamedMetadata(StringTableName);
+  if (!Table)
+    return false;
+  unsigned Kind = M.getContext().getMDKindID(NamesKind);
+  for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        I->setMetadata(Kind, NULL);
+  M.eraseNamedMetadata(Table);
+  return true;
+}
+
 // Propagates debug metadata throughout the CFG.
 bool ArAnotMetadata::runOnModule(Module &M) {
   Function *DbgValueFn = M.getFunction("llvm.dbg.declare");
+
+  // Reuse the table of a previous run, where id 0 is no name.
+  StringTable = M.getOrInsertNamedMetadata(StringTableName);
+  vector<StringRef> Strings;
+  getStringTable(M, Strings);
+  for (unsigned Idx = 1; Idx < Strings.size(); ++Idx)
+    StringIds[Strings[Idx]] = Idx;
+  if (Strings.empty())
+    StringTable->addOperand(MDNode::get(M.getContext(),
+                                        MDString::get(M.getContext(), "")));
+
   for (Module::iterator F = M.begin(), FE = M.end(); F != FE; ++F) {
     if (F->isDeclaration() || F->isIntrinsic())
       continue;
@@ -274,50 +461,47 @@ bool ArAnotMetadata::runOnModule(Module &M) {
             if (Called != DbgValueFn)
               continue;
             MDNode *Metadata0 = cast<MDNode>(CI->getArgOperand(1));
-            Value *TypeString = NULL;
-            MDNode *TypeStringNode = NULL;
+            unsigned Names[NumNames];
+            Names[PtrName] = Names[IndName] =
+              Metadata0->getNumOperands() > 2 ?
+              getStringId(Metadata0->getOperand(2)) : 0;
+            Names[PtrType] = 0;
             if (Metadata0->getNumOperands() > 5) {
               MDNode *Metadata1 = dyn_cast<MDNode>(Metadata0->getOperand(5));
               if (Metadata1 && Metadata1->getNumOperands() > 9) {
                 MDNode *Metadata2 = dyn_cast<MDNode>(Metadata1->getOperand(9));
-                if (Metadata2 && Metadata2->getNumOperands() > 2) {
-                  TypeString = Metadata2->getOperand(2);
-                  TypeStringNode =
-                    MDNode::get(I->getContext(), ArrayRef<Value*>(TypeString));
-                }
+                if (Metadata2 && Metadata2->getNumOperands() > 2)
+                  Names[PtrType] = getStringId(Metadata2->getOperand(2));
               }
             }
             Value *V = cast<MDNode>(CI->getArgOperand(0))->getOperand(0);
-            for (Value::use_iterator UI = V->use_begin(), UE = V->use_end(); UI != UE; ++UI) {
-              if (LoadInst *LI = dyn_cast<LoadInst>(*UI)) {
-                LI->setMetadata("ind_name", Metadata0);
-                LI->setMetadata("ptr_name", Metadata0);
-                if (TypeString)
-                  LI->setMetadata("ptr_type", TypeStringNode);
-              }
-            }
+            for (Value::use_iterator UI = V->use_begin(), UE = V->use_end(); UI != UE; ++UI)
+              if (LoadInst *LI = dyn_cast<LoadInst>(*UI))
+                setNames(LI, Names);
           }
         } else if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(&(*I))) {
           Instruction *Ptr = dyn_cast<Instruction>(GEP->getPointerOperand());
           Instruction *Index = dyn_cast<Instruction>(GEP->getOperand(GEP->getNumOperands() - 1));
-          if (Ptr && Ptr->getMetadata("ptr_name"))
-            GEP->setMetadata("ptr_name", Ptr->getMetadata("ptr_name"));
-          if (Ptr && Ptr->getMetadata("ptr_type"))
-            GEP->setMetadata("ptr_type", Ptr->getMetadata("ptr_type"));
-          if (Index && Index->getMetadata("ind_name"))
-            GEP->setMetadata("ind_name", Index->getMetadata("ind_name"));
+          unsigned PtrNames[NumNames], IndexNames[NumNames], Names[NumNames];
+          bool HasPtr = Ptr && getNames(Ptr, PtrNames);
+          bool HasIndex = Index && getNames(Index, IndexNames);
+          if (!HasPtr && !HasIndex)
+            continue;
+          Names[PtrName] = HasPtr ? PtrNames[PtrName] : 0;
+          Names[PtrType] = HasPtr ? PtrNames[PtrType] : 0;
+          Names[IndName] = HasIndex ? IndexNames[IndName] : 0;
+          setNames(GEP, Names);
         } else if (isa<CastInst>(&(*I))) {
           Instruction *Index = dyn_cast<Instruction>(I->getOperand(0));
-          if (Index && Index->getMetadata("ptr_name"))
-            I->setMetadata("ptr_name", Index->getMetadata("ptr_name"));
-          if (Index && Index->getMetadata("ptr_type"))
-            I->setMetadata("ptr_type", Index->getMetadata("ptr_type"));
-          if (Index && Index->getMetadata("ind_name"))
-            I->setMetadata("ind_name", Index->getMetadata("ind_name"));
+          unsigned Names[NumNames];
+          if (Index && getNames(Index, Names))
+            setNames(I, Names);
         }
       }
   }
 
+  StringIds.clear();
+  Tuples.clear();
   return false;
 }
 
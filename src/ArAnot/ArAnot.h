@@ -4,6 +4,7 @@
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/DominanceFrontier.h"
 #include "llvm/Analysis/Dominators.h"
@@ -30,8 +31,15 @@ class ArAnot : public ModulePass {
     // virtual void print(raw_ostream& OS, const Module *) const;
 
   private:
+    // The comments of a file, with their line, in the order they were added.
+    typedef vector<std::pair<unsigned, string> > FileCommentsTy;
+
     ASI *AS;
-    DenseMap<unsigned, vector<string>*> Comments;
+    // The string table of the ArAnotMetadata names, by id.
+    vector<StringRef> Strings;
+    // The comments of every source file, by path.
+    StringMap<FileCommentsTy> Comments;
+    // The first file of the module, the one -aranot-output annotates.
     string InputFile;
 
     string getSizeRepr(Value *V);
@@ -39,20 +47,49 @@ class ArAnot : public ModulePass {
     string getPtrTypeMetadata(Instruction *I);
     string getIndMetadata(Instruction *I);
     string getPtrMetadata(Instruction *I);
+    string getNameMetadata(Instruction *I, unsigned Field);
     string getPtrAccessRepr(Instruction *I);
     string getLineForIns(Value *V);
     int getLineNo(Value *V);
-    void printToFile(string InputFile, string Filename);
-    void addCommentToLine(string Comment, unsigned Line);
+    void printToFile(string InputFile, string Filename,
+                     FileCommentsTy &FileComments);
+    void printToDir(string Dir);
+    void printReport(string Output);
+    void addCommentToLine(string Comment, string File, unsigned Line);
     void addComments(GetElementPtrInst *GEP);
 };
 
+// Attaches to the loads, GEPs and casts of the source variables the names of
+// the pointer, the index and the pointee type, as a deduplicated tuple
+//   !aranot !{i32 PtrName, i32 IndName, i32 PtrType}
+// of ids into the module string table !aranot.strings. Id 0 is no name.
 class ArAnotMetadata : public ModulePass {
   public:
+    enum NameField { PtrName, IndName, PtrType, NumNames };
+
     static char ID;
-    ArAnotMetadata() : ModulePass(ID) { }
+    ArAnotMetadata() : ModulePass(ID), StringTable(NULL) { }
 
     virtual bool runOnModule(Module &M);
     virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+
+    // The ids of the names of I, false if it has none.
+    static bool getNames(Instruction *I, unsigned Names[NumNames]);
+    // The strings of the table of M, by id.
+    static void getStringTable(Module &M, vector<StringRef> &Strings);
+    // Removes the names and the table from M.
+    static bool stripNames(Module &M);
+
+  private:
+    typedef DenseMap<std::pair<std::pair<unsigned, unsigned>, unsigned>,
+                     MDNode*> TupleMapTy;
+
+    NamedMDNode *StringTable;
+    StringMap<unsigned> StringIds;
+    // The tuples already made, to share them between the instructions.
+    TupleMapTy Tuples;
+
+    unsigned getStringId(Value *Str);
+    void setNames(Instruction *I, unsigned Names[NumNames]);
 };
 
@@ -6,6 +6,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/DominanceFrontier.h"
@@ -19,16 +20,34 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Value.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 
 #include "ArraySizeInference.h"
 
+#include <algorithm>
+#include <pthread.h>
+
 using namespace llvm;
 
+static cl::opt<unsigned> ClThreads("asi-threads",
+                cl::desc("Threads summarizing independent SCCs of the call graph (1)"),
+                cl::init(1));
+
 STATISTIC(TotalMemIns, "Total memory instructions");
 STATISTIC(SafeMemIns,  "Safe memory instructions");
+STATISTIC(SafeCacheHits,   "isSafe queries answered by the cache");
+STATISTIC(SafeCacheMisses, "isSafe queries computed");
+
+// The function called by CI, looking through a bitcast of the function.
+static Function *getCallee(CallInst *CI) {
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(CI->getCalledValue()))
+    if (CE->getOpcode() == Instruction::BitCast)
+      return dyn_cast<Function>(CE->getOperand(0));
+  return CI->getCalledFunction();
+}
 
 static bool IsSLT(APInt L, APInt R) {
   unsigned LBitWidth = L.getBitWidth();
@@ -76,6 +95,7 @@ bool ASI::runOnModule(Module &M) {
   CG = &getAnalysis<CallGraph>();
   
   Context = &M.getContext();
+  clearSafeCache();
 
   // Symbolic top and bottom for the array-size lattice.
   Top = ConstantDataArray::getString(*Context, "** Top **");
@@ -128,16 +148,28 @@ bool ASI::runOnModule(Module &M) {
        GI != GE; ++GI)
     visitGlobal(&(*GI));
 
-  // Add functions to the function worklist in post-order according to the
-  // call graph.
-  CallGraphNode *Entry = CG->getExternalCallingNode();
-  for (po_iterator<CallGraphNode*> FI = po_begin(Entry), FE = po_end(Entry);
-       FI != FE; ++FI) {
-    Function *F = FI->getFunction();
-    if (F && !F->isDeclaration() && !F->isIntrinsic())
-      FnWorklist.insert(F);
+  // Summarize the functions bottom-up, then instantiate the summaries of the
+  // malloc()-like functions at their calls, in visitCall.
+  buildCallGraphSCCs(M);
+  summarizeSCCs(ClThreads);
+  for (DenseMap<Function*, unsigned>::iterator FI = FnIndex.begin(),
+       FE = FnIndex.end(); FI != FE; ++FI) {
+    Value *Size = ReturnSizes[FI->second];
+    if (!Size || MallocLikeFnPointers.count(FI->first))
+      continue;
+    DEBUG(dbgs() << "ASI: Summary: " << FI->first->getName() << " ==> "
+                 << *Size << "\n");
+    PointersTy *Pointers = new PointersTy();
+    Pointers->insert(Size);
+    MallocLikeFnPointers[FI->first] = Pointers;
   }
 
+  // Add functions to the function worklist with the callees first, so that
+  // the callers come out of it first.
+  for (unsigned SCC = 0; SCC < SCCs.size(); ++SCC)
+    for (unsigned Idx = 0; Idx < SCCs[SCC].size(); ++Idx)
+      FnWorklist.insert(SCCs[SCC][Idx]);
+
   while (!FnWorklist.empty()) {
     Function *F = FnWorklist.back();
     FnWorklist.pop_back();
@@ -207,6 +239,49 @@ bool ASI::runOnModule(Module &M) {
 
 // isSafe
 bool ASI::isSafe(Value *Ptr) {
+  ValueMap<Value*, bool, SafeCacheConfig>::iterator It = SafeCache.find(Ptr);
+  if (It != SafeCache.end()) {
+    SafeCacheHits++;
+    return It->second;
+  }
+  SafeCacheMisses++;
+  LowerBoundsTy Lowers;
+  bool Safe = computeSafe(Ptr, Lowers);
+  SafeCache[Ptr] = Safe;
+  return Safe;
+}
+
+// isSafe
+void ASI::isSafe(ArrayRef<Value*> Ptrs, SmallVectorImpl<bool> &Safe) {
+  LowerBoundsTy Lowers;
+  Safe.resize(Ptrs.size());
+  for (unsigned Idx = 0; Idx < Ptrs.size(); ++Idx) {
+    ValueMap<Value*, bool, SafeCacheConfig>::iterator It =
+      SafeCache.find(Ptrs[Idx]);
+    if (It != SafeCache.end()) {
+      SafeCacheHits++;
+      Safe[Idx] = It->second;
+      continue;
+    }
+    SafeCacheMisses++;
+    Safe[Idx] = computeSafe(Ptrs[Idx], Lowers);
+    SafeCache[Ptrs[Idx]] = Safe[Idx];
+  }
+}
+
+// getLower
+// The lower bound of Size, shared by the pointers of the same query.
+APInt ASI::getLower(Value *Size, LowerBoundsTy &Lowers) {
+  LowerBoundsTy::iterator It = Lowers.find(Size);
+  if (It != Lowers.end())
+    return It->second;
+  APInt Lower = IG->getLower(Size);
+  Lowers.insert(std::make_pair(Size, Lower));
+  return Lower;
+}
+
+// computeSafe
+bool ASI::computeSafe(Value *Ptr, LowerBoundsTy &Lowers) {
   if (Ptr->getType()->isPointerTy()) {
     Type *T = Ptr->getType()->getPointerElementType();
     Value *ByteSize = getByteSize(Ptr);
@@ -214,13 +289,13 @@ bool ASI::isSafe(Value *Ptr) {
     // of it's type...
     if (isValidSize(ByteSize) && T->isSized()) {
       unsigned Size = DL->getTypeAllocSize(T);
-      if (IG->getLower(ByteSize).sge(Size))
+      if (getLower(ByteSize, Lowers).sge(Size))
         return true;
     }
     // ... or if it's index size is strictly positive.
     Value *IndexSize = getIndexSize(Ptr);
     if (isValidSize(IndexSize))
-      if (IG->getLower(IndexSize).isStrictlyPositive())
+      if (getLower(IndexSize, Lowers).isStrictlyPositive())
         return true;
   }
   return false;
@@ -523,14 +598,7 @@ void ASI::visitCall(CallInst *CI) {
   //        and remove or change the allocation size accordingly.
   // FIXME: If an allocated pointer is passed to an unknown function, consider
   //        consider the pointer deallocated.
-  Value *V = CI->getCalledValue();
-  Function *Callee = CI->getCalledFunction();
-  
-  // Check if the called value is a bitcast of a function.
-  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
-    if (CE->getOpcode() == Instruction::BitCast)
-      Callee = dyn_cast<Function>(CE->getOperand(0));
-  }
+  Function *Callee = getCallee(CI);
 
   if (!Callee || Callee->isVarArg())
     return;
@@ -562,17 +630,12 @@ void ASI::visitCall(CallInst *CI) {
       }
     }
   }
-
-  // If the function is defined in this module, save the arguments of the call.
-  if (!Callee->isDeclaration() && !Callee->isIntrinsic())
-    insertArgsValue(CI, Callee);
-
 }
 
+// insertArgsValue
+// Saves the real arguments of CI for the formals of F. Called once per call,
+// by buildCallGraphSCCs.
 void ASI::insertArgsValue(CallInst *CI, Function *F) {
-  if (ArgsMapHandledCalls.count(CI))
-    return;
-  ArgsMapHandledCalls.insert(CI);
   DEBUG(dbgs() << "ASI: insertArgsValue: " << *CI << "\n");
   unsigned Idx = 0;
   for (Function::arg_iterator AI = F->arg_begin(), AE = F->arg_end();
@@ -582,6 +645,203 @@ void ASI::insertArgsValue(CallInst *CI, Function *F) {
   // FnWorklist.insert(A->getParent());
 }
 
+// buildCallGraphSCCs
+// Numbers the SCCs of the call graph with the callees first, and saves the
+// real arguments of every call to a function defined in the module.
+void ASI::buildCallGraphSCCs(Module &M) {
+  for (scc_iterator<CallGraph*> I = scc_begin(CG), E = scc_end(CG);
+       I != E; ++I) {
+    std::vector<CallGraphNode*> &Nodes = *I;
+    std::vector<Function*> Fns;
+    for (unsigned Idx = 0; Idx < Nodes.size(); ++Idx) {
+      Function *F = Nodes[Idx]->getFunction();
+      if (F && !F->isDeclaration() && !F->isIntrinsic())
+        Fns.push_back(F);
+    }
+    if (Fns.empty())
+      continue;
+    for (unsigned Idx = 0; Idx < Fns.size(); ++Idx) {
+      SCCOf[Fns[Idx]] = SCCs.size();
+      FnIndex[Fns[Idx]] = ReturnSizes.size();
+      ReturnSizes.push_back(NULL);
+    }
+    SCCs.push_back(Fns);
+  }
+
+  // The call graph doesn't see the calls through bitcasts, so the callers
+  // are found on the calls themselves. Only the callees in earlier SCCs are
+  // kept, which keeps the SCCs a DAG.
+  SCCCallers.resize(SCCs.size());
+  for (unsigned SCC = 0; SCC < SCCs.size(); ++SCC) {
+    for (unsigned Idx = 0; Idx < SCCs[SCC].size(); ++Idx) {
+      Function *F = SCCs[SCC][Idx];
+      for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+        for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+          CallInst *CI = dyn_cast<CallInst>(&(*I));
+          if (!CI)
+            continue;
+          Function *Callee = getCallee(CI);
+          if (!Callee || Callee->isDeclaration() || Callee->isIntrinsic())
+            continue;
+          if (!Callee->isVarArg())
+            insertArgsValue(CI, Callee);
+          DenseMap<Function*, unsigned>::iterator SI = SCCOf.find(Callee);
+          if (SI != SCCOf.end() && SI->second < SCC)
+            SCCCallers[SI->second].push_back(SCC);
+        }
+    }
+  }
+  for (unsigned SCC = 0; SCC < SCCs.size(); ++SCC) {
+    std::vector<unsigned> &Callers = SCCCallers[SCC];
+    std::sort(Callers.begin(), Callers.end());
+    Callers.erase(std::unique(Callers.begin(), Callers.end()), Callers.end());
+  }
+}
+
+namespace {
+// The DAG of the SCCs of the call graph and the state of the threads
+// summarizing it. An SCC is ready once all the SCCs it calls are done.
+struct SummarySchedule {
+  ASI *Analysis;
+  std::vector<std::vector<unsigned> > *Callers;
+  // Number of the SCCs called by each SCC that are not done yet
+  std::vector<unsigned> Pending;
+  std::vector<unsigned> Ready;
+  unsigned NumDone;
+  pthread_mutex_t Lock;
+  pthread_cond_t Changed;
+};
+}
+
+// runSummaryJobs
+void *ASI::runSummaryJobs(void *Arg) {
+  SummarySchedule *S = (SummarySchedule*)Arg;
+  unsigned NumSCCs = S->Pending.size();
+
+  pthread_mutex_lock(&S->Lock);
+  while (true) {
+    while (S->Ready.empty() && S->NumDone < NumSCCs)
+      pthread_cond_wait(&S->Changed, &S->Lock);
+    if (S->Ready.empty())
+      break;
+
+    unsigned SCC = S->Ready.back();
+    S->Ready.pop_back();
+    pthread_mutex_unlock(&S->Lock);
+
+    S->Analysis->summarizeSCC(SCC);
+
+    pthread_mutex_lock(&S->Lock);
+    ++S->NumDone;
+    std::vector<unsigned> &Callers = (*S->Callers)[SCC];
+    for (unsigned Idx = 0; Idx < Callers.size(); ++Idx)
+      if (--S->Pending[Callers[Idx]] == 0)
+        S->Ready.push_back(Callers[Idx]);
+    pthread_cond_broadcast(&S->Changed);
+  }
+  pthread_mutex_unlock(&S->Lock);
+  return 0;
+}
+
+// summarizeSCCs
+// Summarizes every SCC once the SCCs it calls are done; the independent SCCs
+// are summarized by NumThreads threads at the same time. Summaries only
+// read the IR and the summaries of the callees, and each one is written by
+// a single thread.
+void ASI::summarizeSCCs(unsigned NumThreads) {
+  if (NumThreads <= 1) {
+    for (unsigned SCC = 0; SCC < SCCs.size(); ++SCC)
+      summarizeSCC(SCC);
+    return;
+  }
+
+  SummarySchedule S;
+  S.Analysis = this;
+  S.Callers = &SCCCallers;
+  S.Pending.assign(SCCs.size(), 0);
+  for (unsigned SCC = 0; SCC < SCCs.size(); ++SCC)
+    for (unsigned Idx = 0; Idx < SCCCallers[SCC].size(); ++Idx)
+      ++S.Pending[SCCCallers[SCC][Idx]];
+  // The workers take the ready SCCs from the back
+  for (unsigned SCC = SCCs.size(); SCC-- > 0;)
+    if (S.Pending[SCC] == 0)
+      S.Ready.push_back(SCC);
+  S.NumDone = 0;
+  pthread_mutex_init(&S.Lock, 0);
+  pthread_cond_init(&S.Changed, 0);
+
+  std::vector<pthread_t> Threads(NumThreads - 1);
+  for (unsigned T = 0; T < Threads.size(); ++T) {
+    if (pthread_create(&Threads[T], 0, runSummaryJobs, &S) != 0) {
+      Threads.resize(T);
+      break;
+    }
+  }
+  runSummaryJobs(&S);
+  for (unsigned T = 0; T < Threads.size(); ++T)
+    pthread_join(Threads[T], 0);
+
+  pthread_cond_destroy(&S.Changed);
+  pthread_mutex_destroy(&S.Lock);
+}
+
+// summarizeSCC
+void ASI::summarizeSCC(unsigned SCC) {
+  for (unsigned Idx = 0; Idx < SCCs[SCC].size(); ++Idx) {
+    Function *F = SCCs[SCC][Idx];
+    ReturnSizes[FnIndex.find(F)->second] = summarizeReturnSize(F, SCC);
+  }
+}
+
+// getReturnSize
+// The byte size of the pointers returned by F, if F is a malloc()-like
+// function of the library or a function summarized before SCC.
+Value *ASI::getReturnSize(Function *F, unsigned SCC) {
+  FnPointersTy::iterator MI = MallocLikeFnPointers.find(F);
+  if (MI != MallocLikeFnPointers.end())
+    return MI->second->size() == 1 ? MI->second->front() : NULL;
+  DenseMap<Function*, unsigned>::iterator SI = SCCOf.find(F);
+  if (SI == SCCOf.end() || SI->second >= SCC)
+    return NULL;
+  return ReturnSizes[FnIndex.find(F)->second];
+}
+
+// summarizeReturnSize
+// If every return of F returns the result of a call with a known size,
+// instantiated at the call as one of the formals of F or a constant, returns
+// that size.
+Value *ASI::summarizeReturnSize(Function *F, unsigned SCC) {
+  if (!F->getReturnType()->isPointerTy())
+    return NULL;
+
+  Value *Size = NULL;
+  for (Function::iterator BB = F->begin(), E = F->end(); BB != E; ++BB) {
+    ReturnInst *RI = dyn_cast<ReturnInst>(BB->getTerminator());
+    if (!RI)
+      continue;
+    CallInst *CI = dyn_cast<CallInst>(RI->getReturnValue()->stripPointerCasts());
+    if (!CI)
+      return NULL;
+    Function *Callee = getCallee(CI);
+    Value *CalleeSize = Callee ? getReturnSize(Callee, SCC) : NULL;
+    if (!CalleeSize)
+      return NULL;
+    // Instantiate the size of the callee at the call.
+    if (Argument *A = dyn_cast<Argument>(CalleeSize)) {
+      if (A->getArgNo() >= CI->getNumArgOperands())
+        return NULL;
+      CalleeSize = CI->getArgOperand(A->getArgNo());
+    }
+    Argument *A = dyn_cast<Argument>(CalleeSize);
+    if (!isa<ConstantInt>(CalleeSize) && !(A && A->getParent() == F))
+      return NULL;
+    if (Size && Size != CalleeSize)
+      return NULL;
+    Size = CalleeSize;
+  }
+  return Size;
+}
+
 // visitBitCast
 void ASI::visitBitCast(BitCastInst *BCI) {
   if (!BCI->getType()->isPointerTy())
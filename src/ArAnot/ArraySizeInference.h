@@ -1,9 +1,11 @@
 #include "llvm/Pass.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/ValueMap.h"
 #include "llvm/Analysis/CallGraph.h"
 #include "llvm/Analysis/DominanceFrontier.h"
 #include "llvm/Analysis/Dominators.h"
@@ -16,7 +18,7 @@
 
 #include "IneqGraph.h"
 #include "PointerSSI.h"
-#include "AliasSets.h"
+#include "../AliasSets/AliasSets.h"
 
 #include <vector>
 
@@ -31,8 +33,15 @@ class ASI : public ModulePass {
     Value *getIndexSize(Value *V);
 
     bool isSafe(Value *Ptr);
+    // Answers isSafe for all of Ptrs at once, in Safe. The pointers with the
+    // same sizes share their bounds.
+    void isSafe(ArrayRef<Value*> Ptrs, SmallVectorImpl<bool> &Safe);
     bool isValidSize(Value *Size);
 
+    // Forgets the results of isSafe. Results are dropped on their own when
+    // their pointer is deleted; a pass that changes the sizes calls this.
+    void clearSafeCache() { SafeCache.clear(); }
+
     virtual bool runOnModule(Module &M);
     virtual void getAnalysisUsage(AnalysisUsage &AU) const;
     virtual void print(raw_ostream& OS, const Module *) const;
@@ -44,7 +53,6 @@ class ASI : public ModulePass {
     typedef SetVector<BasicBlock*> BlocksTy;
     typedef std::vector<Value*> ArgsValueTy;
     typedef DenseMap<Argument*, ArgsValueTy*> ArgsMapTy;
-    typedef SetVector<Value*> ArgsMapHandledCallsTy;
 
     Value *getSize(SizesTy &Sizes, Value *V);
 
@@ -58,8 +66,20 @@ class ASI : public ModulePass {
 
     void insertArgsValue(CallInst *CI, Function *F);
 
+    // Summaries, computed bottom-up over the SCCs of the call graph.
+    void buildCallGraphSCCs(Module &M);
+    void summarizeSCCs(unsigned NumThreads);
+    static void *runSummaryJobs(void *Arg);
+    void summarizeSCC(unsigned SCC);
+    Value *summarizeReturnSize(Function *F, unsigned SCC);
+    Value *getReturnSize(Function *F, unsigned SCC);
+
     Value *meetSizes(Value *A, Value *B);
 
+    typedef DenseMap<Value*, APInt> LowerBoundsTy;
+    bool computeSafe(Value *Ptr, LowerBoundsTy &Lowers);
+    APInt getLower(Value *Size, LowerBoundsTy &Lowers);
+
     void inferMallocLikeFn(Function *F);
     void inferAllocationSize(Instruction *I);
     void inferParametersAllocationSize(SizesTy &Sizes, Function *F);
@@ -82,12 +102,31 @@ class ASI : public ModulePass {
 
     FnPointersTy MallocLikeFnPointers;
     FnPointersTy FreeLikeFnPointers;
+
+    // The SCCs of the call graph, callees first, and the SCCs that call each
+    // one.
+    std::vector<std::vector<Function*> > SCCs;
+    std::vector<std::vector<unsigned> > SCCCallers;
+    DenseMap<Function*, unsigned> SCCOf;
+
+    // The byte size of the pointers each function returns, as one of its
+    // formals or a constant, NULL if unknown. Written once per function, by
+    // the thread that summarizes its SCC.
+    DenseMap<Function*, unsigned> FnIndex;
+    std::vector<Value*> ReturnSizes;
+
     SizesTy ByteSizes;
     SizesTy IndexSizes;
     SetVector<BasicBlock*> Worklist;
     SetVector<Function*> FnWorklist;
     ArgsMapTy ArgsMap;
-    ArgsMapHandledCallsTy ArgsMapHandledCalls;
+
+    // The results of isSafe. A replaced pointer keeps its result, which it
+    // doesn't pass on to its replacement.
+    struct SafeCacheConfig : ValueMapConfig<Value*> {
+      enum { FollowRAUW = false };
+    };
+    ValueMap<Value*, bool, SafeCacheConfig> SafeCache;
 
     Value *Top;
     Value *Bottom;
@@ -0,0 +1,125 @@
+#ifndef LLVM_TRANSFORMS_DOMTREEORDER_DOMTREEORDER_H_
+#define LLVM_TRANSFORMS_DOMTREEORDER_DOMTREEORDER_H_
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Value.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace llvm {
+
+// DomTreeOrder
+// Numbers the blocks of a dominator tree in DFS order. A block gets the
+// number it is entered at and the last number of its subtree, so the blocks
+// it dominates are the ones numbered in between: dominance is two
+// comparisons, and the users of a value sorted by these numbers have the
+// ones dominated by a block in one contiguous range.
+//
+// The numbers only depend on the CFG, so they stay valid while instructions
+// are inserted or renamed.
+class DomTreeOrder {
+public:
+  typedef SmallVector<Instruction*, 32> UsersTy;
+  typedef UsersTy::iterator user_iterator;
+
+  explicit DomTreeOrder(DominatorTree &DT) {
+    // Iterative DFS: the stack holds a node and its next child.
+    SmallVector<std::pair<DomTreeNode*, DomTreeNode::iterator>, 32> Stack;
+    unsigned Next = 0;
+    DomTreeNode *Root = DT.getRootNode();
+    if (!Root)
+      return;
+    Numbers[Root->getBlock()].first = Next++;
+    Stack.push_back(std::make_pair(Root, Root->begin()));
+    while (!Stack.empty()) {
+      DomTreeNode *Node = Stack.back().first;
+      if (Stack.back().second == Node->end()) {
+        Numbers[Node->getBlock()].second = Next - 1;
+        Stack.pop_back();
+        continue;
+      }
+      DomTreeNode *Child = *Stack.back().second++;
+      Numbers[Child->getBlock()].first = Next++;
+      Stack.push_back(std::make_pair(Child, Child->begin()));
+    }
+  }
+
+  // Same as DominatorTree::dominates: an unreachable block is dominated by
+  // every block, and dominates none but itself.
+  bool dominates(const BasicBlock *A, const BasicBlock *B) const {
+    if (A == B)
+      return true;
+    NumbersTy::const_iterator BI = Numbers.find(B);
+    if (BI == Numbers.end())
+      return true;
+    NumbersTy::const_iterator AI = Numbers.find(A);
+    if (AI == Numbers.end())
+      return false;
+    return AI->second.first <= BI->second.first &&
+           BI->second.first <= AI->second.second;
+  }
+
+  // The instructions using V, each once, sorted by the number of their
+  // block. Users in unreachable blocks go last.
+  void getSortedUsers(Value *V, UsersTy &Users) const {
+    Users.clear();
+    for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
+         UI != UE; ++UI)
+      if (Instruction *I = dyn_cast<Instruction>(*UI))
+        Users.push_back(I);
+    std::sort(Users.begin(), Users.end(), CompareUsers(*this));
+    Users.erase(std::unique(Users.begin(), Users.end()), Users.end());
+  }
+
+  // The users in a sorted list whose block BB dominates, as a range. Users
+  // in unreachable blocks are in no range.
+  std::pair<user_iterator, user_iterator>
+  getDominatedUsers(UsersTy &Users, const BasicBlock *BB) const {
+    NumbersTy::const_iterator BI = Numbers.find(BB);
+    if (BI == Numbers.end())
+      return std::make_pair(Users.end(), Users.end());
+    user_iterator First = std::lower_bound(Users.begin(), Users.end(),
+                                           BI->second.first,
+                                           CompareUsers(*this));
+    user_iterator Last = std::upper_bound(First, Users.end(),
+                                          BI->second.second,
+                                          CompareUsers(*this));
+    return std::make_pair(First, Last);
+  }
+
+  // The number users are sorted by, ~0U for the unreachable blocks.
+  unsigned getNumber(const Instruction *I) const {
+    NumbersTy::const_iterator It = Numbers.find(I->getParent());
+    return It == Numbers.end() ? ~0U : It->second.first;
+  }
+
+private:
+  typedef DenseMap<const BasicBlock*, std::pair<unsigned, unsigned> > NumbersTy;
+
+  // Orders users by the number of their block, then by address, so that
+  // the duplicates end up next to each other.
+  struct CompareUsers {
+    const DomTreeOrder &Order;
+    CompareUsers(const DomTreeOrder &Order) : Order(Order) { }
+    bool operator()(const Instruction *A, const Instruction *B) const {
+      unsigned NA = Order.getNumber(A), NB = Order.getNumber(B);
+      return NA < NB || (NA == NB && A < B);
+    }
+    bool operator()(const Instruction *A, unsigned N) const {
+      return Order.getNumber(A) < N;
+    }
+    bool operator()(unsigned N, const Instruction *B) const {
+      return N < Order.getNumber(B);
+    }
+  };
+
+  NumbersTy Numbers;
+};
+
+}
+
+#endif
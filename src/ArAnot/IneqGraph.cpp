@@ -15,34 +15,30 @@
 #include "RangeAnalysis.h"
 #include "IneqGraph.h"
 
+#include <algorithm>
+#include <limits>
 #include <queue>
 
 using namespace llvm;
 
 using std::queue;
 
-GraphEdge::GraphEdge() :
-  From(NULL), To(NULL), ETy(NONE) {
-}
-
-GraphEdge::GraphEdge(GraphNode *From, GraphNode *To, EdgeType ETy, APInt Weight) :
-  From(From), To(To), ETy(ETy), Weight(Weight) {
-}
-
-void GraphEdge::print(raw_ostream &OS) {
+// printEdge
+void IneqGraph::printEdge(raw_ostream &OS, unsigned From,
+                          const GraphEdge &E) const {
   const StringRef MayColor = "black";
   const StringRef MustColor = "blue";
 
   StringRef Color;
-  if (ETy == MAY) {
+  if (E.getEdgeType() == GraphEdge::MAY) {
     Color = MayColor;
-  } else if (ETy == MUST) {
+  } else if (E.getEdgeType() == GraphEdge::MUST) {
     Color = MustColor;
   } else {
     assert(false && "Invalid ETy");
   }
 
-  Value *FromValue = From->getValue();
+  Value *FromValue = Nodes[From].getValue();
   if (FromValue->hasName())
     OS << "    \"" << FromValue->getName();
   else
@@ -50,25 +46,110 @@ void GraphEdge::print(raw_ostream &OS) {
 
   OS << "\" -> "; 
 
-  Value *ToValue = To->getValue();
+  Value *ToValue = Nodes[E.getToEdge()].getValue();
   if (ToValue->hasName())
     OS << "\"" << ToValue->getName();
   else
     OS << "\"" << *ToValue;
 
-  OS << "\" [label =\"" << Weight << "\", color = \"" << Color << "\"];\n";
+  OS << "\" [label =\"" << getWeight(E) << "\", color = \"" << Color << "\"];\n";
 }
 
 // getOrCreateNode
-GraphNode *IneqGraph::getOrCreateNode(Value *V) {
-  if (!NodeMap.count(V))
-    NodeMap[V] = new GraphNode(V);
-  return NodeMap[V];
+unsigned IneqGraph::getOrCreateNode(Value *V) {
+  std::pair<NodeMapTy::iterator, bool> Res =
+    NodeMap.insert(std::make_pair(V, (unsigned)Nodes.size()));
+  if (Res.second) {
+    Nodes.push_back(GraphNode(V));
+    PathDepth.push_back(~0U);
+  }
+  return Res.first->second;
 }
 
 // getNode
-GraphNode *IneqGraph::getNode(Value *V) {
-  return NodeMap.count(V) ? NodeMap[V] : NULL;
+unsigned IneqGraph::getNode(Value *V) {
+  NodeMapTy::iterator It = NodeMap.find(V);
+  return It != NodeMap.end() ? It->second : ~0U;
+}
+
+// makeEdge
+GraphEdge IneqGraph::makeEdge(unsigned To, GraphEdge::EdgeType ETy,
+                              APInt Weight) {
+  if (Weight.getMinSignedBits() <= 64)
+    return GraphEdge(To, ETy, Weight.getSExtValue());
+  WideWeights.push_back(Weight);
+  return GraphEdge(To, ETy, WideWeights.size() - 1, true);
+}
+
+// addEdge
+// The edge is held back until the next query, which compacts all the new
+// edges at once.
+void IneqGraph::addEdge(unsigned From, const GraphEdge &Edge) {
+  PendingEdges.push_back(std::make_pair(From, Edge));
+  clearDistances();
+}
+
+// compact
+// Moves the pending edges into the edge array, keeping the edges of each
+// node together, may edges first, in the order they were added.
+void IneqGraph::compact() {
+  if (PendingEdges.empty())
+    return;
+
+  unsigned NumNodes = Nodes.size();
+  std::vector<unsigned> NumMay(NumNodes), NumMust(NumNodes);
+  for (unsigned N = 0; N < NumNodes; ++N) {
+    NumMay[N] = Nodes[N].MustBegin - Nodes[N].MayBegin;
+    NumMust[N] = Nodes[N].End - Nodes[N].MustBegin;
+  }
+  std::vector<unsigned> NextMay(NumMay), NextMust(NumMust);
+  for (unsigned Idx = 0; Idx < PendingEdges.size(); ++Idx) {
+    unsigned From = PendingEdges[Idx].first;
+    if (PendingEdges[Idx].second.getEdgeType() == GraphEdge::MUST)
+      ++NumMust[From];
+    else
+      ++NumMay[From];
+  }
+
+  std::vector<GraphEdge> NewEdges(Edges.size() + PendingEdges.size());
+  unsigned Offset = 0;
+  for (unsigned N = 0; N < NumNodes; ++N) {
+    GraphNode &Node = Nodes[N];
+    unsigned MayBegin = Offset;
+    unsigned MustBegin = MayBegin + NumMay[N];
+    std::copy(Edges.begin() + Node.MayBegin, Edges.begin() + Node.MustBegin,
+              NewEdges.begin() + MayBegin);
+    std::copy(Edges.begin() + Node.MustBegin, Edges.begin() + Node.End,
+              NewEdges.begin() + MustBegin);
+    NextMay[N] += MayBegin;
+    NextMust[N] += MustBegin;
+    Offset = MustBegin + NumMust[N];
+    Node.MayBegin = MayBegin;
+    Node.MustBegin = MustBegin;
+    Node.End = Offset;
+  }
+
+  for (unsigned Idx = 0; Idx < PendingEdges.size(); ++Idx) {
+    unsigned From = PendingEdges[Idx].first;
+    const GraphEdge &Edge = PendingEdges[Idx].second;
+    if (Edge.getEdgeType() == GraphEdge::MUST)
+      NewEdges[NextMust[From]++] = Edge;
+    else
+      NewEdges[NextMay[From]++] = Edge;
+  }
+
+  Edges.swap(NewEdges);
+  PendingEdges.clear();
+}
+
+// getWeight64
+// The weight of E, saturated to 64 bits.
+int64_t IneqGraph::getWeight64(const GraphEdge &E) const {
+  if (!E.isWide())
+    return E.getRawWeight();
+  if (WideWeights[E.getRawWeight()].isNegative())
+    return std::numeric_limits<int64_t>::min();
+  return std::numeric_limits<int64_t>::max();
 }
 
 /* void GraphNode::getReachableNodes(SetVector<GraphNode*> &Mark) {
@@ -119,48 +200,88 @@ void GraphNode::removeMustEdges() {
   //minimize(Intersection);
 } */
 
-APInt GraphNode::findShortestPath(GraphNode *Dest, SetVector<GraphNode*> Visited) {
-  if (Dest == this) {
-    DEBUG(dbgs() << "IneqGraph: Reached: " << *Dest->getValue() << "\n");
-    return APInt(64, 0, true);
+// findShortestPath
+// ABCD-style demand-driven search: the distances from the nodes it goes
+// through are memoized, and reused by the later queries to the same node.
+// A node already on the path is a cycle, which gives no distance; the
+// distances found under such a node depend on the path, and are memoized
+// only once the search is back at the first node of the cycle.
+int64_t IneqGraph::findShortestPath(unsigned N, unsigned Dest,
+                                    unsigned &LowLink) {
+  const int64_t PlusInf = std::numeric_limits<int64_t>::max();
+  const int64_t MinusInf = std::numeric_limits<int64_t>::min();
+  LowLink = ~0U;
+
+  if (Dest == N) {
+    DEBUG(dbgs() << "IneqGraph: Reached: " << *Nodes[Dest].getValue() << "\n");
+    return 0;
   }
 
-  DEBUG(dbgs() << "IneqGraph: Node: " << *V << "\n");
+  DenseMap<std::pair<unsigned, unsigned>, int64_t>::iterator DI =
+    Distances.find(std::make_pair(N, Dest));
+  if (DI != Distances.end())
+    return DI->second;
 
-  if (Visited.count(this)) {
+  DEBUG(dbgs() << "IneqGraph: Node: " << *Nodes[N].getValue() << "\n");
+
+  if (PathDepth[N] != ~0U) {
     DEBUG(dbgs() << "IneqGraph: Visited\n");
-    return APInt::getSignedMaxValue(64); //(64, , true);
+    LowLink = PathDepth[N];
+    return PlusInf;
   }
-  Visited.insert(this);
-
-  APInt MayMin = APInt::getSignedMaxValue(64);
-  for (may_iterator It = may_begin(), E = may_end();
-       It != E; ++It) {
-    APInt Total = It->getToEdge()->findShortestPath(Dest, Visited);
-    if (Total.slt(MayMin))
-      MayMin = Total + It->getWeight();
+  unsigned Depth = PathLength++;
+  PathDepth[N] = Depth;
+
+  int64_t MayMin = PlusInf;
+  for (unsigned Idx = Nodes[N].MayBegin, E = Nodes[N].MustBegin;
+       Idx != E; ++Idx) {
+    unsigned EdgeLowLink;
+    int64_t Total = findShortestPath(Edges[Idx].getToEdge(), Dest, EdgeLowLink);
+    LowLink = std::min(LowLink, EdgeLowLink);
+    if (Total == PlusInf)
+      continue;
+    // Drop the paths whose length doesn't fit in 64 bits
+    int64_t Weight = getWeight64(Edges[Idx]);
+    if ((Weight > 0 && Total > PlusInf - Weight) ||
+        (Weight < 0 && Total < MinusInf - Weight))
+      continue;
+    if (Total + Weight < MayMin)
+      MayMin = Total + Weight;
   }
   //DEBUG(dbgs() << "IneqGraph: Node: " << *V << ", MayMin: " << MayMin << "\n");
 
-  APInt MustMax = APInt::getSignedMinValue(64);
-  for (must_iterator It = must_begin(), E = must_end();
-       It != E; ++It) {
-    APInt Total = It->getToEdge()->findShortestPath(Dest, Visited);
-    if (MustMax.slt(Total))
-      MustMax = Total;
+  int64_t MustMax = MinusInf;
+  for (unsigned Idx = Nodes[N].MustBegin, E = Nodes[N].End;
+       Idx != E; ++Idx) {
+    unsigned EdgeLowLink;
+    int64_t Total = findShortestPath(Edges[Idx].getToEdge(), Dest, EdgeLowLink);
+    LowLink = std::min(LowLink, EdgeLowLink);
+    // A path too long for 64 bits gives no bound; one too short is left
+    // out, the others are longer
+    int64_t Weight = getWeight64(Edges[Idx]);
+    if (Total == PlusInf || (Weight > 0 && Total > PlusInf - Weight)) {
+      MustMax = PlusInf;
+      continue;
+    }
+    if (Weight < 0 && Total < MinusInf - Weight)
+      continue;
+    if (MustMax < Total + Weight)
+      MustMax = Total + Weight;
   }
  // DEBUG(dbgs() << "IneqGraph: Node: " << *V << ", MustMax: " << MustMax << "\n");
 
-  if (MustMax.isMinSignedValue()) {
-    //DEBUG(dbgs() << "IneqGraph: Node: " << *V << ", Distance: " << MayMin << "\n");
-    DEBUG(dbgs() << "IneqGraph: Ret: " << MayMin << "\n");
-    return MayMin;
-  } else {
-    APInt Min = MustMax.slt(MayMin) ? MustMax : MayMin;
-    //DEBUG(dbgs() << "IneqGraph: Node: " << *V << ", Distance: " << Min << "\n");
-    DEBUG(dbgs() << "IneqGraph: Ret: " << Min << "\n");
-    return Min;
+  int64_t Min = MayMin;
+  if (MustMax != MinusInf && MustMax < MayMin)
+    Min = MustMax;
+  DEBUG(dbgs() << "IneqGraph: Ret: " << Min << "\n");
+
+  PathDepth[N] = ~0U;
+  --PathLength;
+  if (LowLink >= Depth) {
+    Distances[std::make_pair(N, Dest)] = Min;
+    LowLink = ~0U;
   }
+  return Min;
 }
 
 /* APInt GraphNode::findShortestPath(GraphNode *Dest) {
@@ -208,9 +329,9 @@ APInt GraphNode::findShortestPath(GraphNode *Dest, SetVector<GraphNode*> Visited
 void IneqGraph::addMayEdge(Value *F, Value *T, APInt Weight) {
   DEBUG(dbgs() << "IneqGraph: addMayEdge: " << *F << " == " << Weight
                 << " ==> " << *T << "\n");
-  GraphNode *FN = getOrCreateNode(F);
-  GraphNode *TN = getOrCreateNode(T);
-  FN->addMayEdgeTo(TN, Weight);
+  unsigned FN = getOrCreateNode(F);
+  unsigned TN = getOrCreateNode(T);
+  addEdge(FN, makeEdge(TN, GraphEdge::MAY, Weight));
 }
 
 // Adds the edge F -> T with weight Weight.
@@ -225,23 +346,38 @@ APInt IneqGraph::findShortestPath(Value *F, Value *T) {
       return APInt::getSignedMaxValue(64);
     return RangeF.sextOrSelf(64) - RangeT.sextOrSelf(64);
   }
-  GraphNode *FN = getOrCreateNode(F);
-  GraphNode *TN = getOrCreateNode(T);
-  return FN->findShortestPath(TN);
+  unsigned FN = getOrCreateNode(F);
+  unsigned TN = getOrCreateNode(T);
+  compact();
+  unsigned LowLink;
+  return APInt(64, findShortestPath(FN, TN, LowLink), true);
 }
 
 APInt IneqGraph::findShortestPathAt(Value *F, Value *T, BasicBlock *BB) {
   DEBUG(dbgs() << "IneqGraph: findShortestPathAt: " << *F << " ==> " << *T << " at " << BB->getName() << "\n");
+  std::pair<std::pair<Value*, Value*>, BasicBlock*> Key =
+    std::make_pair(std::make_pair(F, T), BB);
+  DenseMap<std::pair<std::pair<Value*, Value*>, BasicBlock*>, APInt>::iterator
+    It = DistancesAt.find(Key);
+  if (It != DistancesAt.end())
+    return It->second;
+
   Value *SigmaOrF = VS->getSigmaForAt(F, BB);
   Value *SigmaOrT = VS->getSigmaForAt(T, BB);
   APInt Shortest = findShortestPath(SigmaOrF, SigmaOrT);
   APInt Other = findShortestPath(F, SigmaOrT);
-  return Other.slt(Shortest) ? Other : Shortest;
+  APInt Result = Other.slt(Shortest) ? Other : Shortest;
+  DistancesAt[Key] = Result;
+  return Result;
 }
 
 // addMayEdge
 void IneqGraph::addMayEdge(Value *F, Value *T, int64_t Weight) {
-  addMayEdge(F, T, APInt(64, Weight, true));
+  DEBUG(dbgs() << "IneqGraph: addMayEdge: " << *F << " == " << Weight
+                << " ==> " << *T << "\n");
+  unsigned FN = getOrCreateNode(F);
+  unsigned TN = getOrCreateNode(T);
+  addEdge(FN, GraphEdge(TN, GraphEdge::MAY, Weight));
 }
 
 // addMustEdge
@@ -252,12 +388,13 @@ void IneqGraph::addMustEdge(Value *F, Value *T, APInt Weight) {
   if (isa<ConstantInt>(T)) {
     // Make the edge to the alfa node a must edge.
     // F <= T + W ==> F == upper(T) + W ==> :alfa:
-    GraphNode *FN = getOrCreateNode(F);
-    FN->addMustEdgeTo(AlfaNode, RA->getRange(F).getUpper());
+    unsigned FN = getOrCreateNode(F);
+    addEdge(FN, makeEdge(AlfaNode, GraphEdge::MUST,
+                         RA->getRange(F).getUpper()));
   } else {
-    GraphNode *FN = getOrCreateNode(F);
-    GraphNode *TN = getOrCreateNode(T);
-    FN->addMustEdgeTo(TN, Weight);
+    unsigned FN = getOrCreateNode(F);
+    unsigned TN = getOrCreateNode(T);
+    addEdge(FN, makeEdge(TN, GraphEdge::MUST, Weight));
   }
 }
 
@@ -304,9 +441,9 @@ void IneqGraph::addEdgesFor(Instruction *I) {
         if (!isa<ConstantInt>(A) && !BR.getUpper().isMaxSignedValue())
           addMayEdge(I, A, BR.getUpper());
         if (!isa<ConstantInt>(A) && !BR.getLower().isMinSignedValue())
-          addMayEdge(A, I, -BR.getUpper());
+          addMayEdge(A, I, -BR.getLower());
         if (!isa<ConstantInt>(B) && !AR.getLower().isMinSignedValue())
-          addMayEdge(B, I, -AR.getUpper());
+          addMayEdge(B, I, -AR.getLower());
         break;
       }
     case Instruction::Sub:
@@ -335,13 +472,13 @@ void IneqGraph::addEdgesFor(Instruction *I) {
         Value *R = Cmp->getOperand(1);
         DEBUG(dbgs() << "IneqGraph: R: " << *R << "\n");
         Value *LSigma = VS->findSigma(L, BI->getSuccessor(0), BI->getParent());
-        DEBUG(dbgs() << "IneqGraph: LSigma: " << *LSigma << "\n");
+        DEBUG(if (LSigma) dbgs() << "IneqGraph: LSigma: " << *LSigma << "\n");
         Value *RSigma = VS->findSigma(R, BI->getSuccessor(0), BI->getParent());
-        DEBUG(dbgs() << "IneqGraph: RSigma: " << *RSigma << "\n");
+        DEBUG(if (RSigma) dbgs() << "IneqGraph: RSigma: " << *RSigma << "\n");
         Value *LSExtSigma = VS->findSExtSigma(L, BI->getSuccessor(0), BI->getParent());
-        DEBUG(dbgs() << "IneqGraph: LSExtSigma: " << *LSExtSigma << "\n");
+        DEBUG(if (LSExtSigma) dbgs() << "IneqGraph: LSExtSigma: " << *LSExtSigma << "\n");
         Value *RSExtSigma = VS->findSExtSigma(R, BI->getSuccessor(0), BI->getParent());
-        DEBUG(dbgs() << "IneqGraph: RSExtSigma: " << *RSExtSigma << "\n");
+        DEBUG(if (RSExtSigma) dbgs() << "IneqGraph: RSExtSigma: " << *RSExtSigma << "\n");
         switch (Cmp->getPredicate()) {
           case ICmpInst::ICMP_SLT:
             DEBUG(dbgs() << "IneqGraph: SLT:\n");
@@ -362,7 +499,8 @@ void IneqGraph::addEdgesFor(Instruction *I) {
             DEBUG(dbgs() << "IneqGraph: SLE:\n");
             if (!isa<ConstantInt>(R) && LSigma && RSigma)
               addMayEdge(LSigma, RSigma, 0);
-            if (!isa<ConstantInt>(R) && (LSExtSigma != LSigma || RSExtSigma != RSigma))
+            if (!isa<ConstantInt>(R) && LSExtSigma && RSExtSigma &&
+                (LSExtSigma != LSigma || RSExtSigma != RSigma))
               addMayEdge(LSExtSigma, RSExtSigma, 0);
             break;
           default:
@@ -406,9 +544,10 @@ void IneqGraph::print(raw_ostream &OS, const Module*) const {
   OS << "  label = \"Inequality graph for module\";\n";
   OS << "  node [shape = record,fontname = \"Times-Roman\", fontsize = 14];\n";
 
-  for (NodeMapTy::iterator NI = IG.begin(), NE = IG.end(); NI != NE;
-       ++NI)
-    NI->second->print(OS);
+  IG.compact();
+  for (unsigned N = 0; N < Nodes.size(); ++N)
+    for (unsigned Idx = Nodes[N].MayBegin; Idx != Nodes[N].End; ++Idx)
+      printEdge(OS, N, Edges[Idx]);
 
   OS << "    label = \"Function: ALL\";\n";
   OS << "    graph[style = dotted];\n";
@@ -2,8 +2,6 @@
 #define LLVM_TRANSFORMS_INEQUALITYGRAPH_INEQUALITYGRAPH_H_
 
 #include "llvm/Pass.h"
-#include "llvm/ADT/ilist.h"
-#include "llvm/ADT/ilist_node.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/Statistic.h"
@@ -17,93 +15,108 @@
 
 #include "RangeAnalysis.h"
 
-namespace llvm {
+#include <vector>
 
-class GraphNode;
+namespace llvm {
 
-class GraphEdge : public ilist_node<GraphEdge> {
+// An edge of the inequality graph, kept in the edge array of the graph with
+// the other edges of its source node. The weights that don't fit in 64 bits
+// are kept aside, in the wide weights of the graph, and the edge has their
+// index there instead.
+class GraphEdge {
 public:
   enum EdgeType { NONE, MAY, MUST, BYTE, INDEX };
 
-  GraphEdge();
-  GraphEdge(GraphNode *From, GraphNode *To, EdgeType ETy, APInt Weight);
-
-  void print(raw_ostream &OS);
+  GraphEdge()
+    : To(0), ETy(NONE), Wide(false), Weight(0) { }
+  GraphEdge(unsigned To, EdgeType ETy, int64_t Weight, bool Wide = false)
+    : To(To), ETy(ETy), Wide(Wide), Weight(Weight) { }
 
-  GraphNode *getToEdge() {
+  unsigned getToEdge() const {
     return To;
   }
 
-  APInt getWeight() {
-    return Weight;
+  EdgeType getEdgeType() const {
+    return (EdgeType)ETy;
   }
 
   void setEdgeType(EdgeType ET) {
     ETy = ET;
   }
 
+  bool isWide() const {
+    return Wide;
+  }
+
+  // The weight, or the index of the wide weight.
+  int64_t getRawWeight() const {
+    return Weight;
+  }
+
 private:
-  EdgeType ETy;
-  APInt Weight;
-  GraphNode *From, *To;
+  unsigned To;
+  unsigned ETy : 31;
+  unsigned Wide : 1;
+  int64_t Weight;
 };
 
+// A node of the inequality graph. Its edges are contiguous in the edge array
+// of the graph: the may edges from MayBegin to MustBegin, then the must
+// edges up to End.
 class GraphNode {
 public:
-  typedef iplist<GraphEdge>::iterator may_iterator; 
-  typedef iplist<GraphEdge>::iterator must_iterator; 
-
-  may_iterator may_begin() { return MayEdges.begin(); } 
-  may_iterator may_end() { return MayEdges.end(); } 
+  GraphNode(Value *V)
+    : V(V), MayBegin(0), MustBegin(0), End(0) { }
 
-  must_iterator must_begin() { return MustEdges.begin(); } 
-  must_iterator must_end() { return MustEdges.end(); } 
-
-  Value *getValue() { return V; }
-
-  GraphNode(Value *V) : V(V) { }
-
-  /* void getReachableNodes(SetVector<GraphNode*> &Mark);
-  void intersect(SetVector<GraphNode*> &Mark, SetVector<GraphNode*> &Other);
-  void removeMustEdges(); */
-  //APInt findShortestPath(GraphNode *Dest);
-  APInt findShortestPath(GraphNode *Dest, SetVector<GraphNode*> Visited = SetVector<GraphNode*>());
-
-  void addMayEdgeTo(GraphNode *To, APInt Weight) {
-    GraphEdge *Edge = new GraphEdge(this, To, GraphEdge::MAY, Weight);
-    MayEdges.push_back(Edge);
-  }
-
-  void addMustEdgeTo(GraphNode *To, APInt Weight) {
-    GraphEdge *Edge = new GraphEdge(this, To, GraphEdge::MUST, Weight);
-    MustEdges.push_back(Edge);
-  }
-
-  void print(raw_ostream &OS) {
-    for (may_iterator MI = may_begin(), ME = may_end(); MI != ME; ++MI)
-      MI->print(OS);
-
-    for (must_iterator MI = must_begin(), ME = must_end(); MI != ME; ++MI)
-      MI->print(OS);
-  }
+  Value *getValue() const { return V; }
 
 private:
+  friend class IneqGraph;
+
   Value *V;
-  iplist<GraphEdge> MayEdges;
-  iplist<GraphEdge> MustEdges;
+  unsigned MayBegin, MustBegin, End;
 };
 
 class IneqGraph : public ModulePass {
 public:
-  typedef DenseMap<Value*, GraphNode*> NodeMapTy;
+  typedef DenseMap<Value*, unsigned> NodeMapTy;
+  typedef const GraphEdge *edge_iterator;
 
   static char ID;
   IneqGraph()
-    : ModulePass(ID) { }
+    : ModulePass(ID), PathLength(0) { }
 
   NodeMapTy::iterator begin() { return NodeMap.begin(); }
   NodeMapTy::iterator end() { return NodeMap.end(); }
 
+  // Nodes are numbered densely, in the order they were created.
+  unsigned getNumNodes() const { return Nodes.size(); }
+  const GraphNode &getNode(unsigned N) const { return Nodes[N]; }
+
+  edge_iterator may_begin(unsigned N) {
+    compact();
+    return getEdges() + Nodes[N].MayBegin;
+  }
+  edge_iterator may_end(unsigned N) {
+    compact();
+    return getEdges() + Nodes[N].MustBegin;
+  }
+
+  edge_iterator must_begin(unsigned N) {
+    compact();
+    return getEdges() + Nodes[N].MustBegin;
+  }
+  edge_iterator must_end(unsigned N) {
+    compact();
+    return getEdges() + Nodes[N].End;
+  }
+
+  APInt getWeight(const GraphEdge &E) const {
+    if (E.isWide())
+      return WideWeights[E.getRawWeight()];
+    return APInt(64, E.getRawWeight(), true);
+  }
+
   APInt getUpper(Value *V) {
     if (ConstantInt *CI = dyn_cast<ConstantInt>(V))
       return CI->getValue();
@@ -146,9 +159,27 @@ public:
 
   void dumpToFile(const char *File, Module &M);
 
+  // Forgets the memoized distances; the edges changed.
+  void clearDistances() {
+    Distances.clear();
+    DistancesAt.clear();
+  }
+
 private:
-  GraphNode *getOrCreateNode(Value *V);
-  GraphNode *getNode(Value *V);
+  unsigned getOrCreateNode(Value *V);
+  unsigned getNode(Value *V);
+
+  void addEdge(unsigned From, const GraphEdge &Edge);
+  GraphEdge makeEdge(unsigned To, GraphEdge::EdgeType ETy, APInt Weight);
+  void compact();
+
+  const GraphEdge *getEdges() const {
+    return Edges.empty() ? NULL : &Edges[0];
+  }
+
+  int64_t getWeight64(const GraphEdge &E) const;
+  int64_t findShortestPath(unsigned N, unsigned Dest, unsigned &LowLink);
+  void printEdge(raw_ostream &OS, unsigned From, const GraphEdge &E) const;
 
   void addEdgesFor(Instruction *I);
 
@@ -157,7 +188,7 @@ private:
   virtual bool runOnModule(Module &M);
 
   ConstantInt *AlfaConst;
-  GraphNode *AlfaNode;
+  unsigned AlfaNode;
 
   LLVMContext *C;
 
@@ -166,6 +197,24 @@ private:
 
   // Maps a value to it's node in the graph.
   NodeMapTy NodeMap;
+
+  std::vector<GraphNode> Nodes;
+  std::vector<GraphEdge> Edges;
+  std::vector<APInt> WideWeights;
+
+  // The edges added since the last compaction, with their source node.
+  std::vector<std::pair<unsigned, GraphEdge> > PendingEdges;
+
+  // The depth of the nodes on the path of the current search, ~0U for the
+  // others.
+  std::vector<unsigned> PathDepth;
+  unsigned PathLength;
+
+  // The distances found by the queries: from node to node, and from value to
+  // value at a block.
+  DenseMap<std::pair<unsigned, unsigned>, int64_t> Distances;
+  DenseMap<std::pair<std::pair<Value*, Value*>, BasicBlock*>, APInt>
+    DistancesAt;
 };
 
 }
@@ -0,0 +1,244 @@
+#define DEBUG_TYPE "ra-narrow"
+
+#include "IntegerNarrowing.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+STATISTIC(NumNarrowed, "Number of integer operations narrowed");
+STATISTIC(NumNarrowedCmps, "Number of integer comparisons narrowed");
+STATISTIC(NumCasts, "Number of casts inserted at the boundaries");
+STATISTIC(NumBitsSaved, "Number of bits removed from the narrowed operations");
+
+// The widths tried when the module has no data layout
+static const unsigned DefaultWidths[] = { 8, 16, 32 };
+
+void IntegerNarrowing::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<InterProceduralRACousot>();
+}
+
+// The bits that the values of V take as signed integers, or ~0U if the
+// range analysis doesn't bound them.
+unsigned IntegerNarrowing::getSignedBits(const Value *V) {
+  if (const ConstantInt *CI = dyn_cast<ConstantInt>(V))
+    return CI->getValue().getMinSignedBits();
+
+  Range R = RA->getRange(V);
+  if (!R.isRegular())
+    return ~0U;
+  APInt L = R.getLower(), U = R.getUpper();
+  if (L.eq(RA->getMin()) || U.eq(RA->getMax()))
+    return ~0U;
+  return std::max(L.getMinSignedBits(), U.getMinSignedBits());
+}
+
+// The bits that the values of V take as unsigned integers, or ~0U if V may
+// be negative or is unbounded.
+unsigned IntegerNarrowing::getUnsignedBits(const Value *V) {
+  if (const ConstantInt *CI = dyn_cast<ConstantInt>(V))
+    return CI->getValue().isNegative() ? ~0U : CI->getValue().getActiveBits();
+
+  Range R = RA->getRange(V);
+  if (!R.isRegular())
+    return ~0U;
+  APInt L = R.getLower(), U = R.getUpper();
+  if (L.isNegative() || U.eq(RA->getMax()))
+    return ~0U;
+  return std::max(U.getActiveBits(), 1U);
+}
+
+// The narrowest legal width that holds Bits, or 0 if none is narrower than
+// Original.
+unsigned IntegerNarrowing::getLegalWidth(unsigned Bits, unsigned Original) const {
+  for (unsigned i = 0; i < Widths.size(); ++i)
+    if (Widths[i] >= Bits)
+      return Widths[i] < Original ? Widths[i] : 0;
+  return 0;
+}
+
+bool IntegerNarrowing::planInstruction(Instruction *I, Plan &P) {
+  P.I = I;
+
+  if (ICmpInst *Cmp = dyn_cast<ICmpInst>(I)) {
+    IntegerType *Ty = dyn_cast<IntegerType>(Cmp->getOperand(0)->getType());
+    if (!Ty)
+      return false;
+    unsigned Original = Ty->getBitWidth();
+
+    // Sign extension keeps both the signed and the unsigned order, zero
+    // extension only the unsigned one
+    unsigned Bits = std::max(getSignedBits(Cmp->getOperand(0)),
+                             getSignedBits(Cmp->getOperand(1)));
+    if ((P.Width = getLegalWidth(Bits, Original))) {
+      P.Signed = true;
+      return true;
+    }
+    if (Cmp->isSigned() && !Cmp->isEquality())
+      return false;
+    Bits = std::max(getUnsignedBits(Cmp->getOperand(0)),
+                    getUnsignedBits(Cmp->getOperand(1)));
+    P.Signed = false;
+    return (P.Width = getLegalWidth(Bits, Original));
+  }
+
+  IntegerType *Ty = dyn_cast<IntegerType>(I->getType());
+  if (!Ty)
+    return false;
+
+  switch (I->getOpcode()) {
+  case Instruction::Add:
+  case Instruction::Sub:
+  case Instruction::Mul:
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+  case Instruction::Shl:
+    break;
+  default:
+    return false;
+  }
+
+  unsigned Original = Ty->getBitWidth();
+  unsigned SignedWidth = getLegalWidth(getSignedBits(I), Original);
+  unsigned UnsignedWidth = getLegalWidth(getUnsignedBits(I), Original);
+  if (!SignedWidth && !UnsignedWidth)
+    return false;
+
+  P.Signed = SignedWidth && (!UnsignedWidth || SignedWidth <= UnsignedWidth);
+  P.Width = P.Signed ? SignedWidth : UnsignedWidth;
+
+  // A shift by the narrow width or more drops bits that the original kept
+  if (I->getOpcode() == Instruction::Shl &&
+      getUnsignedBits(I->getOperand(1)) >= Log2_32(P.Width) + 1)
+    return false;
+  return true;
+}
+
+// V as an integer of Width bits, for an instruction before InsertBefore.
+Value *IntegerNarrowing::getNarrowOperand(Value *V, unsigned Width,
+                                          Instruction *InsertBefore) {
+  IntegerType *Ty = IntegerType::get(V->getContext(), Width);
+
+  if (ConstantInt *CI = dyn_cast<ConstantInt>(V))
+    return ConstantInt::get(Ty, CI->getValue().trunc(Width));
+
+  DenseMap<Value*, std::pair<Value*, bool> >::iterator It = Narrowed.find(V);
+  if (It != Narrowed.end()) {
+    Value *NV = It->second.first;
+    unsigned NarrowWidth = NV->getType()->getIntegerBitWidth();
+    if (NarrowWidth == Width)
+      return NV;
+    ++NumCasts;
+    if (NarrowWidth > Width)
+      return new TruncInst(NV, Ty, NV->getName(), InsertBefore);
+    if (It->second.second)
+      return new SExtInst(NV, Ty, NV->getName(), InsertBefore);
+    return new ZExtInst(NV, Ty, NV->getName(), InsertBefore);
+  }
+
+  ++NumCasts;
+  return new TruncInst(V, Ty, V->getName() + ".trunc", InsertBefore);
+}
+
+void IntegerNarrowing::narrow(const Plan &P) {
+  Instruction *I = P.I;
+  Value *LHS = getNarrowOperand(I->getOperand(0), P.Width, I);
+  Value *RHS = getNarrowOperand(I->getOperand(1), P.Width, I);
+
+  DEBUG(dbgs() << "ra-narrow: " << *I << " to i" << P.Width << "\n");
+
+  if (ICmpInst *Cmp = dyn_cast<ICmpInst>(I)) {
+    ICmpInst *NewCmp = new ICmpInst(I, Cmp->getPredicate(), LHS, RHS);
+    NewCmp->takeName(I);
+    I->replaceAllUsesWith(NewCmp);
+    I->eraseFromParent();
+    ++NumNarrowedCmps;
+    return;
+  }
+
+  BinaryOperator *NewOp = BinaryOperator::Create(
+      (Instruction::BinaryOps)I->getOpcode(), LHS, RHS,
+      I->getName() + ".narrow", I);
+  Instruction *Ext;
+  if (P.Signed)
+    Ext = new SExtInst(NewOp, I->getType(), "", I);
+  else
+    Ext = new ZExtInst(NewOp, I->getType(), "", I);
+  Ext->takeName(I);
+  I->replaceAllUsesWith(Ext);
+  I->eraseFromParent();
+
+  Narrowed[Ext] = std::make_pair(NewOp, P.Signed);
+  ++NumNarrowed;
+  NumBitsSaved += Ext->getType()->getIntegerBitWidth() - P.Width;
+}
+
+bool IntegerNarrowing::runOnModule(Module &M) {
+  RA = &getAnalysis<InterProceduralRACousot>();
+
+  Widths.clear();
+  if (DataLayout *DL = getAnalysisIfAvailable<DataLayout>()) {
+    for (unsigned W = 8; W <= 64; W *= 2)
+      if (DL->isLegalInteger(W))
+        Widths.push_back(W);
+  } else {
+    Widths.append(DefaultWidths, DefaultWidths + array_lengthof(DefaultWidths));
+  }
+
+  // With -ra-demand, find the ranges of the candidates and of their
+  // operands in one go
+  SmallVector<const Value*, 64> Queries;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+        if (isa<BinaryOperator>(I) || isa<ICmpInst>(I)) {
+          Queries.push_back(I);
+          for (unsigned i = 0; i < 2; ++i)
+            if (!isa<Constant>(I->getOperand(i)))
+              Queries.push_back(I->getOperand(i));
+        }
+  RA->computeRanges(Queries);
+
+  // All the plans are made before the first change, while the ranges
+  // still describe the module
+  SmallVector<Plan, 64> Plans;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+    if (F->isDeclaration())
+      continue;
+
+    // Definitions before their uses, but for the phis
+    ReversePostOrderTraversal<Function*> RPOT(F);
+    for (ReversePostOrderTraversal<Function*>::rpo_iterator BB = RPOT.begin(),
+         BE = RPOT.end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = (*BB)->begin(), IE = (*BB)->end();
+           I != IE; ++I) {
+        Plan P;
+        if (planInstruction(I, P))
+          Plans.push_back(P);
+      }
+  }
+
+  Narrowed.clear();
+  for (unsigned i = 0; i < Plans.size(); ++i)
+    narrow(Plans[i]);
+
+  // The extensions whose users were all narrowed
+  for (DenseMap<Value*, std::pair<Value*, bool> >::iterator
+       It = Narrowed.begin(), E = Narrowed.end(); It != E; ++It)
+    if (It->first->use_empty())
+      cast<Instruction>(It->first)->eraseFromParent();
+  Narrowed.clear();
+
+  return !Plans.empty();
+}
+
+char IntegerNarrowing::ID = 0;
+static RegisterPass<IntegerNarrowing> X("ra-narrow",
+    "Narrow the integer operations bounded by the range analysis");
@@ -0,0 +1,61 @@
+#ifndef LLVM_TRANSFORMS_INTEGERNARROWING_INTEGERNARROWING_H_
+#define LLVM_TRANSFORMS_INTEGERNARROWING_INTEGERNARROWING_H_
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "RangeAnalysis.h"
+
+namespace llvm {
+
+// Rewrites the integer operations whose values the inter-procedural range
+// analysis bounds in a narrower legal type: the operation is done on the
+// operands truncated to that type and its result is extended back, with
+// sext or zext, for the users that remain wide. The narrowed operations
+// take the narrow values of each other directly, so only the boundaries of
+// a narrowed chain get casts.
+//
+// Additions, subtractions, multiplications, the bitwise operations and the
+// left shifts by less than the narrow width only need the result to fit:
+// the low bits of their results only depend on the low bits of their
+// operands. Comparisons need both operands to fit. The ranges are trusted
+// as they are: like the bit counts of the range analysis, they assume the
+// operations of the original width don't wrap around.
+class IntegerNarrowing : public ModulePass {
+public:
+  static char ID;
+  IntegerNarrowing() : ModulePass(ID), RA(0) { }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const;
+  bool runOnModule(Module &M);
+
+private:
+  // How an instruction is narrowed: its width, and whether its narrow
+  // value is sign extended to get the original one
+  struct Plan {
+    Instruction *I;
+    unsigned Width;
+    bool Signed;
+  };
+
+  InterProceduralRACousot *RA;
+  // The legal integer widths, from the narrowest
+  SmallVector<unsigned, 4> Widths;
+
+  // The narrow value of each narrowed instruction
+  DenseMap<Value*, std::pair<Value*, bool> > Narrowed;
+
+  unsigned getSignedBits(const Value *V);
+  unsigned getUnsignedBits(const Value *V);
+  unsigned getLegalWidth(unsigned Bits, unsigned Original) const;
+  bool planInstruction(Instruction *I, Plan &P);
+  Value *getNarrowOperand(Value *V, unsigned Width, Instruction *InsertBefore);
+  void narrow(const Plan &P);
+};
+
+}
+
+#endif /* LLVM_TRANSFORMS_INTEGERNARROWING_INTEGERNARROWING_H_ */
@@ -1,10 +1,11 @@
 #define DEBUG_TYPE "pssi"
 
 #include "llvm/ADT/Statistic.h"
-#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Scalar.h"
@@ -20,6 +21,15 @@ using std::set;
 StringRef OmegaPrefix = "omega_node";
 StringRef PhiPrefix = "phi_node";
 
+static cl::opt<bool> ClPruned("pssi-pruned",
+  cl::desc("Only create the omega nodes of pointers indexed by a GEP after "
+           "the call, and split a run of adjacent calls only once"),
+  cl::init(false));
+
+STATISTIC(NumOmegas, "Number of omega nodes");
+STATISTIC(NumPrunedOmegas, "Number of omega nodes not created by -pssi-pruned");
+STATISTIC(NumSplitsAvoided, "Number of block splits avoided by -pssi-pruned");
+
 void PointerSSI::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<AliasSets>();
   AU.addRequired<DominatorTree>();
@@ -37,9 +47,12 @@ bool PointerSSI::runOnModule(Module &M) {
       // These have to be after the block-splitting part.
       DT = &getAnalysis<DominatorTree>(*F);
       DF = &getAnalysis<DominanceFrontier>(*F);
+      DomTreeOrder FunctionOrder(*DT);
+      Order = &FunctionOrder;
 
       // Create sigmas nodes for pointer function arguments and its aliases.
       createSigmasInFunction(&(*F));
+      Order = NULL;
     }
   }
   return true;
@@ -48,30 +61,111 @@ bool PointerSSI::runOnModule(Module &M) {
 // splitCallsInFunction
 // Modifies the CFG so that every function call with at least one pointer
 // argument is at the beginning of a basic block.
+//
+// With -pssi-pruned, calls with no pointer argument that needs an omega node
+// are not split, and a call right after a split one stays in its block: the
+// omega nodes at the beginning of the block are shared by the whole run.
 void PointerSSI::splitCallsInFunction(Function *F) {
-  for (Function::iterator BB = F->begin(); BB != F->end(); ++BB)
-    for (BasicBlock::iterator I = BB->begin(); I != BB->end(); ++I)
-      if (CallInst *CI = dyn_cast<CallInst>(&(*I)))
-        if (isPointerFnCall(CI)) {
-          // Split the block at the CallInst.
-          SplitBlock(BB, CI, this);
-          // Resume iterating from the created block.
-          ++BB;
+  for (Function::iterator BB = F->begin(); BB != F->end(); ++BB) {
+    // The last instruction is the head of a run of calls at BB's beginning.
+    bool InRun = false;
+    for (BasicBlock::iterator I = BB->begin(); I != BB->end(); ++I) {
+      CallInst *CI = dyn_cast<CallInst>(&(*I));
+      if (!CI || !isPointerFnCall(CI)) {
+        InRun = false;
+        continue;
+      }
+      if (ClPruned) {
+        if (!needsOmegaNodes(CI) || InRun) {
+          ++NumSplitsAvoided;
+          continue;
         }
+        InRun = true;
+        // The call already is at the beginning of a block with a single
+        // predecessor, where the omega nodes can go.
+        if (&(*I) == BB->getFirstNonPHI() && BB->getSinglePredecessor()) {
+          ++NumSplitsAvoided;
+          continue;
+        }
+      }
+      // Split the block at the CallInst.
+      SplitBlock(BB, CI, this);
+      // Resume iterating from the created block.
+      ++BB;
+    }
+  }
+}
+
+// needsOmegaNodes
+// Returns true if a pointer argument of CI needs an omega node.
+bool PointerSSI::needsOmegaNodes(CallInst *CI) {
+  for (unsigned Idx = 0; Idx < CI->getNumArgOperands(); ++Idx) {
+    Value *Operand = CI->getArgOperand(Idx);
+    if (Operand->getType()->isPointerTy() && !isa<Constant>(Operand) &&
+        hasBoundsQuery(Operand, NULL))
+      return true;
+  }
+  return false;
+}
+
+// hasBoundsQuery
+// Returns true if V, or a cast of it, is the pointer of a GEP in a block
+// dominated by BB, or flows into a phi node and so may reach one. A NULL BB
+// accepts every GEP.
+bool PointerSSI::hasBoundsQuery(Value *V, BasicBlock *BB) {
+  SmallVector<Value*, 8> Worklist;
+  SmallPtrSet<Value*, 8> Visited;
+  Worklist.push_back(V);
+  while (!Worklist.empty()) {
+    Value *W = Worklist.pop_back_val();
+    if (!Visited.insert(W))
+      continue;
+    for (Value::use_iterator UI = W->use_begin(), UE = W->use_end();
+         UI != UE; ++UI) {
+      if (isa<PHINode>(*UI))
+        return true;
+      if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(*UI)) {
+        if (GEP->getPointerOperand() == W &&
+            (!BB || Order->dominates(BB, GEP->getParent())))
+          return true;
+      } else if (isa<CastInst>(*UI)) {
+        Worklist.push_back(*UI);
+      }
+    }
+  }
+  return false;
 }
 
 // createSigmasInFunction
 // Create omega nodes at call sites in the given function.
+//
+// With -pssi-pruned, the run of pointer calls at the beginning of a block
+// shares its omega nodes, and the pointers with no bounds query after the
+// block get none.
 void PointerSSI::createSigmasInFunction(Function *F) {
-  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
-    if (CallInst *CI = dyn_cast<CallInst>(BB->getFirstNonPHI()))
-      if (isPointerFnCall(CI))
-        for (unsigned Idx = 0; Idx < CI->getNumArgOperands(); ++Idx) {
-          Value *Operand = CI->getArgOperand(Idx);
-          Type *OperandType = Operand->getType();
-          if (OperandType->isPointerTy() && !isa<Constant>(Operand))
-            createOmegaNodeAt(Operand, CI->getParent(), CI);
+  for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+    // Omega nodes have the single predecessor of their block as incoming.
+    if (!BB->getSinglePredecessor())
+      continue;
+    for (BasicBlock::iterator I = BB->getFirstNonPHI(); I != BB->end(); ++I) {
+      CallInst *CI = dyn_cast<CallInst>(&(*I));
+      if (!CI || !isPointerFnCall(CI))
+        break;
+      for (unsigned Idx = 0; Idx < CI->getNumArgOperands(); ++Idx) {
+        Value *Operand = CI->getArgOperand(Idx);
+        Type *OperandType = Operand->getType();
+        if (!OperandType->isPointerTy() || isa<Constant>(Operand))
+          continue;
+        if (ClPruned && !hasBoundsQuery(Operand, BB)) {
+          ++NumPrunedOmegas;
+          continue;
         }
+        createOmegaNodeAt(Operand, CI->getParent(), CI);
+      }
+      if (!ClPruned)
+        break;
+    }
+  }
 }
 
 // isPointerFnCall
@@ -108,6 +202,7 @@ void PointerSSI::createOmegaNodeAt(Value *V, BasicBlock *BB, CallInst *CI,
   PHINode *Omega = PHINode::Create(V->getType(), 1, OmegaPrefix, BB->begin());
   Omega->addIncoming(V, BB->getSinglePredecessor());
   (*OmegaMap[V])[BB] = Omega;
+  ++NumOmegas;
   DEBUG(dbgs() << "PointerSSI: createOmegaNodeAt: Created: " << *Omega << "\n");
 
   // Replace the argument V of the call with Omega, to avoid it being replaces
@@ -156,10 +251,9 @@ void PointerSSI::createOmegaNodeAt(Value *V, BasicBlock *BB, CallInst *CI,
   if (AS->getValueSetKey(V) == 0)
     return;
 
-  DenseMap<int, set<Value*> > Values = AS->getValueSets();
-  set<Value*> Aliases = Values[AS->getValueSetKey(V)];
+  const set<Value*> &Aliases = AS->getValueSet(AS->getValueSetKey(V));
 
-  for (set<Value*>::iterator VI = Aliases.begin(), VE = Aliases.end();
+  for (set<Value*>::const_iterator VI = Aliases.begin(), VE = Aliases.end();
        VI != VE; ++VI)
     if (*VI != V)
       // If the alias is an instruction and it's defined at the call site,
@@ -213,16 +307,15 @@ PHINode *PointerSSI::createPhiNodeAt(Value *V, BasicBlock *BB) {
 // dominatesUse
 // Returns true if BB dominates a use of V.
 bool PointerSSI::dominatesUse(Value *V, BasicBlock *BB) {
-  for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
-       UI != UE; ++UI)
+  DomTreeOrder::UsersTy Users;
+  Order->getSortedUsers(V, Users);
+  std::pair<DomTreeOrder::user_iterator, DomTreeOrder::user_iterator>
+    Dominated = Order->getDominatedUsers(Users, BB);
+  for (DomTreeOrder::user_iterator UI = Dominated.first; UI != Dominated.second;
+       ++UI)
     // A PHINode* can dominate it's operands, so they have to be disregarded.
-    if (isa<PHINode>(*UI) || V == *UI) {
-      continue;
-    } else if (Instruction *I = dyn_cast<Instruction>(*UI)) {
-      // Return true if BB dominates the use.
-      if (DT->dominates(BB, I->getParent()))
-        return true;
-    }
+    if (!isa<PHINode>(*UI) && V != *UI)
+      return true;
   return false;
 }
 
@@ -230,27 +323,25 @@ bool PointerSSI::dominatesUse(Value *V, BasicBlock *BB) {
 void PointerSSI::replaceUsesOfWithAfter(Value *V, Value *R, BasicBlock *BB) {
   DEBUG(dbgs() << "PointerSSI: replaceUsesOfWithAfter: " << *V << " ==> "
                << *R << " after " << BB->getName() << "\n");
-  SetVector<Instruction*> Replace;
-  for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
-       UI != UE; ++UI)
-    if (Instruction *I = dyn_cast<Instruction>(*UI)) {
-      // If the instruction's parent dominates BB, mark the instruction to
-      // be replaced.
-      if (I != R && DT->dominates(BB, I->getParent()))
-        Replace.insert(I);
-      // If parent does not dominate BB, check if the use is a phi and replace
-      // the incoming value.
-      else if (PHINode *Phi = dyn_cast<PHINode>(*UI))
-        for (unsigned Idx = 0; Idx < Phi->getNumIncomingValues(); ++Idx)
-          if (Phi->getIncomingValue(Idx) == V &&
-              DT->dominates(BB, Phi->getIncomingBlock(Idx)))
-            Phi->setIncomingValue(Idx, R);
-    }
-
-  // Replace V with R on all marked instructions.
-  for (SetVector<Instruction*>::iterator I = Replace.begin(),
-       IE = Replace.end(); I != IE; ++I)
-    (*I)->replaceUsesOfWith(V, R);
+  // The users are unique and sorted, so the ones BB dominates are a range,
+  // and the instructions can be replaced while walking them.
+  DomTreeOrder::UsersTy Users;
+  Order->getSortedUsers(V, Users);
+  std::pair<DomTreeOrder::user_iterator, DomTreeOrder::user_iterator>
+    Dominated = Order->getDominatedUsers(Users, BB);
+  for (DomTreeOrder::user_iterator UI = Users.begin(), UE = Users.end();
+       UI != UE; ++UI) {
+    Instruction *I = *UI;
+    // If BB dominates the instruction's parent, replace V with R on it.
+    if (UI >= Dominated.first && UI < Dominated.second && I != R)
+      I->replaceUsesOfWith(V, R);
+    // Otherwise, check if the use is a phi and replace the incoming value.
+    else if (PHINode *Phi = dyn_cast<PHINode>(I))
+      for (unsigned Idx = 0; Idx < Phi->getNumIncomingValues(); ++Idx)
+        if (Phi->getIncomingValue(Idx) == V &&
+            Order->dominates(BB, Phi->getIncomingBlock(Idx)))
+          Phi->setIncomingValue(Idx, R);
+  }
 }
 
 char PointerSSI::ID = 0;
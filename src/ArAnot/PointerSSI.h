@@ -9,7 +9,8 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Value.h"
 
-#include "AliasSets.h"
+#include "../AliasSets/AliasSets.h"
+#include "DomTreeOrder.h"
 
 namespace llvm {
 
@@ -23,6 +24,8 @@ class PointerSSI : public ModulePass {
 
     DominatorTree *DT;
     DominanceFrontier *DF;
+    // DFS numbers of DT, to find the uses a block dominates.
+    DomTreeOrder *Order;
     AliasSets *AS;
 
     // Maps a (BasicBlock*, Value*) to a PHINode*.
@@ -43,13 +46,15 @@ class PointerSSI : public ModulePass {
 
   public:
     static char ID;
-    PointerSSI() : ModulePass(ID) { }
+    PointerSSI() : ModulePass(ID), Order(NULL) { }
 
     virtual void getAnalysisUsage(AnalysisUsage &AU) const;
     virtual bool runOnModule(Module &M);
 
   private:
     bool isPointerFnCall(CallInst *CI);
+    bool needsOmegaNodes(CallInst *CI);
+    bool hasBoundsQuery(Value *V, BasicBlock *BB);
     bool dominatesUse(Value *V, BasicBlock *BB);
     void replaceUsesOfWithAfter(Value *V, Value *R, BasicBlock *BB);
 
@@ -11,10 +11,65 @@
 #define DEBUG_TYPE "range-analysis"
 
 #include "RangeAnalysis.h"
+#include "../PassProfile/ModuleMetrics.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/InstIterator.h"
+#include "llvm/Support/CommandLine.h"
+#include <pthread.h>
+#include <string.h>
+#include <fstream>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 using namespace llvm;
 
+static cl::opt<unsigned> raThreads("ra-threads",
+		cl::desc("Threads solving independent SCCs of the constraint graph (1)"),
+		cl::init(1));
+
+static cl::opt<bool, false> raDemand("ra-demand",
+		cl::desc("Compute the ranges of ra-inter-* only for the values queried"),
+		cl::NotHidden);
+
+static cl::opt<bool, false> raGlobalJumpSet("ra-global-jumpset",
+		cl::desc("Let the widening of every SCC jump to any constant of the graph"),
+		cl::NotHidden);
+
+static cl::opt<unsigned> raAdaptiveMinSize("ra-adaptive-min-size",
+		cl::desc("Smallest SCC that ra-*-adaptive may solve with CropDFS (16)"),
+		cl::init(16));
+
+static cl::opt<unsigned> raWideningCap("ra-widening-cap",
+		cl::desc("Widening iterations per variable of ra-*-adaptive before "
+			"it stops jumping to constants, 0 is no cap (8)"),
+		cl::init(8));
+
+static cl::opt<bool, false> raBatchEval("ra-batch-eval",
+		cl::desc("Evaluate the additions and subtractions of each SCC together, "
+			"in rounds over the whole SCC"),
+		cl::NotHidden);
+
+static cl::opt<std::string> raSummaryOut("ra-summary-out",
+		cl::desc("Write the return ranges of the functions of ra-inter-* that "
+			"other modules may call to this file"),
+		cl::value_desc("filename"));
+
+static cl::list<std::string> raSummaryIn("ra-summary-in",
+		cl::desc("Take the return ranges of the functions in this file of "
+			"ra-summary-out instead of their constraints"),
+		cl::value_desc("filename"));
+
+static cl::opt<std::string> raProfileJSON("ra-profile-json",
+		cl::desc("Write the profile of a STATS build in JSON to this file"),
+		cl::value_desc("filename"));
+
+static cl::opt<bool, false> raProfileCounters("ra-profile-counters",
+		cl::desc("Sample the hardware counters in the profile of a STATS build"),
+		cl::NotHidden);
+
 // These macros are used to get stats regarding the precision of our analysis.
 STATISTIC(usedBits, "Initial number of bits.");
 STATISTIC(needBits, "Needed bits.");
@@ -34,34 +89,110 @@ STATISTIC(numZeroUses, "Number of variables without any use.");
 STATISTIC(numNotInt, "Number of variables that are not Integer.");
 STATISTIC(numOps, "Number of operations");
 STATISTIC(maxVisit, "Max number of times a value has been visited.");
+STATISTIC(numCousotSCCs, "Number of SCCs solved with Cousot's widening by ra-*-adaptive.");
+STATISTIC(numCropDFSSCCs, "Number of SCCs solved with CropDFS by ra-*-adaptive.");
+STATISTIC(numCappedWidenings, "Number of widenings that reached ra-widening-cap.");
+
+// ========================================================================== //
+// RangeContext
+// ========================================================================== //
+
+// The context of the analysis running on this thread
+static __thread RangeContext *currentContext = NULL;
+
+RangeContext::~RangeContext() {
+	closeTransactionLog();
+}
+
+void RangeContext::setBitWidth(unsigned width) {
+	bitWidth = width;
+	min = APInt::getSignedMinValue(width);
+	max = APInt::getSignedMaxValue(width);
+	zero = APInt(width, 0, true);
+}
+
+RangeContext &RangeContext::current() {
+	if (currentContext) {
+		return *currentContext;
+	}
+	static RangeContext none;
+	return none;
+}
+
+void RangeContext::install(RangeContext &context) {
+	currentContext = &context;
+}
 
-// The number of bits needed to store the largest variable of the function (APInt).
-unsigned MAX_BIT_INT = 1;
+void RangeContext::release(RangeContext &context) {
+	if (currentContext == &context) {
+		currentContext = NULL;
+	}
+}
+
+raw_ostream &RangeContext::transactionLog() {
+	if (!log) {
+		static unsigned numLogs = 0;
+		unsigned n = __sync_fetch_and_add(&numLogs, 1);
+		std::string fileName = "/tmp/ratransactions";
+		if (n) {
+			fileName += "." + utostr(n);
+		}
+		std::string errorInfo;
+		log = new raw_fd_ostream(fileName.c_str(), errorInfo);
+	}
+	return *log;
+}
 
-// This map is used to store the number of times that the narrow_meet 
-// operator is called on a variable. It was a Fernando's suggestion.
-DenseMap<const Value*, unsigned> FerMap;
+void RangeContext::closeTransactionLog() {
+	delete log;
+	log = NULL;
+}
 
+// The values of the analysis running on this thread: the number of bits
+// needed to store the largest variable of the function or module (APInt),
+// and the min and max integer values for that bit width.
+#define MAX_BIT_INT (RangeContext::current().bitWidth)
+#define Min (RangeContext::current().min)
+#define Max (RangeContext::current().max)
+#define Zero (RangeContext::current().zero)
+#define FerMap (RangeContext::current().ferMap)
 
 // ========================================================================== //
 // Static global functions and definitions
 // ========================================================================== //
 
-// The min and max integer values for a given bit width.
-APInt Min = APInt::getSignedMinValue(MAX_BIT_INT);
-APInt Max = APInt::getSignedMaxValue(MAX_BIT_INT);
-APInt Zero(MAX_BIT_INT, 0, true);
-
 // String used to identify sigmas
 const std::string sigmaString = "sigma_node";
 
 // Used to print pseudo-edges in the Constraint Graph dot
-std::string pestring;
-raw_string_ostream pseudoEdgesString(pestring);
 
 #ifdef STATS
 // Used to profile
 Profile prof;
+
+// Iterations of the worklists of the SCC being solved
+static unsigned updateIterations = 0;
+
+static void startProfile() {
+	static bool started = false;
+	if (started) {
+		return;
+	}
+
+	started = true;
+	if (raProfileCounters && !prof.enableCounters()) {
+		errs() << "WARNING: the hardware counters can't be read\n";
+	}
+}
+
+static void finishProfile() {
+	prof.printTimes();
+	prof.printMemoryUsage();
+
+	if (!raProfileJSON.empty() && !prof.writeJSON(raProfileJSON)) {
+		errs() << "ERROR: file " << raProfileJSON << " can't be opened!\n";
+	}
+}
 #endif
 
 // Print name of variable according to its type
@@ -111,6 +242,181 @@ static bool isValidInstruction(const Instruction* I) {
 	return false;
 }
 
+// ========================================================================== //
+// Profile
+// ========================================================================== //
+Profile::~Profile() {
+#ifdef __linux__
+	for (unsigned i = 0; i < NumCounters; ++i) {
+		if (counterFDs[i] >= 0) {
+			close(counterFDs[i]);
+		}
+	}
+#endif
+}
+
+bool Profile::enableCounters() {
+#ifdef __linux__
+	static const uint64_t configs[NumCounters] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS
+	};
+
+	for (unsigned i = 0; i < NumCounters; ++i) {
+		if (counterFDs[i] >= 0) {
+			continue;
+		}
+
+		// Counts this thread in user space, on any cpu
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = configs[i];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		counterFDs[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+		if (counterFDs[i] < 0) {
+			for (unsigned j = 0; j < i; ++j) {
+				close(counterFDs[j]);
+				counterFDs[j] = -1;
+			}
+			return false;
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool Profile::readCounters(uint64_t values[NumCounters]) {
+#ifdef __linux__
+	for (unsigned i = 0; i < NumCounters; ++i) {
+		if (counterFDs[i] < 0 || read(counterFDs[i], &values[i],
+				sizeof(values[i])) != sizeof(values[i])) {
+			return false;
+		}
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Profile::beginPhase(StringRef name) {
+	OpenPhase phase;
+	phase.key = phases.empty() ? name.str() : phases.back().key + "/" + name.str();
+	phase.counted = readCounters(phase.counters);
+	phase.traceStart = PassProfile::get().now();
+	phase.start = timenow();
+	phases.push_back(phase);
+}
+
+void Profile::endPhase() {
+	TimeValue end = timenow();
+	OpenPhase &phase = phases.back();
+	updateTime(phase.key, end - phase.start);
+	PassProfile::get().addTimer(phase.key, "range analysis", phase.traceStart,
+			PassProfile::get().now());
+
+	uint64_t values[NumCounters];
+	if (phase.counted && readCounters(values)) {
+		std::vector<uint64_t> &total = counters[phase.key];
+		total.resize(NumCounters, 0);
+		for (unsigned i = 0; i < NumCounters; ++i) {
+			total[i] += values[i] - phase.counters[i];
+		}
+	}
+
+	setMemoryUsage();
+	phases.pop_back();
+}
+
+/// The bucket of value in the histograms of Profile.
+static unsigned histogramBucket(uint64_t value) {
+	unsigned bucket = 0;
+	while (value >>= 1) {
+		++bucket;
+	}
+	return bucket;
+}
+
+void Profile::addSCC(unsigned size, unsigned iterations) {
+	++numSCCs;
+	sccIterations += iterations;
+	if (iterations > maxSCCIterations) {
+		maxSCCIterations = iterations;
+	}
+
+	unsigned bucket = histogramBucket(iterations);
+	if (bucket >= iterationHistogram.size()) {
+		iterationHistogram.resize(bucket + 1, 0);
+	}
+	++iterationHistogram[bucket];
+
+	bucket = histogramBucket(size);
+	if (bucket >= sizeHistogram.size()) {
+		sizeHistogram.resize(bucket + 1, 0);
+	}
+	++sizeHistogram[bucket];
+}
+
+void Profile::printTimes() {
+	for (unsigned i = 0, e = keys.size(); i < e; ++i) {
+		printTime(keys[i]);
+	}
+}
+
+static void printHistogram(raw_ostream &OS, const char *name,
+		const std::vector<unsigned> &histogram) {
+	OS << "    \"" << name << "\": [";
+	for (unsigned i = 0, e = histogram.size(); i < e; ++i) {
+		uint64_t from = i ? (uint64_t) 1 << i : 0;
+		OS << (i ? ", " : "") << "{\"from\": " << from << ", \"to\": "
+				<< ((uint64_t) 2 << i) - 1 << ", \"count\": " << histogram[i] << "}";
+	}
+	OS << "]";
+}
+
+void Profile::printJSON(raw_ostream &OS) {
+	OS << "{\n  \"phases\": [";
+	for (unsigned i = 0, e = keys.size(); i < e; ++i) {
+		const std::string &key = keys[i];
+		OS << (i ? ",\n" : "\n") << "    {\"name\": \"" << key << "\", \"calls\": "
+				<< calls[key] << ", \"seconds\": " << getTimeDouble(key);
+
+		StringMap<std::vector<uint64_t> >::iterator cit = counters.find(key);
+		if (cit != counters.end()) {
+			OS << ", \"cycles\": " << cit->second[Cycles]
+					<< ", \"instructions\": " << cit->second[Instructions];
+		}
+		OS << "}";
+	}
+	OS << "\n  ],\n";
+
+	OS << "  \"peakMemoryKB\": " << (uint64_t) (memory / 1024) << ",\n";
+	OS << "  \"sccs\": {\n    \"count\": " << numSCCs << ",\n    \"iterations\": "
+			<< sccIterations << ",\n    \"maxIterations\": " << maxSCCIterations
+			<< ",\n";
+	printHistogram(OS, "iterationHistogram", iterationHistogram);
+	OS << ",\n";
+	printHistogram(OS, "sizeHistogram", sizeHistogram);
+	OS << "\n  }\n}\n";
+}
+
+bool Profile::writeJSON(StringRef fileName) {
+	std::string ErrorInfo;
+	raw_fd_ostream file(fileName.str().c_str(), ErrorInfo);
+	if (file.has_error()) {
+		return false;
+	}
+
+	printJSON(file);
+	file.close();
+	return !file.has_error();
+}
+
 // ========================================================================== //
 // RangeAnalysis
 // ========================================================================== //
@@ -140,13 +446,6 @@ unsigned RangeAnalysis::getMaxBitWidth(const Function& F) {
 	return max;
 }
 
-void RangeAnalysis::updateMinMax(unsigned maxBitWidth) {
-	// Updates the Min and Max values.
-	Min = APInt::getSignedMinValue(maxBitWidth);
-	Max = APInt::getSignedMaxValue(maxBitWidth);
-	Zero = APInt(MAX_BIT_INT, 0, true);
-}
-
 //unsigned RangeAnalysis::getBitWidth() {
 //	return MAX_BIT_INT;
 //}
@@ -157,39 +456,39 @@ void RangeAnalysis::updateMinMax(unsigned maxBitWidth) {
 template <class CGT>
 APInt IntraProceduralRA<CGT>::getMin()
 {
-	return Min;
+	return context.min;
 }
 
 template <class CGT>
 APInt IntraProceduralRA<CGT>::getMax()
 {
-	return Max;
+	return context.max;
 }
 
 template <class CGT>
 Range IntraProceduralRA<CGT>::getRange(const Value *v){
+	installContext();
 	return CG->getRange(v);
 }
 
 template<class CGT>
 bool IntraProceduralRA<CGT>::runOnFunction(Function &F) {
+	PassProfileScope scope("IntraProceduralRA", "range analysis");
 //	if(CG) delete CG;
 	CG = new CGT();
 
-	MAX_BIT_INT = getMaxBitWidth(F);
-	updateMinMax(MAX_BIT_INT);
+	context.setBitWidth(getMaxBitWidth(F));
+	installContext();
 
 	// Build the graph and find the intervals of the variables.
 #ifdef STATS
-	Profile::TimeValue before = prof.timenow();
+	startProfile();
+	prof.beginPhase("BuildGraph");
 #endif
 	CG->buildGraph(F);
 	CG->buildVarNodes();
 #ifdef STATS
-	Profile::TimeValue elapsed = prof.timenow() - before;
-	prof.updateTime("BuildGraph", elapsed);
-
-	prof.setMemoryUsage();
+	prof.endPhase();
 #endif
 #ifdef PRINT_DEBUG
 	CG->printToFile(F, "/tmp/" + F.getName() + "cgpre.dot");
@@ -206,11 +505,7 @@ bool IntraProceduralRA<CGT>::runOnFunction(Function &F) {
 template <class CGT>
 IntraProceduralRA<CGT>::~IntraProceduralRA(){
 #ifdef STATS
-	prof.printTime("BuildGraph");
-	prof.printTime("Nuutila");
-	prof.printTime("SCCs resolution");
-	prof.printTime("ComputeStats");
-	prof.printMemoryUsage();
+	finishProfile();
 	
 	std::ostringstream formated;
 	formated << 100 * (1.0 - ((double)(needBits) / usedBits));
@@ -244,21 +539,291 @@ IntraProceduralRA<CGT>::~IntraProceduralRA(){
 template <class CGT>
 APInt InterProceduralRA<CGT>::getMin()
 {
-	return Min;
+	return context.min;
 }
 
 template <class CGT>
 APInt InterProceduralRA<CGT>::getMax()
 {
-	return Max;
+	return context.max;
 }
 
 
 template <class CGT>
 Range InterProceduralRA<CGT>::getRange(const Value *v){
+	installContext();
+	if (raDemand) {
+		SmallVector<const Value*, 1> queries(1, v);
+		computeRanges(queries);
+	}
 	return CG->getRange(v);
 }
 
+template <class CGT>
+void InterProceduralRA<CGT>::print(raw_ostream &OS, const Module *M) const {
+	InterProceduralRA<CGT> *self = const_cast<InterProceduralRA<CGT>*>(this);
+	for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F) {
+		for (Function::const_arg_iterator A = F->arg_begin(), AE = F->arg_end();
+				A != AE; ++A) {
+			if (!A->hasName() || !A->getType()->isIntegerTy())
+				continue;
+			OS << F->getName() << ":%" << A->getName() << " = ";
+			self->getRange(A).print(OS);
+			OS << "\n";
+		}
+		for (const_inst_iterator I = inst_begin(*F), IE = inst_end(*F); I != IE;
+				++I) {
+			if (!I->hasName() || !I->getType()->isIntegerTy())
+				continue;
+			OS << F->getName() << ":%" << I->getName() << " = ";
+			self->getRange(&*I).print(OS);
+			OS << "\n";
+		}
+	}
+}
+
+template <class CGT>
+void InterProceduralRA<CGT>::computeRanges(
+		const SmallVectorImpl<const Value*> &values) {
+	if (!raDemand) {
+		return;
+	}
+
+	installContext();
+	CG->findIntervals(values);
+}
+
+template <class CGT>
+void InterProceduralRA<CGT>::updateFunctions(Module &M,
+		const SmallVectorImpl<Function*> &changed) {
+	if (!CG) {
+		return;
+	}
+
+	// Every range has the width of the widest integer of the module; if
+	// the changes made it wider, start over
+	if (getMaxBitWidth(M) > context.bitWidth) {
+		delete CG;
+		runOnModule(M);
+		return;
+	}
+	installContext();
+
+	SmallPtrSet<const Function*, 8> changedSet;
+	for (unsigned i = 0, e = changed.size(); i < e; ++i) {
+		changedSet.insert(changed[i]);
+	}
+
+	// Functions, changed or not, whose parameters the changed ones pass
+	SmallPtrSet<const Function*, 8> rematch;
+	CG->removeFunctions(changedSet, rematch);
+
+	for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+		if (!changedSet.count(&*I) || I->isDeclaration() || I->isVarArg()
+				|| summaries.count(I->getName()))
+			continue;
+
+		CG->buildGraph(*I);
+
+		for (inst_iterator ii = inst_begin(*I), ie = inst_end(*I); ii != ie;
+				++ii) {
+			if (!isa<CallInst>(&*ii) && !isa<InvokeInst>(&*ii))
+				continue;
+
+			CallSite CS(&*ii);
+			const Function *callee = CS.getCalledFunction();
+			if (callee && !changedSet.count(callee))
+				rematch.insert(callee);
+		}
+	}
+
+	// The matchers of a function are built at once, from all its calls
+	for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+		if (rematch.count(&*I) && !I->isDeclaration() && !I->isVarArg())
+			CG->removeMatchers(*I);
+	}
+	for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+		if (I->isDeclaration() || I->isVarArg() || summaries.count(I->getName()))
+			continue;
+
+		if (changedSet.count(&*I) || rematch.count(&*I))
+			MatchParametersAndReturnValues(*I, *CG);
+	}
+	addSummaryOps(M, &changedSet);
+
+	CG->finishUpdate(raDemand);
+}
+
+/// Reads a bound of a summary: a decimal number, -inf or +inf. Numbers
+/// that don't fit in MAX_BIT_INT become the infinities.
+static bool parseBound(StringRef text, APInt &bound) {
+	if (text == "-inf" || text == "+inf") {
+		bound = text[0] == '-' ? Min : Max;
+		return true;
+	}
+
+	bool negative = text.startswith("-");
+	if (text.size() == negative
+			|| text.find_first_not_of("0123456789", negative) != StringRef::npos) {
+		return false;
+	}
+
+	if (APInt::getBitsNeeded(text, 10) > MAX_BIT_INT) {
+		bound = negative ? Min : Max;
+	} else {
+		bound = APInt(MAX_BIT_INT, text, 10);
+	}
+	return true;
+}
+
+static void printBound(raw_ostream &OS, const APInt &bound) {
+	if (bound.eq(Min)) {
+		OS << "-inf";
+	} else if (bound.eq(Max)) {
+		OS << "+inf";
+	} else {
+		OS << bound;
+	}
+}
+
+template <class CGT>
+void InterProceduralRA<CGT>::loadSummaries() {
+	summaries.clear();
+
+	for (unsigned i = 0, e = raSummaryIn.size(); i < e; ++i) {
+		std::ifstream file(raSummaryIn[i].c_str());
+		if (!file) {
+			errs() << "ERROR: file " << raSummaryIn[i] << " can't be opened!\n";
+			continue;
+		}
+
+		// Each line has the bounds of the range, then the function
+		std::string line;
+		while (std::getline(file, line)) {
+			StringRef text = StringRef(line).trim();
+			if (text.empty() || text[0] == '#') {
+				continue;
+			}
+
+			std::pair<StringRef, StringRef> lower = text.split(' ');
+			std::pair<StringRef, StringRef> upper = lower.second.split(' ');
+			StringRef name = upper.second.trim();
+			APInt l = Min, u = Max;
+			if (name.empty() || !parseBound(lower.first, l)
+					|| !parseBound(upper.first, u) || l.sgt(u)) {
+				errs() << "WARNING: " << raSummaryIn[i]
+						<< ": bad range summary: " << line << "\n";
+				continue;
+			}
+
+			// The same function may be in several files
+			Range range(l, u);
+			StringMap<Range>::iterator sit = summaries.find(name);
+			if (sit != summaries.end()) {
+				sit->second = sit->second.unionWith(range);
+			} else {
+				summaries[name] = range;
+			}
+		}
+	}
+}
+
+template <class CGT>
+void InterProceduralRA<CGT>::addSummaryOps(Module &M,
+		const SmallPtrSet<const Function*, 8> *callers) {
+	for (StringMap<Range>::iterator sit = summaries.begin(), send =
+			summaries.end(); sit != send; ++sit) {
+		Function *F = M.getFunction(sit->getKey());
+		if (!F || !F->getReturnType()->isIntegerTy())
+			continue;
+
+		for (Value::use_iterator UI = F->use_begin(), E = F->use_end();
+				UI != E; ++UI) {
+			User *U = *UI;
+			if (!isa<CallInst>(U) && !isa<InvokeInst>(U))
+				continue;
+
+			Instruction *caller = cast<Instruction>(U);
+			CallSite CS(caller);
+			if (!CS.isCallee(UI))
+				continue;
+
+			// Only the calls in the functions of the graph
+			const Function *G = caller->getParent()->getParent();
+			if (G->isVarArg() || summaries.count(G->getName())
+					|| (callers && !callers->count(G)))
+				continue;
+
+			CG->addSummaryOp(caller, sit->getValue());
+		}
+	}
+}
+
+template <class CGT>
+Range InterProceduralRA<CGT>::getReturnRange(Function &F) {
+	SmallVector<const Value*, 4> values;
+	for (Function::iterator bb = F.begin(), bbend = F.end(); bb != bbend; ++bb) {
+		if (ReturnInst *RI = dyn_cast<ReturnInst>(bb->getTerminator())) {
+			values.push_back(RI->getReturnValue());
+		}
+	}
+	computeRanges(values);
+
+	Range result(Min, Max, Unknown);
+	for (unsigned i = 0, e = values.size(); i < e; ++i) {
+		Range range(Min, Max, Unknown);
+		if (const ConstantInt *CI = dyn_cast<ConstantInt>(values[i])) {
+			APInt constant = CI->getValue();
+			if (constant.getBitWidth() < MAX_BIT_INT) {
+				constant = constant.sext(MAX_BIT_INT);
+			}
+			range = Range(constant, constant);
+		} else {
+			range = CG->getRange(values[i]);
+		}
+
+		// A value out of the graph may be anything
+		if (range.isUnknown()) {
+			return Range(Min, Max);
+		}
+		if (range.isEmpty()) {
+			continue;
+		}
+		result = result.isUnknown() ? range : result.unionWith(range);
+	}
+	return result;
+}
+
+template <class CGT>
+void InterProceduralRA<CGT>::writeSummaries(Module &M) {
+	std::string ErrorInfo;
+	raw_fd_ostream file(raSummaryOut.c_str(), ErrorInfo);
+	if (file.has_error()) {
+		errs() << "ERROR: file " << raSummaryOut << " can't be opened!\n";
+		return;
+	}
+
+	file << "# lower upper function, for any arguments\n";
+	for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
+		if (I->isDeclaration() || I->isVarArg() || I->hasLocalLinkage()
+				|| !I->getReturnType()->isIntegerTy())
+			continue;
+
+		StringMap<Range>::iterator sit = summaries.find(I->getName());
+		Range summary =
+				sit != summaries.end() ? sit->second : getReturnRange(*I);
+
+		// Without a summary, the calls are [-inf, +inf] anyway
+		if (!summary.isRegular() || summary.isMaxRange())
+			continue;
+
+		printBound(file, summary.getLower());
+		file << " ";
+		printBound(file, summary.getUpper());
+		file << " " << I->getName() << "\n";
+	}
+}
+
 template<class CGT>
 unsigned InterProceduralRA<CGT>::getMaxBitWidth(Module &M) {
 	unsigned max = 0;
@@ -276,33 +841,42 @@ unsigned InterProceduralRA<CGT>::getMaxBitWidth(Module &M) {
 
 template<class CGT>
 bool InterProceduralRA<CGT>::runOnModule(Module &M) {
+	PassProfileScope scope("InterProceduralRA", "range analysis");
+	// A large module solves its independent SCCs in parallel
+	ModuleMetrics metrics = ModuleMetrics::compute(M);
+	context.threads = metrics.isLarge() ? ModuleMetrics::suggestedThreads() : 1;
+	PassProfile::get().counter("estimated constraints", "range analysis",
+			metrics.RangeConstraints);
 	// Constraint Graph
 //	if(CG) delete CG;
 	CG = new CGT();
 
-	MAX_BIT_INT = getMaxBitWidth(M);
-	updateMinMax(MAX_BIT_INT);
+	context.setBitWidth(getMaxBitWidth(M));
+	installContext();
+	loadSummaries();
 
 	// Build the Constraint Graph by running on each function
 #ifdef STATS
-	Profile::TimeValue before = prof.timenow();
+	startProfile();
+	prof.beginPhase("BuildGraph");
 #endif
 	for (Module::iterator I = M.begin(), E = M.end(); I != E; ++I) {
 		// If the function is only a declaration, or if it has variable number of arguments, do not match
 		if (I->isDeclaration() || I->isVarArg())
 			continue;
+		// Its calls take the summary instead of its constraints
+		if (summaries.count(I->getName()))
+			continue;
     getAnalysis<vSSA>(*I);
 			
 		CG->buildGraph(*I);
 		MatchParametersAndReturnValues(*I, *CG);
 	}
+	addSummaryOps(M);
 	CG->buildVarNodes();
 
 #ifdef STATS
-	Profile::TimeValue elapsed = prof.timenow() - before;
-	prof.updateTime("BuildGraph", elapsed);
-
-	prof.setMemoryUsage();
+	prof.endPhase();
 #endif
 #ifdef PRINT_DEBUG
 	std::string moduleIdentifier = M.getModuleIdentifier();
@@ -310,10 +884,14 @@ bool InterProceduralRA<CGT>::runOnModule(Module &M) {
 	std::string mIdentifier = pos > 0 ? moduleIdentifier.substr(pos) : moduleIdentifier;
 	CG->printToFile(*(M.begin()), "/tmp/" + mIdentifier + ".cgpre.dot");
 #endif
-	CG->findIntervals();
+	// With -ra-demand the intervals are found by getRange and computeRanges
+	if (!raDemand)
+		CG->findIntervals();
 #ifdef PRINT_DEBUG
 	CG->printToFile(*(M.begin()), "/tmp/" + mIdentifier + ".cgpos.dot");
 #endif
+	if (!raSummaryOut.empty())
+		writeSummaries(M);
 	for (VarNodes::iterator vit = CG->getVars()->begin(), vend = CG->getVars()->end(); vit != vend; ++vit) {
 		Range RG = vit->second->getRange(); 
 		if (!RG.isUnknown()) {
@@ -375,10 +953,14 @@ void InterProceduralRA<CGT>::MatchParametersAndReturnValues(Function &F,
 	// For each use of F, get the real parameters and the caller instruction to do the matching
 	std::vector<PhiOp*> matchers(F.arg_size(), NULL);
 
-	for (unsigned i = 0, e = Parameters.size(); i < e; ++i) {
+	// The summary of a function that other modules may call must hold for
+	// any arguments, so its parameters keep [-inf, +inf]
+	bool matchParameters = raSummaryOut.empty() || F.hasLocalLinkage();
+
+	for (unsigned i = 0, e = Parameters.size(); matchParameters && i < e; ++i) {
 		VarNode *sink = G.addVarNode(Parameters[i].first);
 
-		matchers[i] = new PhiOp(new BasicInterval(), sink, NULL,
+		matchers[i] = new (G.getAllocator()) PhiOp(new BasicInterval(), sink, NULL,
 				Instruction::PHI);
 
 		// Insert the operation in the graph.
@@ -430,7 +1012,7 @@ void InterProceduralRA<CGT>::MatchParametersAndReturnValues(Function &F,
 		VarNode* from = NULL;
 
 		// Match formal and real parameters
-		for (i = 0; i < Parameters.size(); ++i) {
+		for (i = 0; matchParameters && i < Parameters.size(); ++i) {
 			// Add real parameter to the CG
 			from = G.addVarNode(Parameters[i].second);
 
@@ -446,7 +1028,7 @@ void InterProceduralRA<CGT>::MatchParametersAndReturnValues(Function &F,
 			// Add caller instruction to the CG (it receives the return value)
 			to = G.addVarNode(caller);
 
-			PhiOp *phiOp = new PhiOp(new BasicInterval(), to, NULL,
+			PhiOp *phiOp = new (G.getAllocator()) PhiOp(new BasicInterval(), to, NULL,
 					Instruction::PHI);
 
 			// Insert the operation in the graph.
@@ -474,10 +1056,7 @@ void InterProceduralRA<CGT>::MatchParametersAndReturnValues(Function &F,
 template <class CGT>
 InterProceduralRA<CGT>::~InterProceduralRA(){
 #ifdef STATS
-	prof.printTime("BuildGraph");
-	prof.printTime("Nuutila");
-	prof.printTime("SCCs resolution");
-	prof.printMemoryUsage();
+	finishProfile();
 	
 	std::ostringstream formated;
 	formated << 100 * (1.0 - ((double)(needBits) / usedBits));
@@ -517,27 +1096,81 @@ static RegisterPass<InterProceduralRACousot> Y("ra-inter-cousot", "Cousot's inte
 //  return new InterProceduralRACousot(); 
 //}
 
+static RegisterPass<IntraProceduralRAAdaptive> XA("ra-intra-adaptive", "Intra-procedural range analysis choosing the solver of each SCC");
+static RegisterPass<InterProceduralRAAdaptive> YA("ra-inter-adaptive", "Inter-procedural range analysis choosing the solver of each SCC");
+
 // ========================================================================== //
 // Range
 // ========================================================================== //
-Range::Range() {
+Range::Range() :
+		sl(0), su(0), width(1) {
 	Range(Min, Max);
 }
 
 Range::Range(APInt lb, APInt ub, RangeType rType) :
-		l(lb), u(ub), type(rType) {
+		type(rType) {
+	setBounds(lb, ub);
+}
+
+Range::Range(int64_t lb, int64_t ub, unsigned bitwidth, RangeType rType) :
+		sl(lb), su(ub), width(bitwidth), type(rType) {
 }
 
 Range::~Range() {
 }
 
+void Range::setBounds(const APInt& lb, const APInt& ub) {
+	width = lb.getBitWidth();
+	if (isSmall()) {
+		sl = lb.getSExtValue();
+		su = ub.getSExtValue();
+		l = u = APInt();
+	} else {
+		l = lb;
+		u = ub;
+	}
+}
+
 bool Range::isMaxRange() const {
+	if (isSmall())
+		return sl == minValue(width) && su == maxValue(width);
+
 	return this->getLower().eq(Min) && this->getUpper().eq(Max);
 }
 
+// The smallest and the largest of four candidate bounds.
+static void minMax(const int64_t candidates[4], int64_t& min, int64_t& max) {
+	min = max = candidates[0];
+	for (unsigned i = 1; i < 4; ++i) {
+		if (candidates[i] > max)
+			max = candidates[i];
+		else if (candidates[i] < min)
+			min = candidates[i];
+	}
+}
+
 /// Add and Mul are commutatives. So, they are a little different 
 /// of the other operations.
 Range Range::add(const Range& other) {
+	if (isSmall() && other.isSmall()) {
+		int64_t min = minValue(width), max = maxValue(width);
+		int64_t a = sl, b = su, c = other.sl, d = other.su;
+		int64_t l = min, u = max;
+		if (a != min && c != min) {
+			l = wrap((uint64_t)a + (uint64_t)c, width);
+			if ((a < 0) == (c < 0) && (a < 0) != (l < 0))
+				l = min;
+		}
+
+		if (b != max && d != max) {
+			u = wrap((uint64_t)b + (uint64_t)d, width);
+			if ((b < 0) == (d < 0) && (b < 0) != (u < 0))
+				u = max;
+		}
+
+		return Range(l, u, width);
+	}
+
 	const APInt &a = this->getLower();
 	const APInt &b = this->getUpper();
 	const APInt &c = other.getLower();
@@ -563,6 +1196,16 @@ Range Range::add(const Range& other) {
 /// max (a − c, a − d, b − c, b − d)] = [a − d, b − c]
 /// The other operations are just like this operation.
 Range Range::sub(const Range& other) {
+	if (isSmall() && other.isSmall()) {
+		int64_t min = minValue(width), max = maxValue(width);
+		int64_t a = sl, b = su, c = other.sl, d = other.su;
+		int64_t l = (a == min || d == max) ? min
+				: wrap((uint64_t)a - (uint64_t)d, width);
+		int64_t u = (b == max || c == min) ? max
+				: wrap((uint64_t)b - (uint64_t)c, width);
+		return Range(l, u, width);
+	}
+
 	const APInt &a = this->getLower();
 	const APInt &b = this->getUpper();
 	const APInt &c = other.getLower();
@@ -600,14 +1243,49 @@ Range Range::sub(const Range& other) {
 							(xy.isNegative() ? Max : xy) \
 							: (xy.isStrictlyPositive() ? Min : xy))
 
-/// Add and Mul are commutatives. So, they are a little different 
-/// of the other operations.
-// [a, b] * [c, d] = [Min(a*c, a*d, b*c, b*d), Max(a*c, a*d, b*c, b*d)]
+// MUL_OV(x, y, MUL_HELPER(x, y)) on int64_t bounds of the given width. As
+// the macros expand, the overflow check doesn't apply when x is Max.
+static int64_t mulBound(int64_t x, int64_t y, int64_t min, int64_t max,
+		unsigned width) {
+	if (x == max)
+		return y < 0 ? min : (y == 0 ? 0 : max);
+
+	int64_t xy;
+	if (y == max)
+		xy = x < 0 ? min : (x == 0 ? 0 : max);
+	else if (x == min)
+		xy = y < 0 ? max : (y == 0 ? 0 : min);
+	else if (y == min)
+		xy = x < 0 ? max : (x == 0 ? 0 : min);
+	else
+		xy = (int64_t)((uint64_t)x * (uint64_t)y << (64 - width)) >> (64 - width);
+
+	if ((x > 0) == (y > 0))
+		return xy < 0 ? max : xy;
+	return xy > 0 ? min : xy;
+}
+
+/// Add and Mul are commutatives. So, they are a little different 
+/// of the other operations.
+// [a, b] * [c, d] = [Min(a*c, a*d, b*c, b*d), Max(a*c, a*d, b*c, b*d)]
 Range Range::mul(const Range& other) {
 	if (this->isMaxRange() || other.isMaxRange()) {
 		return Range(Min, Max);
 	}
 
+	if (isSmall() && other.isSmall()) {
+		int64_t min = minValue(width), max = maxValue(width);
+		int64_t candidates[4];
+		candidates[0] = mulBound(sl, other.sl, min, max, width);
+		candidates[1] = mulBound(sl, other.su, min, max, width);
+		candidates[2] = mulBound(su, other.sl, min, max, width);
+		candidates[3] = mulBound(su, other.su, min, max, width);
+
+		int64_t l, u;
+		minMax(candidates, l, u);
+		return Range(l, u, width);
+	}
+
 	const APInt &a = this->getLower();
 	const APInt &b = this->getUpper();
 	const APInt &c = other.getLower();
@@ -675,8 +1353,39 @@ Range Range::udiv(const Range& other) {
 	return Range(*min, *max);
 }
 
+// DIV_HELPER(sdiv, x, y) on int64_t bounds; y is never 0.
+static int64_t sdivBound(int64_t x, int64_t y, int64_t min, int64_t max) {
+	if (x == max)
+		return y < 0 ? min : (y == 0 ? 0 : max);
+	if (y == max)
+		return x < 0 ? min : (x == 0 ? 0 : max);
+	if (x == min)
+		return y < 0 ? max : (y == 0 ? 0 : min);
+	if (y == min)
+		return x < 0 ? max : (x == 0 ? 0 : min);
+	return x / y;
+}
+
 // [a, b] / [c, d] = [Min(a/c, a/d), Max(b/c, b/d)]
 Range Range::sdiv(const Range& other) {
+	if (isSmall() && other.isSmall()) {
+		int64_t min = minValue(width), max = maxValue(width);
+
+		// Deal with division by 0 exception
+		if (other.sl == 0 || other.su == 0)
+			return Range(min, max, width);
+
+		int64_t candidates[4];
+		candidates[0] = sdivBound(sl, other.sl, min, max);
+		candidates[1] = sdivBound(sl, other.su, min, max);
+		candidates[2] = sdivBound(su, other.sl, min, max);
+		candidates[3] = sdivBound(su, other.su, min, max);
+
+		int64_t l, u;
+		minMax(candidates, l, u);
+		return Range(l, u, width);
+	}
+
 	const APInt &a = this->getLower();
 	const APInt &b = this->getUpper();
 	const APInt &c = other.getLower();
@@ -803,7 +1512,30 @@ Range Range::srem(const Range& other) {
 	return Range(*min, *max);
 }
 
+// x.shl(y) on int64_t bounds: the shift amount is unsigned, and shifting
+// by the bit width or more gives 0.
+static int64_t shlBound(int64_t x, int64_t y, unsigned width) {
+	uint64_t amount = (uint64_t)y << (64 - width) >> (64 - width);
+	if (amount >= width)
+		return 0;
+	return (int64_t)((uint64_t)x << amount << (64 - width)) >> (64 - width);
+}
+
 Range Range::shl(const Range& other) {
+	if (isSmall() && other.isSmall()) {
+		int64_t min = minValue(width), max = maxValue(width);
+		int64_t a = sl, b = su, c = other.sl, d = other.su;
+		int64_t candidates[4];
+		candidates[0] = (a != min && c != min) ? shlBound(a, c, width) : min;
+		candidates[1] = (a != min && d != max) ? shlBound(a, d, width) : min;
+		candidates[2] = (b != max && c != min) ? shlBound(b, c, width) : max;
+		candidates[3] = (b != max && d != max) ? shlBound(b, d, width) : max;
+
+		int64_t l, u;
+		minMax(candidates, l, u);
+		return Range(l, u, width);
+	}
+
 	const APInt &a = this->getLower();
 	const APInt &b = this->getUpper();
 	const APInt &c = other.getLower();
@@ -1179,6 +1911,9 @@ Range Range::intersectWith(const Range& other) const {
 		return *this;
 	}
 
+	if (isSmall() && other.isSmall())
+		return Range(std::max(sl, other.sl), std::min(su, other.su), width);
+
 	APInt l = getLower().sgt(other.getLower()) ? getLower() : other.getLower();
 	APInt u = getUpper().slt(other.getUpper()) ? getUpper() : other.getUpper();
 	return Range(l, u);
@@ -1201,17 +1936,26 @@ Range Range::unionWith(const Range& other) const {
 		return *this;
 	}
 
+	if (isSmall() && other.isSmall())
+		return Range(std::min(sl, other.sl), std::max(su, other.su), width);
+
 	APInt l = getLower().slt(other.getLower()) ? getLower() : other.getLower();
 	APInt u = getUpper().sgt(other.getUpper()) ? getUpper() : other.getUpper();
 	return Range(l, u);
 }
 
 bool Range::operator==(const Range& other) const {
+	if (isSmall() && other.isSmall())
+		return type == other.type && sl == other.sl && su == other.su;
+
 	return this->type == other.type && getLower().eq(other.getLower())
 			&& getUpper().eq(other.getUpper());
 }
 
 bool Range::operator!=(const Range& other) const {
+	if (isSmall() && other.isSmall())
+		return type != other.type || sl != other.sl || su != other.su;
+
 	return this->type != other.type || getLower().ne(other.getLower())
 			|| getUpper().ne(other.getUpper());
 }
@@ -1364,7 +2108,7 @@ void SymbInterval::print(raw_ostream& OS) const {
 
 /// The ctor.
 VarNode::VarNode(const Value* V) :
-		V(V), interval(Range(Min, Max, Unknown)) {
+		V(V), interval(Range(Min, Max, Unknown)), firstUse(0), lastUse(0) {
 }
 
 /// The dtor.
@@ -1834,32 +2578,16 @@ void ValueSwitchMap::clear() {
 
 ConstraintGraph::ConstraintGraph() {
 	this->func = NULL;
+	this->demand = NULL;
+	this->updating = false;
 }
 
 /// The dtor.
 ConstraintGraph::~ConstraintGraph() {
 //	errs() << "\nConstraintGraph::~ConstraintGraph : "<< this->vars.size();
 	//delete symbMap;
-
-	for (VarNodes::iterator vit = vars.begin(), vend = vars.end();
-			vit != vend; ++vit) {
-		delete vit->second;
-	}
-
-	for (GenOprs::iterator oit = oprs.begin(), oend = oprs.end(); oit != oend;
-			++oit) {
-		delete *oit;
-	}
-
-	for (ValuesBranchMap::iterator vit = valuesBranchMap.begin(), vend =
-			valuesBranchMap.end(); vit != vend; ++vit) {
-		vit->second.clear();
-	}
-
-	for (ValuesSwitchMap::iterator vit = valuesSwitchMap.begin(), vend =
-			valuesSwitchMap.end(); vit != vend; ++vit) {
-		vit->second.clear();
-	}
+	clear();
+	clearValueMaps();
 }
 
 Range ConstraintGraph::getRange(const Value *v) {
@@ -1877,9 +2605,22 @@ VarNode* ConstraintGraph::addVarNode(const Value* V) {
 		return vit->second;
 	}
 
-	VarNode* node = new VarNode(V);
+	VarNode* node = new (allocator) VarNode(V);
 	this->vars.insert(std::make_pair(V, node));
 
+	const Function *F = NULL;
+	if (const Instruction *I = dyn_cast<Instruction>(V)) {
+		F = I->getParent()->getParent();
+	} else if (const Argument *A = dyn_cast<Argument>(V)) {
+		F = A->getParent();
+	}
+	if (F) {
+		this->funcVars[F].push_back(node);
+	}
+	if (this->updating) {
+		this->dirty.push_back(node);
+	}
+
 	// Inserts the node in the use map list.
 	SmallPtrSet<BasicOp*, 8> useList;
 	this->useMap.insert(std::make_pair(V, useList));
@@ -1887,6 +2628,25 @@ VarNode* ConstraintGraph::addVarNode(const Value* V) {
 }
 
 /// Adds an UnaryOp in the graph.
+void ConstraintGraph::addSummaryOp(const Instruction *call,
+		const Range &summary) {
+	VarNode* sink = addVarNode(call);
+	// The callee has no constraints, so it is [-inf, +inf], which the
+	// intersection narrows to the summary
+	ImmutableCallSite CS(call);
+	VarNode* source = addVarNode(CS.getCalledValue());
+
+	UnaryOp* UOp = new (allocator) UnaryOp(new BasicInterval(summary), sink,
+			call, source, call->getOpcode());
+	this->oprs.insert(UOp);
+
+	// Insert this definition in defmap
+	this->defMap[sink->getValue()] = UOp;
+
+	// Inserts the sources of the operation in the use map list.
+	this->useMap.find(source->getValue())->second.insert(UOp);
+}
+
 void ConstraintGraph::addUnaryOp(const Instruction* I) {
 	// Create the sink.
 	VarNode* sink = addVarNode(I);
@@ -1914,7 +2674,7 @@ void ConstraintGraph::addUnaryOp(const Instruction* I) {
 	
 #ifndef OVERFLOWHANDLER
 	// Create the operation using the intersect to constrain sink's interval.
-	UOp = new UnaryOp(new BasicInterval(), sink, I, source,
+	UOp = new (allocator) UnaryOp(new BasicInterval(), sink, I, source,
 			I->getOpcode());
 #else
 	// I can only be an Add instruction if he is a newdef overflow instruction
@@ -1941,7 +2701,7 @@ void ConstraintGraph::addUnaryOp(const Instruction* I) {
 					lower -= constant;
 				}
 				
-				UOp = new UnaryOp(new BasicInterval(lower, upper), sink, I, source, I->getOpcode());
+				UOp = new (allocator) UnaryOp(new BasicInterval(lower, upper), sink, I, source, I->getOpcode());
 				break;
 				
 			case Instruction::Sub:
@@ -1957,7 +2717,7 @@ void ConstraintGraph::addUnaryOp(const Instruction* I) {
 					upper += constant;
 				}
 				
-				UOp = new UnaryOp(new BasicInterval(lower, upper), sink, I, source, I->getOpcode());
+				UOp = new (allocator) UnaryOp(new BasicInterval(lower, upper), sink, I, source, I->getOpcode());
 				break;
 			
 			case Instruction::Mul:
@@ -1976,7 +2736,7 @@ void ConstraintGraph::addUnaryOp(const Instruction* I) {
 					candidates[1] = swap;
 				}
 				
-				UOp = new UnaryOp(new BasicInterval(candidates[0], candidates[1]), sink, I, source, I->getOpcode());
+				UOp = new (allocator) UnaryOp(new BasicInterval(candidates[0], candidates[1]), sink, I, source, I->getOpcode());
 				break;
 			
 			case Instruction::Trunc:
@@ -1995,13 +2755,13 @@ void ConstraintGraph::addUnaryOp(const Instruction* I) {
 				
 				Range truncInterval(minvalue, maxvalue, Regular);
 				
-				UOp = new UnaryOp(new BasicInterval(truncInterval), sink, I, source, I->getOpcode());
+				UOp = new (allocator) UnaryOp(new BasicInterval(truncInterval), sink, I, source, I->getOpcode());
 				break;
 		}
 	}
 	else {
 		// Create the operation using the intersect to constrain sink's interval.
-		UOp = new UnaryOp(new BasicInterval(), sink, I, source,
+		UOp = new (allocator) UnaryOp(new BasicInterval(), sink, I, source,
 		I->getOpcode());
 	}
 #endif
@@ -2029,7 +2789,7 @@ void ConstraintGraph::addBinaryOp(const Instruction* I) {
 
 	// Create the operation using the intersect to constrain sink's interval.
 	BasicInterval* BI = new BasicInterval();
-	BinaryOp* BOp = new BinaryOp(BI, sink, I, source1, source2, I->getOpcode());
+	BinaryOp* BOp = new (allocator) BinaryOp(BI, sink, I, source1, source2, I->getOpcode());
 
 	// Insert the operation in the graph.
 	this->oprs.insert(BOp);
@@ -2046,7 +2806,7 @@ void ConstraintGraph::addBinaryOp(const Instruction* I) {
 void ConstraintGraph::addPhiOp(const PHINode* Phi) {
 	// Create the sink.
 	VarNode* sink = addVarNode(Phi);
-	PhiOp* phiOp = new PhiOp(new BasicInterval(), sink, Phi, Phi->getOpcode());
+	PhiOp* phiOp = new (allocator) PhiOp(new BasicInterval(), sink, Phi, Phi->getOpcode());
 
 	// Insert the operation in the graph.
 	this->oprs.insert(phiOp);
@@ -2078,47 +2838,29 @@ void ConstraintGraph::addSigmaOp(const PHINode* Sigma) {
 			it != e; ++it) {
 		Value *operand = *it;
 		VarNode* source = addVarNode(operand);
-
-		// Create the operation (two cases from: branch or switch)
-		ValuesBranchMap::iterator vbmit = this->valuesBranchMap.find(operand);
-
-		// Branch case
-		if (vbmit != this->valuesBranchMap.end()) {
-			const ValueBranchMap &VBM = vbmit->second;
-			if (thisbb == VBM.getBBTrue()) {
-				BItv = VBM.getItvT();
-			} else {
-				if (thisbb == VBM.getBBFalse()) {
-					BItv = VBM.getItvF();
-				}
+		BItv = NULL;
+
+		// Create the operation (two cases from: branch or switch). The
+		// entries come from the branches into this block, and may have been
+		// replaced by other branches on the same value since they were built.
+		if (!takeSigmaInterval(operand, thisbb, BItv)) {
+			for (const_pred_iterator PI = pred_begin(thisbb), PE =
+					pred_end(thisbb); PI != PE; ++PI) {
+				buildValueMaps((*PI)->getTerminator());
 			}
-		} else {
-			// Switch case
-			ValuesSwitchMap::iterator vsmit = this->valuesSwitchMap.find(
-					operand);
 
-			if (vsmit == this->valuesSwitchMap.end()) {
+			if (!takeSigmaInterval(operand, thisbb, BItv)
+					&& !valuesBranchMap.count(operand)
+					&& !valuesSwitchMap.count(operand)) {
 				continue;
 			}
-
-			const ValueSwitchMap &VSM = vsmit->second;
-
-			// Find out which case are we dealing with
-			for (unsigned idx = 0, e = VSM.getNumOfCases(); idx < e; ++idx) {
-				const BasicBlock *bb = VSM.getBB(idx);
-
-				if (bb == thisbb) {
-					BItv = VSM.getItv(idx);
-					break;
-				}
-			}
 		}
 
 		if (BItv == NULL) {
-			sigmaOp = new SigmaOp(new BasicInterval(), sink, Sigma, source,
+			sigmaOp = new (allocator) SigmaOp(new BasicInterval(), sink, Sigma, source,
 					Sigma->getOpcode());
 		} else {
-			sigmaOp = new SigmaOp(BItv, sink, Sigma, source,
+			sigmaOp = new (allocator) SigmaOp(BItv, sink, Sigma, source,
 					Sigma->getOpcode());
 		}
 
@@ -2231,11 +2973,15 @@ void ConstraintGraph::buildValueSwitchMap(const SwitchInst *sw) {
 	}
 
 	ValueSwitchMap VSM(condition, BBsuccs);
-	valuesSwitchMap.insert(std::make_pair(condition, VSM));
+	addValueMap(VSM);
 
+	// The entry of the operand of the cast has intervals of its own
 	if (Op0_0) {
+		for (unsigned i = 0, e = BBsuccs.size(); i < e; ++i) {
+			BBsuccs[i].first = new BasicInterval(BBsuccs[i].first->getRange());
+		}
 		ValueSwitchMap VSM_0(Op0_0, BBsuccs);
-		valuesSwitchMap.insert(std::make_pair(Op0_0, VSM_0));
+		addValueMap(VSM_0);
 	}
 }
 
@@ -2309,7 +3055,7 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
 
 		const Value *Op0 = ici->getOperand(0);
 		ValueBranchMap VBM(Op0, TBlock, FBlock, BT, BF);
-		valuesBranchMap.insert(std::make_pair(Op0, VBM));
+		addValueMap(VBM);
 
 		// Do the same for the operand of Op0 (if Op0 is a cast instruction)
 		const CastInst *castinst = NULL;
@@ -2320,7 +3066,7 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
 			BasicInterval* BF = new BasicInterval(FValues);
 
 			ValueBranchMap VBM(Op0_0, TBlock, FBlock, BT, BF);
-			valuesBranchMap.insert(std::make_pair(Op0_0, VBM));
+			addValueMap(VBM);
 		}
 	} else {
 		// Create the interval using the intersection in the branch.
@@ -2337,7 +3083,7 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
 		SymbInterval* SFOp0 = new SymbInterval(CR, Op1, invPred);
 
 		ValueBranchMap VBMOp0(Op0, TBlock, FBlock, STOp0, SFOp0);
-		valuesBranchMap.insert(std::make_pair(Op0, VBMOp0));
+		addValueMap(VBMOp0);
 
 		// Symbolic intervals for operand of op0 (if op0 is a cast instruction)
 		const CastInst *castinst = NULL;
@@ -2348,14 +3094,14 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
 			SymbInterval* SFOp1_1 = new SymbInterval(CR, Op1, invPred);
 
 			ValueBranchMap VBMOp1_1(Op0_0, TBlock, FBlock, STOp1_1, SFOp1_1);
-			valuesBranchMap.insert(std::make_pair(Op0_0, VBMOp1_1));
+			addValueMap(VBMOp1_1);
 		}
 
 		// Symbolic intervals for op1
 		SymbInterval* STOp1 = new SymbInterval(CR, Op0, invPred);
 		SymbInterval* SFOp1 = new SymbInterval(CR, Op0, pred);
 		ValueBranchMap VBMOp1(Op1, TBlock, FBlock, STOp1, SFOp1);
-		valuesBranchMap.insert(std::make_pair(Op1, VBMOp1));
+		addValueMap(VBMOp1);
 
 		// Symbolic intervals for operand of op1 (if op1 is a cast instruction)
 		castinst = NULL;
@@ -2366,32 +3112,89 @@ void ConstraintGraph::buildValueBranchMap(const BranchInst *br) {
 			SymbInterval* SFOp1_1 = new SymbInterval(CR, Op1, invPred);
 
 			ValueBranchMap VBMOp1_1(Op0_0, TBlock, FBlock, STOp1_1, SFOp1_1);
-			valuesBranchMap.insert(std::make_pair(Op0_0, VBMOp1_1));
+			addValueMap(VBMOp1_1);
 		}
 	}
 }
 
-void ConstraintGraph::buildValueMaps(const Function& F) {
-	for (Function::const_iterator iBB = F.begin(), eBB = F.end(); iBB != eBB;
-			++iBB) {
-		const TerminatorInst* ti = iBB->getTerminator();
-		const BranchInst* br = dyn_cast<BranchInst>(ti);
-		const SwitchInst* sw = dyn_cast<SwitchInst>(ti);
+void ConstraintGraph::buildValueMaps(const TerminatorInst *ti) {
+	const BranchInst* br = dyn_cast<BranchInst>(ti);
+	const SwitchInst* sw = dyn_cast<SwitchInst>(ti);
+
+	if (br) {
+		buildValueBranchMap(br);
+	} else if (sw) {
+		buildValueSwitchMap(sw);
+	}
+}
+
+void ConstraintGraph::addValueMap(const ValueBranchMap &VBM) {
+	ValuesBranchMap::iterator vbmit = valuesBranchMap.find(VBM.getV());
+	if (vbmit != valuesBranchMap.end()) {
+		vbmit->second.clear();
+		valuesBranchMap.erase(vbmit);
+	}
+	valuesBranchMap.insert(std::make_pair(VBM.getV(), VBM));
+}
+
+void ConstraintGraph::addValueMap(const ValueSwitchMap &VSM) {
+	ValuesSwitchMap::iterator vsmit = valuesSwitchMap.find(VSM.getV());
+	if (vsmit != valuesSwitchMap.end()) {
+		vsmit->second.clear();
+		valuesSwitchMap.erase(vsmit);
+	}
+	valuesSwitchMap.insert(std::make_pair(VSM.getV(), VSM));
+}
 
-		if (br) {
-			buildValueBranchMap(br);
-		} else if (sw) {
-			buildValueSwitchMap(sw);
+bool ConstraintGraph::takeSigmaInterval(const Value *V, const BasicBlock *BB,
+		BasicInterval *&itv) {
+	// Branch case
+	ValuesBranchMap::iterator vbmit = valuesBranchMap.find(V);
+	if (vbmit != valuesBranchMap.end()) {
+		ValueBranchMap &VBM = vbmit->second;
+		if (BB == VBM.getBBTrue()) {
+			itv = VBM.getItvT();
+			VBM.setItvT(NULL);
+			return true;
+		}
+		if (BB == VBM.getBBFalse()) {
+			itv = VBM.getItvF();
+			VBM.setItvF(NULL);
+			return true;
 		}
 	}
+
+	// Switch case
+	ValuesSwitchMap::iterator vsmit = valuesSwitchMap.find(V);
+	if (vsmit != valuesSwitchMap.end()) {
+		ValueSwitchMap &VSM = vsmit->second;
+
+		// Find out which case are we dealing with
+		for (unsigned idx = 0, e = VSM.getNumOfCases(); idx < e; ++idx) {
+			if (VSM.getBB(idx) == BB) {
+				itv = VSM.getItv(idx);
+				VSM.setItv(idx, NULL);
+				return true;
+			}
+		}
+	}
+	return false;
 }
 
+void ConstraintGraph::clearValueMaps() {
+	for (ValuesBranchMap::iterator vit = valuesBranchMap.begin(), vend =
+			valuesBranchMap.end(); vit != vend; ++vit) {
+		vit->second.clear();
+	}
 
-//void ConstraintGraph::clearValueMaps()
-//{
-//	valuesSwitchMap.clear();
-//	valuesBranchMap.clear();
-//}
+	for (ValuesSwitchMap::iterator vit = valuesSwitchMap.begin(), vend =
+			valuesSwitchMap.end(); vit != vend; ++vit) {
+		vit->second.clear();
+	}
+
+	valuesBranchMap.clear();
+	valuesSwitchMap.clear();
+}
 
 /*
  * Comparison function used to sort the constant vector
@@ -2402,47 +3205,56 @@ bool compareAPInt(const APInt &v1, const APInt &v2)
 }
 
 /*
- * Used to insert constant in the right position
+ * Used to insert constant in the jump-set
  */
-void ConstraintGraph::insertConstantIntoVector(APInt constantval)
+void JumpSet::insert(APInt constant)
 {
-	if (constantval.getBitWidth() < MAX_BIT_INT) {
-		constantval = constantval.sext(MAX_BIT_INT);
+	if (constant.getBitWidth() < MAX_BIT_INT) {
+		constant = constant.sext(MAX_BIT_INT);
 	}
 
-	constantvector.push_back(constantval);
+	constants.push_back(constant);
+}
+
+void JumpSet::build()
+{
+	// Sort in ascending order and remove duplicates
+	std::sort(constants.begin(), constants.end(), compareAPInt);
+	constants.erase(std::unique(constants.begin(), constants.end()), constants.end());
 }
 
 /*
- * Get the first constant from vector greater than val
+ * Get the first constant from the jump-set greater than val
  */
-APInt getFirstGreaterFromVector(const SmallVector<APInt, 2> &constantvector, const APInt &val)
+APInt JumpSet::getFirstGreater(const APInt &val) const
 {
-	for (SmallVectorImpl<APInt>::const_iterator vit = constantvector.begin(), vend = constantvector.end(); vit != vend; ++vit) {
-		const APInt &vapint = *vit;
+	const APInt *it = std::lower_bound(constants.begin(), constants.end(), val, compareAPInt);
+	APInt result = it != constants.end() ? *it : Max;
 
-		if (vapint.sge(val)) {
-			return vapint;
+	if (global) {
+		APInt other = global->getFirstGreater(val);
+		if (other.slt(result)) {
+			result = other;
 		}
 	}
-
-	return Max;
+	return result;
 }
 
 /*
- * Get the first constant from vector less than val
+ * Get the first constant from the jump-set less than val
  */
-APInt getFirstLessFromVector(const SmallVector<APInt, 2> &constantvector, const APInt &val)
+APInt JumpSet::getFirstLess(const APInt &val) const
 {
-	for (SmallVectorImpl<APInt>::const_reverse_iterator vit = constantvector.rbegin(), vend = constantvector.rend(); vit != vend; ++vit) {
-		const APInt &vapint = *vit;
+	const APInt *it = std::upper_bound(constants.begin(), constants.end(), val, compareAPInt);
+	APInt result = it != constants.begin() ? *(it - 1) : Min;
 
-		if (vapint.sle(val)) {
-			return vapint;
+	if (global) {
+		APInt other = global->getFirstLess(val);
+		if (other.sgt(result)) {
+			result = other;
 		}
 	}
-
-	return Min;
+	return result;
 }
 
 /*
@@ -2452,7 +3264,8 @@ APInt getFirstLessFromVector(const SmallVector<APInt, 2> &constantvector, const
  *   - Constants that are source of an edge to an entry point
  *   - Constants from intersections generated by sigmas
  */
-void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap)
+void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap,
+		JumpSet &constantvector)
 {
 	// Remove all elements from the vector
 	constantvector.clear();
@@ -2463,7 +3276,7 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 		const ConstantInt *ci = NULL;
 		
 		if ((ci = dyn_cast<ConstantInt>(V))) {
-			insertConstantIntoVector(ci->getValue());
+			constantvector.insert(ci->getValue());
 		}
 	}
 
@@ -2489,10 +3302,10 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 			const ConstantInt *const1, *const2;
 
 			if ((const1 = dyn_cast<ConstantInt>(sourceval1))) {
-				insertConstantIntoVector(const1->getValue());
+				constantvector.insert(const1->getValue());
 			}
 			if ((const2 = dyn_cast<ConstantInt>(sourceval2))) {
-				insertConstantIntoVector(const2->getValue());
+				constantvector.insert(const2->getValue());
 			}
 		}
 		// Handle PhiOp case
@@ -2504,7 +3317,7 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 				const ConstantInt *consti;
 
 				if ((consti = dyn_cast<ConstantInt>(sourceval))) {
-					insertConstantIntoVector(consti->getValue());
+					constantvector.insert(consti->getValue());
 				}
 			}
 		}
@@ -2527,24 +3340,58 @@ void ConstraintGraph::buildConstantVector(const SmallPtrSet<VarNode*, 32> &compo
 				const APInt ub = rintersect.getUpper();
 
 				if (lb.ne(Min) && lb.ne(Max)) {
-					insertConstantIntoVector(lb);
+					constantvector.insert(lb);
 				}
 				if (ub.ne(Min) && ub.ne(Max)) {
-					insertConstantIntoVector(ub);
+					constantvector.insert(ub);
 				}
 			}
 		}
 	}
 
-	// Sort vector in ascending order and remove duplicates
-	std::sort(constantvector.begin(), constantvector.end(), compareAPInt);
-	std::unique(constantvector.begin(), constantvector.end());
+	constantvector.build();
+}
+
+/*
+ * Create the jump-set of the whole graph: its constants and the constants
+ * from the intersections of all the sigmas
+ */
+void ConstraintGraph::buildGlobalJumpSet()
+{
+	globalJumpSet.clear();
+
+	for (VarNodes::iterator vit = vars.begin(), vend = vars.end(); vit != vend; ++vit) {
+		if (const ConstantInt *ci = dyn_cast<ConstantInt>(vit->first)) {
+			globalJumpSet.insert(ci->getValue());
+		}
+	}
+
+	for (GenOprs::iterator oit = oprs.begin(), oend = oprs.end(); oit != oend; ++oit) {
+		const SigmaOp *sigma = dyn_cast<SigmaOp>(*oit);
+
+		if (!sigma || isa<SymbInterval>(sigma->getIntersect())) {
+			continue;
+		}
+
+		Range rintersect = sigma->getIntersect()->getRange();
+
+		const APInt lb = rintersect.getLower();
+		const APInt ub = rintersect.getUpper();
+
+		if (lb.ne(Min) && lb.ne(Max)) {
+			globalJumpSet.insert(lb);
+		}
+		if (ub.ne(Min) && ub.ne(Max)) {
+			globalJumpSet.insert(ub);
+		}
+	}
+
+	globalJumpSet.build();
 }
 
 /// Iterates through all instructions in the function and builds the graph.
 void ConstraintGraph::buildGraph(const Function& F) {
 	this->func = &F;
-	buildValueMaps(F);
 
 //	for (Function::const_arg_iterator ait = F.arg_begin(), aend = F.arg_end(); ait != aend; ++ait) {
 //		const Value *argument = &*ait;
@@ -2569,6 +3416,9 @@ void ConstraintGraph::buildGraph(const Function& F) {
 
 		buildOperations(&*I);
 	}
+
+	// The sigmas have taken their intervals
+	clearValueMaps();
 }
 
 void ConstraintGraph::buildVarNodes() {
@@ -2577,6 +3427,39 @@ void ConstraintGraph::buildVarNodes() {
 	for (; bgn != end; ++bgn) {
 		bgn->second->init(!this->defMap.count(bgn->first));
 	}
+
+	// The graph is complete; pack the use lists and drop the sets
+	uses.build(vars, useMap);
+	UseMap().swap(useMap);
+}
+
+void UseLists::build(VarNodes &vars, const UseMap &useMap) {
+	unsigned numUses = 0;
+	for (UseMap::const_iterator uit = useMap.begin(), uend = useMap.end();
+			uit != uend; ++uit) {
+		numUses += uit->second.size();
+	}
+
+	ops.clear();
+	ops.reserve(numUses);
+	for (VarNodes::iterator vit = vars.begin(), vend = vars.end();
+			vit != vend; ++vit) {
+		unsigned first = ops.size();
+		UseMap::const_iterator p = useMap.find(vit->first);
+
+		if (p != useMap.end()) {
+			ops.insert(ops.end(), p->second.begin(), p->second.end());
+		}
+		vit->second->setUses(first, ops.size());
+	}
+}
+
+void UseLists::unpack(const VarNodes &vars, UseMap &useMap) {
+	for (VarNodes::const_iterator vit = vars.begin(), vend = vars.end();
+			vit != vend; ++vit) {
+		useMap[vit->first].insert(begin(vit->second), end(vit->second));
+	}
+	std::vector<BasicOp*>().swap(ops);
 }
 
 //FIXME: do it just for component
@@ -2587,7 +3470,7 @@ void CropDFS::storeAbstractStates(const SmallPtrSet<VarNode*, 32> *component) {
 	}
 }
 
-bool Meet::fixed(BasicOp* op, const SmallVector<APInt, 2> *constantvector){
+bool Meet::fixed(BasicOp* op, const JumpSet *constantvector){
 	Range oldInterval = op->getSink()->getRange();
 	Range newInterval = op->eval();
 	
@@ -2602,11 +3485,15 @@ bool Meet::fixed(BasicOp* op, const SmallVector<APInt, 2> *constantvector){
 /// a constant interval, e.g., [3, 15]. After this analysis runs, there will
 /// be no undefined interval. Each variable will be either bound to a
 /// constant interval, or to [-, c], or to [c, +], or to [-, +].
-bool Meet::widen(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
+bool Meet::widen(BasicOp* op, const JumpSet *constantvector) {
+	return widenWith(op, op->eval(), constantvector);
+}
+
+bool Meet::widenWith(BasicOp* op, const Range &newInterval,
+		const JumpSet *constantvector) {
 	assert(constantvector != NULL && "Invalid pointer to constant vector");
 
 	Range oldInterval = op->getSink()->getRange();
-	Range newInterval = op->eval();
 
 	APInt oldLower = oldInterval.getLower();
 	APInt oldUpper = oldInterval.getUpper();
@@ -2614,8 +3501,8 @@ bool Meet::widen(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
 	APInt newUpper = newInterval.getUpper();
 
 	// Jump-set
-	APInt nlconstant = getFirstLessFromVector(*constantvector, newLower);
-	APInt nuconstant = getFirstGreaterFromVector(*constantvector, newUpper);
+	APInt nlconstant = constantvector->getFirstLess(newLower);
+	APInt nuconstant = constantvector->getFirstGreater(newUpper);
 
 	if (oldInterval.isUnknown()) {
 		op->getSink()->setRange(newInterval);
@@ -2638,9 +3525,13 @@ bool Meet::widen(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
 	return oldInterval != sinkInterval;
 }
 
-bool Meet::growth(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
+bool Meet::growth(BasicOp* op, const JumpSet *constantvector) {
+	return growthWith(op, op->eval(), constantvector);
+}
+
+bool Meet::growthWith(BasicOp* op, const Range &newInterval,
+		const JumpSet *constantvector) {
 	Range oldInterval = op->getSink()->getRange();
-	Range newInterval = op->eval();
 
 	if (oldInterval.isUnknown())
 		op->getSink()->setRange(newInterval);
@@ -2666,11 +3557,15 @@ bool Meet::growth(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
 /// analysis expands the bounds of each variable, regardless of intersections
 /// in the constraint graph, the cropping analysis shrinks these bounds back
 /// to ranges that respect the intersections.
-bool Meet::narrow(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
+bool Meet::narrow(BasicOp* op, const JumpSet *constantvector) {
+	return narrowWith(op, op->eval(), constantvector);
+}
+
+bool Meet::narrowWith(BasicOp* op, const Range &newInterval,
+		const JumpSet *constantvector) {
 
 	APInt oLower = op->getSink()->getRange().getLower();
 	APInt oUpper = op->getSink()->getRange().getUpper();
-	Range newInterval = op->eval();
 
 	APInt nLower = newInterval.getLower();
 	APInt nUpper = newInterval.getUpper();
@@ -2704,7 +3599,7 @@ bool Meet::narrow(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
 	return hasChanged;
 }
 
-bool Meet::crop(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
+bool Meet::crop(BasicOp* op, const JumpSet *constantvector) {
 	Range oldInterval = op->getSink()->getRange();
 	Range newInterval = op->eval();
 
@@ -2731,24 +3626,28 @@ bool Meet::crop(BasicOp* op, const SmallVector<APInt, 2> *constantvector) {
 }
 
 void Cousot::preUpdate(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& entryPoints) {
-	update(compUseMap, entryPoints, Meet::widen);
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector) {
+	update(compUseMap, entryPoints, Meet::widen, constantvector);
 }
 
 void Cousot::posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& entryPoints,
-		const SmallPtrSet<VarNode*, 32> *component) {
-	update(compUseMap, entryPoints, Meet::narrow);
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector) {
+	update(compUseMap, entryPoints, Meet::narrow, constantvector);
 }
 
 void CropDFS::preUpdate(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& entryPoints) {
-	update(compUseMap, entryPoints, Meet::growth);
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector) {
+	update(compUseMap, entryPoints, Meet::growth, constantvector);
 }
 
 void CropDFS::posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& entryPoints,
-		const SmallPtrSet<VarNode*, 32> *component) {
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector) {
 	storeAbstractStates(component);
 	GenOprs::iterator obgn = oprs.begin(), oend = oprs.end();
 	for (; obgn != oend; ++obgn) {
@@ -2763,6 +3662,62 @@ void CropDFS::posUpdate(const UseMap &compUseMap,
 	}
 }
 
+/// CropDFS pays for the growth once per operation, and for a search of the
+/// SCC from each intersection; Cousot's widening may move every variable
+/// once per constant of the jump-set.
+bool Adaptive::useCropDFS(const UseMap &compUseMap,
+		const JumpSet &constantvector) {
+	if (compUseMap.size() < raAdaptiveMinSize) {
+		return false;
+	}
+
+	uint64_t numOps = 0, numSigmas = 0;
+	for (UseMap::const_iterator uit = compUseMap.begin(), uend =
+			compUseMap.end(); uit != uend; ++uit) {
+		for (SmallPtrSetIterator<BasicOp*> oit = uit->second.begin(), oend =
+				uit->second.end(); oit != oend; ++oit) {
+			++numOps;
+			if (isa<SigmaOp>(*oit)) {
+				++numSigmas;
+			}
+		}
+	}
+
+	uint64_t cousotCost = numOps * (constantvector.size() + 1);
+	uint64_t cropCost = numOps + numSigmas * compUseMap.size();
+	return cropCost < cousotCost;
+}
+
+void Adaptive::preUpdate(const UseMap &compUseMap,
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector) {
+	if (useCropDFS(compUseMap, constantvector)) {
+		++numCropDFSSCCs;
+		CropDFS::preUpdate(compUseMap, entryPoints, constantvector);
+		return;
+	}
+
+	++numCousotSCCs;
+	if (!update(compUseMap, entryPoints, Meet::widen, constantvector,
+			raWideningCap * compUseMap.size())) {
+		++numCappedWidenings;
+		update(compUseMap, entryPoints, Meet::growth, constantvector);
+	}
+}
+
+void Adaptive::posUpdate(const UseMap &compUseMap,
+		SmallPtrSet<const Value*, 6>& activeVars,
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector) {
+	// The same choice as preUpdate, which can't keep it: the SCCs may be
+	// solved by several threads
+	if (useCropDFS(compUseMap, constantvector)) {
+		CropDFS::posUpdate(compUseMap, activeVars, component, constantvector);
+	} else {
+		update(compUseMap, activeVars, Meet::narrow, constantvector);
+	}
+}
+
 void CropDFS::crop(const UseMap &compUseMap, BasicOp *op) {
 	SmallPtrSet<BasicOp*, 8> activeOps;
 	SmallPtrSet<const VarNode*, 8> visitedOps;
@@ -2793,8 +3748,192 @@ void CropDFS::crop(const UseMap &compUseMap, BasicOp *op) {
 	}
 }
 
-void ConstraintGraph::update(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& actv, bool(*meet)(BasicOp* op, const SmallVector<APInt, 2> *constantvector)) {
+/// The additions and subtractions of an SCC, evaluated together: the bounds
+/// of their operands are gathered in arrays, one per bound, and the loops
+/// that find the bounds of the results have no branches, so that the
+/// compiler can vectorize them. They give the same ranges as
+/// BinaryOp::eval; the operations it can't do this way, because their
+/// operands aren't regular ranges of up to 64 bits or they have an
+/// intersection, go through BinaryOp::eval.
+class BinaryOpBatch {
+private:
+	// The additions, then the subtractions
+	std::vector<BinaryOp*> ops;
+	unsigned numAdds;
+	// The bounds of the operands, [a, b] and [c, d], and of the results
+	std::vector<int64_t> a, b, c, d, l, u;
+
+	static void addBounds(const int64_t *a, const int64_t *b,
+			const int64_t *c, const int64_t *d, int64_t *l, int64_t *u,
+			unsigned n, unsigned width);
+	static void subBounds(const int64_t *a, const int64_t *b,
+			const int64_t *c, const int64_t *d, int64_t *l, int64_t *u,
+			unsigned n, unsigned width);
+
+public:
+	/// Takes the additions and subtractions out of ops.
+	explicit BinaryOpBatch(std::vector<BasicOp*> &ops);
+	bool empty() const {return ops.empty();}
+	unsigned size() const {return ops.size();}
+	BasicOp *getOp(unsigned i) const {return ops[i];}
+	/// Evaluates every operation, in results.
+	void evaluate(std::vector<Range> &results);
+};
+
+BinaryOpBatch::BinaryOpBatch(std::vector<BasicOp*> &others) {
+	std::vector<BinaryOp*> subs;
+	std::vector<BasicOp*>::iterator rest = others.begin();
+	for (std::vector<BasicOp*>::iterator oit = others.begin(), oend =
+			others.end(); oit != oend; ++oit) {
+		BinaryOp *bop = dyn_cast<BinaryOp>(*oit);
+		if (bop && bop->getOpcode() == Instruction::Add) {
+			ops.push_back(bop);
+		} else if (bop && bop->getOpcode() == Instruction::Sub) {
+			subs.push_back(bop);
+		} else {
+			*rest++ = *oit;
+		}
+	}
+	others.erase(rest, others.end());
+
+	numAdds = ops.size();
+	ops.insert(ops.end(), subs.begin(), subs.end());
+}
+
+void BinaryOpBatch::addBounds(const int64_t *a, const int64_t *b,
+		const int64_t *c, const int64_t *d, int64_t *l, int64_t *u,
+		unsigned n, unsigned width) {
+	const int64_t min = Range::minValue(width), max = Range::maxValue(width);
+	for (unsigned i = 0; i < n; ++i) {
+		int64_t lw = Range::wrap((uint64_t)a[i] + (uint64_t)c[i], width);
+		int64_t uw = Range::wrap((uint64_t)b[i] + (uint64_t)d[i], width);
+		// The sum overflows if the operands have the same sign, which the
+		// sum doesn't have
+		bool lo = ((a[i] ^ c[i]) >= 0) & ((a[i] ^ lw) < 0);
+		bool uo = ((b[i] ^ d[i]) >= 0) & ((b[i] ^ uw) < 0);
+		l[i] = ((a[i] == min) | (c[i] == min) | lo) ? min : lw;
+		u[i] = ((b[i] == max) | (d[i] == max) | uo) ? max : uw;
+	}
+}
+
+void BinaryOpBatch::subBounds(const int64_t *a, const int64_t *b,
+		const int64_t *c, const int64_t *d, int64_t *l, int64_t *u,
+		unsigned n, unsigned width) {
+	const int64_t min = Range::minValue(width), max = Range::maxValue(width);
+	for (unsigned i = 0; i < n; ++i) {
+		int64_t lw = Range::wrap((uint64_t)a[i] - (uint64_t)d[i], width);
+		int64_t uw = Range::wrap((uint64_t)b[i] - (uint64_t)c[i], width);
+		l[i] = ((a[i] == min) | (d[i] == max)) ? min : lw;
+		u[i] = ((b[i] == max) | (c[i] == min)) ? max : uw;
+	}
+}
+
+void BinaryOpBatch::evaluate(std::vector<Range> &results) {
+	unsigned n = ops.size(), width = MAX_BIT_INT;
+	results.resize(n);
+	if (width > 64) {
+		for (unsigned i = 0; i < n; ++i) {
+			results[i] = getOp(i)->eval();
+		}
+		return;
+	}
+
+	a.resize(n), b.resize(n), c.resize(n), d.resize(n), l.resize(n), u.resize(n);
+	std::vector<bool> gathered(n);
+	for (unsigned i = 0; i < n; ++i) {
+		Range op1 = ops[i]->getSource1()->getRange();
+		Range op2 = ops[i]->getSource2()->getRange();
+		gathered[i] = op1.isRegular() && op2.isRegular()
+				&& op1.width == width && op2.width == width
+				&& ops[i]->getIntersect()->getRange().isMaxRange();
+		a[i] = op1.sl, b[i] = op1.su, c[i] = op2.sl, d[i] = op2.su;
+	}
+
+	addBounds(&a[0], &b[0], &c[0], &d[0], &l[0], &u[0], numAdds, width);
+	subBounds(&a[numAdds], &b[numAdds], &c[numAdds], &d[numAdds], &l[numAdds],
+			&u[numAdds], n - numAdds, width);
+
+	for (unsigned i = 0; i < n; ++i) {
+		if (!gathered[i]) {
+			results[i] = getOp(i)->eval();
+		} else if (l[i] > u[i]) {
+			results[i] = Range(Range::minValue(width), Range::maxValue(width),
+					width);
+		} else {
+			results[i] = Range(l[i], u[i], width);
+		}
+	}
+}
+
+/// Applies meet, which must be widen, growth or narrow, to every operation
+/// of the SCC in rounds, until a round changes nothing. The additions and
+/// subtractions of each round are evaluated together, on the ranges of the
+/// round before. Returns false if it stopped after maxIterations, with the
+/// whole SCC in actv.
+static bool updateInRounds(const UseMap &compUseMap,
+		SmallPtrSet<const Value*, 6>& actv,
+		bool (*meet)(BasicOp* op, const JumpSet *constantvector),
+		const JumpSet &constantvector, unsigned maxIterations) {
+	bool (*meetWith)(BasicOp* op, const Range &newInterval,
+			const JumpSet *constantvector) = Meet::narrowWith;
+	if (meet == Meet::widen) {
+		meetWith = Meet::widenWith;
+	} else if (meet == Meet::growth) {
+		meetWith = Meet::growthWith;
+	}
+
+	SmallPtrSet<BasicOp*, 64> seen;
+	std::vector<BasicOp*> others;
+	for (UseMap::const_iterator uit = compUseMap.begin(), uend =
+			compUseMap.end(); uit != uend; ++uit) {
+		for (SmallPtrSetIterator<BasicOp*> oit = uit->second.begin(), oend =
+				uit->second.end(); oit != oend; ++oit) {
+			if (!seen.count(*oit)) {
+				seen.insert(*oit);
+				others.push_back(*oit);
+			}
+		}
+	}
+	BinaryOpBatch batch(others);
+
+	std::vector<Range> results;
+	unsigned iterations = 0;
+	actv.clear();
+	for (bool changed = true; changed;) {
+		if (maxIterations && iterations >= maxIterations) {
+			for (UseMap::const_iterator uit = compUseMap.begin(), uend =
+					compUseMap.end(); uit != uend; ++uit) {
+				actv.insert(uit->first);
+			}
+			return false;
+		}
+		iterations += batch.size() + others.size();
+#ifdef STATS
+		++updateIterations;
+#endif
+
+		changed = false;
+		batch.evaluate(results);
+		for (unsigned i = 0, e = batch.size(); i < e; ++i) {
+			changed |= meetWith(batch.getOp(i), results[i], &constantvector);
+		}
+		for (unsigned i = 0, e = others.size(); i < e; ++i) {
+			changed |= meet(others[i], &constantvector);
+		}
+	}
+	return true;
+}
+
+bool ConstraintGraph::update(const UseMap &compUseMap,
+		SmallPtrSet<const Value*, 6>& actv, bool(*meet)(BasicOp* op, const JumpSet *constantvector),
+		const JumpSet &constantvector, unsigned maxIterations) {
+	if (raBatchEval && (meet == Meet::widen || meet == Meet::growth
+			|| meet == Meet::narrow)) {
+		return updateInRounds(compUseMap, actv, meet, constantvector,
+				maxIterations);
+	}
+
+	unsigned iterations = 0;
 	/* Breaks during narrowing. */
 	/* dbgs() << "actv = " << "{ ";
 	for (SmallPtrSetIterator<const Value*> i = actv.begin(), e = actv.end(); i != e; ++i) { 
@@ -2803,11 +3942,17 @@ void ConstraintGraph::update(const UseMap &compUseMap,
 	dbgs() << "};\n";
 	*/
 	while (!actv.empty()) {
+		if (maxIterations && iterations++ == maxIterations) {
+			return false;
+		}
+
 		const Value* V = *actv.begin();
                 // dbgs() << "const Value* V = " << **actv.begin() << ";\n";
 		actv.erase(V);
 		
 #ifdef STATS
+		++updateIterations;
+
 		// Updates Fermap
 		if (meet == Meet::narrow) {
 			FerMap[V]++;
@@ -2834,6 +3979,7 @@ void ConstraintGraph::update(const UseMap &compUseMap,
 			}
 		}
 	}
+	return true;
 }
 
 void ConstraintGraph::update(unsigned nIterations, const UseMap &compUseMap,
@@ -2854,22 +4000,170 @@ void ConstraintGraph::update(unsigned nIterations, const UseMap &compUseMap,
 	}
 }
 
+/// Evaluates an operation that uses a variable of a solved SCC.
+static void propagateOp(BasicOp *op) {
+	SigmaOp *sigmaop = dyn_cast<SigmaOp>(op);
+
+	op->getSink()->setRange(op->eval());
+
+	if (sigmaop && sigmaop->getIntersect()->getRange().isUnknown()) {
+		sigmaop->markUnresolved();
+	}
+}
+
+/// The DAG of the SCCs of a constraint graph and the state of the threads
+/// solving it. SCCs are numbered in the topological order of Nuutila.
+struct SCCSchedule {
+	// Owned if the schedule is kept for demand-driven queries
+	Nuutila *sccList;
+	ConstraintGraph *CG;
+	std::vector<SmallPtrSet<VarNode*, 32>*> components;
+	DenseMap<const VarNode*, unsigned> sccOf;
+	// The operations that other SCCs propagate into each SCC, in the order
+	// the sequential loop of findIntervals evaluates them
+	std::vector<std::vector<BasicOp*> > incoming;
+	std::vector<std::vector<unsigned> > successors;
+	std::vector<std::vector<unsigned> > predecessors;
+	// The SCCs to solve in this run, and the ones solved by earlier runs
+	std::vector<bool> selected;
+	std::vector<bool> solved;
+	// Number of selected predecessors of each SCC that are not done yet
+	std::vector<unsigned> pending;
+	std::vector<unsigned> ready;
+	unsigned numSelected;
+	unsigned numDone;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	// The context of the analysis, for the workers
+	RangeContext *context;
+
+	SCCSchedule() : sccList(NULL), CG(NULL), numSelected(0), numDone(0),
+		context(NULL) {}
+	~SCCSchedule() {
+		delete sccList;
+	}
+};
+
+static void* runSCCJobs(void* arg) {
+	SCCSchedule* S = (SCCSchedule*) arg;
+	RangeContext::install(*S->context);
+
+	pthread_mutex_lock(&S->lock);
+	while (true) {
+		while (S->ready.empty() && S->numDone < S->numSelected)
+			pthread_cond_wait(&S->changed, &S->lock);
+		if (S->ready.empty())
+			break;
+
+		unsigned scc = S->ready.back();
+		S->ready.pop_back();
+		pthread_mutex_unlock(&S->lock);
+
+		// Every SCC this one depends on is done, so its entry values don't
+		// depend on how the SCCs were scheduled
+		std::vector<BasicOp*> &ops = S->incoming[scc];
+		for (unsigned i = 0; i < ops.size(); ++i)
+			propagateOp(ops[i]);
+
+		SmallPtrSet<VarNode*, 32> &component = *S->components[scc];
+		S->CG->solveSCC(component);
+		S->CG->propagateToNextSCC(component, true);
+
+		pthread_mutex_lock(&S->lock);
+		++S->numDone;
+		std::vector<unsigned> &succs = S->successors[scc];
+		for (unsigned i = 0; i < succs.size(); ++i)
+			if (S->selected[succs[i]] && --S->pending[succs[i]] == 0)
+				S->ready.push_back(succs[i]);
+		pthread_cond_broadcast(&S->changed);
+	}
+	pthread_mutex_unlock(&S->lock);
+	return 0;
+}
+
+/// Solves the selected SCCs of S, each one as soon as the SCCs it depends
+/// on are done, and returns how many were solved. The predecessors of a
+/// selected SCC must be selected or solved.
+static unsigned runSCCSchedule(SCCSchedule &S, unsigned numThreads) {
+	unsigned numSCCs = S.components.size();
+	S.solved.resize(numSCCs, false);
+	S.pending.assign(numSCCs, 0);
+	S.numSelected = 0;
+	for (unsigned scc = 0; scc < numSCCs; ++scc) {
+		if (!S.selected[scc]) {
+			continue;
+		}
+
+		++S.numSelected;
+		std::vector<unsigned> &succs = S.successors[scc];
+		for (unsigned i = 0; i < succs.size(); ++i) {
+			++S.pending[succs[i]];
+		}
+	}
+
+	// The workers take the ready SCCs from the back
+	S.ready.clear();
+	for (unsigned scc = numSCCs; scc-- > 0;) {
+		if (S.selected[scc] && S.pending[scc] == 0) {
+			S.ready.push_back(scc);
+		}
+	}
+	S.numDone = 0;
+	S.context = &RangeContext::current();
+	pthread_mutex_init(&S.lock, 0);
+	pthread_cond_init(&S.changed, 0);
+
+	std::vector<pthread_t> threads(numThreads - 1);
+	for (unsigned t = 0; t < threads.size(); ++t) {
+		if (pthread_create(&threads[t], 0, runSCCJobs, &S) != 0) {
+			threads.resize(t);
+			break;
+		}
+	}
+	runSCCJobs(&S);
+	for (unsigned t = 0; t < threads.size(); ++t) {
+		pthread_join(threads[t], 0);
+	}
+
+	pthread_cond_destroy(&S.changed);
+	pthread_mutex_destroy(&S.lock);
+
+	for (unsigned scc = 0; scc < numSCCs; ++scc) {
+		if (S.selected[scc]) {
+			S.solved[scc] = true;
+		}
+	}
+	return S.numDone;
+}
+
+static unsigned getNumThreads() {
+#if defined(STATS) || defined(LOG_TRANSACTIONS) || defined(PRINT_DEBUG)
+	// The profile, the transaction log and the dot files aren't thread safe
+	return 1;
+#else
+	return raThreads.getNumOccurrences() ? raThreads
+			: RangeContext::current().threads;
+#endif
+}
+
 /// Finds the intervals of the variables in the graph.
 void ConstraintGraph::findIntervals() {
+	PassProfileScope scope("findIntervals", "range analysis");
 //	clearValueMaps();
 
 	// Builds symbMap
 #ifdef STATS
-	Profile::TimeValue before = prof.timenow();
+	prof.beginPhase("Nuutila");
 #endif
 	buildSymbolicIntersectMap();
+	if (raGlobalJumpSet) {
+		buildGlobalJumpSet();
+	}
 
 	// List of SCCs
-	Nuutila sccList(&vars, &useMap, &symbMap);
+	Nuutila sccList(&vars, &uses, &symbMap);
 #ifdef STATS
-	Profile::TimeValue after = prof.timenow();
-	Profile::TimeValue elapsed = after - before;
-	prof.updateTime("Nuutila", elapsed);
+	prof.endPhase();
 #endif
 	// STATS
 	numSCCs += sccList.worklist.size();
@@ -2879,97 +4173,478 @@ void ConstraintGraph::findIntervals() {
 
 	// For each SCC in graph, do the following
 #ifdef STATS
-	before = prof.timenow();
+	prof.beginPhase("SCCs resolution");
 #endif
 	
 	for (Nuutila::iterator nit = sccList.begin(), nend = sccList.end();
 			nit != nend; ++nit) {
-		SmallPtrSet<VarNode*, 32> &component = *sccList.components[*nit];
+		unsigned size = sccList.components[*nit]->size();
+		if (size == 1) {
+			++numAloneSCCs;
+		} else if (size > sizeMaxSCC) {
+			sizeMaxSCC = size;
+		}
+	}
+
+	unsigned numThreads = getNumThreads();
+	if (numThreads > 1 && sccList.worklist.size() > 1) {
+		SCCSchedule S;
+		buildSCCSchedule(sccList, S);
+		S.selected.assign(S.components.size(), true);
 #ifdef SCC_DEBUG
-		--numberOfSCCs;
+		numberOfSCCs -= runSCCSchedule(S, numThreads);
+#else
+		runSCCSchedule(S, numThreads);
 #endif
-		//PRINTCOMPONENT(component)
+	} else {
+		for (Nuutila::iterator nit = sccList.begin(), nend = sccList.end();
+				nit != nend; ++nit) {
+			SmallPtrSet<VarNode*, 32> &component = *sccList.components[*nit];
+#ifdef SCC_DEBUG
+			--numberOfSCCs;
+#endif
+			solveSCC(component);
+			propagateToNextSCC(component);
+		}
+	}
 
-		if (component.size() == 1) {
-			++numAloneSCCs;
-			fixIntersects(component);
-			
-			VarNode *var = *component.begin();
-			if (var->getRange().isUnknown()) {
-				var->setRange(Range(Min, Max));
-			}
-		}else{
-			if (component.size() > sizeMaxSCC) {
-				sizeMaxSCC = component.size();
-			}
+#ifdef STATS
+	prof.endPhase();
+#endif
 
-			UseMap compUseMap = buildUseMap(component);
+#ifdef SCC_DEBUG
+	ASSERT(numberOfSCCs==0, "Not all SCCs have been visited")
+#endif
 
-			// Get the entry points of the SCC
-			SmallPtrSet<const Value*, 6> entryPoints;
-			
+#ifdef STATS
+	prof.beginPhase("ComputeStats");
+	computeStats();
+	prof.endPhase();
+#endif
+}
+
+void ConstraintGraph::solveSCC(SmallPtrSet<VarNode*, 32> &component) {
+#ifdef STATS
+	updateIterations = 0;
+#endif
+	if (component.size() == 1) {
+		fixIntersects(component);
+		
+		VarNode *var = *component.begin();
+		if (var->getRange().isUnknown()) {
+			var->setRange(Range(Min, Max));
+		}
+	}else{
+		UseMap compUseMap = buildUseMap(component);
+		JumpSet constantvector(raGlobalJumpSet ? &globalJumpSet : NULL);
+
+		// Get the entry points of the SCC
+		SmallPtrSet<const Value*, 6> entryPoints;
+		
 #ifdef JUMPSET
-			// Create vector of constants inside component
-			// Comment this line below to deactivate jump-set
-			buildConstantVector(component, compUseMap);
+		// Create vector of constants inside component
+		// Comment this line below to deactivate jump-set
+		buildConstantVector(component, compUseMap, constantvector);
 #endif
 
-			//generateEntryPoints(component, entryPoints);
-			//iterate a fixed number of time before widening
-			//update(component.size()*2 /*| NUMBER_FIXED_ITERATIONS*/, compUseMap, entryPoints);
+		//generateEntryPoints(component, entryPoints);
+		//iterate a fixed number of time before widening
+		//update(component.size()*2 /*| NUMBER_FIXED_ITERATIONS*/, compUseMap, entryPoints);
 
 #ifdef PRINT_DEBUG
-			if (func)
-				printToFile(*func, "/tmp/" + func->getName() + "cgfixed.dot");
+		if (func)
+			printToFile(*func, "/tmp/" + func->getName() + "cgfixed.dot");
 #endif
+		
+		// Primeiro iterate till fix point
+		generateEntryPoints(component, entryPoints);
+#ifdef STATS
+		prof.beginPhase("Widening");
+#endif
+		// Primeiro iterate till fix point
+		preUpdate(compUseMap, entryPoints, constantvector);
+#ifdef STATS
+		prof.endPhase();
+#endif
+		fixIntersects(component);
+		
+		// FIXME: Ensure that this code is not needed
+		for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend = component.end(); cit != cend; ++cit) {
+			VarNode* var = *cit;
 			
-			// Primeiro iterate till fix point
-			generateEntryPoints(component, entryPoints);
-			// Primeiro iterate till fix point
-			preUpdate(compUseMap, entryPoints);
-			fixIntersects(component);
-			
-			// FIXME: Ensure that this code is not needed
-			for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend = component.end(); cit != cend; ++cit) {
-				VarNode* var = *cit;
-				
-				if (var->getRange().isUnknown()) {
-					var->setRange(Range(Min, Max));
-				}
+			if (var->getRange().isUnknown()) {
+				var->setRange(Range(Min, Max));
 			}
+		}
 
-			//printResultIntervals();
+		//printResultIntervals();
 #ifdef PRINT_DEBUG
-			if (func)
-				printToFile(*func, "/tmp/" + func->getName() + "cgint.dot");
+		if (func)
+			printToFile(*func, "/tmp/" + func->getName() + "cgint.dot");
 #endif
 
-			// Segundo iterate till fix point
-			SmallPtrSet<const Value*, 6> activeVars;
-			generateActivesVars(component, activeVars);
+		// Segundo iterate till fix point
+		SmallPtrSet<const Value*, 6> activeVars;
+		generateActivesVars(component, activeVars);
                         /* Loop starts here. */
-			posUpdate(compUseMap, activeVars, &component);
-		}
-		propagateToNextSCC(component);
-	}
-
 #ifdef STATS
-	elapsed = prof.timenow() - before;
-	prof.updateTime("SCCs resolution", elapsed);
+		prof.beginPhase("Narrowing");
 #endif
-
-#ifdef SCC_DEBUG
-	ASSERT(numberOfSCCs==0, "Not all SCCs have been visited")
+		posUpdate(compUseMap, activeVars, &component, constantvector);
+#ifdef STATS
+		prof.endPhase();
 #endif
-
+	}
 #ifdef STATS
-	before = prof.timenow();
-	computeStats();
-	elapsed = prof.timenow() - before;
-	prof.updateTime("ComputeStats", elapsed);
+	prof.addSCC(component.size(), updateIterations);
 #endif
 }
 
+/// Adds the edge from scc to the SCC of the sink of op, if it is another
+/// one, and op to the operations propagated into that SCC.
+static void addSCCEdge(SCCSchedule &S, std::vector<unsigned> &lastEdge,
+		unsigned scc, BasicOp *op, bool propagated) {
+	DenseMap<const VarNode*, unsigned>::iterator sink =
+			S.sccOf.find(op->getSink());
+	if (sink == S.sccOf.end() || sink->second == scc) {
+		return;
+	}
+
+	if (propagated) {
+		S.incoming[sink->second].push_back(op);
+	}
+	if (lastEdge[sink->second] != scc) {
+		lastEdge[sink->second] = scc;
+		S.successors[scc].push_back(sink->second);
+		S.predecessors[sink->second].push_back(scc);
+	}
+}
+
+void ConstraintGraph::buildSCCSchedule(Nuutila &sccList, SCCSchedule &S) {
+	S.CG = this;
+	for (Nuutila::iterator nit = sccList.begin(), nend = sccList.end();
+			nit != nend; ++nit) {
+		SmallPtrSet<VarNode*, 32> *component = sccList.components[*nit];
+		for (SmallPtrSetIterator<VarNode*> cit = component->begin(), cend =
+				component->end(); cit != cend; ++cit) {
+			S.sccOf[*cit] = S.components.size();
+		}
+		S.components.push_back(component);
+	}
+
+	unsigned numSCCs = S.components.size();
+	S.incoming.resize(numSCCs);
+	S.successors.resize(numSCCs);
+	S.predecessors.resize(numSCCs);
+
+	// An SCC depends on the SCCs whose variables its operations use, either
+	// as sources (useMap) or as bounds of their intersections (symbMap)
+	std::vector<unsigned> lastEdge(numSCCs, numSCCs);
+	for (unsigned scc = 0; scc < numSCCs; ++scc) {
+		SmallPtrSet<VarNode*, 32> &component = *S.components[scc];
+		for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend =
+				component.end(); cit != cend; ++cit) {
+			VarNode *var = *cit;
+
+			for (UseLists::iterator sit = uses.begin(var), send = uses.end(var);
+					sit != send; ++sit) {
+				addSCCEdge(S, lastEdge, scc, *sit, true);
+			}
+
+			SymbMap::iterator p = symbMap.find(var->getValue());
+			if (p == symbMap.end()) {
+				continue;
+			}
+
+			for (SmallPtrSetIterator<BasicOp*> sit = p->second.begin(), send =
+					p->second.end(); sit != send; ++sit) {
+				addSCCEdge(S, lastEdge, scc, *sit, false);
+			}
+		}
+	}
+}
+
+/// Finds the intervals of the queried values, solving only the SCCs they
+/// depend on. The SCCs are computed by the first query and kept, with the
+/// intervals found, for the next ones.
+void ConstraintGraph::findIntervals(const SmallVectorImpl<const Value*> &queries) {
+	if (!demand) {
+		buildSymbolicIntersectMap();
+		if (raGlobalJumpSet) {
+			buildGlobalJumpSet();
+		}
+		demand = new SCCSchedule();
+		demand->sccList = new Nuutila(&vars, &uses, &symbMap);
+		numSCCs += demand->sccList->worklist.size();
+		buildSCCSchedule(*demand->sccList, *demand);
+	}
+
+	SCCSchedule &S = *demand;
+	S.solved.resize(S.components.size(), false);
+	S.selected.assign(S.components.size(), false);
+
+	// Select the unsolved SCCs the queries depend on
+	std::vector<unsigned> worklist;
+	for (unsigned i = 0, e = queries.size(); i < e; ++i) {
+		VarNodes::iterator vit = vars.find(queries[i]);
+		if (vit == vars.end()) {
+			continue;
+		}
+
+		DenseMap<const VarNode*, unsigned>::iterator sit =
+				S.sccOf.find(vit->second);
+		if (sit == S.sccOf.end()) {
+			continue;
+		}
+
+		unsigned scc = sit->second;
+		if (!S.solved[scc] && !S.selected[scc]) {
+			S.selected[scc] = true;
+			worklist.push_back(scc);
+		}
+	}
+
+	if (worklist.empty()) {
+		return;
+	}
+
+	while (!worklist.empty()) {
+		unsigned scc = worklist.back();
+		worklist.pop_back();
+
+		unsigned size = S.components[scc]->size();
+		if (size == 1) {
+			++numAloneSCCs;
+		} else if (size > sizeMaxSCC) {
+			sizeMaxSCC = size;
+		}
+
+		std::vector<unsigned> &preds = S.predecessors[scc];
+		for (unsigned i = 0; i < preds.size(); ++i) {
+			if (!S.solved[preds[i]] && !S.selected[preds[i]]) {
+				S.selected[preds[i]] = true;
+				worklist.push_back(preds[i]);
+			}
+		}
+	}
+
+	runSCCSchedule(S, getNumThreads());
+}
+
+void ConstraintGraph::removeOperation(BasicOp *op) {
+	if (!oprs.erase(op)) {
+		return;
+	}
+
+	DefMap::iterator dit = defMap.find(op->getSink()->getValue());
+	if (dit != defMap.end() && dit->second == op) {
+		defMap.erase(dit);
+	}
+
+	SmallVector<const VarNode*, 2> sources;
+	if (UnaryOp *uop = dyn_cast<UnaryOp>(op)) {
+		sources.push_back(uop->getSource());
+	} else if (BinaryOp *bop = dyn_cast<BinaryOp>(op)) {
+		sources.push_back(bop->getSource1());
+		sources.push_back(bop->getSource2());
+	} else if (PhiOp *pop = dyn_cast<PhiOp>(op)) {
+		for (unsigned i = 0, e = pop->getNumSources(); i < e; ++i) {
+			sources.push_back(pop->getSource(i));
+		}
+	}
+
+	for (unsigned i = 0, e = sources.size(); i < e; ++i) {
+		UseMap::iterator uit = useMap.find(sources[i]->getValue());
+		if (uit != useMap.end()) {
+			uit->second.erase(op);
+		}
+	}
+
+	// The allocator keeps the memory until clear
+	op->~BasicOp();
+}
+
+void ConstraintGraph::removeFunctions(
+		const SmallPtrSet<const Function*, 8> &changed,
+		SmallPtrSet<const Function*, 8> &rematch) {
+	uses.unpack(vars, useMap);
+	updating = true;
+
+	// The values of these nodes may be deleted, so only their addresses
+	// are used from here on
+	SmallPtrSet<VarNode*, 32> removed;
+	for (SmallPtrSetIterator<const Function*> fit = changed.begin(), fend =
+			changed.end(); fit != fend; ++fit) {
+		DenseMap<const Function*, std::vector<VarNode*> >::iterator p =
+				funcVars.find(*fit);
+		if (p == funcVars.end()) {
+			continue;
+		}
+
+		removed.insert(p->second.begin(), p->second.end());
+		funcVars.erase(p);
+	}
+
+	// The operations that define the nodes go with them
+	std::vector<BasicOp*> ops;
+	for (GenOprs::iterator oit = oprs.begin(), oend = oprs.end(); oit != oend;
+			++oit) {
+		if (removed.count((*oit)->getSink())) {
+			ops.push_back(*oit);
+		}
+	}
+
+	// and so do the ones that pass their values to other functions
+	for (SmallPtrSetIterator<VarNode*> vit = removed.begin(), vend =
+			removed.end(); vit != vend; ++vit) {
+		UseMap::iterator p = useMap.find((*vit)->getValue());
+		if (p == useMap.end()) {
+			continue;
+		}
+
+		for (SmallPtrSetIterator<BasicOp*> sit = p->second.begin(), send =
+				p->second.end(); sit != send; ++sit) {
+			VarNode *sink = (*sit)->getSink();
+			if (removed.count(sink)) {
+				continue;
+			}
+
+			// A matcher of the parameters of a function that didn't change:
+			// all of them are built again
+			if (const Argument *A = dyn_cast<Argument>(sink->getValue())) {
+				rematch.insert(A->getParent());
+			}
+			ops.push_back(*sit);
+			dirty.push_back(sink);
+		}
+	}
+
+	for (unsigned i = 0, e = ops.size(); i < e; ++i) {
+		removeOperation(ops[i]);
+	}
+
+	for (SmallPtrSetIterator<VarNode*> vit = removed.begin(), vend =
+			removed.end(); vit != vend; ++vit) {
+		const Value *V = (*vit)->getValue();
+		vars.erase(V);
+		defMap.erase(V);
+		useMap.erase(V);
+		(*vit)->~VarNode();
+	}
+}
+
+void ConstraintGraph::removeMatcher(const Value *V) {
+	VarNodes::iterator vit = vars.find(V);
+	if (vit == vars.end()) {
+		return;
+	}
+
+	dirty.push_back(vit->second);
+
+	DefMap::iterator dit = defMap.find(V);
+	if (dit != defMap.end() && isa<PhiOp>(dit->second)
+			&& !dit->second->getInstruction()) {
+		removeOperation(dit->second);
+	}
+}
+
+void ConstraintGraph::removeMatchers(Function &F) {
+	for (Function::arg_iterator ait = F.arg_begin(), aend = F.arg_end();
+			ait != aend; ++ait) {
+		removeMatcher(&*ait);
+	}
+
+	for (Value::use_iterator UI = F.use_begin(), E = F.use_end(); UI != E;
+			++UI) {
+		User *U = *UI;
+		if (!isa<CallInst>(U) && !isa<InvokeInst>(U))
+			continue;
+
+		CallSite CS(cast<Instruction>(U));
+		if (CS.isCallee(UI))
+			removeMatcher(U);
+	}
+}
+
+/// Whether the SCC of V was solved in the old schedule S.
+static bool wasSolved(const SCCSchedule *S, const VarNode *V) {
+	if (!S) {
+		return false;
+	}
+
+	DenseMap<const VarNode*, unsigned>::const_iterator sit = S->sccOf.find(V);
+	return sit != S->sccOf.end() && sit->second < S->solved.size()
+			&& S->solved[sit->second];
+}
+
+void ConstraintGraph::finishUpdate(bool lazy) {
+	updating = false;
+	uses.build(vars, useMap);
+	UseMap().swap(useMap);
+
+	// The old SCCs don't hold anymore, but tell which ones were solved
+	SCCSchedule *old = demand;
+	demand = NULL;
+
+	buildSymbolicIntersectMap();
+	if (raGlobalJumpSet) {
+		buildGlobalJumpSet();
+	}
+	SCCSchedule *S = new SCCSchedule();
+	S->sccList = new Nuutila(&vars, &uses, &symbMap);
+	buildSCCSchedule(*S->sccList, *S);
+
+	// Select the SCCs that depend on the changed constraints
+	unsigned numComponents = S->components.size();
+	S->selected.assign(numComponents, false);
+	std::vector<unsigned> worklist;
+	for (unsigned i = 0, e = dirty.size(); i < e; ++i) {
+		DenseMap<const VarNode*, unsigned>::iterator sit = S->sccOf.find(dirty[i]);
+		if (sit != S->sccOf.end() && !S->selected[sit->second]) {
+			S->selected[sit->second] = true;
+			worklist.push_back(sit->second);
+		}
+	}
+	std::vector<VarNode*>().swap(dirty);
+
+	while (!worklist.empty()) {
+		unsigned scc = worklist.back();
+		worklist.pop_back();
+
+		std::vector<unsigned> &succs = S->successors[scc];
+		for (unsigned i = 0; i < succs.size(); ++i) {
+			if (!S->selected[succs[i]]) {
+				S->selected[succs[i]] = true;
+				worklist.push_back(succs[i]);
+			}
+		}
+	}
+
+	// The others have the same constraints as before, and so the same
+	// ranges; the selected ones start over
+	S->solved.assign(numComponents, false);
+	for (unsigned scc = 0; scc < numComponents; ++scc) {
+		SmallPtrSet<VarNode*, 32> &component = *S->components[scc];
+		if (!S->selected[scc]) {
+			S->solved[scc] = !lazy || wasSolved(old, *component.begin());
+			continue;
+		}
+
+		for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend =
+				component.end(); cit != cend; ++cit) {
+			(*cit)->init(!defMap.count((*cit)->getValue()));
+		}
+	}
+	delete old;
+
+	if (lazy) {
+		demand = S;
+	} else {
+		runSCCSchedule(*S, getNumThreads());
+		delete S;
+	}
+}
+
 void ConstraintGraph::generateEntryPoints(SmallPtrSet<VarNode*, 32> &component
 		, SmallPtrSet<const Value*, 6> &entryPoints) {
 	if (!entryPoints.empty()) {
@@ -3052,7 +4727,31 @@ void ConstraintGraph::generateActivesVars(SmallPtrSet<VarNode*, 32> &component
 // TODO: To implement it.
 /// Releases the memory used by the graph.
 void ConstraintGraph::clear() {
+	delete demand;
+	demand = NULL;
+
+	// The nodes and the operations live in the allocator, which releases
+	// them at once; only their destructors are left to run
+	for (VarNodes::iterator vit = vars.begin(), vend = vars.end();
+			vit != vend; ++vit) {
+		vit->second->~VarNode();
+	}
+
+	for (GenOprs::iterator oit = oprs.begin(), oend = oprs.end(); oit != oend;
+			++oit) {
+		(*oit)->~BasicOp();
+	}
 
+	vars.clear();
+	oprs.clear();
+	defMap.clear();
+	useMap.clear();
+	symbMap.clear();
+	funcVars.clear();
+	dirty.clear();
+	updating = false;
+	uses = UseLists();
+	allocator.Reset();
 }
 
 /// Prints the content of the graph in dot format. For more informations
@@ -3085,7 +4784,7 @@ void ConstraintGraph::print(const Function& F, raw_ostream& OS) const {
 		OS << "\n";
 	}
 
-	OS << pseudoEdgesString.str();
+	OS << RangeContext::current().pseudoEdges;
 
 	// Print the footer of the .dot file.
 	OS << "}\n";
@@ -3257,12 +4956,10 @@ UseMap ConstraintGraph::buildUseMap(
 		// Get the component's use list for V (it does not exist until we try to get it)
 		SmallPtrSet<BasicOp*, 8> &list = compUseMap[V];
 
-		// Get the use list of the variable in component
-		UseMap::iterator p = this->useMap.find(V);
-
-		// For each operation in the list, verify if its sink is in the component
-		for (SmallPtrSetIterator<BasicOp*> opit = p->second.begin(), opend =
-				p->second.end(); opit != opend; ++opit) {
+		// For each operation in the use list of the variable, verify if its
+		// sink is in the component
+		for (UseLists::iterator opit = uses.begin(var), opend = uses.end(var);
+				opit != opend; ++opit) {
 			VarNode *sink = (*opit)->getSink();
 
 			// If it is, add op to the component's use map
@@ -3322,24 +5019,20 @@ void ConstraintGraph::buildSymbolicIntersectMap() {
  *  points to kick start the range analysis algorithm.
  */
 void ConstraintGraph::propagateToNextSCC(
-		const SmallPtrSet<VarNode*, 32> &component) {
+		const SmallPtrSet<VarNode*, 32> &component, bool inside) {
 	for (SmallPtrSetIterator<VarNode*> cit = component.begin(), cend =
 			component.end(); cit != cend; ++cit) {
 		VarNode *var = *cit;
-		const Value *V = var->getValue();
-
-		UseMap::iterator p = this->useMap.find(V);
-
-		for (SmallPtrSetIterator<BasicOp*> sit = p->second.begin(), send =
-				p->second.end(); sit != send; ++sit) {
-			BasicOp *op = *sit;
-			SigmaOp *sigmaop = dyn_cast<SigmaOp>(op);
-
-			op->getSink()->setRange(op->eval());
 
-			if (sigmaop && sigmaop->getIntersect()->getRange().isUnknown()) {
-				sigmaop->markUnresolved();
+		for (UseLists::iterator sit = uses.begin(var), send = uses.end(var);
+				sit != send; ++sit) {
+			// With inside set, only the operations of the component itself;
+			// the next SCCs take the others once they are ready
+			if (inside && !component.count((*sit)->getSink())) {
+				continue;
 			}
+
+			propagateOp(*sit);
 		}
 	}
 }
@@ -3351,29 +5044,17 @@ void ConstraintGraph::propagateToNextSCC(
  *  one just need to go over the map of uses removing every instance of the
  *  ControlDep class.
  */
-void Nuutila::addControlDependenceEdges(SymbMap *symbMap, UseMap *useMap,
-		VarNodes* vars) {
+void Nuutila::addControlDependenceEdges(SymbMap *symbMap, VarNodes* vars) {
 	for (SymbMap::iterator sit = symbMap->begin(), send = symbMap->end();
 			sit != send; ++sit) {
+		// Cria uma aresta pseudo-dependência
+		VarNodes::iterator source_value = vars->find(sit->first);
+		unsigned source = indices[source_value->second];
+
 		for (SmallPtrSetIterator<BasicOp*> opit = sit->second.begin(), opend =
 				sit->second.end(); opit != opend; ++opit) {
-			// Cria uma operação pseudo-aresta
-			VarNodes::iterator source_value = vars->find(sit->first);
-			VarNode* source = source_value->second;
-
-//			if (source_value != vars.end()) {
-//				source = vars.find(sit->first)->second;
-//			}
-
-//			if (source == NULL) {
-//				continue;
-//			}
-
-			BasicOp *cdedge = new ControlDep((*opit)->getSink(), source);
-//			BasicOp *cdedge = new ControlDep((cast<UnaryOp>(*opit))->getSource(), source);
-
-			//(*useMap)[(*opit)->getSink()->getValue()].insert(cdedge);
-			(*useMap)[sit->first].insert(cdedge);
+			controlDeps.push_back(
+					std::make_pair(source, indices[(*opit)->getSink()]));
 		}
 	}
 }
@@ -3381,110 +5062,128 @@ void Nuutila::addControlDependenceEdges(SymbMap *symbMap, UseMap *useMap,
 /*
  *	Removes the control dependence edges from the constraint graph.
  */
-void Nuutila::delControlDependenceEdges(UseMap *useMap) {
-	for (UseMap::iterator it = useMap->begin(), end = useMap->end(); it != end;
-			++it) {
-
-		std::deque<ControlDep*> ops;
-
-		if (!ops.empty()) {
-			errs() << "Erro na lista\n";
-		}
-
-		for (SmallPtrSetIterator<BasicOp*> sit = it->second.begin(), send =
-				it->second.end(); sit != send; ++sit) {
-			ControlDep *op = NULL;
-
-			if ((op = dyn_cast<ControlDep>(*sit))) {
-				ops.push_back(op);
-			}
+void Nuutila::delControlDependenceEdges() {
+	raw_string_ostream pseudoEdgesString(RangeContext::current().pseudoEdges);
+	for (unsigned i = 0, e = controlDeps.size(); i < e; ++i) {
+		// Add pseudo edge to the string
+		const Value* V = nodes[controlDeps[i].first]->getValue();
+		if (const ConstantInt* C = dyn_cast<ConstantInt>(V)) {
+			pseudoEdgesString << " " << C->getValue() << " -> ";
+		} else {
+			pseudoEdgesString << " " << '"';
+			printVarName(V, pseudoEdgesString);
+			pseudoEdgesString << '"' << " -> ";
 		}
 
-		for (std::deque<ControlDep*>::iterator dit = ops.begin(), dend =
-				ops.end(); dit != dend; ++dit) {
-			ControlDep *op = *dit;
+		const Value* VS = nodes[controlDeps[i].second]->getValue();
+		pseudoEdgesString << '"';
+		printVarName(VS, pseudoEdgesString);
+		pseudoEdgesString << '"';
 
-			// Add pseudo edge to the string
-			const Value* V = op->getSource()->getValue();
-			if (const ConstantInt* C = dyn_cast<ConstantInt>(V)) {
-				pseudoEdgesString << " " << C->getValue() << " -> ";
-			} else {
-				pseudoEdgesString << " " << '"';
-				printVarName(V, pseudoEdgesString);
-				pseudoEdgesString << '"' << " -> ";
-			}
-
-			const Value* VS = op->getSink()->getValue();
-			pseudoEdgesString << '"';
-			printVarName(VS, pseudoEdgesString);
-			pseudoEdgesString << '"';
+		pseudoEdgesString << " [style=dashed]\n";
+	}
+	std::vector<std::pair<unsigned, unsigned> >().swap(controlDeps);
+	std::vector<unsigned>().swap(edgeBegin);
+	std::vector<unsigned>().swap(edges);
+}
 
-			pseudoEdgesString << " [style=dashed]\n";
+void Nuutila::buildEdges() {
+	unsigned numNodes = nodes.size();
+	edgeBegin.assign(numNodes + 1, 0);
+	for (unsigned i = 0; i < numNodes; ++i) {
+		edgeBegin[i + 1] = uses->end(nodes[i]) - uses->begin(nodes[i]);
+	}
+	for (unsigned i = 0, e = controlDeps.size(); i < e; ++i) {
+		++edgeBegin[controlDeps[i].first + 1];
+	}
+	for (unsigned i = 0; i < numNodes; ++i) {
+		edgeBegin[i + 1] += edgeBegin[i];
+	}
 
-			// Remove pseudo edge from the map
-			it->second.erase(op);
+	edges.resize(edgeBegin[numNodes]);
+	std::vector<unsigned> next(edgeBegin.begin(), edgeBegin.end() - 1);
+	for (unsigned i = 0; i < numNodes; ++i) {
+		for (UseLists::iterator sit = uses->begin(nodes[i]), send =
+				uses->end(nodes[i]); sit != send; ++sit) {
+			edges[next[i]++] = indices[(*sit)->getSink()];
 		}
 	}
+	for (unsigned i = 0, e = controlDeps.size(); i < e; ++i) {
+		edges[next[controlDeps[i].first]++] = controlDeps[i].second;
+	}
 }
 
 /*
  *	Finds SCCs using Nuutila's algorithm. This algorithm is divided in
- *  two parts. The first calls the recursive visit procedure on every node
- *  in the constraint graph. The second phase revisits these nodes,
- *  grouping them in components.
+ *  two parts. The first visits every node in the constraint graph in depth
+ *  first order; an explicit stack of the nodes being visited, with the next
+ *  edge of each one, takes the place of the recursion. The second phase
+ *  revisits these nodes, grouping them in components.
  */
-void Nuutila::visit(Value *V, std::stack<Value*> &stack, UseMap *useMap) {
-	dfs[V] = index;
-	++index;
+void Nuutila::visit(unsigned V) {
+	std::vector<std::pair<unsigned, unsigned> > path;
+
+	dfs[V] = index++;
 	root[V] = V;
+	path.push_back(std::make_pair(V, edgeBegin[V]));
 
-	// Visit every node defined in an instruction that uses V
-	for (SmallPtrSetIterator<BasicOp*> sit = (*useMap)[V].begin(), send =
-			(*useMap)[V].end(); sit != send; ++sit) {
-		BasicOp *op = *sit;
-		Value *name = const_cast<Value*>(op->getSink()->getValue());
+	while (!path.empty()) {
+		unsigned node = path.back().first;
+		unsigned edge = path.back().second;
 
-		if (dfs[name] < 0) {
-			visit(name, stack, useMap);
+		if (edge == edgeBegin[node + 1]) {
+			path.pop_back();
+			finishVisit(node);
+			continue;
 		}
 
-		if ((inComponent.count(name) == false)
-				&& (dfs[root[V]] >= dfs[root[name]])) {
-			root[V] = root[name];
+		// Visit every node defined in an instruction that uses node, or
+		// whose intersection node bounds; the edge is taken again once the
+		// visit of its sink is over
+		unsigned sink = edges[edge];
+		if (dfs[sink] < 0) {
+			dfs[sink] = index++;
+			root[sink] = sink;
+			path.push_back(std::make_pair(sink, edgeBegin[sink]));
+			continue;
 		}
+
+		if (!inComponent[sink] && (dfs[root[node]] >= dfs[root[sink]])) {
+			root[node] = root[sink];
+		}
+		++path.back().second;
 	}
+}
 
+void Nuutila::finishVisit(unsigned V) {
 	// The second phase of the algorithm assigns components to stacked nodes
-	if (root[V] == V) {
-		// Neither the worklist nor the map of components is part of Nuutila's
-		// original algorithm. We are using these data structures to get a
-		// topological ordering of the SCCs without having to go over the root
-		// list once more.
-		worklist.push_back(V);
-
-		SmallPtrSet<VarNode*, 32> *SCC = new SmallPtrSet<VarNode*, 32>;
-
-		if (!SCC->empty()) {
-			errs() << "Erro na lista\n";
-		}
+	if (root[V] != V) {
+		stack.push_back(V);
+		return;
+	}
 
-		SCC->insert((*variables)[V]);
+	// Neither the worklist nor the map of components is part of Nuutila's
+	// original algorithm. We are using these data structures to get a
+	// topological ordering of the SCCs without having to go over the root
+	// list once more.
+	Value *value = const_cast<Value*>(nodes[V]->getValue());
+	worklist.push_back(value);
 
-		inComponent.insert(V);
+	SmallPtrSet<VarNode*, 32> *SCC = new SmallPtrSet<VarNode*, 32>;
+	SCC->insert(nodes[V]);
 
-		while (!stack.empty() && (dfs[stack.top()] > dfs[V])) {
-			Value *node = stack.top();
-			stack.pop();
+	inComponent[V] = true;
 
-			inComponent.insert(node);
+	while (!stack.empty() && (dfs[stack.back()] > dfs[V])) {
+		unsigned node = stack.back();
+		stack.pop_back();
 
-			SCC->insert((*variables)[node]);
-		}
+		inComponent[node] = true;
 
-		components[V] = SCC;
-	} else {
-		stack.push(V);
+		SCC->insert(nodes[node]);
 	}
+
+	components[value] = SCC;
 }
 
 /*
@@ -3493,7 +5192,7 @@ void Nuutila::visit(Value *V, std::stack<Value*> &stack, UseMap *useMap) {
  *  control dependence edges in the contraint graph. These edges are removed
  *  after the class is done computing the SCCs.
  */
-Nuutila::Nuutila(VarNodes *varNodes, UseMap *useMap, SymbMap *symbMap,
+Nuutila::Nuutila(VarNodes *varNodes, const UseLists *useLists, SymbMap *symbMap,
 		bool single) {
 	if (single) {
 		/* FERNANDO */
@@ -3515,41 +5214,43 @@ Nuutila::Nuutila(VarNodes *varNodes, UseMap *useMap, SymbMap *symbMap,
 	} else {
 		// Copy structures
 		this->variables = varNodes;
+		this->uses = useLists;
 		this->index = 0;
 
-		// Iterate over all varnodes of the constraint graph
+		// Number the varnodes of the constraint graph
+		nodes.reserve(varNodes->size());
 		for (VarNodes::iterator vit = varNodes->begin(), vend = varNodes->end();
 				vit != vend; ++vit) {
-			// Initialize DFS control variable for each Value in the graph
-			Value *V = const_cast<Value*>(vit->first);
-			dfs[V] = -1;
+			indices[vit->second] = nodes.size();
+			nodes.push_back(vit->second);
 		}
 
-		addControlDependenceEdges(symbMap, useMap, varNodes);
+		addControlDependenceEdges(symbMap, varNodes);
+		buildEdges();
 
-		// Iterate again over all varnodes of the constraint graph
-		for (VarNodes::iterator vit = varNodes->begin(), vend = varNodes->end();
-				vit != vend; ++vit) {
-			Value *V = const_cast<Value*>(vit->first);
+		// Initialize DFS control variable for each node in the graph
+		unsigned numNodes = nodes.size();
+		dfs.assign(numNodes, -1);
+		root.resize(numNodes);
+		inComponent.assign(numNodes, false);
 
-			// If the Value has not been visited yet, call visit for him
+		// If the node has not been visited yet, call visit for him
+		for (unsigned V = 0; V < numNodes; ++V) {
 			if (dfs[V] < 0) {
-				std::stack<Value*> pilha;
-				if (!pilha.empty()) {
-					errs() << "Erro na pilha\n";
-				}
-
-				visit(V, pilha, useMap);
+				visit(V);
 			}
 		}
 
-		delControlDependenceEdges(useMap);
+		delControlDependenceEdges();
+		std::vector<int>().swap(dfs);
+		std::vector<unsigned>().swap(root);
+		std::vector<bool>().swap(inComponent);
 	}
 
 #ifdef SCC_DEBUG
 	ASSERT(checkWorklist(),"an inconsistency in SCC worklist have been found")
 	ASSERT(checkComponents(), "a component has been used more than once")
-	ASSERT(checkTopologicalSort(useMap), "topological sort is incorrect")
+	ASSERT(checkTopologicalSort(), "topological sort is incorrect")
 #endif
 }
 
@@ -3601,14 +5302,13 @@ bool Nuutila::checkComponents() {
  * Check if a component has an edge to another component
  */
 bool Nuutila::hasEdge(SmallPtrSet<VarNode*, 32> *componentFrom,
-		SmallPtrSet<VarNode*, 32> *componentTo, UseMap *useMap)
+		SmallPtrSet<VarNode*, 32> *componentTo)
 {
 	for (SmallPtrSetIterator<VarNode*> vit = componentFrom->begin(),
 			vend = componentFrom->end(); vit != vend; ++vit)
 	{
-		const Value *source = (*vit)->getValue();
-		for (SmallPtrSetIterator<BasicOp*> sit = (*useMap)[source].begin(),
-				send = (*useMap)[source].end(); sit != send; ++sit)
+		for (UseLists::iterator sit = uses->begin(*vit), send = uses->end(*vit);
+				sit != send; ++sit)
 		{
 			BasicOp *op = *sit;
 			if(componentTo->count(op->getSink())) {
@@ -3619,7 +5319,7 @@ bool Nuutila::hasEdge(SmallPtrSet<VarNode*, 32> *componentFrom,
 	return false;
 }
 
-bool Nuutila::checkTopologicalSort(UseMap *useMap) {
+bool Nuutila::checkTopologicalSort() {
 	bool isConsistent = true;
 	DenseMap<SmallPtrSet<VarNode*, 32>*,bool> visited;
 	for (Nuutila::iterator nit = this->begin(), nend = this->end();
@@ -3639,7 +5339,7 @@ bool Nuutila::checkTopologicalSort(UseMap *useMap) {
 					nit2 != nend2; ++nit2) {
 				SmallPtrSet<VarNode*, 32> *component2 = &this->components[*nit2];
 				if(nit != nit2 && visited[component2] &&
-						hasEdge(component, component2, useMap)) {
+						hasEdge(component, component2)) {
 					isConsistent = false;
 				}
 			}
@@ -42,6 +42,8 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/AlignOf.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/ConstantRange.h"
@@ -50,6 +52,7 @@
 #include "llvm/Support/Process.h"
 #include "llvm/Pass.h"
 #include "vSSA.h"
+#include "../PassProfile/PassProfile.h"
 #include <deque>
 #include <stack>
 #include <set>
@@ -106,11 +109,9 @@ errs() << "\n--------------\n"; \
 //#define LOG_TRANSACTIONS
 
 #ifdef LOG_TRANSACTIONS
-std::string _log_ErrorInfo;
-llvm::Twine _log_fileName = "/tmp/ratransactions";
-llvm::raw_fd_ostream _log_file(_log_fileName.str().c_str(), _log_ErrorInfo);
-#define LOG_TRANSACTION(str) _log_file << str << "\n";
-#define FINISH_LOG _log_file.close();
+// Each analysis writes /tmp/ratransactions, /tmp/ratransactions.1, ...
+#define LOG_TRANSACTION(str) RangeContext::current().transactionLog() << str << "\n";
+#define FINISH_LOG RangeContext::current().closeTransactionLog();
 #else
 #define LOG_TRANSACTION(str)
 #define FINISH_LOG
@@ -134,20 +135,46 @@ using namespace llvm;
 
 enum RangeType {Unknown, Regular, Empty};
 
+///
+/// Almost every integer is at most 64 bits wide, so ranges of up to 64 bits
+/// keep their bounds sign extended in int64_t, and add, sub, mul, sdiv, shl,
+/// intersectWith and unionWith work on them directly, giving the same
+/// results the APInt operations would at that bit width. Only wider ranges
+/// store APInt bounds.
 class Range {
 private:
-	APInt l;	// The lower bound of the range.
-	APInt u;	// The upper bound of the range.
+	int64_t sl;	// The lower bound of the range, up to 64 bits.
+	int64_t su;	// The upper bound of the range, up to 64 bits.
+	APInt l;	// The lower bound of the range, over 64 bits.
+	APInt u;	// The upper bound of the range, over 64 bits.
+	unsigned width;
 	RangeType type;
 
+	Range(int64_t lb, int64_t ub, unsigned width, RangeType type = Regular);
+	bool isSmall() const {return width <= 64;}
+	friend class BinaryOpBatch;
+	void setBounds(const APInt& lb, const APInt& ub);
+
+	static int64_t maxValue(unsigned width) {
+		return (int64_t)(((uint64_t)1 << (width - 1)) - 1);
+	}
+	static int64_t minValue(unsigned width) {
+		return -maxValue(width) - 1;
+	}
+	// Sign extend the low width bits of x, i.e. wrap x around as an APInt
+	// of that bit width would
+	static int64_t wrap(uint64_t x, unsigned width) {
+		return (int64_t)(x << (64 - width)) >> (64 - width);
+	}
+
 public:
 	Range();
 	Range(APInt lb, APInt ub, RangeType type = Regular);
 	~Range();
-	APInt getLower() const {return l;}
-	APInt getUpper() const {return u;}
-	void setLower(const APInt& newl) {this->l = newl;}
-	void setUpper(const APInt& newu) {this->u = newu;}
+	APInt getLower() const {return isSmall() ? APInt(width, sl, true) : l;}
+	APInt getUpper() const {return isSmall() ? APInt(width, su, true) : u;}
+	void setLower(const APInt& newl) {setBounds(newl, getUpper());}
+	void setUpper(const APInt& newu) {setBounds(getLower(), newu);}
 	bool isUnknown() const {return type == Unknown;}
 	void setUnknown() {type = Unknown;}
 	bool isRegular() const {return type == Regular;}
@@ -191,10 +218,18 @@ private:
 	Range interval;
 	// Used by the crop meet operator
 	char abstractState;
+	// Where the operations that use the variable are in the use lists of
+	// the graph
+	unsigned firstUse, lastUse;
 
 public:
 	VarNode(const Value* V);
 	~VarNode();
+	/// VarNodes live in the allocator of their graph.
+	void *operator new(size_t size, BumpPtrAllocator &allocator) {
+		return allocator.Allocate(size, AlignOf<VarNode>::Alignment);
+	}
+	void operator delete(void *, BumpPtrAllocator &) {}
 	/// Initializes the value of the node.
 	void init(bool outside);
 	/// Returns the range of the variable represented by this node.
@@ -216,6 +251,9 @@ public:
 	char getAbstractState(){ return abstractState; }
 	// The possible states are '0', '+', '-' and '?'.
 	void storeAbstractState();
+	unsigned getFirstUse() const {return firstUse;}
+	unsigned getLastUse() const {return lastUse;}
+	void setUses(unsigned first, unsigned last) {firstUse = first; lastUse = last;}
 };
 
 enum IntervalId {
@@ -316,6 +354,14 @@ protected:
 public:
 	/// The dtor. Its virtual because this is a base class.
 	virtual ~BasicOp();
+	/// The operations of a graph live in its allocator; the others, like
+	/// the control dependences of Nuutila, in the heap.
+	void *operator new(size_t size, BumpPtrAllocator &allocator) {
+		return allocator.Allocate(size, AlignOf<BasicOp>::Alignment);
+	}
+	void operator delete(void *, BumpPtrAllocator &) {}
+	void *operator new(size_t size) {return ::operator new(size);}
+	void operator delete(void *p) {::operator delete(p);}
 	// Methods for RTTI
 	virtual OperationId getValueId() const = 0;
 	static bool classof(BasicOp const *) {return true;}
@@ -651,14 +697,52 @@ class Profile {
 	
 		// Map to store accumulated times
 		typedef StringMap<TimeValue> AccTimesMap;
+
+		// Hardware counters sampled by the phases, where available
+		enum Counter {
+			Cycles,
+			Instructions,
+			NumCounters
+		};
 	
 	private:
 		AccTimesMap accumulatedtimes;
 		size_t memory;
+		// The keys in the order they were first updated, and how many
+		// times each one was
+		std::vector<std::string> keys;
+		StringMap<unsigned> calls;
+		StringMap<std::vector<uint64_t> > counters;
+		// The open phases, innermost last, with their start times and
+		// counters
+		struct OpenPhase {
+			std::string key;
+			TimeValue start;
+			uint64_t traceStart;
+			bool counted;
+			uint64_t counters[NumCounters];
+		};
+		std::vector<OpenPhase> phases;
+		int counterFDs[NumCounters];
+		// SCCs solved, by number of iterations of the worklists, and by
+		// size; bucket i holds the values in [2^i, 2^(i+1)), 0 included
+		// in the first one
+		unsigned numSCCs;
+		uint64_t sccIterations;
+		unsigned maxSCCIterations;
+		std::vector<unsigned> iterationHistogram;
+		std::vector<unsigned> sizeHistogram;
+
+		bool readCounters(uint64_t values[NumCounters]);
 	
 	public:
 		Profile():
-			memory(0) {}
+			memory(0), numSCCs(0), sccIterations(0), maxSCCIterations(0) {
+			for (unsigned i = 0; i < NumCounters; ++i) {
+				counterFDs[i] = -1;
+			}
+		}
+		~Profile();
 
 		TimeValue timenow() {
 			TimeValue garbage, usertime;
@@ -668,8 +752,24 @@ class Profile {
 		}
 	
 		void updateTime(StringRef key, const TimeValue &time) {
+			if (!accumulatedtimes.count(key)) {
+				keys.push_back(key.str());
+			}
 			accumulatedtimes[key] += time;
+			++calls[key];
 		}
+
+		/// Starts timing a phase; the key of a phase that starts inside
+		/// another one is "outer/inner".
+		void beginPhase(StringRef name);
+		/// Ends the innermost phase and adds its time, and its counters, to
+		/// the ones of its key.
+		void endPhase();
+		/// Samples the cycles and the instructions of the phases from now
+		/// on. Returns false if the system can't count them.
+		bool enableCounters();
+		/// Counts an SCC solved in the given iterations of the worklists.
+		void addSCC(unsigned size, unsigned iterations);
 		
 		double getTimeDouble(StringRef key) {
 			return accumulatedtimes[key].seconds() + (0.001) * accumulatedtimes[key].milliseconds();
@@ -704,6 +804,13 @@ class Profile {
 			formatted << (mem / 1024);
 			errs() << formatted.str() << "\t - " << "Memory used in KB\n";
 		}
+
+		/// Prints the time of every key, in the order they were updated.
+		void printTimes();
+		/// Writes the times, the counters, the memory and the SCCs in JSON.
+		void printJSON(raw_ostream &OS);
+		/// The same, to a file; false if it can't be written.
+		bool writeJSON(StringRef fileName);
 };
 
 // The VarNodes type.
@@ -726,6 +833,49 @@ typedef DenseMap<const Value*, ValueBranchMap> ValuesBranchMap;
 
 typedef DenseMap<const Value*, ValueSwitchMap> ValuesSwitchMap;
 
+/// The operations that use each variable of a complete constraint graph,
+/// packed in one array; each VarNode knows where its own list is. This
+/// takes the place of the UseMap, whose per variable sets are much larger.
+class UseLists {
+private:
+	std::vector<BasicOp*> ops;
+
+public:
+	typedef std::vector<BasicOp*>::const_iterator iterator;
+	/// Packs the lists of useMap.
+	void build(VarNodes &vars, const UseMap &useMap);
+	/// Moves the lists back to useMap, so that they can change.
+	void unpack(const VarNodes &vars, UseMap &useMap);
+	iterator begin(const VarNode *V) const {return ops.begin() + V->getFirstUse();}
+	iterator end(const VarNode *V) const {return ops.begin() + V->getLastUse();}
+};
+
+/// The constants that the widening of an SCC jumps to, instead of going
+/// straight to -inf or +inf: the jump-set. They are sorted and unique once
+/// built, so that the lookups are binary searches. A jump-set may extend
+/// another one, shared by several SCCs.
+class JumpSet {
+private:
+	SmallVector<APInt, 8> constants;
+	const JumpSet *global;
+
+public:
+	JumpSet(const JumpSet *global = NULL) : global(global) {}
+	/// Adds a constant; build must run before the lookups.
+	void insert(APInt constant);
+	/// Sorts the constants and removes the duplicates.
+	void build();
+	void clear() {constants.clear();}
+	unsigned size() const {return constants.size();}
+	/// The least constant not less than val, or Max.
+	APInt getFirstGreater(const APInt &val) const;
+	/// The greatest constant not greater than val, or Min.
+	APInt getFirstLess(const APInt &val) const;
+};
+
+class Nuutila;
+struct SCCSchedule;
+
 /// This class represents our constraint graph. This graph is used to
 /// perform all computations in our analysis.
 class ConstraintGraph {
@@ -738,22 +888,34 @@ protected:
 private:
     // Save the last Function analyzed
     const Function *func;
+	// The storage of the VarNodes and of the operations
+	BumpPtrAllocator allocator;
 	// A map from variables to the operations that define them
 	DefMap defMap;
-	// A map from variables to the operations where these variables are used.
+	// A map from variables to the operations where these variables are used,
+	// until buildVarNodes or finishUpdate packs it in uses.
 	UseMap useMap;
+	UseLists uses;
 	// A map from variables to the operations where these
 	// variables are present as bounds
 	SymbMap symbMap;
 	// This data structure is used to store intervals, basic blocks and intervals
-	// obtained in the branches.
+	// obtained in the branches. They are built for the branches into the
+	// blocks of the sigmas, and released once the function is done; the
+	// intervals that the sigmas take are theirs.
 	ValuesBranchMap valuesBranchMap;
 	ValuesSwitchMap valuesSwitchMap;
+	// The variables of each function, so that its constraints can be
+	// replaced when a transformation changes it
+	DenseMap<const Function*, std::vector<VarNode*> > funcVars;
+	// Between removeFunctions and finishUpdate, the ranges to find again
+	bool updating;
+	std::vector<VarNode*> dirty;
 	
-	// Vector containing the constants from a SCC
-	// It is cleared at the beginning of every SCC resolution
-	SmallVector<APInt, 2> constantvector;
-	
+	/// Takes an operation out of the graph while it is updated.
+	void removeOperation(BasicOp *op);
+	/// Takes out the matcher that defines V, if any.
+	void removeMatcher(const Value *V);
 	/// Adds a BinaryOp in the graph.
 	void addBinaryOp(const Instruction* I);
 	/// Adds a PhiOp in the graph.
@@ -764,27 +926,45 @@ private:
 	void buildOperations(const Instruction* I);
 	void buildValueBranchMap(const BranchInst *br);
 	void buildValueSwitchMap(const SwitchInst *sw);
-	void buildValueMaps(const Function& F);
-	
-//	void clearValueMaps();
-
-	void insertConstantIntoVector(APInt constantval);
-	APInt getFirstGreaterFromVector(const SmallVector<APInt, 2> &constantvector, const APInt &val);
-	APInt getFirstLessFromVector(const SmallVector<APInt, 2> &constantvector, const APInt &val);
-	void buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap);
+	/// Builds the entries of the values that the branch or switch ti compares.
+	void buildValueMaps(const TerminatorInst *ti);
+	/// Replaces the entry of the value of VBM or VSM.
+	void addValueMap(const ValueBranchMap &VBM);
+	void addValueMap(const ValueSwitchMap &VSM);
+	/// Takes the interval of a sigma of V in BB out of the maps, if there
+	/// is an entry of V about BB; returns false if there is not.
+	bool takeSigmaInterval(const Value *V, const BasicBlock *BB,
+		BasicInterval *&itv);
+	void clearValueMaps();
+
+	// Fills constantvector with the constants from a SCC
+	void buildConstantVector(const SmallPtrSet<VarNode*, 32> &component, const UseMap &compusemap,
+		JumpSet &constantvector);
+	// The constants of the whole graph, which every SCC may jump to
+	JumpSet globalJumpSet;
+	void buildGlobalJumpSet();
+	// The SCCs of the demand-driven queries, from the first one on
+	SCCSchedule *demand;
+	// Builds the DAG of the SCCs of sccList
+	void buildSCCSchedule(Nuutila &sccList, SCCSchedule &S);
 	// Perform the widening and narrowing operations
 
 protected:
-	void update(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& actv, bool (*meet)(BasicOp* op, const SmallVector<APInt, 2> *constantvector));
+	/// Applies meet until actv is empty. After maxIterations, if not 0,
+	/// stops early and returns false, leaving the rest in actv.
+	bool update(const UseMap &compUseMap,
+		SmallPtrSet<const Value*, 6>& actv, bool (*meet)(BasicOp* op, const JumpSet *constantvector),
+		const JumpSet &constantvector, unsigned maxIterations = 0);
 	void update(unsigned nIterations, const UseMap &compUseMap,
 			SmallPtrSet<const Value*, 6>& actv);
 
 	virtual void preUpdate(const UseMap &compUseMap,
-		SmallPtrSet<const Value*, 6>& entryPoints) = 0;
+		SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector) = 0;
 	virtual void posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& activeVars,
-		const SmallPtrSet<VarNode*, 32> *component) = 0;
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector) = 0;
 
 public:
 	/// I'm doing this because I want to use this analysis in an
@@ -798,18 +978,45 @@ public:
 	GenOprs* getOprs() {return &oprs;}
 	DefMap* getDefMap() {return &defMap;}
 	UseMap* getUseMap() {return &useMap;}
+	const UseLists& getUseLists() const {return uses;}
+	BumpPtrAllocator& getAllocator() {return allocator;}
 	VarNodes* getVars() { return &vars; }
 	/// Adds an UnaryOp to the graph.
 	void addUnaryOp(const Instruction* I);
+	/// Defines the value of call as the summary range of its callee, which
+	/// has no constraints in the graph.
+	void addSummaryOp(const Instruction *call, const Range &summary);
 	/// Iterates through all instructions in the function and builds the graph.
 	void buildGraph(const Function& F);
+	/// Initializes the nodes and packs the use lists once the graph is
+	/// complete; new operations can't be added afterwards, but during
+	/// an update.
 	void buildVarNodes();
+	/// Starts an update of a solved graph: takes out the nodes and the
+	/// operations of the changed functions, whose instructions may be gone
+	/// already. Adds to rematch the other functions whose parameters they
+	/// passed. buildGraph can then add the new constraints of these
+	/// functions, until finishUpdate.
+	void removeFunctions(const SmallPtrSet<const Function*, 8> &changed,
+		SmallPtrSet<const Function*, 8> &rematch);
+	/// Takes out the operations that match the parameters and the return
+	/// values of F during an update, so they can be built again.
+	void removeMatchers(Function &F);
+	/// Ends an update: finds again the ranges of the SCCs that depend on
+	/// the changed constraints, or, if lazy, leaves them to the
+	/// demand-driven queries. The other SCCs keep their ranges.
+	void finishUpdate(bool lazy);
 	void buildSymbolicIntersectMap();
 	UseMap buildUseMap(const SmallPtrSet<VarNode*, 32> &component);
-	void propagateToNextSCC(const SmallPtrSet<VarNode*, 32> &component);
+	void propagateToNextSCC(const SmallPtrSet<VarNode*, 32> &component, bool inside = false);
 
 	/// Finds the intervals of the variables in the graph.
 	void findIntervals();
+	/// Finds the intervals of the queried values only, reusing the SCCs
+	/// solved by earlier queries.
+	void findIntervals(const SmallVectorImpl<const Value*> &queries);
+	/// Widening and narrowing of one SCC, once the SCCs it depends on are done.
+	void solveSCC(SmallPtrSet<VarNode*, 32> &component);
 	void generateEntryPoints(SmallPtrSet<VarNode*, 32> &component, SmallPtrSet<const Value*, 6> &entryPoints);
 	void fixIntersects(SmallPtrSet<VarNode*, 32> &component);
 	void generateActivesVars(SmallPtrSet<VarNode*, 32> &component, SmallPtrSet<const Value*, 6> &activeVars);
@@ -829,21 +1036,25 @@ public:
 
 class Cousot: public ConstraintGraph {
 private:
-	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints);
+	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector);
 	void posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& activeVars,
-		const SmallPtrSet<VarNode*, 32> *component);
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector);
 
 public:
 	Cousot(): ConstraintGraph() {}
 };
 
 class CropDFS: public ConstraintGraph{
-private:
-	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints);
+protected:
+	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector);
 	void posUpdate(const UseMap &compUseMap,
 		SmallPtrSet<const Value*, 6>& activeVars,
-		const SmallPtrSet<VarNode*, 32> *component);
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector);
 	void storeAbstractStates(const SmallPtrSet<VarNode*, 32> *component);
 	void crop(const UseMap &compUseMap, BasicOp *op);
 
@@ -851,28 +1062,65 @@ public:
 	CropDFS(): ConstraintGraph() {}
 };
 
+/// Chooses the solver of each SCC: CropDFS for the large ones whose
+/// widening would walk a long jump-set, and Cousot's widening and
+/// narrowing for the others. The widening goes straight to the infinities
+/// once it passes a number of iterations.
+class Adaptive: public CropDFS {
+private:
+	static bool useCropDFS(const UseMap &compUseMap, const JumpSet &constantvector);
+	void preUpdate(const UseMap &compUseMap, SmallPtrSet<const Value*, 6>& entryPoints,
+		const JumpSet &constantvector);
+	void posUpdate(const UseMap &compUseMap,
+		SmallPtrSet<const Value*, 6>& activeVars,
+		const SmallPtrSet<VarNode*, 32> *component,
+		const JumpSet &constantvector);
+
+public:
+	Adaptive(): CropDFS() {}
+};
+
 class Nuutila {
 public:
 	VarNodes *variables;
+	const UseLists *uses;
+	// The nodes by dense index, in the order of variables, and the index
+	// of each one
+	std::vector<VarNode*> nodes;
+	DenseMap<const VarNode*, unsigned> indices;
+	// The control dependence edges, from bounds to the sinks of the sigmas
+	std::vector<std::pair<unsigned, unsigned> > controlDeps;
+	// The successors of node i are edges[edgeBegin[i]] to
+	// edges[edgeBegin[i + 1] - 1]: the sinks of its uses, then the ones of
+	// its control dependences
+	std::vector<unsigned> edgeBegin;
+	std::vector<unsigned> edges;
+	// The state of the search, by node index
 	int index;
-	DenseMap<Value*, int> dfs;
-	DenseMap<Value*, Value*> root;
-	SmallPtrSet<Value*, 32> inComponent;
+	std::vector<int> dfs;
+	std::vector<unsigned> root;
+	std::vector<bool> inComponent;
+	std::vector<unsigned> stack;
 	DenseMap<Value*, SmallPtrSet<VarNode*, 32>* > components;
 	std::deque<Value*> worklist;
 #ifdef SCC_DEBUG
     bool checkWorklist();
     bool checkComponents();
-    bool checkTopologicalSort(UseMap *useMap);
-    bool hasEdge(SmallPtrSet<VarNode*, 32> *componentFrom, SmallPtrSet<VarNode*, 32> *componentTo, UseMap *useMap);
+    bool checkTopologicalSort();
+    bool hasEdge(SmallPtrSet<VarNode*, 32> *componentFrom, SmallPtrSet<VarNode*, 32> *componentTo);
 #endif
 public:
-	Nuutila(VarNodes *varNodes, UseMap *useMap, SymbMap *symbMap, bool single = false);
+	Nuutila(VarNodes *varNodes, const UseLists *uses, SymbMap *symbMap, bool single = false);
 	~Nuutila();
 
-	void addControlDependenceEdges(SymbMap *symbMap, UseMap *useMap, VarNodes* vars);
-	void delControlDependenceEdges(UseMap *useMap);
-	void visit(Value *V, std::stack<Value*> &stack, UseMap *useMap);
+	void addControlDependenceEdges(SymbMap *symbMap, VarNodes* vars);
+	void delControlDependenceEdges();
+	/// Fills edgeBegin and edges from the use lists and controlDeps.
+	void buildEdges();
+	/// Searches from node V, without recursion.
+	void visit(unsigned V);
+	/// Ends the visit of node V, making a component if it is a root.
+	void finishVisit(unsigned V);
 	typedef std::deque<Value*>::reverse_iterator iterator;
 	iterator begin() {return worklist.rbegin();}
 	iterator end() {return worklist.rend();}
@@ -881,16 +1129,67 @@ public:
 class Meet{
 
 public:
-	static bool widen(BasicOp* op, const SmallVector<APInt, 2> *constantvector);
-	static bool narrow(BasicOp* op, const SmallVector<APInt, 2> *constantvector);
-	static bool crop(BasicOp* op, const SmallVector<APInt, 2> *constantvector);
-	static bool growth(BasicOp* op, const SmallVector<APInt, 2> *constantvector);
-	static bool fixed(BasicOp* op, const SmallVector<APInt, 2> *constantvector);
+	static bool widen(BasicOp* op, const JumpSet *constantvector);
+	static bool narrow(BasicOp* op, const JumpSet *constantvector);
+	/// widen, growth and narrow, given the interval op evaluates to.
+	static bool widenWith(BasicOp* op, const Range &newInterval,
+		const JumpSet *constantvector);
+	static bool growthWith(BasicOp* op, const Range &newInterval,
+		const JumpSet *constantvector);
+	static bool narrowWith(BasicOp* op, const Range &newInterval,
+		const JumpSet *constantvector);
+	static bool crop(BasicOp* op, const JumpSet *constantvector);
+	static bool growth(BasicOp* op, const JumpSet *constantvector);
+	static bool fixed(BasicOp* op, const JumpSet *constantvector);
+};
+
+/// The state that the ranges of an analysis share: the bit width of its
+/// APInts and their extremes, and what it collects for the statistics and
+/// the dot files. Every analysis owns one and installs it on the thread
+/// that runs it or asks it for ranges, so analyses of different modules or
+/// functions may run in parallel threads; its SCC workers install it too.
+class RangeContext {
+public:
+	unsigned bitWidth;
+	APInt min, max, zero;
+	// The threads solving the SCCs, when -ra-threads isn't given
+	unsigned threads;
+	// The number of times that the narrow_meet operator is called on a
+	// variable. It was a Fernando's suggestion.
+	DenseMap<const Value*, unsigned> ferMap;
+	// The control dependence edges, for the dot file
+	std::string pseudoEdges;
+
+	RangeContext() : threads(1), log(NULL) { setBitWidth(1); }
+	~RangeContext();
+
+	void setBitWidth(unsigned width);
+
+	/// The context installed on the calling thread; a context of width 1
+	/// if there is none.
+	static RangeContext &current();
+	/// Makes the context current on the calling thread.
+	static void install(RangeContext &context);
+	/// Uninstalls the context from the calling thread, if it is current.
+	static void release(RangeContext &context);
+
+	raw_ostream &transactionLog();
+	void closeTransactionLog();
+
+private:
+	raw_fd_ostream *log;
+
+	RangeContext(const RangeContext &);
+	RangeContext &operator=(const RangeContext &);
 };
 
 class RangeAnalysis{
 protected:
 	ConstraintGraph *CG;
+	RangeContext context;
+	/// Makes the context of this analysis current, if another analysis
+	/// ran on this thread since.
+	void installContext() { RangeContext::install(context); }
 public:
 	/** Gets the maximum bit width of the operands in the instructions of the
 	 * function. This function is necessary because the class APInt only
@@ -900,12 +1199,11 @@ public:
 	 * the number of operands used in the function.
 	 */
 	static unsigned getMaxBitWidth(const Function& F);
-	static void updateMinMax(unsigned maxBitWidth);
 	
 	virtual APInt getMin() = 0;
 	virtual APInt getMax() = 0;
 	virtual Range getRange(const Value *v) = 0;
-	virtual ~RangeAnalysis() { /*errs() << "\nRangeAnalysis";*/ }
+	virtual ~RangeAnalysis() { RangeContext::release(context); }
 };
 
 template <class CGT>
@@ -920,7 +1218,30 @@ public:
 	virtual APInt getMin();
 	virtual APInt getMax();
 	virtual Range getRange(const Value *v);
+	/// With -ra-demand, finds the ranges of these values at once; getRange
+	/// finds them one value at a time. Without it, does nothing.
+	void computeRanges(const SmallVectorImpl<const Value*> &values);
+	/// Replaces the constraints of the functions of M that a transformation
+	/// changed since runOnModule, and finds again only the ranges that
+	/// depend on them. The functions must still be in e-SSA form.
+	void updateFunctions(Module &M, const SmallVectorImpl<Function*> &changed);
+	/// Prints the range of every named integer argument and instruction,
+	/// as "function:%name = range", for -analyze.
+	void print(raw_ostream &OS, const Module *M) const;
 private:
+	// The return ranges of the functions summarized in -ra-summary-in
+	StringMap<Range> summaries;
+	/// Reads the summaries of -ra-summary-in, with the width of MAX_BIT_INT.
+	void loadSummaries();
+	/// Gives the calls to summarized functions their return ranges; only
+	/// the calls in callers, if not NULL.
+	void addSummaryOps(Module &M,
+		const SmallPtrSet<const Function*, 8> *callers = NULL);
+	/// The union of the ranges of the values F returns.
+	Range getReturnRange(Function &F);
+	/// Writes the return ranges of the functions that other modules may
+	/// call to -ra-summary-out.
+	void writeSummaries(Module &M);
 	void MatchParametersAndReturnValues(Function &F, ConstraintGraph &G);
 };
 
@@ -960,5 +1281,25 @@ public:
   }
 };
 
+class IntraProceduralRAAdaptive : public IntraProceduralRA<Adaptive> {
+public:
+  IntraProceduralRAAdaptive() : IntraProceduralRA<Adaptive>() {
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<vSSA>();
+    AU.setPreservesAll();
+  }
+};
+
+class InterProceduralRAAdaptive : public InterProceduralRA<Adaptive> {
+public:
+  InterProceduralRAAdaptive() : InterProceduralRA<Adaptive>() {
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<vSSA>();
+    AU.setPreservesAll();
+  }
+};
+
 #endif /* LLVM_TRANSFORMS_RANGEANALYSIS_RANGEANALYSIS_H_ */
 
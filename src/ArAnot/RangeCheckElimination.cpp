@@ -0,0 +1,190 @@
+#define DEBUG_TYPE "ra-check-elim"
+
+#include "RangeCheckElimination.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Local.h"
+
+using namespace llvm;
+
+STATISTIC(NumCmpsByRanges, "Number of comparisons decided by the ranges");
+STATISTIC(NumCmpsByIneqGraph, "Number of comparisons decided by the inequality graph");
+STATISTIC(NumBranchesRemoved, "Number of conditional branches removed");
+
+void RangeCheckElimination::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<InterProceduralRACousot>();
+  AU.addRequired<IneqGraph>();
+}
+
+// The bounds of V, at the width of the range analysis. Returns false if
+// the range is unknown or empty.
+bool RangeCheckElimination::getBounds(Value *V, APInt &Lower, APInt &Upper) {
+  unsigned Width = RA->getMin().getBitWidth();
+  if (ConstantInt *CI = dyn_cast<ConstantInt>(V)) {
+    Lower = Upper = CI->getValue().sextOrTrunc(Width);
+    return true;
+  }
+
+  Range R = RA->getRange(V);
+  if (!R.isRegular())
+    return false;
+  Lower = R.getLower();
+  Upper = R.getUpper();
+  return true;
+}
+
+// 1 if L Pred R always holds, 0 if it never does, -1 if the ranges of L and
+// R overlap. Pred is signed or an equality.
+int RangeCheckElimination::decideByRanges(ICmpInst::Predicate Pred,
+                                          Value *L, Value *R) {
+  APInt LL, LU, RL, RU;
+  if (!getBounds(L, LL, LU) || !getBounds(R, RL, RU))
+    return -1;
+
+  switch (Pred) {
+  case ICmpInst::ICMP_SLT:
+    if (LU.slt(RL)) return 1;
+    if (LL.sge(RU)) return 0;
+    return -1;
+  case ICmpInst::ICMP_SLE:
+    if (LU.sle(RL)) return 1;
+    if (LL.sgt(RU)) return 0;
+    return -1;
+  case ICmpInst::ICMP_SGT:
+    return decideByRanges(ICmpInst::ICMP_SLT, R, L);
+  case ICmpInst::ICMP_SGE:
+    return decideByRanges(ICmpInst::ICMP_SLE, R, L);
+  case ICmpInst::ICMP_EQ:
+  case ICmpInst::ICMP_NE:
+    {
+      int Equal = -1;
+      if (LL == LU && RL == RU && LL == RL)
+        Equal = 1;
+      else if (LU.slt(RL) || RU.slt(LL))
+        Equal = 0;
+      if (Equal == -1 || Pred == ICmpInst::ICMP_EQ)
+        return Equal;
+      return !Equal;
+    }
+  default:
+    return -1;
+  }
+}
+
+// As decideByRanges, from the shortest paths between L and R, which bound
+// L - R. Only the signed orders are decided.
+int RangeCheckElimination::decideByIneqGraph(ICmpInst::Predicate Pred,
+                                             Value *L, Value *R) {
+  switch (Pred) {
+  case ICmpInst::ICMP_SLT:
+    // L <= R - 1, or R <= L
+    if (IG->findShortestPath(L, R).sle(-1)) return 1;
+    if (IG->findShortestPath(R, L).sle(0)) return 0;
+    return -1;
+  case ICmpInst::ICMP_SLE:
+    if (IG->findShortestPath(L, R).sle(0)) return 1;
+    if (IG->findShortestPath(R, L).sle(-1)) return 0;
+    return -1;
+  case ICmpInst::ICMP_SGT:
+    return decideByIneqGraph(ICmpInst::ICMP_SLT, R, L);
+  case ICmpInst::ICMP_SGE:
+    return decideByIneqGraph(ICmpInst::ICMP_SLE, R, L);
+  default:
+    return -1;
+  }
+}
+
+int RangeCheckElimination::decide(ICmpInst *Cmp, bool &ByRanges) {
+  Value *L = Cmp->getOperand(0);
+  Value *R = Cmp->getOperand(1);
+  ICmpInst::Predicate Pred = Cmp->getPredicate();
+
+  // The unsigned orders are the signed ones on the non-negative values
+  if (Cmp->isUnsigned()) {
+    APInt LL, LU, RL, RU;
+    if (!getBounds(L, LL, LU) || !getBounds(R, RL, RU) ||
+        LL.isNegative() || RL.isNegative())
+      return -1;
+    Pred = ICmpInst::getSignedPredicate(Pred);
+  }
+
+  ByRanges = true;
+  int Result = decideByRanges(Pred, L, R);
+  if (Result != -1)
+    return Result;
+
+  // The weights of the graph have 64 bits
+  ByRanges = false;
+  if (isa<ConstantInt>(L) || isa<ConstantInt>(R) ||
+      L->getType()->getIntegerBitWidth() > 64)
+    return -1;
+  return decideByIneqGraph(Pred, L, R);
+}
+
+bool RangeCheckElimination::runOnModule(Module &M) {
+  RA = &getAnalysis<InterProceduralRACousot>();
+  IG = &getAnalysis<IneqGraph>();
+  Folded.clear();
+
+  SmallVector<ICmpInst*, 64> Cmps;
+  SmallVector<const Value*, 64> Queries;
+  for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+    for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+      for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+        ICmpInst *Cmp = dyn_cast<ICmpInst>(I);
+        if (!Cmp || !Cmp->getOperand(0)->getType()->isIntegerTy())
+          continue;
+        Cmps.push_back(Cmp);
+        for (unsigned i = 0; i < 2; ++i)
+          if (!isa<Constant>(Cmp->getOperand(i)))
+            Queries.push_back(Cmp->getOperand(i));
+      }
+  RA->computeRanges(Queries);
+
+  // Every comparison is decided before the first change, while the
+  // analyses still describe the module
+  SmallVector<std::pair<ICmpInst*, bool>, 16> Folds;
+  for (unsigned i = 0; i < Cmps.size(); ++i) {
+    bool ByRanges;
+    int Result = decide(Cmps[i], ByRanges);
+    if (Result == -1)
+      continue;
+    if (ByRanges)
+      ++NumCmpsByRanges;
+    else
+      ++NumCmpsByIneqGraph;
+    DEBUG(dbgs() << "ra-check-elim: " << *Cmps[i] << " is always "
+                 << (Result ? "true" : "false") << "\n");
+    Folds.push_back(std::make_pair(Cmps[i], Result == 1));
+    Folded.push_back(std::make_pair(Cmps[i]->getName().str(), Result == 1));
+  }
+
+  SetVector<BasicBlock*> Branches;
+  for (unsigned i = 0; i < Folds.size(); ++i) {
+    ICmpInst *Cmp = Folds[i].first;
+    for (Value::use_iterator UI = Cmp->use_begin(), UE = Cmp->use_end();
+         UI != UE; ++UI)
+      if (BranchInst *BI = dyn_cast<BranchInst>(*UI))
+        Branches.insert(BI->getParent());
+    Cmp->replaceAllUsesWith(ConstantInt::get(Cmp->getType(), Folds[i].second));
+    Cmp->eraseFromParent();
+  }
+
+  for (unsigned i = 0; i < Branches.size(); ++i)
+    if (ConstantFoldTerminator(Branches[i]))
+      ++NumBranchesRemoved;
+
+  return !Folds.empty();
+}
+
+void RangeCheckElimination::print(raw_ostream &OS, const Module*) const {
+  for (unsigned i = 0; i < Folded.size(); ++i)
+    OS << Folded[i].first << " = " << (Folded[i].second ? "true" : "false")
+       << "\n";
+}
+
+char RangeCheckElimination::ID = 0;
+static RegisterPass<RangeCheckElimination> X("ra-check-elim",
+    "Fold the comparisons and branches decided by the range analysis");
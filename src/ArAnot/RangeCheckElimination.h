@@ -0,0 +1,50 @@
+#ifndef LLVM_TRANSFORMS_RANGECHECKELIMINATION_RANGECHECKELIMINATION_H_
+#define LLVM_TRANSFORMS_RANGECHECKELIMINATION_RANGECHECKELIMINATION_H_
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+#include "IneqGraph.h"
+#include "RangeAnalysis.h"
+
+namespace llvm {
+
+// Folds the integer comparisons whose outcome the analyses decide, and the
+// conditional branches on them, which removes the bounds checks written in
+// the source: the guards like "if (i < n)" and the assert-like calls on the
+// failing side. A comparison is decided by the ranges of its operands when
+// they don't overlap, or else, for the signed orders, by the inequality
+// graph, which bounds the difference of two variables.
+//
+// Branches become unconditional and the edges they drop are removed; the
+// blocks left unreachable are for -simplifycfg to delete.
+class RangeCheckElimination : public ModulePass {
+public:
+  static char ID;
+  RangeCheckElimination() : ModulePass(ID), RA(0), IG(0) { }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const;
+  bool runOnModule(Module &M);
+  // Prints "name = true" or "name = false" for every comparison folded
+  virtual void print(raw_ostream &OS, const Module*) const;
+
+private:
+  InterProceduralRACousot *RA;
+  IneqGraph *IG;
+  // The names of the comparisons folded, and their outcome
+  SmallVector<std::pair<std::string, bool>, 16> Folded;
+
+  bool getBounds(Value *V, APInt &Lower, APInt &Upper);
+  int decideByRanges(ICmpInst::Predicate Pred, Value *L, Value *R);
+  int decideByIneqGraph(ICmpInst::Predicate Pred, Value *L, Value *R);
+  int decide(ICmpInst *Cmp, bool &ByRanges);
+};
+
+}
+
+#endif /* LLVM_TRANSFORMS_RANGECHECKELIMINATION_RANGECHECKELIMINATION_H_ */
@@ -0,0 +1,231 @@
+#! /usr/bin/env python3
+#
+# Runs ArAnot on every translation unit of a compile_commands.json, on a pool
+# of jobs, and merges the comments of all of them into one report, and
+# optionally into annotated copies of the sources (headers included).
+#
+# The bitcode and the report of each TU are kept in a cache directory, and
+# reused while the TU, its command and the headers it includes don't change.
+#
+#   run_aranot_batch.py -p build/compile_commands.json -j 16 \
+#       --report aranot-report.txt --output-dir aranot
+#
+# The report has one "file:line:comment" line per comment, sorted by file and
+# line, like -aranot-report.
+
+import argparse
+import concurrent.futures
+import hashlib
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+
+# Flags of the original commands that the driver replaces with its own
+DROPPED_FLAGS = set(['-c', '-S', '-E', '-MD', '-MMD', '-MP'])
+DROPPED_FLAGS_WITH_ARG = set(['-o', '-MF', '-MT', '-MQ'])
+
+REPORT_LINE = re.compile(r'^(.*?):(\d+):(.*)$')
+
+# The shared analyses ArAnot uses, loaded before it
+CORE_PLUGINS = ['PADriver.so', 'AliasSets.so']
+
+
+def load_commands(path):
+    if os.path.isdir(path):
+        path = os.path.join(path, 'compile_commands.json')
+    with open(path) as f:
+        return json.load(f)
+
+
+def source_path(entry):
+    return os.path.normpath(os.path.join(entry['directory'], entry['file']))
+
+
+def compile_args(entry):
+    """The arguments of the command of entry, without the compiler, the
+    source, the outputs and the dependency flags."""
+    if 'arguments' in entry:
+        args = list(entry['arguments'])
+    else:
+        args = shlex.split(entry['command'])
+    source = source_path(entry)
+    kept = []
+    skip = False
+    for arg in args[1:]:
+        if skip:
+            skip = False
+        elif arg in DROPPED_FLAGS_WITH_ARG:
+            skip = True
+        elif arg in DROPPED_FLAGS or arg.startswith('-o'):
+            pass
+        elif arg.startswith('-O'):
+            # ArAnot needs the llvm.dbg.declare of the unoptimized code
+            pass
+        elif os.path.normpath(os.path.join(entry['directory'], arg)) == source:
+            pass
+        else:
+            kept.append(arg)
+    return kept
+
+
+def read_deps(dep_file):
+    """The prerequisites of a make dependency file, as written by -MD."""
+    with open(dep_file) as f:
+        text = f.read().replace('\\\n', ' ').replace('\\ ', '\0')
+    deps = text.split(':', 1)[1].split() if ':' in text else []
+    return [d.replace('\0', ' ') for d in deps]
+
+
+def up_to_date(output, deps):
+    if not os.path.exists(output):
+        return False
+    mtime = os.path.getmtime(output)
+    for dep in deps:
+        if not os.path.exists(dep) or os.path.getmtime(dep) > mtime:
+            return False
+    return True
+
+
+def run(cmd, cwd):
+    p = subprocess.run(cmd, cwd=cwd, stdout=subprocess.PIPE,
+                       stderr=subprocess.STDOUT, universal_newlines=True)
+    return p.returncode, p.stdout
+
+
+def analyze(entry, opts):
+    """Compiles and analyzes one TU, reusing the cache; returns the path of
+    its report, or raises RuntimeError with the output of the failed step."""
+    args = compile_args(entry)
+    source = source_path(entry)
+    key = hashlib.sha1(json.dumps(
+        [entry['directory'], source, opts.clang, args]).encode()).hexdigest()
+    base = os.path.join(opts.cache_dir, key)
+    bitcode, dep_file, report = base + '.bc', base + '.d', base + '.report'
+
+    deps = read_deps(dep_file) if os.path.exists(dep_file) else []
+    if not deps or not up_to_date(bitcode, deps):
+        cmd = [opts.clang] + args + ['-c', '-emit-llvm', '-g',
+                                     '-MD', '-MF', dep_file,
+                                     '-o', bitcode, source]
+        status, out = run(cmd, entry['directory'])
+        if status != 0:
+            raise RuntimeError(' '.join(cmd) + '\n' + out)
+
+    if not up_to_date(report, [bitcode]):
+        cmd = [opts.opt]
+        for plugin in opts.core_plugins + [opts.plugin]:
+            cmd += ['-load', plugin]
+        cmd += ['-aranot-metadata', '-aranot',
+                '-aranot-report', report + '.tmp', '-disable-output', bitcode]
+        status, out = run(cmd, entry['directory'])
+        if status != 0:
+            raise RuntimeError(' '.join(cmd) + '\n' + out)
+        os.replace(report + '.tmp', report)
+    return report
+
+
+def merge_reports(reports):
+    """Maps every file to its lines and their comments, without the
+    duplicates of the headers seen by several TUs, in the order found."""
+    comments = {}
+    for report in reports:
+        with open(report) as f:
+            for line in f:
+                m = REPORT_LINE.match(line.rstrip('\n'))
+                if not m:
+                    continue
+                lines = comments.setdefault(m.group(1), {})
+                texts = lines.setdefault(int(m.group(2)), [])
+                if m.group(3) not in texts:
+                    texts.append(m.group(3))
+    return comments
+
+
+def write_report(comments, path):
+    with open(path, 'w') as f:
+        for file in sorted(comments):
+            for line in sorted(comments[file]):
+                for text in comments[file][line]:
+                    f.write('%s:%d:%s\n' % (file, line, text))
+
+
+def write_annotated(comments, output_dir):
+    """Writes the sources with the comments above their lines, like
+    -aranot-output-dir."""
+    for file, lines in sorted(comments.items()):
+        output = os.path.join(output_dir, file.lstrip('/'))
+        os.makedirs(os.path.dirname(output), exist_ok=True)
+        try:
+            src = open(file, errors='replace')
+        except IOError:
+            sys.stderr.write('Could not read %s\n' % file)
+            continue
+        with src, open(output, 'w') as out:
+            for number, line in enumerate(src, 1):
+                texts = lines.get(number, [])
+                if texts:
+                    start = line[:len(line) - len(line.lstrip(' \t'))]
+                    width = max(len(t) for t in texts)
+                    for text in texts:
+                        out.write('%s/* %s */\n' % (start, text.ljust(width)))
+                out.write(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run ArAnot on every TU of a compile_commands.json.')
+    parser.add_argument('-p', dest='commands', default='.',
+                        help='compile_commands.json or its directory')
+    parser.add_argument('-j', dest='jobs', type=int,
+                        default=os.cpu_count() or 1, help='parallel jobs')
+    parser.add_argument('--cache-dir', default='.aranot-cache',
+                        help='bitcode and reports of the TUs')
+    parser.add_argument('--clang', default='clang')
+    parser.add_argument('--opt', default='opt')
+    parser.add_argument('--plugin', default='ArAnot.so')
+    parser.add_argument('--core-plugins',
+                        help='comma-separated shared analyses to load first '
+                        '(default: %s, next to --plugin)' %
+                        ','.join(CORE_PLUGINS))
+    parser.add_argument('--report', default='aranot-report.txt',
+                        help='merged report')
+    parser.add_argument('--output-dir',
+                        help='write the annotated sources under this directory')
+    opts = parser.parse_args()
+
+    opts.cache_dir = os.path.abspath(opts.cache_dir)
+    if opts.core_plugins is None:
+        opts.core_plugins = [os.path.join(os.path.dirname(opts.plugin), p)
+                             for p in CORE_PLUGINS]
+    else:
+        opts.core_plugins = [p for p in opts.core_plugins.split(',') if p]
+    os.makedirs(opts.cache_dir, exist_ok=True)
+    entries = load_commands(opts.commands)
+
+    reports = []
+    failed = 0
+    with concurrent.futures.ThreadPoolExecutor(opts.jobs) as pool:
+        jobs = dict((pool.submit(analyze, e, opts), e) for e in entries)
+        for job in concurrent.futures.as_completed(jobs):
+            try:
+                reports.append(job.result())
+            except RuntimeError as e:
+                failed += 1
+                sys.stderr.write('%s: %s\n' % (source_path(jobs[job]), e))
+
+    # The order of the comments of a line doesn't depend on the schedule
+    comments = merge_reports(sorted(reports))
+    write_report(comments, opts.report)
+    if opts.output_dir:
+        write_annotated(comments, opts.output_dir)
+
+    sys.stderr.write('%d TUs, %d failed, %d files annotated\n' %
+                     (len(entries), failed, len(comments)))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
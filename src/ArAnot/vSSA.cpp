@@ -2,6 +2,8 @@
 
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "vSSA.h"
 #include <iostream>
@@ -13,9 +15,19 @@ static const std::string vSSA_SIG = "sigma_node";
 
 static vSSA::ValueMapTy ValueMap;
 static vSSA::SigmaMapTy SigmaMap;
+static SmallPtrSet<Value*, 16> RequestedValues;
+
+static cl::opt<bool> ClPruned("vssa-pruned",
+		cl::desc("Only create the sigmas of values indexing a GEP, compared by a branch or requested"),
+		cl::init(false));
 
 STATISTIC(numsigmas, "Number of sigmas");
 STATISTIC(numphis, "Number of phis");
+STATISTIC(numpruned, "Number of sigmas not created by -vssa-pruned");
+
+void vSSA::requestSigmasFor(Value *V) {
+	RequestedValues.insert(V);
+}
 
 void vSSA::getAnalysisUsage(AnalysisUsage &AU) const {
 	AU.addRequiredID(BreakCriticalEdgesID);
@@ -47,12 +59,17 @@ Value *vSSA::getSigmaForAt(Value *V, BasicBlock *BB) {
 bool vSSA::runOnFunction(Function &F) {
 	DT_ = &getAnalysis<DominatorTree>();
 	DF_ = &getAnalysis<DominanceFrontier>();
+	// vSSA doesn't change the CFG, so the numbers hold for the whole function
+	DomTreeOrder Order(*DT_);
+	Order_ = &Order;
 	
 	// Iterate over all Basic Blocks of the Function, calling the function that creates sigma functions, if needed
 	for (Function::iterator Fit = F.begin(), Fend = F.end(); Fit != Fend; ++Fit) {
 		createSigmasIfNeeded(Fit);
 	}
 
+	Order_ = NULL;
+
 	return false;
 }
 
@@ -168,6 +185,10 @@ void vSSA::insertSigmas(TerminatorInst *TI, Value *V)
 
 		// If the successor is not BB itself and BB dominates the successor
 		if (BB_next != BB && BB_next->getSinglePredecessor() != NULL && dominateOrHasInFrontier(BB, BB_next, V)) {
+			if (ClPruned && !hasConsumedUse(BB_next, V)) {
+				++numpruned;
+				continue;
+			}
 			// Create the sigma function (but before, verify if there is already an identical sigma function)
       DEBUG(dbgs() << "Succ: " << BB_next->getName() << "\n");
 			if (verifySigmaExistance(V, BB_next, BB)) {
@@ -252,43 +273,42 @@ void vSSA::renameUsesToSigma(Value *V, PHINode *sigma)
 	// Get the dominance frontier of the successor
 	DominanceFrontier::iterator DF_BB = DF_->find(BB_next);
 	
-	// This vector of Instruction* points to the uses of V.
+	// The users of V, sorted in DFS order of the dominator tree.
 	// This auxiliary vector of pointers is used because the use_iterators are invalidated when we do the renaming
-	SmallVector<Instruction*, 25> usepointers;
-	unsigned i = 0, n = V->getNumUses();
-	usepointers.resize(n);
+	DomTreeOrder::UsersTy usepointers;
+	Order_->getSortedUsers(V, usepointers);
+	
+	// The uses in the dominator tree of sigma(V) are a range of the users
+	std::pair<DomTreeOrder::user_iterator, DomTreeOrder::user_iterator> dominated = Order_->getDominatedUsers(usepointers, BB_next);
+	for (DomTreeOrder::user_iterator uit = dominated.first; uit != dominated.second; ++uit) {
+		if (*uit != sigma)
+			(*uit)->replaceUsesOfWith(V, sigma);
+	}
 	
-	for (Value::use_iterator uit = V->use_begin(), uend = V->use_end(); uit != uend; ++uit, ++i)
-		usepointers[i] = dyn_cast<Instruction>(*uit);
+	// If BB_next has no dominance frontier, no other use is renamed
+	if (DF_BB == DF_->end())
+		return;
 	
-	for (i = 0; i < n; ++i) {
-		if (usepointers[i] ==  NULL) {
-			continue;
+	for (DomTreeOrder::user_iterator uit = usepointers.begin(), uend = usepointers.end(); uit != uend; ++uit) {
+		if (uit == dominated.first) {
+			uit = dominated.second;
+			if (uit == uend)
+				break;
 		}
-		if (usepointers[i] == sigma) {
-			continue;
-		}
-		/* if (isa<GetElementPtrInst>(usepointers[i])) {
-			continue;
-		} */
 		
-		BasicBlock *BB_user = usepointers[i]->getParent();
+		BasicBlock *BB_user = (*uit)->getParent();
 		
-		// Check if the use is in the dominator tree of sigma(V)
-		if (DT_->dominates(BB_next, BB_user)){
-			usepointers[i]->replaceUsesOfWith(V, sigma);
-		}
 		// Check if the use is in the dominance frontier of sigma(V)
-		else if ((DF_BB != DF_->end()) && (DF_BB->second.find(BB_user) != DF_BB->second.end())) {
+		if (DF_BB->second.find(BB_user) != DF_BB->second.end()) {
 			// Check if the user is a PHI node (it has to be, but only for precaution)
-			if (PHINode *phi = dyn_cast<PHINode>(usepointers[i])) {
+			if (PHINode *phi = dyn_cast<PHINode>(*uit)) {
 				for (unsigned i = 0, e = phi->getNumIncomingValues(); i < e; ++i) {
 					Value *operand = phi->getIncomingValue(i);
 					
 					if (operand != V)
 						continue;
 					
-					if (DT_->dominates(BB_next, phi->getIncomingBlock(i))) {
+					if (Order_->dominates(BB_next, phi->getIncomingBlock(i))) {
 						phi->setIncomingValue(i, sigma);
 					}
 				}
@@ -426,60 +446,11 @@ void vSSA::insertPhisForPhi(Value *V, PHINode *phi)
 void vSSA::renameUsesToPhi(Value *V, PHINode *phi)
 {
   DEBUG(dbgs() << "renaming uses of: " << *V << " to " << *phi << "\n");
-	// This vector of Instruction* points to the uses of operand.
-	// This auxiliary vector of pointers is used because the use_iterators are invalidated when we do the renaming
-	SmallVector<Instruction*, 25> usepointers;
-	unsigned i = 0, n = V->getNumUses();
-	 
-	usepointers.resize(n);
-	
 	// This vector contains pointers to all sigmas that have its operand renamed to vSSA_phi
 	// For them, we need to try to create phi functions again
 	SmallVector<PHINode*, 25> sigmasRenamed;
 	
-	BasicBlock *BB_next = phi->getParent();
-	
-	// Get the dominance frontier of the successor
-	DominanceFrontier::iterator DF_BB = DF_->find(BB_next);
-	
-	for (Value::use_iterator uit = V->use_begin(), uend = V->use_end(); uit != uend; ++uit, ++i)
-		usepointers[i] = dyn_cast<Instruction>(*uit);
-	
-	BasicBlock *BB_parent = phi->getParent();
-	 
-	for (i = 0; i < n; ++i) {
-		// Check if the use is in the dominator tree of vSSA_PHI
-		if (DT_->dominates(BB_parent, usepointers[i]->getParent())) {
-			if (BB_parent != usepointers[i]->getParent()) {
-				usepointers[i]->replaceUsesOfWith(V, phi);
-				
-				// If this use is in a sigma, we need to check whether phis creation are needed again for this sigma
-				if (PHINode *sigma = dyn_cast<PHINode>(usepointers[i])) {
-					if (sigma->getName().startswith(vSSA_SIG)) {
-						sigmasRenamed.push_back(sigma);
-					}
-				}
-			}
-			else if (!isa<PHINode>(usepointers[i]))
-				usepointers[i]->replaceUsesOfWith(V, phi);
-		}
-		// Check if the use is in the dominance frontier of phi
-	 	else if (DF_BB->second.find(usepointers[i]->getParent()) != DF_BB->second.end()) {
-	 		// Check if the user is a PHI node (it has to be, but only for precaution)
-	 		if (PHINode *phiuser = dyn_cast<PHINode>(usepointers[i])) {
-	 			for (unsigned i = 0, e = phiuser->getNumIncomingValues(); i < e; ++i) {
-	 				Value *operand = phiuser->getIncomingValue(i);
-	 				
-	 				if (operand != V)
-	 					continue;
-	 				
-	 				if (DT_->dominates(BB_next, phiuser->getIncomingBlock(i))) {
-	 					phiuser->setIncomingValue(i, phi);
-	 				}
-	 			}
-	 		}
-	 	}
-	}
+	renameUsesInTreeOf(V, phi, sigmasRenamed);
 	
 	for (unsigned k = 0, f = phi->getNumIncomingValues(); k < f; ++k) {
 		PHINode *p = dyn_cast<PHINode>(phi->getIncomingValue(k));
@@ -487,50 +458,7 @@ void vSSA::renameUsesToPhi(Value *V, PHINode *phi)
 		if (!p || !p->getName().startswith(vSSA_SIG))
 			continue;
 		
-		Value *V = p->getIncomingValue(0);
-		
-		n = V->getNumUses();
-		usepointers.resize(n);
-		
-		unsigned i = 0;
-		
-		for (Value::use_iterator uit = V->use_begin(), uend = V->use_end(); uit != uend; ++uit, ++i)
-			usepointers[i] = dyn_cast<Instruction>(*uit);
-		 
-		for (i = 0; i < n; ++i) {
-			// Check if the use is in the dominator tree of vSSA_PHI
-			if (DT_->dominates(BB_parent, usepointers[i]->getParent())) {
-				if (BB_parent != usepointers[i]->getParent()) {
-					usepointers[i]->replaceUsesOfWith(V, phi);
-				
-					// If this use is in a sigma, we need to check whether phis creation are needed again for this sigma
-					if (PHINode *sigma = dyn_cast<PHINode>(usepointers[i])) {
-						if (sigma->getName().startswith(vSSA_SIG)) {
-							sigmasRenamed.push_back(sigma);
-						}
-					}
-				}
-				else if (!isa<PHINode>(usepointers[i]))
-					usepointers[i]->replaceUsesOfWith(V, phi);
-			}
-			// Check if the use is in the dominance frontier of phi
-		 	else if (DF_BB->second.find(usepointers[i]->getParent()) != DF_BB->second.end()) {
-		 		// Check if the user is a PHI node (it has to be, but only for precaution)
-		 		if (PHINode *phiuser = dyn_cast<PHINode>(usepointers[i])) {
-		 			for (unsigned i = 0, e = phiuser->getNumIncomingValues(); i < e; ++i) {
-		 				Value *operand = phiuser->getIncomingValue(i);
-		 				
-		 				if (operand != V)
-		 					continue;
-		 				
-		 				if (DT_->dominates(BB_next, phiuser->getIncomingBlock(i))) {
-		 					phiuser->setIncomingValue(i, phi);
-		 				}
-		 			}
-		 		}
-		 	}
-		}
-		
+		renameUsesInTreeOf(p->getIncomingValue(0), phi, sigmasRenamed);
 	}
 	
 	// Try to create phis again for the sigmas whose operand was renamed to vSSA_phi
@@ -550,6 +478,68 @@ void vSSA::renameUsesToPhi(Value *V, PHINode *phi)
 /*
  *  Insert the sigma as an operand of the vSSA_phis contained in the vector
  */
+/*
+ * Renaming uses of V to uses of vSSA_PHI, for renameUsesToPhi.
+ * The users of V are sorted in DFS order of the dominator tree, so the uses in the dominator tree of vSSA_PHI are one range of them
+ */
+void vSSA::renameUsesInTreeOf(Value *V, PHINode *phi, SmallVectorImpl<PHINode*> &sigmasRenamed)
+{
+	// This auxiliary vector of pointers is used because the use_iterators are invalidated when we do the renaming
+	DomTreeOrder::UsersTy usepointers;
+	Order_->getSortedUsers(V, usepointers);
+	
+	BasicBlock *BB_parent = phi->getParent();
+	
+	// Get the dominance frontier of the phi
+	DominanceFrontier::iterator DF_BB = DF_->find(BB_parent);
+	
+	// The uses in the dominator tree of vSSA_PHI
+	std::pair<DomTreeOrder::user_iterator, DomTreeOrder::user_iterator> dominated = Order_->getDominatedUsers(usepointers, BB_parent);
+	for (DomTreeOrder::user_iterator uit = dominated.first; uit != dominated.second; ++uit) {
+		if (BB_parent != (*uit)->getParent()) {
+			(*uit)->replaceUsesOfWith(V, phi);
+			
+			// If this use is in a sigma, we need to check whether phis creation are needed again for this sigma
+			if (PHINode *sigma = dyn_cast<PHINode>(*uit)) {
+				if (sigma->getName().startswith(vSSA_SIG)) {
+					sigmasRenamed.push_back(sigma);
+				}
+			}
+		}
+		else if (!isa<PHINode>(*uit))
+			(*uit)->replaceUsesOfWith(V, phi);
+	}
+	
+	if (DF_BB == DF_->end())
+		return;
+	
+	// Check if the other uses are in the dominance frontier of phi
+	for (DomTreeOrder::user_iterator uit = usepointers.begin(), uend = usepointers.end(); uit != uend; ++uit) {
+		if (uit == dominated.first) {
+			uit = dominated.second;
+			if (uit == uend)
+				break;
+		}
+		
+		if (DF_BB->second.find((*uit)->getParent()) == DF_BB->second.end())
+			continue;
+		
+		// Check if the user is a PHI node (it has to be, but only for precaution)
+		if (PHINode *phiuser = dyn_cast<PHINode>(*uit)) {
+			for (unsigned i = 0, e = phiuser->getNumIncomingValues(); i < e; ++i) {
+				Value *operand = phiuser->getIncomingValue(i);
+				
+				if (operand != V)
+					continue;
+				
+				if (Order_->dominates(BB_parent, phiuser->getIncomingBlock(i))) {
+					phiuser->setIncomingValue(i, phi);
+				}
+			}
+		}
+	}
+}
+
 void vSSA::insertSigmaAsOperandOfPhis(SmallVector<PHINode*, 25> &vssaphi_created, PHINode *sigma)
 {
 	BasicBlock *BB = sigma->getParent();
@@ -634,18 +624,17 @@ bool vSSA::dominateAny(BasicBlock *BB, Value *value) {
 			return false;
 	}
 	
-	// Iterate over the uses of Value.
+	// Iterate over the uses of Value dominated by the BasicBlock in-frontier.
 	// If the use is in the BasicBlock in-frontier itself and it's a PHINode, it means that mem2reg already created a phi for this case, so we don't need to do it
-	// Otherwise, if the use is dominated by the BasicBlock in-frontier, we create the vSSA_PHI
-	for (Value::use_iterator begin = value->use_begin(), end = value->use_end(); begin != end; ++begin) {
-		Instruction *I = cast<Instruction>(*begin);
-		BasicBlock *BB_father = I->getParent();
-		if (BB == BB_father && isa<PHINode>(I)) {
+	// Otherwise we create the vSSA_PHI
+	DomTreeOrder::UsersTy users;
+	Order_->getSortedUsers(value, users);
+	std::pair<DomTreeOrder::user_iterator, DomTreeOrder::user_iterator> dominated = Order_->getDominatedUsers(users, BB);
+	for (DomTreeOrder::user_iterator uit = dominated.first; uit != dominated.second; ++uit) {
+		if (BB == (*uit)->getParent() && isa<PHINode>(*uit)) {
 			continue;
 		}
-		if (DT_->dominates(BB, BB_father)) {
-			return true;
-		}
+		return true;
 	}
 	return false;
 }
@@ -681,6 +670,47 @@ bool vSSA::dominateOrHasInFrontier(BasicBlock *BB, BasicBlock *BB_next, Value *v
 	return false;
 }
 
+/*
+ *  Used by -vssa-pruned. Verifies if a client requested V, or if a use of V
+ *  dominated by BB_next, directly or through casts, is a GEP index or a
+ *  comparison tested by a branch: the uses that the range analysis is asked about.
+ */
+bool vSSA::hasConsumedUse(BasicBlock *BB_next, Value *V) {
+	if (RequestedValues.count(V))
+		return true;
+
+	SmallVector<Value*, 4> worklist(1, V);
+	SmallPtrSet<Value*, 4> visited;
+	visited.insert(V);
+	while (!worklist.empty()) {
+		Value *value = worklist.pop_back_val();
+		for (Value::use_iterator begin = value->use_begin(), end = value->use_end(); begin != end; ++begin) {
+			Instruction *I = dyn_cast<Instruction>(*begin);
+			if (I == NULL)
+				continue;
+
+			// The casts themselves may be anywhere; their uses count
+			if (isa<CastInst>(I)) {
+				if (visited.insert(I))
+					worklist.push_back(I);
+				continue;
+			}
+
+			if (!DT_->dominates(BB_next, I->getParent()))
+				continue;
+
+			if (isa<GetElementPtrInst>(I) && begin.getOperandNo() != 0)
+				return true;
+
+			if (isa<ICmpInst>(I))
+				for (Value::use_iterator ubegin = I->use_begin(), uend = I->use_end(); ubegin != uend; ++ubegin)
+					if (isa<BranchInst>(*ubegin))
+						return true;
+		}
+	}
+	return false;
+}
+
 PHINode *vSSA::findSigma(Value *V, BasicBlock *BB, BasicBlock *BB_from)
 {
   DEBUG(dbgs() << "findSigma: " << *V << " :: " << BB->getName() << " :: " << BB_from->getName() << "\n");
@@ -6,6 +6,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/Transforms/Scalar.h"
+#include "DomTreeOrder.h"
 #include <deque>
 #include <algorithm>
 
@@ -17,28 +18,35 @@ public:
         typedef DenseMap<BasicBlock*, Value*> BlockMapTy;
         typedef DenseMap<Value*, BlockMapTy*> SigmaMapTy;
         static char ID; // Pass identification, replacement for typeid.
-        vSSA() : FunctionPass(ID) {}
+        vSSA() : FunctionPass(ID), Order_(NULL) {}
         void getAnalysisUsage(AnalysisUsage &AU) const;
         Value *getSigmaForAt(Value *V, BasicBlock *BB);
         bool runOnFunction(Function&);
         PHINode *findSigma(Value *V, BasicBlock *BB, BasicBlock *from);
         PHINode *findSExtSigma(Value *V, BasicBlock *BB, BasicBlock *BB_from);
+        // With -vssa-pruned, the sigmas of V are created even without a GEP
+        // or branch using it. Must be called before the pass runs.
+        static void requestSigmasFor(Value *V);
 
 private:
         // Variables always live
         DominatorTree *DT_;
         DominanceFrontier *DF_;
+        // DFS numbers of DT_, for the dominance queries on use lists
+        DomTreeOrder *Order_;
         void createSigmasIfNeeded(BasicBlock *BB);
         void insertSigmas(TerminatorInst *TI, Value *V);
         void renameUsesToSigma(Value *V, PHINode *sigma);
         SmallVector<PHINode*, 25> insertPhisForSigma(Value *V, PHINode *sigma);
         void insertPhisForPhi(Value *V, PHINode *phi);
         void renameUsesToPhi(Value *V, PHINode *phi);
+        void renameUsesInTreeOf(Value *V, PHINode *phi, SmallVectorImpl<PHINode*> &sigmasRenamed);
         void insertSigmaAsOperandOfPhis(SmallVector<PHINode*, 25> &vssaphi_created, PHINode *sigma);
         void populatePhis(SmallVector<PHINode*, 25> &vssaphi_created, Value *V);
         bool dominateAny(BasicBlock *BB, Value *value);
         bool dominateOrHasInFrontier(BasicBlock *BB, BasicBlock *BB_next, Value *value);
         bool verifySigmaExistance(Value *V, BasicBlock *BB, BasicBlock *from);
+        bool hasConsumedUse(BasicBlock *BB_next, Value *V);
 };
 
 }
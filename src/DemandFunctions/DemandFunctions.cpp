@@ -0,0 +1,205 @@
+#define DEBUG_TYPE "demand-functions"
+#include "DemandFunctions.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/Support/raw_ostream.h"
+#include "../PassProfile/PassProfile.h"
+
+#include <string>
+
+using namespace llvm;
+
+STATISTIC(NumKept, "Number of function bodies kept for the query");
+STATISTIC(NumDropped, "Number of function bodies dropped");
+
+static cl::list<std::string> DemandRoots("demand-func",
+		cl::desc("Function whose body, and its callees', the analyses need"),
+		cl::value_desc("name"), cl::ZeroOrMore);
+
+static cl::list<std::string> DemandSinks("demand-sink",
+		cl::desc("Function whose callers are roots of -demand-functions"),
+		cl::value_desc("name"), cl::ZeroOrMore);
+
+static cl::opt<bool> DemandCallers("demand-callers",
+		cl::desc("Keep also the bodies of the functions that call the roots"),
+		cl::init(false));
+
+void DemandFunctions::getAnalysisUsage(AnalysisUsage &AU) const {
+	// Runs before the analyses, and preserves none of them
+}
+
+bool DemandFunctions::materialize(Module &M, Function* F) {
+	if (!M.isMaterializable(F))
+		return !F->isDeclaration();
+	std::string error;
+	if (M.Materialize(F, &error)) {
+		errs() << "demand-functions: can't read " << F->getName() << ": "
+				<< error << "\n";
+		return false;
+	}
+	return true;
+}
+
+static bool materializeAll(Module &M) {
+	std::string error;
+	if (M.MaterializeAll(&error)) {
+		errs() << "demand-functions: can't read the module: " << error << "\n";
+		return false;
+	}
+	return true;
+}
+
+// The function that makes the call U, if U calls F
+static Function* getCaller(Value::use_iterator U) {
+	CallSite CS(*U);
+	if (!CS || !CS.isCallee(U))
+		return NULL;
+	return CS.getInstruction()->getParent()->getParent();
+}
+
+static bool hasIndirectCall(Function* F) {
+	for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+		CallSite CS(&*I);
+		if (CS && !CS.getCalledFunction() && !CS.isInlineAsm())
+			return true;
+	}
+	return false;
+}
+
+void DemandFunctions::findRoots(Module &M, SmallVectorImpl<Function*>& roots) {
+	for (unsigned i = 0; i < DemandRoots.size(); ++i) {
+		Function* F = M.getFunction(DemandRoots[i]);
+		if (F)
+			roots.push_back(F);
+		else
+			errs() << "demand-functions: no function " << DemandRoots[i] << "\n";
+	}
+
+	for (unsigned i = 0; i < DemandSinks.size(); ++i) {
+		Function* S = M.getFunction(DemandSinks[i]);
+		if (!S) {
+			errs() << "demand-functions: no function " << DemandSinks[i] << "\n";
+			continue;
+		}
+		for (Value::use_iterator U = S->use_begin(), E = S->use_end(); U != E; ++U)
+			if (Function* caller = getCaller(U))
+				roots.push_back(caller);
+	}
+}
+
+/*
+ * The callers of the roots, up to the functions nothing calls. A function
+ * whose address is taken may be called by any indirect call.
+ */
+void DemandFunctions::addCallers(Module &M, SmallVectorImpl<Function*>& roots) {
+	std::vector<Function*> indirectCallers;
+	for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+		if (!F->isDeclaration() && hasIndirectCall(F))
+			indirectCallers.push_back(F);
+
+	SmallPtrSet<Function*, 64> seen;
+	for (unsigned i = 0; i < roots.size(); ++i)
+		seen.insert(roots[i]);
+
+	for (unsigned i = 0; i < roots.size(); ++i) {
+		Function* F = roots[i];
+		for (Value::use_iterator U = F->use_begin(), E = F->use_end(); U != E; ++U) {
+			Function* caller = getCaller(U);
+			if (caller && seen.insert(caller))
+				roots.push_back(caller);
+		}
+		if (F->hasAddressTaken())
+			for (unsigned j = 0; j < indirectCallers.size(); ++j)
+				if (seen.insert(indirectCallers[j]))
+					roots.push_back(indirectCallers[j]);
+	}
+}
+
+/*
+ * Marks the functions of worklist and everything they call as kept,
+ * materializing each body once it is reached. The first indirect call
+ * keeps every function whose address is taken; their uses are only all
+ * known once the whole module is read.
+ */
+void DemandFunctions::addCallees(Module &M, SmallVectorImpl<Function*>& worklist) {
+	bool addressTaken = false;
+
+	while (!worklist.empty()) {
+		Function* F = worklist.pop_back_val();
+		if (!kept.insert(F) || !materialize(M, F))
+			continue;
+
+		for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+			CallSite CS(&*I);
+			if (!CS || CS.isInlineAsm())
+				continue;
+			if (Function* callee = CS.getCalledFunction()) {
+				if (!kept.count(callee))
+					worklist.push_back(callee);
+				continue;
+			}
+			if (addressTaken)
+				continue;
+
+			addressTaken = true;
+			if (!materializeAll(M))
+				continue;
+			for (Module::iterator G = M.begin(), GE = M.end(); G != GE; ++G)
+				if (G->hasAddressTaken() && !kept.count(G))
+					worklist.push_back(G);
+		}
+	}
+}
+
+bool DemandFunctions::runOnModule(Module &M) {
+	PassProfileScope scope("DemandFunctions", "demand");
+	kept.clear();
+
+	// The callers of a function are only all known once every body is read
+	if ((DemandCallers || !DemandSinks.empty()) && !materializeAll(M))
+		return false;
+
+	SmallVector<Function*, 16> roots;
+	findRoots(M, roots);
+	if (roots.empty()) {
+		errs() << "demand-functions: no roots; give -demand-func or "
+				"-demand-sink. Every body is kept\n";
+		return false;
+	}
+
+	if (DemandCallers)
+		addCallers(M, roots);
+	addCallees(M, roots);
+
+	bool changed = false;
+	for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+		if (kept.count(F)) {
+			if (!F->isDeclaration())
+				NumKept++;
+			continue;
+		}
+		// An unread body is a declaration already
+		if (F->isDeclaration())
+			continue;
+
+		DEBUG(dbgs() << "demand-functions: dropping " << F->getName() << "\n");
+		if (M.isDematerializable(F))
+			M.Dematerialize(F);
+		else
+			F->deleteBody();
+		NumDropped++;
+		changed = true;
+	}
+
+	PassProfile::get().counter("kept functions", "demand", NumKept);
+	PassProfile::get().counter("dropped functions", "demand", NumDropped);
+	return changed;
+}
+
+char DemandFunctions::ID = 0;
+static RegisterPass<DemandFunctions> X("demand-functions",
+		"Keep only the function bodies a targeted query reaches");
@@ -0,0 +1,62 @@
+#ifndef DEMANDFUNCTIONS_H_
+#define DEMANDFUNCTIONS_H_
+
+#include "llvm/Pass.h"
+#include "llvm/IR/Module.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include <vector>
+
+namespace llvm {
+
+/*
+ * Class DemandFunctions
+ *
+ * Module pass that keeps the bodies of the functions a targeted query can
+ * reach and leaves every other function a declaration, so that the
+ * analyses run after it (the demand range analysis, the taint analysis,
+ * ga-asan with -ga-asan-debug-func) build nothing for the rest:
+ *
+ *     opt -load ... -load DemandFunctions.so -demand-functions
+ *         -demand-func=parse_header -ra-demand -ra-inter-cousot prog.bc
+ *
+ * The roots are the functions of -demand-func and the callers of the
+ * functions of -demand-sink. The bodies kept are those of the roots and
+ * of everything they call, directly or through a pointer; with
+ * -demand-callers, also those of the functions that call the roots, so
+ * that a root's arguments get the values its callers pass. A dropped
+ * function is seen by the analyses as any external function.
+ *
+ * A module read lazily (getLazyIRFileModule) has only the kept bodies
+ * materialized, so the other bodies are never parsed; one read by opt is
+ * whole, and the other bodies are deleted. -demand-callers has to see
+ * every call, so it materializes every body, and dematerializes the ones
+ * it doesn't keep.
+ */
+class DemandFunctions: public ModulePass {
+public:
+	static char ID;
+	DemandFunctions() :
+		ModulePass(ID) {
+	}
+	void getAnalysisUsage(AnalysisUsage &AU) const;
+	bool runOnModule(Module &M);
+
+	bool isKept(const Function* F) const {
+		return kept.count(F);
+	}
+
+private:
+	SmallPtrSet<const Function*, 64> kept;
+
+	// Makes the body of F available; false if it can't be read
+	bool materialize(Module &M, Function* F);
+
+	void findRoots(Module &M, SmallVectorImpl<Function*>& roots);
+	void addCallers(Module &M, SmallVectorImpl<Function*>& roots);
+	void addCallees(Module &M, SmallVectorImpl<Function*>& worklist);
+};
+
+}
+
+#endif /* DEMANDFUNCTIONS_H_ */
@@ -1,4 +1,14 @@
 #include "DepGraph.h"
+#include "DepGraphFile.h"
+#include "../LibraryModels/LibraryModels.h"
+#include "../PassProfile/ModuleMetrics.h"
+#include "../PassProfile/PassProfile.h"
+#include "llvm/DebugInfo.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/InstIterator.h"
+#include <sys/time.h>
+#include <pthread.h>
 
 using namespace llvm;
 
@@ -6,6 +16,43 @@ static cl::opt<bool, false> includeAllInstsInDepGraph(
 		"includeAllInstsInDepGraph",
 		cl::desc("Include All Instructions In DepGraph."), cl::NotHidden);
 
+static cl::opt<bool, false> useReachabilityIndex("depgraph-reach-index",
+		cl::desc("Answer reachability queries of DepGraph with an index."),
+		cl::NotHidden);
+
+static cl::opt<unsigned> depGraphThreads("depgraph-threads",
+		cl::desc("Threads building the module dependence graph (1)"),
+		cl::init(1));
+
+static cl::list<std::string> dotFunctions("depgraph-dot-function",
+		cl::desc("Write only the nodes of this function (view-depgraph)"),
+		cl::ZeroOrMore);
+
+static cl::list<std::string> dotValues("depgraph-dot-around",
+		cl::desc("Write only the nodes near this value (view-depgraph)"),
+		cl::ZeroOrMore);
+
+static cl::opt<unsigned> dotHops("depgraph-dot-hops",
+		cl::desc("Hops around the values of -depgraph-dot-around (2)"),
+		cl::init(2));
+
+static cl::opt<bool, false> dotControlEdges("depgraph-dot-control",
+		cl::desc("Write only the control edges (view-depgraph)"),
+		cl::NotHidden);
+
+static cl::opt<bool, false> splitMemNodes("depgraph-split-mem",
+		cl::desc("Split the memory nodes of moduleDepGraph by the ranged "
+			"alias sets of a -ranged-alias-sets run before it"),
+		cl::NotHidden);
+
+STATISTIC(NrSplitAliasSets, "Number of alias sets split by their memory ranges");
+
+STATISTIC(NrReachIndexBuilds, "Number of reachability index builds");
+STATISTIC(ReachIndexBuildTime, "Time building reachability indexes (us)");
+STATISTIC(ReachIndexBytes, "Memory of the last reachability index (bytes)");
+STATISTIC(NrReachQueries, "Number of reachability queries");
+STATISTIC(NrReachSearches, "Number of reachability queries that searched");
+
 //*********************************************************************************************************************************************************************
 //                                                                                                                              DEPENDENCE GRAPH API
 //*********************************************************************************************************************************************************************
@@ -21,22 +68,116 @@ static cl::opt<bool, false> includeAllInstsInDepGraph(
 
 //FIXME: Deal properly with invoke instructions. An Invoke instruction can be treated as a call node
 
+/*
+ * Class NodeArena
+ */
+
+llvm::NodeArena::NodeArena(const NodeArena& other) :
+	current(NULL), left(0), bytes(0) {
+	splice(const_cast<NodeArena&> (other));
+}
+
+llvm::NodeArena::~NodeArena() {
+	for (unsigned i = 0; i < slabs.size(); ++i)
+		free(slabs[i]);
+}
+
+void* llvm::NodeArena::allocate(size_t size) {
+	size = (size + 15) & ~(size_t) 15;
+
+	//Big requests get a slab of their own, so the current one isn't wasted
+	if (size > SlabSize / 4) {
+		char* slab = (char*) malloc(size);
+		if (!slab)
+			throw std::bad_alloc();
+		slabs.push_back(slab);
+		bytes += size;
+		return slab;
+	}
+
+	if (size > left) {
+		current = (char*) malloc(SlabSize);
+		if (!current)
+			throw std::bad_alloc();
+		slabs.push_back(current);
+		left = SlabSize;
+		bytes += SlabSize;
+	}
+
+	void* p = current;
+	current += size;
+	left -= size;
+	return p;
+}
+
+void llvm::NodeArena::splice(NodeArena& other) {
+	if (&other == this)
+		return;
+	slabs.insert(slabs.end(), other.slabs.begin(), other.slabs.end());
+	bytes += other.bytes;
+	other.slabs.clear();
+	other.current = NULL;
+	other.left = 0;
+	other.bytes = 0;
+}
+
+size_t llvm::NodeArena::getNumBytes() const {
+	return bytes;
+}
+
 /*
  * Class GraphNode
  */
 
+//Every node is preceded by a header saying where its memory came from; 16
+//bytes keep the node itself aligned as malloc would
+static const size_t NodeHeader = 16;
+static const size_t HeapNode = 0;
+static const size_t ArenaNode = 1;
+
+void* GraphNode::operator new(size_t size) {
+	char* p = (char*) ::operator new(size + NodeHeader);
+	*(size_t*) p = HeapNode;
+	return p + NodeHeader;
+}
+
+void* GraphNode::operator new(size_t size, NodeArena& arena) {
+	char* p = (char*) arena.allocate(size + NodeHeader);
+	*(size_t*) p = ArenaNode;
+	return p + NodeHeader;
+}
+
+void GraphNode::operator delete(void* p) {
+	if (!p)
+		return;
+	char* header = (char*) p - NodeHeader;
+	if (*(size_t*) header == HeapNode)
+		::operator delete(header);
+}
+
+void GraphNode::operator delete(void* p, NodeArena& arena) {
+	//Only called if a constructor throws; the arena frees the memory
+}
+
 GraphNode::GraphNode() {
 	Class_ID = 0;
-	ID = currentID++;
+	ID = -1;
+	compactGraph = NULL;
+	index = 0;
 }
 
 GraphNode::GraphNode(GraphNode &G) {
 	Class_ID = 0;
-	ID = currentID++;
+	ID = -1;
+	compactGraph = NULL;
+	index = 0;
 }
 
 GraphNode::~GraphNode() {
 
+	if (compactGraph)
+		compactGraph->expand();
+
 	for (std::map<GraphNode*, edgeType>::iterator pred = predecessors.begin(); pred
 			!= predecessors.end(); pred++) {
 		(*pred).first->successors.erase(this);
@@ -54,15 +195,83 @@ GraphNode::~GraphNode() {
 }
 
 std::map<GraphNode*, edgeType> llvm::GraphNode::getSuccessors() {
-	return successors;
+	if (!compactGraph)
+		return successors;
+
+	std::map<GraphNode*, edgeType> result;
+	Graph* G = compactGraph;
+	for (unsigned i = G->succOffsets[index], e =
+			G->succOffsets[index + 1]; i != e; ++i)
+		result[G->nodeList[Graph::edgeIndex(G->succEdges[i])]]
+				= Graph::edgeKind(G->succEdges[i]);
+	return result;
 }
 
 std::map<GraphNode*, edgeType> llvm::GraphNode::getPredecessors() {
-	return predecessors;
+	if (!compactGraph)
+		return predecessors;
+
+	std::map<GraphNode*, edgeType> result;
+	Graph* G = compactGraph;
+	for (unsigned i = G->predOffsets[index], e =
+			G->predOffsets[index + 1]; i != e; ++i)
+		result[G->nodeList[Graph::edgeIndex(G->predEdges[i])]]
+				= Graph::edgeKind(G->predEdges[i]);
+	return result;
+}
+
+GraphNode::edge_range llvm::GraphNode::makeRange(
+		const std::map<GraphNode*, edgeType>& edges,
+		const std::vector<unsigned>* compactEdges,
+		const std::vector<unsigned>* compactOffsets, int filter) {
+	edge_range range;
+	range.first.filter = range.second.filter = filter;
+
+	if (compactGraph) {
+		const unsigned* base = compactEdges->empty() ? NULL : &(*compactEdges)[0];
+		range.first.graph = range.second.graph = compactGraph;
+		range.first.edge = base + (*compactOffsets)[index];
+		range.first.edgeEnd = range.second.edge = range.second.edgeEnd = base
+				+ (*compactOffsets)[index + 1];
+	} else {
+		range.first.mapIt = edges.begin();
+		range.first.mapEnd = range.second.mapIt = range.second.mapEnd
+				= edges.end();
+	}
+
+	range.first.skip();
+	return range;
+}
+
+GraphNode::edge_range llvm::GraphNode::outEdges() {
+	return makeRange(successors, compactGraph ? &compactGraph->succEdges : NULL,
+			compactGraph ? &compactGraph->succOffsets : NULL, -1);
+}
+
+GraphNode::edge_range llvm::GraphNode::outEdges(edgeType type) {
+	return makeRange(successors, compactGraph ? &compactGraph->succEdges : NULL,
+			compactGraph ? &compactGraph->succOffsets : NULL, type);
+}
+
+GraphNode::edge_range llvm::GraphNode::inEdges() {
+	return makeRange(predecessors,
+			compactGraph ? &compactGraph->predEdges : NULL,
+			compactGraph ? &compactGraph->predOffsets : NULL, -1);
+}
+
+GraphNode::edge_range llvm::GraphNode::inEdges(edgeType type) {
+	return makeRange(predecessors,
+			compactGraph ? &compactGraph->predEdges : NULL,
+			compactGraph ? &compactGraph->predOffsets : NULL, type);
 }
 
 void llvm::GraphNode::connect(GraphNode* dst, edgeType type) {
 
+	if (compactGraph)
+		compactGraph->expand();
+	if (dst->compactGraph)
+		dst->compactGraph->expand();
+
 	unsigned int curSize = this->successors.size();
 	this->successors[dst] = type;
 	dst->predecessors[this] = type;
@@ -79,12 +288,28 @@ int llvm::GraphNode::getId() const {
 	return ID;
 }
 
+//Binary search for the packed edges to node index in edges[begin, end)
+static bool hasCompactEdge(const std::vector<unsigned>& edges, unsigned begin,
+		unsigned end, unsigned index) {
+	std::vector<unsigned>::const_iterator it = std::lower_bound(
+			edges.begin() + begin, edges.begin() + end, index << 1);
+	return it != edges.begin() + end && (*it >> 1) == index;
+}
+
 bool llvm::GraphNode::hasSuccessor(GraphNode* succ) {
-	return successors.count(succ) > 0;
+	if (!compactGraph)
+		return successors.count(succ) > 0;
+	return succ->compactGraph == compactGraph && hasCompactEdge(
+			compactGraph->succEdges, compactGraph->succOffsets[index],
+			compactGraph->succOffsets[index + 1], succ->index);
 }
 
 bool llvm::GraphNode::hasPredecessor(GraphNode* pred) {
-	return predecessors.count(pred) > 0;
+	if (!compactGraph)
+		return predecessors.count(pred) > 0;
+	return pred->compactGraph == compactGraph && hasCompactEdge(
+			compactGraph->predEdges, compactGraph->predOffsets[index],
+			compactGraph->predOffsets[index + 1], pred->index);
 }
 
 std::string llvm::GraphNode::getName() {
@@ -97,8 +322,6 @@ std::string llvm::GraphNode::getStyle() {
 	return std::string("solid");
 }
 
-int llvm::GraphNode::currentID = 0;
-
 /*
  * Class OpNode
  */
@@ -217,13 +440,15 @@ GraphNode* llvm::VarNode::clone() {
  * Class MemNode
  */
 std::set<llvm::Value*> llvm::MemNode::getAliases() {
-	return USE_ALIAS_SETS ? AS->getValueSets()[aliasSetID] : std::set<
+	return USE_ALIAS_SETS ? AS->getValueSet(aliasSetID) : std::set<
 			llvm::Value*>();
 }
 
 std::string llvm::MemNode::getLabel() {
 	std::ostringstream stringStream;
 	stringStream << "Memory " << aliasSetID;
+	if (isCoarse())
+		stringStream << " (unified)";
 	return stringStream.str();
 }
 
@@ -241,6 +466,10 @@ std::string llvm::MemNode::getStyle() {
 	return std::string("dashed");
 }
 
+bool llvm::MemNode::isCoarse() const {
+	return AS && AS->isUnified();
+}
+
 int llvm::MemNode::getAliasSetId() const {
 	return aliasSetID;
 }
@@ -257,12 +486,52 @@ std::set<GraphNode*>::iterator Graph::end() {
 }
 
 Graph::~Graph() {
-	for (std::set<GraphNode*>::iterator it = nodes.begin(); it != nodes.end(); ++it) {
-		GraphNode* g = *it;
-		delete g;
+	//The nodes are deleted together, so there is no need to expand the edges
+	//just to unlink them one by one
+	if (compacted) {
+		NrEdges -= succEdges.size();
+		for (std::vector<GraphNode*>::iterator it = nodeList.begin(); it
+				!= nodeList.end(); ++it)
+			if (*it)
+				(*it)->compactGraph = NULL;
+	} else {
+		//Only the edges to nodes of other graphs have to be unlinked
+		for (std::vector<GraphNode*>::iterator it = nodeList.begin(); it
+				!= nodeList.end(); ++it) {
+			GraphNode* node = *it;
+			if (!node)
+				continue;
+
+			for (std::map<GraphNode*, edgeType>::iterator succ =
+					node->successors.begin(), end = node->successors.end(); succ
+					!= end; ++succ) {
+				NrEdges--;
+				if (!hasNode(succ->first))
+					succ->first->predecessors.erase(node);
+			}
+
+			for (std::map<GraphNode*, edgeType>::iterator pred =
+					node->predecessors.begin(), end = node->predecessors.end(); pred
+					!= end; ++pred) {
+				if (!hasNode(pred->first)) {
+					pred->first->successors.erase(node);
+					NrEdges--;
+				}
+			}
+
+			node->successors.clear();
+			node->predecessors.clear();
+		}
 	}
 
+	//Nodes of the arena only run their destructors here; the arena member
+	//frees their memory afterwards
+	for (std::vector<GraphNode*>::iterator it = nodeList.begin(); it
+			!= nodeList.end(); ++it)
+		delete *it;
+
 	nodes.clear();
+	nodeList.clear();
 
 }
 
@@ -273,10 +542,10 @@ int Graph::getTaintedEdges() {
 
 	for (llvm::DenseMap<GraphNode*, bool>::iterator it = taintedMap.begin(); it
 			!= taintedMap.end(); ++it) {
-		std::map<GraphNode*, edgeType> succs = it->first->getSuccessors();
-		for (std::map<GraphNode*, edgeType>::iterator succ = succs.begin(),
-				s_end = succs.end(); succ != s_end; succ++) {
-			if (taintedMap.count(succ->first) > 0) {
+		GraphNode::edge_range succs = it->first->outEdges();
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+			if (taintedMap.count(*succ) > 0) {
 				countEdges++;
 			}
 		}
@@ -293,49 +562,27 @@ Graph Graph::generateSubGraph(Value *src, Value *dst) {
 
 	std::map<GraphNode*, GraphNode*> nodeMap;
 
-	std::set<GraphNode*> visitedNodes1;
-	std::set<GraphNode*> visitedNodes2;
-
-	GraphNode* source = findOpNode(src);
-	if (!source)
-		source = findNode(src);
-
-	GraphNode* destination = findNode(dst);
-
-	if (source == NULL || destination == NULL) {
-		return G;
-	}
-
-	dfsVisit(source, destination, visitedNodes1);
-	dfsVisitBack(destination, source, visitedNodes2);
-
-	//check the nodes visited in both directions
-	for (std::set<GraphNode*>::iterator it = visitedNodes1.begin(); it
-			!= visitedNodes1.end(); ++it) {
-		if (visitedNodes2.count(*it) > 0) {
-			nodeMap[*it] = (*it)->clone();
-			//Armazena os nós originais no mapa estático
-			if (taintedMap.count(*it) == 0) {
-				taintedMap[*it] = true;
-			}
-		}
-	}
+	//Copy the nodes on the paths from src to dst
+	SubGraph sub = getSubGraph(src, dst);
+	for (std::vector<GraphNode*>::const_iterator it = sub.getNodes().begin(); it
+			!= sub.getNodes().end(); ++it)
+		nodeMap[*it] = (*it)->clone();
 
 	//connect the new vertices
 	for (std::map<GraphNode*, GraphNode*>::iterator it = nodeMap.begin(); it
 			!= nodeMap.end(); ++it) {
 
-		std::map<GraphNode*, edgeType> succs = it->first->getSuccessors();
+		GraphNode::edge_range succs = it->first->outEdges();
 
-		for (std::map<GraphNode*, edgeType>::iterator succ = succs.begin(),
-				s_end = succs.end(); succ != s_end; succ++) {
-			if (nodeMap.count(succ->first) > 0) {
-				it->second->connect(nodeMap[succ->first], succ->second);
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+			if (nodeMap.count(*succ) > 0) {
+				it->second->connect(nodeMap[*succ], succ.getType());
 			}
 		}
 
 		if (!G.nodes.count(it->second)) {
-			G.nodes.insert(it->second);
+			G.insertNode(it->second);
 
 			if (isa<VarNode> (it->second)) {
 				G.varNodes[dyn_cast<VarNode> (it->second)->getValue()]
@@ -365,6 +612,188 @@ Graph Graph::generateSubGraph(Value *src, Value *dst) {
 	return G;
 }
 
+void llvm::Graph::startBackVisit() {
+	backMarks.resize(nodeList.size(), 0);
+
+	if (++backEpoch == 0) {
+		std::fill(backMarks.begin(), backMarks.end(), 0);
+		backEpoch = 1;
+	}
+}
+
+llvm::Graph::SubGraph llvm::Graph::getSubGraph(Value *src, Value *dst) {
+	SubGraph result;
+	result.graph = this;
+
+	GraphNode* source = findOpNode(src);
+	if (!source)
+		source = findNode(src);
+
+	GraphNode* destination = findNode(dst);
+
+	if (source == NULL || destination == NULL)
+		return result;
+
+	//The forward search uses the visit marks and doesn't go past the
+	//destination; the backward one uses the back marks and doesn't go past
+	//the source. Both are breadth first, one level at a time, on the side
+	//with the smaller frontier, until some node is reached by both.
+	std::vector<GraphNode*> forward(1, source), backward(1, destination);
+	unsigned fwdHead = 0, bwdHead = 0;
+	startVisit();
+	startBackVisit();
+	markVisited(source);
+	markBackVisited(destination);
+	bool met = source == destination;
+
+	while (!met && fwdHead < forward.size() && bwdHead < backward.size()) {
+		bool fwd = forward.size() - fwdHead <= backward.size() - bwdHead;
+		std::vector<GraphNode*>& queue = fwd ? forward : backward;
+		unsigned& head = fwd ? fwdHead : bwdHead;
+
+		for (unsigned end = queue.size(); head < end && !met; ++head) {
+			GraphNode* node = queue[head];
+			if (node == (fwd ? destination : source))
+				continue;
+
+			GraphNode::edge_range edges = fwd ? node->outEdges()
+					: node->inEdges();
+			for (GraphNode::edge_iterator e = edges.begin(), e_end =
+					edges.end(); e != e_end; ++e) {
+				if (fwd ? isVisited(*e) : isBackVisited(*e))
+					continue;
+				if (fwd)
+					markVisited(*e);
+				else
+					markBackVisited(*e);
+				queue.push_back(*e);
+				met |= fwd ? isBackVisited(*e) : isVisited(*e);
+			}
+		}
+	}
+
+	//One of the searches ran out: dst doesn't depend on src
+	if (!met)
+		return result;
+
+	for (; fwdHead < forward.size(); ++fwdHead) {
+		GraphNode* node = forward[fwdHead];
+		if (node == destination)
+			continue;
+
+		GraphNode::edge_range succs = node->outEdges();
+		for (GraphNode::edge_iterator succ = succs.begin(), s_end =
+				succs.end(); succ != s_end; ++succ)
+			if (!isVisited(*succ)) {
+				markVisited(*succ);
+				forward.push_back(*succ);
+			}
+	}
+
+	//Search backwards again, now only through the nodes reached forwards,
+	//so this search is as big as the subgraph
+	startBackVisit();
+	markBackVisited(destination);
+	std::vector<GraphNode*>& onPath = result.nodes;
+	onPath.push_back(destination);
+	for (unsigned i = 0; i < onPath.size(); ++i) {
+		GraphNode* node = onPath[i];
+		if (node == source)
+			continue;
+
+		GraphNode::edge_range preds = node->inEdges();
+		for (GraphNode::edge_iterator pred = preds.begin(), p_end =
+				preds.end(); pred != p_end; ++pred)
+			if (isVisited(*pred) && !isBackVisited(*pred)) {
+				markBackVisited(*pred);
+				onPath.push_back(*pred);
+			}
+	}
+
+	std::sort(onPath.begin(), onPath.end(), SubGraph::byIndex);
+
+	//Armazena os nós originais no mapa estático
+	for (unsigned i = 0; i < onPath.size(); ++i)
+		if (taintedMap.count(onPath[i]) == 0)
+			taintedMap[onPath[i]] = true;
+
+	return result;
+}
+
+bool llvm::Graph::SubGraph::byIndex(GraphNode* a, GraphNode* b) {
+	return a->index < b->index;
+}
+
+bool llvm::Graph::SubGraph::hasNode(GraphNode* node) const {
+	std::vector<GraphNode*>::const_iterator it = std::lower_bound(
+			nodes.begin(), nodes.end(), node, byIndex);
+	return it != nodes.end() && *it == node;
+}
+
+unsigned llvm::Graph::SubGraph::getNumEdges(edgeType type) const {
+	unsigned count = 0;
+	for (unsigned i = 0; i < nodes.size(); ++i) {
+		GraphNode::edge_range succs = nodes[i]->outEdges(type);
+		for (GraphNode::edge_iterator succ = succs.begin(), s_end =
+				succs.end(); succ != s_end; ++succ)
+			if (hasNode(*succ))
+				count++;
+	}
+	return count;
+}
+
+unsigned llvm::Graph::SubGraph::getNumDataEdges() const {
+	return getNumEdges(etData);
+}
+
+unsigned llvm::Graph::SubGraph::getNumControlEdges() const {
+	return getNumEdges(etControl);
+}
+
+void llvm::Graph::SubGraph::toDot(std::string s, const std::string fileName) const {
+
+	std::string ErrorInfo;
+
+	raw_fd_ostream File(fileName.c_str(), ErrorInfo);
+
+	if (!ErrorInfo.empty()) {
+		errs() << "Error opening file " << fileName
+				<< " for writing! Error Info: " << ErrorInfo << " \n";
+		return;
+	}
+
+	this->toDot(s, &File);
+
+}
+
+void llvm::Graph::SubGraph::toDot(std::string s, raw_ostream *stream) const {
+
+	(*stream) << "digraph \"DFG for \'" << s << "\' function \"{\n";
+	(*stream) << "label=\"DFG for \'" << s << "\' function\";\n";
+
+	for (unsigned i = 0; i < nodes.size(); ++i)
+		(*stream) << nodes[i]->getName() << "[shape=" << nodes[i]->getShape()
+				<< ",style=" << nodes[i]->getStyle() << ",label=\""
+				<< nodes[i]->getLabel() << "\"]\n";
+
+	for (unsigned i = 0; i < nodes.size(); ++i) {
+		GraphNode::edge_range succs = nodes[i]->outEdges();
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+			if (!hasNode(*succ))
+				continue;
+
+			(*stream) << "\"" << nodes[i]->getName() << "\"->\""
+					<< (*succ)->getName() << "\"";
+			if (succ.getType() == etControl)
+				(*stream) << " [style=dashed]";
+			(*stream) << "\n";
+		}
+	}
+
+	(*stream) << "}\n\n";
+}
+
 void Graph::dfsVisit(GraphNode* u, GraphNode* u2,
 		std::set<GraphNode*> &visitedNodes) {
 
@@ -373,12 +802,12 @@ void Graph::dfsVisit(GraphNode* u, GraphNode* u2,
 	if (u->getId() == u2->getId())
 		return;
 
-	std::map<GraphNode*, edgeType> succs = u->getSuccessors();
+	GraphNode::edge_range succs = u->outEdges();
 
-	for (std::map<GraphNode*, edgeType>::iterator succ = succs.begin(), s_end =
-			succs.end(); succ != s_end; succ++) {
-		if (visitedNodes.count(succ->first) == 0) {
-			dfsVisit(succ->first, u2, visitedNodes);
+	for (GraphNode::edge_iterator succ = succs.begin(), s_end =
+			succs.end(); succ != s_end; ++succ) {
+		if (visitedNodes.count(*succ) == 0) {
+			dfsVisit(*succ, u2, visitedNodes);
 		}
 	}
 
@@ -392,12 +821,12 @@ void Graph::dfsVisitBack(GraphNode* u, GraphNode* u2,
 	if (u->getId() == u2->getId())
 		return;
 
-	std::map<GraphNode*, edgeType> preds = u->getPredecessors();
+	GraphNode::edge_range preds = u->inEdges();
 
-	for (std::map<GraphNode*, edgeType>::iterator pred = preds.begin(), s_end =
-			preds.end(); pred != s_end; pred++) {
-		if (visitedNodes.count(pred->first) == 0 && pred->first != u2) {
-			dfsVisitBack(pred->first, u2, visitedNodes);
+	for (GraphNode::edge_iterator pred = preds.begin(), s_end =
+			preds.end(); pred != s_end; ++pred) {
+		if (visitedNodes.count(*pred) == 0 && *pred != u2) {
+			dfsVisitBack(*pred, u2, visitedNodes);
 		}
 	}
 
@@ -428,122 +857,439 @@ void Graph::toDot(std::string s, const std::string fileName) {
 
 void Graph::toDot(std::string s, raw_ostream *stream) {
 
-	(*stream) << "digraph \"DFG for \'" << s << "\' function \"{\n";
-	(*stream) << "label=\"DFG for \'" << s << "\' function\";\n";
+	this->toDot(s, stream, DotFilter());
 
-	std::map<GraphNode*, int> DefinedNodes;
+}
 
-	for (std::set<GraphNode*>::iterator node = nodes.begin(), end = nodes.end(); node
-			!= end; node++) {
+void llvm::Graph::toDot(std::string s, raw_ostream *stream,
+		llvm::Graph::Guider* g) {
 
-		if (DefinedNodes.count(*node) == 0) {
-			(*stream) << (*node)->getName() << "[shape=" << (*node)->getShape()
-					<< ",style=" << (*node)->getStyle() << ",label=\""
-					<< (*node)->getLabel() << "\"]\n";
-			DefinedNodes[*node] = 1;
-		}
+	this->toDot(s, stream, DotFilter(), g);
 
-		std::map<GraphNode*, edgeType> succs = (*node)->getSuccessors();
+}
 
-		for (std::map<GraphNode*, edgeType>::iterator succ = succs.begin(),
-				s_end = succs.end(); succ != s_end; succ++) {
+//The function of a value, or NULL for constants and globals
+static Function* getValueFunction(Value* v) {
+	if (Instruction* I = dyn_cast_or_null<Instruction> (v))
+		return I->getParent()->getParent();
+	if (Argument* A = dyn_cast_or_null<Argument> (v))
+		return A->getParent();
+	return NULL;
+}
 
-			if (DefinedNodes.count(succ->first) == 0) {
-				(*stream) << (succ->first)->getName() << "[shape="
-						<< (succ->first)->getShape() << ",style="
-						<< (succ->first)->getStyle() << ",label=\""
-						<< (succ->first)->getLabel() << "\"]\n";
-				DefinedNodes[succ->first] = 1;
-			}
+//The function of a node, or NULL for memory, constants and globals
+static Function* getNodeFunction(GraphNode* node) {
+	if (OpNode* op = dyn_cast<OpNode> (node))
+		return getValueFunction(op->getValue());
+	if (VarNode* var = dyn_cast<VarNode> (node))
+		return getValueFunction(var->getValue());
+	return NULL;
+}
 
-			//Source
-			(*stream) << "\"" << (*node)->getName() << "\"";
+llvm::Graph::DotFilter::DotFilter() :
+	dataEdges(true), controlEdges(true) {
+}
 
-			(*stream) << "->";
+void llvm::Graph::DotFilter::addFunction(const Function* F) {
+	functions.insert(F);
+}
 
-			//Destination
-			(*stream) << "\"" << (succ->first)->getName() << "\"";
+void llvm::Graph::DotFilter::addNeighborhood(Value* v, unsigned hops) {
+	neighborhoods.push_back(std::make_pair(v, hops));
+}
 
-			if (succ->second == etControl)
-				(*stream) << " [style=dashed]";
+void llvm::Graph::DotFilter::addTaintSource(Value* v) {
+	taintSources.insert(v);
+}
 
-			(*stream) << "\n";
+void llvm::Graph::DotFilter::setEdgeTypes(bool data, bool control) {
+	dataEdges = data;
+	controlEdges = control;
+}
 
+void llvm::Graph::selectNeighborhoods(const DotFilter& filter,
+		std::vector<GraphNode*>& selected) {
+
+	std::set<GraphNode*> chosen;
+
+	for (unsigned i = 0; i < filter.neighborhoods.size(); ++i) {
+		Value* v = filter.neighborhoods[i].first;
+		unsigned hops = filter.neighborhoods[i].second;
+
+		//Breadth first search both ways, one hop at a time
+		std::vector<GraphNode*> frontier, next;
+		startVisit();
+		GraphNode* seeds[] = { findOpNode(v), findNode(v) };
+		for (unsigned j = 0; j < 2; ++j)
+			if (seeds[j] && !isVisited(seeds[j])) {
+				markVisited(seeds[j]);
+				frontier.push_back(seeds[j]);
+			}
+
+		for (unsigned hop = 0; !frontier.empty(); ++hop) {
+			for (unsigned j = 0; j < frontier.size(); ++j) {
+				GraphNode* node = frontier[j];
+				if (chosen.insert(node).second)
+					selected.push_back(node);
+				if (hop == hops)
+					continue;
+
+				GraphNode::edge_range edges[] = { node->outEdges(),
+						node->inEdges() };
+				for (unsigned k = 0; k < 2; ++k)
+					for (GraphNode::edge_iterator e = edges[k].begin(), e_end =
+							edges[k].end(); e != e_end; ++e)
+						if (!isVisited(*e)) {
+							markVisited(*e);
+							next.push_back(*e);
+						}
+			}
+			frontier.swap(next);
+			next.clear();
 		}
+	}
+}
 
+void llvm::Graph::toDot(std::string s, const std::string fileName,
+		const DotFilter& filter) {
+
+	std::string ErrorInfo;
+
+	raw_fd_ostream File(fileName.c_str(), ErrorInfo);
+
+	if (!ErrorInfo.empty()) {
+		errs() << "Error opening file " << fileName
+				<< " for writing! Error Info: " << ErrorInfo << " \n";
+		return;
 	}
 
-	(*stream) << "}\n\n";
+	this->toDot(s, &File, filter);
 
 }
 
 void llvm::Graph::toDot(std::string s, raw_ostream *stream,
-		llvm::Graph::Guider* g) {
-	(*stream) << "digraph \"DFG for \'" << s << "\' module \"{\n";
-	(*stream) << "label=\"DFG for \'" << s << "\' module\";\n";
+		const DotFilter& filter, llvm::Graph::Guider* g) {
+
+	std::string kind = g ? "module" : "function";
+	(*stream) << "digraph \"DFG for \'" << s << "\' " << kind << " \"{\n";
+	(*stream) << "label=\"DFG for \'" << s << "\' " << kind << "\";\n";
+
+	//The nodes the other restrictions choose from
+	std::vector<GraphNode*> candidates;
+	bool allNodes = filter.neighborhoods.empty() && filter.taintSources.empty();
+	if (!filter.neighborhoods.empty())
+		selectNeighborhoods(filter, candidates);
+
+	if (!filter.taintSources.empty()) {
+		std::set<GraphNode*> tainted = getDepValues(filter.taintSources);
+		std::set<GraphNode*> sources = findNodes(filter.taintSources);
+		tainted.insert(sources.begin(), sources.end());
+
+		if (filter.neighborhoods.empty())
+			candidates.assign(tainted.begin(), tainted.end());
+		else {
+			std::vector<GraphNode*> kept;
+			for (unsigned i = 0; i < candidates.size(); ++i)
+				if (tainted.count(candidates[i]))
+					kept.push_back(candidates[i]);
+			candidates.swap(kept);
+		}
+	} else if (allNodes) {
+		for (unsigned i = 0; i < nodeList.size(); ++i)
+			if (nodeList[i])
+				candidates.push_back(nodeList[i]);
+	}
 
-	// print every node
-	for (std::set<GraphNode*>::iterator node = nodes.begin(), end = nodes.end(); node
-			!= end; node++) {
-		(*stream) << (*node)->getName() << g->getNodeAttrs(*node) << "\n";
+	//The nodes written are the visited ones
+	std::vector<GraphNode*> selected;
+	startVisit();
+	for (unsigned i = 0; i < candidates.size(); ++i) {
+		GraphNode* node = candidates[i];
+		if (filter.functions.empty() || filter.functions.count(
+				getNodeFunction(node))) {
+			markVisited(node);
+			selected.push_back(node);
+		}
+	}
+
+	//Nodes of no function go along with the nodes next to them
+	if (!filter.functions.empty()) {
+		std::set<GraphNode*> candidateSet;
+		if (!allNodes)
+			candidateSet.insert(candidates.begin(), candidates.end());
+
+		for (unsigned i = 0, n = selected.size(); i < n; ++i) {
+			GraphNode::edge_range edges[] = { selected[i]->outEdges(),
+					selected[i]->inEdges() };
+			for (unsigned k = 0; k < 2; ++k)
+				for (GraphNode::edge_iterator e = edges[k].begin(), e_end =
+						edges[k].end(); e != e_end; ++e)
+					if (!isVisited(*e) && !getNodeFunction(*e) && (allNodes
+							|| candidateSet.count(*e))) {
+						markVisited(*e);
+						selected.push_back(*e);
+					}
+		}
+	}
 
+	// print every node
+	for (unsigned i = 0; i < selected.size(); ++i) {
+		GraphNode* node = selected[i];
+		if (g)
+			(*stream) << node->getName() << g->getNodeAttrs(node) << "\n";
+		else
+			(*stream) << node->getName() << "[shape=" << node->getShape()
+					<< ",style=" << node->getStyle() << ",label=\""
+					<< node->getLabel() << "\"]\n";
 	}
+
 	// print edges
-	for (std::set<GraphNode*>::iterator node = nodes.begin(), end = nodes.end(); node
-			!= end; node++) {
-		std::map<GraphNode*, edgeType> succs = (*node)->getSuccessors();
-		for (std::map<GraphNode*, edgeType>::iterator succ = succs.begin(),
-				s_end = succs.end(); succ != s_end; succ++) {
+	for (unsigned i = 0; i < selected.size(); ++i) {
+		GraphNode* node = selected[i];
+		GraphNode::edge_range succs = node->outEdges();
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+			if (!isVisited(*succ) || !(succ.getType() == etControl ? filter.controlEdges
+					: filter.dataEdges))
+				continue;
+
 			//Source
-			(*stream) << "\"" << (*node)->getName() << "\"";
+			(*stream) << "\"" << node->getName() << "\"";
 			(*stream) << "->";
 			//Destination
-			(*stream) << "\"" << (succ->first)->getName() << "\"";
-			(*stream) << g->getEdgeAttrs(*node, succ->first);
+			(*stream) << "\"" << (*succ)->getName() << "\"";
+
+			if (g)
+				(*stream) << g->getEdgeAttrs(node, *succ);
+			else if (succ.getType() == etControl)
+				(*stream) << " [style=dashed]";
+
 			(*stream) << "\n";
 		}
 	}
+
 	(*stream) << "}\n\n";
 }
 
-GraphNode* Graph::addInst(Value *v) {
+/*
+ * Binary export
+ */
 
-	GraphNode *Op, *Var, *Operand;
+namespace {
 
-	CallInst* CI = dyn_cast<CallInst> (v);
-	bool hasVarNode = true;
+//String table of a binary graph file; equal strings are stored once
+class FileStrings {
+public:
+	FileStrings() :
+		size(1) {
+		offsets[""] = 0;
+		order.push_back(offsets.begin());
+	}
 
-	if (isValidInst(v)) { //If is a data manipulator instruction
-		Var = this->findNode(v);
+	uint32_t add(const std::string& s) {
+		std::pair<std::map<std::string, uint32_t>::iterator, bool> it =
+				offsets.insert(std::make_pair(s, size));
+		if (it.second) {
+			order.push_back(it.first);
+			size += s.size() + 1;
+		}
+		return it.first->second;
+	}
 
-		/*
-		 * If Var is NULL, the value hasn't been processed yet, so we must process it
-		 *
-		 * However, if Var is a Pointer, maybe the memory node already exists but the
-		 * operation node aren't in the graph, yet. Thus we must process it.
-		 */
-		if (Var == NULL || (Var != NULL && findOpNode(v) == NULL)) { //If it has not processed yet
+	uint32_t getSize() const {
+		return size;
+	}
 
-			//If Var isn't NULL, we won't create another node for it
-			if (Var == NULL) {
+	void write(raw_ostream *stream) const {
+		for (unsigned i = 0; i < order.size(); ++i)
+			stream->write(order[i]->first.c_str(), order[i]->first.size() + 1);
+	}
 
-				if (CI) {
-					hasVarNode = !CI->getType()->isVoidTy();
-				}
+private:
+	std::map<std::string, uint32_t> offsets;
+	std::vector<std::map<std::string, uint32_t>::iterator> order;
+	uint32_t size;
+};
 
-				if (hasVarNode) {
-					if (StoreInst* SI = dyn_cast<StoreInst>(v))
-						Var = addInst(SI->getOperand(1)); // We do this here because we want to represent the store instructions as a flow of information of a data to a memory node
-					else if ((!isa<Constant> (v)) && isMemoryPointer(v)) {
-						Var = new MemNode(
-								USE_ALIAS_SETS ? AS->getValueSetKey(v) : 0, AS);
-						memNodes[USE_ALIAS_SETS ? AS->getValueSetKey(v) : 0]
-								= Var;
-					} else {
-						Var = new VarNode(v);
-						varNodes[v] = Var;
-					}
-					nodes.insert(Var);
+}
+
+static uint64_t fileAlign(uint64_t offset) {
+	return (offset + 7) & ~(uint64_t) 7;
+}
+
+static void writePadding(raw_ostream *stream, uint64_t offset) {
+	static const char zeros[8] = { 0 };
+	stream->write(zeros, fileAlign(offset) - offset);
+}
+
+//The function and the debug location of the value of a node, if any
+static void getSourceLocation(Value* v, DepGraphFileNode& record,
+		FileStrings& strings) {
+	if (Instruction* I = dyn_cast_or_null<Instruction> (v))
+		if (MDNode *mdn = I->getMetadata("dbg")) {
+			DILocation Loc(mdn);
+			record.file = strings.add(Loc.getFilename().str());
+			record.line = Loc.getLineNumber();
+		}
+
+	if (Function* F = getValueFunction(v))
+		record.function = strings.add(F->getName().str());
+}
+
+void Graph::toBinary(std::string s, const std::string fileName) {
+
+	std::string ErrorInfo;
+
+	raw_fd_ostream File(fileName.c_str(), ErrorInfo);
+
+	if (!ErrorInfo.empty()) {
+		errs() << "Error opening file " << fileName
+				<< " for writing! Error Info: " << ErrorInfo << " \n";
+		return;
+	}
+
+	this->toBinary(s, &File);
+
+}
+
+void Graph::toBinary(std::string s, raw_ostream *stream) {
+
+	FileStrings strings;
+	DepGraphFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DEPGRAPH_FILE_MAGIC, 8);
+	header.version = DEPGRAPH_FILE_VERSION;
+	header.module = strings.add(s);
+
+	//Number the nodes densely, skipping the holes left by removed nodes
+	std::vector<GraphNode*> fileNodes;
+	std::vector<unsigned> fileIndex(nodeList.size(), 0);
+	for (unsigned i = 0; i < nodeList.size(); ++i)
+		if (nodeList[i]) {
+			fileIndex[i] = fileNodes.size();
+			fileNodes.push_back(nodeList[i]);
+		}
+
+	std::vector<DepGraphFileNode> records(fileNodes.size());
+	uint64_t numEdges = 0;
+	for (unsigned i = 0; i < fileNodes.size(); ++i) {
+		GraphNode* node = fileNodes[i];
+		DepGraphFileNode& record = records[i];
+		memset(&record, 0, sizeof(record));
+		record.kind = node->getClass_Id();
+		record.id = node->getId();
+		record.label = strings.add(node->getLabel());
+
+		if (OpNode* op = dyn_cast<OpNode> (node)) {
+			record.aux = op->getOpCode();
+			getSourceLocation(op->getValue(), record, strings);
+		} else if (VarNode* var = dyn_cast<VarNode> (node)) {
+			if (isa<Constant> (var->getValue()))
+				record.flags |= DGF_Constant;
+			getSourceLocation(var->getValue(), record, strings);
+		} else if (MemNode* mem = dyn_cast<MemNode> (node))
+			record.aux = mem->getAliasSetId();
+
+		GraphNode::edge_range succs = node->outEdges();
+		for (GraphNode::edge_iterator succ = succs.begin(), s_end =
+				succs.end(); succ != s_end; ++succ)
+			if (hasNode(*succ))
+				numEdges++;
+	}
+
+	header.numNodes = fileNodes.size();
+	header.numEdges = numEdges;
+	header.stringsSize = strings.getSize();
+
+	uint64_t offsetsSize = (uint64_t) (fileNodes.size() + 1) * 4;
+	header.nodesOffset = fileAlign(sizeof(header));
+	header.succOffsetsOffset = fileAlign(header.nodesOffset
+			+ records.size() * sizeof(DepGraphFileNode));
+	header.succEdgesOffset = fileAlign(header.succOffsetsOffset + offsetsSize);
+	header.predOffsetsOffset = fileAlign(header.succEdgesOffset + numEdges * 4);
+	header.predEdgesOffset = fileAlign(header.predOffsetsOffset + offsetsSize);
+	header.stringsOffset = fileAlign(header.predEdgesOffset + numEdges * 4);
+
+	stream->write((const char*) &header, sizeof(header));
+	writePadding(stream, sizeof(header));
+	stream->write((const char*) &records[0], records.size()
+			* sizeof(DepGraphFileNode));
+	writePadding(stream, records.size() * sizeof(DepGraphFileNode));
+
+	//Successors first, then predecessors: the offsets of each direction,
+	//then its edges, one node at a time
+	std::vector<uint32_t> row;
+	for (int forward = 1; forward >= 0; --forward) {
+		uint32_t offset = 0;
+		stream->write((const char*) &offset, 4);
+		for (unsigned i = 0; i < fileNodes.size(); ++i) {
+			GraphNode::edge_range edges = forward ? fileNodes[i]->outEdges()
+					: fileNodes[i]->inEdges();
+			for (GraphNode::edge_iterator e = edges.begin(), e_end =
+					edges.end(); e != e_end; ++e)
+				if (hasNode(*e))
+					offset++;
+			stream->write((const char*) &offset, 4);
+		}
+		writePadding(stream, offsetsSize);
+
+		for (unsigned i = 0; i < fileNodes.size(); ++i) {
+			GraphNode::edge_range edges = forward ? fileNodes[i]->outEdges()
+					: fileNodes[i]->inEdges();
+			row.clear();
+			for (GraphNode::edge_iterator e = edges.begin(), e_end =
+					edges.end(); e != e_end; ++e)
+				if (hasNode(*e))
+					row.push_back(fileIndex[(*e)->index] << 1 | (e.getType()
+							== etControl ? DGF_ControlEdge : DGF_DataEdge));
+			std::sort(row.begin(), row.end());
+			if (!row.empty())
+				stream->write((const char*) &row[0], row.size() * 4);
+		}
+		writePadding(stream, numEdges * 4);
+	}
+
+	strings.write(stream);
+	stream->flush();
+}
+
+GraphNode* Graph::addInst(Value *v) {
+
+	GraphNode *Op, *Var, *Operand;
+
+	CallInst* CI = dyn_cast<CallInst> (v);
+	bool hasVarNode = true;
+
+	if (isValidInst(v)) { //If is a data manipulator instruction
+		Var = this->findNode(v);
+
+		/*
+		 * If Var is NULL, the value hasn't been processed yet, so we must process it
+		 *
+		 * However, if Var is a Pointer, maybe the memory node already exists but the
+		 * operation node aren't in the graph, yet. Thus we must process it.
+		 */
+		if (Var == NULL || (Var != NULL && !opNodes.count(v))) { //If it has not processed yet
+
+			//If Var isn't NULL, we won't create another node for it
+			if (Var == NULL) {
+
+				if (CI) {
+					hasVarNode = !CI->getType()->isVoidTy();
+				}
+
+				if (hasVarNode) {
+					if (StoreInst* SI = dyn_cast<StoreInst>(v))
+						Var = addInst(SI->getOperand(1)); // We do this here because we want to represent the store instructions as a flow of information of a data to a memory node
+					else if ((!isa<Constant> (v)) && isMemoryPointer(v)) {
+						int key = getMemoryKey(v);
+						Var = new (arena) MemNode(key, AS);
+						memNodes[key] = Var;
+					} else {
+						Var = new (arena) VarNode(v);
+						varNodes[v] = Var;
+					}
+					insertNode(Var);
 				}
 
 			}
@@ -551,14 +1297,14 @@ GraphNode* Graph::addInst(Value *v) {
 			if (isa<Instruction> (v)) {
 
 				if (CI) {
-					Op = new CallNode(CI);
+					Op = new (arena) CallNode(CI);
 					callNodes[CI] = Op;
 				} else {
-					Op = new OpNode(dyn_cast<Instruction> (v)->getOpcode(), v);
+					Op = new (arena) OpNode(dyn_cast<Instruction> (v)->getOpcode(), v);
 				}
 				opNodes[v] = Op;
 
-				nodes.insert(Op);
+				insertNode(Op);
 				if (hasVarNode)
 					Op->connect(Var);
 
@@ -584,12 +1330,41 @@ GraphNode* Graph::addInst(Value *v) {
 
 void Graph::addEdge(GraphNode* src, GraphNode* dst, edgeType type) {
 
-	nodes.insert(src);
-	nodes.insert(dst);
+	insertNode(src);
+	insertNode(dst);
 	src->connect(dst, type);
 
 }
 
+void Graph::addEdges(const std::vector<std::pair<GraphNode*, GraphNode*> >& edges,
+		edgeType type) {
+
+	bool batch = compacted;
+	for (unsigned i = 0; batch && i < edges.size(); ++i)
+		batch = edges[i].first->compactGraph == this
+				&& edges[i].second->compactGraph == this;
+
+	if (!batch) {
+		for (unsigned i = 0; i < edges.size(); ++i)
+			addEdge(edges[i].first, edges[i].second, type);
+		return;
+	}
+
+	std::vector<std::pair<unsigned, unsigned> > succAdded, predAdded;
+	succAdded.reserve(edges.size());
+	predAdded.reserve(edges.size());
+	for (unsigned i = 0; i < edges.size(); ++i) {
+		succAdded.push_back(std::make_pair(edges[i].first->index,
+				packEdge(edges[i].second->index, type)));
+		predAdded.push_back(std::make_pair(edges[i].second->index,
+				packEdge(edges[i].first->index, type)));
+	}
+
+	NrEdges += mergeCompactEdges(succAdded, succOffsets, succEdges);
+	mergeCompactEdges(predAdded, predOffsets, predEdges);
+	reachIndexValid = false;
+}
+
 //It verify if the instruction is valid for the dependence graph, i.e. just data manipulator instructions are important for dependence graph
 bool Graph::isValidInst(Value *v) {
 
@@ -613,6 +1388,17 @@ bool Graph::isValidInst(Value *v) {
 
 }
 
+int llvm::Graph::getMemoryKey(llvm::Value* v) {
+	if (!USE_ALIAS_SETS)
+		return 0;
+	if (splitKeys) {
+		llvm::DenseMap<Value*, int>::const_iterator it = splitKeys->find(v);
+		if (it != splitKeys->end())
+			return it->second;
+	}
+	return AS->getValueSetKey(v);
+}
+
 bool llvm::Graph::isMemoryPointer(llvm::Value* v) {
 	if (v && v->getType())
 		return v->getType()->isPointerTy();
@@ -624,7 +1410,7 @@ bool llvm::Graph::isMemoryPointer(llvm::Value* v) {
 GraphNode* Graph::findNode(Value *op) {
 
 	if ((!isa<Constant> (op)) && isMemoryPointer(op)) {
-		int index = USE_ALIAS_SETS ? AS->getValueSetKey(op) : 0;
+		int index = getMemoryKey(op);
 		if (memNodes.count(index))
 			return memNodes[index];
 	} else {
@@ -654,7 +1440,7 @@ std::set<GraphNode*> Graph::findNodes(std::set<Value*> values) {
 OpNode* llvm::Graph::findOpNode(llvm::Value* op) {
 
 	if (opNodes.count(op))
-		return dyn_cast<OpNode> (opNodes[op]);
+		return dyn_cast_or_null<OpNode> (opNodes[op]);
 	return NULL;
 }
 
@@ -662,6 +1448,575 @@ std::set<GraphNode*> llvm::Graph::getNodes() {
 	return nodes;
 }
 
+void llvm::Graph::insertNode(GraphNode* node) {
+	if (nodes.insert(node).second) {
+		node->index = nodeList.size();
+		if (node->ID < 0)
+			node->ID = node->index;
+		nodeList.push_back(node);
+		reachIndexValid = false;
+	}
+}
+
+void llvm::Graph::startVisit() {
+	visitMarks.resize(nodeList.size(), 0);
+
+	//Only clear the marks when the epoch wraps around
+	if (++visitEpoch == 0) {
+		std::fill(visitMarks.begin(), visitMarks.end(), 0);
+		visitEpoch = 1;
+	}
+}
+
+//Pack the edges of a node in edges, sorted by the index of the neighbor.
+//Returns false if a neighbor isn't a node of this graph.
+bool llvm::Graph::packEdges(const std::map<GraphNode*, edgeType>& neighbors,
+		std::vector<unsigned>& edges) {
+	unsigned first = edges.size();
+	for (std::map<GraphNode*, edgeType>::const_iterator it = neighbors.begin(), e =
+			neighbors.end(); it != e; ++it) {
+		if (it->first->compactGraph != this)
+			return false;
+		edges.push_back(packEdge(it->first->index, it->second));
+	}
+	std::sort(edges.begin() + first, edges.end());
+	return true;
+}
+
+//Orders added edges by node, then by neighbor, whatever their type
+static bool compareAddedEdges(const std::pair<unsigned, unsigned>& a,
+		const std::pair<unsigned, unsigned>& b) {
+	return a.first < b.first || (a.first == b.first && (a.second >> 1)
+			< (b.second >> 1));
+}
+
+//Merge the added (node index, packed edge) pairs into the rows of a compact
+//edge array. As in connect(), the last edge to a neighbor replaces the one
+//already there. Returns the number of new edges.
+unsigned llvm::Graph::mergeCompactEdges(
+		std::vector<std::pair<unsigned, unsigned> >& added,
+		std::vector<unsigned>& offsets, std::vector<unsigned>& edges) {
+
+	std::stable_sort(added.begin(), added.end(), compareAddedEdges);
+
+	std::vector<unsigned> newOffsets(1, 0);
+	std::vector<unsigned> newEdges;
+	newEdges.reserve(edges.size() + added.size());
+
+	unsigned numNew = 0;
+	std::vector<std::pair<unsigned, unsigned> >::iterator a = added.begin(),
+			ae = added.end();
+	for (unsigned row = 0; row + 1 < offsets.size(); ++row) {
+		unsigned j = offsets[row], je = offsets[row + 1];
+		while (a != ae && a->first == row) {
+			unsigned index = edgeIndex(a->second);
+			std::vector<std::pair<unsigned, unsigned> >::iterator last = a;
+			while (last + 1 != ae && (last + 1)->first == row
+					&& edgeIndex((last + 1)->second) == index)
+				++last;
+
+			for (; j != je && edgeIndex(edges[j]) < index; ++j)
+				newEdges.push_back(edges[j]);
+			if (j != je && edgeIndex(edges[j]) == index)
+				++j;
+			else
+				++numNew;
+			newEdges.push_back(last->second);
+			a = last + 1;
+		}
+		for (; j != je; ++j)
+			newEdges.push_back(edges[j]);
+		newOffsets.push_back(newEdges.size());
+	}
+
+	offsets.swap(newOffsets);
+	edges.swap(newEdges);
+	return numNew;
+}
+
+void llvm::Graph::compact() {
+
+	if (compacted)
+		expand();
+
+	for (unsigned i = 0; i < nodeList.size(); ++i)
+		if (nodeList[i])
+			nodeList[i]->compactGraph = this;
+
+	succOffsets.assign(1, 0);
+	predOffsets.assign(1, 0);
+	unsigned numEdges = 0;
+	for (unsigned i = 0; i < nodeList.size(); ++i)
+		if (nodeList[i])
+			numEdges += nodeList[i]->successors.size();
+	succEdges.reserve(numEdges);
+	predEdges.reserve(numEdges);
+
+	bool ok = true;
+	for (unsigned i = 0; ok && i < nodeList.size(); ++i) {
+		if (nodeList[i])
+			ok = packEdges(nodeList[i]->successors, succEdges)
+					&& packEdges(nodeList[i]->predecessors, predEdges);
+		succOffsets.push_back(succEdges.size());
+		predOffsets.push_back(predEdges.size());
+	}
+
+	//Some edge leaves the graph; keep the maps
+	if (!ok) {
+		for (unsigned i = 0; i < nodeList.size(); ++i)
+			if (nodeList[i])
+				nodeList[i]->compactGraph = NULL;
+		succOffsets.clear();
+		predOffsets.clear();
+		succEdges.clear();
+		predEdges.clear();
+		return;
+	}
+
+	for (unsigned i = 0; i < nodeList.size(); ++i) {
+		if (nodeList[i]) {
+			nodeList[i]->successors.clear();
+			nodeList[i]->predecessors.clear();
+		}
+	}
+	compacted = true;
+}
+
+void llvm::Graph::expand() {
+
+	if (!compacted)
+		return;
+
+	for (unsigned i = 0; i < nodeList.size(); ++i) {
+		GraphNode* node = nodeList[i];
+		if (!node)
+			continue;
+		for (unsigned j = succOffsets[i]; j != succOffsets[i + 1]; ++j)
+			node->successors[nodeList[edgeIndex(succEdges[j])]]
+					= edgeKind(succEdges[j]);
+		for (unsigned j = predOffsets[i]; j != predOffsets[i + 1]; ++j)
+			node->predecessors[nodeList[edgeIndex(predEdges[j])]]
+					= edgeKind(predEdges[j]);
+		node->compactGraph = NULL;
+	}
+
+	std::vector<unsigned>().swap(succOffsets);
+	std::vector<unsigned>().swap(predOffsets);
+	std::vector<unsigned>().swap(succEdges);
+	std::vector<unsigned>().swap(predEdges);
+	compacted = false;
+	reachIndexValid = false;
+}
+
+bool llvm::Graph::isCompact() const {
+	return compacted;
+}
+
+void llvm::Graph::merge(Graph& other) {
+
+	expand();
+	other.expand();
+
+	//Nodes of other that this graph already has
+	DenseMap<GraphNode*, GraphNode*> existing;
+	for (DenseMap<Value*, GraphNode*>::iterator it = other.varNodes.begin(), e =
+			other.varNodes.end(); it != e; ++it)
+		if (varNodes.count(it->first))
+			existing[it->second] = varNodes[it->first];
+	for (DenseMap<int, GraphNode*>::iterator it = other.memNodes.begin(), e =
+			other.memNodes.end(); it != e; ++it)
+		if (memNodes.count(it->first))
+			existing[it->second] = memNodes[it->first];
+
+	std::vector<GraphNode*> duplicates;
+	for (unsigned i = 0; i < other.nodeList.size(); ++i) {
+		GraphNode* node = other.nodeList[i];
+		if (!node)
+			continue;
+		if (existing.count(node)) {
+			duplicates.push_back(node);
+			continue;
+		}
+		node->ID = -1;
+		insertNode(node);
+	}
+
+	for (DenseMap<Value*, GraphNode*>::iterator it = other.varNodes.begin(), e =
+			other.varNodes.end(); it != e; ++it)
+		if (!existing.count(it->second))
+			varNodes[it->first] = it->second;
+	for (DenseMap<int, GraphNode*>::iterator it = other.memNodes.begin(), e =
+			other.memNodes.end(); it != e; ++it)
+		if (!existing.count(it->second))
+			memNodes[it->first] = it->second;
+	for (DenseMap<Value*, GraphNode*>::iterator it = other.opNodes.begin(), e =
+			other.opNodes.end(); it != e; ++it)
+		opNodes[it->first] = it->second;
+	for (DenseMap<Value*, GraphNode*>::iterator it = other.callNodes.begin(), e =
+			other.callNodes.end(); it != e; ++it)
+		callNodes[it->first] = it->second;
+
+	//Move the edges of the duplicates to the nodes they stand for
+	for (unsigned i = 0; i < duplicates.size(); ++i) {
+		GraphNode* node = duplicates[i];
+		GraphNode* target = existing[node];
+
+		for (std::map<GraphNode*, edgeType>::iterator pred =
+				node->predecessors.begin(), end = node->predecessors.end(); pred
+				!= end; ++pred) {
+			GraphNode* src = existing.count(pred->first) ? existing[pred->first]
+					: pred->first;
+			src->connect(target, pred->second);
+		}
+
+		for (std::map<GraphNode*, edgeType>::iterator succ =
+				node->successors.begin(), end = node->successors.end(); succ
+				!= end; ++succ) {
+			GraphNode* dst = existing.count(succ->first) ? existing[succ->first]
+					: succ->first;
+			target->connect(dst, succ->second);
+		}
+	}
+
+	for (unsigned i = 0; i < duplicates.size(); ++i)
+		delete duplicates[i];
+
+	arena.splice(other.arena);
+
+	other.opNodes.clear();
+	other.callNodes.clear();
+	other.varNodes.clear();
+	other.memNodes.clear();
+	other.nodes.clear();
+	other.nodeList.clear();
+	other.visitMarks.clear();
+	other.reachIndexValid = false;
+}
+
+void llvm::Graph::setReachabilityIndex(bool enable) {
+	reachIndexEnabled = enable;
+}
+
+bool llvm::Graph::isReachable(llvm::Value* src, llvm::Value* dst) {
+	GraphNode* srcNode = findNode(src);
+	GraphNode* dstNode = findNode(dst);
+	return srcNode && dstNode && isReachable(srcNode, dstNode);
+}
+
+bool llvm::Graph::isReachable(GraphNode* src, GraphNode* dst) {
+
+	NrReachQueries++;
+
+	if (src == dst)
+		return true;
+
+	if (!(reachIndexEnabled || useReachabilityIndex)
+			|| !(reachIndexValid || buildReachabilityIndex())) {
+		NrReachSearches++;
+		return searchNodes(src, dst);
+	}
+
+	unsigned from = nodeComponent[src->index];
+	unsigned to = nodeComponent[dst->index];
+
+	if (from == to)
+		return true;
+	if (!mayReach(from, to))
+		return false;
+
+	//Descendant in the spanning forest of the first search
+	if (treePre[from] <= treePre[to] && labelPost[to * ReachLabels]
+			<= labelPost[from * ReachLabels])
+		return true;
+
+	NrReachSearches++;
+	return searchComponents(from, to);
+}
+
+//Breadth first search from src, for graphs without the index
+bool llvm::Graph::searchNodes(GraphNode* src, GraphNode* dst) {
+
+	std::vector<GraphNode*> workList;
+
+	startVisit();
+	markVisited(src);
+	workList.push_back(src);
+
+	for (size_t head = 0; head < workList.size(); ++head) {
+
+		GraphNode::edge_range succs = workList[head]->outEdges();
+
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+
+			if (*succ == dst)
+				return true;
+
+			if (!isVisited(*succ)) {
+				markVisited(*succ);
+				workList.push_back(*succ);
+			}
+
+		}
+
+	}
+
+	return false;
+}
+
+//False if no path from component from to component to can exist
+bool llvm::Graph::mayReach(unsigned from, unsigned to) const {
+
+	//Edges of the condensation go from higher to lower numbers
+	if (from < to)
+		return false;
+
+	for (unsigned label = 0; label < ReachLabels; ++label) {
+		unsigned f = from * ReachLabels + label, t = to * ReachLabels + label;
+		if (labelLow[t] < labelLow[f] || labelPost[f] < labelPost[t])
+			return false;
+	}
+
+	return true;
+}
+
+//Depth first search on the condensation, skipping the components whose
+//intervals show that they can't reach to
+bool llvm::Graph::searchComponents(unsigned from, unsigned to) {
+
+	if (++componentEpoch == 0) {
+		std::fill(componentMarks.begin(), componentMarks.end(), 0);
+		componentEpoch = 1;
+	}
+
+	std::vector<unsigned> stack(1, from);
+	componentMarks[from] = componentEpoch;
+
+	while (!stack.empty()) {
+
+		unsigned c = stack.back();
+		stack.pop_back();
+
+		for (unsigned e = dagOffsets[c]; e != dagOffsets[c + 1]; ++e) {
+
+			unsigned next = dagEdges[e];
+
+			if (next == to)
+				return true;
+
+			if (componentMarks[next] != componentEpoch && mayReach(next, to)) {
+				componentMarks[next] = componentEpoch;
+				stack.push_back(next);
+			}
+
+		}
+
+	}
+
+	return false;
+}
+
+bool llvm::Graph::buildReachabilityIndex() {
+
+	struct timeval start, end;
+	gettimeofday(&start, 0);
+
+	//The index uses the compact edges, and is invalidated with them
+	compact();
+	if (!compacted)
+		return false;
+
+	findComponents();
+
+	unsigned numComponents = dagOffsets.size() - 1;
+	labelLow.assign(numComponents * ReachLabels, 0);
+	labelPost.assign(numComponents * ReachLabels, 0);
+	treePre.assign(numComponents, 0);
+	componentMarks.assign(numComponents, 0);
+	componentEpoch = 0;
+
+	for (unsigned label = 0; label < ReachLabels; ++label)
+		labelComponents(label);
+
+	reachIndexValid = true;
+
+	gettimeofday(&end, 0);
+	NrReachIndexBuilds++;
+	ReachIndexBuildTime += (end.tv_sec - start.tv_sec) * 1000000
+			+ (end.tv_usec - start.tv_usec);
+	ReachIndexBytes = sizeof(unsigned) * (nodeComponent.capacity()
+			+ dagOffsets.capacity() + dagEdges.capacity()
+			+ labelLow.capacity() + labelPost.capacity() + treePre.capacity()
+			+ componentMarks.capacity());
+
+	return true;
+}
+
+//Tarjan's algorithm on the compact edges, without recursion. Fills
+//nodeComponent and the edges between components (dagOffsets, dagEdges).
+void llvm::Graph::findComponents() {
+
+	const unsigned none = ~0U;
+	unsigned n = nodeList.size();
+	std::vector<unsigned> order(n, none), lowLink(n, 0), nextEdge(n, 0);
+	std::vector<unsigned> stack, callStack;
+	unsigned counter = 0, numComponents = 0;
+
+	nodeComponent.assign(n, none);
+
+	for (unsigned root = 0; root < n; ++root) {
+
+		if (!nodeList[root] || order[root] != none)
+			continue;
+
+		callStack.push_back(root);
+		order[root] = lowLink[root] = counter++;
+		nextEdge[root] = succOffsets[root];
+		stack.push_back(root);
+
+		while (!callStack.empty()) {
+
+			unsigned u = callStack.back();
+
+			if (nextEdge[u] != succOffsets[u + 1]) {
+				unsigned v = edgeIndex(succEdges[nextEdge[u]++]);
+				if (order[v] == none) {
+					order[v] = lowLink[v] = counter++;
+					nextEdge[v] = succOffsets[v];
+					stack.push_back(v);
+					callStack.push_back(v);
+				} else if (nodeComponent[v] == none)
+					lowLink[u] = std::min(lowLink[u], order[v]);
+				continue;
+			}
+
+			callStack.pop_back();
+			if (!callStack.empty())
+				lowLink[callStack.back()] = std::min(lowLink[callStack.back()],
+						lowLink[u]);
+
+			if (lowLink[u] == order[u]) {
+				unsigned v;
+				do {
+					v = stack.back();
+					stack.pop_back();
+					nodeComponent[v] = numComponents;
+				} while (v != u);
+				numComponents++;
+			}
+
+		}
+
+	}
+
+	//Edges between components, without duplicates
+	std::vector<std::pair<unsigned, unsigned> > edges;
+	for (unsigned u = 0; u < n; ++u) {
+		if (!nodeList[u])
+			continue;
+		for (unsigned e = succOffsets[u]; e != succOffsets[u + 1]; ++e) {
+			unsigned v = edgeIndex(succEdges[e]);
+			if (nodeComponent[u] != nodeComponent[v])
+				edges.push_back(std::make_pair(nodeComponent[u],
+						nodeComponent[v]));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+	dagOffsets.assign(numComponents + 1, 0);
+	dagEdges.resize(edges.size());
+	for (unsigned e = 0; e < edges.size(); ++e) {
+		dagOffsets[edges[e].first + 1]++;
+		dagEdges[e] = edges[e].second;
+	}
+	for (unsigned c = 0; c < numComponents; ++c)
+		dagOffsets[c + 1] += dagOffsets[c];
+}
+
+//Interval labels of one depth first search of the condensation. Even
+//labels visit children in order, odd ones in reverse order.
+void llvm::Graph::labelComponents(unsigned label) {
+
+	unsigned numComponents = dagOffsets.size() - 1;
+	std::vector<bool> visited(numComponents, false);
+	std::vector<std::pair<unsigned, unsigned> > callStack; // component, next child
+	unsigned post = 0, pre = 0;
+	bool reverse = label % 2;
+
+	//Sources of the condensation have the highest numbers, so start there
+	for (unsigned r = numComponents; r-- > 0;) {
+
+		if (visited[r])
+			continue;
+
+		visited[r] = true;
+		if (label == 0)
+			treePre[r] = pre++;
+		callStack.push_back(std::make_pair(r, 0));
+
+		while (!callStack.empty()) {
+
+			unsigned c = callStack.back().first;
+			unsigned i = callStack.back().second;
+			unsigned degree = dagOffsets[c + 1] - dagOffsets[c];
+
+			if (i < degree) {
+				callStack.back().second++;
+				unsigned child = dagEdges[dagOffsets[c] + (reverse ? degree - 1
+						- i : i)];
+				if (!visited[child]) {
+					visited[child] = true;
+					if (label == 0)
+						treePre[child] = pre++;
+					callStack.push_back(std::make_pair(child, 0));
+				}
+				continue;
+			}
+
+			callStack.pop_back();
+			labelPost[c * ReachLabels + label] = post++;
+
+		}
+
+	}
+
+	//Children have lower numbers, so their low is final before their parents'
+	for (unsigned c = 0; c < numComponents; ++c) {
+		unsigned low = labelPost[c * ReachLabels + label];
+		for (unsigned e = dagOffsets[c]; e != dagOffsets[c + 1]; ++e)
+			low = std::min(low, labelLow[dagEdges[e] * ReachLabels + label]);
+		labelLow[c * ReachLabels + label] = low;
+	}
+}
+
+void llvm::Graph::removeNode(GraphNode* node) {
+
+	if (!nodes.erase(node))
+		return;
+
+	if (OpNode* op = dyn_cast<OpNode> (node)) {
+		if (Value* v = op->getValue()) {
+			if (opNodes.count(v) && opNodes[v] == node)
+				opNodes.erase(v);
+			if (callNodes.count(v) && callNodes[v] == node)
+				callNodes.erase(v);
+		}
+	} else if (VarNode* var = dyn_cast<VarNode> (node)) {
+		if (varNodes.count(var->getValue()) && varNodes[var->getValue()] == node)
+			varNodes.erase(var->getValue());
+	} else if (MemNode* mem = dyn_cast<MemNode> (node)) {
+		if (memNodes.count(mem->getAliasSetId()) && memNodes[mem->getAliasSetId()]
+				== node)
+			memNodes.erase(mem->getAliasSetId());
+	}
+
+	unsigned index = node->index;
+	delete node;
+	nodeList[index] = NULL;
+	reachIndexValid = false;
+}
+
 void llvm::Graph::deleteCallNodes(Function* F) {
 
 	for (Value::use_iterator UI = F->use_begin(), E = F->use_end(); UI != E; ++UI) {
@@ -681,11 +2036,12 @@ void llvm::Graph::deleteCallNodes(Function* F) {
 		Instruction *caller = cast<Instruction> (U);
 
 		if (callNodes.count(caller)) {
-			if (GraphNode* node = callNodes[caller]) {
-				nodes.erase(node);
-				delete node;
-			}
+			if (GraphNode* node = callNodes[caller])
+				removeNode(node);
 			callNodes.erase(caller);
+
+			//The call stays processed, so addInst doesn't build it again
+			opNodes[caller] = NULL;
 		}
 
 	}
@@ -703,18 +2059,9 @@ std::pair<GraphNode*, int> llvm::Graph::getNearestDependency(llvm::Value* sink,
 
 		std::set<GraphNode*> sourceNodes = findNodes(sources);
 
-		std::map<GraphNode*, int> nodeColor;
-
 		std::list<std::pair<GraphNode*, int> > workList;
 
-		for (std::set<GraphNode*>::iterator Nit = nodes.begin(), Nend =
-				nodes.end(); Nit != Nend; Nit++) {
-
-			if (skipMemoryNodes && isa<MemNode> (*Nit))
-				nodeColor[*Nit] = 1;
-			else
-				nodeColor[*Nit] = 0;
-		}
+		startVisit();
 
 		workList.push_back(pair<GraphNode*, int> (startNode, 0));
 
@@ -729,7 +2076,7 @@ std::pair<GraphNode*, int> llvm::Graph::getNearestDependency(llvm::Value* sink,
 			GraphNode* workNode = workList.front().first;
 			int currentDistance = workList.front().second;
 
-			nodeColor[workNode] = 1;
+			markVisited(workNode);
 
 			workList.pop_front();
 
@@ -741,17 +2088,17 @@ std::pair<GraphNode*, int> llvm::Graph::getNearestDependency(llvm::Value* sink,
 
 			}
 
-			std::map<GraphNode*, edgeType> preds = workNode->getPredecessors();
+			GraphNode::edge_range preds = workNode->inEdges();
 
-			for (std::map<GraphNode*, edgeType>::iterator pred = preds.begin(),
-					pend = preds.end(); pred != pend; pred++) {
+			for (GraphNode::edge_iterator pred = preds.begin(),
+					pend = preds.end(); pred != pend; ++pred) {
 
-				if (nodeColor[pred->first] == 0) { // the node hasn't been processed yet
+				if (!isVisited(*pred) && !(skipMemoryNodes && isa<MemNode> (*pred))) { // the node hasn't been processed yet
 
-					nodeColor[pred->first] = 1;
+					markVisited(*pred);
 
 					workList.push_back(
-							pair<GraphNode*, int> (pred->first,
+							pair<GraphNode*, int> (*pred,
 									currentDistance + 1));
 
 				}
@@ -777,20 +2124,12 @@ std::map<GraphNode*, std::vector<GraphNode*> > llvm::Graph::getEveryDependency(
 		//              errs() << "found sink\n";
 		//              errs() << "Starting search from " << startNode->getLabel() << "\n";
 		std::set<GraphNode*> sourceNodes = findNodes(sources);
-		std::map<GraphNode*, int> nodeColor;
 		std::list<GraphNode*> workList;
-		//              int size = 0;
-		for (std::set<GraphNode*>::iterator Nit = nodes.begin(), Nend =
-				nodes.end(); Nit != Nend; Nit++) {
-			//                      size++;
-			if (skipMemoryNodes && isa<MemNode> (*Nit))
-				nodeColor[*Nit] = 1;
-			else
-				nodeColor[*Nit] = 0;
-		}
+
+		startVisit();
 
 		workList.push_back(startNode);
-		nodeColor[startNode] = 1;
+		markVisited(startNode);
 		/*
 		 * we will do a breadth search on the predecessors of each node,
 		 * until we find one of the sources. If we don't find any, then the
@@ -817,14 +2156,14 @@ std::map<GraphNode*, std::vector<GraphNode*> > llvm::Graph::getEveryDependency(
 				//                              errs() << "\n";
 				result[workNode] = path;
 			}
-			std::map<GraphNode*, edgeType> preds = workNode->getPredecessors();
-			for (std::map<GraphNode*, edgeType>::iterator pred = preds.begin(),
-					pend = preds.end(); pred != pend; pred++) {
-				if (nodeColor[pred->first] == 0) { // the node hasn't been processed yet
-					nodeColor[pred->first] = 1;
-					workList.push_back(pred->first);
+			GraphNode::edge_range preds = workNode->inEdges();
+			for (GraphNode::edge_iterator pred = preds.begin(),
+					pend = preds.end(); pred != pend; ++pred) {
+				if (!isVisited(*pred) && !(skipMemoryNodes && isa<MemNode> (*pred))) { // the node hasn't been processed yet
+					markVisited(*pred);
+					workList.push_back(*pred);
 					//                                      pb++;
-					parent[pred->first] = workNode;
+					parent[*pred] = workNode;
 				}
 			}
 			//                      errs() << pb << "/" << size << "\n";
@@ -833,6 +2172,96 @@ std::map<GraphNode*, std::vector<GraphNode*> > llvm::Graph::getEveryDependency(
 	return result;
 }
 
+llvm::Graph::DependencyPaths llvm::Graph::getDependencyPaths(
+		const std::set<llvm::Value*>& sources, bool skipMemoryNodes) {
+
+	DependencyPaths result(this);
+	result.parent.assign(nodeList.size(), -1);
+	result.distance.assign(nodeList.size(), -1);
+
+	std::set<GraphNode*> sourceNodes = findNodes(sources);
+	std::vector<unsigned> workList;
+
+	for (std::set<GraphNode*>::iterator s = sourceNodes.begin(), e =
+			sourceNodes.end(); s != e; ++s) {
+		result.parent[(*s)->index] = (*s)->index;
+		result.distance[(*s)->index] = 0;
+		workList.push_back((*s)->index);
+	}
+
+	/*
+	 * Breadth first search on the successors, starting from every source
+	 * at once: the first time a node is reached it is through a shortest
+	 * path from its nearest source. Memory nodes end paths but, when they
+	 * are skipped, no path goes through them, as in getEveryDependency.
+	 */
+	for (size_t head = 0; head < workList.size(); ++head) {
+
+		GraphNode* workNode = nodeList[workList[head]];
+
+		if (skipMemoryNodes && isa<MemNode> (workNode))
+			continue;
+
+		GraphNode::edge_range succs = workNode->outEdges();
+
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+
+			unsigned index = (*succ)->index;
+
+			if (result.parent[index] < 0) {
+				result.parent[index] = workNode->index;
+				result.distance[index] = result.distance[workNode->index] + 1;
+				workList.push_back(index);
+			}
+
+		}
+
+	}
+
+	return result;
+}
+
+int llvm::Graph::DependencyPaths::reached(llvm::Value* sink) const {
+	GraphNode* node = graph->findNode(sink);
+	if (node == NULL || node->index >= parent.size() || parent[node->index] < 0)
+		return -1;
+	return node->index;
+}
+
+bool llvm::Graph::DependencyPaths::hasDependency(llvm::Value* sink) const {
+	return reached(sink) >= 0;
+}
+
+GraphNode* llvm::Graph::DependencyPaths::getSource(llvm::Value* sink) const {
+	int index = reached(sink);
+	if (index < 0)
+		return NULL;
+	while (parent[index] != index)
+		index = parent[index];
+	return graph->nodeList[index];
+}
+
+int llvm::Graph::DependencyPaths::getDistance(llvm::Value* sink) const {
+	int index = reached(sink);
+	return index < 0 ? -1 : distance[index];
+}
+
+std::vector<GraphNode*> llvm::Graph::DependencyPaths::getPath(
+		llvm::Value* sink) const {
+	std::vector<GraphNode*> path;
+	int index = reached(sink);
+	if (index < 0)
+		return path;
+	path.push_back(graph->nodeList[index]);
+	while (parent[index] != index) {
+		index = parent[index];
+		path.push_back(graph->nodeList[index]);
+	}
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
 int llvm::Graph::getNumOpNodes() {
 	return opNodes.size();
 }
@@ -856,14 +2285,11 @@ int llvm::Graph::getNumEdges(edgeType type) {
 	for (std::set<GraphNode*>::iterator node = nodes.begin(), end = nodes.end(); node
 			!= end; node++) {
 
-		std::map<GraphNode*, edgeType> succs = (*node)->getSuccessors();
-
-		for (std::map<GraphNode*, edgeType>::iterator succ = succs.begin(),
-				s_end = succs.end(); succ != s_end; succ++) {
-
-			if (succ->second == type)
-				result++;
+		GraphNode::edge_range succs = (*node)->outEdges(type);
 
+		for (GraphNode::edge_iterator succ = succs.begin(),
+				s_end = succs.end(); succ != s_end; ++succ) {
+			result++;
 		}
 
 	}
@@ -936,6 +2362,7 @@ void moduleDepGraph::getAnalysisUsage(AnalysisUsage &AU) const {
 
 bool moduleDepGraph::runOnModule(Module &M) {
 
+	PassProfileScope scope("moduleDepGraph", "dependence graph");
 	AliasSets* AS = NULL;
 
 	if (USE_ALIAS_SETS)
@@ -943,34 +2370,198 @@ bool moduleDepGraph::runOnModule(Module &M) {
 
 	//Making dependency graph
 	depGraph = new Graph(AS);
+	if (splitMemNodes && AS) {
+		computeSplitMemKeys(M, AS);
+		depGraph->setSplitMemoryKeys(&splitMemKeys);
+	}
+
+	//A large module gets a thread per processor, unless told otherwise
+	unsigned threads = depGraphThreads;
+	if (depGraphThreads.getNumOccurrences() == 0) {
+		ModuleMetrics metrics = ModuleMetrics::compute(M);
+		if (metrics.isLarge())
+			threads = ModuleMetrics::suggestedThreads();
+	}
 
 	//Insert instructions in the graph
-	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
-		for (Function::iterator BBit = Fit->begin(), BBend = Fit->end(); BBit
-				!= BBend; ++BBit) {
-			for (BasicBlock::iterator Iit = BBit->begin(), Iend = BBit->end(); Iit
-					!= Iend; ++Iit) {
-				depGraph->addInst(Iit);
+	if (threads > 1) {
+		PassProfileScope scope("build", "dependence graph");
+		buildFunctionGraphs(M, AS, threads);
+	} else {
+		PassProfileScope scope("build", "dependence graph");
+		for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
+			for (Function::iterator BBit = Fit->begin(), BBend = Fit->end(); BBit
+					!= BBend; ++BBit) {
+				for (BasicBlock::iterator Iit = BBit->begin(), Iend = BBit->end(); Iit
+						!= Iend; ++Iit) {
+					depGraph->addInst(Iit);
+				}
 			}
 		}
 	}
 
 	//Connect formal and actual parameters and return values
-	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
+	{
+		PassProfileScope scope("match calls", "dependence graph");
+		for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
 
-		// If the function is empty, do not do anything
-		// Empty functions include externally linked ones (i.e. abort, printf, scanf, ...)
-		if (Fit->begin() == Fit->end())
-			continue;
+			// If the function is empty, do not do anything
+			// Empty functions include externally linked ones (i.e. abort, printf, scanf, ...)
+			if (Fit->begin() == Fit->end())
+				continue;
+
+			matchParametersAndReturnValues(*Fit);
+
+		}
 
-		matchParametersAndReturnValues(*Fit);
+		//The flows of the library functions, which have no body to match
+		for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit)
+			addLibraryFlows(*Fit);
+	}
+
+	//Remember which nodes come from each function, for updateFunction
+	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit)
+		recordFunctionNodes(*Fit);
 
+	//The graph is complete; pack its edges for the clients
+	depGraph->compact();
+
+	PassProfile &profile = PassProfile::get();
+	if (profile.isEnabled()) {
+		profile.counter("op nodes", "dependence graph", depGraph->getNumOpNodes());
+		profile.counter("var nodes", "dependence graph", depGraph->getNumVarNodes());
+		profile.counter("mem nodes", "dependence graph", depGraph->getNumMemNodes());
+		profile.counter("data edges", "dependence graph", depGraph->getNumDataEdges());
+		profile.sampleRSS("dependence graph");
 	}
 
 	//We don't modify anything, so we must return false
 	return false;
 }
 
+/*
+ * The ranged sets of RangedAliasSets that can stand for the memory of
+ * their pointers. An alias set is split only if each load and store
+ * through it goes through a pointer of exactly one ranged set, and no
+ * call takes one of its pointers, since the callee could reach memory of
+ * any part: the memory a part doesn't hold is then never read within it.
+ */
+void moduleDepGraph::computeSplitMemKeys(Module &M, AliasSets* AS) {
+
+	splitMemKeys.clear();
+	if (!AS->hasRangedSets()) {
+		errs() << "moduleDepGraph: -depgraph-split-mem needs -ranged-alias-sets "
+				"before it; the memory nodes are not split\n";
+		return;
+	}
+
+	DenseSet<int> whole;
+	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit)
+		for (inst_iterator I = inst_begin(Fit), E = inst_end(Fit); I != E; ++I) {
+			Value* pointer = NULL;
+			if (LoadInst* LI = dyn_cast<LoadInst> (&*I))
+				pointer = LI->getPointerOperand();
+			else if (StoreInst* SI = dyn_cast<StoreInst> (&*I))
+				pointer = SI->getPointerOperand();
+			if (pointer && !AS->getRangedSetKey(pointer))
+				whole.insert(AS->getValueSetKey(pointer));
+
+			CallSite CS(&*I);
+			if (!CS || isa<DbgInfoIntrinsic> (&*I))
+				continue;
+			for (CallSite::arg_iterator A = CS.arg_begin(), AE = CS.arg_end(); A
+					!= AE; ++A)
+				if ((*A)->getType()->isPointerTy())
+					whole.insert(AS->getValueSetKey(*A));
+		}
+
+	const DenseMap<int, std::set<Value*> >& sets = AS->getValueSets();
+	for (DenseMap<int, std::set<Value*> >::const_iterator s = sets.begin(), e =
+			sets.end(); s != e; ++s) {
+		if (whole.count(s->first))
+			continue;
+		bool split = false;
+		for (std::set<Value*>::const_iterator v = s->second.begin(), ve =
+				s->second.end(); v != ve; ++v)
+			if (int key = AS->getRangedSetKey(*v)) {
+				splitMemKeys[*v] = key;
+				split = true;
+			}
+		if (split)
+			NrSplitAliasSets++;
+	}
+}
+
+/// Shared state of the threads building function graphs; each thread
+/// claims the next function until none is left
+struct FunctionGraphTask {
+	std::vector<Function*>* functions;
+	std::vector<Graph*>* graphs;
+	volatile long next;
+};
+
+static void* runFunctionGraphJobs(void* arg) {
+	FunctionGraphTask* task = (FunctionGraphTask*) arg;
+	long numFunctions = task->functions->size();
+
+	while (true) {
+		long i = __sync_fetch_and_add(&task->next, 1);
+		if (i >= numFunctions)
+			break;
+
+		Function* F = (*task->functions)[i];
+		Graph* G = (*task->graphs)[i];
+		for (Function::iterator BBit = F->begin(), BBend = F->end(); BBit
+				!= BBend; ++BBit) {
+			for (BasicBlock::iterator Iit = BBit->begin(), Iend = BBit->end(); Iit
+					!= Iend; ++Iit) {
+				G->addInst(Iit);
+			}
+		}
+	}
+	return 0;
+}
+
+void moduleDepGraph::buildFunctionGraphs(Module &M, AliasSets* AS,
+		unsigned numThreads) {
+
+	std::vector<Function*> functions;
+	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit)
+		if (Fit->begin() != Fit->end())
+			functions.push_back(Fit);
+
+	//The graphs are created in module order, before the workers start
+	std::vector<Graph*> graphs(functions.size());
+	for (unsigned i = 0; i < functions.size(); ++i) {
+		graphs[i] = new Graph(AS);
+		if (!splitMemKeys.empty())
+			graphs[i]->setSplitMemoryKeys(&splitMemKeys);
+	}
+
+	FunctionGraphTask task;
+	task.functions = &functions;
+	task.graphs = &graphs;
+	task.next = 0;
+
+	std::vector<pthread_t> threads(numThreads - 1);
+	for (unsigned t = 0; t < threads.size(); ++t) {
+		if (pthread_create(&threads[t], 0, runFunctionGraphJobs, &task) != 0) {
+			threads.resize(t);
+			break;
+		}
+	}
+	runFunctionGraphJobs(&task);
+	for (unsigned t = 0; t < threads.size(); ++t)
+		pthread_join(threads[t], 0);
+
+	//Merge in the order of the module, so the result doesn't depend on
+	//how the functions were scheduled
+	for (unsigned i = 0; i < graphs.size(); ++i) {
+		depGraph->merge(*graphs[i]);
+		delete graphs[i];
+	}
+}
+
 void moduleDepGraph::matchParametersAndReturnValues(Function &F) {
 
 	// Only do the matching if F has any use
@@ -978,51 +2569,27 @@ void moduleDepGraph::matchParametersAndReturnValues(Function &F) {
 		return;
 	}
 
-	// Data structure which contains the matches between formal and real parameters
-	// First: formal parameter
-	// Second: real parameter
-	SmallVector<std::pair<GraphNode*, GraphNode*>, 4> Parameters(F.arg_size());
-
-	// Fetch the function arguments (formal parameters) into the data structure
-	Function::arg_iterator argptr;
-	Function::arg_iterator e;
-	unsigned i;
+	// The formal parameters, one PHI node for each argument
+	std::vector<GraphNode*>& formals = formalNodes[&F];
+	formals.clear();
 
 	//Create the PHI nodes for the formal parameters
-	for (i = 0, argptr = F.arg_begin(), e = F.arg_end(); argptr != e; ++i, ++argptr) {
+	for (Function::arg_iterator argptr = F.arg_begin(), e = F.arg_end(); argptr
+			!= e; ++argptr) {
 
-		OpNode* argPHI = new OpNode(Instruction::PHI);
+		OpNode* argPHI = new (depGraph->getNodeArena()) OpNode(Instruction::PHI);
 		GraphNode* argNode = NULL;
 		argNode = depGraph->addInst(argptr);
 
 		if (argNode != NULL)
 			depGraph->addEdge(argPHI, argNode);
 
-		Parameters[i].first = argPHI;
+		formals.push_back(argPHI);
 	}
 
-	// Check if the function returns a supported value type. If not, no return value matching is done
-	bool noReturn = F.getReturnType()->isVoidTy();
-
 	// Creates the data structure which receives the return values of the function, if there is any
 	SmallPtrSet<llvm::Value*, 8> ReturnValues;
-
-	if (!noReturn) {
-		// Iterate over the basic blocks to fetch all possible return values
-		for (Function::iterator bb = F.begin(), bbend = F.end(); bb != bbend; ++bb) {
-			// Get the terminator instruction of the basic block and check if it's
-			// a return instruction: if it's not, continue to next basic block
-			Instruction *terminator = bb->getTerminator();
-
-			ReturnInst *RI = dyn_cast<ReturnInst> (terminator);
-
-			if (!RI)
-				continue;
-
-			// Get the return value and insert in the data structure
-			ReturnValues.insert(RI->getReturnValue());
-		}
-	}
+	getReturnValues(F, ReturnValues);
 
 	for (Value::use_iterator UI = F.use_begin(), E = F.use_end(); UI != E; ++UI) {
 		User *U = *UI;
@@ -1042,41 +2609,225 @@ void moduleDepGraph::matchParametersAndReturnValues(Function &F) {
 		if (!CS.isCallee(UI))
 			continue;
 
-		// Iterate over the real parameters and put them in the data structure
-		CallSite::arg_iterator AI;
-		CallSite::arg_iterator EI;
+		matchCallSite(F, CS, ReturnValues);
+	}
+
+	depGraph->deleteCallNodes(&F);
+}
+
+void moduleDepGraph::getReturnValues(Function &F,
+		SmallPtrSet<llvm::Value*, 8> &ReturnValues) {
+
+	// Check if the function returns a supported value type. If not, no return value matching is done
+	if (F.getReturnType()->isVoidTy())
+		return;
+
+	// Iterate over the basic blocks to fetch all possible return values
+	for (Function::iterator bb = F.begin(), bbend = F.end(); bb != bbend; ++bb) {
+		// Get the terminator instruction of the basic block and check if it's
+		// a return instruction: if it's not, continue to next basic block
+		Instruction *terminator = bb->getTerminator();
+
+		ReturnInst *RI = dyn_cast<ReturnInst> (terminator);
+
+		if (!RI)
+			continue;
+
+		// Get the return value and insert in the data structure
+		ReturnValues.insert(RI->getReturnValue());
+	}
+}
+
+void moduleDepGraph::matchCallSite(Function &F, CallSite CS,
+		SmallPtrSet<llvm::Value*, 8> &ReturnValues) {
+
+	std::vector<GraphNode*>& formals = formalNodes[&F];
+	Instruction *caller = CS.getInstruction();
+
+	// Match formal and real parameters
+	unsigned i = 0;
+	for (CallSite::arg_iterator AI = CS.arg_begin(), EI = CS.arg_end(); AI
+			!= EI && i < formals.size(); ++i, ++AI) {
+		if (GraphNode* actual = depGraph->addInst(*AI))
+			depGraph->addEdge(actual, formals[i]);
+	}
 
-		for (i = 0, AI = CS.arg_begin(), EI = CS.arg_end(); AI != EI; ++i, ++AI) {
-			Parameters[i].second = depGraph->addInst(*AI);
+	// Match return values
+	if (!F.getReturnType()->isVoidTy()) {
+
+		OpNode* retPHI = new (depGraph->getNodeArena()) OpNode(Instruction::PHI);
+		GraphNode* callerNode = depGraph->addInst(caller);
+		depGraph->addEdge(retPHI, callerNode);
+
+		for (SmallPtrSetIterator<llvm::Value*> ri = ReturnValues.begin(),
+				re = ReturnValues.end(); ri != re; ++ri) {
+			GraphNode* retNode = depGraph->addInst(*ri);
+			depGraph->addEdge(retNode, retPHI);
 		}
 
-		// Match formal and real parameters
-		for (i = 0; i < Parameters.size(); ++i) {
+		Function* callerFunction = caller->getParent()->getParent();
+		returnNodes[retPHI] = std::make_pair(callerFunction, &F);
+		callerReturnNodes[callerFunction].push_back(retPHI);
+		calleeReturnNodes[&F].push_back(retPHI);
+	}
+}
+
+//The nodes that exist only for F: those of its instructions and arguments,
+//but not the memory nodes, which stand for alias sets shared with others.
+//Taken after the matching, which has deleted the call nodes of F.
+void moduleDepGraph::recordFunctionNodes(Function &F) {
+
+	std::vector<GraphNode*>& owned = functionNodes[&F];
+	owned.clear();
+
+	for (Function::arg_iterator A = F.arg_begin(), E = F.arg_end(); A != E; ++A)
+		if (GraphNode* node = depGraph->findNode(A))
+			if (isa<VarNode> (node))
+				owned.push_back(node);
 
-			depGraph->addEdge(Parameters[i].second, Parameters[i].first);
+	for (Function::iterator BB = F.begin(), BBend = F.end(); BB != BBend; ++BB) {
+		for (BasicBlock::iterator I = BB->begin(), Iend = BB->end(); I != Iend; ++I) {
+			if (GraphNode* node = depGraph->findNode(I))
+				if (isa<VarNode> (node))
+					owned.push_back(node);
+			if (GraphNode* node = depGraph->findOpNode(I))
+				owned.push_back(node);
 		}
+	}
 
-		// Match return values
-		if (!noReturn) {
+	std::vector<GraphNode*>& stores = libraryNodes[&F];
+	owned.insert(owned.end(), stores.begin(), stores.end());
+}
 
-			OpNode* retPHI = new OpNode(Instruction::PHI);
-			GraphNode* callerNode = depGraph->addInst(caller);
-			depGraph->addEdge(retPHI, callerNode);
+//The calls of F to the functions of LibraryModels get the flows of their
+//model: one store node per call and destination, which the sources of the
+//destination flow into. The edges go to the graph in one batch.
+void moduleDepGraph::addLibraryFlows(Function &F) {
 
-			for (SmallPtrSetIterator<llvm::Value*> ri = ReturnValues.begin(),
-					re = ReturnValues.end(); ri != re; ++ri) {
-				GraphNode* retNode = depGraph->addInst(*ri);
-				depGraph->addEdge(retNode, retPHI);
-			}
+	const LibraryModels& models = LibraryModels::get();
+	std::vector<GraphNode*>& stores = libraryNodes[&F];
+	stores.clear();
 
+	std::vector<std::pair<GraphNode*, GraphNode*> > edges;
+	for (Function::iterator BB = F.begin(), BBend = F.end(); BB != BBend; ++BB) {
+		for (BasicBlock::iterator I = BB->begin(), Iend = BB->end(); I != Iend; ++I) {
+			CallSite CS(I);
+			if (!CS || !CS.getCalledFunction())
+				continue;
+			const std::vector<LibraryModels::Flow>* flows = models.lookup(
+					CS.getCalledFunction());
+			if (!flows)
+				continue;
+
+			std::map<int, GraphNode*> callStores;
+			for (unsigned i = 0; i < flows->size(); ++i) {
+				const LibraryModels::Flow& flow = (*flows)[i];
+
+				GraphNode* dstNode = NULL;
+				if (flow.dst == LibraryModels::Ret)
+					dstNode = depGraph->addInst(I);
+				else if ((unsigned) flow.dst < CS.arg_size()
+						&& CS.getArgument(flow.dst)->getType()->isPointerTy())
+					dstNode = depGraph->addInst(CS.getArgument(flow.dst));
+				if (dstNode == NULL)
+					continue;
+
+				GraphNode*& store = callStores[flow.dst];
+				if (store == NULL) {
+					store = new (depGraph->getNodeArena()) OpNode(
+							Instruction::Store);
+					stores.push_back(store);
+					edges.push_back(std::make_pair(store, dstNode));
+				}
+
+				unsigned last = flow.srcVariadic ? CS.arg_size() : flow.src + 1;
+				for (unsigned a = flow.src; a < last && a < CS.arg_size(); ++a)
+					if (GraphNode* srcNode = depGraph->addInst(CS.getArgument(a)))
+						edges.push_back(std::make_pair(srcNode, store));
+			}
 		}
+	}
 
-		// Real parameters are cleaned before moving to the next use (for safety's sake)
-		for (i = 0; i < Parameters.size(); ++i)
-			Parameters[i].second = NULL;
+	depGraph->addEdges(edges);
+}
+
+static void eraseNode(std::vector<GraphNode*>& nodes, GraphNode* node) {
+	nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+}
+
+void moduleDepGraph::removeFunction(Function &F) {
+
+	std::vector<GraphNode*>& owned = functionNodes[&F];
+	for (unsigned i = 0; i < owned.size(); ++i)
+		depGraph->removeNode(owned[i]);
+	functionNodes.erase(&F);
+
+	std::vector<GraphNode*>& formals = formalNodes[&F];
+	for (unsigned i = 0; i < formals.size(); ++i)
+		depGraph->removeNode(formals[i]);
+	formalNodes.erase(&F);
+
+	//Return values matched at the calls made by F and at the calls to F
+	std::vector<GraphNode*> returns = callerReturnNodes[&F];
+	returns.insert(returns.end(), calleeReturnNodes[&F].begin(),
+			calleeReturnNodes[&F].end());
+	for (unsigned i = 0; i < returns.size(); ++i) {
+		if (!returnNodes.count(returns[i]))
+			continue; // F calls itself
+		std::pair<Function*, Function*> call = returnNodes[returns[i]];
+		eraseNode(callerReturnNodes[call.first], returns[i]);
+		eraseNode(calleeReturnNodes[call.second], returns[i]);
+		returnNodes.erase(returns[i]);
+		depGraph->removeNode(returns[i]);
 	}
+	callerReturnNodes.erase(&F);
+	calleeReturnNodes.erase(&F);
+	libraryNodes.erase(&F);
+}
 
-	depGraph->deleteCallNodes(&F);
+void moduleDepGraph::updateFunction(Function &F) {
+
+	removeFunction(F);
+
+	for (Function::iterator BBit = F.begin(), BBend = F.end(); BBit != BBend; ++BBit)
+		for (BasicBlock::iterator Iit = BBit->begin(), Iend = BBit->end(); Iit
+				!= Iend; ++Iit)
+			depGraph->addInst(Iit);
+	addLibraryFlows(F);
+
+	//Calls to F
+	if (F.begin() != F.end())
+		matchParametersAndReturnValues(F);
+
+	//Calls made by F to the other functions of the module
+	std::set<Function*> callees;
+	for (Function::iterator BB = F.begin(), BBend = F.end(); BB != BBend; ++BB) {
+		for (BasicBlock::iterator I = BB->begin(), Iend = BB->end(); I != Iend; ++I) {
+			if (!isa<CallInst> (I) && !isa<InvokeInst> (I))
+				continue;
+			CallSite CS(I);
+			Function* callee = CS.getCalledFunction();
+			if (!callee || callee == &F || callee->begin() == callee->end()
+					|| callee->isVarArg())
+				continue;
+
+			if (!formalNodes.count(callee)) {
+				//First call to callee: match all of them
+				matchParametersAndReturnValues(*callee);
+				continue;
+			}
+
+			SmallPtrSet<llvm::Value*, 8> ReturnValues;
+			getReturnValues(*callee, ReturnValues);
+			matchCallSite(*callee, CS, ReturnValues);
+			callees.insert(callee);
+		}
+	}
+	for (std::set<Function*>::iterator it = callees.begin(), e = callees.end(); it
+			!= e; ++it)
+		depGraph->deleteCallNodes(*it);
+
+	recordFunctionNodes(F);
 }
 
 void llvm::moduleDepGraph::deleteCallNodes(Function* F) {
@@ -1088,8 +2839,9 @@ std::set<GraphNode*> llvm::Graph::getDepValues(std::set<llvm::Value*> sources,
 	unsigned long nnodes = nodes.size();
 	std::set<GraphNode*> visited;
 	std::set<GraphNode*> sourceNodes = findNodes(sources);
+	startVisit();
 	std::list<GraphNode*> worklist;
-	std::map<GraphNode*, edgeType> neigh;
+	GraphNode::edge_range neigh;
 	for (std::set<GraphNode*>::iterator i = sourceNodes.begin(), e =
 			sourceNodes.end(); i != e; ++i) {
 		worklist.push_back(*i);
@@ -1099,14 +2851,15 @@ std::set<GraphNode*> llvm::Graph::getDepValues(std::set<llvm::Value*> sources,
 		DEBUG(errs() << worklist.size() << "/" << visited.size() << "/" << nnodes << "\n");
 		DEBUG(assert(worklist.size() <= nnodes && "Problem with nodes"));
 		if (forward)
-			neigh = n->getSuccessors();
+			neigh = n->outEdges();
 		else
-			neigh = n->getPredecessors();
-		for (std::map<GraphNode*, edgeType>::iterator i = neigh.begin(), e =
-				neigh.end(); i != e; ++i) {
-			if (!visited.count(i->first)) {
-				worklist.push_back(i->first);
-				visited.insert(i->first);
+			neigh = n->inEdges();
+		for (GraphNode::edge_iterator i = neigh.begin(), e = neigh.end(); i
+				!= e; ++i) {
+			if (!isVisited(*i)) {
+				markVisited(*i);
+				worklist.push_back(*i);
+				visited.insert(*i);
 			}
 		}
 		worklist.pop_front();
@@ -1114,14 +2867,45 @@ std::set<GraphNode*> llvm::Graph::getDepValues(std::set<llvm::Value*> sources,
 	return visited;
 }
 
+unsigned llvm::Graph::getDepValues(const std::set<llvm::Value*>& sources,
+		BitVector& deps, bool forward) {
+	PassProfileScope scope("getDepValues", "taint");
+	if (deps.size() < nodeList.size())
+		deps.resize(nodeList.size());
+
+	//deps is closed under the edges followed, so a node already in it has
+	//its neighbors there too and the search stops at it
+	std::vector<GraphNode*> worklist;
+	for (std::set<llvm::Value*>::const_iterator i = sources.begin(), e =
+			sources.end(); i != e; ++i) {
+		GraphNode* n = findNode(*i);
+		if (n && !deps.test(n->index))
+			worklist.push_back(n);
+	}
+	unsigned added = 0;
+	GraphNode::edge_range neigh;
+	while (!worklist.empty()) {
+		GraphNode* n = worklist.back();
+		worklist.pop_back();
+		if (forward)
+			neigh = n->outEdges();
+		else
+			neigh = n->inEdges();
+		for (GraphNode::edge_iterator i = neigh.begin(), e = neigh.end(); i
+				!= e; ++i) {
+			if (!deps.test((*i)->index)) {
+				deps.set((*i)->index);
+				worklist.push_back(*i);
+				++added;
+			}
+		}
+	}
+	return added;
+}
+
 llvm::Graph::Guider::Guider(Graph* graph) {
 	this->graph = graph;
-	std::set<GraphNode*> nodes = graph->getNodes();
-	for (std::set<GraphNode*>::iterator i = nodes.begin(), e = nodes.end(); i
-			!= e; ++i) {
-		nodeAttrs[*i] = "[label=\"" + (*i)->getLabel() + "\" shape=\""
-				+ (*i)->getShape() + "\" style=\"" + (*i)->getStyle() + "\"]";
-	}
+	this->defaultNodeAttrs = true;
 }
 
 void llvm::Graph::Guider::setNodeAttrs(GraphNode* n, std::string attrs) {
@@ -1134,6 +2918,7 @@ void llvm::Graph::Guider::setEdgeAttrs(GraphNode* u, GraphNode* v,
 }
 
 void llvm::Graph::Guider::clear() {
+	defaultNodeAttrs = false;
 	nodeAttrs.clear();
 	edgeAttrs.clear();
 }
@@ -1141,6 +2926,9 @@ void llvm::Graph::Guider::clear() {
 std::string llvm::Graph::Guider::getNodeAttrs(GraphNode* n) {
 	if (nodeAttrs.count(n))
 		return nodeAttrs[n];
+	if (defaultNodeAttrs)
+		return "[label=\"" + n->getLabel() + "\" shape=\"" + n->getShape()
+				+ "\" style=\"" + n->getStyle() + "\"]";
 	return "";
 }
 
@@ -1156,6 +2944,69 @@ char moduleDepGraph::ID = 0;
 static RegisterPass<moduleDepGraph> Y("moduleDepGraph",
 		"Module Dependence Graph");
 
+bool ViewModuleDepGraph::runOnModule(Module& M) {
+
+	moduleDepGraph& DepGraph = getAnalysis<moduleDepGraph> ();
+	Graph *g = DepGraph.depGraph;
+
+	std::string tmp = M.getModuleIdentifier();
+	replace(tmp.begin(), tmp.end(), '\\', '_');
+
+	std::string Filename = "/tmp/" + tmp + ".dot";
+
+	Graph::DotFilter filter;
+	for (unsigned i = 0; i < dotFunctions.size(); ++i)
+		if (Function* F = M.getFunction(dotFunctions[i]))
+			filter.addFunction(F);
+		else {
+			errs() << "view-depgraph: no function " << dotFunctions[i] << "\n";
+			return false;
+		}
+
+	//Values are named within their functions, so look everywhere
+	for (unsigned i = 0; i < dotValues.size(); ++i) {
+		bool found = false;
+		if (GlobalValue* GV = M.getNamedValue(dotValues[i])) {
+			filter.addNeighborhood(GV, dotHops);
+			found = true;
+		}
+		for (Module::iterator F = M.begin(), Fend = M.end(); F != Fend; ++F) {
+			for (Function::arg_iterator A = F->arg_begin(), Aend =
+					F->arg_end(); A != Aend; ++A)
+				if (A->getName() == dotValues[i]) {
+					filter.addNeighborhood(A, dotHops);
+					found = true;
+				}
+			for (Function::iterator BB = F->begin(), BBend = F->end(); BB
+					!= BBend; ++BB)
+				for (BasicBlock::iterator I = BB->begin(), Iend = BB->end(); I
+						!= Iend; ++I)
+					if (I->getName() == dotValues[i]) {
+						filter.addNeighborhood(I, dotHops);
+						found = true;
+					}
+		}
+		if (!found) {
+			errs() << "view-depgraph: no value " << dotValues[i] << "\n";
+			return false;
+		}
+	}
+
+	if (dotControlEdges)
+		filter.setEdgeTypes(false, true);
+
+	//Print dependency graph (in dot format)
+	g->toDot(M.getModuleIdentifier(), Filename, filter);
+
+	//                DisplayGraph(Filename, true, GraphProgram::DOT);
+
+	return false;
+}
+
 char ViewModuleDepGraph::ID = 0;
 static RegisterPass<ViewModuleDepGraph> Z("view-depgraph",
 		"View Module Dependence Graph");
+
+char WriteModuleDepGraph::ID = 0;
+static RegisterPass<WriteModuleDepGraph> W("write-depgraph",
+		"Write Module Dependence Graph (binary)");
@@ -8,9 +8,11 @@
 #define USE_ALIAS_SETS true
 
 #include "llvm/Pass.h"
-#include "llvm/Module.h"
+#include "llvm/IR/Module.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/DominanceFrontier.h"
 #include "llvm/ADT/DenseMap.h"
@@ -44,6 +46,43 @@ typedef enum {
 	etData = 0, etControl = 1
 } edgeType;
 
+class Graph;
+
+/*
+ * Class NodeArena
+ *
+ * Memory for the nodes of a Graph. Nodes are carved out of large slabs in
+ * the order they are created, so the nodes of a function sit next to each
+ * other, and all the slabs are freed in one go with the Graph. Deleting a
+ * node of the arena only runs its destructor.
+ */
+class NodeArena {
+public:
+	NodeArena() :
+		current(NULL), left(0), bytes(0) {
+	}
+	// Graphs are returned by value: the copy takes the slabs over
+	NodeArena(const NodeArena& other);
+	~NodeArena();
+
+	void* allocate(size_t size);
+
+	// Move the slabs of other here, leaving other empty
+	void splice(NodeArena& other);
+
+	size_t getNumBytes() const;
+
+private:
+	static const size_t SlabSize = 64 * 1024;
+
+	std::vector<char*> slabs;
+	char* current;
+	size_t left;
+	size_t bytes;
+
+	NodeArena& operator=(const NodeArena&);
+};
+
 /*
  * Class GraphNode
  *
@@ -65,9 +104,20 @@ private:
 	std::map<GraphNode*, edgeType> successors;
 	std::map<GraphNode*, edgeType> predecessors;
 
-	static int currentID;
+	// The index of the node in the Graph it was first inserted into, so
+	// graphs built in parallel threads number their nodes alike; -1 until
+	// then
 	int ID;
 
+	// Set while the node belongs to a compacted Graph: its edges then live
+	// in the arrays of that Graph, and the maps above are empty
+	Graph* compactGraph;
+
+	// Dense index of the node in its Graph
+	unsigned index;
+
+	friend class Graph;
+
 protected:
 	int Class_ID;
 public:
@@ -76,6 +126,16 @@ public:
 
 	virtual ~GraphNode();
 
+	/*
+	 * Nodes are allocated either in the arena of a Graph, with
+	 * new (G.getNodeArena()) OpNode(...), or on the heap. A small header in
+	 * front of every node tells delete which one it was.
+	 */
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, NodeArena& arena);
+	static void operator delete(void* p);
+	static void operator delete(void* p, NodeArena& arena);
+
 	static inline bool classof(const GraphNode *N) {
 		return true;
 	}
@@ -86,6 +146,72 @@ public:
 	std::map<GraphNode*, edgeType> getPredecessors();
 	bool hasPredecessor(GraphNode* pred);
 
+	/*
+	 * Iterator over the successors or the predecessors of a node, on either
+	 * edge representation, that doesn't copy anything. When built with an
+	 * edgeType, edges of the other type are skipped. The edges must not be
+	 * changed while iterating.
+	 */
+	class edge_iterator {
+	public:
+		edge_iterator() :
+			graph(NULL), edge(NULL), edgeEnd(NULL), filter(-1) {
+		}
+
+		GraphNode* operator*() const;
+		edgeType getType() const;
+
+		edge_iterator& operator++() {
+			if (graph)
+				++edge;
+			else
+				++mapIt;
+			skip();
+			return *this;
+		}
+
+		bool operator==(const edge_iterator& other) const {
+			return graph ? edge == other.edge : mapIt == other.mapIt;
+		}
+		bool operator!=(const edge_iterator& other) const {
+			return !(*this == other);
+		}
+
+	private:
+		friend class GraphNode;
+
+		//Skip the edges that don't match the filter
+		void skip();
+
+		std::map<GraphNode*, edgeType>::const_iterator mapIt, mapEnd;
+		const Graph* graph;
+		const unsigned* edge;
+		const unsigned* edgeEnd;
+		int filter;
+	};
+
+	struct edge_range {
+		edge_iterator first, second;
+		edge_iterator begin() const {
+			return first;
+		}
+		edge_iterator end() const {
+			return second;
+		}
+	};
+
+	edge_range outEdges();
+	edge_range outEdges(edgeType type);
+	edge_range inEdges();
+	edge_range inEdges(edgeType type);
+
+private:
+	edge_range makeRange(const std::map<GraphNode*, edgeType>& edges,
+			const std::vector<unsigned>* compactEdges,
+			const std::vector<unsigned>* compactOffsets, int filter);
+
+public:
+
 	void connect(GraphNode* dst, edgeType type = etData);
 	int getClass_Id() const;
 	int getId() const;
@@ -233,6 +359,10 @@ public:
 	std::string getStyle();
 
 	int getAliasSetId() const;
+
+	//True if the alias set comes from unified points-to sets, so the node
+	//may stand for more memory than the program can reach through it
+	bool isCoarse() const;
 };
 
 /*
@@ -258,8 +388,127 @@ private:
 
 	std::set<GraphNode*> nodes;
 
+	//The nodes by dense index (GraphNode::index); deleted nodes leave a NULL
+	std::vector<GraphNode*> nodeList;
+
+	//Memory of the nodes created by addInst; freed after they are deleted
+	NodeArena arena;
+
+	void insertNode(GraphNode* node);
+	bool hasNode(GraphNode* node) const {
+		return node->index < nodeList.size() && nodeList[node->index] == node;
+	}
+
+	/*
+	 * Visited marks of the graph searches. A node is visited by the
+	 * current search if its mark is the current epoch, so starting a new
+	 * search doesn't need to clear anything.
+	 */
+	std::vector<unsigned> visitMarks;
+	unsigned visitEpoch;
+
+	void startVisit();
+	bool isVisited(GraphNode* node) const {
+		return visitMarks[node->index] == visitEpoch;
+	}
+	void markVisited(GraphNode* node) {
+		visitMarks[node->index] = visitEpoch;
+	}
+
+	//Second set of marks, for the searches that go both ways at once
+	std::vector<unsigned> backMarks;
+	unsigned backEpoch;
+
+	void startBackVisit();
+	bool isBackVisited(GraphNode* node) const {
+		return backMarks[node->index] == backEpoch;
+	}
+	void markBackVisited(GraphNode* node) {
+		backMarks[node->index] = backEpoch;
+	}
+
+	/*
+	 * Compressed sparse row form of the edges, built by compact(). Node i
+	 * of nodeList has its successors in succEdges[succOffsets[i]] to
+	 * succEdges[succOffsets[i + 1] - 1], sorted by index, and likewise for
+	 * its predecessors. Each entry packs the index of the neighbor and the
+	 * edgeType of the edge (lowest bit).
+	 */
+	bool compacted;
+	std::vector<unsigned> succOffsets;
+	std::vector<unsigned> predOffsets;
+	std::vector<unsigned> succEdges;
+	std::vector<unsigned> predEdges;
+
+	static unsigned packEdge(unsigned index, edgeType type) {
+		return index << 1 | type;
+	}
+	static unsigned edgeIndex(unsigned edge) {
+		return edge >> 1;
+	}
+	static edgeType edgeKind(unsigned edge) {
+		return (edgeType) (edge & 1);
+	}
+
+	bool packEdges(const std::map<GraphNode*, edgeType>& neighbors,
+			std::vector<unsigned>& edges);
+	static unsigned mergeCompactEdges(
+			std::vector<std::pair<unsigned, unsigned> >& added,
+			std::vector<unsigned>& offsets, std::vector<unsigned>& edges);
+
+	/*
+	 * Reachability index, built on the graph of strongly connected
+	 * components. Components are numbered in the order Tarjan's algorithm
+	 * finishes them, so every edge of the condensation goes from a higher
+	 * number to a lower one. Each component has ReachLabels intervals
+	 * [low, post] from depth first searches in different child orders: if
+	 * u reaches v, the intervals of v are inside the ones of u. The first
+	 * search also gives pre-order numbers, so the descendants of u in its
+	 * spanning forest are answered without searching. The remaining pairs
+	 * fall back to a depth first search pruned by the intervals.
+	 *
+	 * The index is only valid while the graph stays compact: any change
+	 * to the edges expands the graph and the index is rebuilt on the next
+	 * query.
+	 */
+	static const unsigned ReachLabels = 2;
+
+	bool reachIndexEnabled;
+	bool reachIndexValid;
+	std::vector<unsigned> nodeComponent; // by node index
+	std::vector<unsigned> dagOffsets;
+	std::vector<unsigned> dagEdges;
+	std::vector<unsigned> labelLow; // ReachLabels entries per component
+	std::vector<unsigned> labelPost;
+	std::vector<unsigned> treePre;
+	std::vector<unsigned> componentMarks;
+	unsigned componentEpoch;
+
+	bool buildReachabilityIndex();
+	void findComponents();
+	void labelComponents(unsigned label);
+	bool mayReach(unsigned from, unsigned to) const;
+	bool searchComponents(unsigned from, unsigned to);
+	bool searchNodes(GraphNode* src, GraphNode* dst);
+
+	friend class GraphNode;
+	friend class GraphNode::edge_iterator;
+
 	AliasSets *AS;
 
+	//The memory nodes of the pointers in the split alias sets, of
+	//setSplitMemoryKeys, or NULL
+	const llvm::DenseMap<Value*, int>* splitKeys;
+
+	//The key of the memory node of the pointer v
+	int getMemoryKey(Value* v);
+
+public:
+	class DotFilter;
+private:
+	void selectNeighborhoods(const DotFilter& filter,
+			std::vector<GraphNode*>& selected);
+
 	bool isValidInst(Value *v); //Return true if the instruction is valid for dependence graph construction
 	bool isMemoryPointer(Value *v); //Return true if the value is a memory pointer
 
@@ -272,14 +521,49 @@ public:
 	std::set<GraphNode*>::iterator end();
 
 	Graph(AliasSets *AS) :
-		AS(AS) {
-		NrEdges = 0;
+		visitEpoch(0), backEpoch(0), compacted(false), reachIndexEnabled(false),
+				reachIndexValid(false), componentEpoch(0), AS(AS), splitKeys(NULL) {
 	}
 	; //Constructor
 	~Graph(); //Destructor - Free adjacent matrix's memory
 
+	NodeArena& getNodeArena() {
+		return arena;
+	}
+
+	/*
+	 * Gives the pointers of keys the memory node of their key instead of
+	 * the one of their alias set, to split an alias set into the parts of
+	 * memory that its pointers can't reach from one another. keys must
+	 * outlive the graph; set it before adding instructions.
+	 */
+	void setSplitMemoryKeys(const llvm::DenseMap<Value*, int>* keys) {
+		splitKeys = keys;
+	}
+
 	std::set<GraphNode*> getDepValues(
 			std::set<llvm::Value*> sources, bool forward=true);
+
+	/*
+	 * getDepValues into a bit vector over the node indices. deps is taken
+	 * as the result of earlier calls: the nodes it holds are not searched
+	 * again, so adding sources only visits what they newly reach. Returns
+	 * the number of nodes added.
+	 */
+	unsigned getDepValues(const std::set<llvm::Value*>& sources,
+			BitVector& deps, bool forward=true);
+
+	//Dense index of a node in its graph, below getNumNodeIndices()
+	static unsigned getNodeIndex(const GraphNode* node) {
+		return node->index;
+	}
+	unsigned getNumNodeIndices() const {
+		return nodeList.size();
+	}
+	//The node of an index, or NULL if it was deleted
+	GraphNode* getNodeByIndex(unsigned index) const {
+		return nodeList[index];
+	}
 	int getTaintedEdges();
 	int getTaintedNodesSize();
 
@@ -287,6 +571,14 @@ public:
 
 	void addEdge(GraphNode* src, GraphNode* dst, edgeType type = etData);
 
+	/*
+	 * addEdge for many edges at once. On a compacted graph whose nodes
+	 * the edges join, the edges are merged into the arrays in one pass
+	 * and the graph stays compact; otherwise they are added one by one.
+	 */
+	void addEdges(const std::vector<std::pair<GraphNode*, GraphNode*> >& edges,
+			edgeType type = etData);
+
 	GraphNode* findNode(Value *op); //Return the pointer to the node or NULL if it is not in the graph
 	std::set<GraphNode*> findNodes(std::set<Value*> values);
 
@@ -294,6 +586,35 @@ public:
 
 	std::set<GraphNode*> getNodes();
 
+	/*
+	 * Move the edges of every node into contiguous arrays, to save memory
+	 * and make traversals cheaper once the graph is built. The graph can
+	 * still be changed afterwards: adding or removing edges expands it back
+	 * to the per-node maps first.
+	 */
+	void compact();
+	void expand();
+	bool isCompact() const;
+
+	/*
+	 * Move every node of other into this graph, leaving other empty.
+	 * VarNodes of the same value and MemNodes of the same alias set become
+	 * one node. The nodes are added, and numbered, in the order other
+	 * created them, so merging the graphs of the functions one after
+	 * another gives the graph that adding their instructions here would.
+	 */
+	void merge(Graph& other);
+
+	/*
+	 * Answers whether dst depends on src, i.e. whether there is a path
+	 * from src to dst. With the reachability index enabled (here or with
+	 * -depgraph-reach-index) the graph is compacted and indexed on the
+	 * first query, and most queries don't search the graph at all.
+	 */
+	void setReachabilityIndex(bool enable);
+	bool isReachable(GraphNode* src, GraphNode* dst);
+	bool isReachable(Value* src, Value* dst);
+
 	//print graph in dot format
 	class Guider {
 	public:
@@ -305,14 +626,104 @@ public:
 		void clear();
 	private:
 		Graph* graph;
+		// Only the attributes that were set are stored; until clear() is
+		// called, the other nodes get their label, shape and style
+		bool defaultNodeAttrs;
 		DenseMap<GraphNode*, std::string> nodeAttrs;
 		DenseMap<std::pair<GraphNode*, GraphNode*>, std::string> edgeAttrs;
 	};
+
+	/*
+	 * The part of the graph that toDot writes. An empty filter keeps the
+	 * whole graph; every restriction added narrows it further:
+	 *              - functions: only nodes of these functions, plus the
+	 *                nodes that belong to no function (memory, constants,
+	 *                globals) next to them
+	 *              - neighborhoods: only nodes at most some hops away from
+	 *                chosen values, following edges both ways
+	 *              - taint sources: only nodes that depend on the sources
+	 *              - edge types: only data or only control edges
+	 * With neighborhoods or taint sources, the work done is proportional
+	 * to the part written, not to the whole graph.
+	 */
+	class DotFilter {
+	public:
+		DotFilter();
+		void addFunction(const Function* F);
+		void addNeighborhood(Value* v, unsigned hops);
+		void addTaintSource(Value* v);
+		void setEdgeTypes(bool data, bool control);
+	private:
+		friend class Graph;
+		SmallPtrSet<const Function*, 8> functions;
+		std::vector<std::pair<Value*, unsigned> > neighborhoods;
+		std::set<Value*> taintSources;
+		bool dataEdges;
+		bool controlEdges;
+	};
+
 	void toDot(std::string s); //print in stdErr
 	void toDot(std::string s, std::string fileName); //print in a file
 	void toDot(std::string s, raw_ostream *stream); //print in any stream
 	void toDot(std::string s, raw_ostream *stream, llvm::Graph::Guider* g);
 
+	//Stream the part of the graph kept by filter, with the attributes of g
+	//if there is one
+	void toDot(std::string s, std::string fileName, const DotFilter& filter);
+	void toDot(std::string s, raw_ostream *stream, const DotFilter& filter,
+			llvm::Graph::Guider* g = NULL);
+
+	/*
+	 * Write the graph in the binary format of DepGraphFile.h, which tools
+	 * map in memory instead of parsing. Only the nodes and the string
+	 * table are gathered first; the edges are streamed out node by node.
+	 */
+	void toBinary(std::string s, std::string fileName);
+	void toBinary(std::string s, raw_ostream *stream);
+
+	/*
+	 * The nodes on the paths from a source to a destination, as a view on
+	 * the graph: nothing is copied, and the view is only valid while the
+	 * graph doesn't change. The nodes are sorted by their index in the
+	 * graph.
+	 */
+	class SubGraph {
+	public:
+		SubGraph() :
+			graph(NULL) {
+		}
+		bool empty() const {
+			return nodes.empty();
+		}
+		unsigned size() const {
+			return nodes.size();
+		}
+		const std::vector<GraphNode*>& getNodes() const {
+			return nodes;
+		}
+		bool hasNode(GraphNode* node) const;
+		unsigned getNumDataEdges() const;
+		unsigned getNumControlEdges() const;
+		void toDot(std::string s, std::string fileName) const;
+		void toDot(std::string s, raw_ostream *stream) const;
+	private:
+		friend class Graph;
+		Graph* graph;
+		std::vector<GraphNode*> nodes;
+		static bool byIndex(GraphNode* a, GraphNode* b);
+		unsigned getNumEdges(edgeType type) const;
+	};
+
+	/*
+	 * The nodes that lie on a path from src to dst, the source included.
+	 * A bidirectional search first finds out whether there is any such
+	 * path, so unrelated pairs are given up as soon as one side runs out
+	 * of nodes; only then the searches are completed, the backward one
+	 * restricted to the nodes reached forwards. Paths don't go through
+	 * dst, or back through src, on the way.
+	 */
+	SubGraph getSubGraph(Value *src, Value *dst);
+
 	Graph generateSubGraph(Value *src, Value *dst); //Take a source value and a destination value and find a Connecting Subgraph from source to destination
 
 	void dfsVisit(GraphNode* u, GraphNode* u2,
@@ -322,6 +733,9 @@ public:
 
 	void deleteCallNodes(Function* F);
 
+	// Unlink node from the graph and delete it
+	void removeNode(GraphNode* node);
+
 	/*
 	 * Function getNearestDependence
 	 *
@@ -339,6 +753,52 @@ public:
 			llvm::Value* sink, std::set<llvm::Value*> sources,
 			bool skipMemoryNodes);
 
+	/*
+	 * Class DependencyPaths
+	 *
+	 * Shortest paths from a set of sources to every node of the graph,
+	 * found by a single breadth first search that starts at all sources at
+	 * once. Each node keeps the node it was reached from, so the path to
+	 * any sink is rebuilt on demand. It answers the same question as
+	 * getNearestDependency for as many sinks as needed.
+	 *
+	 * The paths refer to the graph as it was when they were computed.
+	 */
+	class DependencyPaths {
+	public:
+		bool hasDependency(Value* sink) const;
+
+		// Nearest source of sink, or NULL if it doesn't depend on any
+		GraphNode* getSource(Value* sink) const;
+
+		// Length of the path from the nearest source, or -1
+		int getDistance(Value* sink) const;
+
+		// The path from the nearest source to sink, in the same order as
+		// getEveryDependency: the source first and the sink last
+		std::vector<GraphNode*> getPath(Value* sink) const;
+
+	private:
+		friend class Graph;
+		DependencyPaths(Graph* graph) : graph(graph) {}
+
+		// Index of sink in the graph, or -1 if it has no path
+		int reached(Value* sink) const;
+
+		Graph* graph;
+		std::vector<int> parent; // indexed by node, -1 if not reached
+		std::vector<int> distance;
+	};
+
+	/*
+	 * Function getDependencyPaths
+	 *
+	 * Computes the shortest path from sources to every node, so that
+	 * many sinks can be queried without a new search for each one
+	 */
+	DependencyPaths getDependencyPaths(const std::set<llvm::Value*>& sources,
+			bool skipMemoryNodes);
+
 	int getNumOpNodes();
 	int getNumCallNodes();
 	int getNumMemNodes();
@@ -349,6 +809,25 @@ public:
 
 };
 
+inline GraphNode* GraphNode::edge_iterator::operator*() const {
+	return graph ? graph->nodeList[Graph::edgeIndex(*edge)] : mapIt->first;
+}
+
+inline edgeType GraphNode::edge_iterator::getType() const {
+	return graph ? Graph::edgeKind(*edge) : mapIt->second;
+}
+
+inline void GraphNode::edge_iterator::skip() {
+	if (filter < 0)
+		return;
+	if (graph)
+		while (edge != edgeEnd && Graph::edgeKind(*edge) != filter)
+			++edge;
+	else
+		while (mapIt != mapEnd && mapIt->second != filter)
+			++mapIt;
+}
+
 /*
  * Class functionDepGraph
  *
@@ -385,13 +864,61 @@ public:
 	void matchParametersAndReturnValues(Function &F);
 	void deleteCallNodes(Function* F);
 
+	/*
+	 * Keep the graph up to date after a transformation changes F, without
+	 * building it again: the nodes of F and its parameter and return value
+	 * matchings are removed, and built again from the current body of F.
+	 * removeFunction alone is for functions about to be erased.
+	 *
+	 * The graph is left expanded; call depGraph->compact() when done.
+	 */
+	void updateFunction(Function &F);
+	void removeFunction(Function &F);
+
 	Graph* depGraph;
+
+private:
+	// The nodes of the instructions and arguments of each function
+	DenseMap<Function*, std::vector<GraphNode*> > functionNodes;
+
+	// The PHI nodes of the formal parameters of each function
+	DenseMap<Function*, std::vector<GraphNode*> > formalNodes;
+
+	// The PHI node of the return value at each matched call, and the
+	// (caller, callee) functions of that call
+	DenseMap<GraphNode*, std::pair<Function*, Function*> > returnNodes;
+	DenseMap<Function*, std::vector<GraphNode*> > callerReturnNodes;
+	DenseMap<Function*, std::vector<GraphNode*> > calleeReturnNodes;
+
+	// The store nodes of the library calls made by each function
+	DenseMap<Function*, std::vector<GraphNode*> > libraryNodes;
+
+	// With -depgraph-split-mem, the ranged set of each pointer of the
+	// alias sets that can be split
+	DenseMap<Value*, int> splitMemKeys;
+	void computeSplitMemKeys(Module &M, AliasSets* AS);
+
+	void getReturnValues(Function &F, SmallPtrSet<llvm::Value*, 8> &ReturnValues);
+	void matchCallSite(Function &F, CallSite CS,
+			SmallPtrSet<llvm::Value*, 8> &ReturnValues);
+	void recordFunctionNodes(Function &F);
+	void addLibraryFlows(Function &F);
+
+	// Builds the graph of each function on its own thread, then merges
+	// them in the order of the module
+	void buildFunctionGraphs(Module &M, AliasSets* AS, unsigned numThreads);
 };
 
-class ViewModuleDepGraph: public ModulePass {
+/*
+ * Class WriteModuleDepGraph
+ *
+ * Writes the module dependence graph to /tmp/<module>.dg in the binary
+ * format of DepGraphFile.h.
+ */
+class WriteModuleDepGraph: public ModulePass {
 public:
 	static char ID; // Pass identification, replacement for typeid.
-	ViewModuleDepGraph() :
+	WriteModuleDepGraph() :
 		ModulePass(ID) {
 	}
 
@@ -403,20 +930,30 @@ public:
 	bool runOnModule(Module& M) {
 
 		moduleDepGraph& DepGraph = getAnalysis<moduleDepGraph> ();
-		Graph *g = DepGraph.depGraph;
 
 		std::string tmp = M.getModuleIdentifier();
 		replace(tmp.begin(), tmp.end(), '\\', '_');
 
-		std::string Filename = "/tmp/" + tmp + ".dot";
+		DepGraph.depGraph->toBinary(M.getModuleIdentifier(),
+				"/tmp/" + tmp + ".dg");
 
-		//Print dependency graph (in dot format)
-		g->toDot(M.getModuleIdentifier(), Filename);
+		return false;
+	}
+};
 
-		//                DisplayGraph(Filename, true, GraphProgram::DOT);
+class ViewModuleDepGraph: public ModulePass {
+public:
+	static char ID; // Pass identification, replacement for typeid.
+	ViewModuleDepGraph() :
+		ModulePass(ID) {
+	}
 
-		return false;
+	void getAnalysisUsage(AnalysisUsage &AU) const {
+		AU.addRequired<moduleDepGraph> ();
+		AU.setPreservesAll();
 	}
+
+	bool runOnModule(Module& M);
 };
 }
 
@@ -0,0 +1,338 @@
+#ifndef DEPGRAPH_FILE_H_
+#define DEPGRAPH_FILE_H_
+
+/*
+ * Binary dependence graph files, written by Graph::toBinary and read back
+ * by DepGraphFile without LLVM and without parsing: the file is mapped in
+ * memory and every section is used in place.
+ *
+ * Layout (native byte order, every section 8-byte aligned):
+ *
+ *      DepGraphFileHeader
+ *      DepGraphFileNode   nodes[numNodes]
+ *      uint32_t           succOffsets[numNodes + 1]
+ *      uint32_t           succEdges[numEdges]
+ *      uint32_t           predOffsets[numNodes + 1]
+ *      uint32_t           predEdges[numEdges]
+ *      char               strings[stringsSize]
+ *
+ * The edges are in compressed sparse row form, like the compact form of
+ * Graph: node i has its successors in succEdges[succOffsets[i]] to
+ * succEdges[succOffsets[i + 1] - 1], sorted by node, and likewise for its
+ * predecessors. Each entry packs the neighbor (high bits) and the type of
+ * the edge (lowest bit, DGF_ControlEdge for control edges).
+ *
+ * Strings are NUL terminated and referred to by their offset in the string
+ * table; offset 0 is the empty string.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DEPGRAPH_FILE_MAGIC "DEPGRAPH"
+#define DEPGRAPH_FILE_VERSION 1
+
+// Node kinds; the same numbers as GraphNode::getClass_Id()
+enum {
+	DGF_OpNode = 1, DGF_VarNode = 2, DGF_CallNode = 3, DGF_MemNode = 4
+};
+
+// Node flags
+enum {
+	DGF_Constant = 1 // VarNode of a constant
+};
+
+// Edge types, in the lowest bit of the edge entries
+enum {
+	DGF_DataEdge = 0, DGF_ControlEdge = 1
+};
+
+struct DepGraphFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t numNodes;
+	uint32_t numEdges;
+	uint32_t stringsSize;
+	uint32_t module; // name of the module (string)
+	uint32_t reserved;
+	uint64_t nodesOffset;
+	uint64_t succOffsetsOffset;
+	uint64_t succEdgesOffset;
+	uint64_t predOffsetsOffset;
+	uint64_t predEdgesOffset;
+	uint64_t stringsOffset;
+};
+
+struct DepGraphFileNode {
+	uint32_t kind;
+	uint32_t flags;
+	int32_t id; // GraphNode::getId()
+	uint32_t aux; // opcode of Op/CallNodes, alias set of MemNodes
+	uint32_t label; // string
+	uint32_t function; // string, empty if unknown
+	uint32_t file; // string, empty without debug info
+	uint32_t line; // 0 without debug info
+};
+
+/*
+ * Class DepGraphFile
+ *
+ * Read only view of a binary dependence graph file. Nodes are numbered
+ * from 0 to getNumNodes() - 1 in the order of the file.
+ */
+class DepGraphFile {
+public:
+	DepGraphFile() :
+		data(NULL), size(0), mappedFile(false) {
+	}
+	~DepGraphFile() {
+		close();
+	}
+
+	// Map fileName in memory; false if it can't be read or isn't valid
+	bool open(const std::string& fileName);
+	void close();
+
+	// Use a file already in memory (8-byte aligned), which must outlive this
+	bool openMemory(const void* data, size_t size);
+
+	bool isOpen() const {
+		return header() != NULL;
+	}
+
+	unsigned getNumNodes() const {
+		return header()->numNodes;
+	}
+	unsigned getNumEdges() const {
+		return header()->numEdges;
+	}
+	const char* getModuleName() const {
+		return getString(header()->module);
+	}
+
+	const DepGraphFileNode& getNode(unsigned node) const {
+		return nodes()[node];
+	}
+	const char* getLabel(unsigned node) const {
+		return getString(getNode(node).label);
+	}
+	const char* getString(uint32_t offset) const {
+		return section<char> (header()->stringsOffset) + offset;
+	}
+
+	/*
+	 * Edges of a node, as [begin, end) ranges of packed entries; use
+	 * edgeNode and edgeType to unpack them.
+	 */
+	const uint32_t* succBegin(unsigned node) const {
+		return succEdges() + succOffsets()[node];
+	}
+	const uint32_t* succEnd(unsigned node) const {
+		return succEdges() + succOffsets()[node + 1];
+	}
+	const uint32_t* predBegin(unsigned node) const {
+		return predEdges() + predOffsets()[node];
+	}
+	const uint32_t* predEnd(unsigned node) const {
+		return predEdges() + predOffsets()[node + 1];
+	}
+
+	static unsigned edgeNode(uint32_t edge) {
+		return edge >> 1;
+	}
+	static unsigned edgeType(uint32_t edge) {
+		return edge & 1;
+	}
+
+	bool hasEdge(unsigned src, unsigned dst) const;
+
+	// The nodes with the given label, in file order
+	std::vector<unsigned> findNodes(const char* label) const;
+
+	// The given nodes and the ones they reach (forward) or that reach them
+	std::vector<unsigned> getDepNodes(const std::vector<unsigned>& sources,
+			bool forward = true) const;
+
+private:
+	const char* data;
+	size_t size;
+	bool mappedFile; // data was mapped by open()
+
+	DepGraphFile(const DepGraphFile&);
+	DepGraphFile& operator=(const DepGraphFile&);
+
+	bool validate() const;
+	bool validOffsets(const uint32_t* offsets, uint64_t numEdges) const;
+
+	template<typename T> const T* section(uint64_t offset) const {
+		return reinterpret_cast<const T*> (data + offset);
+	}
+	const DepGraphFileHeader* header() const {
+		return reinterpret_cast<const DepGraphFileHeader*> (data);
+	}
+	const DepGraphFileNode* nodes() const {
+		return section<DepGraphFileNode> (header()->nodesOffset);
+	}
+	const uint32_t* succOffsets() const {
+		return section<uint32_t> (header()->succOffsetsOffset);
+	}
+	const uint32_t* succEdges() const {
+		return section<uint32_t> (header()->succEdgesOffset);
+	}
+	const uint32_t* predOffsets() const {
+		return section<uint32_t> (header()->predOffsetsOffset);
+	}
+	const uint32_t* predEdges() const {
+		return section<uint32_t> (header()->predEdgesOffset);
+	}
+};
+
+// ============================================= //
+
+inline bool DepGraphFile::open(const std::string& fileName) {
+	close();
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	void* p = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (p == MAP_FAILED)
+		return false;
+
+	data = (const char*) p;
+	size = st.st_size;
+	mappedFile = true;
+	if (!validate()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+inline bool DepGraphFile::openMemory(const void* memory, size_t memorySize) {
+	close();
+	data = (const char*) memory;
+	size = memorySize;
+	if (!validate()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+inline void DepGraphFile::close() {
+	if (mappedFile)
+		munmap((void*) data, size);
+	mappedFile = false;
+	data = NULL;
+	size = 0;
+}
+
+inline bool DepGraphFile::validOffsets(const uint32_t* offsets,
+		uint64_t numEdges) const {
+	if (offsets[0] != 0 || offsets[header()->numNodes] != numEdges)
+		return false;
+	for (unsigned i = 0; i < header()->numNodes; ++i)
+		if (offsets[i] > offsets[i + 1])
+			return false;
+	return true;
+}
+
+inline bool DepGraphFile::validate() const {
+	if (size < sizeof(DepGraphFileHeader))
+		return false;
+
+	const DepGraphFileHeader* H = header();
+	if (memcmp(H->magic, DEPGRAPH_FILE_MAGIC, 8) != 0 || H->version
+			!= DEPGRAPH_FILE_VERSION)
+		return false;
+
+	//Every section must be aligned and inside the file
+	uint64_t n = H->numNodes, e = H->numEdges;
+	const uint64_t sections[][2] = { { H->nodesOffset, n
+			* sizeof(DepGraphFileNode) }, { H->succOffsetsOffset, (n + 1) * 4 },
+			{ H->succEdgesOffset, e * 4 }, { H->predOffsetsOffset, (n + 1) * 4 },
+			{ H->predEdgesOffset, e * 4 }, { H->stringsOffset, H->stringsSize } };
+	for (unsigned i = 0; i < sizeof(sections) / sizeof(sections[0]); ++i)
+		if (sections[i][0] % 8 || sections[i][0] > size || sections[i][1]
+				> size - sections[i][0])
+			return false;
+
+	if (H->stringsSize == 0 || getString(H->stringsSize - 1)[0] != '\0')
+		return false;
+	if (!validOffsets(succOffsets(), e) || !validOffsets(predOffsets(), e))
+		return false;
+
+	for (uint64_t i = 0; i < e; ++i)
+		if (edgeNode(succEdges()[i]) >= n || edgeNode(predEdges()[i]) >= n)
+			return false;
+
+	for (uint64_t i = 0; i < n; ++i) {
+		const DepGraphFileNode& node = nodes()[i];
+		if (node.label >= H->stringsSize || node.function >= H->stringsSize
+				|| node.file >= H->stringsSize)
+			return false;
+	}
+	return H->module < H->stringsSize;
+}
+
+inline bool DepGraphFile::hasEdge(unsigned src, unsigned dst) const {
+	//The successors are sorted by node
+	const uint32_t* lo = succBegin(src);
+	const uint32_t* hi = succEnd(src);
+	while (lo < hi) {
+		const uint32_t* mid = lo + (hi - lo) / 2;
+		if (edgeNode(*mid) < dst)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo != succEnd(src) && edgeNode(*lo) == dst;
+}
+
+inline std::vector<unsigned> DepGraphFile::findNodes(const char* label) const {
+	std::vector<unsigned> result;
+	for (unsigned i = 0; i < getNumNodes(); ++i)
+		if (strcmp(getLabel(i), label) == 0)
+			result.push_back(i);
+	return result;
+}
+
+inline std::vector<unsigned> DepGraphFile::getDepNodes(
+		const std::vector<unsigned>& sources, bool forward) const {
+	std::vector<bool> visited(getNumNodes(), false);
+	std::vector<unsigned> result;
+
+	for (unsigned i = 0; i < sources.size(); ++i)
+		if (sources[i] < getNumNodes() && !visited[sources[i]]) {
+			visited[sources[i]] = true;
+			result.push_back(sources[i]);
+		}
+
+	//result doubles as the worklist of the breadth first search
+	for (unsigned i = 0; i < result.size(); ++i) {
+		unsigned node = result[i];
+		const uint32_t* it = forward ? succBegin(node) : predBegin(node);
+		const uint32_t* end = forward ? succEnd(node) : predEnd(node);
+		for (; it != end; ++it)
+			if (!visited[edgeNode(*it)]) {
+				visited[edgeNode(*it)] = true;
+				result.push_back(edgeNode(*it));
+			}
+	}
+	return result;
+}
+
+#endif //DEPGRAPH_FILE_H_
@@ -6,29 +6,17 @@ InputDep::InputDep() :
 	ModulePass(ID) {
 }
 
-//TODO: Verify signature
-
 /*
- * Main args are always input
- * Functions currently considered as input functions:
- * scanf
- * fscanf
- * gets
- * fgets
- * fread
- * fgetc
- * getc
- * getchar
- * recv
- * recvmsg
- * read
- * recvfrom
- * fread
+ * Main args are always input. The other input values are those the input
+ * spec (see InputSpec.h) gives for the calls of its sources: by default,
+ * what scanf, fscanf, gets, fgets, fread, getwd, getcwd, fgetc, getc,
+ * getchar, recv, recvmsg, read and recvfrom read into, and the globals it
+ * names. The spec is looked up once per function, and only the call sites
+ * of the sources are visited.
  */
 bool InputDep::runOnModule(Module &M) {
 	//	DEBUG (errs() << "Function " << F.getName() << "\n";);
 	NumInputValues = 0;
-	bool inserted;
 	Function* main = M.getFunction("main");
 	if (main) {
 		MDNode *mdn = main->begin()->begin()->getMetadata("dbg");
@@ -45,99 +33,49 @@ bool InputDep::runOnModule(Module &M) {
 
 
 	}
+
+	const InputSpec& spec = getInputSpec();
+	SmallVector<Value*, 8> values;
+	spec.getGlobals(M, values);
+	for (unsigned i = 0, e = values.size(); i != e; ++i)
+		if (inputDepValues.insert(values[i]).second)
+			NumInputValues++;
+
 	for (Module::iterator F = M.begin(), eM = M.end(); F != eM; ++F) {
-		for (Function::iterator BB = F->begin(), e = F->end(); BB != e; ++BB) {
-			for (BasicBlock::iterator I = BB->begin(), ee = BB->end(); I != ee; ++I) {
-				if (CallInst *CI = dyn_cast<CallInst>(I)) {
-					Function *Callee = CI->getCalledFunction();
-					if (Callee) {
-						Value* V;
-						inserted = false;
-						StringRef Name = Callee->getName();
-						if (Name.equals("main")) {
-							errs() << "main\n";
-							V = CI->getArgOperand(1); //char* argv[]
-							inputDepValues.insert(V);
-							inserted = true;
-							//errs() << "Input    " << *V << "\n";
-						}
-						if (Name.equals("__isoc99_scanf") || Name.equals(
-								"scanf")) {
-							for (unsigned i = 1, eee = CI->getNumArgOperands(); i
-									!= eee; ++i) { // skip format string (i=1)
-								V = CI->getArgOperand(i);
-								if (V->getType()->isPointerTy()) {
-									inputDepValues.insert(V);
-									inserted = true;
-									//errs() << "Input    " << *V << "\n";
-								}
-							}
-						} else if (Name.equals("__isoc99_fscanf")
-								|| Name.equals("fscanf")) {
-							for (unsigned i = 2, eee = CI->getNumArgOperands(); i
-									!= eee; ++i) { // skip file pointer and format string (i=1)
-								V = CI->getArgOperand(i);
-								if (V->getType()->isPointerTy()) {
-									inputDepValues.insert(V);
-									inserted = true;
-									//errs() << "Input    " << *V << "\n";
-								}
-							}
-						} else if ((Name.equals("gets") || Name.equals("fgets")
-								|| Name.equals("fread"))
-								|| Name.equals("getwd")
-								|| Name.equals("getcwd")) {
-							V = CI->getArgOperand(0); //the first argument receives the input for these functions
-							if (V->getType()->isPointerTy()) {
-								inputDepValues.insert(V);
-								inserted = true;
-								//errs() << "Input    " << *V << "\n";
-							}
-						} else if ((Name.equals("fgetc") || Name.equals("getc")
-								|| Name.equals("getchar"))) {
-							inputDepValues.insert(CI);
-							inserted = true;
-							//errs() << "Input    " << *CI << "\n";
-						} else if (Name.equals("recv")
-								|| Name.equals("recvmsg")
-								|| Name.equals("read")) {
-							Value* V = CI->getArgOperand(1);
-							if (V->getType()->isPointerTy()) {
-								inputDepValues.insert(V);
-								inserted = true;
-								//errs() << "Input    " << *V << "\n";
-							}
-						} else if (Name.equals("recvfrom")) {
-							V = CI->getArgOperand(1);
-							if (V->getType()->isPointerTy()) {
-								inputDepValues.insert(V);
-								inserted = true;
-								//errs() << "Input    " << *V << "\n";
-							}
-							V = CI->getArgOperand(4);
-							if (V->getType()->isPointerTy()) {
-								inputDepValues.insert(V);
-								inserted = true;
-								//errs() << "Input    " << *V << "\n";
-							}
-						}
-						if (inserted) {
-							if (MDNode *mdn = I->getMetadata("dbg")) {
-								NumInputValues++;
-								DILocation Loc(mdn);
-								unsigned Line = Loc.getLineNumber();
-								lineNo[V] = Line;
-							}
-						}
-					}
-				}
+		const InputSpec::Entry* source = spec.lookup(F->getName());
+		bool isMain = F->getName().equals("main");
+		if (!isMain && !(source && source->isSource()))
+			continue;
+		for (Value::use_iterator U = F->use_begin(), eU = F->use_end(); U != eU; ++U) {
+			CallInst* CI = dyn_cast<CallInst>(*U);
+			if (!CI || CI->getCalledFunction() != F)
+				continue;
+			if (isMain) {
+				errs() << "main\n";
+				if (CI->getNumArgOperands() > 1)
+					insertInputDepValue(CI->getArgOperand(1), CI); //char* argv[]
+				continue;
 			}
+			values.clear();
+			spec.getSources(CI, *source, values);
+			for (unsigned i = 0, e = values.size(); i != e; ++i)
+				insertInputDepValue(values[i], CI);
 		}
 	}
 	DEBUG(printer());
 	return false;
 }
 
+void InputDep::insertInputDepValue(Value* V, Instruction* I) {
+	inputDepValues.insert(V);
+	if (MDNode *mdn = I->getMetadata("dbg")) {
+		NumInputValues++;
+		DILocation Loc(mdn);
+		unsigned Line = Loc.getLineNumber();
+		lineNo[V] = Line;
+	}
+}
+
 void InputDep::printer() {
 	errs() << "===Input dependant values:====\n";
 	for (std::set<Value*>::iterator i = inputDepValues.begin(), e =
@@ -2,22 +2,24 @@
 #define __INPUTDEP_H__
 
 #include "llvm/Pass.h"
-#include "llvm/Function.h"
-#include "llvm/BasicBlock.h"
-#include "llvm/Instruction.h"
-#include "llvm/User.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/User.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/DebugInfo.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/ilist.h"
-#include "llvm/Instructions.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/ADT/SmallPtrSet.h"
-#include "llvm/Metadata.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/PassAnalysisSupport.h"
-#include "llvm/Function.h"
+#include "llvm/IR/Function.h"
 #include "DepGraph.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CallSite.h"
+#include "../InputValues/InputSpec.h"
 #include<set>
 
 using namespace llvm;
@@ -28,6 +30,7 @@ class InputDep : public ModulePass {
 		std::set<Value*> inputDepValues;
 		std::map<Value*, int> lineNo;
 		bool runOnModule(Module &M);
+		void insertInputDepValue(Value* V, Instruction* I);
 	public:
 		static char ID; // Pass identification, replacement for typeid.
 		InputDep();
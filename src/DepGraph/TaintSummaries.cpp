@@ -0,0 +1,710 @@
+#define DEBUG_TYPE "taint-summaries"
+
+#include "TaintSummaries.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InstIterator.h"
+
+using namespace llvm;
+
+static cl::opt<std::string> summaryOut("taint-summary-out",
+		cl::desc("Write the summaries of the functions that other modules may "
+			"call to this file, for their depgraph-lib-models"),
+		cl::value_desc("filename"));
+
+STATISTIC(NumSummaries, "Number of function summaries");
+STATISTIC(NumSummaryPasses, "Number of times a function summary was computed");
+STATISTIC(NumTaintVisits, "Number of function visits to propagate taint");
+STATISTIC(NumTaintedCells, "Number of tainted memory cells");
+STATISTIC(NumChangedFunctions, "Number of functions summarized again after a change");
+
+void TaintSummaries::getAnalysisUsage(AnalysisUsage &AU) const {
+	if (USE_ALIAS_SETS)
+		AU.addRequired<AliasSets> ();
+
+	AU.setPreservesAll();
+}
+
+const TaintSummaries::Summary* TaintSummaries::getSummary(Function* F) const {
+	DenseMap<Function*, Summary>::const_iterator it = summaries.find(F);
+	return it == summaries.end() ? NULL : &it->second;
+}
+
+/*
+ * Changes when an instruction of F is added, removed, replaced or gets
+ * other operands. Addresses are hashed, not names: a value that is
+ * recreated in place is a new value for the graphs too.
+ */
+hash_code TaintSummaries::getFingerprint(Function* F) {
+	hash_code h = hash_value(F->arg_size());
+	for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+		h = hash_combine(h, &*I, I->getOpcode());
+		for (User::op_iterator O = I->op_begin(), OE = I->op_end(); O != OE; ++O)
+			h = hash_combine(h, O->get());
+	}
+	return h;
+}
+
+//The memory cell of a node, numbered the first time it is seen, or -1
+int TaintSummaries::getCell(GraphNode* node) {
+	unsigned cell = numCells;
+	if (MemNode* MN = dyn_cast<MemNode> (node)) {
+		std::pair<DenseMap<int, unsigned>::iterator, bool> it = aliasCells.insert(
+				std::make_pair(MN->getAliasSetId(), cell));
+		cell = it.first->second;
+	} else if (VarNode* VN = dyn_cast<VarNode> (node)) {
+		if (!isa<GlobalVariable> (VN->getValue()))
+			return -1;
+		std::pair<DenseMap<Value*, unsigned>::iterator, bool> it =
+				globalCells.insert(std::make_pair(VN->getValue(), cell));
+		cell = it.first->second;
+	} else
+		return -1;
+
+	if (cell == numCells) {
+		numCells++;
+		cellFunctions.resize(numCells);
+	}
+	return cell;
+}
+
+//The memory cell of a value, as the graphs give it, or -1
+int TaintSummaries::getCell(Value* V) const {
+	if (isa<GlobalVariable> (V)) {
+		DenseMap<Value*, unsigned>::const_iterator it = globalCells.find(V);
+		return it == globalCells.end() ? -1 : (int) it->second;
+	}
+	if (isa<Constant> (V) || !V->getType()->isPointerTy())
+		return -1;
+	DenseMap<int, unsigned>::const_iterator it = aliasCells.find(
+			USE_ALIAS_SETS ? AS->getValueSetKey(V) : 0);
+	return it == aliasCells.end() ? -1 : (int) it->second;
+}
+
+/*
+ * The dependence graph of F alone, as functionDepGraph builds it. The
+ * first time, which is while summarizing, the cells of F and the callers
+ * of the functions it calls are recorded.
+ */
+void TaintSummaries::buildGraph(Function* F, FunctionGraph& FG, bool record) {
+
+	FG.graph = new Graph(AS);
+	for (Function::iterator BBit = F->begin(), BBend = F->end(); BBit != BBend; ++BBit) {
+		for (BasicBlock::iterator Iit = BBit->begin(), Iend = BBit->end(); Iit
+				!= Iend; ++Iit) {
+			FG.graph->addInst(Iit);
+		}
+
+		if (ReturnInst* RI = dyn_cast<ReturnInst> (BBit->getTerminator()))
+			if (Value* RV = RI->getReturnValue())
+				if (GraphNode* node = FG.graph->addInst(RV))
+					FG.returns.insert(node);
+	}
+
+	SmallPtrSet<Function*, 8> callees;
+	for (Graph::iterator n = FG.graph->begin(), e = FG.graph->end(); n != e; ++n) {
+		int cell = getCell(*n);
+		if (cell >= 0) {
+			FG.cells[*n] = cell;
+			if (record)
+				cellFunctions[cell].push_back(F);
+		}
+
+		if (CallNode* CN = dyn_cast<CallNode> (*n)) {
+			Function* C = CN->getCalledFunction();
+			if (C && summaries.count(C)) {
+				FG.summarizedCalls[CN] = CN->getCallInst();
+				if (record && callees.insert(C))
+					callers[C].push_back(F);
+			}
+		}
+	}
+}
+
+//The arguments of CI whose node is node
+void TaintSummaries::getArgNodes(FunctionGraph& FG, CallInst* CI,
+		GraphNode* node, SmallVectorImpl<unsigned>& args) {
+	for (unsigned k = 0, e = CI->getNumArgOperands(); k != e; ++k)
+		if (FG.graph->findNode(CI->getArgOperand(k)) == node)
+			args.push_back(k);
+}
+
+/*
+ * Follows the flows of each parameter of F through its graph. The search
+ * stops at memory cells, which belong to the whole module, and goes
+ * through a summarized call only as far as the summary of the callee lets
+ * it. Returns whether the summary of F grew.
+ */
+bool TaintSummaries::computeSummary(Function* F, FunctionGraph& FG) {
+
+	Summary& S = summaries[F];
+	bool changed = false;
+	NumSummaryPasses++;
+
+	unsigned j = 0;
+	for (Function::arg_iterator A = F->arg_begin(), E = F->arg_end(); A != E; ++A, ++j) {
+
+		GraphNode* start = FG.graph->findNode(A);
+		if (!start)
+			continue;
+
+		DenseSet<GraphNode*> visited;
+		SmallVector<GraphNode*, 32> stack;
+		SmallVector<unsigned, 8> cells(S.paramCells[j].begin(),
+				S.paramCells[j].end());
+		bool ret = false;
+
+		visited.insert(start);
+		stack.push_back(start);
+		while (!stack.empty()) {
+			GraphNode* n = stack.pop_back_val();
+
+			if (FG.returns.count(n))
+				ret = true;
+
+			DenseMap<GraphNode*, unsigned>::iterator cell = FG.cells.find(n);
+			if (cell != FG.cells.end()) {
+				cells.push_back(cell->second);
+				continue;
+			}
+
+			GraphNode::edge_range succs = n->outEdges();
+			for (GraphNode::edge_iterator s = succs.begin(), s_end = succs.end(); s
+					!= s_end; ++s) {
+
+				DenseMap<GraphNode*, CallInst*>::iterator call =
+						FG.summarizedCalls.find(*s);
+				if (call == FG.summarizedCalls.end()) {
+					if (visited.insert(*s).second)
+						stack.push_back(*s);
+					continue;
+				}
+
+				const Summary* CS = getSummary(call->second->getCalledFunction());
+				SmallVector<unsigned, 2> args;
+				getArgNodes(FG, call->second, n, args);
+				for (unsigned i = 0; i < args.size(); ++i) {
+					unsigned k = args[i];
+					if (k >= CS->paramCells.size())
+						continue;
+					cells.append(CS->paramCells[k].begin(), CS->paramCells[k].end());
+					if (CS->retParams.test(k)) {
+						GraphNode* result = FG.graph->findNode(call->second);
+						if (result && visited.insert(result).second)
+							stack.push_back(result);
+					}
+				}
+			}
+		}
+
+		std::sort(cells.begin(), cells.end());
+		cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+		if (cells.size() != S.paramCells[j].size()) {
+			S.paramCells[j].assign(cells.begin(), cells.end());
+			changed = true;
+		}
+		if (ret && !S.retParams.test(j)) {
+			S.retParams.set(j);
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+bool TaintSummaries::runOnModule(Module &M) {
+
+	if (USE_ALIAS_SETS)
+		AS = &(getAnalysis<AliasSets> ());
+
+	//The functions whose calls are summarized: those with a body and a
+	//fixed number of parameters, as moduleDepGraph matches them
+	std::vector<Function*> functions;
+	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
+		if (Fit->isDeclaration() || Fit->isVarArg())
+			continue;
+		Summary& S = summaries[Fit];
+		S.retParams.resize(Fit->arg_size());
+		S.paramCells.resize(Fit->arg_size());
+		fingerprints[Fit] = getFingerprint(Fit);
+		functions.push_back(Fit);
+	}
+	NumSummaries = functions.size();
+
+	DenseMap<Function*, std::vector<Function*> > callees;
+	for (unsigned i = 0; i < functions.size(); ++i) {
+		std::vector<Function*>& calls = callees[functions[i]];
+		for (inst_iterator I = inst_begin(functions[i]), E = inst_end(functions[i]); I
+				!= E; ++I)
+			if (CallInst* CI = dyn_cast<CallInst> (&*I))
+				if (Function* C = CI->getCalledFunction())
+					if (summaries.count(C) && std::find(calls.begin(),
+							calls.end(), C) == calls.end())
+						calls.push_back(C);
+	}
+
+	/*
+	 * Tarjan's algorithm gives the strongly connected components of the
+	 * call graph callees first, so the summaries of the functions a
+	 * component calls are final when it is summarized.
+	 */
+	DenseMap<Function*, unsigned> order, low;
+	DenseSet<Function*> onStack;
+	std::vector<Function*> sccStack;
+	unsigned counter = 0;
+
+	for (unsigned r = 0; r < functions.size(); ++r) {
+		if (order.count(functions[r]))
+			continue;
+
+		std::vector<std::pair<Function*, unsigned> > dfs;
+		order[functions[r]] = low[functions[r]] = counter++;
+		sccStack.push_back(functions[r]);
+		onStack.insert(functions[r]);
+		dfs.push_back(std::make_pair(functions[r], 0u));
+
+		while (!dfs.empty()) {
+			Function* F = dfs.back().first;
+			std::vector<Function*>& calls = callees[F];
+
+			if (dfs.back().second < calls.size()) {
+				Function* C = calls[dfs.back().second++];
+				if (!order.count(C)) {
+					order[C] = low[C] = counter++;
+					sccStack.push_back(C);
+					onStack.insert(C);
+					dfs.push_back(std::make_pair(C, 0u));
+				} else if (onStack.count(C))
+					low[F] = std::min(low[F], order[C]);
+				continue;
+			}
+
+			dfs.pop_back();
+			if (!dfs.empty())
+				low[dfs.back().first] = std::min(low[dfs.back().first], low[F]);
+			if (low[F] != order[F])
+				continue;
+
+			std::vector<Function*> scc;
+			Function* member;
+			do {
+				member = sccStack.back();
+				sccStack.pop_back();
+				onStack.erase(member);
+				scc.push_back(member);
+			} while (member != F);
+
+			//A component without recursion is summarized in one pass
+			bool recursive = scc.size() > 1 || std::find(calls.begin(),
+					calls.end(), F) != calls.end();
+			std::vector<FunctionGraph> graphs(scc.size());
+			for (unsigned i = 0; i < scc.size(); ++i)
+				buildGraph(scc[i], graphs[i], true);
+
+			bool changed = true;
+			while (changed) {
+				changed = false;
+				for (unsigned i = 0; i < scc.size(); ++i)
+					if (computeSummary(scc[i], graphs[i]))
+						changed = true;
+				if (!recursive)
+					break;
+			}
+
+			for (unsigned i = 0; i < scc.size(); ++i)
+				delete graphs[i].graph;
+		}
+	}
+
+	if (!summaryOut.empty())
+		writeSummaries(M, summaryOut);
+
+	//We don't modify anything, so we must return false
+	return false;
+}
+
+bool TaintSummaries::writeSummaries(Module& M, StringRef path) const {
+	std::string error;
+	raw_fd_ostream file(path.str().c_str(), error);
+	if (!error.empty()) {
+		errs() << "Error opening file " << path << ": " << error << "\n";
+		return false;
+	}
+
+	file << "# taint summaries of " << M.getModuleIdentifier() << "\n";
+	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
+		const Summary* S = getSummary(Fit);
+		if (!S || Fit->hasLocalLinkage())
+			continue;
+
+		//The cell of each pointer parameter, as a caller in another module
+		//sees it: the memory its argument points to
+		std::vector<int> argCells;
+		for (Function::arg_iterator A = Fit->arg_begin(), E = Fit->arg_end(); A
+				!= E; ++A)
+			argCells.push_back(A->getType()->isPointerTy() ? getCell(A) : -1);
+
+		file << Fit->getName();
+		for (unsigned j = 0; j < S->paramCells.size(); ++j) {
+			if (S->retParams.test(j))
+				file << " " << j << ">ret";
+			for (unsigned k = 0; k < argCells.size(); ++k)
+				if (argCells[k] >= 0 && std::binary_search(
+						S->paramCells[j].begin(), S->paramCells[j].end(),
+						(unsigned) argCells[k]))
+					file << " " << j << ">" << k;
+		}
+		file << "\n";
+	}
+	return true;
+}
+
+void TaintSummaries::enqueue(Function* F) {
+	if (queued.insert(F).second)
+		workList.push_back(F);
+}
+
+void TaintSummaries::runWorkList() {
+	while (!workList.empty()) {
+		Function* F = workList.back();
+		workList.pop_back();
+		queued.erase(F);
+		taintFunction(F);
+	}
+}
+
+void TaintSummaries::taintValue(Function* F, Value* V) {
+	if (tainted.insert(V).second && (isa<Instruction> (V) || isa<Argument> (V)))
+		taintedLocals[F].push_back(V);
+}
+
+void TaintSummaries::taintCell(unsigned cell) {
+	if (taintedCells.size() < numCells)
+		taintedCells.resize(numCells);
+	if (taintedCells.test(cell))
+		return;
+	taintedCells.set(cell);
+	NumTaintedCells++;
+	for (unsigned i = 0; i < cellFunctions[cell].size(); ++i)
+		enqueue(cellFunctions[cell][i]);
+}
+
+static Value* getNodeValue(GraphNode* node) {
+	if (OpNode* ON = dyn_cast<OpNode> (node))
+		return ON->getValue();
+	if (VarNode* VN = dyn_cast<VarNode> (node))
+		return VN->getValue();
+	return NULL;
+}
+
+/*
+ * Taints what the stack reaches in the graph of F. A summarized call
+ * taints the parameters of the callee its tainted arguments go to, and
+ * its result when the summary says they reach it. With independent, the
+ * search didn't start from the parameters of F, so a tainted return value
+ * is tainted at every call of F.
+ */
+void TaintSummaries::propagate(Function* F, FunctionGraph& FG,
+		SmallVectorImpl<GraphNode*>& stack, DenseSet<GraphNode*>& visited,
+		bool independent) {
+
+	while (!stack.empty()) {
+		GraphNode* n = stack.pop_back_val();
+
+		if (Value* V = getNodeValue(n))
+			taintValue(F, V);
+
+		if (independent && FG.returns.count(n) && taintedReturns.insert(F).second) {
+			std::vector<Function*>& calls = callers[F];
+			for (unsigned i = 0; i < calls.size(); ++i)
+				enqueue(calls[i]);
+		}
+
+		DenseMap<GraphNode*, unsigned>::iterator cell = FG.cells.find(n);
+		if (cell != FG.cells.end())
+			taintCell(cell->second);
+
+		GraphNode::edge_range succs = n->outEdges();
+		for (GraphNode::edge_iterator s = succs.begin(), s_end = succs.end(); s
+				!= s_end; ++s) {
+
+			DenseMap<GraphNode*, CallInst*>::iterator call =
+					FG.summarizedCalls.find(*s);
+			if (call == FG.summarizedCalls.end()) {
+				if (visited.insert(*s).second)
+					stack.push_back(*s);
+				continue;
+			}
+
+			Function* C = call->second->getCalledFunction();
+			const Summary* CS = getSummary(C);
+			SmallVector<unsigned, 2> args;
+			getArgNodes(FG, call->second, n, args);
+			for (unsigned i = 0; i < args.size(); ++i) {
+				unsigned k = args[i];
+				if (k >= CS->paramCells.size())
+					continue;
+
+				BitVector& params = taintedParams[C];
+				if (params.size() < C->arg_size())
+					params.resize(C->arg_size());
+				if (!params.test(k)) {
+					params.set(k);
+					enqueue(C);
+				}
+
+				for (unsigned c = 0; c < CS->paramCells[k].size(); ++c)
+					taintCell(CS->paramCells[k][c]);
+
+				if (CS->retParams.test(k)) {
+					GraphNode* result = FG.graph->findNode(call->second);
+					if (result && visited.insert(result).second)
+						stack.push_back(result);
+				}
+			}
+		}
+	}
+}
+
+/*
+ * Visits F again: first from what is tainted whatever its parameters are
+ * (its sources, the tainted cells it uses and the tainted results of its
+ * calls), then from its tainted parameters.
+ */
+void TaintSummaries::taintFunction(Function* F) {
+
+	NumTaintVisits++;
+	FunctionGraph FG;
+	buildGraph(F, FG, false);
+
+	DenseSet<GraphNode*> visited;
+	SmallVector<GraphNode*, 32> stack;
+
+	std::vector<Value*>& sources = functionSources[F];
+	for (unsigned i = 0; i < sources.size(); ++i) {
+		taintValue(F, sources[i]);
+		GraphNode* n = FG.graph->findNode(sources[i]);
+		if (n && visited.insert(n).second)
+			stack.push_back(n);
+	}
+
+	if (taintedCells.size() < numCells)
+		taintedCells.resize(numCells);
+	for (DenseMap<GraphNode*, unsigned>::iterator c = FG.cells.begin(), e =
+			FG.cells.end(); c != e; ++c)
+		if (taintedCells.test(c->second) && visited.insert(c->first).second)
+			stack.push_back(c->first);
+
+	for (DenseMap<GraphNode*, CallInst*>::iterator c =
+			FG.summarizedCalls.begin(), e = FG.summarizedCalls.end(); c != e; ++c) {
+		if (!taintedReturns.count(c->second->getCalledFunction()))
+			continue;
+		GraphNode* result = FG.graph->findNode(c->second);
+		if (result && visited.insert(result).second)
+			stack.push_back(result);
+	}
+
+	propagate(F, FG, stack, visited, true);
+
+	DenseMap<Function*, BitVector>::iterator params = taintedParams.find(F);
+	if (params != taintedParams.end()) {
+		unsigned j = 0;
+		for (Function::arg_iterator A = F->arg_begin(), E = F->arg_end(); A
+				!= E; ++A, ++j) {
+			if (j >= params->second.size() || !params->second.test(j))
+				continue;
+			taintValue(F, A);
+			GraphNode* n = FG.graph->findNode(A);
+			if (n && visited.insert(n).second)
+				stack.push_back(n);
+		}
+		propagate(F, FG, stack, visited, false);
+	}
+
+	delete FG.graph;
+}
+
+void TaintSummaries::taint(const std::set<Value*>& sources) {
+
+	for (std::set<Value*>::const_iterator i = sources.begin(), e =
+			sources.end(); i != e; ++i) {
+		Function* F = NULL;
+		if (Instruction* I = dyn_cast<Instruction> (*i))
+			F = I->getParent()->getParent();
+		else if (Argument* A = dyn_cast<Argument> (*i))
+			F = A->getParent();
+
+		if (F) {
+			//Already propagated, by an earlier call
+			if (tainted.count(*i))
+				continue;
+			functionSources[F].push_back(*i);
+			enqueue(F);
+			continue;
+		}
+
+		int cell = getCell(*i);
+		if (cell >= 0)
+			taintCell(cell);
+		else
+			tainted.insert(*i);
+	}
+
+	runWorkList();
+}
+
+/*
+ * Drops what refers to the graph of F. F may have been deleted, so only
+ * its address is used. What its callers passed to it, and whether its
+ * return value was tainted, stay while F is in the module.
+ */
+void TaintSummaries::forget(Function* F, bool removed) {
+	for (DenseMap<Function*, std::vector<Function*> >::iterator c =
+			callers.begin(), e = callers.end(); c != e; ++c)
+		c->second.erase(std::remove(c->second.begin(), c->second.end(), F),
+				c->second.end());
+	for (unsigned i = 0; i < cellFunctions.size(); ++i)
+		cellFunctions[i].erase(std::remove(cellFunctions[i].begin(),
+				cellFunctions[i].end(), F), cellFunctions[i].end());
+
+	DenseMap<Function*, std::vector<Value*> >::iterator locals =
+			taintedLocals.find(F);
+	if (locals != taintedLocals.end()) {
+		for (unsigned i = 0; i < locals->second.size(); ++i)
+			tainted.erase(locals->second[i]);
+		taintedLocals.erase(locals);
+	}
+	functionSources.erase(F);
+
+	if (removed) {
+		summaries.erase(F);
+		callers.erase(F);
+		taintedParams.erase(F);
+		taintedReturns.erase(F);
+		fingerprints.erase(F);
+	}
+}
+
+unsigned TaintSummaries::update(Module& M) {
+
+	SmallPtrSet<Function*, 32> live;
+	std::vector<Function*> changed;
+	for (Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; ++Fit) {
+		if (Fit->isDeclaration() || Fit->isVarArg())
+			continue;
+		live.insert(Fit);
+		hash_code h = getFingerprint(Fit);
+		DenseMap<Function*, hash_code>::iterator it = fingerprints.find(Fit);
+		if (it != fingerprints.end() && it->second == h)
+			continue;
+		fingerprints[Fit] = h;
+		changed.push_back(Fit);
+	}
+
+	std::vector<Function*> removed;
+	for (DenseMap<Function*, hash_code>::iterator it = fingerprints.begin(), e =
+			fingerprints.end(); it != e; ++it)
+		if (!live.count(it->first))
+			removed.push_back(it->first);
+	for (unsigned i = 0; i < removed.size(); ++i)
+		forget(removed[i], true);
+
+	if (changed.empty())
+		return 0;
+
+	//Every changed function gets an empty summary before any is computed,
+	//so that the calls between them are summarized calls
+	DenseSet<Function*> unrecorded;
+	for (unsigned i = 0; i < changed.size(); ++i) {
+		Function* F = changed[i];
+		forget(F, false);
+		Summary& S = summaries[F];
+		S.retParams.clear();
+		S.retParams.resize(F->arg_size());
+		S.paramCells.assign(F->arg_size(), SmallVector<unsigned, 4>());
+		unrecorded.insert(F);
+		enqueue(F);
+	}
+	NumSummaries = summaries.size();
+	NumChangedFunctions += changed.size();
+
+	/*
+	 * The summaries of the other functions are left as they are, so they
+	 * only grow from here and a work list reaches the fixpoint, recursive
+	 * cycles included. A caller whose callee's summary grew is summarized
+	 * and visited again.
+	 */
+	std::vector<Function*> pending(changed.rbegin(), changed.rend());
+	DenseSet<Function*> inPending;
+	for (unsigned i = 0; i < changed.size(); ++i)
+		inPending.insert(changed[i]);
+	while (!pending.empty()) {
+		Function* F = pending.back();
+		pending.pop_back();
+		inPending.erase(F);
+
+		FunctionGraph FG;
+		buildGraph(F, FG, unrecorded.erase(F));
+		bool grew = computeSummary(F, FG);
+		delete FG.graph;
+		if (!grew)
+			continue;
+
+		std::vector<Function*>& calls = callers[F];
+		for (unsigned i = 0; i < calls.size(); ++i) {
+			enqueue(calls[i]);
+			if (inPending.insert(calls[i]).second)
+				pending.push_back(calls[i]);
+		}
+	}
+
+	runWorkList();
+	return changed.size();
+}
+
+bool TaintSummaries::isTainted(Value* V) const {
+	int cell = getCell(V);
+	if (cell >= 0)
+		return (unsigned) cell < taintedCells.size() && taintedCells.test(cell);
+	return tainted.count(V);
+}
+
+void TaintSummaries::print(raw_ostream &OS, const Module *M) const {
+	if (!M)
+		return;
+	for (Module::const_iterator Fit = M->begin(), Fend = M->end(); Fit != Fend; ++Fit) {
+		const Summary* S = getSummary(const_cast<Function*> (&*Fit));
+		if (!S)
+			continue;
+		OS << Fit->getName() << ":";
+		for (unsigned j = 0; j < S->paramCells.size(); ++j) {
+			OS << " " << j << "->{";
+			if (S->retParams.test(j))
+				OS << "ret";
+			for (unsigned c = 0; c < S->paramCells[j].size(); ++c)
+				OS << ((c || S->retParams.test(j)) ? "," : "") << "cell "
+						<< S->paramCells[j][c];
+			OS << "}";
+		}
+		OS << "\n";
+	}
+}
+
+void TaintSummaries::releaseMemory() {
+	summaries.clear();
+	callers.clear();
+	aliasCells.clear();
+	globalCells.clear();
+	numCells = 0;
+	cellFunctions.clear();
+	tainted.clear();
+	taintedCells.clear();
+	taintedParams.clear();
+	taintedReturns.clear();
+	functionSources.clear();
+	taintedLocals.clear();
+	fingerprints.clear();
+}
+
+char TaintSummaries::ID = 0;
+static RegisterPass<TaintSummaries> X("taint-summaries",
+		"Summary-based interprocedural tainted flow");
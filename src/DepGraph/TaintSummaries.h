@@ -0,0 +1,159 @@
+#ifndef TAINTSUMMARIES_H_
+#define TAINTSUMMARIES_H_
+
+#include "DepGraph.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include <set>
+#include <vector>
+
+namespace llvm {
+
+/*
+ * Class TaintSummaries
+ *
+ * Interprocedural tainted flow without the module dependence graph. Each
+ * function with a body gets, once, a summary of the flows of its own
+ * dependence graph: which parameters reach its return value and which
+ * memory cells each parameter reaches. A memory cell is an alias set or a
+ * global variable; cells are shared by the whole module, as in the module
+ * graph. Summaries are computed bottom up on the call graph, iterating on
+ * the recursive cycles, and a call to a summarized function only carries
+ * the flows of its summary: the value returned at one call site doesn't
+ * depend on the arguments of the others.
+ *
+ * taint() then propagates sources function by function, from the tainted
+ * parameters, cells and call results of each one, until nothing changes.
+ * The graph of a function is built when the function is visited and freed
+ * right after, so memory holds one function graph at a time, the
+ * summaries and the tainted values. Calls to declarations and indirect
+ * calls keep the conservative flow of the function graph, from every
+ * operand to the result. Only data edges are followed.
+ *
+ * A fingerprint of each function is recorded with its summary, so that a
+ * later stage of the pipeline, after a transform that preserves this pass
+ * and AliasSets, can call update() to summarize and visit again only the
+ * functions that changed, and the callers that their new summaries affect.
+ *
+ * The modules of a program can also be analyzed apart, and at the same
+ * time: -taint-summary-out writes the summaries of the functions of each
+ * one, and the module graph of the others reads them back as library
+ * models, with -depgraph-lib-models, as -ra-summary-out and -ra-summary-in
+ * do for the range analysis.
+ */
+class TaintSummaries: public ModulePass {
+public:
+	static char ID; // Pass identification, replacement for typeid.
+	TaintSummaries() :
+		ModulePass(ID), AS(NULL), numCells(0) {
+	}
+	void getAnalysisUsage(AnalysisUsage &AU) const;
+	bool runOnModule(Module &M);
+	void releaseMemory();
+	void print(raw_ostream &OS, const Module *M) const;
+
+	struct Summary {
+		// The parameters that reach the return value
+		BitVector retParams;
+		// The memory cells that each parameter reaches, sorted
+		std::vector<SmallVector<unsigned, 4> > paramCells;
+	};
+
+	// The summary of F, or NULL if calls to F are not summarized
+	const Summary* getSummary(Function* F) const;
+
+	/*
+	 * Taints what sources reach, on top of what earlier calls tainted:
+	 * only the functions that the new sources change are visited again.
+	 */
+	void taint(const std::set<Value*>& sources);
+
+	/*
+	 * Brings the summaries and the taint up to date with M: functions whose
+	 * fingerprint changed are summarized and visited again, removed ones are
+	 * forgotten. The taint of the other functions is kept, so it only grows:
+	 * it may keep flows that the transform removed, but never misses one.
+	 * Returns the number of functions that changed.
+	 */
+	unsigned update(Module& M);
+
+	// Whether V is tainted. A pointer is tainted when its memory cell is.
+	bool isTainted(Value* V) const;
+
+	/*
+	 * Writes the summaries of the functions that other modules may call to
+	 * path, as a spec file of LibraryModels: the parameters that reach the
+	 * return value, and those that reach the memory of a pointer parameter.
+	 * Cells of global variables are left out; another module has cells of
+	 * its own. Returns false if path can't be written.
+	 */
+	bool writeSummaries(Module& M, StringRef path) const;
+
+	unsigned getNumTaintedValues() const {
+		return tainted.size();
+	}
+
+private:
+	AliasSets* AS;
+
+	DenseMap<Function*, Summary> summaries;
+	// The summarized functions that call each one
+	DenseMap<Function*, std::vector<Function*> > callers;
+
+	// The memory cells, numbered densely, and the functions whose graph
+	// reads or writes each of them
+	DenseMap<int, unsigned> aliasCells;
+	DenseMap<Value*, unsigned> globalCells;
+	unsigned numCells;
+	std::vector<std::vector<Function*> > cellFunctions;
+
+	// What taint() found so far
+	DenseSet<Value*> tainted;
+	BitVector taintedCells;
+	DenseMap<Function*, BitVector> taintedParams;
+	// Functions whose return value is tainted whatever their arguments
+	DenseSet<Function*> taintedReturns;
+	DenseMap<Function*, std::vector<Value*> > functionSources;
+	// The instructions and arguments of each function in tainted
+	DenseMap<Function*, std::vector<Value*> > taintedLocals;
+
+	// The fingerprint of each function, when it was last summarized
+	DenseMap<Function*, hash_code> fingerprints;
+	static hash_code getFingerprint(Function* F);
+	void forget(Function* F, bool removed);
+
+	// The graph of a function and what the propagation needs from it
+	struct FunctionGraph {
+		Graph* graph;
+		SmallPtrSet<GraphNode*, 8> returns;
+		// Memory cell of the nodes that are cells
+		DenseMap<GraphNode*, unsigned> cells;
+		// The calls of summarized functions, by node
+		DenseMap<GraphNode*, CallInst*> summarizedCalls;
+	};
+	void buildGraph(Function* F, FunctionGraph& FG, bool record);
+	int getCell(GraphNode* node);
+	int getCell(Value* V) const;
+	bool computeSummary(Function* F, FunctionGraph& FG);
+	void getArgNodes(FunctionGraph& FG, CallInst* CI, GraphNode* node,
+			SmallVectorImpl<unsigned>& args);
+
+	// State of one taint() run
+	std::vector<Function*> workList;
+	DenseSet<Function*> queued;
+	void enqueue(Function* F);
+	void runWorkList();
+	void taintValue(Function* F, Value* V);
+	void taintCell(unsigned cell);
+	void taintFunction(Function* F);
+	void propagate(Function* F, FunctionGraph& FG,
+			SmallVectorImpl<GraphNode*>& stack, DenseSet<GraphNode*>& visited,
+			bool independent);
+};
+
+}
+
+#endif /* TAINTSUMMARIES_H_ */
@@ -1,5 +1,5 @@
 /*
- * InputDeps.cpp
+ * ValueCounter.cpp
  *
  *  Created on: 05/04/2013
  *      Author: raphael
@@ -12,6 +12,13 @@
 using namespace llvm;
 
 STATISTIC(TotalValues, "Number of values (of all kinds)");
+STATISTIC(TotalInsts, "Number of instructions");
+STATISTIC(PointerOps, "Number of pointer operations");
+STATISTIC(IndirectCalls, "Number of indirect calls");
+STATISTIC(MaxFunctionSize, "Instructions of the largest function");
+STATISTIC(LargestSCC, "Functions of the largest call graph SCC");
+STATISTIC(EstPointsTo, "Estimated number of points-to constraints");
+STATISTIC(EstRange, "Estimated number of range constraints");
 
 void llvm::ValueCounter::getAnalysisUsage(AnalysisUsage& AU) const {
 
@@ -22,34 +29,61 @@ void llvm::ValueCounter::getAnalysisUsage(AnalysisUsage& AU) const {
 	AU.setPreservesAll();
 }
 
-bool llvm::ValueCounter::runOnModule(Module& M) {
-
+/*
+ * The instructions and their operands, fed by the same walk as the
+ * metrics of the module.
+ */
+namespace {
+class ValueCollector : public ModuleWalk::Client {
+public:
 	std::set<Value*> values;
 
-	for(Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; Fit++){
-
-		if (!values.count(Fit)) values.insert(Fit);
-
-		for(Function::arg_iterator Arg = Fit->arg_begin(), aEnd = Fit->arg_end(); Arg != aEnd; Arg++) {
-			if (!values.count(Arg)) values.insert(Arg);
-		}
-
-		for (Function::iterator BBit = Fit->begin(), BBend = Fit->end(); BBit != BBend; BBit++) {
+	void visit(Instruction& I) {
+		values.insert(&I);
+		for (unsigned int i = 0; i < I.getNumOperands(); i++)
+			values.insert(I.getOperand(i));
+	}
+};
+}
 
-			for (BasicBlock::iterator Iit = BBit->begin(), Iend = BBit->end(); Iit != Iend; Iit++) {
+bool llvm::ValueCounter::runOnModule(Module& M) {
 
-				if (!values.count(Iit)) values.insert(Iit);
+	ValueCollector collector;
+	std::set<Value*>& values = collector.values;
 
-				for(unsigned int i = 0; i < Iit->getNumOperands(); i++){
+	for(Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; Fit++){
 
-					if (!values.count(Iit->getOperand(i))) values.insert(Iit->getOperand(i));
+		values.insert(Fit);
 
-				}
-			}
+		for(Function::arg_iterator Arg = Fit->arg_begin(), aEnd = Fit->arg_end(); Arg != aEnd; Arg++) {
+			values.insert(Arg);
 		}
 	}
+
+	metrics = ModuleMetrics();
+	ModuleMetrics::Counter counter(metrics);
+	ModuleWalk walk;
+	walk.add(&collector);
+	walk.add(&counter);
+	walk.run(M);
+	counter.finish(M);
 	TotalValues = values.size();
 
+	TotalInsts = metrics.Instructions;
+	PointerOps = metrics.PointerOps;
+	IndirectCalls = metrics.IndirectCalls;
+	MaxFunctionSize = metrics.MaxFunctionSize;
+	LargestSCC = metrics.LargestSCC;
+	EstPointsTo = metrics.PointsToConstraints;
+	EstRange = metrics.RangeConstraints;
+
+	dbgs() << "================ MODULE METRICS ===============\n";
+	dbgs() << "==== # of values:                 " << values.size() << "\n";
+	metrics.print(dbgs());
+	if (metrics.isLarge())
+		dbgs() << "==== " << (metrics.isHuge() ? "huge" : "large")
+				<< " module: the analyses budget for it unless told otherwise\n";
+
 	//We don't modify anything, so we must return false;
 	return false;
 }
@@ -1,5 +1,5 @@
 /*
- * InputDeps.h
+ * ValueCounter.h
  *
  *  Created on: 05/04/2013
  *      Author: raphael
@@ -9,13 +9,15 @@
 #define VALUECOUNTER_H_
 
 #include "llvm/Pass.h"
-#include "llvm/Module.h"
+#include "llvm/IR/Module.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/CallSite.h"
+#include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
+#include "../PassProfile/ModuleMetrics.h"
 #include <set>
 #include <string>
 
@@ -23,6 +25,10 @@ using namespace std;
 
 namespace llvm {
 
+	/*
+	 * Counts the values of the module, and measures it with ModuleMetrics:
+	 * the numbers the expensive analyses pick their budgets from.
+	 */
         class ValueCounter : public ModulePass {
         public:
 			static char ID; // Pass identification, replacement for typeid.
@@ -30,6 +36,11 @@ namespace llvm {
 
 			void getAnalysisUsage(AnalysisUsage &AU) const;
 			bool runOnModule(Module& M);
+
+			const ModuleMetrics& getMetrics() const { return metrics; }
+
+        private:
+			ModuleMetrics metrics;
         };
 }
 
@@ -1,5 +1,7 @@
 #include "VulArrays.h"
 #define DEBUG_TYPE "vulArrays"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
 STATISTIC(NumFunc, "The number of functions");
 STATISTIC(NumFuncArr, "The number of functions that contain arrays");
 STATISTIC(NumArr, "The number of arrays");
@@ -9,8 +11,13 @@ STATISTIC(NumStores, "The number of store insts");
 STATISTIC(NumVulArraysAr, "The number of vulnerable contiguous arrays");
 STATISTIC(NumVulArraysSt, "The number of vulnerable arrays in structs");
 
+static cl::opt<std::string>
+		JSONOutput("vul-arrays-json",
+				cl::desc("Write the vulnerable arrays to this file as JSON Lines, while they are found, instead of keeping them for the .vul.dot graph ('-' for stdout)"),
+				cl::value_desc("file"), cl::init(""));
+
 VulArrays::VulArrays() :
-	ModulePass(ID) {
+	ModulePass(ID), jsonOut(NULL), inputPaths(NULL) {
 	NumFuncArr = 0;
 	NumArr = 0;
 	NumVulArrays = 0;
@@ -30,7 +37,7 @@ bool VulArrays::structHasArray(StructType* ST) {
 }
 
 DenseMap<const Value*, std::vector<GraphNode*> > VulArrays::getValueDeps(
-		Value* V, std::set<Value*> inputDepValues) {
+		Value* V, const std::set<Value*>& inputDepValues) {
 	DenseMap<const Value*, std::vector<GraphNode*> > result;
 
 	//Firstly, check if array or alias is passed as parameter to "any" lib function
@@ -63,42 +70,33 @@ DenseMap<const Value*, std::vector<GraphNode*> > VulArrays::getValueDeps(
 	}
 
 	//Secondly, check store operations targeting the array
-	std::map<GraphNode*, edgeType> pred = N->getPredecessors();
-	for (std::map<GraphNode*, edgeType>::iterator i = pred.begin(), endi =
-			pred.end(); i != endi; ++i) {
-		GraphNode* n = i->first;
+	GraphNode::edge_range pred = N->inEdges();
+	for (GraphNode::edge_iterator i = pred.begin(), endi = pred.end(); i
+			!= endi; ++i) {
+		GraphNode* n = *i;
 		if (OpNode* ON = dyn_cast<OpNode> (n)) {
 			if (ON->getOpCode() == Instruction::Store) {
 				//				errs() << "Store inst found before ";
 				//				errs() << *V << "\n";
-				std::map<GraphNode*, std::vector<GraphNode*> > dep =
-						depGraph->getEveryDependency(V, inputDepValues, false);
-				if (dep.begin() != dep.end()) {
+				if (inputPaths->hasDependency(V)) {
 					//					errs() << "Dep found\n";
 					// Get debug info
 					if (ON->getValue() != NULL) {
 						if (Instruction* I = dyn_cast<Instruction>(ON->getValue())) {
-							if (MDNode *mdn = I->getMetadata("dbg")) {
-								DILocation Loc(mdn); // DILocation is in DebugInfo.h
-								unsigned Line = Loc.getLineNumber();
-								StringRef File = Loc.getFilename();
-								debugInfo[std::make_pair<GraphNode*, GraphNode*>(
-										n, N)] = std::make_pair<unsigned,
-										std::string>(Line, File.str());
-							}
+							SourceLoc loc = getLoc(I);
+							if (loc.file)
+								debugInfo[std::make_pair(n, N)] = loc;
 						}
 					}
-					for (std::map<GraphNode*, std::vector<GraphNode*> >::iterator
-							ii = dep.begin(), ee = dep.end(); ii != ee; ++ii) {
-						if (VarNode * VN = dyn_cast<VarNode> (ii->first)) {
-							result[VN->getValue()] = ii->second;
-						} else if (MemNode * MN = dyn_cast<MemNode> (ii->first)) {
-							std::set<Value*>::iterator i =
-									MN->getAliases().begin(); //get alias 0 as representative
-							result[*i] = ii->second;
-						}
-						DEBUG(errs() << "[VulArrays]  Error: not a MemNode nor a VarNode\n");
+					GraphNode* source = inputPaths->getSource(V);
+					if (VarNode * VN = dyn_cast<VarNode> (source)) {
+						result[VN->getValue()] = inputPaths->getPath(V);
+					} else if (MemNode * MN = dyn_cast<MemNode> (source)) {
+						std::set<Value*>::iterator i =
+								MN->getAliases().begin(); //get alias 0 as representative
+						result[*i] = inputPaths->getPath(V);
 					}
+					DEBUG(errs() << "[VulArrays]  Error: not a MemNode nor a VarNode\n");
 				}
 			}
 		}
@@ -107,7 +105,7 @@ DenseMap<const Value*, std::vector<GraphNode*> > VulArrays::getValueDeps(
 	return result;
 }
 
-const Value* VulArrays::isValueInpDep(Value* V, std::set<Value*> inputDepValues) {
+const Value* VulArrays::isValueInpDep(Value* V, const std::set<Value*>& inputDepValues) {
 	//Firstly, check if array or alias is passed as parameter to "any" lib function
 	std::set<Value*> alias;
 	static DenseMap<GraphNode*, const Value*> isDep; // to avoid repeated computation
@@ -130,20 +128,18 @@ const Value* VulArrays::isValueInpDep(Value* V, std::set<Value*> inputDepValues)
 	}
 
 	//Secondly, check store operations targeting the array
-	std::map<GraphNode*, edgeType> pred = N->getPredecessors();
-	for (std::map<GraphNode*, edgeType>::iterator i = pred.begin(), endi =
-			pred.end(); i != endi; ++i) {
-		GraphNode* n = i->first;
+	GraphNode::edge_range pred = N->inEdges();
+	for (GraphNode::edge_iterator i = pred.begin(), endi = pred.end(); i
+			!= endi; ++i) {
+		GraphNode* n = *i;
 		if (OpNode* ON = dyn_cast<OpNode> (n)) {
 			if (ON->getOpCode() == Instruction::Store) {
-				std::pair<GraphNode*, int> dep =
-						depGraph->getNearestDependency(ON->getValue(),
-								inputDepValues, false);
-				if (dep.first != NULL) {
-					if (VarNode * VN = dyn_cast<VarNode> (dep.first)) {
+				GraphNode* source = inputPaths->getSource(ON->getValue());
+				if (source != NULL) {
+					if (VarNode * VN = dyn_cast<VarNode> (source)) {
 						isDep[N] = VN->getValue();
 						return VN->getValue();
-					} else if (MemNode * MN = dyn_cast<MemNode> (dep.first)) {
+					} else if (MemNode * MN = dyn_cast<MemNode> (source)) {
 						std::set<Value*>::iterator i = MN->getAliases().begin();
 						isDep[N] = *i; //get alias 0 as representative
 						return *i;
@@ -167,6 +163,18 @@ bool VulArrays::runOnModule(Module &M) {
 	depGraph = AS.getModifiedGraph();
 	DenseMap<Function*, bool> funcHasArray;
 	std::set<Value*> inputDepValues = IV.getInputDepValues();
+	std::string ErrorInfo;
+	if (!JSONOutput.empty()) {
+		jsonOut = new raw_fd_ostream(JSONOutput.c_str(), ErrorInfo);
+		if (!ErrorInfo.empty()) {
+			errs() << "[VulArrays]  " << ErrorInfo << "\n";
+			delete jsonOut;
+			jsonOut = NULL;
+		}
+	}
+	// One search from every input gives the nearest input of all arrays
+	inputPaths = new Graph::DependencyPaths(
+			depGraph->getDependencyPaths(inputDepValues, false));
 	for (Module::iterator F = M.begin(), endF = M.end(); F != endF; ++F) {
 		std::set<Value*> arrays;
 		for (Function::iterator BB = F->begin(), endBB = F->end(); BB != endBB; ++BB) {
@@ -212,7 +220,7 @@ bool VulArrays::runOnModule(Module &M) {
 									if (m.begin() != m.end()) {
 										//										depStructs1[F].insert(
 										//												std::make_pair(AI, v));
-										Structs1[depGraph->findNode(AI)] = m;
+										report(Structs1, "struct", F, AI, m);
 										NumVulArrays++;
 										NumVulArraysSt++;
 									}
@@ -228,8 +236,8 @@ bool VulArrays::runOnModule(Module &M) {
 										m = getValueDeps(BC->getOperand(0),
 												inputDepValues);
 								if (m.begin() != m.end()) {
-									Structs2[depGraph->findNode(
-											BC->getOperand(0))] = m;
+									report(Structs2, "struct-cast", F,
+											BC->getOperand(0), m);
 								}
 							}
 						}
@@ -245,7 +253,7 @@ bool VulArrays::runOnModule(Module &M) {
 						getValueDeps(*i, inputDepValues);
 				if (m.begin() != m.end()) {
 					dep = true;
-					Arrays[depGraph->findNode(*i)] = m;
+					report(Arrays, "array", F, *i, m);
 				}
 			}
 		}
@@ -254,6 +262,17 @@ bool VulArrays::runOnModule(Module &M) {
 			NumVulArraysAr += arrays.size() - 1;
 			;
 		}
+		if (jsonOut)
+			jsonOut->flush(); // each function is complete, for readers of the stream
+	}
+	delete inputPaths;
+	inputPaths = NULL;
+	if (jsonOut) {
+		delete jsonOut;
+		jsonOut = NULL;
+		locs.clear();
+		debugInfo.clear();
+		return false;
 	}
 	toDot(M.getModuleIdentifier());
 	//	printStats();
@@ -261,12 +280,99 @@ bool VulArrays::runOnModule(Module &M) {
 	return false;
 }
 
+VulArrays::SourceLoc VulArrays::getLoc(const Value* V) {
+	DenseMap<const Value*, SourceLoc>::iterator it = locs.find(V);
+	if (it != locs.end())
+		return it->second;
+	SourceLoc loc = { NULL, 0 };
+	if (const Instruction* I = dyn_cast_or_null<Instruction>(V)) {
+		if (MDNode *mdn = I->getMetadata("dbg")) {
+			DILocation Loc(mdn); // DILocation is in DebugInfo.h
+			loc.file = files.GetOrCreateValue(Loc.getFilename()).getKeyData();
+			loc.line = Loc.getLineNumber();
+		}
+	}
+	locs[V] = loc;
+	return loc;
+}
+
+/*
+ * The results go to the JSON stream when there is one, so that nothing but
+ * the memoized dependencies stays in memory, and are kept for toDot
+ * otherwise.
+ */
+void VulArrays::report(DenseMap<GraphNode*, DenseMap<const Value*, std::vector<GraphNode*> > >& results,
+		const char* kind, Function* F, Value* V,
+		const DenseMap<const Value*, std::vector<GraphNode*> >& deps) {
+	if (jsonOut)
+		writeJSON(kind, F, V, deps);
+	else
+		results[depGraph->findNode(V)] = deps;
+}
+
+static void printJSONString(raw_ostream &OS, StringRef S) {
+	OS << '"';
+	for (size_t i = 0, n = S.size(); i != n; i++) {
+		unsigned char Ch = S[i];
+		if (Ch == '"' || Ch == '\\')
+			OS << '\\' << Ch;
+		else if (Ch < 0x20)
+			OS << "\\u00" << hexdigit(Ch >> 4) << hexdigit(Ch & 15);
+		else
+			OS << Ch;
+	}
+	OS << '"';
+}
+
+void VulArrays::writeJSONLoc(SourceLoc loc) {
+	if (!loc.file)
+		return;
+	*jsonOut << ",\"file\":";
+	printJSONString(*jsonOut, loc.file);
+	*jsonOut << ",\"line\":" << loc.line;
+}
+
+static const Value* getNodeValue(GraphNode* n) {
+	if (OpNode* ON = dyn_cast<OpNode> (n))
+		return ON->getValue();
+	if (VarNode* VN = dyn_cast<VarNode> (n))
+		return VN->getValue();
+	return NULL;
+}
+
+//One line per input the array depends on
+void VulArrays::writeJSON(const char* kind, Function* F, Value* V,
+		const DenseMap<const Value*, std::vector<GraphNode*> >& deps) {
+	GraphNode* N = depGraph->findNode(V);
+	for (DenseMap<const Value*, std::vector<GraphNode*> >::const_iterator i =
+			deps.begin(), e = deps.end(); i != e; ++i) {
+		raw_ostream &OS = *jsonOut;
+		OS << "{\"kind\":\"" << kind << "\",\"function\":";
+		printJSONString(OS, F->getName());
+		OS << ",\"array\":";
+		printJSONString(OS, N ? N->getLabel() : V->getName().str());
+		writeJSONLoc(getLoc(V));
+		OS << ",\"input\":";
+		printJSONString(OS, i->first->getName());
+		OS << ",\"distance\":" << (i->second.empty() ? 0 : i->second.size() - 1);
+		OS << ",\"path\":[";
+		for (unsigned j = 0; j < i->second.size(); j++) {
+			if (j)
+				OS << ",";
+			OS << "{\"node\":";
+			printJSONString(OS, i->second[j]->getLabel());
+			writeJSONLoc(getLoc(getNodeValue(i->second[j])));
+			OS << "}";
+		}
+		OS << "]}\n";
+	}
+}
+
 void VulArrays::toDot(std::string name) {
 	Graph::Guider* guider = new Graph::Guider(depGraph);
 	std::string ErrorInfo("");
 	std::string fileName = name + ".vul.dot";
 	std::string s;
-	std::ostringstream ss;
 	for (DenseMap<GraphNode*, DenseMap<const Value*, std::vector<GraphNode*> > >::iterator
 			i = Arrays.begin(), e = Arrays.end(); i != e; ++i) {
 		s = "[label=\"";
@@ -293,9 +399,9 @@ void VulArrays::toDot(std::string name) {
 				std::pair<GraphNode*, GraphNode*> uv = std::make_pair<
 						GraphNode*, GraphNode*>(u, v);
 				if (debugInfo.count(uv)) {
-					ss << debugInfo[uv].first;
-					s += " label=\"" + debugInfo[uv].second + ": line "
-							+ ss.str() + "\"";
+					SourceLoc loc = debugInfo[uv];
+					s += " label=\"" + std::string(loc.file) + ": line "
+							+ utostr(loc.line) + "\"";
 				}
 				s += "]";
 				guider->setEdgeAttrs(u, v, s);
@@ -330,9 +436,9 @@ void VulArrays::toDot(std::string name) {
 				std::pair<GraphNode*, GraphNode*> uv = std::make_pair<
 						GraphNode*, GraphNode*>(u, v);
 				if (debugInfo.count(uv)) {
-					ss << debugInfo[uv].first;
-					s += " label=\"" + debugInfo[uv].second + ": line "
-							+ ss.str() + "\"";
+					SourceLoc loc = debugInfo[uv];
+					s += " label=\"" + std::string(loc.file) + ": line "
+							+ utostr(loc.line) + "\"";
 				}
 				s += "]";
 				guider->setEdgeAttrs(u, v, s);
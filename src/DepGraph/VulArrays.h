@@ -2,26 +2,27 @@
 #define __VUL_ARRAYS_H__
 
 #include "llvm/Pass.h"
-#include "llvm/Function.h"
-#include "llvm/BasicBlock.h"
-#include "llvm/Instruction.h"
-#include "llvm/User.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/User.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/ilist.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
-#include "llvm/Instructions.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/ADT/SmallPtrSet.h"
-#include "llvm/Metadata.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/PassAnalysisSupport.h"
-#include "llvm/Function.h"
+#include "llvm/IR/Function.h"
 #include "llvm/DebugInfo.h"
 #include "DepGraph.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
 #include "DepGraph.h"
-#include "InputValues.h"
+#include "../InputValues/InputValues.h"
 #include "InputDep.h"
 #include "AddStore.h"
 #include<set>
@@ -40,12 +41,28 @@ class VulArrays : public ModulePass {
 		DenseMap<GraphNode*, DenseMap<const Value*, std::vector<GraphNode*> > > Arrays;
 		DenseMap<GraphNode*, DenseMap<const Value*, std::vector<GraphNode*> > > Structs1;
 		DenseMap<GraphNode*, DenseMap<const Value*, std::vector<GraphNode*> > > Structs2;
-		DenseMap<std::pair<GraphNode*, GraphNode*>, std::pair<unsigned, std::string> > debugInfo;
+		// A source line; the file names are interned in files
+		struct SourceLoc {
+			const char* file; // NULL without debug info
+			unsigned line;
+		};
+		DenseMap<std::pair<GraphNode*, GraphNode*>, SourceLoc> debugInfo;
+		DenseMap<const Value*, SourceLoc> locs; // resolved once per instruction
+		StringSet<> files;
+		SourceLoc getLoc(const Value* V);
 		Graph* depGraph;
+		raw_ostream* jsonOut; // -vul-arrays-json, while running
+		Graph::DependencyPaths* inputPaths; // from the input values, while running
 
-		const Value* isValueInpDep(Value* V, std::set<Value*> inputDepValues);
-		DenseMap<const Value*, std::vector<GraphNode*> > getValueDeps(Value* V, std::set<Value*> inputDepValues);
+		const Value* isValueInpDep(Value* V, const std::set<Value*>& inputDepValues);
+		DenseMap<const Value*, std::vector<GraphNode*> > getValueDeps(Value* V, const std::set<Value*>& inputDepValues);
 		void toDot(std::string name);
+		void report(DenseMap<GraphNode*, DenseMap<const Value*, std::vector<GraphNode*> > >& results,
+				const char* kind, Function* F, Value* V,
+				const DenseMap<const Value*, std::vector<GraphNode*> >& deps);
+		void writeJSON(const char* kind, Function* F, Value* V,
+				const DenseMap<const Value*, std::vector<GraphNode*> >& deps);
+		void writeJSONLoc(SourceLoc loc);
 //		void printStats();
 	public:
 		static char ID;
@@ -13,6 +13,11 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "LoopChecks.h"
+#include "SiteCounters.h"
+#include "SymbolicRangeAnalysis.h"
+#include "../PassProfile/PassProfile.h"
+
 #include "llvm/Transforms/Instrumentation.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
@@ -23,7 +28,12 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/Dominators.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/DIBuilder.h"
+#include "llvm/DebugInfo.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
@@ -38,7 +48,7 @@
 #include "llvm/Support/DataTypes.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Support/Debug.h"
-#include "llvm/Support/Endian.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/system_error.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -48,11 +58,16 @@
 #include "llvm/Transforms/Utils/ModuleUtils.h"
 #include <algorithm>
 #include <string>
+#include <vector>
 
 using namespace llvm;
 
 STATISTIC(Safe, "S");
 STATISTIC(NotSafe, "NS");
+STATISTIC(Hoisted, "H");
+STATISTIC(Coalesced, "C");
+STATISTIC(Sampled, "Sm");
+STATISTIC(Untainted, "U");
 
 static const uint64_t kDefaultShadowScale = 3;
 static const uint64_t kDefaultShadowOffset32 = 1ULL << 29;
@@ -85,15 +100,26 @@ static const char *kAsanGenPrefix = "__asan_gen_";
 static const char *kAsanPoisonStackMemoryName = "__asan_poison_stack_memory";
 static const char *kAsanUnpoisonStackMemoryName =
     "__asan_unpoison_stack_memory";
+static const char *kAsanRegionIsPoisonedName = "__asan_region_is_poisoned";
+static const char *kAsanSampleCounterName = "__ga_asan_sample_counter";
+static const char *kAsanDispatchFlagPrefix = "__ga_asan_enabled.";
+static const char *kAsanCheckCountName = "__ga_asan_checks_executed";
+static const char *kAsanCheckCountDtorName = "__ga_asan_print_check_count";
 
 static const int kAsanStackLeftRedzoneMagic = 0xf1;
 static const int kAsanStackMidRedzoneMagic = 0xf2;
 static const int kAsanStackRightRedzoneMagic = 0xf3;
 static const int kAsanStackPartialRedzoneMagic = 0xf4;
 
+// Frames whose redzones need more shadow stores are unpoisoned by memset.
+static const size_t kMaxStackShadowStores = 16;
+
 // Accesses sizes are powers of two: 1, 2, 4, 8, 16.
 static const size_t kNumberOfAccessSizes = 5;
 
+// Coalesced checks load at most this many shadow bytes at once.
+static const uint64_t kMaxCoalescedShadowBytes = 8;
+
 // Command-line flags.
 
 // This flag may need to be replaced with -f[no-]asan-reads.
@@ -109,6 +135,32 @@ static cl::opt<bool> ClAlwaysSlowPath("ga-asan-always-slow-path",
        cl::Hidden, cl::init(false));
 static cl::opt<bool> ClOptASI("ga-asan-asi",
        cl::desc("Optimize instrumentation with ASI"), cl::Hidden, cl::init(false));
+// For threat models where only the input is hostile: the accesses that
+// -tainted-annotate tags as untainted, whose addresses the input can't
+// influence, are not checked.
+static cl::opt<bool> ClTaint("ga-asan-taint",
+       cl::desc("Check only the accesses that the input may influence"),
+       cl::Hidden, cl::init(false));
+// Affine accesses in loops, base + i * stride, are checked once in the loop
+// preheader for the whole interval the symbolic range analysis gives to i.
+static cl::opt<bool> ClHoistLoopChecks("ga-asan-hoist-loop-checks",
+       cl::desc("Check affine accesses in loops once, in the preheader"),
+       cl::Hidden, cl::init(false));
+// With a block frequency profile (branch weights, e.g. from
+// -profile-metadata-loader), accesses in blocks that run at least
+// ga-asan-hot-freq times per call of their function are hot. Cold accesses
+// are all checked, ASI proofs notwithstanding; hot accesses rely on the
+// proofs, and those without one are checked once every ga-asan-sample-rate
+// times they run.
+static cl::opt<bool> ClProfile("ga-asan-profile",
+       cl::desc("Use the block frequencies to choose what to check"),
+       cl::Hidden, cl::init(false));
+static cl::opt<unsigned> ClHotFreq("ga-asan-hot-freq",
+       cl::desc("Runs per function call from which a block is hot"),
+       cl::Hidden, cl::init(64));
+static cl::opt<unsigned> ClSampleRate("ga-asan-sample-rate",
+       cl::desc("Check unproven hot accesses once in this many runs"),
+       cl::Hidden, cl::init(16));
 // This flag limits the number of instructions to be instrumented
 // in any given BB. Normally, this should be set to unlimited (INT_MAX),
 // but due to http://llvm.org/bugs/show_bug.cgi?id=12652 we temporary
@@ -135,6 +187,18 @@ static cl::opt<bool> ClRealignStack("ga-asan-realign-stack",
 static cl::opt<std::string> ClBlacklistFile("ga-asan-blacklist",
        cl::desc("File containing the list of objects to ignore "
                 "during instrumentation"), cl::Hidden);
+static cl::opt<std::string> ClCheckReport("ga-asan-check-report",
+       cl::desc("Write to this file, in JSON, why each access is checked "
+                "or not"), cl::Hidden);
+static cl::opt<std::string> ClSiteCounts("ga-asan-site-counts",
+       cl::desc("Count the executions of each access at run time, into "
+                "<file>.counts, and write its sites to this file (see "
+                "SiteCounters.h)"), cl::Hidden);
+// For benchmarks: the count is shared by the modules of the program, and
+// printed on stderr at exit.
+static cl::opt<bool> ClCountChecks("ga-asan-count-checks",
+       cl::desc("Count the checks executed at run time"),
+       cl::Hidden, cl::init(false));
 
 // This is an experimental feature that will allow to choose between
 // instrumented and non-instrumented code at link-time.
@@ -148,6 +212,17 @@ static cl::opt<std::string> ClBlacklistFile("ga-asan-blacklist",
 static cl::opt<bool> ClKeepUninstrumented("ga-asan-keep-uninstrumented-functions",
        cl::desc("Keep uninstrumented copies of functions"),
        cl::Hidden, cl::init(false));
+// With the uninstrumented copies, the choice can also be made at run-time:
+// the function becomes a stub that calls ASAN_<name> if the byte
+// __ga_asan_enabled.<name> is set, and NOASAN_<name> otherwise. The flags
+// start with the value of ClDispatchDefault and may be flipped by the
+// process or a debugger at any time.
+static cl::opt<bool> ClDispatch("ga-asan-dispatch",
+       cl::desc("Choose between the copies of functions at run-time"),
+       cl::Hidden, cl::init(false));
+static cl::opt<bool> ClDispatchDefault("ga-asan-dispatch-default",
+       cl::desc("Run the instrumented copies first"),
+       cl::Hidden, cl::init(false));
 
 // These flags allow to change the shadow mapping.
 // The shadow mapping looks like
@@ -169,6 +244,9 @@ static cl::opt<bool> ClOptSameTemp("ga-asan-opt-same-temp",
        cl::init(true));
 static cl::opt<bool> ClOptGlobals("ga-asan-opt-globals",
        cl::desc("Don't instrument scalar globals"), cl::Hidden, cl::init(true));
+static cl::opt<bool> ClOptCoalesce("ga-asan-opt-coalesce",
+       cl::desc("Check nearby accesses to the same base once, in each BB"),
+       cl::Hidden, cl::init(false));
 
 static cl::opt<bool> ClCheckLifetime("ga-asan-check-lifetime",
        cl::desc("Use llvm.lifetime intrinsics to insert extra checks"),
@@ -283,9 +361,21 @@ struct AddressSanitizer : public FunctionPass {
   }
   
   virtual void getAnalysisUsage(AnalysisUsage &AU) const { 
+    if (ClProfile)
+      AU.addRequired<BlockFrequencyInfo>();
+    if (ClHoistLoopChecks) {
+      AU.addRequired<DominatorTree>();
+      AU.addRequired<LoopInfo>();
+      AU.addRequired<SymbolicRangeAnalysis>();
+      AU.addPreserved<SymbolicRangeAnalysis>();
+    }
   }
 
   void instrumentMop(Instruction *I);
+  bool isProvenSafe(Instruction *I);
+  bool isUntainted(Instruction *I);
+  Instruction *insertSamplingBranch(Instruction *I);
+  void countCheck(IRBuilder<> &IRB);
   void instrumentAddress(Instruction *OrigIns, Instruction *InsertBefore,
                          Value *Addr, uint32_t TypeSize, bool IsWrite,
                          Value *SizeArgument);
@@ -298,14 +388,69 @@ struct AddressSanitizer : public FunctionPass {
   void instrumentMemIntrinsicParam(Instruction *OrigIns, Value *Addr,
                                    Value *Size,
                                    Instruction *InsertBefore, bool IsWrite);
+  // The accesses [Base + Lower * Stride, Base + Upper * Stride + TypeSize)
+  // that Access does over all the iterations of its loop.
+  struct LoopCheck {
+    Instruction *Access;
+    BasicBlock *Preheader;
+    Value *Base;
+    AffineExpr Lower, Upper;
+    uint64_t Stride;
+    uint32_t TypeSize;
+    bool IsWrite;
+  };
+  // The accesses [Base + Begin, Base + End) of a BB, between two calls,
+  // checked at once before the first of them.
+  struct CheckGroup {
+    Instruction *InsertBefore;
+    Value *Base;
+    int64_t Begin, End;
+    bool IsWrite;
+    SmallVector<Instruction*, 4> Accesses;
+  };
+  void coalesceChecks(Function &F, SmallVectorImpl<Instruction*> &ToInstrument,
+                      SmallVectorImpl<CheckGroup> &Groups);
+  void instrumentCheckGroup(const CheckGroup &G);
+  bool getLoopCheck(Instruction *I, LoopCheck &LC);
+  bool loopHasCalls(Loop *L);
+  bool isAvailableAt(const AffineExpr &A, Instruction *I);
+  Value *materializeAffine(const AffineExpr &A, IRBuilder<> &IRB);
+  void instrumentLoopCheck(const LoopCheck &LC);
   Value *memToShadow(Value *Shadow, IRBuilder<> &IRB);
   bool runOnFunction(Function &F);
   bool maybeInsertAsanInitAtFunctionEntry(Function &F);
+  void createDispatchStub(Function &F, Function *Uninstrumented);
   void emitShadowMapping(Module &M, IRBuilder<> &IRB) const;
   virtual bool doInitialization(Module &M);
+  virtual bool doFinalization(Module &M);
   static char ID;  // Pass identification, replacement for typeid
 
  private:
+  // Why the check of an access was removed or kept, for ClCheckReport.
+  enum CheckReason {
+    kProvenSafe,    // Safe by the range analyses (ASI).
+    kUntainted,     // The input can't influence the address (ClTaint).
+    kGlobal,        // A global without dynamic initializer.
+    kSameTemp,      // The same address was checked before in the BB.
+    kLoopHoisted,   // Checked once in the loop preheader.
+    kCoalesced,     // Checked with nearby accesses to the same base.
+    kSampled,       // Hot and checked once in ClSampleRate runs.
+    kNoProof,       // Checked.
+    kNumCheckReasons
+  };
+  struct AccessReport {
+    std::string File;
+    unsigned Line, Column;
+    const char *Access;
+    CheckReason Reason;
+  };
+  struct FunctionReport {
+    std::string Name;
+    std::vector<AccessReport> Accesses;
+  };
+  void reportAccess(Instruction *I, CheckReason Reason);
+  void writeCheckReport(raw_ostream &OS) const;
+
   void initializeCallbacks(Module &M);
 
   bool ShouldInstrumentGlobal(GlobalVariable *G);
@@ -326,6 +471,9 @@ struct AddressSanitizer : public FunctionPass {
   Function *AsanCtorFunction;
   Function *AsanInitFunction;
   Function *AsanHandleNoReturnFunc;
+  Function *AsanRegionIsPoisonedFunc;
+  GlobalVariable *AsanSampleCounter;
+  GlobalVariable *AsanCheckCount;
   OwningPtr<BlackList> BL;
   // This array is indexed by AccessIsWrite and log2(AccessSize).
   Function *AsanErrorCallback[2][kNumberOfAccessSizes];
@@ -333,6 +481,20 @@ struct AddressSanitizer : public FunctionPass {
   Function *AsanErrorCallbackSized[2];
   InlineAsm *EmptyAsm;
   SetOfDynamicallyInitializedGlobals DynamicallyInitializedGlobals;
+  // Only with ClHoistLoopChecks.
+  DominatorTree *DT;
+  LoopInfo *LI;
+  SymbolicRangeAnalysis *SRA;
+  DenseMap<Loop*, bool> LoopHasCalls;
+  // Only with ClProfile.
+  SmallPtrSet<Instruction*, 16> HotAccesses;
+  SmallPtrSet<Instruction*, 16> ColdAccesses;
+  // Only with ClCheckReport; the last one is for the current function.
+  std::vector<FunctionReport> Reports;
+  // The accesses of the current function given a reason already.
+  SmallPtrSet<Instruction*, 16> Reported;
+  // Only with ClSiteCounts.
+  OwningPtr<SiteCounters> SiteCounts;
 
   friend struct FunctionStackPoisoner;
 };
@@ -415,6 +577,7 @@ struct FunctionStackPoisoner : public InstVisitor<FunctionStackPoisoner> {
   // Maps Value to an AllocaInst from which the Value is originated.
   typedef DenseMap<Value*, AllocaInst*> AllocaForValueMapTy;
   AllocaForValueMapTy AllocaForValue;
+  DenseMap<AllocaInst*, bool> ProvenInBounds;
 
   FunctionStackPoisoner(Function &F, AddressSanitizer &ASan)
       : F(F), ASan(ASan), DIB(*F.getParent()), C(ASan.C),
@@ -497,7 +660,49 @@ struct FunctionStackPoisoner : public InstVisitor<FunctionStackPoisoner> {
     return (!AI.isArrayAllocation() &&
             AI.isStaticAlloca() &&
             AI.getAlignment() <= RedzoneSize() &&
-            AI.getAllocatedType()->isSized());
+            AI.getAllocatedType()->isSized() &&
+            !isProvenInBounds(AI));
+  }
+
+  // With ASI, an alloca that doesn't escape and whose accesses are all
+  // proven safe (or, with ClTaint, untainted) needs no redzones.
+  bool isProvenInBounds(AllocaInst &AI) {
+    if (!ClOptASI && !ClTaint)
+      return false;
+    DenseMap<AllocaInst*, bool>::iterator It = ProvenInBounds.find(&AI);
+    if (It != ProvenInBounds.end())
+      return It->second;
+    bool Res = true;
+    SmallPtrSet<Value*, 8> Visited;
+    SmallVector<Value*, 8> Worklist;
+    Worklist.push_back(&AI);
+    while (Res && !Worklist.empty()) {
+      Value *V = Worklist.pop_back_val();
+      for (Value::use_iterator UI = V->use_begin(), UE = V->use_end();
+           UI != UE && Res; ++UI) {
+        Instruction *I = dyn_cast<Instruction>(*UI);
+        if (!I)
+          Res = false;
+        else if (isa<GetElementPtrInst>(I) || isa<BitCastInst>(I) ||
+                 isa<PHINode>(I)) {
+          if (!Visited.count(I)) {
+            Visited.insert(I);
+            Worklist.push_back(I);
+          }
+        } else if (LoadInst *LI = dyn_cast<LoadInst>(I))
+          Res = ASan.isProvenSafe(LI) || ASan.isUntainted(LI);
+        else if (StoreInst *SI = dyn_cast<StoreInst>(I))
+          Res = SI->getValueOperand() != V &&
+                (ASan.isProvenSafe(SI) || ASan.isUntainted(SI));
+        else if (IntrinsicInst *II = dyn_cast<IntrinsicInst>(I))
+          Res = II->getIntrinsicID() == Intrinsic::lifetime_start ||
+                II->getIntrinsicID() == Intrinsic::lifetime_end;
+        else
+          Res = false;
+      }
+    }
+    ProvenInBounds[&AI] = Res;
+    return Res;
   }
 
   size_t RedzoneSize() const {
@@ -518,6 +723,8 @@ struct FunctionStackPoisoner : public InstVisitor<FunctionStackPoisoner> {
   }
   /// Finds alloca where the value comes from.
   AllocaInst *findAllocaForValue(Value *V);
+  void getFrameShadow(const ArrayRef<AllocaInst*> &AllocaVec,
+                      SmallVectorImpl<uint8_t> &Shadow);
   void poisonRedZones(const ArrayRef<AllocaInst*> &AllocaVec, IRBuilder<> IRB,
                       Value *ShadowBase, bool DoPoison);
   void poisonAlloca(Value *V, uint64_t Size, IRBuilder<> IRB, bool DoPoison);
@@ -645,12 +852,12 @@ void AddressSanitizer::instrumentMop(Instruction *I) {
       // If initialization order checking is disabled, a simple access to a
       // dynamically initialized global is always valid.
       if (!CheckInitOrder)
-        return;
+        return reportAccess(I, kGlobal);
       // If a global variable does not have dynamic initialization we don't
       // have to instrument it.  However, if a global does not have initailizer
       // at all, we assume it has dynamic initializer (in other TU).
       if (G->hasInitializer() && !DynamicallyInitializedGlobals.Contains(G))
-        return;
+        return reportAccess(I, kGlobal);
     }
   }
 
@@ -662,22 +869,65 @@ void AddressSanitizer::instrumentMop(Instruction *I) {
 
   assert((TypeSize % 8) == 0);
 
+  // Hot accesses without a proof are checked only once in a while.
+  Instruction *InsertBefore = I;
+  if (HotAccesses.count(I) && !isProvenSafe(I) && ClSampleRate > 1) {
+    InsertBefore = insertSamplingBranch(I);
+    Sampled++;
+    reportAccess(I, kSampled);
+  }
+
   // Instrument a 1-, 2-, 4-, 8-, or 16- byte access with one check.
   if (TypeSize == 8  || TypeSize == 16 ||
       TypeSize == 32 || TypeSize == 64 || TypeSize == 128)
-    return instrumentAddress(I, I, Addr, TypeSize, IsWrite, 0);
+    return instrumentAddress(I, InsertBefore, Addr, TypeSize, IsWrite, 0);
   // Instrument unusual size (but still multiple of 8).
   // We can not do it with a single check, so we do 1-byte check for the first
   // and the last bytes. We call __asan_report_*_n(addr, real_size) to be able
   // to report the actual access size.
-  IRBuilder<> IRB(I);
+  IRBuilder<> IRB(InsertBefore);
   Value *LastByte =  IRB.CreateIntToPtr(
       IRB.CreateAdd(IRB.CreatePointerCast(Addr, IntptrTy),
                     ConstantInt::get(IntptrTy, TypeSize / 8 - 1)),
       OrigPtrTy);
   Value *Size = ConstantInt::get(IntptrTy, TypeSize / 8);
-  instrumentAddress(I, I, Addr, 8, IsWrite, Size);
-  instrumentAddress(I, I, LastByte, 8, IsWrite, Size);
+  instrumentAddress(I, InsertBefore, Addr, 8, IsWrite, Size);
+  instrumentAddress(I, InsertBefore, LastByte, 8, IsWrite, Size);
+}
+
+// Is I safe by the range analyses, and can we trust that? Cold accesses are
+// checked anyway.
+bool AddressSanitizer::isProvenSafe(Instruction *I) {
+  if (!ClOptASI || ColdAccesses.count(I))
+    return false;
+  return I->getMetadata("memsafe") || I->getMetadata("safe");
+}
+
+// Can't the input influence the address of I? Unlike the proofs, this holds
+// for the cold accesses too.
+bool AddressSanitizer::isUntainted(Instruction *I) {
+  return ClTaint && I->getMetadata("untainted");
+}
+
+// Branch around the check of I but once in ClSampleRate times, with a module
+// counter; return the place for the check.
+Instruction *AddressSanitizer::insertSamplingBranch(Instruction *I) {
+  IRBuilder<> IRB(I);
+  Type *CounterTy = AsanSampleCounter->getType()->getElementType();
+  Value *Count = IRB.CreateAdd(IRB.CreateLoad(AsanSampleCounter),
+                               ConstantInt::get(CounterTy, 1));
+  IRB.CreateStore(Count, AsanSampleCounter);
+  Value *Cmp = IRB.CreateICmpEQ(
+      IRB.CreateURem(Count, ConstantInt::get(CounterTy, ClSampleRate)),
+      Constant::getNullValue(CounterTy));
+  return SplitBlockAndInsertIfThen(cast<Instruction>(Cmp), false);
+}
+
+void AddressSanitizer::countCheck(IRBuilder<> &IRB) {
+  Type *CountTy = AsanCheckCount->getType()->getElementType();
+  IRB.CreateStore(IRB.CreateAdd(IRB.CreateLoad(AsanCheckCount),
+                                ConstantInt::get(CountTy, 1)),
+                  AsanCheckCount);
 }
 
 // Validate the result of Module::getOrInsertFunction called for an interface
@@ -730,10 +980,11 @@ void AddressSanitizer::instrumentAddress(Instruction *OrigIns,
                                          bool IsWrite, Value *SizeArgument) {
   if (ClOptASI) {
     //errs() << "Addr: " << *Addr << "\n";
-    if (OrigIns->getMetadata("memsafe") || OrigIns->getMetadata("safe")) {
+    if (isProvenSafe(OrigIns)) {
       //errs() << *I << " is safe\n";
       OrigIns->setMetadata("noinstrument", MDNode::get(*C,  ArrayRef<Value*>()));
       Safe++;
+      reportAccess(OrigIns, kProvenSafe);
       return;
     }
     //errs() << "Safe, NotSafe:" << Safe << ", " << NotSafe << "\n";
@@ -758,8 +1009,11 @@ void AddressSanitizer::instrumentAddress(Instruction *OrigIns,
   } */
 
   NotSafe++;
+  reportAccess(OrigIns, kNoProof);
 
   IRBuilder<> IRB(InsertBefore);
+  if (ClCountChecks)
+    countCheck(IRB);
   Value *AddrLong = IRB.CreatePointerCast(Addr, IntptrTy);
 
   Type *ShadowTy  = IntegerType::get(
@@ -796,6 +1050,279 @@ void AddressSanitizer::instrumentAddress(Instruction *OrigIns,
   Crash->setDebugLoc(OrigIns->getDebugLoc());
 }
 
+// hasCalls, once per loop: the accesses of a loop ask for it in turn.
+bool AddressSanitizer::loopHasCalls(Loop *L) {
+  DenseMap<Loop*, bool>::iterator It = LoopHasCalls.find(L);
+  if (It != LoopHasCalls.end())
+    return It->second;
+  bool Res = hasCalls(L);
+  LoopHasCalls[L] = Res;
+  return Res;
+}
+
+// Can A be computed at I? Its symbols must be integers of this function
+// defined before I.
+bool AddressSanitizer::isAvailableAt(const AffineExpr &A, Instruction *I) {
+  Function *F = I->getParent()->getParent();
+  for (unsigned i = 0, n = A.getTerms().size(); i != n; ++i) {
+    const Value *V = Expr::GetSymbolValue(A.getTerms()[i].first);
+    if (!V || !V->getType()->isIntegerTy())
+      return false;
+    if (const Argument *Arg = dyn_cast<Argument>(V)) {
+      if (Arg->getParent() != F)
+        return false;
+    } else if (const Instruction *Def = dyn_cast<Instruction>(V)) {
+      if (Def->getParent()->getParent() != F || !DT->dominates(Def, I))
+        return false;
+    } else if (!isa<Constant>(V)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Value *AddressSanitizer::materializeAffine(const AffineExpr &A,
+                                           IRBuilder<> &IRB) {
+  Value *Res = ConstantInt::get(IntptrTy, A.getConstant(), true);
+  for (unsigned i = 0, n = A.getTerms().size(); i != n; ++i) {
+    const AffineExpr::Term &T = A.getTerms()[i];
+    Value *Sym = const_cast<Value*>(Expr::GetSymbolValue(T.first));
+    Sym = IRB.CreateIntCast(Sym, IntptrTy, true);
+    Res = IRB.CreateAdd(
+        Res, IRB.CreateMul(Sym, ConstantInt::get(IntptrTy, T.second, true)));
+  }
+  return Res;
+}
+
+// If I is a load or store of Base[i] in a loop, for an induction variable i
+// whose symbolic range can be computed in the preheader, fill LC with the
+// interval of memory I touches over the whole loop.
+bool AddressSanitizer::getLoopCheck(Instruction *I, LoopCheck &LC) {
+  if (!isa<LoadInst>(I) && !isa<StoreInst>(I))
+    return false;
+  if (isProvenSafe(I))
+    return false;
+  bool IsWrite = false;
+  Value *Addr = isInterestingMemoryAccess(I, &IsWrite);
+  BasicBlock *BB = I->getParent();
+  Loop *L = LI->getLoopFor(BB);
+  if (!Addr || !L)
+    return false;
+
+  // I must run in every iteration, and the loop must leave from one place
+  // only, so that I touches the whole interval.
+  BasicBlock *Preheader = L->getLoopPreheader();
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!Preheader || !Latch || !L->getExitingBlock() ||
+      !DT->dominates(BB, Latch) || loopHasCalls(L))
+    return false;
+
+  // Only the last index may vary: a[i], or a[0][i] for arrays.
+  GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(Addr);
+  if (!GEP || GEP->getNumIndices() == 0 ||
+      !L->isLoopInvariant(GEP->getPointerOperand()))
+    return false;
+  unsigned Last = GEP->getNumOperands() - 1;
+  for (unsigned Idx = 1; Idx < Last; ++Idx) {
+    ConstantInt *CI = dyn_cast<ConstantInt>(GEP->getOperand(Idx));
+    if (!CI || !CI->isZero())
+      return false;
+  }
+  Value *Index = GEP->getOperand(Last);
+  if (!isUnitStrideIndex(Index, L))
+    return false;
+
+  Range R = SRA->getRange(Index);
+  Expr Lower = R.getLower(), Upper = R.getUpper();
+  if (Lower.isMinusInf() || Lower.isPlusInf() ||
+      Upper.isMinusInf() || Upper.isPlusInf())
+    return false;
+  if (!Lower.getAffine(LC.Lower) || !Upper.getAffine(LC.Upper))
+    return false;
+  Instruction *InsertBefore = Preheader->getTerminator();
+  if (!isAvailableAt(LC.Lower, InsertBefore) ||
+      !isAvailableAt(LC.Upper, InsertBefore))
+    return false;
+
+  Type *OrigTy = cast<PointerType>(Addr->getType())->getElementType();
+  LC.Access = I;
+  LC.Preheader = Preheader;
+  LC.Base = GEP->getPointerOperand();
+  LC.Stride = TD->getTypeAllocSize(OrigTy);
+  LC.TypeSize = TD->getTypeStoreSizeInBits(OrigTy);
+  LC.IsWrite = IsWrite;
+  return true;
+}
+
+void AddressSanitizer::instrumentLoopCheck(const LoopCheck &LC) {
+  Instruction *InsertBefore = LC.Preheader->getTerminator();
+  IRBuilder<> IRB(InsertBefore);
+  Value *Lower = materializeAffine(LC.Lower, IRB);
+  Value *Upper = materializeAffine(LC.Upper, IRB);
+
+  // The loop may not run at all.
+  Value *NotEmpty = IRB.CreateICmpSLE(Lower, Upper);
+  if (ConstantInt *CI = dyn_cast<ConstantInt>(NotEmpty)) {
+    if (CI->isZero())
+      return;
+  } else {
+    InsertBefore =
+        SplitBlockAndInsertIfThen(cast<Instruction>(NotEmpty), false);
+    IRB.SetInsertPoint(InsertBefore);
+  }
+
+  if (ClCountChecks)
+    countCheck(IRB);
+
+  // Begin = Base + Lower * Stride
+  // Size  = (Upper - Lower) * Stride + TypeSize / 8
+  Value *Stride = ConstantInt::get(IntptrTy, LC.Stride);
+  Value *Base = IRB.CreatePointerCast(LC.Base, IntptrTy);
+  Value *Begin = IRB.CreateAdd(Base, IRB.CreateMul(Lower, Stride));
+  Value *Size = IRB.CreateAdd(
+      IRB.CreateMul(IRB.CreateSub(Upper, Lower), Stride),
+      ConstantInt::get(IntptrTy, LC.TypeSize / 8));
+  Value *Poisoned = IRB.CreateCall2(AsanRegionIsPoisonedFunc, Begin, Size);
+  Value *Cmp = IRB.CreateICmpNE(Poisoned, Constant::getNullValue(IntptrTy));
+  TerminatorInst *CrashTerm =
+      SplitBlockAndInsertIfThen(cast<Instruction>(Cmp), true);
+  Instruction *Crash =
+      generateCrashCode(CrashTerm, Poisoned, LC.IsWrite, 0, Size);
+  Crash->setDebugLoc(LC.Access->getDebugLoc());
+  Hoisted++;
+  reportAccess(LC.Access, kLoopHoisted);
+}
+
+// The shadow bytes of Span bytes of memory starting anywhere in a granule:
+// the granules they touch when they start at its last byte, rounded up to a
+// power of two (a power of two stays as it is).
+static uint64_t getNumShadowBytes(uint64_t Span, size_t Granularity) {
+  uint64_t Granules = (Span + 2 * Granularity - 2) / Granularity;
+  return NextPowerOf2(Granules - 1);
+}
+
+// Group the loads and stores of ToInstrument with the same base and
+// constant offsets, if no call is between them and their shadow fits in
+// one load. The grouped accesses are removed from ToInstrument.
+void AddressSanitizer::coalesceChecks(
+    Function &F, SmallVectorImpl<Instruction*> &ToInstrument,
+    SmallVectorImpl<CheckGroup> &Groups) {
+  size_t Granularity = 1 << Mapping.Scale;
+  SmallPtrSet<Instruction*, 16> Candidates;
+  for (size_t i = 0, n = ToInstrument.size(); i != n; i++) {
+    Instruction *I = ToInstrument[i];
+    if (!isa<LoadInst>(I) && !isa<StoreInst>(I))
+      continue;
+    // Leave to instrumentMop what it doesn't check.
+    if (isProvenSafe(I))
+      continue;
+    bool IsWrite;
+    if (ClOpt && ClOptGlobals &&
+        isa<GlobalVariable>(isInterestingMemoryAccess(I, &IsWrite)))
+      continue;
+    Candidates.insert(I);
+  }
+
+  SmallPtrSet<Instruction*, 16> Grouped;
+  for (Function::iterator FI = F.begin(), FE = F.end(); FI != FE; ++FI) {
+    // The group, in Groups, still open for each base.
+    DenseMap<Value*, size_t> Open;
+    for (BasicBlock::iterator BI = FI->begin(), BE = FI->end();
+         BI != BE; ++BI) {
+      if (CallSite(BI)) {
+        Open.clear();
+        continue;
+      }
+      if (!Candidates.count(BI))
+        continue;
+      bool IsWrite = false;
+      Value *Addr = isInterestingMemoryAccess(BI, &IsWrite);
+      Type *OrigTy = cast<PointerType>(Addr->getType())->getElementType();
+      int64_t Offset = 0;
+      Value *Base = GetPointerBaseWithConstantOffset(Addr, Offset, TD);
+      int64_t End = Offset + TD->getTypeStoreSize(OrigTy);
+
+      DenseMap<Value*, size_t>::iterator It = Open.find(Base);
+      if (It != Open.end()) {
+        CheckGroup &G = Groups[It->second];
+        int64_t Begin = std::min(G.Begin, Offset);
+        int64_t NewEnd = std::max(G.End, End);
+        if (getNumShadowBytes(NewEnd - Begin, Granularity) <=
+            kMaxCoalescedShadowBytes) {
+          G.Begin = Begin;
+          G.End = NewEnd;
+          G.IsWrite |= IsWrite;
+          G.Accesses.push_back(BI);
+          continue;
+        }
+      }
+      CheckGroup G;
+      G.InsertBefore = BI;
+      G.Base = Base;
+      G.Begin = Offset;
+      G.End = End;
+      G.IsWrite = IsWrite;
+      G.Accesses.push_back(BI);
+      Open[Base] = Groups.size();
+      Groups.push_back(G);
+    }
+  }
+
+  // A group of one access is checked as usual.
+  size_t NumGroups = 0;
+  for (size_t i = 0, n = Groups.size(); i != n; i++) {
+    if (Groups[i].Accesses.size() < 2)
+      continue;
+    for (size_t j = 0, m = Groups[i].Accesses.size(); j != m; j++)
+      Grouped.insert(Groups[i].Accesses[j]);
+    Groups[NumGroups++] = Groups[i];
+  }
+  Groups.resize(NumGroups);
+
+  SmallVector<Instruction*, 16> Remaining;
+  for (size_t i = 0, n = ToInstrument.size(); i != n; i++)
+    if (!Grouped.count(ToInstrument[i]))
+      Remaining.push_back(ToInstrument[i]);
+  ToInstrument.swap(Remaining);
+}
+
+void AddressSanitizer::instrumentCheckGroup(const CheckGroup &G) {
+  size_t Granularity = 1 << Mapping.Scale;
+  IRBuilder<> IRB(G.InsertBefore);
+  if (ClCountChecks)
+    countCheck(IRB);
+  Value *Begin = IRB.CreateAdd(IRB.CreatePointerCast(G.Base, IntptrTy),
+                               ConstantInt::get(IntptrTy, G.Begin, true));
+  Value *Size = ConstantInt::get(IntptrTy, G.End - G.Begin);
+
+  // Fast path: every granule the group touches is addressable.
+  Type *ShadowTy = IntegerType::get(
+      *C, 8 * getNumShadowBytes(G.End - G.Begin, Granularity));
+  Type *ShadowPtrTy = PointerType::get(ShadowTy, 0);
+  Value *ShadowPtr = memToShadow(Begin, IRB);
+  // The shadow of an arbitrary group start isn't aligned for ShadowTy.
+  LoadInst *ShadowValue = IRB.CreateLoad(
+      IRB.CreateIntToPtr(ShadowPtr, ShadowPtrTy));
+  ShadowValue->setAlignment(1);
+  Value *Cmp = IRB.CreateICmpNE(ShadowValue, Constant::getNullValue(ShadowTy));
+  TerminatorInst *CheckTerm =
+      SplitBlockAndInsertIfThen(cast<Instruction>(Cmp), false);
+
+  // Slow path: the shadow load may cover a partial granule, or granules
+  // around the group, so ask the run-time about the bytes themselves.
+  IRB.SetInsertPoint(CheckTerm);
+  Value *Poisoned = IRB.CreateCall2(AsanRegionIsPoisonedFunc, Begin, Size);
+  Value *Cmp2 = IRB.CreateICmpNE(Poisoned, Constant::getNullValue(IntptrTy));
+  TerminatorInst *CrashTerm =
+      SplitBlockAndInsertIfThen(cast<Instruction>(Cmp2), true);
+  Instruction *Crash =
+      generateCrashCode(CrashTerm, Poisoned, G.IsWrite, 0, Size);
+  Crash->setDebugLoc(G.InsertBefore->getDebugLoc());
+  Coalesced += G.Accesses.size();
+  for (size_t i = 0, n = G.Accesses.size(); i != n; i++)
+    reportAccess(G.Accesses[i], kCoalesced);
+}
+
 void AddressSanitizerModule::createInitializerPoisonCalls(
     Module &M, GlobalValue *ModuleName) {
   // We do all of our poisoning and unpoisoning within _GLOBAL__I_a.
@@ -1076,6 +1603,9 @@ void AddressSanitizer::initializeCallbacks(Module &M) {
 
   AsanHandleNoReturnFunc = checkInterfaceFunction(M.getOrInsertFunction(
       kAsanHandleNoReturnName, IRB.getVoidTy(), NULL));
+  if (ClHoistLoopChecks || ClOptCoalesce)
+    AsanRegionIsPoisonedFunc = checkInterfaceFunction(M.getOrInsertFunction(
+        kAsanRegionIsPoisonedName, IntptrTy, IntptrTy, IntptrTy, NULL));
   // We insert an empty inline asm after __asan_report* to avoid callback merge.
   EmptyAsm = InlineAsm::get(FunctionType::get(IRB.getVoidTy(), false),
                             StringRef(""), StringRef(""),
@@ -1128,9 +1658,140 @@ bool AddressSanitizer::doInitialization(Module &M) {
   emitShadowMapping(M, IRB);
 
   appendToGlobalCtors(M, AsanCtorFunction, kAsanCtorAndCtorPriority);
+
+  if (ClProfile)
+    AsanSampleCounter = new GlobalVariable(
+        M, IRB.getInt32Ty(), false, GlobalValue::InternalLinkage,
+        IRB.getInt32(0), kAsanSampleCounterName);
+
+  if (ClCountChecks) {
+    AsanCheckCount = new GlobalVariable(
+        M, IRB.getInt64Ty(), false, GlobalValue::WeakAnyLinkage,
+        IRB.getInt64(0), kAsanCheckCountName);
+    Function *Dtor = Function::Create(
+        FunctionType::get(IRB.getVoidTy(), false),
+        GlobalValue::InternalLinkage, kAsanCheckCountDtorName, &M);
+    IRBuilder<> DtorIRB(ReturnInst::Create(*C, BasicBlock::Create(*C, "", Dtor)));
+    Constant *DPrintF = M.getOrInsertFunction(
+        "dprintf", FunctionType::get(DtorIRB.getInt32Ty(),
+                                     DtorIRB.getInt32Ty(), true));
+    DtorIRB.CreateCall3(
+        DPrintF, DtorIRB.getInt32(2),
+        DtorIRB.CreateGlobalStringPtr("ga-asan: %llu checks executed\n"),
+        DtorIRB.CreateLoad(AsanCheckCount));
+    appendToGlobalDtors(M, Dtor, kAsanCtorAndCtorPriority);
+  }
+
+  if (!ClSiteCounts.empty())
+    SiteCounts.reset(new SiteCounters(M, "ga-asan", ClSiteCounts, LongSize));
   return true;
 }
 
+// virtual
+bool AddressSanitizer::doFinalization(Module &M) {
+  PassProfile &Profile = PassProfile::get();
+  Profile.counter("ga-asan checks", "instrumentation", NotSafe);
+  Profile.counter("ga-asan proven safe", "instrumentation", Safe);
+  Profile.counter("ga-asan untainted", "instrumentation", Untainted);
+  Profile.sampleRSS("instrumentation");
+
+  bool Changed = false;
+  if (SiteCounts) {
+    Profile.counter("ga-asan counted sites", "instrumentation",
+                    SiteCounts->size());
+    SiteCounts->finish();
+    SiteCounts.reset();
+    Changed = true;
+  }
+
+  if (ClCheckReport.empty())
+    return Changed;
+  std::string ErrorInfo;
+  raw_fd_ostream File(ClCheckReport.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << "Error opening file " << ClCheckReport
+           << " for writing! Error Info: " << ErrorInfo << " \n";
+    return Changed;
+  }
+  writeCheckReport(File);
+  return Changed;
+}
+
+static const char *getCheckReasonName(unsigned Reason) {
+  static const char *Names[] = {
+    "proven-safe", "untainted", "global", "same-temp", "loop-hoisted", "coalesced",
+    "sampled", "no-proof"
+  };
+  return Names[Reason];
+}
+
+static void printJSONString(raw_ostream &OS, StringRef S) {
+  OS << '"';
+  for (size_t i = 0, n = S.size(); i != n; i++) {
+    unsigned char Ch = S[i];
+    if (Ch == '"' || Ch == '\\')
+      OS << '\\' << Ch;
+    else if (Ch < 0x20)
+      OS << "\\u00" << hexdigit(Ch >> 4) << hexdigit(Ch & 15);
+    else
+      OS << Ch;
+  }
+  OS << '"';
+}
+
+// With ClSiteCounts, the access also gets a counter, before it: a check
+// kept, or sampled, runs as often as its access.
+void AddressSanitizer::reportAccess(Instruction *I, CheckReason Reason) {
+  if ((ClCheckReport.empty() && !SiteCounts) || !Reported.insert(I))
+    return;
+  if (SiteCounts)
+    SiteCounts->addSite(I, getCheckReasonName(Reason),
+                        Reason == kNoProof || Reason == kSampled);
+  if (ClCheckReport.empty())
+    return;
+  AccessReport R;
+  R.Line = R.Column = 0;
+  if (MDNode *N = I->getMetadata("dbg")) {
+    DILocation Loc(N);
+    R.File = Loc.getFilename();
+    R.Line = Loc.getLineNumber();
+    R.Column = Loc.getColumnNumber();
+  }
+  R.Access = I->getOpcodeName();
+  R.Reason = Reason;
+  Reports.back().Accesses.push_back(R);
+}
+
+// One object per function, with the number of accesses for each reason and
+// the accesses in the order they were seen.
+void AddressSanitizer::writeCheckReport(raw_ostream &OS) const {
+  OS << "{\n  \"functions\": [";
+  for (size_t i = 0, n = Reports.size(); i != n; i++) {
+    const FunctionReport &FR = Reports[i];
+    unsigned Counts[kNumCheckReasons] = { 0 };
+    for (size_t j = 0, m = FR.Accesses.size(); j != m; j++)
+      Counts[FR.Accesses[j].Reason]++;
+
+    OS << (i ? ",\n" : "\n") << "    {\n      \"name\": ";
+    printJSONString(OS, FR.Name);
+    OS << ",\n      \"counts\": {";
+    for (unsigned Reason = 0; Reason != kNumCheckReasons; Reason++)
+      OS << (Reason ? ", " : " ") << '"' << getCheckReasonName(Reason)
+         << "\": " << Counts[Reason];
+    OS << " },\n      \"accesses\": [";
+    for (size_t j = 0, m = FR.Accesses.size(); j != m; j++) {
+      const AccessReport &R = FR.Accesses[j];
+      OS << (j ? ",\n" : "\n") << "        { \"file\": ";
+      printJSONString(OS, R.File);
+      OS << ", \"line\": " << R.Line << ", \"column\": " << R.Column
+         << ", \"access\": \"" << R.Access << "\", \"reason\": \""
+         << getCheckReasonName(R.Reason) << "\" }";
+    }
+    OS << (FR.Accesses.empty() ? "]" : "\n      ]") << "\n    }";
+  }
+  OS << (Reports.empty() ? "]" : "\n  ]") << "\n}\n";
+}
+
 bool AddressSanitizer::maybeInsertAsanInitAtFunctionEntry(Function &F) {
   // For each NSObject descendant having a +load method, this method is invoked
   // by the ObjC runtime before any of the static constructors is called.
@@ -1147,7 +1808,66 @@ bool AddressSanitizer::maybeInsertAsanInitAtFunctionEntry(Function &F) {
   return false;
 }
 
+// Move the instrumented body of F into ASAN_<name> and make F call either
+// it or Uninstrumented, as its flag says.
+void AddressSanitizer::createDispatchStub(Function &F,
+                                          Function *Uninstrumented) {
+  Module &M = *F.getParent();
+  Function *Instrumented = Function::Create(
+      F.getFunctionType(), GlobalValue::InternalLinkage,
+      "ASAN_" + F.getName(), &M);
+  Instrumented->copyAttributesFrom(&F);
+  Instrumented->setLinkage(GlobalValue::InternalLinkage);
+  Instrumented->setVisibility(GlobalValue::DefaultVisibility);
+  // It must not be instrumented again when the pass reaches it.
+  Instrumented->removeFnAttr(Attribute::SanitizeAddress);
+  Instrumented->getBasicBlockList().splice(Instrumented->begin(),
+                                           F.getBasicBlockList());
+  for (Function::arg_iterator AI = F.arg_begin(), AE = F.arg_end(),
+       NI = Instrumented->arg_begin(); AI != AE; ++AI, ++NI) {
+    AI->replaceAllUsesWith(NI);
+    NI->takeName(AI);
+  }
+  Instrumented->setSection("ASAN");
+  Uninstrumented->setSection("NOASAN");
+  Uninstrumented->setLinkage(GlobalValue::InternalLinkage);
+  Uninstrumented->setVisibility(GlobalValue::DefaultVisibility);
+
+  IRBuilder<> IRB(BasicBlock::Create(*C, "", &F));
+  GlobalVariable *Flag = new GlobalVariable(
+      M, IRB.getInt8Ty(), false,
+      F.hasLocalLinkage() ? GlobalValue::InternalLinkage
+                          : GlobalValue::ExternalLinkage,
+      IRB.getInt8(ClDispatchDefault), kAsanDispatchFlagPrefix + F.getName());
+  // The flag may change at any time.
+  Value *Enabled = IRB.CreateICmpNE(
+      IRB.CreateLoad(Flag, /*isVolatile=*/true), IRB.getInt8(0));
+  BasicBlock *InstrumentedBB = BasicBlock::Create(*C, "", &F);
+  BasicBlock *UninstrumentedBB = BasicBlock::Create(*C, "", &F);
+  IRB.CreateCondBr(Enabled, InstrumentedBB, UninstrumentedBB);
+
+  SmallVector<Value*, 8> Args;
+  for (Function::arg_iterator AI = F.arg_begin(), AE = F.arg_end();
+       AI != AE; ++AI)
+    Args.push_back(AI);
+  Function *Callees[] = { Instrumented, Uninstrumented };
+  BasicBlock *Blocks[] = { InstrumentedBB, UninstrumentedBB };
+  for (unsigned i = 0; i < 2; i++) {
+    IRB.SetInsertPoint(Blocks[i]);
+    CallInst *Call = IRB.CreateCall(Callees[i], Args);
+    // Byval arguments live in the frame of the stub.
+    Call->setTailCall(!F.getAttributes().hasAttrSomewhere(Attribute::ByVal));
+    Call->setCallingConv(F.getCallingConv());
+    Call->setAttributes(Callees[i]->getAttributes());
+    if (F.getReturnType()->isVoidTy())
+      IRB.CreateRetVoid();
+    else
+      IRB.CreateRet(Call);
+  }
+}
+
 bool AddressSanitizer::runOnFunction(Function &F) {
+  PassProfileScope Scope("ga-asan", "instrumentation");
   if (BL->isIn(F)) return false;
   if (&F == AsanCtorFunction) return false;
   if (F.getLinkage() == GlobalValue::AvailableExternallyLinkage) return false;
@@ -1163,6 +1883,12 @@ bool AddressSanitizer::runOnFunction(Function &F) {
   if (!ClDebugFunc.empty() && ClDebugFunc != F.getName())
     return false;
 
+  Reported.clear();
+  if (!ClCheckReport.empty()) {
+    Reports.push_back(FunctionReport());
+    Reports.back().Name = F.getName();
+  }
+
   // We want to instrument every address only once per basic block (unless there
   // are calls between uses).
   SmallSet<Value*, 16> TempsToInstrument;
@@ -1181,8 +1907,11 @@ bool AddressSanitizer::runOnFunction(Function &F) {
       if (LooksLikeCodeInBug11395(BI)) return false;
       if (Value *Addr = isInterestingMemoryAccess(BI, &IsWrite)) {
         if (ClOpt && ClOptSameTemp) {
-          if (!TempsToInstrument.insert(Addr))
-            continue;  // We've seen this temp in the current BB.
+          if (!TempsToInstrument.insert(Addr)) {
+            // We've seen this temp in the current BB.
+            reportAccess(BI, kSameTemp);
+            continue;
+          }
         }
       } else if (isa<MemIntrinsic>(BI) && ClMemIntrin) {
         // ok, take it.
@@ -1205,9 +1934,49 @@ bool AddressSanitizer::runOnFunction(Function &F) {
     }
   }
 
+  // The accesses the input can't influence are left out of every kind of
+  // check.
+  if (ClTaint) {
+    SmallVector<Instruction*, 16> Tainted;
+    unsigned NumUntainted = 0;
+    for (size_t i = 0, n = ToInstrument.size(); i != n; i++) {
+      if (isUntainted(ToInstrument[i])) {
+        reportAccess(ToInstrument[i], kUntainted);
+        NumUntainted++;
+      } else {
+        Tainted.push_back(ToInstrument[i]);
+      }
+    }
+    ToInstrument.swap(Tainted);
+    Untainted += NumUntainted;
+    if (NumUntainted)
+      dbgs() << "ga-asan: " << F.getName() << ": " << NumUntainted
+             << " untainted accesses not checked\n";
+  }
+
+  // Split hot and cold accesses while the blocks are those of the profile.
+  HotAccesses.clear();
+  ColdAccesses.clear();
+  if (ClProfile) {
+    BlockFrequencyInfo &BFI = getAnalysis<BlockFrequencyInfo>();
+    uint64_t EntryFreq = BFI.getBlockFreq(&F.getEntryBlock()).getFrequency();
+    for (size_t i = 0, n = ToInstrument.size(); i != n; i++) {
+      Instruction *I = ToInstrument[i];
+      uint64_t Freq = BFI.getBlockFreq(I->getParent()).getFrequency();
+      if (Freq >= EntryFreq * ClHotFreq)
+        HotAccesses.insert(I);
+      else
+        ColdAccesses.insert(I);
+    }
+  }
+
   Function *UninstrumentedDuplicate = 0;
+  // Accesses that are all proven safe need no copy.
+  bool AllProvenSafe = true;
+  for (size_t i = 0, n = ToInstrument.size(); i != n && AllProvenSafe; i++)
+    AllProvenSafe = isProvenSafe(ToInstrument[i]);
   bool LikelyToInstrument =
-      !NoReturnCalls.empty() || !ToInstrument.empty() || (NumAllocas > 0);
+      !NoReturnCalls.empty() || !AllProvenSafe || (NumAllocas > 0);
   if (ClKeepUninstrumented && LikelyToInstrument) {
     ValueToValueMapTy VMap;
     UninstrumentedDuplicate = CloneFunction(&F, VMap, false);
@@ -1216,6 +1985,35 @@ bool AddressSanitizer::runOnFunction(Function &F) {
     F.getParent()->getFunctionList().push_back(UninstrumentedDuplicate);
   }
 
+  // Check the affine accesses in loops once, in the preheaders. The loops
+  // must be found before the instrumentation splits their blocks.
+  SmallVector<LoopCheck, 8> LoopChecks;
+  if (ClHoistLoopChecks) {
+    DT = &getAnalysis<DominatorTree>();
+    LI = &getAnalysis<LoopInfo>();
+    SRA = &getAnalysis<SymbolicRangeAnalysis>();
+    LoopHasCalls.clear();
+    SmallVector<Instruction*, 16> Remaining;
+    for (size_t i = 0, n = ToInstrument.size(); i != n; i++) {
+      LoopCheck LC;
+      if (getLoopCheck(ToInstrument[i], LC))
+        LoopChecks.push_back(LC);
+      else
+        Remaining.push_back(ToInstrument[i]);
+    }
+    ToInstrument.swap(Remaining);
+    for (size_t i = 0, n = LoopChecks.size(); i != n; i++)
+      instrumentLoopCheck(LoopChecks[i]);
+  }
+
+  // Check nearby accesses to the same base together.
+  SmallVector<CheckGroup, 8> CheckGroups;
+  if (ClOpt && ClOptCoalesce) {
+    coalesceChecks(F, ToInstrument, CheckGroups);
+    for (size_t i = 0, n = CheckGroups.size(); i != n; i++)
+      instrumentCheckGroup(CheckGroups[i]);
+  }
+
   // Instrument.
   int NumInstrumented = 0;
   for (size_t i = 0, n = ToInstrument.size(); i != n; i++) {
@@ -1241,17 +2039,19 @@ bool AddressSanitizer::runOnFunction(Function &F) {
     IRB.CreateCall(AsanHandleNoReturnFunc);
   }
 
-  bool res = NumInstrumented > 0 || ChangedStack || !NoReturnCalls.empty();
+  bool res = NumInstrumented > 0 || !LoopChecks.empty() ||
+             !CheckGroups.empty() || ChangedStack || !NoReturnCalls.empty();
   DEBUG(dbgs() << "ASAN done instrumenting: " << res << " " << F << "\n");
 
-  if (ClKeepUninstrumented) {
+  // Without the duplicate, every check was proven unnecessary.
+  if (ClKeepUninstrumented && UninstrumentedDuplicate) {
     if (!res) {
       // No instrumentation is done, no need for the duplicate.
-      if (UninstrumentedDuplicate)
-        UninstrumentedDuplicate->eraseFromParent();
+      UninstrumentedDuplicate->eraseFromParent();
+    } else if (ClDispatch && !F.isVarArg()) {
+      createDispatchStub(F, UninstrumentedDuplicate);
     } else {
-      // The function was instrumented. We must have the duplicate.
-      assert(UninstrumentedDuplicate);
+      // The function was instrumented.
       UninstrumentedDuplicate->setSection("NOASAN");
       assert(!F.hasSection());
       F.setSection("ASAN");
@@ -1261,15 +2061,6 @@ bool AddressSanitizer::runOnFunction(Function &F) {
   return res;
 }
 
-static uint64_t ValueForPoison(uint64_t PoisonByte, size_t ShadowRedzoneSize) {
-  if (ShadowRedzoneSize == 1) return PoisonByte;
-  if (ShadowRedzoneSize == 2) return (PoisonByte << 8) + PoisonByte;
-  if (ShadowRedzoneSize == 4)
-    return (PoisonByte << 24) + (PoisonByte << 16) +
-        (PoisonByte << 8) + (PoisonByte);
-  llvm_unreachable("ShadowRedzoneSize is either 1, 2 or 4");
-}
-
 static void PoisonShadowPartialRightRedzone(uint8_t *Shadow,
                                             size_t Size,
                                             size_t RZSize,
@@ -1312,65 +2103,82 @@ void FunctionStackPoisoner::initializeCallbacks(Module &M) {
       kAsanUnpoisonStackMemoryName, IRB.getVoidTy(), IntptrTy, IntptrTy, NULL));
 }
 
-void FunctionStackPoisoner::poisonRedZones(
-  const ArrayRef<AllocaInst*> &AllocaVec, IRBuilder<> IRB, Value *ShadowBase,
-  bool DoPoison) {
+// The shadow of the whole frame: the left redzone, then every alloca
+// followed by its redzone, in the order of AllocaVec.
+void FunctionStackPoisoner::getFrameShadow(
+  const ArrayRef<AllocaInst*> &AllocaVec, SmallVectorImpl<uint8_t> &Shadow) {
+  size_t Granularity = 1ULL << Mapping.Scale;
   size_t ShadowRZSize = RedzoneSize() >> Mapping.Scale;
-  assert(ShadowRZSize >= 1 && ShadowRZSize <= 4);
-  Type *RZTy = Type::getIntNTy(*C, ShadowRZSize * 8);
-  Type *RZPtrTy = PointerType::get(RZTy, 0);
-
-  Value *PoisonLeft  = ConstantInt::get(RZTy,
-    ValueForPoison(DoPoison ? kAsanStackLeftRedzoneMagic : 0LL, ShadowRZSize));
-  Value *PoisonMid   = ConstantInt::get(RZTy,
-    ValueForPoison(DoPoison ? kAsanStackMidRedzoneMagic : 0LL, ShadowRZSize));
-  Value *PoisonRight = ConstantInt::get(RZTy,
-    ValueForPoison(DoPoison ? kAsanStackRightRedzoneMagic : 0LL, ShadowRZSize));
-
-  // poison the first red zone.
-  IRB.CreateStore(PoisonLeft, IRB.CreateIntToPtr(ShadowBase, RZPtrTy));
-
-  // poison all other red zones.
-  uint64_t Pos = RedzoneSize();
+  Shadow.clear();
+  Shadow.append(ShadowRZSize, kAsanStackLeftRedzoneMagic);
   for (size_t i = 0, n = AllocaVec.size(); i < n; i++) {
     AllocaInst *AI = AllocaVec[i];
     uint64_t SizeInBytes = getAllocaSizeInBytes(AI);
     uint64_t AlignedSize = getAlignedAllocaSize(AI);
     assert(AlignedSize - SizeInBytes < RedzoneSize());
-    Value *Ptr = NULL;
-
-    Pos += AlignedSize;
-
-    assert(ShadowBase->getType() == IntptrTy);
+    Shadow.append(AlignedSize >> Mapping.Scale, 0);
     if (SizeInBytes < AlignedSize) {
       // Poison the partial redzone at right
-      Ptr = IRB.CreateAdd(
-          ShadowBase, ConstantInt::get(IntptrTy,
-                                       (Pos >> Mapping.Scale) - ShadowRZSize));
       size_t AddressableBytes = RedzoneSize() - (AlignedSize - SizeInBytes);
-      uint32_t Poison = 0;
-      if (DoPoison) {
-        PoisonShadowPartialRightRedzone((uint8_t*)&Poison, AddressableBytes,
-                                        RedzoneSize(),
-                                        1ULL << Mapping.Scale,
-                                        kAsanStackPartialRedzoneMagic);
-        Poison =
-            ASan.TD->isLittleEndian()
-                ? support::endian::byte_swap<uint32_t, support::little>(Poison)
-                : support::endian::byte_swap<uint32_t, support::big>(Poison);
-      }
-      Value *PartialPoison = ConstantInt::get(RZTy, Poison);
-      IRB.CreateStore(PartialPoison, IRB.CreateIntToPtr(Ptr, RZPtrTy));
+      PoisonShadowPartialRightRedzone(Shadow.end() - ShadowRZSize,
+                                      AddressableBytes, RedzoneSize(),
+                                      Granularity,
+                                      kAsanStackPartialRedzoneMagic);
     }
-
     // Poison the full redzone at right.
-    Ptr = IRB.CreateAdd(ShadowBase,
-                        ConstantInt::get(IntptrTy, Pos >> Mapping.Scale));
     bool LastAlloca = (i == AllocaVec.size() - 1);
-    Value *Poison = LastAlloca ? PoisonRight : PoisonMid;
-    IRB.CreateStore(Poison, IRB.CreateIntToPtr(Ptr, RZPtrTy));
+    Shadow.append(ShadowRZSize, LastAlloca ? kAsanStackRightRedzoneMagic
+                                           : kAsanStackMidRedzoneMagic);
+  }
+}
 
-    Pos += RedzoneSize();
+// Write the shadow of the frame with the widest stores the target has,
+// skipping the words that are zero in the poisoned frame, which the stack
+// shadow already is. Frames needing many stores are unpoisoned with a
+// single memset.
+void FunctionStackPoisoner::poisonRedZones(
+  const ArrayRef<AllocaInst*> &AllocaVec, IRBuilder<> IRB, Value *ShadowBase,
+  bool DoPoison) {
+  assert(ShadowBase->getType() == IntptrTy);
+  SmallVector<uint8_t, 64> Shadow;
+  getFrameShadow(AllocaVec, Shadow);
+  uint64_t WordSize = ASan.LongSize / 8;
+  uint64_t ShadowAlign =
+      std::max<uint64_t>(1, (uint64_t)StackAlignment >> Mapping.Scale);
+
+  // The stores, as offset and size.
+  SmallVector<std::pair<uint64_t, uint64_t>, 16> Stores;
+  for (uint64_t Pos = 0, End = Shadow.size(); Pos < End; ) {
+    uint64_t Size = WordSize;
+    while (Size > End - Pos)
+      Size /= 2;
+    for (uint64_t i = Pos; i < Pos + Size; i++)
+      if (Shadow[i]) {
+        Stores.push_back(std::make_pair(Pos, Size));
+        break;
+      }
+    Pos += Size;
+  }
+
+  if (!DoPoison && Stores.size() > kMaxStackShadowStores) {
+    IRB.CreateMemSet(IRB.CreateIntToPtr(ShadowBase, IRB.getInt8PtrTy()),
+                     IRB.getInt8(0), Shadow.size(), ShadowAlign);
+    return;
+  }
+
+  for (size_t i = 0, n = Stores.size(); i < n; i++) {
+    uint64_t Pos = Stores[i].first, Size = Stores[i].second;
+    uint64_t Poison = 0;
+    for (uint64_t j = 0; DoPoison && j < Size; j++) {
+      unsigned Shift = ASan.TD->isLittleEndian() ? j : Size - 1 - j;
+      Poison |= (uint64_t)Shadow[Pos + j] << (8 * Shift);
+    }
+    Type *StoreTy = Type::getIntNTy(*C, Size * 8);
+    Value *Ptr = IRB.CreateAdd(ShadowBase, ConstantInt::get(IntptrTy, Pos));
+    IRB.CreateAlignedStore(
+        ConstantInt::get(StoreTy, Poison),
+        IRB.CreateIntToPtr(Ptr, PointerType::get(StoreTy, 0)),
+        MinAlign(ShadowAlign, Pos));
   }
 }
 
@@ -1,21 +1,28 @@
 //===------------------------------- Expr.cpp -----------------------------===//
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "expr"
+
 #include "Expr.h"
 #include "Range.h"
 
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "ginac/ginac.h"
 
 #include <algorithm>
+#include <climits>
 #include <map>
 #include <queue>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 /* ************************************************************************** */
 /* ************************************************************************** */
@@ -51,11 +58,369 @@ static cl::opt<bool>
 char TestExpr::ID = 0;
 static RegisterPass<TestExpr> X("expr-test", "Test expression handling");
 
+static cl::opt<unsigned>
+  ExprCacheSize("expr-cache-size",
+          cl::desc("Entries of the tables of expressions and of comparisons,"
+                   " 0 disables them"),
+          cl::Hidden, cl::init(1 << 16));
+
+static cl::opt<bool>
+  ExprCacheStats("expr-cache-stats",
+          cl::desc("Print the hit rate of the comparison cache at exit"),
+          cl::Hidden, cl::init(false));
+
+static cl::opt<bool>
+  ExprAffine("expr-affine",
+          cl::desc("Keep the affine expressions out of GiNaC"),
+          cl::Hidden, cl::init(true));
+
+STATISTIC(NumCmpHits,   "Number of comparisons answered by the cache");
+STATISTIC(NumCmpMisses, "Number of comparisons computed by GiNaC");
+
 #define EXPR_DEBUG(X) { if (ExprDebug) { X; } }
 
 /* ************************************************************************** */
 /* ************************************************************************** */
 
+namespace {
+
+struct ExHash {
+  size_t operator()(const GiNaC::ex& E) const { return E.gethash(); }
+};
+
+struct ExEqual {
+  bool operator()(const GiNaC::ex& L, const GiNaC::ex& R) const {
+    return L.is_equal(R);
+  }
+};
+
+// ExprTable
+// Hash-consing of the expressions: equal expressions share one GiNaC node,
+// so that comparing them, here or in the cache, is a pointer comparison.
+// When full it starts over; the expressions out of it are still valid.
+class ExprTable {
+public:
+  GiNaC::ex intern(const GiNaC::ex& E) {
+    if (ExprCacheSize == 0)
+      return E;
+
+    auto It = Table_.find(E);
+    if (It != Table_.end())
+      return *It;
+
+    if (Table_.size() >= ExprCacheSize)
+      Table_.clear();
+    Table_.insert(E);
+    return E;
+  }
+
+private:
+  std::unordered_set<GiNaC::ex, ExHash, ExEqual> Table_;
+};
+
+// CmpCache
+// The results of LHS < RHS in an assumption context. Every comparison of
+// Expr comes down to this one.
+class CmpCache {
+public:
+  CmpCache() : Hits_(0), Misses_(0) { }
+  ~CmpCache() {
+    if (ExprCacheStats && Hits_ + Misses_)
+      errs() << "expr: " << Hits_ << " of " << (Hits_ + Misses_)
+             << " comparisons cached ("
+             << format("%.1f", 100.0 * Hits_ / (Hits_ + Misses_)) << "%)\n";
+  }
+
+  bool lookup(const GiNaC::ex& LHS, const GiNaC::ex& RHS,
+              unsigned long Context, bool& Result) {
+    auto It = Results_.find(Key(LHS, RHS, Context));
+    if (It == Results_.end()) {
+      ++Misses_, ++NumCmpMisses;
+      return false;
+    }
+    ++Hits_, ++NumCmpHits;
+    Result = It->second;
+    return true;
+  }
+
+  void insert(const GiNaC::ex& LHS, const GiNaC::ex& RHS,
+              unsigned long Context, bool Result) {
+    if (Results_.size() >= ExprCacheSize)
+      Results_.clear();
+    Results_[Key(LHS, RHS, Context)] = Result;
+  }
+
+private:
+  struct Key {
+    Key(const GiNaC::ex& L, const GiNaC::ex& R, unsigned long C)
+      : LHS(L), RHS(R), Context(C) { }
+    GiNaC::ex LHS, RHS;
+    unsigned long Context;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& K) const {
+      return (K.LHS.gethash() * 31 + K.RHS.gethash()) * 31 + K.Context;
+    }
+  };
+
+  struct KeyEqual {
+    bool operator()(const Key& L, const Key& R) const {
+      return L.Context == R.Context && L.LHS.is_equal(R.LHS) &&
+             L.RHS.is_equal(R.RHS);
+    }
+  };
+
+  std::unordered_map<Key, bool, KeyHash, KeyEqual> Results_;
+  unsigned long Hits_;
+  unsigned long Misses_;
+};
+
+// SymbolTable
+// The symbols of the affine expressions, by dense id. The symbol of a value
+// is only built, and named, when its GiNaC form is needed; until then the
+// expressions of the value only hold its id.
+class SymbolTable {
+public:
+  // The id of a symbol built elsewhere
+  unsigned getId(const GiNaC::ex& Sym) {
+    auto It = ExIds_.find(Sym);
+    if (It != ExIds_.end())
+      return It->second;
+
+    unsigned Id = Entries_.size();
+    Entry E = { NULL, Sym, true };
+    Entries_.push_back(E);
+    ExIds_[Sym] = Id;
+    return Id;
+  }
+
+  // The id of the symbol of a value
+  unsigned getId(const Value *V) {
+    auto It = ValueIds_.find(V);
+    if (It != ValueIds_.end())
+      return It->second;
+
+    unsigned Id = Entries_.size();
+    Entry E = { V, GiNaC::ex(), false };
+    Entries_.push_back(E);
+    ValueIds_[V] = Id;
+    return Id;
+  }
+
+  const GiNaC::ex& getSymbol(unsigned Id) {
+    Entry& E = Entries_[Id];
+    if (!E.Built) {
+      E.Sym = GiNaC::symbol(GetName(E.V));
+      ExIds_[E.Sym] = Id;
+      E.Built = true;
+    }
+    return E.Sym;
+  }
+
+  // The value of a symbol, if it has one in the current module
+  const Value *getValue(unsigned Id) const {
+    return Entries_[Id].V;
+  }
+
+  // Forgets the values, which may not outlive their module. The symbols
+  // not built yet get a name of their own, without looking at the value,
+  // so that the expressions holding them stay valid.
+  void clearValues() {
+    for (unsigned Id = 0, E = Entries_.size(); Id != E; ++Id) {
+      Entry& Ent = Entries_[Id];
+      if (!Ent.Built) {
+        Ent.Sym = GiNaC::symbol("__SRA_SYM_STALE__");
+        ExIds_[Ent.Sym] = Id;
+        Ent.Built = true;
+      }
+      Ent.V = NULL;
+    }
+    ValueIds_.clear();
+  }
+
+private:
+  // A symbol, built from its value if it has one
+  struct Entry {
+    const Value *V;
+    GiNaC::ex Sym;
+    bool Built;
+  };
+
+  vector<Entry> Entries_;
+  std::unordered_map<GiNaC::ex, unsigned, ExHash, ExEqual> ExIds_;
+  DenseMap<const Value*, unsigned> ValueIds_;
+
+  static string GetName(const Value *V) {
+    if (!V->hasName())
+      return "__SRA_SYM_UNAMED__";
+    if (isa<Instruction>(V) || isa<Argument>(V))
+      return V->getName().str();
+    return "__SRA_SYM_UNKNOWN_" + V->getName().str() + "__";
+  }
+};
+
+} // end anonymous namespace
+
+// Expressions may be built during the static initialization of other files
+static ExprTable& GetTable() {
+  static ExprTable Table;
+  return Table;
+}
+
+static CmpCache& GetCache() {
+  static CmpCache Cache;
+  return Cache;
+}
+
+static SymbolTable& GetSymbols() {
+  static SymbolTable Symbols;
+  return Symbols;
+}
+
+/* ************************************************************************** */
+/* ************************************************************************** */
+
+// CheckedAdd
+static bool CheckedAdd(long A, long B, long& Res) {
+  if ((B > 0 && A > LONG_MAX - B) || (B < 0 && A < LONG_MIN - B))
+    return false;
+  Res = A + B;
+  return true;
+}
+
+// CheckedMul
+static bool CheckedMul(long A, long B, long& Res) {
+  if (A > 0 ? (B > 0 ? A > LONG_MAX / B : B < LONG_MIN / A)
+            : (B > 0 ? A < LONG_MIN / B : (A != 0 && B < LONG_MAX / A)))
+    return false;
+  Res = A * B;
+  return true;
+}
+
+
+/**************
+ * AffineExpr *
+ **************/
+AffineExpr AffineExpr::GetSymbol(unsigned Id) {
+  AffineExpr Affine;
+  Affine.Terms_.push_back(Term(Id, 1));
+  return Affine;
+}
+
+bool AffineExpr::add(const AffineExpr& Other, long Scale,
+                     AffineExpr& Res) const {
+  long Const;
+  if (!CheckedMul(Other.Const_, Scale, Const) ||
+      !CheckedAdd(Const_, Const, Res.Const_))
+    return false;
+
+  // Merge the terms, both sorted by symbol
+  Res.Terms_.clear();
+  auto L = Terms_.begin(), LE = Terms_.end();
+  auto R = Other.Terms_.begin(), RE = Other.Terms_.end();
+  while (L != LE || R != RE) {
+    long Coeff;
+    if (R == RE || (L != LE && L->first < R->first)) {
+      Res.Terms_.push_back(*L++);
+      continue;
+    }
+    if (!CheckedMul(R->second, Scale, Coeff))
+      return false;
+    unsigned Id = R->first;
+    if (L != LE && L->first == Id && !CheckedAdd(L->second, Coeff, Coeff))
+      return false;
+    if (L != LE && L->first == Id)
+      ++L;
+    ++R;
+    if (Coeff != 0)
+      Res.Terms_.push_back(Term(Id, Coeff));
+  }
+  return true;
+}
+
+bool AffineExpr::scale(long Factor, AffineExpr& Res) const {
+  Res.Terms_.clear();
+  if (!CheckedMul(Const_, Factor, Res.Const_))
+    return false;
+  if (Factor == 0)
+    return true;
+  for (auto& T : Terms_) {
+    long Coeff;
+    if (!CheckedMul(T.second, Factor, Coeff))
+      return false;
+    Res.Terms_.push_back(Term(T.first, Coeff));
+  }
+  return true;
+}
+
+bool AffineExpr::operator==(const AffineExpr& Other) const {
+  return Const_ == Other.Const_ && Terms_.size() == Other.Terms_.size() &&
+         std::equal(Terms_.begin(), Terms_.end(), Other.Terms_.begin());
+}
+
+// ToAffine
+// The affine form of an expression, if it has one that fits.
+static bool ToAffine(const GiNaC::ex& Ex, AffineExpr& Affine) {
+  if (GiNaC::is_a<GiNaC::numeric>(Ex)) {
+    const GiNaC::numeric& Num = GiNaC::ex_to<GiNaC::numeric>(Ex);
+    if (!Num.is_integer() || Num > GiNaC::numeric(LONG_MAX) ||
+        Num < GiNaC::numeric(LONG_MIN))
+      return false;
+    Affine = AffineExpr(Num.to_long());
+    return true;
+  }
+
+  if (GiNaC::is_a<GiNaC::symbol>(Ex)) {
+    Affine = AffineExpr::GetSymbol(GetSymbols().getId(Ex));
+    return true;
+  }
+
+  if (GiNaC::is_a<GiNaC::add>(Ex)) {
+    AffineExpr Sum;
+    for (size_t Idx = 0, E = Ex.nops(); Idx != E; ++Idx) {
+      AffineExpr Op, Res;
+      if (!ToAffine(Ex.op(Idx), Op) || !Sum.add(Op, 1, Res))
+        return false;
+      Sum = Res;
+    }
+    Affine = Sum;
+    return true;
+  }
+
+  // A product is affine if all its factors but one are numbers
+  if (GiNaC::is_a<GiNaC::mul>(Ex)) {
+    AffineExpr Prod(1);
+    for (size_t Idx = 0, E = Ex.nops(); Idx != E; ++Idx) {
+      AffineExpr Op, Res;
+      if (!ToAffine(Ex.op(Idx), Op))
+        return false;
+      if (Op.isConstant()) {
+        if (!Prod.scale(Op.getConstant(), Res))
+          return false;
+      } else if (!Prod.isConstant() || !Op.scale(Prod.getConstant(), Res)) {
+        return false;
+      }
+      Prod = Res;
+    }
+    Affine = Prod;
+    return true;
+  }
+
+  return false;
+}
+
+// FromAffine
+static GiNaC::ex FromAffine(const AffineExpr& Affine) {
+  GiNaC::ex Ex = GiNaC::numeric(Affine.getConstant());
+  for (auto& T : Affine.getTerms())
+    Ex += GiNaC::numeric(T.second) * GetSymbols().getSymbol(T.first);
+  return Ex;
+}
+
+/* ************************************************************************** */
+/* ************************************************************************** */
+
 // Round
 static long int Round(double D) {
   return (D > 0.0) ? (D + 0.5) : (D - 0.5); 
@@ -177,16 +542,37 @@ vector<pair<GiNaC::ex, GiNaC::ex> >
   return Negs;
 }
 
-// ExIsLessThen
+// ExIsLessThanUncached
 // Tells us if an expression is less then another assuming
-// a symbol maps to a range in the map.
-bool ExIsLessThan(GiNaC::ex LHS, GiNaC::ex RHS, map<Expr, Range> Assume = map<Expr, Range>()) {
+// the symbols of the context are in their ranges.
+static bool ExIsLessThanUncached(GiNaC::ex LHS, GiNaC::ex RHS,
+                                 const AssumptionContext* Assume) {
   // Check if the substraction is a number. If so, LHS < RHS if LHS - RHS
   // is less than zero.
   GiNaC::ex Sub = (LHS - RHS).evalf();
   if (GiNaC::is_a<GiNaC::numeric>(Sub))
     return GiNaC::ex_to<GiNaC::numeric>(Sub).is_negative();
 
+  // If LHS - RHS is linear in the assumed symbols, with numeric
+  // coefficients, its greatest value is at a bound of each of them.
+  if (Assume && !Assume->empty()) {
+    GiNaC::exmap Subs;
+    for (auto& P : Assume->getUpperSubs()) {
+      if (!Sub.has(P.first))
+        continue;
+      GiNaC::ex Coeff = Sub.coeff(P.first, 1);
+      if (Sub.degree(P.first) != 1 || !GiNaC::is_a<GiNaC::numeric>(Coeff))
+        return false;
+      Subs[P.first] = GiNaC::ex_to<GiNaC::numeric>(Coeff).is_positive()
+                          ? P.second
+                          : Assume->getLowerSubs().find(P.first)->second;
+    }
+
+    GiNaC::ex Bound = Sub.subs(Subs).evalf();
+    if (GiNaC::is_a<GiNaC::numeric>(Bound))
+      return GiNaC::ex_to<GiNaC::numeric>(Bound).is_negative();
+  }
+
   /* auto Syms = GetSymbols(Sub);
   if (Syms.empty())
     return false;
@@ -210,8 +596,20 @@ bool ExIsLessThan(GiNaC::ex LHS, GiNaC::ex RHS, map<Expr, Range> Assume = map<Ex
   return false;
 }
 
-static bool ExIsGreaterThan(GiNaC::ex LHS, GiNaC::ex RHS) {
-  assert(false);
+// ExIsLessThan
+static bool ExIsLessThan(GiNaC::ex LHS, GiNaC::ex RHS,
+                         const AssumptionContext* Assume = NULL) {
+  if (ExprCacheSize == 0)
+    return ExIsLessThanUncached(LHS, RHS, Assume);
+
+  unsigned long Context = Assume ? Assume->getId() : 0;
+  bool Result;
+  if (GetCache().lookup(LHS, RHS, Context, Result))
+    return Result;
+
+  Result = ExIsLessThanUncached(LHS, RHS, Assume);
+  GetCache().insert(LHS, RHS, Context, Result);
+  return Result;
 }
 
 /* ************************************************************************** */
@@ -220,56 +618,79 @@ static bool ExIsGreaterThan(GiNaC::ex LHS, GiNaC::ex RHS) {
 /*********
  * Expr *
  *********/
-Expr::Expr() {
+Expr::Expr()
+  : HasExpr_(true), Affine_(0), IsAffine_(ExprAffine) {
 }
 
 Expr::Expr(int Int)
-  : Expr_(Int) {
+  : Expr_(Int), HasExpr_(true), Affine_(Int), IsAffine_(ExprAffine) {
 }
 
 Expr::Expr(APInt Int)
-  : Expr_((long int)Int.getSExtValue()) {
+  : Expr_((long int)Int.getSExtValue()), HasExpr_(true),
+    Affine_(Int.getSExtValue()), IsAffine_(ExprAffine) {
 }
 
 Expr::Expr(GiNaC::ex Expr)
-  : Expr_(Expr) {
+  : Expr_(GetTable().intern(Expr)), HasExpr_(true) {
+  setAffine();
 }
 
 Expr::Expr(Twine Name)
-  : Expr_(GiNaC::symbol(Name.str())) {
+  : Expr_(GiNaC::symbol(Name.str())), HasExpr_(true) {
+  setAffine();
 }
 
-static DenseMap<const Value*, GiNaC::ex> Exprs;
-Expr::Expr(const Value *V) {
+Expr::Expr(const AffineExpr& Affine)
+  : HasExpr_(false), Affine_(Affine), IsAffine_(true) {
+}
+
+Expr::Expr(const Value *V)
+  : HasExpr_(true) {
   assert(V && "Constructor expected non-null parameter");
   
   if (const ConstantInt *CI = dyn_cast<ConstantInt>(V)) {
     Expr_ = GiNaC::ex((long int)CI->getValue().getSExtValue());
+    setAffine();
     return;
   }
 
-  if (Exprs.count(V)) {
-    Expr_ = Exprs[V];
+  unsigned Id = GetSymbols().getId(V);
+  if (ExprAffine) {
+    HasExpr_ = false;
+    Affine_ = AffineExpr::GetSymbol(Id);
+    IsAffine_ = true;
     return;
   }
 
-  Twine Name;
-  if (V->hasName()) {
-    if (isa<const Instruction>(V) || isa<const Argument>(V))
-      Name = V->getName();
-    else
-      Name = "__SRA_SYM_UNKNOWN_" + V->getName() + "__";
-  } else {
-    Name = "__SRA_SYM_UNAMED__";
-  }
+  Expr_ = GetSymbols().getSymbol(Id);
+  IsAffine_ = false;
+}
+
+GiNaC::ex Expr::GetSymbol(const Value *V) {
+  return GetSymbols().getSymbol(GetSymbols().getId(V));
+}
 
-  std::string NameStr = Name.str();
-  Expr_ = GiNaC::ex(GiNaC::symbol(NameStr));
-  Exprs[V] = Expr_;
+void Expr::ClearValueSymbols() {
+  GetSymbols().clearValues();
+}
+
+const Value *Expr::GetSymbolValue(unsigned Id) {
+  return GetSymbols().getValue(Id);
+}
+
+bool Expr::getAffine(AffineExpr& Affine) const {
+  if (IsAffine_)
+    Affine = Affine_;
+  return IsAffine_;
+}
+
+void Expr::setAffine() {
+  IsAffine_ = ExprAffine && ToAffine(Expr_, Affine_);
 }
 
 Expr Expr::subs(std::vector<std::pair<Expr, Expr> > Subs) { 
-  GiNaC::ex Ex = Expr_;
+  GiNaC::ex Ex = getExpr();
   for (auto& E : Subs) {
     //dbgs() << "Replacing " << E.first.getExpr() << " with " << E.second.getExpr() << " in " << Ex;
     Ex = Ex.subs(E.first.getExpr() == E.second.getExpr());
@@ -278,31 +699,78 @@ Expr Expr::subs(std::vector<std::pair<Expr, Expr> > Subs) {
   return Expr(Ex);
 }
 
-bool Expr::lt(const Expr& Other, std::map<Expr, Range> Assume) const {
-  //for (auto& P : Assume)
-  //  assert(GiNaC::is_a<GiNaC::symbol>(P.first.getExpr()) &&
-  //         "Assumptions must map symbols to range");
-  return ExIsLessThan(Expr_, Other.getExpr()); 
+bool Expr::has(const Expr& Sym) const {
+  if (IsAffine_ && Sym.IsAffine_ && Sym.Affine_.getConstant() == 0 &&
+      Sym.Affine_.getTerms().size() == 1 &&
+      Sym.Affine_.getTerms()[0].second == 1) {
+    unsigned Id = Sym.Affine_.getTerms()[0].first;
+    for (auto& T : Affine_.getTerms())
+      if (T.first == Id)
+        return true;
+    return false;
+  }
+  return getExpr().has(Sym.getExpr());
 }
 
+// AffineLessThan
+// Without assumptions GiNaC only decides LHS < RHS when LHS - RHS is a
+// number, so the affine forms decide it whenever they can be subtracted.
+bool Expr::AffineLessThan(const Expr& LHS, const Expr& RHS, long Bias,
+                          bool& Result) {
+  if (!LHS.IsAffine_ || !RHS.IsAffine_)
+    return false;
+
+  AffineExpr Sub;
+  if (!LHS.Affine_.add(RHS.Affine_, -1, Sub))
+    return false;
+  Result = Sub.isConstant() && Sub.getConstant() < Bias;
+  return true;
+}
+
+bool Expr::lt(const Expr& Other) const {
+  bool Result;
+  if (AffineLessThan(*this, Other, 0, Result))
+    return Result;
+  return ExIsLessThan(getExpr(), Other.getExpr()); 
+}
+
+bool Expr::lt(const Expr& Other, const AssumptionContext& Assume) const {
+  bool Result;
+  if (Assume.empty() && AffineLessThan(*this, Other, 0, Result))
+    return Result;
+  return ExIsLessThan(getExpr(), Other.getExpr(), &Assume); 
+}
+
+// The bounds are integers, so a <= b is a < b + 1.
 bool Expr::le(const Expr& Other) const {
-  return ExIsLessThan(Expr_, Other.getExpr() = 1);
+  bool Result;
+  if (AffineLessThan(*this, Other, 1, Result))
+    return Result;
+  return ExIsLessThan(getExpr(), Other.getExpr() + 1);
 }
 
 bool Expr::gt(const Expr& Other) const {
-  return ExIsGreaterThan(Expr_, Other.getExpr());
+  bool Result;
+  if (AffineLessThan(Other, *this, 0, Result))
+    return Result;
+  return ExIsLessThan(Other.getExpr(), getExpr());
 }
 
 bool Expr::ge(const Expr& Other) const {
-  return ExIsGreaterThan(Expr_, Other.getExpr() + 1);
+  bool Result;
+  if (AffineLessThan(Other, *this, 1, Result))
+    return Result;
+  return ExIsLessThan(Other.getExpr(), getExpr() + 1);
 }
 
 bool Expr::eq(const Expr& Other) const {
-  return Expr_.is_equal(Other.getExpr());
+  if (IsAffine_ && Other.IsAffine_)
+    return Affine_ == Other.Affine_;
+  return getExpr().is_equal(Other.getExpr());
 }
 
 bool Expr::ne(const Expr& Other) const {
-  return !Expr_.is_equal(Other.getExpr());
+  return !eq(Other);
 }
 
 bool Expr::operator==(const Expr& Other) const {
@@ -334,16 +802,16 @@ Expr Expr::min(const Expr& Other) const {
     return *this;
   else if (*this == GetBottomValue())
     return Other;
-  if (ExIsLessThan(Expr_, Other.getExpr()))
-    return Expr_;
-  else if (ExIsLessThan(Other.getExpr(), Expr_))
-    return Other.getExpr();
-  else if (GiNaC::is_a<GiNaC::numeric>(Expr_))
-    return Expr_;
-  else if (GiNaC::is_a<GiNaC::numeric>(Other.getExpr()))
-    return Other.getExpr();
+  if (lt(Other))
+    return *this;
+  else if (Other.lt(*this))
+    return Other;
+  else if (isNumber())
+    return *this;
+  else if (Other.isNumber())
+    return Other;
     
-  GiNaC::ex Res = GiNaC::min(Expr_, Other.getExpr());
+  GiNaC::ex Res = GiNaC::min(getExpr(), Other.getExpr());
   EXPR_DEBUG(dbgs() << "min(): " << *this << " :: " << Other
                     << " = " << Res << "\n");
   return Expr(Res);
@@ -355,31 +823,37 @@ Expr Expr::max(const Expr& Other) const {
   else if (*this == GetBottomValue())
     return Other;
 
-  if (ExIsLessThan(Expr_, Other.getExpr()))
-    return Expr_;
-  else if (ExIsLessThan(Other.getExpr(), Expr_))
-    return Expr_;
-  else if (GiNaC::is_a<GiNaC::numeric>(Expr_))
-    return Other.getExpr();
-  else if (GiNaC::is_a<GiNaC::numeric>(Other.getExpr()))
-    return Other.getExpr();
+  if (lt(Other))
+    return *this;
+  else if (Other.lt(*this))
+    return *this;
+  else if (isNumber())
+    return Other;
+  else if (Other.isNumber())
+    return Other;
 
-  return Expr(GiNaC::max(Expr_, Other.getExpr()));
+  return Expr(GiNaC::max(getExpr(), Other.getExpr()));
 }
 
 bool Expr::isNegative() const {
+  if (IsAffine_)
+    return Affine_.isConstant() && Affine_.getConstant() < 0;
   if (GiNaC::is_a<GiNaC::numeric>(Expr_))
     return GiNaC::ex_to<GiNaC::numeric>(Expr_).is_negative();
   return isMinusInf();
 }
 
 bool Expr::isNonNegative() const {
+  if (IsAffine_)
+    return Affine_.isConstant() && Affine_.getConstant() >= 0;
   if (GiNaC::is_a<GiNaC::numeric>(Expr_))
     return !GiNaC::ex_to<GiNaC::numeric>(Expr_).is_negative();
   return isPlusInf();
 }
 
 bool Expr::isNotPositive() const {
+  if (IsAffine_)
+    return Affine_.isConstant() && Affine_.getConstant() <= 0;
   if (GiNaC::is_a<GiNaC::numeric>(Expr_))
     return !GiNaC::ex_to<GiNaC::numeric>(Expr_).is_positive();
   if (isPlusInf())
@@ -390,6 +864,8 @@ bool Expr::isNotPositive() const {
 }
 
 bool Expr::isStrictlyPositive() const {
+  if (IsAffine_)
+    return Affine_.isConstant() && Affine_.getConstant() > 0;
   if (GiNaC::is_a<GiNaC::numeric>(Expr_))
     return GiNaC::ex_to<GiNaC::numeric>(Expr_).is_positive();
   if (isPlusInf())
@@ -398,6 +874,8 @@ bool Expr::isStrictlyPositive() const {
 }
 
 bool Expr::isPlusInf() const {
+  if (IsAffine_)
+    return false;
   if (GiNaC::is_a<GiNaC::function>(Expr_)) {
     GiNaC::function Fn = GiNaC::ex_to<GiNaC::function>(Expr_);
     return Fn.get_name() == "inf" &&
@@ -407,6 +885,8 @@ bool Expr::isPlusInf() const {
 }
 
 bool Expr::isMinusInf() const {
+  if (IsAffine_)
+    return false;
   if (GiNaC::is_a<GiNaC::function>(Expr_)) {
     GiNaC::function Fn = GiNaC::ex_to<GiNaC::function>(Expr_);
     return Fn.get_name() == "inf" &&
@@ -416,39 +896,65 @@ bool Expr::isMinusInf() const {
 }
 
 bool Expr::isNumber() const {
+  if (IsAffine_)
+    return Affine_.isConstant();
   return GiNaC::is_a<GiNaC::numeric>(Expr_);
 }
 
 Expr Expr::operator+(const Expr& Other) const {
-  return Expr_ + Other.getExpr();
+  AffineExpr Res;
+  if (IsAffine_ && Other.IsAffine_ && Affine_.add(Other.Affine_, 1, Res))
+    return Expr(Res);
+  return getExpr() + Other.getExpr();
 }
 
 Expr Expr::operator+(unsigned Other) const {
-  return Expr_ + Other;
+  AffineExpr Res;
+  if (IsAffine_ && Affine_.add(AffineExpr(Other), 1, Res))
+    return Expr(Res);
+  return getExpr() + Other;
 }
 
 Expr Expr::operator-(const Expr& Other) const {
-  return Expr_ - Other.getExpr();
+  AffineExpr Res;
+  if (IsAffine_ && Other.IsAffine_ && Affine_.add(Other.Affine_, -1, Res))
+    return Expr(Res);
+  return getExpr() - Other.getExpr();
 }
 
 Expr Expr::operator-(unsigned Other) const {
-  return Expr_ - Other;
+  AffineExpr Res;
+  if (IsAffine_ && Affine_.add(AffineExpr(Other), -1, Res))
+    return Expr(Res);
+  return getExpr() - Other;
 }
 
 Expr Expr::operator*(const Expr& Other) const {
-  return Expr_ * Other.getExpr();
+  AffineExpr Res;
+  if (IsAffine_ && Other.IsAffine_) {
+    if (Other.Affine_.isConstant() &&
+        Affine_.scale(Other.Affine_.getConstant(), Res))
+      return Expr(Res);
+    if (Affine_.isConstant() &&
+        Other.Affine_.scale(Affine_.getConstant(), Res))
+      return Expr(Res);
+  }
+  return getExpr() * Other.getExpr();
 }
 
 Expr Expr::operator*(unsigned Other) const {
-  return Expr_ * Other;
+  AffineExpr Res;
+  if (IsAffine_ && Affine_.scale(Other, Res))
+    return Expr(Res);
+  return getExpr() * Other;
 }
 
 Expr Expr::operator/(const Expr& Other) const {
-  return Expr_/Other.getExpr();
+  return getExpr()/Other.getExpr();
 }
 
 Expr Expr::operator/(unsigned Other) const {
-  return Expr_/Other;
+  return getExpr()/Other;
 }
 
 Expr Expr::GetPlusInfValue() {
@@ -472,10 +978,17 @@ Expr Expr::GetBottomValue() {
 }
 
 GiNaC::ex Expr::getExpr() const {
+  if (!HasExpr_) {
+    Expr_ = GetTable().intern(FromAffine(Affine_));
+    HasExpr_ = true;
+  }
   return Expr_;
 }
 
 int Expr::getMaxDegree() const {
+  if (IsAffine_)
+    return Affine_.isConstant() ? 0 : 1;
+
   int Max = 0;
   for (auto It = Expr_.preorder_begin(), E = Expr_.preorder_end();
        It != E; ++It) {
@@ -490,10 +1003,50 @@ int Expr::getMaxDegree() const {
 
 string Expr::getStringRepr() const {
   std::ostringstream Str;
-  Str << Expr_;
+  Str << getExpr();
   return Str.str();
 }
 
+/*********************
+ * AssumptionContext *
+ *********************/
+void AssumptionContext::newId() {
+  static unsigned long NextId = 0;
+  Id_ = Stack_.empty() ? 0 : ++NextId;
+}
+
+void AssumptionContext::push(const Expr& Sym, const Expr& Lower,
+                             const Expr& Upper) {
+  assert(GiNaC::is_a<GiNaC::symbol>(Sym.getExpr()) &&
+         "Assumptions must map symbols to range");
+  Assumption A = { Sym.getExpr(), Lower.getExpr(), Upper.getExpr() };
+  Stack_.push_back(A);
+  Lower_[A.Sym] = A.Lower;
+  Upper_[A.Sym] = A.Upper;
+  newId();
+}
+
+void AssumptionContext::push(const Expr& Sym, const Range& R) {
+  push(Sym, R.getLower(), R.getUpper());
+}
+
+void AssumptionContext::pop() {
+  assert(!Stack_.empty() && "No assumption to pop");
+  GiNaC::ex Sym = Stack_.back().Sym;
+  Stack_.pop_back();
+  Lower_.erase(Sym);
+  Upper_.erase(Sym);
+
+  // An earlier assumption on the same symbol holds again
+  for (auto It = Stack_.rbegin(), E = Stack_.rend(); It != E; ++It)
+    if (It->Sym.is_equal(Sym)) {
+      Lower_[Sym] = It->Lower;
+      Upper_[Sym] = It->Upper;
+      break;
+    }
+  newId();
+}
+
 namespace llvm {
 
 raw_ostream& operator<<(raw_ostream& OS, const GiNaC::ex &E) {
@@ -2,6 +2,7 @@
 #define _ENCAPSEXPR_H_
 
 #include "llvm/Pass.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Debug.h"
 
@@ -24,6 +25,37 @@ using std::pair;
 using std::string;
 using std::vector;
 
+class AssumptionContext;
+
+// AffineExpr
+// A linear combination of symbols with integer coefficients, plus a
+// constant: the form of most bounds, kept apart from GiNaC. The operations
+// fail, and leave the expression to GiNaC, when a number overflows.
+class AffineExpr {
+public:
+  // Symbol id, coefficient
+  typedef pair<unsigned, long> Term;
+
+  explicit AffineExpr(long Const = 0) : Const_(Const) { }
+  static AffineExpr GetSymbol(unsigned Id);
+
+  // Res = this + Scale * Other; Res must be another expression
+  bool add  (const AffineExpr& Other, long Scale, AffineExpr& Res) const;
+  // Res = Factor * this
+  bool scale(long Factor, AffineExpr& Res) const;
+
+  bool isConstant()  const { return Terms_.empty(); }
+  long getConstant() const { return Const_; }
+  const SmallVectorImpl<Term>& getTerms() const { return Terms_; }
+
+  bool operator==(const AffineExpr& Other) const;
+
+private:
+  // Sorted by symbol id, without zero coefficients
+  SmallVector<Term, 4> Terms_;
+  long Const_;
+};
+
 class Expr {
 public:
   Expr();
@@ -34,9 +66,10 @@ public:
   Expr(const Value *V);
 
   Expr subs(vector<pair<Expr, Expr> > Subs); 
+  bool has (const Expr& Sym) const;
 
-  bool lt        (const Expr& Other,
-                  map<Expr, Range> Assume = map<Expr, Range>()) const;
+  bool lt        (const Expr& Other) const;
+  bool lt        (const Expr& Other, const AssumptionContext& Assume) const;
   bool gt        (const Expr& Other) const;
   bool le        (const Expr& Other) const;
   bool ge        (const Expr& Other) const;
@@ -71,7 +104,14 @@ public:
   bool isMinusInf()         const;
   bool isNumber()           const;
 
-  static GiNaC::symbol& GetSymbol(const Value *V);
+  static GiNaC::ex GetSymbol(const Value *V);
+  // Forgets the values of a module; their expressions stay valid.
+  static void ClearValueSymbols();
+  // The value of a symbol of the affine form, NULL if it has none
+  static const Value *GetSymbolValue(unsigned Id);
+
+  // The affine form, if the expression has one
+  bool getAffine(AffineExpr& Affine) const;
 
   static Expr           GetZeroValue();
   static Expr           GetPlusInfValue();
@@ -82,13 +122,61 @@ public:
   static Expr Max(Expr L, Expr R);
 
   friend raw_ostream& operator<<(raw_ostream& OS, const Expr& EI);
-  friend bool ExIsLessThan(Expr LHS, Expr RHS, map<Expr, Range> Assume); 
+  friend class AssumptionContext;
 
 protected:
   GiNaC::ex getExpr() const;
 
 private:
-  GiNaC::ex Expr_;
+  // The GiNaC form of an affine expression is only built when needed.
+  mutable GiNaC::ex Expr_;
+  mutable bool HasExpr_;
+  AffineExpr Affine_;
+  bool IsAffine_;
+
+  explicit Expr(const AffineExpr& Affine);
+  void setAffine();
+
+  // Decides LHS - RHS < Bias on the affine forms, if it can.
+  static bool AffineLessThan(const Expr& LHS, const Expr& RHS, long Bias,
+                             bool& Result);
+};
+
+// AssumptionContext
+// Ranges that comparisons may assume for some symbols. A query site builds
+// one, pushes and pops assumptions around its comparisons, and passes it by
+// reference. The substitutions of the symbols by their bounds are computed
+// when the assumptions are pushed.
+class AssumptionContext {
+public:
+  AssumptionContext() : Id_(0) { }
+
+  void push(const Expr& Sym, const Expr& Lower, const Expr& Upper);
+  void push(const Expr& Sym, const Range& R);
+  void pop();
+
+  bool     empty() const { return Stack_.empty(); }
+  unsigned size()  const { return Stack_.size(); }
+
+  // Tells apart the states of every context, for the comparison cache;
+  // 0 is no assumptions.
+  unsigned long getId() const { return Id_; }
+
+  // The symbols and their bounds, the last push of each symbol first.
+  const GiNaC::exmap& getLowerSubs() const { return Lower_; }
+  const GiNaC::exmap& getUpperSubs() const { return Upper_; }
+
+private:
+  struct Assumption {
+    GiNaC::ex Sym, Lower, Upper;
+  };
+
+  vector<Assumption> Stack_;
+  GiNaC::exmap Lower_;
+  GiNaC::exmap Upper_;
+  unsigned long Id_;
+
+  void newId();
 };
 
 class TestExpr : public ModulePass {
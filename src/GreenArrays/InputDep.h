@@ -1,41 +0,0 @@
-#ifndef __INPUTDEP_H__
-#define __INPUTDEP_H__
-
-#include "llvm/Pass.h"
-#include "llvm/IR/Function.h"
-#include "llvm/IR/BasicBlock.h"
-#include "llvm/IR/Instruction.h"
-#include "llvm/IR/User.h"
-#include "llvm/Support/raw_ostream.h"
-#include "llvm/Support/Debug.h"
-#include "llvm/DebugInfo.h"
-#include "llvm/ADT/Statistic.h"
-#include "llvm/ADT/ilist.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/ADT/SmallPtrSet.h"
-#include "llvm/IR/Metadata.h"
-#include "llvm/PassAnalysisSupport.h"
-#include "llvm/IR/Function.h"
-#include "DepGraph.h"
-#include "llvm/ADT/StringRef.h"
-#include<set>
-
-using namespace llvm;
-
-
-class InputDep : public ModulePass {
-	private:
-		std::set<Value*> inputDepValues;
-		std::map<Value*, int> lineNo;
-		bool runOnModule(Module &M);
-	public:
-		static char ID; // Pass identification, replacement for typeid.
-		InputDep();
-		void getAnalysisUsage(AnalysisUsage &AU) const;
-		bool isInputDependent(Value* V);
-		std::set<Value*> getInputDepValues();
-		int getLineNo(Value*);
-		void printer();
-};
-
-#endif
@@ -0,0 +1,51 @@
+//===---------------------------- LoopChecks.cpp --------------------------===//
+//===----------------------------------------------------------------------===//
+// The loop tests of the two sanitizers. See LoopChecks.h.
+//===----------------------------------------------------------------------===//
+
+#include "LoopChecks.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/CallSite.h"
+
+using namespace llvm;
+
+Value *llvm::stripCopies(Value *V) {
+  while (true) {
+    if (SExtInst *SI = dyn_cast<SExtInst>(V)) {
+      V = SI->getOperand(0);
+    } else if (PHINode *Phi = dyn_cast<PHINode>(V)) {
+      if (Phi->getNumIncomingValues() != 1)
+        return V;
+      V = Phi->getIncomingValue(0);
+    } else {
+      return V;
+    }
+  }
+}
+
+bool llvm::isUnitStrideIndex(Value *V, Loop *L) {
+  PHINode *Phi = dyn_cast<PHINode>(stripCopies(V));
+  if (!Phi || Phi->getParent() != L->getHeader() ||
+      Phi->getNumIncomingValues() != 2)
+    return false;
+  Value *Next = stripCopies(Phi->getIncomingValueForBlock(L->getLoopLatch()));
+  BinaryOperator *BO = dyn_cast<BinaryOperator>(Next);
+  if (!BO || BO->getOpcode() != Instruction::Add)
+    return false;
+  ConstantInt *Step = dyn_cast<ConstantInt>(BO->getOperand(1));
+  return Step && Step->isOne() && stripCopies(BO->getOperand(0)) == Phi;
+}
+
+bool llvm::hasCalls(Loop *L) {
+  for (Loop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI)
+    for (BasicBlock::iterator II = (*BI)->begin(), IE = (*BI)->end();
+         II != IE; ++II) {
+      CallSite CS(II);
+      if (CS && !isa<IntrinsicInst>(II))
+        return true;
+    }
+  return false;
+}
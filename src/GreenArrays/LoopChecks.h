@@ -0,0 +1,30 @@
+//===----------------------------- LoopChecks.h ---------------------------===//
+//===----------------------------------------------------------------------===//
+// The loop tests that AddressSanitizer and OverflowSanitizer share to hoist
+// a check to the preheader: the check then covers the whole range of an
+// induction variable, which holds only if the loop counts up by one and
+// no call can leave it, or free its memory, before the last iteration.
+//===----------------------------------------------------------------------===//
+#ifndef LOOPCHECKS_H_
+#define LOOPCHECKS_H_
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Value.h"
+
+namespace llvm {
+
+// Looks through sign extensions and the copies that live-range splitting
+// inserts (single-entry phis).
+Value *stripCopies(Value *V);
+
+// Is V the induction variable of L, counting up by one? An instruction on V
+// then sees every value of its range, the bounds included.
+bool isUnitStrideIndex(Value *V, Loop *L);
+
+// Does L call a function other than an intrinsic? The call may leave the
+// loop (exit, longjmp) or free the memory after the check in the preheader.
+bool hasCalls(Loop *L);
+
+}
+
+#endif /* LOOPCHECKS_H_ */
@@ -7,11 +7,44 @@
 #define DEBUG_TYPE "OverflowSanitizer"
 
 #include "OverflowSanitizer.h"
+#include "LoopChecks.h"
+#include "SiteCounters.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/Support/Debug.h"
+#include "../PassProfile/PassProfile.h"
 
 using namespace std;
 #define InsertAborts true
 #define TruncInstrumentation true
 #define InsertFprintfs false
+
+static cl::opt<bool, false> DeferredChecks("overflow-sanitizer-deferred",
+		cl::desc("Check the overflows of each basic block together, before "
+			"side effects, loads and divisions and at its end."), cl::NotHidden);
+
+static cl::opt<bool, false> UseRanges("overflow-sanitizer-ranges",
+		cl::desc("Use the symbolic ranges to remove checks, and to check loops "
+			"once, before they run."), cl::NotHidden);
+
+static cl::opt<unsigned, false> SamplePeriod("overflow-sanitizer-sample",
+		cl::desc("Check each site once every N executions (N > 1), or every "
+			"OVERFLOW_SANITIZER_SAMPLE executions if set at run time."),
+		cl::NotHidden, cl::init(0));
+
+static cl::opt<bool, false> UseIntrinsics("overflow-sanitizer-intrinsics",
+		cl::desc("Check additions, subtractions and multiplications with the "
+			"llvm.*.with.overflow intrinsics."), cl::NotHidden, cl::init(true));
+
+static cl::opt<bool, false> UseTaint("overflow-sanitizer-taint",
+		cl::desc("Check only the instructions that the input may influence: "
+			"those -tainted-annotate doesn't tag as untainted."), cl::NotHidden);
+
+static cl::opt<std::string, false> SiteCountsReport("overflow-sanitizer-site-counts",
+		cl::desc("Count the executions of each may-overflow instruction at "
+			"run time, into <file>.counts, and write its sites to this file "
+			"(see SiteCounters.h)"), cl::NotHidden);
+
 //Table 2
 STATISTIC(NumInstructionsBefore , "Number of Instructions Before Instrumentation");
 STATISTIC(NumOvfInstructions , "Number of may-overflow Instructions");
@@ -19,6 +52,9 @@ STATISTIC(NumInstrumentedInsts , "Number of instrumented Instructions");
 STATISTIC(NumInstructionsAfter , "Number of Instructions After Instrumentation");
 STATISTIC(NumTainted, "Number of tainted graph nodes");
 STATISTIC(NumClean, "Number of clean graph nodes");
+STATISTIC(NumProvenSafe, "Number of instructions proven not to overflow");
+STATISTIC(NumHoistedChecks, "Number of checks hoisted out of loops");
+STATISTIC(NumUntainted, "Number of instructions the input can't influence");
 
 /*
  * 	Instructions that may cause an overflow
@@ -81,34 +117,162 @@ bool basicBlockSearch(BasicBlock* src, BasicBlock* dst,
 
 }
 
-BasicBlock* OverflowSanitizer::newOverflowOccurrenceBlock(Instruction* I,
-		BasicBlock* NextBlock, Value *messagePtr) {
+/*
+ * The overflow handler of F: a single, out of line block shared by every
+ * check of F. It receives the site ID of the failing check in a PHI node,
+ * reports it and aborts (or, without aborts, goes back to the check's
+ * continuation).
+ */
+BasicBlock* OverflowSanitizer::getAbortBlock(Function* F) {
+
+	if (abortBlocks.count(F))
+		return abortBlocks[F];
+
+	// Create the basic block which the control flow goes to when the assertion fail
+	BasicBlock* AbortBB = BasicBlock::Create(*context, "assert fail", F);
 
-	Constant* SourceFile = getSourceFile(I);
-	Constant* LineNumber = getLineNumber(I);
-	//	Constant* InstructionIdentifier = ConstantInt::get(Type::getInt32Ty(*context), (int)I);
+	// Call to abort function
+	CallInst *abort = CallInst::Create(AbortF, Twine(), AbortBB);
 
+	// Add attributes to the abort call instruction: no return and no unwind
+	abort->addAttribute(~0, Attribute::NoReturn);
+	abort->addAttribute(~0, Attribute::NoUnwind);
 
-	BasicBlock* result = BasicBlock::Create(*context, "",
-			I->getParent()->getParent(), NextBlock);
-	BranchInst* branch = BranchInst::Create(NextBlock, result);
+	// Unreachable instruction
+	new UnreachableInst(*context, AbortBB);
+
+	abortBlocks[F] = AbortBB;
+	return AbortBB;
+}
+
+BasicBlock* OverflowSanitizer::getOverflowHandler(Function* F) {
+
+	if (handlerBlocks.count(F))
+		return handlerBlocks[F];
+
+	// Appended to F, so that it is laid out after the hot code
+	BasicBlock* result = BasicBlock::Create(*context, "overflow handler", F);
+	PHINode* site = PHINode::Create(Type::getInt32Ty(*context), 0, "site",
+			result);
 
 	if (InsertFprintfs) {
-		Value* vStderr = new LoadInst(GVstderr, "loadstderr", branch);
-
-		std::vector<Value*> args;
-		args.push_back(vStderr);
-		args.push_back(messagePtr);
-		args.push_back(SourceFile);
-		args.push_back(LineNumber);
-		//		args.push_back(InstructionIdentifier);
-		ArrayRef<Value*> ARargs(args);
-		CallInst::Create(FPrintF, ARargs, "", branch);
+		CallInst* report = CallInst::Create(ReportF, site, "", result);
+		report->addAttribute(~0, Attribute::NoUnwind);
 	}
 
+	if (InsertAborts)
+		BranchInst::Create(getAbortBlock(F), result);
+
+	handlerBlocks[F] = result;
 	return result;
 }
 
+/*
+ * Terminates InsertAtEnd with a branch to the overflow handler, when
+ * hasIntegerBug, or to Continue. The branch gets a new site ID, whose entry
+ * of the site table has the source location and opcode of I.
+ */
+void OverflowSanitizer::branchOnOverflow(Instruction* I, Value* hasIntegerBug,
+		OvfSiteKind kind, BasicBlock* Continue, BasicBlock* InsertAtEnd) {
+
+	BasicBlock* handler = getOverflowHandler(InsertAtEnd->getParent());
+	PHINode* site = cast<PHINode> (handler->begin());
+
+	ConstantInt* siteID = ConstantInt::get(Type::getInt32Ty(*context),
+			sites.size());
+	Constant* fields[] = { ConstantInt::get(Type::getInt32Ty(*context),
+			getSourceFile(I)), ConstantInt::get(Type::getInt32Ty(*context),
+			getLineNumber(I)), ConstantInt::get(Type::getInt16Ty(*context),
+			I->getOpcode()), ConstantInt::get(Type::getInt16Ty(*context), kind) };
+	sites.push_back(ConstantStruct::getAnon(*context, fields));
+
+	site->addIncoming(siteID, InsertAtEnd);
+
+	if (!InsertAborts) {
+		// Go back to the continuation of the check, through a switch on the site
+		SwitchInst* back = dyn_cast_or_null<SwitchInst> (
+				handler->getTerminator());
+		if (!back)
+			back = SwitchInst::Create(site, Continue, 0, handler);
+		back->addCase(siteID, Continue);
+	}
+
+	setColdBranch(BranchInst::Create(handler, Continue, hasIntegerBug,
+			InsertAtEnd));
+}
+
+/*
+ * Marks the true successor of branch as almost never taken, so that the code
+ * generator moves it out of line.
+ */
+void OverflowSanitizer::setColdBranch(BranchInst* branch) {
+	MDBuilder MDB(*context);
+	branch->setMetadata(LLVMContext::MD_prof, MDB.createBranchWeights(1,
+			1U << 20));
+}
+
+/*
+ * Defines the report function, called by the overflow handlers with the
+ * site ID of the failing check. It decodes the entry of the site in the site
+ * table: the message of its kind and its file name are found in the string
+ * table, one global for every string of the module.
+ */
+void OverflowSanitizer::createReportFunction() {
+
+	Type* Int32Ty = Type::getInt32Ty(*context);
+	Type* Int16Ty = Type::getInt16Ty(*context);
+
+	// file (offset in the string table), line, opcode, kind
+	Type* siteTy = StructType::get(Int32Ty, Int32Ty, Int16Ty, Int16Ty, NULL);
+	ArrayType* tableTy = ArrayType::get(siteTy, sites.size());
+	GlobalVariable* table = new GlobalVariable(*module, tableTy, true,
+			llvm::GlobalValue::InternalLinkage,
+			ConstantArray::get(tableTy, sites), "OverflowSites");
+
+	Constant* stringConstant = ConstantDataArray::getString(*context, strings,
+			false);
+	GlobalVariable* stringTable = new GlobalVariable(*module,
+			stringConstant->getType(), true,
+			llvm::GlobalValue::InternalLinkage, stringConstant,
+			"OverflowStrings");
+
+	Constant* messagesConstant = ConstantDataArray::get(*context, ArrayRef<
+			uint32_t> (messageOffsets, NumSiteKinds));
+	GlobalVariable* messages = new GlobalVariable(*module,
+			messagesConstant->getType(), true,
+			llvm::GlobalValue::InternalLinkage, messagesConstant,
+			"OverflowMessages");
+
+	BasicBlock* entry = BasicBlock::Create(*context, "", ReportF);
+	Value* site = ReportF->arg_begin();
+	Value* fields[4];
+	for (unsigned field = 0; field < 4; field++) {
+		Value* idx[] = { ConstantInt::get(Int32Ty, 0), site, ConstantInt::get(
+				Int32Ty, field) };
+		Value* ptr = GetElementPtrInst::CreateInBounds(table, idx, "", entry);
+		fields[field] = new LoadInst(ptr, "", entry);
+	}
+
+	Value* idx[] = { ConstantInt::get(Int32Ty, 0), new ZExtInst(fields[3],
+			Int32Ty, "", entry) };
+	Value* message = new LoadInst(GetElementPtrInst::CreateInBounds(messages,
+			idx, "", entry), "", entry);
+	idx[1] = message;
+	message = GetElementPtrInst::CreateInBounds(stringTable, idx, "", entry);
+	idx[1] = fields[0];
+	Value* file = GetElementPtrInst::CreateInBounds(stringTable, idx, "", entry);
+
+	std::vector<Value*> args;
+	args.push_back(new LoadInst(GVstderr, "loadstderr", entry));
+	args.push_back(message);
+	args.push_back(file);
+	args.push_back(fields[1]);
+	args.push_back(site);
+	CallInst::Create(FPrintF, args, "", entry);
+
+	ReturnInst::Create(*context, entry);
+}
+
 int llvm::OverflowSanitizer::countInstructions() {
 
 	int result = 0;
@@ -147,6 +311,8 @@ int llvm::OverflowSanitizer::countOverflowableInsts() {
 
 bool ::OverflowSanitizer::runOnModule(Module& M) {
 
+	PassProfileScope scope("OverflowSanitizer", "instrumentation");
+
 	bSSA& bssa = getAnalysis<bSSA> ();
 	Graph* graph = bssa.newGraph;
 
@@ -204,46 +370,110 @@ bool ::OverflowSanitizer::runOnModule(Module& M) {
 	}
 	//	errs() << "end\n";
 
-	NumInstrumentedInsts = valuesToSafe.size();
-
-	//insert instrumentation
+	// With an attacker that only controls the input, the instructions it
+	// can't influence can't be made to overflow
+	if (UseTaint) {
+		std::map<Function*, unsigned> untainted;
+		for (std::set<Instruction*>::iterator i = valuesToSafe.begin(), e =
+				valuesToSafe.end(); i != e;) {
+			Instruction* I = *i++;
+			if (I->getMetadata("untainted")) {
+				untainted[I->getParent()->getParent()]++;
+				valuesToSafe.erase(I);
+				NumUntainted++;
+				addCountedSite(I, "untainted", false);
+			}
+		}
 
-	for (std::set<Instruction*>::iterator i = valuesToSafe.begin(), e =
-			valuesToSafe.end(); i != e; i++) {
+		for (Module::iterator F = M.begin(), endF = M.end(); F != endF; ++F)
+			if (untainted.count(F))
+				dbgs() << "overflow-sanitizer: " << F->getName() << ": "
+						<< untainted[F] << " untainted instructions not checked\n";
+	}
 
-		Function* F = (*i)->getParent()->getParent();
+	NumInstrumentedInsts = valuesToSafe.size();
 
-		BasicBlock *AbortBB = NULL;
+	if (UseRanges) {
+		SRA = &getAnalysis<SymbolicRangeAnalysis> ();
 
-		if (abortBlocks.count(F)) {
-			AbortBB = abortBlocks[F];
-		} else {
+		std::map<Function*, std::vector<Instruction*> > insts;
+		for (std::set<Instruction*>::iterator i = valuesToSafe.begin(), e =
+				valuesToSafe.end(); i != e; i++)
+			insts[(*i)->getParent()->getParent()].push_back(*i);
 
-			// Create the basic block which the control flow goes to when the assertion fail
-			AbortBB = BasicBlock::Create(*context, "assert fail", F);
+		for (std::map<Function*, std::vector<Instruction*> >::iterator i =
+				insts.begin(), e = insts.end(); i != e; i++)
+			checkWithRanges(i->first, i->second);
+	}
 
-			// Call to abort function
-			CallInst *abort = CallInst::Create(AbortF, Twine(), AbortBB);
+	//blocks to instrument in deferred mode
+	std::set<BasicBlock*> deferredBlocks;
 
-			// Add attributes to the abort call instruction: no return and no unwind
-			abort->addAttribute(~0, Attribute::NoReturn);
-			abort->addAttribute(~0, Attribute::NoUnwind);
+	//insert instrumentation
 
-			// Unreachable instruction
-			new UnreachableInst(*context, AbortBB);
+	for (std::set<Instruction*>::iterator i = valuesToSafe.begin(), e =
+			valuesToSafe.end(); i != e; i++) {
 
-			abortBlocks[F] = AbortBB;
+		BasicBlock *AbortBB = getAbortBlock((*i)->getParent()->getParent());
 
+		if (SamplePeriod > 1) {
+			insertSampledInstrumentation(*i, OvUnknown);
+			addCountedSite(*i, "sampled", true);
+		} else if (DeferredChecks) {
+			deferredBlocks.insert((*i)->getParent());
+			addCountedSite(*i, "deferred", true);
+		} else {
+			insertInstrumentation(*i, AbortBB, OvUnknown);
+			addCountedSite(*i, "checked", true);
 		}
-
-		insertInstrumentation(*i, AbortBB, OvUnknown);
 	}
 
+	for (std::set<BasicBlock*>::iterator i = deferredBlocks.begin(), e =
+			deferredBlocks.end(); i != e; i++)
+		insertDeferredInstrumentation(*i);
+
+	if (InsertFprintfs)
+		createReportFunction();
+
+	if (!SiteCountsReport.empty())
+		insertSiteCounters();
+
 	NumInstructionsAfter = countInstructions();
+	PassProfile::get().counter("overflow checks", "instrumentation",
+			valuesToSafe.size());
 
 	return true;
 }
 
+void OverflowSanitizer::addCountedSite(Instruction* I, const char* reason,
+		bool checked) {
+	if (SiteCountsReport.empty())
+		return;
+	CountedSite S = { I, reason, checked };
+	countedSites.push_back(S);
+}
+
+/*
+ * The counters of the sites, inserted once the module is instrumented: the
+ * deferred checks would see their increments as side effects. The counter
+ * of a site is incremented before its instruction, so that a check kept
+ * counts as often as it runs, and one removed as often as it would have.
+ */
+void OverflowSanitizer::insertSiteCounters() {
+	DataLayout* TD = getAnalysisIfAvailable<DataLayout> ();
+	SiteCounters counters(*module, "overflow-sanitizer", SiteCountsReport,
+			TD ? TD->getPointerSizeInBits() : 64);
+
+	for (unsigned i = 0; i < countedSites.size(); i++)
+		counters.addSite(countedSites[i].I, countedSites[i].reason,
+				countedSites[i].checked);
+	counters.finish();
+
+	PassProfile::get().counter("overflow counted sites", "instrumentation",
+			countedSites.size());
+	countedSites.clear();
+}
+
 void OverflowSanitizer::markAsNotOriginal(Instruction& inst) {
 	inst.setMetadata("new-inst",
 			MDNode::get(*context, llvm::ArrayRef<Value*>()));
@@ -253,24 +483,7 @@ bool OverflowSanitizer::isNotOriginal(Instruction& inst) {
 }
 
 Constant* OverflowSanitizer::strToLLVMConstant(std::string s) {
-
-	std::vector<unsigned char> vec(s.begin(), s.end());
-
-	std::vector<Constant*> cVec;
-
-	for (unsigned int i = 0; i < vec.size(); i++) {
-		cVec.push_back(
-				llvm::ConstantInt::get(Type::getInt8Ty(*context),
-						APInt(8, vec[i], false)));
-	}
-
-	llvm::ArrayRef<Constant*> aRef(cVec);
-
-	int size = vec.size();
-	ArrayType* arrayType = ArrayType::get(Type::getInt8Ty(*context), size);
-
-	return llvm::ConstantArray::get(arrayType, aRef);
-
+	return ConstantDataArray::getString(*context, s);
 }
 
 /*
@@ -278,59 +491,16 @@ Constant* OverflowSanitizer::strToLLVMConstant(std::string s) {
  */
 void OverflowSanitizer::insertGlobalDeclarations() {
 
-	//Create a global variable with the fprintf Message
-	std::string message1("Overflow occurred in %s, line %d. [%d]\n");
-	std::string message2(
+	//The fprintf messages, the first strings of the string table
+	messageOffsets[KindOverflow] = addString(
+			"Overflow occurred in %s, line %d. [%d]\n");
+	messageOffsets[KindTrunc] = addString(
 			"Truncation with data loss occurred in %s, line %d. [%d]\n");
-	std::string
-			message3("(Suspected) Overflow occurred in %s, line %d. [%d]\n");
-	std::string
-			message4(
-					"(Suspected) Truncation with data loss occurred in %s, line %d. [%d]\n");
-
-	Constant* stringConstant = strToLLVMConstant(message1);
-	GlobalVariable* messageStr = new GlobalVariable(*module,
-			stringConstant->getType(), true,
-			llvm::GlobalValue::InternalLinkage, stringConstant,
-			"OverflowMessage");
-
-	//Get the int8ptr to our message
-	constZero = ConstantInt::get(Type::getInt32Ty(*context), 0);
-	Constant* constArray = ConstantExpr::getInBoundsGetElementPtr(messageStr,
-			constZero);
-	overflowMessagePtr = ConstantExpr::getBitCast(constArray,
-			PointerType::getUnqual(Type::getInt8Ty(*context)));
-
-	stringConstant = strToLLVMConstant(message2);
-	messageStr = new GlobalVariable(*module, stringConstant->getType(), true,
-			llvm::GlobalValue::InternalLinkage, stringConstant,
-			"TruncErrorMessage");
-
-	//Get the int8ptr to our message
-	constArray = ConstantExpr::getInBoundsGetElementPtr(messageStr, constZero);
-	truncErrorMessagePtr = ConstantExpr::getBitCast(constArray,
-			PointerType::getUnqual(Type::getInt8Ty(*context)));
-
 	//Messages for the overflows statically detected (suspect instructions)
-	stringConstant = strToLLVMConstant(message3);
-	messageStr = new GlobalVariable(*module, stringConstant->getType(), true,
-			llvm::GlobalValue::InternalLinkage, stringConstant,
-			"OverflowMessage");
-
-	//Get the int8ptr to our message
-	constArray = ConstantExpr::getInBoundsGetElementPtr(messageStr, constZero);
-	overflowMessagePtr2 = ConstantExpr::getBitCast(constArray,
-			PointerType::getUnqual(Type::getInt8Ty(*context)));
-
-	stringConstant = strToLLVMConstant(message4);
-	messageStr = new GlobalVariable(*module, stringConstant->getType(), true,
-			llvm::GlobalValue::InternalLinkage, stringConstant,
-			"TruncErrorMessage");
-
-	//Get the int8ptr to our message
-	constArray = ConstantExpr::getInBoundsGetElementPtr(messageStr, constZero);
-	truncErrorMessagePtr2 = ConstantExpr::getBitCast(constArray,
-			PointerType::getUnqual(Type::getInt8Ty(*context)));
+	messageOffsets[KindSuspectedOverflow] = addString(
+			"(Suspected) Overflow occurred in %s, line %d. [%d]\n");
+	messageOffsets[KindSuspectedTrunc] = addString(
+			"(Suspected) Truncation with data loss occurred in %s, line %d. [%d]\n");
 
 	Type* IO_FILE_PTR_ty;
 
@@ -413,6 +583,20 @@ void OverflowSanitizer::insertGlobalDeclarations() {
 	FPrintF = module->getOrInsertFunction("fprintf",
 			FunctionType::get(Type::getVoidTy(*context), aRParams, true));
 
+	if (SamplePeriod > 1)
+		insertSamplingDeclarations();
+
+	// The report function, shared by the overflow handlers; defined at the end
+	if (InsertFprintfs) {
+		ReportF = Function::Create(FunctionType::get(Type::getVoidTy(*context),
+				Type::getInt32Ty(*context), false),
+				GlobalValue::InternalLinkage, "__overflow_sanitizer_report",
+				module);
+		ReportF->addFnAttr(Attribute::Cold);
+		ReportF->addFnAttr(Attribute::NoInline);
+		ReportF->addFnAttr(Attribute::NoUnwind);
+	}
+
 	// Get void function type
 	FunctionType *AbortFTy =
 			FunctionType::get(Type::getVoidTy(*context), false);
@@ -476,13 +660,44 @@ static bool isSignedInst(llvm::Value* V) {
 
 }
 
-void OverflowSanitizer::insertInstrumentation(Instruction* I,
-		BasicBlock* AbortBB, OvfPrediction Pred) {
+OvfSiteKind OverflowSanitizer::getSiteKind(Instruction* I, OvfPrediction Pred) {
+	if (I->getOpcode() == Instruction::BitCast || I->getOpcode()
+			== Instruction::Trunc)
+		return (Pred == OvUnknown ? KindTrunc : KindSuspectedTrunc);
+	return (Pred == OvUnknown ? KindOverflow : KindSuspectedOverflow);
+}
 
-	// Create comparison instructions, according to the may-overflow instruction.
-	// They are inserted just after the instruction I
-	Instruction* nextInstruction = getNextInstruction(*I);
-	BasicBlock::iterator nextIt(nextInstruction);
+/*
+ * The llvm.*.with.overflow intrinsic that checks I, if any.
+ */
+static Intrinsic::ID getOverflowIntrinsic(Instruction* I) {
+	if (!UseIntrinsics)
+		return Intrinsic::not_intrinsic;
+
+	bool isSigned = isSignedInst(I);
+	switch (I->getOpcode()) {
+	case Instruction::Add:
+		return isSigned ? Intrinsic::sadd_with_overflow
+				: Intrinsic::uadd_with_overflow;
+	case Instruction::Sub:
+		return isSigned ? Intrinsic::ssub_with_overflow
+				: Intrinsic::usub_with_overflow;
+	case Instruction::Mul:
+		return isSigned ? Intrinsic::smul_with_overflow
+				: Intrinsic::umul_with_overflow;
+	default:
+		return Intrinsic::not_intrinsic;
+	}
+}
+
+/*
+ * Inserts before InsertBefore the instructions that compute whether the
+ * may-overflow instruction I overflowed, and returns that i1 value. No block
+ * is split: for multiplications, the division by a zero operand is avoided
+ * by dividing by one instead.
+ */
+Value* OverflowSanitizer::createOverflowPredicate(Instruction* I,
+		Instruction* nextInstruction) {
 
 	ICmpInst *positiveOp1;
 	ICmpInst *positiveOp2;
@@ -496,21 +711,11 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 	ICmpInst *negativeResult;
 	ICmpInst *positiveResult;
 
-	BasicBlock *newBB, *newBB2, *NextBB;
-	BranchInst *branch;
-
 	bool isBinaryOperator = (dyn_cast<BinaryOperator> (I) != NULL);
 	bool isSigned = isSignedInst(I);
 
-	//	if (isSigned) {
-	//		NrSignedInsts++;
-	//	} else {
-	//		NrUnsignedInsts++;
-	//	}
-
-
 	Value* op1;
-	Value* op2;
+	Value* op2 = NULL;
 
 	Value* hasIntegerBug1 = NULL;
 	Value* hasIntegerBug2 = NULL;
@@ -527,8 +732,23 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 		op1 = I->getOperand(0);
 	}
 
-	Value* messagePtr = (Pred == OvUnknown ? overflowMessagePtr
-			: overflowMessagePtr2);
+	Intrinsic::ID ovfIntrinsic = getOverflowIntrinsic(I);
+	if (ovfIntrinsic != Intrinsic::not_intrinsic) {
+		/*
+		 * The intrinsic computes the result and its overflow bit at once: the
+		 * users of I move to that result, and I is left dead (it's still the
+		 * site of the check) for later dead code elimination.
+		 */
+		Type* Tys[] = { I->getType() };
+		Value* args[] = { op1, op2 };
+		CallInst* call = CallInst::Create(Intrinsic::getDeclaration(module,
+				ovfIntrinsic, Tys), args, "", nextInstruction);
+		call->setDebugLoc(I->getDebugLoc());
+		markAsNotOriginal(*call);
+		I->replaceAllUsesWith(ExtractValueInst::Create(call, 0, "",
+				nextInstruction));
+		return ExtractValueInst::Create(call, 1, "", nextInstruction);
+	}
 
 	switch (I->getOpcode()) {
 
@@ -620,59 +840,18 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 
 	case Instruction::Mul:
 
-		//How to verify if an integer bug has just happened :
-		//	divide the result by one of the operands of the multiplication.
-		//  If the result of the division is not equal the other operand, there is an overflow
-		// 	(It can be an expensive test. If it gets too expensive, we can test it in terms of
-		//	 the most significant bit of the operators and the most significant bit of the result)
-
-		//First verify if the operand op1 is zero (it would cause a divide-by-zero exception)
+		//Divide the result by op1, or by one when op1 is zero (there is no
+		//	overflow then), and compare with op2
 		canCauseOverflow = new ICmpInst(nextInstruction, CmpInst::ICMP_NE, op1,
 				constZero);
-
-		// Move all remaining instructions of the basic block to a new one
-		// This new BB is where controw flow goes to when the assertion is correct
-		newBB = I->getParent()->splitBasicBlock(nextIt);
-
-		//This new BB is the BB that contains the overflow check
-		newBB2 = BasicBlock::Create(*context, "", I->getParent()->getParent(),
-				newBB);
-
-		// Remove the unconditional branch created by splitBasicBlock, and insert a conditional
-		// branch that correctly connects to newBB and newBB2
-		branch = cast<BranchInst> (I->getParent()->getTerminator());
-		branch->eraseFromParent();
-
-		BranchInst::Create(newBB2, newBB, canCauseOverflow, I->getParent());
-
-		branch = BranchInst::Create(newBB, newBB2);
-
-		if (isSigned) {
-
-			tmpValue = BinaryOperator::Create(Instruction::SDiv, I, op1, "",
-					branch);
-			hasIntegerBug = new ICmpInst(branch, CmpInst::ICMP_NE, tmpValue,
-					op2);
-
-		} else {
-
-			tmpValue = BinaryOperator::Create(Instruction::UDiv, I, op1, "",
-					branch);
-			hasIntegerBug = new ICmpInst(branch, CmpInst::ICMP_NE, tmpValue,
-					op2);
-
-		}
-
-		// Remove the unconditional branch created by splitBasicBlock, and insert a conditional
-		// branch that correctly connects to newBB and assertfail
-		branch = cast<BranchInst> (newBB2->getTerminator());
-		branch->eraseFromParent();
-
-		NextBB = InsertAborts ? AbortBB : newBB;
-
-		BranchInst::Create(newOverflowOccurrenceBlock(I, NextBB, messagePtr),
-				newBB, hasIntegerBug, newBB2);
-
+		tmpValue = SelectInst::Create(canCauseOverflow, op1,
+				ConstantInt::get(I->getType(), 1), "", nextInstruction);
+		tmpValue = BinaryOperator::Create(isSigned ? Instruction::SDiv
+				: Instruction::UDiv, I, tmpValue, "", nextInstruction);
+		hasIntegerBug1 = new ICmpInst(nextInstruction, CmpInst::ICMP_NE,
+				tmpValue, op2);
+		hasIntegerBug = BinaryOperator::Create(Instruction::And,
+				canCauseOverflow, hasIntegerBug1, "", nextInstruction);
 		break;
 
 	case Instruction::Shl:
@@ -692,7 +871,7 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 					constZero);
 			canCauseOverflow = new ICmpInst(nextInstruction, CmpInst::ICMP_NE,
 					op2, constZero);
-			hasIntegerBug1 = BinaryOperator::Create(Instruction::And,
+			hasIntegerBug2 = BinaryOperator::Create(Instruction::And,
 					canCauseOverflow, negativeOp1, "", nextInstruction);
 
 			hasIntegerBug = BinaryOperator::Create(Instruction::Or,
@@ -713,8 +892,6 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 		 * How to check an integer bug in a trunc instruction:
 		 * 		Cast the truncated value back to its original type and check if the value remains equal
 		 */
-		messagePtr = (Pred == OvUnknown ? truncErrorMessagePtr
-				: truncErrorMessagePtr2);
 		if (isSigned) {
 
 			tmpValue = new SExtInst(I, op1->getType(), "", nextInstruction);
@@ -734,7 +911,93 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 
 	}
 
-	if (I->getOpcode() != Instruction::Mul) {
+	return hasIntegerBug;
+}
+
+void OverflowSanitizer::insertInstrumentation(Instruction* I,
+		BasicBlock* AbortBB, OvfPrediction Pred) {
+
+	// Create comparison instructions, according to the may-overflow instruction.
+	// They are inserted just after the instruction I
+	Instruction* nextInstruction = getNextInstruction(*I);
+	BasicBlock::iterator nextIt(nextInstruction);
+
+	BasicBlock *newBB, *newBB2;
+	BranchInst *branch;
+
+	bool isSigned = isSignedInst(I);
+
+	//	if (isSigned) {
+	//		NrSignedInsts++;
+	//	} else {
+	//		NrUnsignedInsts++;
+	//	}
+
+	Value* hasIntegerBug = NULL;
+	Value* canCauseOverflow;
+	Value* tmpValue;
+
+	OvfSiteKind kind = getSiteKind(I, Pred);
+
+	if (I->getOpcode() == Instruction::Mul && !UseIntrinsics) {
+
+		Value* op1 = I->getOperand(0);
+		Value* op2 = I->getOperand(1);
+		constZero = ConstantInt::get(I->getType(), 0);
+
+		//How to verify if an integer bug has just happened :
+		//	divide the result by one of the operands of the multiplication.
+		//  If the result of the division is not equal the other operand, there is an overflow
+		// 	(It can be an expensive test. If it gets too expensive, we can test it in terms of
+		//	 the most significant bit of the operators and the most significant bit of the result)
+
+		//First verify if the operand op1 is zero (it would cause a divide-by-zero exception)
+		canCauseOverflow = new ICmpInst(nextInstruction, CmpInst::ICMP_NE, op1,
+				constZero);
+
+		// Move all remaining instructions of the basic block to a new one
+		// This new BB is where controw flow goes to when the assertion is correct
+		newBB = I->getParent()->splitBasicBlock(nextIt);
+
+		//This new BB is the BB that contains the overflow check
+		newBB2 = BasicBlock::Create(*context, "", I->getParent()->getParent(),
+				newBB);
+
+		// Remove the unconditional branch created by splitBasicBlock, and insert a conditional
+		// branch that correctly connects to newBB and newBB2
+		branch = cast<BranchInst> (I->getParent()->getTerminator());
+		branch->eraseFromParent();
+
+		BranchInst::Create(newBB2, newBB, canCauseOverflow, I->getParent());
+
+		branch = BranchInst::Create(newBB, newBB2);
+
+		if (isSigned) {
+
+			tmpValue = BinaryOperator::Create(Instruction::SDiv, I, op1, "",
+					branch);
+			hasIntegerBug = new ICmpInst(branch, CmpInst::ICMP_NE, tmpValue,
+					op2);
+
+		} else {
+
+			tmpValue = BinaryOperator::Create(Instruction::UDiv, I, op1, "",
+					branch);
+			hasIntegerBug = new ICmpInst(branch, CmpInst::ICMP_NE, tmpValue,
+					op2);
+
+		}
+
+		// Remove the unconditional branch created by splitBasicBlock, and insert a conditional
+		// branch that correctly connects to newBB and assertfail
+		branch = cast<BranchInst> (newBB2->getTerminator());
+		branch->eraseFromParent();
+
+		branchOnOverflow(I, hasIntegerBug, kind, newBB, newBB2);
+
+	} else {
+
+		hasIntegerBug = createOverflowPredicate(I, nextInstruction);
 
 		// Move all remaining instructions of the basic block to a new one
 		// This new BB is where control flow goes to when the assertion is correct
@@ -745,12 +1008,377 @@ void OverflowSanitizer::insertInstrumentation(Instruction* I,
 		branch = cast<BranchInst> (I->getParent()->getTerminator());
 		branch->eraseFromParent();
 
-		NextBB = InsertAborts ? AbortBB : newBB;
+		branchOnOverflow(I, hasIntegerBug, kind, newBB, I->getParent());
 
-		branch = BranchInst::Create(
-				newOverflowOccurrenceBlock(I, NextBB, messagePtr), newBB,
-				hasIntegerBug, I->getParent());
+	}
+}
+
+/*
+ * Sampling mode: I is checked once every SamplePeriod executions, counted
+ * down by a counter of its own. The other executions only decrement the
+ * counter. A site seen overflowing gets a negative counter, and is checked
+ * every time from then on.
+ */
+void OverflowSanitizer::insertSampledInstrumentation(Instruction* I,
+		OvfPrediction Pred) {
+
+	Instruction* nextInstruction = getNextInstruction(*I);
+	Type* Int32Ty = Type::getInt32Ty(*context);
+	Value* hasIntegerBug = NULL;
+
+	// The intrinsic replaces I, so it must run in every execution
+	if (getOverflowIntrinsic(I) != Intrinsic::not_intrinsic)
+		hasIntegerBug = createOverflowPredicate(I, nextInstruction);
+
+	GlobalVariable* countdown = new GlobalVariable(*module, Int32Ty, false,
+			llvm::GlobalValue::InternalLinkage, ConstantInt::get(Int32Ty, 1),
+			"OverflowCountdown");
+	LoadInst* count = new LoadInst(countdown, "", nextInstruction);
+	Value* skip = new ICmpInst(nextInstruction, CmpInst::ICMP_SGT, count,
+			ConstantInt::get(Int32Ty, 1));
+
+	BasicBlock* BB = I->getParent();
+	BasicBlock* newBB = BB->splitBasicBlock(nextInstruction);
+	BasicBlock* skipBB = BasicBlock::Create(*context, "", BB->getParent(),
+			newBB);
+	BasicBlock* checkBB = BasicBlock::Create(*context, "", BB->getParent(),
+			newBB);
+
+	BB->getTerminator()->eraseFromParent();
+	BranchInst* branch = BranchInst::Create(skipBB, checkBB, skip, BB);
+	MDBuilder MDB(*context);
+	branch->setMetadata(LLVMContext::MD_prof, MDB.createBranchWeights(
+			SamplePeriod - 1, 1));
+
+	branch = BranchInst::Create(newBB, skipBB);
+	new StoreInst(BinaryOperator::Create(Instruction::Sub, count,
+			ConstantInt::get(Int32Ty, 1), "", branch), countdown, branch);
+
+	// The counter starts again from the period, unless the site is always
+	// checked, or overflows now
+	StoreInst* restart = new StoreInst(count, countdown, checkBB);
+	if (!hasIntegerBug)
+		hasIntegerBug = createOverflowPredicate(I, restart);
+	Value* always = new ICmpInst(restart, CmpInst::ICMP_SLT, count,
+			ConstantInt::get(Int32Ty, 0));
+	Value* next = SelectInst::Create(always, count, new LoadInst(
+			GVsamplePeriod, "", restart), "", restart);
+	next = SelectInst::Create(hasIntegerBug, ConstantInt::get(Int32Ty, -1,
+			true), next, "", restart);
+	restart->setOperand(0, next);
+
+	branchOnOverflow(I, hasIntegerBug, getSiteKind(I, Pred), newBB, checkBB);
+}
+
+/*
+ * Declares the sampling period and the module constructor that reads it
+ * from the environment variable OVERFLOW_SANITIZER_SAMPLE, if it is set.
+ */
+void OverflowSanitizer::insertSamplingDeclarations() {
+
+	Type* Int32Ty = Type::getInt32Ty(*context);
+	Type* Int8PtrTy = Type::getInt8PtrTy(*context);
+
+	GVsamplePeriod = new GlobalVariable(*module, Int32Ty, false,
+			llvm::GlobalValue::InternalLinkage, ConstantInt::get(Int32Ty,
+					SamplePeriod), "OverflowSamplePeriod");
+
+	Constant* stringConstant = strToLLVMConstant("OVERFLOW_SANITIZER_SAMPLE");
+	GlobalVariable* nameStr = new GlobalVariable(*module,
+			stringConstant->getType(), true,
+			llvm::GlobalValue::InternalLinkage, stringConstant,
+			"SampleVariable");
+	Constant* namePtr = ConstantExpr::getBitCast(
+			ConstantExpr::getInBoundsGetElementPtr(nameStr, ConstantInt::get(
+					Int32Ty, 0)), Int8PtrTy);
+
+	Constant* GetEnvF = module->getOrInsertFunction("getenv",
+			FunctionType::get(Int8PtrTy, Int8PtrTy, false));
+	Constant* AtoIF = module->getOrInsertFunction("atoi", FunctionType::get(
+			Int32Ty, Int8PtrTy, false));
+
+	Function* InitF = Function::Create(FunctionType::get(
+			Type::getVoidTy(*context), false), GlobalValue::InternalLinkage,
+			"__overflow_sanitizer_init_sampling", module);
+	BasicBlock* entry = BasicBlock::Create(*context, "", InitF);
+	BasicBlock* set = BasicBlock::Create(*context, "", InitF);
+	BasicBlock* exit = BasicBlock::Create(*context, "", InitF);
+
+	CallInst* value = CallInst::Create(GetEnvF, namePtr, "", entry);
+	BranchInst::Create(exit, set, new ICmpInst(*entry, CmpInst::ICMP_EQ,
+			value, ConstantPointerNull::get(cast<PointerType> (Int8PtrTy))),
+			entry);
+
+	new StoreInst(CallInst::Create(AtoIF, value, "", set), GVsamplePeriod, set);
+	BranchInst::Create(exit, set);
+
+	ReturnInst::Create(*context, exit);
+
+	appendToGlobalCtors(*module, InitF, 0);
+}
+
+/*
+ * Deferred mode: the overflow bits of the instructions of BB are ORed into a
+ * sticky flag, tested only before the next instruction with side effects,
+ * the next one that can't be executed speculatively, such as a load or a
+ * division that may trap on a wrapped value, and before the terminator.
+ * When the flag is set, a slow path tests the bits one by one, in program
+ * order, to report the first failing instruction with its line.
+ */
+void OverflowSanitizer::insertDeferredInstrumentation(BasicBlock* BB) {
+
+	// The instructions of BB before any instrumentation
+	std::vector<Instruction*> insts;
+	for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I)
+		insts.push_back(I);
+
+	std::vector<std::pair<Instruction*, Value*> > pending;
+	Value* sticky = NULL;
+
+	for (unsigned i = 0; i < insts.size(); i++) {
+		Instruction* I = insts[i];
+
+		if (!pending.empty() && (I->mayHaveSideEffects() || isa<
+				TerminatorInst> (I) || !isSafeToSpeculativelyExecute(I))) {
+			flushStickyFlag(I, sticky, pending);
+			pending.clear();
+			sticky = NULL;
+		}
+
+		if (!valuesToSafe.count(I))
+			continue;
+
+		Instruction* nextInstruction = insts[i + 1];
+		Value* hasIntegerBug = createOverflowPredicate(I, nextInstruction);
+		pending.push_back(std::make_pair(I, hasIntegerBug));
+		sticky = sticky ? BinaryOperator::Create(Instruction::Or, sticky,
+				hasIntegerBug, "", nextInstruction) : hasIntegerBug;
+	}
+}
+
+/*
+ * Branches on the sticky flag just before I: to the rest of the block when it
+ * is clear, and to the tests of the pending instructions otherwise.
+ */
+void OverflowSanitizer::flushStickyFlag(Instruction* I, Value* sticky,
+		std::vector<std::pair<Instruction*, Value*> > &pending) {
+
+	BasicBlock* BB = I->getParent();
+	BasicBlock* newBB = BB->splitBasicBlock(I);
+
+	// Build the tests from the last one, each falling through to the next
+	BasicBlock* NextTest = newBB;
+	for (unsigned i = pending.size(); i > 0; i--) {
+		Instruction* PI = pending[i - 1].first;
+		BasicBlock* Test = BasicBlock::Create(*context, "", BB->getParent(),
+				newBB);
+		branchOnOverflow(PI, pending[i - 1].second, getSiteKind(PI,
+				OvUnknown), NextTest, Test);
+		NextTest = Test;
+	}
+
+	BranchInst* branch = cast<BranchInst> (BB->getTerminator());
+	branch->eraseFromParent();
+	setColdBranch(BranchInst::Create(NextTest, newBB, sticky, BB));
+}
+
+/*
+ * The bounds, in the sense of isSigned, that the values of type Ty can take.
+ * The unsigned bounds are kept to the ones of the signed type: the symbolic
+ * ranges are signed.
+ */
+static void getTypeBounds(IntegerType* Ty, bool isSigned, int64_t& Min,
+		int64_t& Max) {
+	unsigned width = Ty->getBitWidth();
+	Min = isSigned ? APInt::getSignedMinValue(width).getSExtValue() : 0;
+	Max = APInt::getSignedMaxValue(width).getSExtValue();
+}
 
+/*
+ * Can the affine expression A be computed at I? Its symbols must be integers
+ * of this function defined before I.
+ */
+bool OverflowSanitizer::isAvailableAt(const AffineExpr& A, Instruction* I) {
+	Function* F = I->getParent()->getParent();
+	for (unsigned i = 0, n = A.getTerms().size(); i != n; ++i) {
+		const Value* V = Expr::GetSymbolValue(A.getTerms()[i].first);
+		if (!V || !V->getType()->isIntegerTy())
+			return false;
+		if (const Argument* Arg = dyn_cast<Argument> (V)) {
+			if (Arg->getParent() != F)
+				return false;
+		} else if (const Instruction* Def = dyn_cast<Instruction> (V)) {
+			if (Def->getParent()->getParent() != F || !DT->dominates(Def, I))
+				return false;
+		} else if (!isa<Constant> (V))
+			return false;
+	}
+	return true;
+}
+
+Value* OverflowSanitizer::materializeAffine(const AffineExpr& A,
+		IntegerType* Ty, bool isSigned, Instruction* InsertBefore) {
+	Value* result = ConstantInt::get(Ty, A.getConstant(), true);
+	for (unsigned i = 0, n = A.getTerms().size(); i != n; ++i) {
+		const AffineExpr::Term& T = A.getTerms()[i];
+		Value* Sym = const_cast<Value*> (Expr::GetSymbolValue(T.first));
+		Sym = CastInst::CreateIntegerCast(Sym, Ty, isSigned, "", InsertBefore);
+		Sym = BinaryOperator::Create(Instruction::Mul, Sym, ConstantInt::get(
+				Ty, T.second, true), "", InsertBefore);
+		result = BinaryOperator::Create(Instruction::Add, result, Sym, "",
+				InsertBefore);
+	}
+	return result;
+}
+
+/*
+ * Does the symbolic range of I prove that it never overflows? Its bounds
+ * must be numbers that fit in the type of I.
+ */
+OvfPrediction OverflowSanitizer::predictOverflow(Instruction* I) {
+	IntegerType* Ty = dyn_cast<IntegerType> (I->getType());
+	if (!Ty || Ty->getBitWidth() > 64 || !isa<BinaryOperator> (I))
+		return OvUnknown;
+
+	Range R = SRA->getRange(I);
+	AffineExpr Lower, Upper;
+	if (R.getLower().isMinusInf() || R.getUpper().isPlusInf()
+			|| !R.getLower().getAffine(Lower) || !R.getUpper().getAffine(Upper)
+			|| !Lower.isConstant() || !Upper.isConstant())
+		return OvUnknown;
+
+	int64_t Min, Max;
+	getTypeBounds(Ty, isSignedInst(I), Min, Max);
+	if (Lower.getConstant() >= Min && Upper.getConstant() <= Max)
+		return OvWillNotHappen;
+	return OvUnknown;
+}
+
+/*
+ * If I is an addition, subtraction or multiplication of the induction
+ * variable of its loop by a loop invariant, and its symbolic range can be
+ * computed in the preheader, fill Lower and Upper with the bounds of I over
+ * the whole loop and return the loop.
+ */
+Loop* OverflowSanitizer::getLoopCheck(Instruction* I, AffineExpr& Lower,
+		AffineExpr& Upper) {
+	IntegerType* Ty = dyn_cast<IntegerType> (I->getType());
+	if (!Ty || Ty->getBitWidth() > 64)
+		return NULL;
+	if (I->getOpcode() != Instruction::Add && I->getOpcode()
+			!= Instruction::Sub && I->getOpcode() != Instruction::Mul)
+		return NULL;
+
+	// I must run in every iteration, and the loop must leave from one place
+	// only, so that I reaches the bounds of its range.
+	BasicBlock* BB = I->getParent();
+	Loop* L = LI->getLoopFor(BB);
+	if (!L || !L->getLoopPreheader() || !L->getLoopLatch()
+			|| !L->getExitingBlock() || !DT->dominates(BB, L->getLoopLatch())
+			|| hasCalls(L))
+		return NULL;
+
+	Value* op1 = I->getOperand(0);
+	Value* op2 = I->getOperand(1);
+	if (!(isUnitStrideIndex(op1, L) && L->isLoopInvariant(op2))
+			&& !(I->getOpcode() != Instruction::Sub && isUnitStrideIndex(op2,
+					L) && L->isLoopInvariant(op1)))
+		return NULL;
+
+	Range R = SRA->getRange(I);
+	if (R.getLower().isMinusInf() || R.getLower().isPlusInf()
+			|| R.getUpper().isMinusInf() || R.getUpper().isPlusInf())
+		return NULL;
+	if (!R.getLower().getAffine(Lower) || !R.getUpper().getAffine(Upper))
+		return NULL;
+
+	Instruction* InsertBefore = L->getLoopPreheader()->getTerminator();
+	if (!isAvailableAt(Lower, InsertBefore) || !isAvailableAt(Upper,
+			InsertBefore))
+		return NULL;
+	return L;
+}
+
+/*
+ * Uses the symbolic ranges on the instructions of F to check: the ones
+ * whose range fits in their type are predicted OvWillNotHappen and not
+ * checked at all, and the ones of loops that getLoopCheck accepts are checked
+ * once, before the loop, on the bounds of their range. The instructions
+ * handled here leave valuesToSafe.
+ */
+void OverflowSanitizer::checkWithRanges(Function* F,
+		std::vector<Instruction*> &insts) {
+
+	DT = &getAnalysis<DominatorTree> (*F);
+	LI = &getAnalysis<LoopInfo> (*F);
+
+	// All the decisions are taken before the loops are changed; the checks
+	// are grouped by preheader
+	std::map<BasicBlock*, std::vector<std::pair<Instruction*, std::pair<
+			AffineExpr, AffineExpr> > > > loopChecks;
+	for (unsigned i = 0; i < insts.size(); i++) {
+		Instruction* I = insts[i];
+		AffineExpr Lower, Upper;
+
+		if (predictOverflow(I) == OvWillNotHappen) {
+			valuesToSafe.erase(I);
+			NumProvenSafe++;
+			addCountedSite(I, "proven-safe", false);
+		} else if (Loop* L = getLoopCheck(I, Lower, Upper)) {
+			loopChecks[L->getLoopPreheader()].push_back(std::make_pair(I,
+					std::make_pair(Lower, Upper)));
+			valuesToSafe.erase(I);
+			NumHoistedChecks++;
+			addCountedSite(I, "loop-hoisted", false);
+		}
+	}
+
+	for (std::map<BasicBlock*, std::vector<std::pair<Instruction*, std::pair<
+			AffineExpr, AffineExpr> > > >::iterator it = loopChecks.begin(),
+			e = loopChecks.end(); it != e; ++it) {
+
+		Instruction* InsertBefore = it->first->getTerminator();
+		std::vector<std::pair<Instruction*, Value*> > pending;
+		Value* sticky = NULL;
+
+		for (unsigned i = 0; i < it->second.size(); i++) {
+			Instruction* I = it->second[i].first;
+			IntegerType* Ty = cast<IntegerType> (I->getType());
+			bool isSigned = isSignedInst(I);
+
+			// Wide enough for the products of the bounds not to overflow
+			unsigned width = 2 * std::max(Ty->getBitWidth(), 64u) + 8;
+			IntegerType* WideTy = IntegerType::get(*context, width);
+
+			Value* lower = materializeAffine(it->second[i].second.first, WideTy,
+					isSigned, InsertBefore);
+			Value* upper = materializeAffine(it->second[i].second.second,
+					WideTy, isSigned, InsertBefore);
+
+			APInt TyMin = isSigned ? APInt::getSignedMinValue(
+					Ty->getBitWidth()).sext(width) : APInt(width, 0);
+			APInt TyMax = isSigned ? APInt::getSignedMaxValue(
+					Ty->getBitWidth()).sext(width) : APInt::getMaxValue(
+					Ty->getBitWidth()).zext(width);
+
+			// An empty range means that the loop doesn't run
+			Value* nonEmpty = new ICmpInst(InsertBefore, CmpInst::ICMP_SLE,
+					lower, upper);
+			Value* belowMin = new ICmpInst(InsertBefore, CmpInst::ICMP_SLT,
+					lower, ConstantInt::get(*context, TyMin));
+			Value* aboveMax = new ICmpInst(InsertBefore, CmpInst::ICMP_SGT,
+					upper, ConstantInt::get(*context, TyMax));
+			Value* hasIntegerBug = BinaryOperator::Create(Instruction::Or,
+					belowMin, aboveMax, "", InsertBefore);
+			hasIntegerBug = BinaryOperator::Create(Instruction::And, nonEmpty,
+					hasIntegerBug, "", InsertBefore);
+
+			pending.push_back(std::make_pair(I, hasIntegerBug));
+			sticky = sticky ? BinaryOperator::Create(Instruction::Or, sticky,
+					hasIntegerBug, "", InsertBefore) : hasIntegerBug;
+		}
+
+		flushStickyFlag(InsertBefore, sticky, pending);
 	}
 }
 
@@ -760,7 +1388,21 @@ Instruction* OverflowSanitizer::getNextInstruction(Instruction& i) {
 	return it;
 }
 
-Constant* OverflowSanitizer::getSourceFile(Instruction* I) {
+/*
+ * Appends s, NUL terminated, to the string table and returns its offset.
+ */
+unsigned OverflowSanitizer::addString(StringRef s) {
+	unsigned offset = strings.size();
+	strings += s;
+	strings += '\0';
+	return offset;
+}
+
+/*
+ * The offset of the file name of I in the string table; each name is in the
+ * table once.
+ */
+unsigned OverflowSanitizer::getSourceFile(Instruction* I) {
 
 	StringRef File;
 	if (MDNode *N = I->getMetadata("dbg")) {
@@ -770,45 +1412,32 @@ Constant* OverflowSanitizer::getSourceFile(Instruction* I) {
 		File = "Unknown Source File";
 	}
 
-	if (SourceFiles.count(File)) {
+	if (SourceFiles.count(File))
 		return SourceFiles.find(File)->second;
-	} else {
-
-		//Create a global variable with the File string
-		Constant* stringConstant = strToLLVMConstant(File);
-		GlobalVariable* sourceFileStr = new GlobalVariable(*module,
-				stringConstant->getType(), true,
-				llvm::GlobalValue::InternalLinkage, stringConstant,
-				"SourceFile");
 
-		constZero = ConstantInt::get(Type::getInt32Ty(*context), 0);
-
-		//Get the int8ptr to our message
-		Constant* constArray = ConstantExpr::getInBoundsGetElementPtr(
-				sourceFileStr, constZero);
-		Constant* sourceFilePtr = ConstantExpr::getBitCast(constArray,
-				PointerType::getUnqual(Type::getInt8Ty(*context)));
-
-		SourceFiles[File] = sourceFilePtr;
-
-		return sourceFilePtr;
-	}
+	unsigned offset = addString(File);
+	SourceFiles[File] = offset;
+	return offset;
 }
 
-Constant* OverflowSanitizer::getLineNumber(Instruction* I) {
+unsigned OverflowSanitizer::getLineNumber(Instruction* I) {
 
 	if (MDNode *N = I->getMetadata("dbg")) {
 		DILocation Loc(N);
-		unsigned Line = Loc.getLineNumber();
-		return ConstantInt::get(Type::getInt32Ty(*context), Line);
+		return Loc.getLineNumber();
 	} else {
-		return ConstantInt::get(Type::getInt32Ty(*context), 0);
+		return 0;
 	}
 
 }
 
 void OverflowSanitizer::getAnalysisUsage(AnalysisUsage &AU) const {
 	AU.addRequired<bSSA> ();
+	if (UseRanges) {
+		AU.addRequired<SymbolicRangeAnalysis> ();
+		AU.addRequired<DominatorTree> ();
+		AU.addRequired<LoopInfo> ();
+	}
 	//	AU.addRequired<moduleDepGraph> ();
 }
 
@@ -13,7 +13,10 @@
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Intrinsics.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
 #include "llvm/IR/Operator.h"
@@ -21,18 +24,21 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Support/CallSite.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
 
 #include <vector>
 #include <set>
 #include <list>
 #include <stdio.h>
 
-#include "InputValues.h"
-#include "DepGraph.h"
-#include "bSSA.h"
+#include "../InputValues/InputValues.h"
+#include "../DepGraph/DepGraph.h"
+#include "../bSSA/bSSA.h"
+#include "SymbolicRangeAnalysis.h"
 
 using namespace llvm;
 
@@ -40,37 +46,79 @@ namespace llvm{
 
 	typedef enum { OvUnknown, OvCanHappen, OvWillHappen, OvWillNotHappen } OvfPrediction;
 
+	// What the report of a site says; indexes the messages of the site table
+	typedef enum { KindOverflow, KindTrunc, KindSuspectedOverflow, KindSuspectedTrunc,
+		NumSiteKinds } OvfSiteKind;
+
 	struct OverflowSanitizer : public ModulePass {
 	private:
 		Module* module;
 		std::set<Instruction*> valuesToSafe;
 		llvm::DenseMap<Function*, BasicBlock*> abortBlocks;
+		llvm::DenseMap<Function*, BasicBlock*> handlerBlocks;
+		std::vector<Constant*> sites; // file, line, opcode and kind of each site ID
+		std::string strings; // string table of the sites: messages, then file names
+		unsigned messageOffsets[NumSiteKinds];
         llvm::LLVMContext* context;
         Constant* constZero;
-        Value* GVstderr, *FPrintF, *overflowMessagePtr, *truncErrorMessagePtr, *overflowMessagePtr2, *truncErrorMessagePtr2;
+        Value* GVstderr, *FPrintF;
         // Pointer to abort function
         Function *AbortF;
-        std::map<std::string,Constant*> SourceFiles;
+        // Sampling period of the checks, set at run time
+        GlobalVariable* GVsamplePeriod;
+        // Pointer to the report function of the overflow handlers
+        Function *ReportF;
+        std::map<std::string,unsigned> SourceFiles;
+        // The sites counted at run time, with -overflow-sanitizer-site-counts
+        struct CountedSite {
+            Instruction* I;
+            const char* reason;
+            bool checked;
+        };
+        std::vector<CountedSite> countedSites;
+        SymbolicRangeAnalysis* SRA;
+        DominatorTree* DT;
+        LoopInfo* LI;
 
         void markAsNotOriginal(Instruction& inst);
         bool isNotOriginal(Instruction& inst);
         static bool isValidInst(Instruction *I);
-		BasicBlock* newOverflowOccurrenceBlock(Instruction* I, BasicBlock* NextBlock, Value *messagePtr);
+		BasicBlock* getAbortBlock(Function* F);
+		BasicBlock* getOverflowHandler(Function* F);
+		void branchOnOverflow(Instruction* I, Value* hasIntegerBug, OvfSiteKind kind,
+				BasicBlock* Continue, BasicBlock* InsertAtEnd);
+		void setColdBranch(BranchInst* branch);
+		void createReportFunction();
+		OvfSiteKind getSiteKind(Instruction* I, OvfPrediction Pred);
+		Value* createOverflowPredicate(Instruction* I, Instruction* InsertBefore);
 		void insertInstrumentation(Instruction* I, BasicBlock* AbortBB, OvfPrediction Pred);
-		Constant* getSourceFile(Instruction* I);
-		Constant* getLineNumber(Instruction* I);
+		void insertSampledInstrumentation(Instruction* I, OvfPrediction Pred);
+		void insertSamplingDeclarations();
+		void insertDeferredInstrumentation(BasicBlock* BB);
+		void flushStickyFlag(Instruction* I, Value* sticky,
+				std::vector<std::pair<Instruction*, Value*> > &pending);
+		bool isAvailableAt(const AffineExpr& A, Instruction* I);
+		Value* materializeAffine(const AffineExpr& A, IntegerType* Ty, bool isSigned,
+				Instruction* InsertBefore);
+		OvfPrediction predictOverflow(Instruction* I);
+		Loop* getLoopCheck(Instruction* I, AffineExpr& Lower, AffineExpr& Upper);
+		void checkWithRanges(Function* F, std::vector<Instruction*> &insts);
+		unsigned addString(StringRef s);
+		unsigned getSourceFile(Instruction* I);
+		unsigned getLineNumber(Instruction* I);
 		Instruction* getNextInstruction(Instruction& i);
 		Constant* strToLLVMConstant(std::string s);
 		int countInstructions();
 		int countOverflowableInsts();
 		void insertGlobalDeclarations();
+		void addCountedSite(Instruction* I, const char* reason, bool checked);
+		void insertSiteCounters();
 
 	public:
 		static char ID;
 		OverflowSanitizer() : ModulePass(ID), module(NULL), context(NULL),
-							  constZero(NULL), GVstderr(NULL), FPrintF(NULL), overflowMessagePtr(NULL),
-							  truncErrorMessagePtr(NULL), overflowMessagePtr2(NULL),
-							  truncErrorMessagePtr2(NULL), AbortF(NULL){};
+							  constZero(NULL), GVstderr(NULL), FPrintF(NULL), AbortF(NULL), GVsamplePeriod(NULL), ReportF(NULL),
+							  SRA(NULL), DT(NULL), LI(NULL){};
 
 		virtual bool runOnModule(Module &M);
 
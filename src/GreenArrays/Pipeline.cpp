@@ -0,0 +1,88 @@
+//===----------------------------- Pipeline.cpp ---------------------------===//
+//===----------------------------------------------------------------------===//
+// Runs the whole GreenArrays chain of the README in one opt invocation: the
+// passes share a single pass manager, so the analyses that a stage preserves
+// stay alive for the next ones, and the module is read and written once.
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Pass.h"
+#include "llvm/PassManager.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Target/TargetLibraryInfo.h"
+
+#include <string>
+#include <vector>
+
+/* ************************************************************************** */
+/* ************************************************************************** */
+
+using namespace llvm;
+using std::string;
+using std::vector;
+
+static cl::list<string>
+  ClPasses("ga-pipeline-passes",
+           cl::desc("Passes run by -ga-pipeline, in order (default: the "
+                    "whole chain of the README)"),
+           cl::CommaSeparated, cl::Hidden);
+
+// The opt invocations of the README, in order.
+static const char *const DefaultPipeline[] = {
+  // SSA form and removal of the unused functions
+  "mem2reg", "instnamer", "mergereturn", "remove-unused-functions",
+  // Live-range splitting, without the redefinitions that can't narrow a
+  // range
+  "redef", "ptr-redef", "redef-prune",
+  // Symbolic range and region analyses, tainted-flow analysis
+  "region-analysis-annotate-safety", "tainted-annotate",
+  // Instrumentation, once the redefinitions as wide as their sources are
+  // gone
+  "redef-prune", "overflow-sanitizer", "ga-asan", "ga-asan-module"
+};
+
+namespace llvm {
+
+class GAPipeline : public ModulePass {
+public:
+  static char ID;
+  GAPipeline() : ModulePass(ID) { }
+
+  virtual bool runOnModule(Module &M);
+};
+
+}
+
+bool GAPipeline::runOnModule(Module &M) {
+  vector<string> Names(ClPasses.begin(), ClPasses.end());
+  if (Names.empty())
+    Names.assign(DefaultPipeline,
+                 DefaultPipeline + array_lengthof(DefaultPipeline));
+
+  // The immutable passes opt would have added for the stages.
+  PassManager PM;
+  if (!M.getDataLayout().empty())
+    PM.add(new DataLayout(&M));
+  PM.add(new TargetLibraryInfo(Triple(M.getTargetTriple())));
+
+  PassRegistry *Registry = PassRegistry::getPassRegistry();
+  for (auto& Name : Names) {
+    const PassInfo *PI = Registry->getPassInfo(Name);
+    if (!PI || !PI->getNormalCtor())
+      report_fatal_error("ga-pipeline: unknown pass '" + Name + "'");
+    DEBUG(dbgs() << "ga-pipeline: " << Name << "\n");
+    PM.add(PI->createPass());
+  }
+
+  PM.run(M);
+  return true;
+}
+
+char GAPipeline::ID = 0;
+static RegisterPass<GAPipeline>
+  X("ga-pipeline", "Run the GreenArrays passes in one pass manager");
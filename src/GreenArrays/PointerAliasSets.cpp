@@ -1,4 +1,4 @@
-#include "AliasSets.h"
+#include "PointerAliasSets.h"
 
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/SetVector.h"
@@ -20,25 +20,25 @@
 
 using namespace llvm;
 
-static cl::opt<bool> AliasSetsDebug("alias-sets-debug",
+static cl::opt<bool> AliasSetsDebug("ptr-alias-sets-debug",
                                     cl::desc("Enable debugging"),
                                     cl::Hidden, cl::init(false));
 
 static cl::opt<std::string>
-  AliasSetsDebugFunction("alias-sets-debug-function",
+  AliasSetsDebugFunction("ptr-alias-sets-debug-function",
                          cl::desc("Enable debugging"),
                          cl::Hidden, cl::init(""));
 
 #define AS_DEBUG(X) { if (AliasSetsDebug) { X; } }
 
 // getAnalysisUsage
-void AliasSets::getAnalysisUsage(AnalysisUsage &AU) const {
+void PointerAliasSets::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<AliasAnalysis>();
   AU.setPreservesAll();
 }
 
 // runOnFunction
-bool AliasSets::runOnFunction(Function &F) {
+bool PointerAliasSets::runOnFunction(Function &F) {
   //if (AliasSetsDebugFunction == "__all__") {
   //  dbgs() << F.getName() << "\n";
   //} else if (!AliasSetsDebugFunction.empty()) {
@@ -48,7 +48,7 @@ bool AliasSets::runOnFunction(Function &F) {
   //  dbgs() << F;
   //}
 
-  //errs() << "(AliasSets) Function: " << F.getName() << "\n";
+  //errs() << "(PointerAliasSets) Function: " << F.getName() << "\n";
 
   Ptrs_.clear();
   Sets_.clear();
@@ -74,7 +74,7 @@ bool AliasSets::runOnFunction(Function &F) {
   return false;
 }
 
-void AliasSets::print(raw_ostream& OS) const {
+void PointerAliasSets::print(raw_ostream& OS) const {
   for (auto& P : Sets_) {
     OS << "## " << *P.first << "\n";
     for (auto& T : *P.second)
@@ -82,14 +82,14 @@ void AliasSets::print(raw_ostream& OS) const {
   }
 }
 
-void AliasSets::visitArgument(Argument *A) {
+void PointerAliasSets::visitArgument(Argument *A) {
   if (A->getType()->isPointerTy()) {
     //errs() << "Inserting: " << *A << "\n";
     Ptrs_.insert(A);
   }
 }
 
-void AliasSets::visitInstruction(Instruction *I) {
+void PointerAliasSets::visitInstruction(Instruction *I) {
   //errs() << "Visiting instruction: " << *I << "\n";
   if (I->getType()->isPointerTy()) {
     //errs() << "Inserting: " << *I << "\n";
@@ -97,7 +97,7 @@ void AliasSets::visitInstruction(Instruction *I) {
   }
 }
 
-std::set<Value*> *AliasSets::getAliasSet(Value *V) {
+std::set<Value*> *PointerAliasSets::getAliasSet(Value *V) {
   assert(V->getType()->isPointerTy() && "Value must be a pointer");
   assert(!isa<GlobalValue>(V) && !isa<Constant>(V) &&
          "Value must not be a global or a constant");
@@ -109,7 +109,7 @@ std::set<Value*> *AliasSets::getAliasSet(Value *V) {
   return createAndRegisterAliasSet(V);
 }
 
-std::set<Value*> *AliasSets::getOrAllocateAliasSet(Value *V) {
+std::set<Value*> *PointerAliasSets::getOrAllocateAliasSet(Value *V) {
   assert(V->getType()->isPointerTy() && "Value must be a pointer");
 
   auto It = Sets_.find(V);
@@ -121,7 +121,7 @@ std::set<Value*> *AliasSets::getOrAllocateAliasSet(Value *V) {
   return Set;
 }
 
-std::set<Value*> *AliasSets::getAliasSetOrNull(Value *V) {
+std::set<Value*> *PointerAliasSets::getAliasSetOrNull(Value *V) {
   assert(V->getType()->isPointerTy() && "Value must be a pointer");
 
   auto It = Sets_.find(V);
@@ -131,8 +131,8 @@ std::set<Value*> *AliasSets::getAliasSetOrNull(Value *V) {
   return NULL;
 }
 
-void AliasSets::bind(Value *V, Value *Parent) {
-  AS_DEBUG(dbgs() << "(AliasSets) bind: " << *V << ", " << *Parent << "\n");
+void PointerAliasSets::bind(Value *V, Value *Parent) {
+  AS_DEBUG(dbgs() << "(PointerAliasSets) bind: " << *V << ", " << *Parent << "\n");
   //errs() << "bind: " << *V << ", " << *Parent << "\n";
   assert(!Ptrs_.count(V));
   if (Ptrs_.count(Parent))
@@ -142,7 +142,7 @@ void AliasSets::bind(Value *V, Value *Parent) {
   Sets_[V] = Set;
 }
 
-std::set<Value*> *AliasSets::createAndRegisterAliasSet(Value *V) {
+std::set<Value*> *PointerAliasSets::createAndRegisterAliasSet(Value *V) {
   //errs() << "createAndRegisterAliasSet: " << *V << "\n";
   if (!Ptrs_.count(V))
     errs() << "## V = " << *V << ", " << Sets_.count(V) << "\n";
@@ -179,7 +179,7 @@ std::set<Value*> *AliasSets::createAndRegisterAliasSet(Value *V) {
   return Set;
 }
 
-char AliasSets::ID = 0;
-static RegisterPass<AliasSets>
-  X("alias-sets", "Pointer redefinition for sparse abstract interperatation");
+char PointerAliasSets::ID = 0;
+static RegisterPass<PointerAliasSets>
+  X("ptr-alias-sets", "Pointer redefinition for sparse abstract interperatation");
 
@@ -1,5 +1,5 @@
-#ifndef _ALIASSETS_H_
-#define _ALIASSETS_H_
+#ifndef _POINTERALIASSETS_H_
+#define _POINTERALIASSETS_H_
 
 #include "llvm/Pass.h"
 #include "llvm/ADT/DenseMap.h"
@@ -19,11 +19,11 @@
 
 namespace llvm {
 
-class AliasSets : public FunctionPass {
+class PointerAliasSets : public FunctionPass {
 
 public:
   static char ID;
-  AliasSets() : FunctionPass(ID) { }
+  PointerAliasSets() : FunctionPass(ID) { }
 
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   virtual bool runOnFunction(Function &F); 
@@ -5,7 +5,7 @@
  */
 
 #include "PointerRedefinition.h"
-#include "AliasSets.h"
+#include "PointerAliasSets.h"
 
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/SetVector.h"
@@ -63,7 +63,7 @@ static BitCastInst *CreateNamedBitCast(Value *V, Twine Prefix,
 void PointerRedefinition::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<DominatorTree>();
   AU.addRequired<DominanceFrontier>();
-  AU.addRequired<AliasSets>();
+  AU.addRequired<PointerAliasSets>();
   AU.addRequired<TargetLibraryInfo>();
   AU.setPreservesAll();
   //AU.addPreserved<DominatorTree>();
@@ -120,7 +120,7 @@ bool PointerRedefinition::runOnModule(Module &M) {
     //  continue;
     //errs() << "(PointerRedefinition) Function: " << F.getName() << "\n";
     //errs() << "GETTING ALIAS SET\n";
-    AS_ = &getAnalysis<AliasSets>(F);
+    AS_ = &getAnalysis<PointerAliasSets>(F);
     //errs() << "GOT\n";
     DT_ = &getAnalysis<DominatorTree>(F);
     //errs() << "DT\n";
@@ -1,7 +1,7 @@
 #ifndef LLVM_TRANSFORMS_POINTERSSI_POINTERSSI_H_
 #define LLVM_TRANSFORMS_POINTERSSI_POINTERSSI_H_
 
-#include "AliasSets.h"
+#include "PointerAliasSets.h"
 
 #include "llvm/Pass.h"
 #include "llvm/ADT/DenseMap.h"
@@ -52,7 +52,7 @@ private:
 
   Function *F_;
 
-  AliasSets *AS_;
+  PointerAliasSets *AS_;
   CallGraph *CG_;
   DominatorTree *DT_;
   DominanceFrontier *DF_;
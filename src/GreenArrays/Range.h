@@ -46,8 +46,8 @@ public:
 	void setLower(const Expr& Lower) { Lower_ = Lower; }
 	void setUpper(const Expr& Upper) { Upper_ = Upper; }
 
-  bool lt(Range Other) { return Upper_.lt(Other.getLower()); }
-  bool le(Range Other) { return Upper_.le(Other.getLower()); }
+  bool lt(const Range& Other) const { return Upper_.lt(Other.Lower_); }
+  bool le(const Range& Other) const { return Upper_.le(Other.Lower_); }
 
   // Basic arithmetic operations.
 	Range add(const Range& Other);
@@ -1,12 +1,18 @@
 //===--------------------- SymbolicRangeAnalysis.cpp ----------------------===//
 //===----------------------------------------------------------------------===//
 
+#define DEBUG_TYPE "redef"
 #include "Redefinition.h"
+#include "PointerRedefinition.h"
+#include "SymbolicRangeAnalysis.h"
 
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 
+#include <cctype>
 #include <queue>
+#include <vector>
 
 /* ************************************************************************** */
 /* ************************************************************************** */
@@ -15,6 +21,12 @@ using namespace llvm;
 using std::queue;
 using std::set;
 using std::string;
+using std::vector;
+
+STATISTIC(NumPrunedDead,    "Number of redefinitions pruned without uses");
+STATISTIC(NumPrunedTrivial, "Number of phis pruned with a single incoming value");
+STATISTIC(NumPrunedRange,   "Number of redefinitions pruned with the range "
+                            "of their source");
 
 static cl::opt<bool>
   ClDebug("redef-debug",
@@ -123,6 +135,8 @@ bool Redefinition::doFinalization(Module& M) {
          << StatNumCreatedSigmas_       << "\t ====\n";
   dbgs() << "==== Number of create phis:     "
          << StatNumCreatedFrontierPhis_ << "\t ====\n";
+  dbgs() << "==== Number of skipped sigmas:  "
+         << StatNumSkippedSigmas_       << "\t ====\n";
   dbgs() << "==== Number of instructions:    "
          << StatNumInstructions_        << "\t ====\n";
   return true;
@@ -200,14 +214,69 @@ void Redefinition::createSigmaNodesForValueAt(Value *V, Value *C,
   if (C)
     GetTransitiveRedefinitions(C, BB, DT_, Redefinitions);
 
+  set<Value*> Needed;
+  getNeededRedefinitions(Redefinitions, BB, Needed);
+  StatNumSkippedSigmas_ += Redefinitions.size() - Needed.size();
+
   auto Position = BB->begin();
   while (isa<PHINode>(&(*Position)))
     Position++;
 
-  for (auto& S : Redefinitions)
+  for (auto& S : Needed)
     createSigmaNodeForValueAt(S, BB, Position);
 }
 
+// getNeededRedefinitions
+// The redefinitions at BB that can narrow a range: those of the values
+// read after BB, and those of the values they are computed from, which
+// their redefinitions are instantiated with. A sigma of any other value
+// would have no uses.
+void Redefinition::getNeededRedefinitions(const set<Value*>& Redefinitions,
+                                          BasicBlock *BB,
+                                          set<Value*>& Needed) {
+  queue<Value*> Worklist;
+  for (auto& S : Redefinitions)
+    if (isUsedAfter(S, BB))
+      Worklist.push(S);
+
+  while (!Worklist.empty()) {
+    Value *S = Worklist.front();
+    Worklist.pop();
+    if (!Needed.insert(S).second)
+      continue;
+    if (Instruction *I = dyn_cast<Instruction>(S))
+      for (auto OI = I->op_begin(), OE = I->op_end(); OI != OE; ++OI)
+        if (Redefinitions.count(*OI))
+          Worklist.push(*OI);
+  }
+}
+
+// isUsedAfter
+// Returns true if a sigma of V at BB would have a use: an instruction that
+// BB dominates, an incoming value of a phi from a block that BB dominates,
+// or a phi that would merge it at the dominance frontier of BB.
+bool Redefinition::isUsedAfter(Value *V, BasicBlock *BB) {
+  for (auto UI = V->use_begin(), UE = V->use_end(); UI != UE; ++UI) {
+    Instruction *I = dyn_cast<Instruction>(*UI);
+    if (!I)
+      continue;
+    if (DT_->dominates(BB, I->getParent()))
+      return true;
+    if (PHINode *Phi = dyn_cast<PHINode>(I))
+      for (unsigned Idx = 0; Idx < Phi->getNumIncomingValues(); ++Idx)
+        if (Phi->getIncomingValue(Idx) == V &&
+            DT_->dominates(BB, Phi->getIncomingBlock(Idx)))
+          return true;
+  }
+
+  auto DI = DF_->find(BB);
+  if (DI != DF_->end())
+    for (auto& BI : DI->second)
+      if (dominatesUse(V, BI))
+        return true;
+  return false;
+}
+
 void Redefinition::createSigmaNodeForValueAt(Value *V, BasicBlock *BB,
                                              BasicBlock::iterator Position) {
   RDEF_DEBUG(dbgs() << "createSigmaNodeForValueAt: " << *V << "\n");
@@ -305,3 +374,203 @@ void Redefinition::replaceUsesOfWithAfter(Value *V, Value *R, BasicBlock *BB) {
     I->replaceUsesOfWith(V, R);
 }
 
+
+/**********************
+ * PruneRedefinitions *
+ **********************/
+// Removes the redefinitions of -redef and -ptr-redef that can't change a
+// range: those without uses, the phis whose incoming values are all the
+// same, and, once the symbolic range analysis has run, the integer ones
+// whose range is the range of the value they redefine. It runs after the
+// live-range splitting, so that the analyses build nothing for them, and
+// again before the instrumentation, with the ranges of the analyses.
+class PruneRedefinitions : public ModulePass {
+public:
+  static char ID;
+  PruneRedefinitions() : ModulePass(ID), SRA_(NULL) { }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+  virtual bool runOnModule(Module &M);
+
+private:
+  Value *getReplacement(Instruction *I);
+  bool hasSigmaComputedFrom(PHINode *Sigma);
+  void erase(Instruction *I);
+
+  SymbolicRangeAnalysis *SRA_;
+  set<Instruction*> Pending_;
+};
+
+char PruneRedefinitions::ID = 0;
+static RegisterPass<PruneRedefinitions>
+  P("redef-prune", "Remove the redefinitions that can't change a range");
+
+// HasRedefPrefix
+// Whether the name is one -redef or -ptr-redef gives: the prefix, alone,
+// before a dot or before the number that makes it unique.
+static bool HasRedefPrefix(StringRef Name, StringRef Prefix) {
+  if (!Name.startswith(Prefix))
+    return false;
+  StringRef Rest = Name.substr(Prefix.size());
+  return Rest.empty() || Rest[0] == '.' || isdigit(Rest[0]);
+}
+
+// IsSigma
+// The single-incoming phis of -redef, and the bitcasts of -ptr-redef.
+static bool IsSigma(Instruction *I) {
+  if (PHINode *Phi = dyn_cast<PHINode>(I))
+    return Phi->getNumIncomingValues() == 1 &&
+           HasRedefPrefix(I->getName(), Redefinition::GetRedefPrefix());
+  return isa<BitCastInst>(I) &&
+         HasRedefPrefix(I->getName(), PointerRedefinition::GetRedefPrefix());
+}
+
+// IsRedefinition
+static bool IsRedefinition(Instruction *I) {
+  if (IsSigma(I))
+    return true;
+  return isa<PHINode>(I) &&
+         (HasRedefPrefix(I->getName(), Redefinition::GetPhiPrefix()) ||
+          HasRedefPrefix(I->getName(), PointerRedefinition::GetPhiPrefix()));
+}
+
+// GetSource
+// The value a chain of sigmas redefines.
+static Value *GetSource(Value *V) {
+  while (Instruction *I = dyn_cast<Instruction>(V)) {
+    if (!IsSigma(I))
+      break;
+    V = I->getOperand(0);
+  }
+  return V;
+}
+
+// getAnalysisUsage
+void PruneRedefinitions::getAnalysisUsage(AnalysisUsage &AU) const {
+  // The ranges of the values kept don't change
+  AU.addPreserved<SymbolicRangeAnalysis>();
+  AU.setPreservesCFG();
+}
+
+// runOnModule
+bool PruneRedefinitions::runOnModule(Module &M) {
+  SRA_ = getAnalysisIfAvailable<SymbolicRangeAnalysis>();
+
+  Pending_.clear();
+  for (auto& F : M)
+    for (auto& BB : F)
+      for (auto& I : BB)
+        if (IsRedefinition(&I))
+          Pending_.insert(&I);
+
+  bool Changed = false;
+  while (!Pending_.empty()) {
+    Instruction *I = *Pending_.begin();
+    Pending_.erase(Pending_.begin());
+
+    if (I->use_empty()) {
+      // Before the range analysis, the sigma of a value that another
+      // sigma of the block is computed from gives that one its range
+      PHINode *Sigma = dyn_cast<PHINode>(I);
+      if (!SRA_ && Sigma && IsSigma(I) && hasSigmaComputedFrom(Sigma))
+        continue;
+      NumPrunedDead++;
+    } else if (Value *R = getReplacement(I)) {
+      for (auto UI = I->use_begin(), UE = I->use_end(); UI != UE; ++UI)
+        if (Instruction *U = dyn_cast<Instruction>(*UI))
+          if (IsRedefinition(U))
+            Pending_.insert(U);
+      I->replaceAllUsesWith(R);
+    } else {
+      continue;
+    }
+
+    erase(I);
+    Changed = true;
+  }
+  return Changed;
+}
+
+// getReplacement
+// The value that may take the place of I everywhere, or NULL.
+Value *PruneRedefinitions::getReplacement(Instruction *I) {
+  PHINode *Phi = dyn_cast<PHINode>(I);
+
+  // A phi of a single value, besides itself
+  if (Phi && !IsSigma(I)) {
+    Value *Common = NULL;
+    for (unsigned Idx = 0; Idx < Phi->getNumIncomingValues(); ++Idx) {
+      Value *V = Phi->getIncomingValue(Idx);
+      if (V == Phi || V == Common)
+        continue;
+      if (Common)
+        return NULL;
+      Common = V;
+    }
+    if (Common) {
+      NumPrunedTrivial++;
+      return Common;
+    }
+  }
+
+  // An integer redefinition as wide as its source, whose sigmas the phi
+  // looks through
+  if (!SRA_ || !Phi || !Phi->getType()->isIntegerTy())
+    return NULL;
+  Value *Source = GetSource(Phi);
+  if (Source == Phi)
+    for (unsigned Idx = 0; Idx < Phi->getNumIncomingValues(); ++Idx) {
+      Value *V = GetSource(Phi->getIncomingValue(Idx));
+      if (V == Phi)
+        continue;
+      if (Source != Phi && V != Source)
+        return NULL;
+      Source = V;
+    }
+  if (Source == Phi || SRA_->getRange(Phi) != SRA_->getRange(Source))
+    return NULL;
+  NumPrunedRange++;
+  return Source;
+}
+
+// hasSigmaComputedFrom
+// Returns true if another sigma of the block redefines an instruction that
+// takes the source of Sigma as an operand.
+bool PruneRedefinitions::hasSigmaComputedFrom(PHINode *Sigma) {
+  Value *Source = Sigma->getIncomingValue(0);
+  for (auto& I : *Sigma->getParent()) {
+    PHINode *Phi = dyn_cast<PHINode>(&I);
+    if (!Phi)
+      break;
+    if (Phi == Sigma || !IsSigma(Phi))
+      continue;
+    if (Instruction *Redefined = dyn_cast<Instruction>(Phi->getIncomingValue(0)))
+      for (auto OI = Redefined->op_begin(), OE = Redefined->op_end();
+           OI != OE; ++OI)
+        if (*OI == Source)
+          return true;
+  }
+  return false;
+}
+
+// erase
+// Deletes I; its operands and the sigmas of its block may be prunable now.
+void PruneRedefinitions::erase(Instruction *I) {
+  for (auto OI = I->op_begin(), OE = I->op_end(); OI != OE; ++OI)
+    if (Instruction *Op = dyn_cast<Instruction>(*OI))
+      if (Op != I && IsRedefinition(Op))
+        Pending_.insert(Op);
+  if (isa<PHINode>(I))
+    for (auto& II : *I->getParent()) {
+      PHINode *Phi = dyn_cast<PHINode>(&II);
+      if (!Phi)
+        break;
+      if (Phi != I && IsSigma(Phi))
+        Pending_.insert(Phi);
+    }
+
+  Pending_.erase(I);
+  if (SRA_)
+    SRA_->forgetValue(I);
+  I->eraseFromParent();
+}
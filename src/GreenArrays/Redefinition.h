@@ -6,6 +6,8 @@
 #include "llvm/Analysis/DominanceFrontier.h"
 #include "llvm/IR/Instructions.h"
 
+#include <set>
+
 namespace llvm {
 
 class Redefinition : public FunctionPass {
@@ -13,7 +15,8 @@ public:
   static char ID;
   Redefinition()
     : FunctionPass(ID), StatNumCreatedSigmas_(0),
-      StatNumCreatedFrontierPhis_(0), StatNumInstructions_(0) { }
+      StatNumCreatedFrontierPhis_(0), StatNumSkippedSigmas_(0),
+      StatNumInstructions_(0) { }
 
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   virtual bool runOnFunction(Function &F);
@@ -33,6 +36,9 @@ private:
   PHINode *createPhiNodeAt(Value *V, BasicBlock *BB);
 
   bool dominatesUse(Value *V, BasicBlock *BB);
+  bool isUsedAfter(Value *V, BasicBlock *BB);
+  void getNeededRedefinitions(const std::set<Value*>& Redefinitions,
+                              BasicBlock *BB, std::set<Value*>& Needed);
   void replaceUsesOfWithAfter(Value *V, Value *R, BasicBlock *BB);
 
   DominatorTree *DT_;
@@ -41,6 +47,7 @@ private:
   // Statistics.
   unsigned StatNumCreatedSigmas_;
   unsigned StatNumCreatedFrontierPhis_;
+  unsigned StatNumSkippedSigmas_;
   unsigned StatNumInstructions_;
 };
 
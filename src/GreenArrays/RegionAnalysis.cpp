@@ -19,6 +19,7 @@
 #include "Expr.h"
 #include "SymbolicRangeAnalysis.h"
 #include "RegionAnalysis.h"
+#include "../PassProfile/PassProfile.h"
 
 #include <chrono>
 #include <queue>
@@ -403,6 +404,7 @@ void RegionAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
 
 // runOnModule
 bool RegionAnalysis::runOnModule(Module& M) {
+  PassProfileScope Scope("RegionAnalysis", "range analysis");
   auto Start = std::chrono::high_resolution_clock::now();
 
   bool OrRaDebug = RaDebug;
@@ -510,6 +512,8 @@ bool RegionAnalysis::runOnModule(Module& M) {
   dbgs() << "================== RA STATS =================\n";
   dbgs() << "==== Total evaluation time:     " << Elapsed << "\t ====\n";
   dbgs() << "==== Number of pointers:        " << PointersMap_.size() << "\n";
+  PassProfile::get().counter("region pointers", "range analysis",
+                             PointersMap_.size());
 
   if (RaStats) {
     dbgs() << "================== RA STATS =================\n";
@@ -564,10 +568,32 @@ void RegionAnalysis::printInfo(raw_ostream& OS) const {
   OS << "## Instruction: " << I_->getName()  << "\n";
 }
 
+// releaseMemory
+void RegionAnalysis::releaseMemory() {
+  for (auto& P : Pointers_)
+    P->~Pointer();
+  Pointers_.clear();
+  Allocator_.Reset();
+
+  PointersMap_.clear();
+  Evaluated_.clear();
+  ValueSizes_.clear();
+  ReturnVal_.clear();
+  Summaries_.clear();
+}
+
 // getRange
 Range RegionAnalysis::getRange(Value *V) {
-  if (PointersMap_.count(V))
-    return PointersMap_[V]->eval();
+  auto It = PointersMap_.find(V);
+  if (It != PointersMap_.end()) {
+    // Every access through the same pointer asks for the same range
+    auto EI = Evaluated_.find(It->second);
+    if (EI != Evaluated_.end())
+      return EI->second;
+    Range R = It->second->eval();
+    Evaluated_[It->second] = R;
+    return R;
+  }
   return Range(Expr::GetPlusInfValue(), Expr::GetMinusInfValue());
 }
 
@@ -750,7 +776,7 @@ void RegionAnalysis::createPointerForPhiNode(PHINode *Phi) {
 // createBasePointer
 BasePointer *RegionAnalysis::createBasePointer(Value *V) {
   RG_DEBUG(dbgs() << "createBasePointer: " << *V << "\n");
-  BasePointer *J = new BasePointer(V, Range(Expr::GetPlusInfValue(), Expr::GetMinusInfValue()));
+  BasePointer *J = allocate<BasePointer>(V, Range(Expr::GetPlusInfValue(), Expr::GetMinusInfValue()));
   setPointer(V, J);
   return J;
 }
@@ -758,7 +784,7 @@ BasePointer *RegionAnalysis::createBasePointer(Value *V) {
 // createBasePointer
 BasePointer *RegionAnalysis::createBasePointer(Value *V, Range R) {
   RG_DEBUG(dbgs() << "createBasePointer: " << *V << ", " << R << "\n");
-  BasePointer *J = new BasePointer(V, R);
+  BasePointer *J = allocate<BasePointer>(V, R);
   setPointer(V, J);
   return J;
 }
@@ -767,12 +793,30 @@ Range RegionAnalysis::getRangeForFunction(Function *F) {
   return ValueSizes_[F];
 }
 
+// getSummaryForFunction
+const RegionAnalysis::FunctionSummary&
+RegionAnalysis::getSummaryForFunction(Function *F) {
+  auto It = Summaries_.find(F);
+  if (It != Summaries_.end())
+    return It->second;
+
+  FunctionSummary& S = Summaries_[F];
+  S.R = getRangeForFunction(F);
+  for (auto& AI : F->getArgumentList()) {
+    Expr Formal(&AI);
+    if (S.R.getLower().has(Formal) || S.R.getUpper().has(Formal))
+      S.Formals.push_back(make_pair(AI.getArgNo(), Formal));
+  }
+  return S;
+}
+
 Range RegionAnalysis::getRangeForCall(CallInst *CI) {
   Function *F = CI->getCalledFunction();
-  Range R = getRangeForFunction(F);
-  if (!F || !ValueSizes_.count(F) || F->isVarArg())
+  if (!F || F->isVarArg())
     return Range::GetInfRange();
-  if (ValueSizes_[F] == Range::GetZeroRange()) {
+  const FunctionSummary& S = getSummaryForFunction(F);
+  Range R = S.R;
+  if (R == Range::GetZeroRange()) {
     BasicBlock *BB = CI->getParent();
     auto I = BB->rbegin();
     while (&(*I) != CI)
@@ -782,13 +826,16 @@ Range RegionAnalysis::getRangeForCall(CallInst *CI) {
   }
   //assert(F && "Indirect are not handled");
   RG_DEBUG(dbgs() << "Range for " << F->getName() << " is " << R << "\n");
+  if (S.Formals.empty())
+    return R;
+
   vector<pair<Expr, Expr> > SubsLower, SubsUpper;
-  unsigned Idx = 0;
-  for (auto& AI : F->getArgumentList()) {
-    RG_DEBUG(dbgs() << "Replace " << Expr(&AI) << " with " << Expr(CI->getArgOperand(Idx)) << "\n");
-    Range ArgR = RG_->getRange(CI->getArgOperand(Idx++));
-    SubsLower.push_back(make_pair(Expr(&AI), ArgR.getLower()));//Expr(CI->getArgOperand(Idx++))));
-    SubsUpper.push_back(make_pair(Expr(&AI), ArgR.getUpper()));//Expr(CI->getArgOperand(Idx++))));
+  for (auto& P : S.Formals) {
+    Value *Actual = CI->getArgOperand(P.first);
+    RG_DEBUG(dbgs() << "Replace " << P.second << " with " << Expr(Actual) << "\n");
+    Range ArgR = RG_->getRange(Actual);
+    SubsLower.push_back(make_pair(P.second, ArgR.getLower()));
+    SubsUpper.push_back(make_pair(P.second, ArgR.getUpper()));
   }
   R = Range(R.getLower().subs(SubsLower), R.getUpper().subs(SubsUpper));
   RG_DEBUG(dbgs() << "Subs for " << *CI << " is " << R << "\n");
@@ -798,7 +845,7 @@ Range RegionAnalysis::getRangeForCall(CallInst *CI) {
 // createPhiPointer
 PhiPointer *RegionAnalysis::createPhiPointer(Value *V) {
   RG_DEBUG(dbgs() << "createPhiPointer: " << *V << "\n");
-  PhiPointer *J = new PhiPointer(V);
+  PhiPointer *J = allocate<PhiPointer>(V);
   setPointer(V, J);
   return J;
 }
@@ -830,7 +877,7 @@ Pointer *RegionAnalysis::createCallPointer(CallInst *CI, Function *F) {
   return NULL;
   RG_DEBUG(dbgs() << "createCallPointer: " << *CI << "\n");
   //Range R = getRangeForCall(CI);
-  CallPointer *J = new CallPointer(CI, Range::GetInfRange(), Subs);
+  CallPointer *J = allocate<CallPointer>(CI, Range::GetInfRange(), Subs);
   assert(ReturnVal_[F]);
   J->pushArg(ReturnVal_[F]);
   setPointer(CI, J);
@@ -842,7 +889,7 @@ NoopPointer *RegionAnalysis::createNoopPointer(Value *V, Value *Op) {
   RG_DEBUG(dbgs() << "createNoopPointer: " << *V << " :: " << *Op << "\n");
 
   Pointer *Incoming = getPointerForValue(Op);
-  NoopPointer *J = new NoopPointer(V, Incoming);
+  NoopPointer *J = allocate<NoopPointer>(V, Incoming);
   setPointer(V, J);
   return J;
 }
@@ -850,7 +897,7 @@ NoopPointer *RegionAnalysis::createNoopPointer(Value *V, Value *Op) {
 // createNoopPointer
 NoopPointer *RegionAnalysis::createNoopPointer(Value *V) {
   RG_DEBUG(dbgs() << "createNoopPointer: " << *V << "\n");
-  NoopPointer *J = new NoopPointer(V);
+  NoopPointer *J = allocate<NoopPointer>(V);
   setPointer(V, J);
   return J;
 }
@@ -898,7 +945,7 @@ IndexPointer *RegionAnalysis::createIndexPointer(GetElementPtrInst *GEP) {
 
   Range R(Lower, Upper);
   RG_DEBUG(dbgs() << "Index: " << R << "\n");
-  IndexPointer *J = new IndexPointer(GEP, Incoming, R);
+  IndexPointer *J = allocate<IndexPointer>(GEP, Incoming, R);
   setPointer(GEP, J);
   return J;
 }
@@ -14,6 +14,9 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Value.h"
+#include "llvm/Support/Allocator.h"
+
+#include <utility>
 
 namespace llvm {
 
@@ -35,6 +38,7 @@ public:
 
   Pointer(Value *Value);
   Pointer(Value *Value, Range R);
+  virtual ~Pointer() { }
 
   // RTTI for Pointer.
   enum ValueId { BASE_PTR, CALL_PTR, NOOP_PTR, INDEX_PTR, PHI_PTR }; 
@@ -208,6 +212,7 @@ class RegionAnalysis : public ModulePass {
 public:
   static char ID;
   RegionAnalysis() : ModulePass(ID) { }
+  ~RegionAnalysis() { releaseMemory(); }
 
   typedef DenseMap<Value*, Pointer*> PointersMapTy;
 
@@ -219,6 +224,7 @@ public:
 
   virtual void getAnalysisUsage(AnalysisUsage &AU) const;
   virtual bool runOnModule(Module &M);
+  virtual void releaseMemory();
 
   virtual void print(raw_ostream& OS) const;
   void printAsDot(raw_ostream& OS) const;
@@ -230,7 +236,15 @@ public:
 private:
   void setPointer(Value *V, Pointer *J); 
 
+  // The region returned by a function, in terms of the formal parameters
+  // it mentions: calls only substitute those.
+  struct FunctionSummary {
+    Range R;
+    vector<pair<unsigned, Expr> > Formals; // Argument number, symbol
+  };
+
   Range getRangeForFunction(Function *F);
+  const FunctionSummary& getSummaryForFunction(Function *F);
   Range getRangeForCall(CallInst *CI);
 
   void createConstraintsForFunction(Function *F);
@@ -259,6 +273,15 @@ private:
   PhiPointer   *createPhiPointer(Value *V); 
   BasePointer  *createPointerForType(Value *V, Type *T); 
 
+  // Pointers live in Allocator_ until releaseMemory()
+  template <class PointerTy, class... ArgTys>
+  PointerTy *allocate(ArgTys&&... Args) {
+    PointerTy *P = new (Allocator_.Allocate<PointerTy>())
+                     PointerTy(std::forward<ArgTys>(Args)...);
+    Pointers_.push_back(P);
+    return P;
+  }
+
   Function   *F_;
   BasicBlock *BB_;
   Value      *I_;
@@ -271,9 +294,15 @@ private:
 
   LLVMContext *Context;
 
+  BumpPtrAllocator Allocator_;
+  vector<Pointer*> Pointers_;
+
   PointersMapTy PointersMap_;
+  // The ranges getRange() evaluated already
+  DenseMap<Pointer*, Range> Evaluated_;
   DenseMap<Value*, Range>    ValueSizes_;
   DenseMap<Function*, Pointer*> ReturnVal_;
+  DenseMap<Function*, FunctionSummary> Summaries_;
 };
 
 } // end namespace llvm
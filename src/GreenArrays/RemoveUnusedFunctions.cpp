@@ -1,44 +1,52 @@
-//===------------------------ RegionAnalysis.cpp --------------------------===//
+//===-------------------- RemoveUnusedFunctions.cpp -----------------------===//
 //===----------------------------------------------------------------------===//
+// Prunes the module before the analyses run: the functions and globals that
+// nothing reachable from the roots references, and the blocks that the entry
+// of their function doesn't reach. The roots are main, the names given with
+// -ruf-roots, the llvm.* globals (llvm.used, the constructors...) and, in a
+// module without main, every externally visible definition. A function whose
+// address a reachable function takes is reachable, since it may be called
+// through the pointer.
+//===----------------------------------------------------------------------===//
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Statistic.h"
-#include "llvm/ADT/SetVector.h"
-#include "llvm/ADT/PostOrderIterator.h"
-#include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Constants.h"
-#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CFG.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
-#include "llvm/Transforms/Scalar.h"
-#include "llvm/Transforms/Utils/BasicBlockUtils.h"
-#include "llvm/ADT/STLExtras.h"
-#include "llvm/Analysis/MemoryBuiltins.h"
-#include "llvm/Target/TargetLibraryInfo.h"
-
-#include "PointerRedefinition.h"
-#include "Expr.h"
-#include "SymbolicRangeAnalysis.h"
-#include "RegionAnalysis.h"
-
-#include <queue>
-#include <set>
-#include <sstream>
+
 #include <string>
 #include <vector>
 
-#include "llvm/Pass.h"
-#include "llvm/ADT/DenseMap.h"
-#include "llvm/Analysis/Dominators.h"
-#include "llvm/Analysis/DominanceFrontier.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/IR/DataLayout.h"
-#include "llvm/IR/Module.h"
-#include "llvm/IR/Function.h"
-#include "llvm/IR/Value.h"
+#define DEBUG_TYPE "remove-unused-functions"
+
+STATISTIC(NumFunctionsRemoved, "Number of unreachable functions removed");
+STATISTIC(NumGlobalsRemoved, "Number of unreferenced globals removed");
+STATISTIC(NumBlocksRemoved, "Number of unreachable basic blocks removed");
+STATISTIC(NumInstructionsBefore, "Number of instructions before the pruning");
+STATISTIC(NumInstructionsRemoved, "Number of instructions removed by the pruning");
 
 /* ************************************************************************** */
 /* ************************************************************************** */
 
+using namespace llvm;
+using std::string;
+using std::vector;
+
+static cl::list<string>
+  ClRoots("ruf-roots",
+          cl::desc("Functions and globals that remove-unused-functions keeps, "
+                   "with what they reach, besides main"),
+          cl::CommaSeparated);
+
 namespace llvm {
 
 class RemoveUnusedFunctions : public ModulePass {
@@ -47,37 +55,190 @@ public:
   RemoveUnusedFunctions() : ModulePass(ID) { }
 
   virtual bool runOnModule(Module &M);
+
+private:
+  SmallPtrSet<GlobalValue*, 64> Reachable;
+  vector<GlobalValue*> Worklist;
+  // The blocks that the entry of each reachable function reaches
+  SmallPtrSet<BasicBlock*, 256> LiveBlocks;
+
+  void markReachable(GlobalValue *GV);
+  void markReferences(Constant *C, SmallPtrSet<Constant*, 16> &Visited);
+  void visitFunction(Function &F);
+  unsigned removeDeadBlocks(Function &F);
 };
 
 }
-  
-using namespace llvm;
-using std::set;
+
+void RemoveUnusedFunctions::markReachable(GlobalValue *GV) {
+  if (Reachable.insert(GV))
+    Worklist.push_back(GV);
+}
+
+// Marks the globals that a constant refers to, through constant expressions
+// and aggregates.
+void RemoveUnusedFunctions::markReferences(Constant *C,
+                                           SmallPtrSet<Constant*, 16> &Visited) {
+  if (GlobalValue *GV = dyn_cast<GlobalValue>(C)) {
+    markReachable(GV);
+    return;
+  }
+  if (!Visited.insert(C))
+    return;
+  for (User::op_iterator O = C->op_begin(), E = C->op_end(); O != E; ++O)
+    if (Constant *Op = dyn_cast<Constant>(*O))
+      markReferences(Op, Visited);
+}
+
+void RemoveUnusedFunctions::visitFunction(Function &F) {
+  if (F.isDeclaration())
+    return;
+
+  SmallVector<BasicBlock*, 32> Stack;
+  Stack.push_back(&F.getEntryBlock());
+  LiveBlocks.insert(&F.getEntryBlock());
+  SmallPtrSet<Constant*, 16> Visited;
+
+  while (!Stack.empty()) {
+    BasicBlock *BB = Stack.pop_back_val();
+    for (auto& I : *BB)
+      for (User::op_iterator O = I.op_begin(), E = I.op_end(); O != E; ++O)
+        if (Constant *C = dyn_cast<Constant>(*O))
+          markReferences(C, Visited);
+
+    for (succ_iterator S = succ_begin(BB), E = succ_end(BB); S != E; ++S)
+      if (LiveBlocks.insert(*S))
+        Stack.push_back(*S);
+  }
+}
+
+// Removes the blocks of F that its entry doesn't reach; returns the number
+// of instructions removed.
+unsigned RemoveUnusedFunctions::removeDeadBlocks(Function &F) {
+  vector<BasicBlock*> Dead;
+  for (auto& BB : F)
+    if (!LiveBlocks.count(&BB))
+      Dead.push_back(&BB);
+
+  unsigned NumInstructions = 0;
+  for (auto& BB : Dead) {
+    for (succ_iterator S = succ_begin(BB), E = succ_end(BB); S != E; ++S)
+      if (LiveBlocks.count(*S))
+        (*S)->removePredecessor(BB);
+    NumInstructions += BB->size();
+    BB->dropAllReferences();
+  }
+  for (auto& BB : Dead)
+    BB->eraseFromParent();
+
+  NumBlocksRemoved += Dead.size();
+  return NumInstructions;
+}
 
 bool RemoveUnusedFunctions::runOnModule(Module& M) {
-  set<Function*> Functions;
-  unsigned NumRemoved = 0;
-
-  for (auto& F : M) {
-    if (F.getName() == "main")
-      continue;
-    // errs() << F.getName() << ", " << F.getNumUses() << "\n";
-    if (!F.getNumUses())
-      Functions.insert(&F);
+  Reachable.clear();
+  Worklist.clear();
+  LiveBlocks.clear();
+
+  unsigned NumInstructions = 0;
+  for (auto& F : M)
+    for (auto& BB : F)
+      NumInstructions += BB.size();
+  NumInstructionsBefore += NumInstructions;
+
+  // The roots
+  Function *Main = M.getFunction("main");
+  if (Main)
+    markReachable(Main);
+  for (auto& Name : ClRoots)
+    if (GlobalValue *GV = M.getNamedValue(Name))
+      markReachable(GV);
+  for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+       G != E; ++G)
+    if (G->getName().startswith("llvm.") ||
+        (!Main && !G->isDeclaration() && !G->hasLocalLinkage()))
+      markReachable(G);
+  // The aliases stay: the globals they name can't lose their bodies
+  for (Module::alias_iterator A = M.alias_begin(), E = M.alias_end();
+       A != E; ++A)
+    markReachable(A);
+  if (!Main)
+    for (auto& F : M)
+      if (!F.isDeclaration() && !F.hasLocalLinkage())
+        markReachable(&F);
+
+  while (!Worklist.empty()) {
+    GlobalValue *GV = Worklist.back();
+    Worklist.pop_back();
+
+    SmallPtrSet<Constant*, 16> Visited;
+    if (Function *F = dyn_cast<Function>(GV))
+      visitFunction(*F);
+    else if (GlobalVariable *G = dyn_cast<GlobalVariable>(GV)) {
+      if (G->hasInitializer())
+        markReferences(G->getInitializer(), Visited);
+    } else if (GlobalAlias *A = dyn_cast<GlobalAlias>(GV)) {
+      if (Constant *Aliasee = A->getAliasee())
+        markReferences(Aliasee, Visited);
+    }
   }
 
-  for (auto& F : Functions) {
-    NumRemoved++;
-    // errs() << "Removing: " << F->getName() << "\n";
-    F->eraseFromParent();
-    // errs() << "Removed\n";
+  unsigned Removed = 0;
+  for (auto& F : M)
+    if (Reachable.count(&F) && !F.isDeclaration())
+      Removed += removeDeadBlocks(F);
+
+  // Drop the bodies and initializers of the dead globals before erasing
+  // them, as GlobalDCE does, so that they no longer refer to each other.
+  // Dead constant expressions may still use them; the globals that keep a
+  // use stay as declarations.
+  vector<Function*> DeadFunctions;
+  vector<GlobalVariable*> DeadGlobals;
+  for (auto& F : M)
+    if (!Reachable.count(&F)) {
+      DEBUG(dbgs() << "Removing: " << F.getName() << "\n");
+      for (auto& BB : F)
+        Removed += BB.size();
+      if (!F.isDeclaration())
+        F.deleteBody();
+      DeadFunctions.push_back(&F);
+    }
+  for (Module::global_iterator G = M.global_begin(), E = M.global_end();
+       G != E; ++G)
+    if (!Reachable.count(G)) {
+      if (G->hasInitializer()) {
+        G->setInitializer(0);
+        G->setLinkage(GlobalValue::ExternalLinkage);
+      }
+      DeadGlobals.push_back(G);
+    }
+
+  for (auto& F : DeadFunctions) {
+    F->removeDeadConstantUsers();
+    if (F->use_empty()) {
+      F->eraseFromParent();
+      ++NumFunctionsRemoved;
+    }
+  }
+  for (auto& G : DeadGlobals) {
+    G->removeDeadConstantUsers();
+    if (G->use_empty()) {
+      G->eraseFromParent();
+      ++NumGlobalsRemoved;
+    }
   }
+  NumInstructionsRemoved += Removed;
 
   dbgs() << "==================== RUF ====================\n";
-  dbgs() << "==== # of removed functions:   " << NumRemoved << "\n";
+  dbgs() << "==== # of removed functions:   " << NumFunctionsRemoved << "\n";
+  dbgs() << "==== # of removed globals:     " << NumGlobalsRemoved << "\n";
+  dbgs() << "==== # of removed blocks:      " << NumBlocksRemoved << "\n";
+  dbgs() << "==== # of removed instructions: " << Removed << " of "
+         << NumInstructions << "\n";
 
-  return false;
+  return Removed || !DeadFunctions.empty() || !DeadGlobals.empty();
 }
 
 char RemoveUnusedFunctions::ID = 0;
-static RegisterPass<RemoveUnusedFunctions> X("remove-unused-functions", "Remove unused functions");
+static RegisterPass<RemoveUnusedFunctions> X("remove-unused-functions",
+  "Remove the functions, globals and blocks unreachable from main");
@@ -0,0 +1,235 @@
+//===--------------------------- SiteCounters.cpp -------------------------===//
+//===----------------------------------------------------------------------===//
+// The counters of the sites of a sanitizer, and the constructor that maps
+// them to their file. See SiteCounters.h.
+//===----------------------------------------------------------------------===//
+
+#include "SiteCounters.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/DebugInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+using namespace llvm;
+
+// The flags of open and mmap, as Linux defines them.
+static const int kO_RDWR = 02;
+static const int kO_CREAT = 0100;
+static const int kPROT_READ_WRITE = 3;
+static const int kMAP_SHARED = 1;
+static const int kSEEK_END = 2;
+static const unsigned kPathMax = 4096;
+// Run before the constructors of the sanitizers, so that the accesses of
+// the other constructors are counted in the file.
+static const int kSiteCountersCtorPriority = 0;
+
+SiteCounters::SiteCounters(Module &M, StringRef Tool, StringRef ReportPath,
+                           unsigned PointerBits)
+    : M(M), Tool(Tool), ReportPath(ReportPath), PointerBits(PointerBits) {
+  SmallString<256> Path(ReportPath);
+  sys::fs::make_absolute(Path);
+  CountsPath = Path.str();
+  CountsPath += ".counts";
+
+  // Its initializer, the static table, is only known with the number of
+  // sites.
+  Table = new GlobalVariable(M, Type::getInt64PtrTy(M.getContext()), false,
+                             GlobalValue::InternalLinkage, 0,
+                             "__ga_site_counts");
+}
+
+unsigned SiteCounters::addSite(Instruction *I, StringRef Reason,
+                               bool Checked) {
+  unsigned ID = Sites.size();
+  Site S;
+  S.Function = I->getParent()->getParent()->getName();
+  S.Line = S.Column = 0;
+  if (MDNode *N = I->getMetadata("dbg")) {
+    DILocation Loc(N);
+    S.File = Loc.getFilename();
+    S.Line = Loc.getLineNumber();
+    S.Column = Loc.getColumnNumber();
+  }
+  S.Access = I->getOpcodeName();
+  S.Reason = Reason;
+  S.Checked = Checked;
+  Sites.push_back(S);
+
+  IRBuilder<> IRB(I);
+  Value *Counter = IRB.CreateConstInBoundsGEP1_32(IRB.CreateLoad(Table), ID);
+  IRB.CreateAtomicRMW(AtomicRMWInst::Add, Counter, IRB.getInt64(1),
+                      Monotonic);
+  return ID;
+}
+
+bool SiteCounters::finish() {
+  if (Sites.empty()) {
+    Table->eraseFromParent();
+    Table = 0;
+  } else {
+    ArrayType *Ty = ArrayType::get(Type::getInt64Ty(M.getContext()),
+                                   Sites.size());
+    GlobalVariable *Fallback = new GlobalVariable(
+        M, Ty, false, GlobalValue::InternalLinkage,
+        ConstantAggregateZero::get(Ty), "__ga_site_counts_static");
+    Table->setInitializer(ConstantExpr::getBitCast(
+        Fallback, Table->getType()->getElementType()));
+    createConstructor();
+  }
+  return writeReport();
+}
+
+/*
+ * The constructor opens the counts file, named by the report or by
+ * GA_SITE_COUNTS, gives it the size of the table (from zero, if it had
+ * another size) and maps it over the static table.
+ */
+void SiteCounters::createConstructor() {
+  LLVMContext &C = M.getContext();
+  IRBuilder<> IRB(C);
+  IntegerType *IntptrTy = Type::getIntNTy(C, PointerBits);
+  Type *Int8PtrTy = IRB.getInt8PtrTy();
+  Type *Int32Ty = IRB.getInt32Ty();
+
+  Type *SNPrintFArgs[] = { Int8PtrTy, IntptrTy, Int8PtrTy };
+  Constant *SNPrintF = M.getOrInsertFunction(
+      "snprintf", FunctionType::get(Int32Ty, SNPrintFArgs, true));
+  Type *OpenArgs[] = { Int8PtrTy, Int32Ty };
+  Constant *Open = M.getOrInsertFunction(
+      "open", FunctionType::get(Int32Ty, OpenArgs, true));
+  Constant *GetEnv = M.getOrInsertFunction("getenv", Int8PtrTy, Int8PtrTy,
+                                           NULL);
+  Constant *LSeek = M.getOrInsertFunction("lseek", IntptrTy, Int32Ty,
+                                          IntptrTy, Int32Ty, NULL);
+  Constant *FTruncate = M.getOrInsertFunction("ftruncate", Int32Ty, Int32Ty,
+                                              IntptrTy, NULL);
+  Constant *MMap = M.getOrInsertFunction("mmap", Int8PtrTy, Int8PtrTy,
+                                         IntptrTy, Int32Ty, Int32Ty, Int32Ty,
+                                         IntptrTy, NULL);
+  Constant *Close = M.getOrInsertFunction("close", Int32Ty, Int32Ty, NULL);
+
+  Function *Ctor = Function::Create(
+      FunctionType::get(IRB.getVoidTy(), false), GlobalValue::InternalLinkage,
+      "__ga_site_counts_map", &M);
+  BasicBlock *Entry = BasicBlock::Create(C, "", Ctor);
+  BasicBlock *FromEnv = BasicBlock::Create(C, "from_env", Ctor);
+  BasicBlock *OpenBB = BasicBlock::Create(C, "open", Ctor);
+  BasicBlock *Opened = BasicBlock::Create(C, "opened", Ctor);
+  BasicBlock *Reset = BasicBlock::Create(C, "reset", Ctor);
+  BasicBlock *MapBB = BasicBlock::Create(C, "map", Ctor);
+  BasicBlock *Mapped = BasicBlock::Create(C, "mapped", Ctor);
+  BasicBlock *CloseBB = BasicBlock::Create(C, "close", Ctor);
+  BasicBlock *Done = BasicBlock::Create(C, "done", Ctor);
+  Constant *Size = ConstantInt::get(IntptrTy, Sites.size() * 8);
+  Constant *Zero = ConstantInt::get(IntptrTy, 0);
+
+  IRB.SetInsertPoint(Entry);
+  Value *Buffer = IRB.CreateConstInBoundsGEP2_32(
+      IRB.CreateAlloca(ArrayType::get(IRB.getInt8Ty(), kPathMax)), 0, 0);
+  Value *DefaultPath = IRB.CreateGlobalStringPtr(CountsPath);
+  Value *Dir = IRB.CreateCall(GetEnv,
+                              IRB.CreateGlobalStringPtr("GA_SITE_COUNTS"));
+  IRB.CreateCondBr(IRB.CreateIsNull(Dir), OpenBB, FromEnv);
+
+  IRB.SetInsertPoint(FromEnv);
+  Value *PrintArgs[] = {
+    Buffer, ConstantInt::get(IntptrTy, kPathMax),
+    IRB.CreateGlobalStringPtr("%s/%s"), Dir,
+    IRB.CreateGlobalStringPtr(sys::path::filename(CountsPath))
+  };
+  IRB.CreateCall(SNPrintF, PrintArgs);
+  IRB.CreateBr(OpenBB);
+
+  IRB.SetInsertPoint(OpenBB);
+  PHINode *Path = IRB.CreatePHI(Int8PtrTy, 2);
+  Path->addIncoming(DefaultPath, Entry);
+  Path->addIncoming(Buffer, FromEnv);
+  Value *Fd = IRB.CreateCall3(Open, Path, IRB.getInt32(kO_RDWR | kO_CREAT),
+                              IRB.getInt32(0644));
+  IRB.CreateCondBr(IRB.CreateICmpSLT(Fd, IRB.getInt32(0)), Done, Opened);
+
+  IRB.SetInsertPoint(Opened);
+  Value *End = IRB.CreateCall3(LSeek, Fd, Zero, IRB.getInt32(kSEEK_END));
+  IRB.CreateCondBr(IRB.CreateICmpEQ(End, Size), MapBB, Reset);
+
+  // The counts of another table: start over
+  IRB.SetInsertPoint(Reset);
+  IRB.CreateCall2(FTruncate, Fd, Zero);
+  IRB.CreateCondBr(IRB.CreateIsNull(IRB.CreateCall2(FTruncate, Fd, Size)),
+                   MapBB, CloseBB);
+
+  IRB.SetInsertPoint(MapBB);
+  Value *MapArgs[] = {
+    ConstantPointerNull::get(IRB.getInt8PtrTy()), Size,
+    IRB.getInt32(kPROT_READ_WRITE), IRB.getInt32(kMAP_SHARED), Fd, Zero
+  };
+  Value *Mem = IRB.CreateCall(MMap, MapArgs);
+  Constant *MapFailed = ConstantExpr::getIntToPtr(
+      ConstantInt::get(IntptrTy, -1, true), Int8PtrTy);
+  IRB.CreateCondBr(IRB.CreateICmpEQ(Mem, MapFailed), CloseBB, Mapped);
+
+  IRB.SetInsertPoint(Mapped);
+  IRB.CreateStore(IRB.CreateBitCast(Mem, Table->getType()->getElementType()),
+                  Table);
+  IRB.CreateBr(CloseBB);
+
+  // The mapping outlives the descriptor
+  IRB.SetInsertPoint(CloseBB);
+  IRB.CreateCall(Close, Fd);
+  IRB.CreateBr(Done);
+
+  IRB.SetInsertPoint(Done);
+  IRB.CreateRetVoid();
+
+  appendToGlobalCtors(M, Ctor, kSiteCountersCtorPriority);
+}
+
+static void printJSONString(raw_ostream &OS, StringRef S) {
+  OS << '"';
+  for (size_t i = 0, n = S.size(); i != n; i++) {
+    unsigned char Ch = S[i];
+    if (Ch == '"' || Ch == '\\')
+      OS << '\\' << Ch;
+    else if (Ch < 0x20)
+      OS << "\\u00" << hexdigit(Ch >> 4) << hexdigit(Ch & 15);
+    else
+      OS << Ch;
+  }
+  OS << '"';
+}
+
+bool SiteCounters::writeReport() const {
+  std::string ErrorInfo;
+  raw_fd_ostream OS(ReportPath.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << Tool << ": can't write the site report " << ReportPath << ": "
+           << ErrorInfo << "\n";
+    return false;
+  }
+
+  OS << "{\n  \"tool\": ";
+  printJSONString(OS, Tool);
+  OS << ",\n  \"counts\": ";
+  printJSONString(OS, CountsPath);
+  OS << ",\n  \"sites\": [";
+  for (size_t i = 0, n = Sites.size(); i != n; i++) {
+    const Site &S = Sites[i];
+    OS << (i ? ",\n" : "\n") << "    { \"site\": " << i << ", \"function\": ";
+    printJSONString(OS, S.Function);
+    OS << ", \"file\": ";
+    printJSONString(OS, S.File);
+    OS << ", \"line\": " << S.Line << ", \"column\": " << S.Column
+       << ", \"access\": \"" << S.Access << "\", \"reason\": \"" << S.Reason
+       << "\", \"checked\": " << (S.Checked ? "true" : "false") << " }";
+  }
+  OS << (Sites.empty() ? "]" : "\n  ]") << "\n}\n";
+  return true;
+}
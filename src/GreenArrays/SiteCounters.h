@@ -0,0 +1,77 @@
+//===---------------------------- SiteCounters.h --------------------------===//
+//===----------------------------------------------------------------------===//
+// Execution counts of the sites of a sanitizer, for the run-time profiles of
+// the checks: each site gets a 64-bit counter, incremented by one relaxed
+// atomic add before its instruction, whether its check was kept or removed.
+// The counters of a module are a table in a file mapped shared by a
+// constructor, so that the kernel writes them out at exit, even when the
+// program aborts on a failing check; runs add up in the same file.
+//
+// At compile time the sites are written to a JSON report:
+//
+//   { "tool": "ga-asan", "counts": "/abs/path/report.json.counts",
+//     "sites": [ { "site": 0, "function": "f", "file": "f.c", "line": 3,
+//                  "column": 7, "access": "load", "reason": "no-proof",
+//                  "checked": true }, ... ] }
+//
+// and at run time the counts to the file of "counts": one native uint64
+// per site, in the order of "sites". The environment variable
+// GA_SITE_COUNTS, when set, is the directory of the counts file instead.
+// tests/site_counts.py joins the two. A file of another number of sites,
+// that of an earlier build, is started over.
+//
+// The run-time side only calls libc (getenv, snprintf, open, ftruncate, mmap
+// and close), with the flags of Linux. Until the constructor runs, and if
+// the file can't be mapped, the counters are a static table of the module.
+//===----------------------------------------------------------------------===//
+#ifndef SITECOUNTERS_H_
+#define SITECOUNTERS_H_
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class SiteCounters {
+public:
+  // Tool names the sanitizer in the report; ReportPath is the file of the
+  // report, and with ".counts" appended, the default counts file.
+  SiteCounters(Module &M, StringRef Tool, StringRef ReportPath,
+               unsigned PointerBits);
+
+  // A new site for I, which the sanitizer checks or not for Reason; the
+  // counter is incremented right before I. Returns the ID of the site.
+  unsigned addSite(Instruction *I, StringRef Reason, bool Checked);
+
+  unsigned size() const { return Sites.size(); }
+
+  // Creates the table and its constructor, once every site is known, and
+  // writes the report. False if the report can't be written.
+  bool finish();
+
+private:
+  struct Site {
+    std::string Function, File, Access, Reason;
+    unsigned Line, Column;
+    bool Checked;
+  };
+
+  void createConstructor();
+  bool writeReport() const;
+
+  Module &M;
+  std::string Tool, ReportPath, CountsPath;
+  unsigned PointerBits;
+  // Points to the counters: the mapped file, or the static table
+  GlobalVariable *Table;
+  std::vector<Site> Sites;
+};
+
+}
+
+#endif /* SITECOUNTERS_H_ */
@@ -3,11 +3,18 @@
 
 #include "SymbolicRangeAnalysis.h"
 #include "Redefinition.h"
+#include "../PassProfile/ModuleMetrics.h"
+#include "../PassProfile/PassProfile.h"
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Timer.h"
 
 #include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
 
 /* ************************************************************************** */
 /* ************************************************************************** */
@@ -58,6 +65,52 @@ static cl::opt<bool>
                    "analysis"),
           cl::Hidden, cl::init(false));
 
+static cl::opt<bool>
+  ClWorklist("sra-worklist",
+             cl::desc("Solve the junction graph with a worklist instead of "
+                      "evaluating the junctions recursively"),
+             cl::Hidden, cl::init(true));
+
+static cl::opt<unsigned>
+  ClWidenAfter("sra-widen-after",
+               cl::desc("Changes of a phi junction before it is widened, by "
+                        "the worklist solver"),
+               cl::Hidden, cl::init(2));
+
+static cl::opt<unsigned>
+  ClMaxJunctions("sra-max-junctions",
+                 cl::desc("Junctions of a function above which its values "
+                          "get [-inf, +inf], 0 for no limit"),
+                 cl::Hidden, cl::init(0));
+
+static cl::opt<int>
+  ClMaxDegree("sra-max-degree",
+              cl::desc("Degree of a bound above which the range of the "
+                       "value becomes [-inf, +inf], 0 for no limit"),
+              cl::Hidden, cl::init(0));
+
+static cl::opt<unsigned>
+  ClTimeBudget("sra-time-budget",
+               cl::desc("Milliseconds for solving the junction graph of a "
+                        "module, after which the ranges left get "
+                        "[-inf, +inf], 0 for no limit"),
+               cl::Hidden, cl::init(0));
+
+// The budgets of a huge module (ModuleMetrics::isHuge) without the options
+static const unsigned HugeModuleMaxJunctions = 50000;
+static const unsigned HugeModuleTimeBudget = 600000;
+
+static cl::opt<string>
+  ClRangesOut("sra-ranges-out",
+              cl::desc("Write the ranges to a binary range file"),
+              cl::Hidden, cl::init(""));
+
+static cl::opt<string>
+  ClRangesIn("sra-ranges-in",
+             cl::desc("Read the ranges from a binary range file instead of "
+                      "computing them"),
+             cl::Hidden, cl::init(""));
+
 static cl::opt<string>
   ClDebugFunction("sra-debug-function",
                   cl::desc("Run and debug the symbolic range analysis "
@@ -171,6 +224,61 @@ Range GetEvalMeet(Junction::ArgsTy Args) {
   return R;
 }
 
+// GetFunction
+static Function *GetFunction(Value *V) {
+  if (Instruction *I = dyn_cast<Instruction>(V))
+    return I->getParent()->getParent();
+  if (Argument *A = dyn_cast<Argument>(V))
+    return A->getParent();
+  return NULL;
+}
+
+// IsBottom
+static bool IsBottom(const Range& R) {
+  return R.getLower() == Expr::GetBottomValue();
+}
+
+// Intersect
+// The range R of a value once it's known to compare with Predicate to a
+// value in Bound.
+static Range Intersect(unsigned Predicate, Range R, Range Bound) {
+  if (R.getLower() == Expr::GetBottomValue())
+    R.setLower(Expr::GetMinusInfValue());
+  if (R.getUpper() == Expr::GetBottomValue())
+    R.setUpper(Expr::GetPlusInfValue());
+
+  // TODO: Explain.
+  if (Bound.getLower() == Expr::GetBottomValue())
+    Bound.setLower(Expr::GetMinusInfValue());
+  if (Bound.getUpper() == Expr::GetBottomValue())
+    Bound.setUpper(Expr::GetPlusInfValue());
+
+  switch (Predicate) {
+    case ICmpInst::ICMP_SLT:
+    case ICmpInst::ICMP_ULT:
+      R.setUpper(Bound.getUpper() - 1);
+      break;
+    case ICmpInst::ICMP_SLE:
+    case ICmpInst::ICMP_ULE:
+      R.setUpper(Bound.getUpper());
+      break;
+    case ICmpInst::ICMP_SGT:
+    case ICmpInst::ICMP_UGT:
+      R.setLower(Bound.getLower() + 1);
+      break;
+    case ICmpInst::ICMP_SGE:
+    case ICmpInst::ICMP_UGE:
+      R.setLower(Bound.getLower());
+      break;
+    case ICmpInst::ICMP_NE:
+    case ICmpInst::ICMP_EQ:
+      break;
+    default:
+      assert(false && "Invalid predicate");
+  }
+  return R;
+}
+
 /* ************************************************************************** */
 /* ************************************************************************** */
 
@@ -251,10 +359,27 @@ size_t Junction::getNumArgs() const {
 }
 
 // subs
-void Junction::subs(DenseMap<Junction*, Junction*> Subs) {
-  for (unsigned Idx = 0; Idx < getNumArgs(); ++Idx)
-    if (Subs.count(getArg(Idx)))
-      setArg(Idx, Subs[getArg(Idx)]);
+void Junction::subs(const SubsMapTy& Subs) {
+  for (unsigned Idx = 0; Idx < getNumArgs(); ++Idx) {
+    auto It = Subs.find(getArg(Idx));
+    if (It != Subs.end())
+      setArg(Idx, It->second);
+  }
+}
+
+// hasArgIn
+bool Junction::hasArgIn(const SubsMapTy& Subs) const {
+  for (auto& J : *this)
+    if (Subs.count(J))
+      return true;
+  return false;
+}
+
+// instantiate
+Junction *Junction::instantiate(Value *V, const SubsMapTy& Subs) {
+  if (!hasArgIn(Subs))
+    return this;
+  return clone(V, Subs);
 }
 
 unsigned Junction::Idxs_ = 0;
@@ -268,7 +393,7 @@ BaseJunction::BaseJunction(Value *V, Expr Sym)
 }
 
 // clone
-Junction *BaseJunction::clone(Value *V, DenseMap<Junction*, Junction*>) {
+Junction *BaseJunction::clone(Value *V, const SubsMapTy&) {
   Junction *J = new BaseJunction(V, getSymbol());
   // TODO:
   // Why did I comment this?
@@ -282,6 +407,11 @@ Range BaseJunction::eval() {
   return getRange();
 }
 
+// transfer
+Range BaseJunction::transfer() {
+  return getRange();
+}
+
 /****************
  * NoopJunction *
  ****************/
@@ -291,7 +421,7 @@ NoopJunction::NoopJunction(Value *V, Junction *J)
 }
 
 // clone
-Junction *NoopJunction::clone(Value *V, DenseMap<Junction*, Junction*>) {
+Junction *NoopJunction::clone(Value *V, const SubsMapTy&) {
   return new NoopJunction(V, getArg(0));
 }
 
@@ -307,6 +437,11 @@ Range NoopJunction::eval() {
   return R;
 }
 
+// transfer
+Range NoopJunction::transfer() {
+  return getArg(0)->getRange();
+}
+
 /*****************
  * SigmaJunction *
  *****************/
@@ -323,7 +458,7 @@ void SigmaJunction::printEpilog(raw_ostream& OS) const {
 }
 
 // clone
-Junction *SigmaJunction::clone(Value *V, DenseMap<Junction*, Junction*> Subs) {
+Junction *SigmaJunction::clone(Value *V, const SubsMapTy& Subs) {
   SigmaJunction *J = new SigmaJunction(V, getPredicate(), getBound(),
                                        getIncoming());
   J->subs(Subs);
@@ -335,49 +470,20 @@ Range SigmaJunction::eval() {
   unsigned Idx = EvalIdx_++;
   RG_DEBUG_EVAL(dbgs() << "eval(): " << *this << ", " << Idx << "\n");
 
-  Range R = getIncoming()->eval();
-
-  if (R.getLower() == Expr::GetBottomValue())
-    R.setLower(Expr::GetMinusInfValue());
-  if (R.getUpper() == Expr::GetBottomValue())
-    R.setUpper(Expr::GetPlusInfValue());
-
-  // TODO: Explain.
-  Range Bound = getBound()->eval();
-  if (Bound.getLower() == Expr::GetBottomValue())
-    Bound.setLower(Expr::GetMinusInfValue());
-  if (Bound.getUpper() == Expr::GetBottomValue())
-    Bound.setUpper(Expr::GetPlusInfValue());
-
-  switch (getPredicate()) {
-    case ICmpInst::ICMP_SLT:
-    case ICmpInst::ICMP_ULT:
-      R.setUpper(Bound.getUpper() - 1);
-      break;
-    case ICmpInst::ICMP_SLE:
-    case ICmpInst::ICMP_ULE:
-      R.setUpper(Bound.getUpper());
-      break;
-    case ICmpInst::ICMP_SGT:
-    case ICmpInst::ICMP_UGT:
-      R.setLower(Bound.getLower() + 1);
-      break;
-    case ICmpInst::ICMP_SGE:
-    case ICmpInst::ICMP_UGE:
-      R.setLower(Bound.getLower());
-      break;
-    case ICmpInst::ICMP_NE:
-    case ICmpInst::ICMP_EQ:
-      break;
-    default:
-      assert(false && "Invalid predicate");
-  }
+  Range Incoming = getIncoming()->eval();
+  Range R = Intersect(getPredicate(), Incoming, getBound()->eval());
 
   RG_DEBUG_EVAL(dbgs() << "setRange(): " << R << ", " << Idx << "\n");
   setRange(R);
   return R;
 }
 
+// transfer
+Range SigmaJunction::transfer() {
+  return Intersect(getPredicate(), getIncoming()->getRange(),
+                   getBound()->getRange());
+}
+
 /***************
  * PhiJunction *
  ***************/
@@ -397,7 +503,7 @@ void PhiJunction::pushIncoming(/* BasicBlock *IncomingBlock, */ Junction *Incomi
 }
 
 // clone
-Junction *PhiJunction::clone(Value *V, DenseMap<Junction*, Junction*> Subs) {
+Junction *PhiJunction::clone(Value *V, const SubsMapTy& Subs) {
   PhiJunction *J = new PhiJunction(V);
   for (unsigned Idx = 0; Idx < getNumArgs(); ++Idx)
     J->pushIncoming(/* IncomingBlocks_[Idx], */ getArg(Idx));
@@ -449,6 +555,19 @@ Range PhiJunction::eval() {
   return R;
 }
 
+// transfer
+// The meet of the incoming values that have a range already.
+Range PhiJunction::transfer() {
+  Range R = Range::GetBottomRange();
+  for (auto& J : *this) {
+    Range Incoming = J->getRange();
+    if (IsBottom(Incoming))
+      continue;
+    R = IsBottom(R) ? Incoming : R.meet(Incoming);
+  }
+  return R;
+}
+
 /******************
  * BinaryJunction *
  ******************/
@@ -467,7 +586,7 @@ AddJunction::AddJunction(Value *V, Junction *Left, Junction *Right)
 }
 
 // clone
-Junction *AddJunction::clone(Value *V, DenseMap<Junction*, Junction*> Subs) {
+Junction *AddJunction::clone(Value *V, const SubsMapTy& Subs) {
   AddJunction *J = new AddJunction(V, getLeft(), getRight());
   J->subs(Subs);
   return J;
@@ -491,6 +610,11 @@ Range AddJunction::eval() {
   return R;
 }
 
+// transfer
+Range AddJunction::transfer() {
+  return getLeft()->getRange() + getRight()->getRange();
+}
+
 /***************
  * SubJunction *
  ***************/
@@ -499,7 +623,7 @@ SubJunction::SubJunction(Value *V, Junction *Left, Junction *Right)
 }
 
 // clone
-Junction *SubJunction::clone(Value *V, DenseMap<Junction*, Junction*> Subs) {
+Junction *SubJunction::clone(Value *V, const SubsMapTy& Subs) {
   SubJunction *J = new SubJunction(V, getLeft(), getRight());
   J->subs(Subs);
   return J;
@@ -523,6 +647,11 @@ Range SubJunction::eval() {
   return R;
 }
 
+// transfer
+Range SubJunction::transfer() {
+  return getLeft()->getRange() - getRight()->getRange();
+}
+
 /***************
  * MulJunction *
  ***************/
@@ -531,7 +660,7 @@ MulJunction::MulJunction(Value *V, Junction *Left, Junction *Right)
 }
 
 // clone
-Junction *MulJunction::clone(Value *V, DenseMap<Junction*, Junction*> Subs) {
+Junction *MulJunction::clone(Value *V, const SubsMapTy& Subs) {
   MulJunction *J = new MulJunction(V, getLeft(), getRight());
   J->subs(Subs);
   return J;
@@ -555,6 +684,11 @@ Range MulJunction::eval() {
   return R;
 }
 
+// transfer
+Range MulJunction::transfer() {
+  return getLeft()->getRange() * getRight()->getRange();
+}
+
 /***************
  * DivJunction *
  ***************/
@@ -563,7 +697,7 @@ DivJunction::DivJunction(Value *V, Junction *Left, Junction *Right)
 }
 
 // clone
-Junction *DivJunction::clone(Value *V, DenseMap<Junction*, Junction*> Subs) {
+Junction *DivJunction::clone(Value *V, const SubsMapTy& Subs) {
   DivJunction *J = new DivJunction(V, getLeft(), getRight());
   J->subs(Subs);
   return J;
@@ -587,6 +721,11 @@ Range DivJunction::eval() {
   return R;
 }
 
+// transfer
+Range DivJunction::transfer() {
+  return getLeft()->getRange()/getRight()->getRange();
+}
+
 /*************************
  * SymbolicRangeAnalysis *
  *************************/
@@ -598,9 +737,29 @@ void SymbolicRangeAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
 }
 
 // runOnModule
+// The functions are processed one at a time: the junctions of a function
+// take the calls to it as incoming values of its arguments, and GiNaC
+// expressions, shared by every junction, are not thread safe.
 bool SymbolicRangeAnalysis::runOnModule(Module& M) {
+  PassProfileScope Scope("SymbolicRangeAnalysis", "range analysis");
   auto Start = std::chrono::high_resolution_clock::now();
 
+  // The values of a module run before may have been freed
+  Expr::ClearValueSymbols();
+
+  if (!ClRangesIn.empty() && readRanges(M, ClRangesIn))
+    return false;
+
+  // A huge module would spend hours in its largest functions; it rather
+  // gets [-inf, +inf] for them
+  ModuleMetrics Metrics = ModuleMetrics::compute(M);
+  MaxJunctions_ = ClMaxJunctions;
+  if (ClMaxJunctions.getNumOccurrences() == 0 && Metrics.isHuge())
+    MaxJunctions_ = HugeModuleMaxJunctions;
+  TimeBudget_ = ClTimeBudget;
+  if (ClTimeBudget.getNumOccurrences() == 0 && Metrics.isHuge())
+    TimeBudget_ = HugeModuleTimeBudget;
+
   bool OrClDebug = ClDebug;
   bool OrClDebugEval = ClDebugEval;
   bool OrClDebugConst = ClDebugConst;
@@ -645,6 +804,12 @@ bool SymbolicRangeAnalysis::runOnModule(Module& M) {
     createConstraintsForFunction(&F);
   }
 
+  if (ClWorklist)
+    solve();
+
+  if (!ClRangesOut.empty())
+    writeRanges(M, ClRangesOut);
+
   ClDebug = OrClDebug;
   ClDebugEval = OrClDebugEval;
   ClDebugConst = OrClDebugConst;
@@ -656,6 +821,9 @@ bool SymbolicRangeAnalysis::runOnModule(Module& M) {
   dbgs() << "================= SRA STATS =================\n";
   dbgs() << "==== Total evaluation time:     " << Elapsed << "\t ====\n";
   dbgs() << "==== Number of junctions:       " << JunctionsMap_.size() << "\t ====\n";
+  PassProfile::get().counter("junctions", "range analysis",
+                             JunctionsMap_.size());
+  PassProfile::get().sampleRSS("range analysis");
 
   if (ClDebug) {
     dbgs() << "================= SRA DEBUG =================\n";
@@ -668,7 +836,7 @@ bool SymbolicRangeAnalysis::runOnModule(Module& M) {
            << JunctionsMap_.size() << "\t ====\n";
 
     for (auto& J : JunctionsMap_) {
-      Range R = J.second->eval();
+      Range R = evalJunction(J.second);
       ASSERT_NE(R.getLower(), Expr::GetBottomValue(),
                 "Unevaluated lower bound");
       ASSERT_NE(R.getUpper(), Expr::GetBottomValue(),
@@ -695,9 +863,16 @@ void SymbolicRangeAnalysis::print(raw_ostream& OS) const {
       }
 
     RG_DEBUG_EVAL(dbgs() << "==== eval() ==== " << *J.second << " ====\n");
-    Ranges.push_back(make_pair(J.second, J.second->eval()));
+    Ranges.push_back(make_pair(J.second, evalJunction(J.second)));
   }
 
+  // In the order the junctions were created, not the order of the map
+  std::stable_sort(Ranges.begin(), Ranges.end(),
+                   [](const pair<Junction*, Range>& L,
+                      const pair<Junction*, Range>& R) {
+                     return L.first->getIdx() < R.first->getIdx();
+                   });
+
   OS << "=================== RANGES ==================\n";
   for (auto& P : Ranges) {
     OS << *P.first<< " = " << P.second << "\n";
@@ -709,8 +884,8 @@ void SymbolicRangeAnalysis::printAsDot(raw_ostream& OS) const {
   OS << "digraph module {\n";
   OS << "  graph [rankdir = LR, margin = 0];\n";
   OS << "  node [shape = record,fontname = \"Times-Roman\", fontsize = 14];\n";
-  for (auto& J : JunctionsMap_)
-    J.second->printAsDot(OS);
+  for (auto& J : getJunctions())
+    J->printAsDot(OS);
   OS << "}\n";
 }
 
@@ -724,12 +899,446 @@ void SymbolicRangeAnalysis::printInfo(raw_ostream& OS) const {
 // getRange
 Range SymbolicRangeAnalysis::getRange(Value *V) {
   if (JunctionsMap_.count(V))
-    return JunctionsMap_[V]->eval();
+    return evalJunction(JunctionsMap_[V]);
   else if (isa<ConstantInt>(V))
     return Range(V);
   return Range::GetInfRange();
 }
 
+// forgetValue
+void SymbolicRangeAnalysis::forgetValue(Value *V) {
+  JunctionsMap_.erase(V);
+  Symbols_.erase(V);
+}
+
+// evalJunction
+Range SymbolicRangeAnalysis::evalJunction(Junction *J) const {
+  return Solved_ ? J->getRange() : J->eval();
+}
+
+// getJunctions
+// Every junction of the graph once, in the order they were created, which
+// doesn't depend on the addresses of values and junctions.
+vector<Junction*> SymbolicRangeAnalysis::getJunctions() const {
+  // Junctions are shared between values, and arguments may have none
+  SmallPtrSet<Junction*, 256> Seen;
+  vector<Junction*> Junctions;
+  for (auto& P : JunctionsMap_)
+    if (!Seen.count(P.second)) {
+      Seen.insert(P.second);
+      Junctions.push_back(P.second);
+    }
+  for (unsigned Idx = 0; Idx < Junctions.size(); ++Idx)
+    for (auto& Arg : *Junctions[Idx])
+      if (!Seen.count(Arg)) {
+        Seen.insert(Arg);
+        Junctions.push_back(Arg);
+      }
+
+  std::sort(Junctions.begin(), Junctions.end(),
+            [](Junction *L, Junction *R) {
+              return L->getIdx() < R->getIdx();
+            });
+  return Junctions;
+}
+
+// solve
+// Computes the ranges of every junction with a worklist: a junction is
+// evaluated again only when the range of one of its arguments changes.
+// A phi junction that keeps changing is widened after ClWidenAfter
+// changes, and set to [-inf, +inf] if it changes once more. The other
+// junctions wait for all their arguments to have a range.
+// Junctions over the budgets get [-inf, +inf] and are not evaluated
+// again; each of these fallbacks is reported.
+void SymbolicRangeAnalysis::solve() {
+  auto Start = std::chrono::high_resolution_clock::now();
+  vector<Junction*> Junctions = getJunctions();
+
+  SmallPtrSet<Junction*, 256> Frozen;
+  if (MaxJunctions_) {
+    DenseMap<Function*, unsigned> Counts;
+    for (auto& J : Junctions)
+      if (Function *F = GetFunction(J->getValue()))
+        ++Counts[F];
+
+    for (auto& J : Junctions) {
+      Function *F = GetFunction(J->getValue());
+      if (!F || Counts[F] <= MaxJunctions_ || isa<BaseJunction>(J))
+        continue;
+      J->setRange(Range::GetInfRange());
+      Frozen.insert(J);
+    }
+    for (auto& P : Counts)
+      if (P.second > MaxJunctions_)
+        errs() << "sra: " << P.first->getName() << " has " << P.second
+               << " junctions, over the budget; its ranges are unknown\n";
+  }
+
+  DenseMap<Junction*, vector<Junction*> > Users;
+  for (auto& J : Junctions)
+    for (auto& Arg : *J)
+      Users[Arg].push_back(J);
+
+  std::deque<Junction*> Worklist(Junctions.begin(), Junctions.end());
+  SmallPtrSet<Junction*, 256> InWorklist;
+  for (auto& J : Junctions)
+    InWorklist.insert(J);
+  DenseMap<Junction*, unsigned> Changes;
+  unsigned NumOverDegree = 0;
+  unsigned long Steps = 0;
+
+  while (!Worklist.empty()) {
+    // Stopping leaves the ranges below their fixed point, so every range
+    // computed so far is dropped.
+    if (TimeBudget_ && ++Steps % 1024 == 0 &&
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::high_resolution_clock::now() - Start).count() >
+          TimeBudget_) {
+      errs() << "sra: over the time budget after " << Steps
+             << " evaluations; the ranges are unknown\n";
+      for (auto& J : Junctions)
+        if (!isa<BaseJunction>(J))
+          J->setRange(Range::GetInfRange());
+      break;
+    }
+
+    Junction *J = Worklist.front();
+    Worklist.pop_front();
+    InWorklist.erase(J);
+
+    bool IsPhi = isa<PhiJunction>(J);
+    if (Frozen.count(J) || (IsPhi && Changes[J] > ClWidenAfter))
+      continue;
+    if (!IsPhi && !isa<BaseJunction>(J) &&
+        std::any_of(J->begin(), J->end(),
+                    [](Junction *Arg) { return IsBottom(Arg->getRange()); }))
+      continue;
+
+    Range R = J->transfer();
+    if (R == J->getRange())
+      continue;
+
+    if (IsPhi) {
+      unsigned Count = ++Changes[J];
+      if (Count > ClWidenAfter)
+        R = Range::GetInfRange();
+      else if (Count == ClWidenAfter)
+        R = R.widen(J->getRange());
+    }
+
+    if (ClMaxDegree && (R.getLower().getMaxDegree() > ClMaxDegree ||
+                        R.getUpper().getMaxDegree() > ClMaxDegree)) {
+      RG_DEBUG(dbgs() << "solve(): over the degree budget: " << *J << " = "
+                      << R << "\n");
+      R = Range::GetInfRange();
+      Frozen.insert(J);
+      ++NumOverDegree;
+    }
+
+    RG_DEBUG_EVAL(dbgs() << "solve(): " << *J << " = " << R << "\n");
+    J->setRange(R);
+    for (auto& User : Users[J])
+      if (!InWorklist.count(User)) {
+        InWorklist.insert(User);
+        Worklist.push_back(User);
+      }
+  }
+
+  if (NumOverDegree)
+    errs() << "sra: " << NumOverDegree << " ranges over the degree budget "
+           << "are unknown\n";
+
+  // Left without a range by unreachable or uncalled code
+  for (auto& J : Junctions)
+    if (IsBottom(J->getRange()))
+      J->setRange(Range::GetInfRange());
+
+  Solved_ = true;
+}
+
+/* Binary range files, written with -sra-ranges-out and read back with
+ * -sra-ranges-in instead of running the analysis again. Native byte order:
+ *
+ *      char     magic[8]                       "SRARANGE"
+ *      uint32_t version
+ *      uint32_t numFunctions
+ *               uint32_t nameSize, char name[nameSize], uint32_t numValues
+ *      uint32_t numSymbols
+ *               uint32_t value
+ *      uint32_t numRanges
+ *               uint32_t value, bound lower, bound upper
+ *
+ * Values are numbered densely over the defined functions, in module order:
+ * the arguments of each function, then its instructions. A bound is a
+ * uint8_t kind; finite bounds are affine and follow with an int64_t
+ * constant, a uint32_t number of terms and the terms, each a uint32_t
+ * symbol and an int64_t coefficient. A file is only read back into a
+ * module with the same functions and numbers of values.
+ */
+#define SRA_RANGES_MAGIC "SRARANGE"
+#define SRA_RANGES_VERSION 1
+
+enum { BOUND_FINITE, BOUND_PLUS_INF, BOUND_MINUS_INF, BOUND_UNKNOWN };
+
+// GetRangeFunctions
+static vector<Function*> GetRangeFunctions(Module& M) {
+  vector<Function*> Fns;
+  for (auto& F : M)
+    if (!F.isIntrinsic() && !F.isDeclaration())
+      Fns.push_back(&F);
+  return Fns;
+}
+
+// GetRangeValues
+// The values of the functions, in the order of their numbers.
+static vector<Value*> GetRangeValues(const vector<Function*>& Fns) {
+  vector<Value*> Values;
+  for (auto& F : Fns) {
+    for (auto AI = F->arg_begin(), E = F->arg_end(); AI != E; ++AI)
+      Values.push_back(&(*AI));
+    for (auto& BB : *F)
+      for (auto& I : BB)
+        Values.push_back(&I);
+  }
+  return Values;
+}
+
+// GetNumValues
+static uint32_t GetNumValues(Function *F) {
+  uint32_t Num = F->arg_size();
+  for (auto& BB : *F)
+    Num += BB.size();
+  return Num;
+}
+
+// Put
+template <class T>
+static void Put(raw_ostream& OS, T V) {
+  OS.write(reinterpret_cast<const char*>(&V), sizeof(V));
+}
+
+// PutBound
+// Symbols are numbered in the order they are first used.
+static void PutBound(raw_ostream& OS, const Expr& E,
+                     const DenseMap<const Value*, uint32_t>& ValueIds,
+                     DenseMap<unsigned, uint32_t>& SymbolIdxs,
+                     vector<uint32_t>& Symbols) {
+  if (E.isPlusInf()) {
+    Put<uint8_t>(OS, BOUND_PLUS_INF);
+    return;
+  }
+  if (E.isMinusInf()) {
+    Put<uint8_t>(OS, BOUND_MINUS_INF);
+    return;
+  }
+
+  // Only the affine bounds over values of the module are written
+  AffineExpr Affine;
+  bool Known = E.getAffine(Affine);
+  for (auto& T : Affine.getTerms()) {
+    const Value *V = Known ? Expr::GetSymbolValue(T.first) : NULL;
+    Known = V && ValueIds.count(V);
+  }
+  if (!Known) {
+    Put<uint8_t>(OS, BOUND_UNKNOWN);
+    return;
+  }
+
+  Put<uint8_t>(OS, BOUND_FINITE);
+  Put<int64_t>(OS, Affine.getConstant());
+  Put<uint32_t>(OS, Affine.getTerms().size());
+  for (auto& T : Affine.getTerms()) {
+    auto It = SymbolIdxs.find(T.first);
+    if (It == SymbolIdxs.end()) {
+      It = SymbolIdxs.insert(make_pair(T.first, Symbols.size())).first;
+      Symbols.push_back(ValueIds.lookup(Expr::GetSymbolValue(T.first)));
+    }
+    Put<uint32_t>(OS, It->second);
+    Put<int64_t>(OS, T.second);
+  }
+}
+
+namespace {
+
+// RangeFileReader
+// Reads a range file in memory; Ok turns false past its end.
+struct RangeFileReader {
+  RangeFileReader(const string& Data)
+    : Cur(Data.data()), End(Data.data() + Data.size()), Ok(true) { }
+
+  template <class T> T get() {
+    T V = T();
+    if ((size_t)(End - Cur) < sizeof(T)) {
+      Ok = false;
+      return V;
+    }
+    memcpy(&V, Cur, sizeof(T));
+    Cur += sizeof(T);
+    return V;
+  }
+
+  string getString(uint32_t Size) {
+    if ((size_t)(End - Cur) < Size) {
+      Ok = false;
+      return string();
+    }
+    string S(Cur, Size);
+    Cur += Size;
+    return S;
+  }
+
+  // Unknown bounds are the infinity on their side
+  Expr getBound(const vector<Expr>& Symbols, bool IsUpper) {
+    switch (get<uint8_t>()) {
+      case BOUND_FINITE: {
+        Expr E(APInt(64, get<int64_t>(), true));
+        uint32_t NumTerms = get<uint32_t>();
+        for (uint32_t Idx = 0; Ok && Idx < NumTerms; ++Idx) {
+          uint32_t Sym = get<uint32_t>();
+          int64_t Coeff = get<int64_t>();
+          if (Sym >= Symbols.size()) {
+            Ok = false;
+            break;
+          }
+          E = E + Symbols[Sym] * Expr(APInt(64, Coeff, true));
+        }
+        return E;
+      }
+      case BOUND_PLUS_INF:
+        return Expr::GetPlusInfValue();
+      case BOUND_MINUS_INF:
+        return Expr::GetMinusInfValue();
+      case BOUND_UNKNOWN:
+        return IsUpper ? Expr::GetPlusInfValue() : Expr::GetMinusInfValue();
+      default:
+        Ok = false;
+        return Expr();
+    }
+  }
+
+  const char *Cur;
+  const char *End;
+  bool Ok;
+};
+
+} // end anonymous namespace
+
+// writeRanges
+void SymbolicRangeAnalysis::writeRanges(Module& M, const string& FileName) {
+  vector<Function*> Fns = GetRangeFunctions(M);
+  vector<Value*> Values = GetRangeValues(Fns);
+  DenseMap<const Value*, uint32_t> ValueIds;
+  for (uint32_t Idx = 0; Idx < Values.size(); ++Idx)
+    ValueIds[Values[Idx]] = Idx;
+
+  // The ranges go first to a buffer, to number the symbols they use
+  string RangesData;
+  raw_string_ostream Ranges(RangesData);
+  DenseMap<unsigned, uint32_t> SymbolIdxs;
+  vector<uint32_t> Symbols;
+  uint32_t NumRanges = 0;
+  for (uint32_t Idx = 0; Idx < Values.size(); ++Idx) {
+    auto It = JunctionsMap_.find(Values[Idx]);
+    if (It == JunctionsMap_.end())
+      continue;
+    Range R = evalJunction(It->second);
+    Put<uint32_t>(Ranges, Idx);
+    PutBound(Ranges, R.getLower(), ValueIds, SymbolIdxs, Symbols);
+    PutBound(Ranges, R.getUpper(), ValueIds, SymbolIdxs, Symbols);
+    ++NumRanges;
+  }
+  Ranges.flush();
+
+  std::string ErrorInfo;
+  raw_fd_ostream File(FileName.c_str(), ErrorInfo);
+  if (!ErrorInfo.empty()) {
+    errs() << "Error opening file " << FileName
+           << " for writing! Error Info: " << ErrorInfo << " \n";
+    return;
+  }
+
+  File.write(SRA_RANGES_MAGIC, 8);
+  Put<uint32_t>(File, SRA_RANGES_VERSION);
+  Put<uint32_t>(File, Fns.size());
+  for (auto& F : Fns) {
+    Put<uint32_t>(File, F->getName().size());
+    File << F->getName();
+    Put<uint32_t>(File, GetNumValues(F));
+  }
+  Put<uint32_t>(File, Symbols.size());
+  for (auto& S : Symbols)
+    Put<uint32_t>(File, S);
+  Put<uint32_t>(File, NumRanges);
+  File << RangesData;
+}
+
+// readRanges
+// Gives the values of M the ranges of the file, as base junctions; false,
+// and nothing changed, if the file can't be read or is for another module.
+bool SymbolicRangeAnalysis::readRanges(Module& M, const string& FileName) {
+  std::ifstream File(FileName.c_str(), std::ios::in | std::ios::binary);
+  if (!File) {
+    errs() << "sra: can't read " << FileName << "\n";
+    return false;
+  }
+  string Data((std::istreambuf_iterator<char>(File)),
+              std::istreambuf_iterator<char>());
+
+  RangeFileReader Reader(Data);
+  if (Reader.getString(8) != SRA_RANGES_MAGIC ||
+      Reader.get<uint32_t>() != SRA_RANGES_VERSION) {
+    errs() << "sra: " << FileName << " is not a range file\n";
+    return false;
+  }
+
+  vector<Function*> Fns = GetRangeFunctions(M);
+  bool SameModule = Reader.get<uint32_t>() == Fns.size();
+  for (unsigned Idx = 0; SameModule && Idx < Fns.size(); ++Idx) {
+    string Name = Reader.getString(Reader.get<uint32_t>());
+    SameModule = Reader.Ok && Name == Fns[Idx]->getName() &&
+                 Reader.get<uint32_t>() == GetNumValues(Fns[Idx]);
+  }
+  if (!SameModule) {
+    errs() << "sra: " << FileName << " is for another module\n";
+    return false;
+  }
+
+  vector<Value*> Values = GetRangeValues(Fns);
+  vector<Expr> Symbols;
+  uint32_t NumSymbols = Reader.get<uint32_t>();
+  for (uint32_t Idx = 0; Reader.Ok && Idx < NumSymbols; ++Idx) {
+    uint32_t ValueIdx = Reader.get<uint32_t>();
+    if (ValueIdx >= Values.size())
+      Reader.Ok = false;
+    else
+      Symbols.push_back(Expr(Values[ValueIdx]));
+  }
+
+  vector<pair<Value*, Range> > Ranges;
+  uint32_t NumRanges = Reader.get<uint32_t>();
+  for (uint32_t Idx = 0; Reader.Ok && Idx < NumRanges; ++Idx) {
+    uint32_t ValueIdx = Reader.get<uint32_t>();
+    Expr Lower = Reader.getBound(Symbols, false);
+    Expr Upper = Reader.getBound(Symbols, true);
+    if (ValueIdx >= Values.size())
+      Reader.Ok = false;
+    else
+      Ranges.push_back(make_pair(Values[ValueIdx], Range(Lower, Upper)));
+  }
+  if (!Reader.Ok) {
+    errs() << "sra: " << FileName << " is truncated\n";
+    return false;
+  }
+
+  for (auto& P : Ranges) {
+    BaseJunction *J = new BaseJunction(P.first, Expr(P.first));
+    J->setRange(P.second);
+    setJunction(P.first, J);
+  }
+  Solved_ = true;
+  return true;
+}
+
 // setJunction
 void SymbolicRangeAnalysis::setJunction(Value *V, Junction *J) {
   JunctionsMap_[V] = J;
@@ -822,7 +1431,7 @@ void SymbolicRangeAnalysis::createConstraintsOnBranchBlock(BasicBlock *BB,
   unsigned NumFoundSigmas = 0;
   Value *FoundSigmaForIncoming = NULL;
 
-  DenseMap<Junction*, Junction*> Subs;
+  Junction::SubsMapTy Subs;
 
   unsigned Predicate = DoSwap ? ICI->getInversePredicate()
                               : ICI->getPredicate();
@@ -865,9 +1474,10 @@ void SymbolicRangeAnalysis::createConstraintsOnBranchBlock(BasicBlock *BB,
       }
       // For value that are not branch operands, clone the incoming value's
       // junction, replacing it's value with the phi node and replacing
-      // it's arguments with the redefinitions in Subs, if any.
+      // it's arguments with the redefinitions in Subs. Without any, the
+      // phi node shares the incoming value's junction.
       else
-        New = J->clone(Phi, Subs);
+        New = J->instantiate(Phi, Subs);
 
       Subs.insert(std::make_pair(J, New));
       setJunction(Phi, New);
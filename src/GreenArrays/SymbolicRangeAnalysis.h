@@ -23,6 +23,7 @@ raw_ostream& operator<<(raw_ostream& OS, const SymbolicRangeAnalysis& R);
 class Junction {
 public:
   typedef vector<Junction*> ArgsTy;
+  typedef DenseMap<Junction*, Junction*> SubsMapTy;
 
   Junction(Value *Value);
   Junction(Value *Value, Range R);
@@ -45,8 +46,17 @@ public:
   virtual void print(raw_ostream &OS)      const;
   virtual void printAsDot(raw_ostream &OS) const;
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs) = 0;
-  virtual Range eval()                                                   = 0;
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs) = 0;
+  virtual Range eval()                                   = 0;
+
+  // The range of this junction from the current ranges of its arguments,
+  // without evaluating them: the transfer function of the worklist solver.
+  virtual Range transfer() = 0;
+
+  // The junction of V, which has this junction's arguments replaced by
+  // Subs: this one if none of them is, so that the unchanged parts of the
+  // graph are shared, or a clone otherwise.
+  Junction *instantiate(Value *V, const SubsMapTy& Subs);
 
   void     incIterations()       { Iterations_++; }
   unsigned getIterations() const { return Iterations_; }
@@ -61,7 +71,8 @@ public:
   Junction *getArg(unsigned Idx) const;
   ArgsTy    getArgs()            const { return Args_; }
 
-  void subs(DenseMap<Junction*, Junction*> Subs);
+  void subs(const SubsMapTy& Subs);
+  bool hasArgIn(const SubsMapTy& Subs) const;
 
 private:
   // Juction node counts for printing to dot graphs.
@@ -98,8 +109,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "base"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*>);
+  virtual Junction *clone(Value *V, const SubsMapTy&);
   virtual Range eval();
+  virtual Range transfer();
 
 private:
   Expr Sym_;
@@ -122,8 +134,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "noop"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*>);
+  virtual Junction *clone(Value *V, const SubsMapTy&);
   virtual Range eval();
+  virtual Range transfer();
 };
 
 /*****************
@@ -134,8 +147,8 @@ public:
   SigmaJunction(Value *V, unsigned Predicate, Junction *Bound,
                 Junction *Incoming);
 
-  // RTTI for PhiJunction.
-  virtual ValueId getValueId() const { return PHI_ID; }
+  // RTTI for SigmaJunction.
+  virtual ValueId getValueId() const { return SIGMA_ID; }
   static bool classof(SigmaJunction const*) { return true; }
   static bool classof(Junction const *J)  {
     return J->getValueId() == SIGMA_ID;
@@ -144,8 +157,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "sigma"; }
   virtual void printEpilog(raw_ostream& OS) const;
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs);
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs);
   virtual Range eval();
+  virtual Range transfer();
 
   unsigned  getPredicate() const { return Predicate_; }
   Junction *getIncoming()  const { return getArg(0); }
@@ -183,8 +197,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "phi"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs);
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs);
   virtual Range eval();
+  virtual Range transfer();
 
 private:
   // void pushBlock(BasicBlock *IncomingBlock);
@@ -232,8 +247,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "add"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs);
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs);
   virtual Range eval();
+  virtual Range transfer();
 };
 
 /***************
@@ -254,8 +270,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "sub"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs);
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs);
   virtual Range eval();
+  virtual Range transfer();
 };
 
 /***************
@@ -276,8 +293,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "mul"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs);
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs);
   virtual Range eval();
+  virtual Range transfer();
 };
 
 /***************
@@ -298,8 +316,9 @@ public:
   virtual void printProlog(raw_ostream& OS) const { OS << "div"; }
   virtual void printEpilog(raw_ostream& OS) const { }
 
-  virtual Junction *clone(Value *V, DenseMap<Junction*, Junction*> Subs);
+  virtual Junction *clone(Value *V, const SubsMapTy& Subs);
   virtual Range eval();
+  virtual Range transfer();
 };
 
 /*************************
@@ -308,7 +327,8 @@ public:
 class SymbolicRangeAnalysis : public ModulePass {
 public:
   static char ID;
-  SymbolicRangeAnalysis() : ModulePass(ID) { }
+  SymbolicRangeAnalysis()
+    : ModulePass(ID), Solved_(false), MaxJunctions_(0), TimeBudget_(0) { }
 
   typedef DenseMap<Value*, Junction*> JunctionsMapTy;
 
@@ -324,12 +344,25 @@ public:
 
   Range getRange(Value *V);
 
+  // Drops the junction of V, which a transformation is about to delete and
+  // whose range is now the range of the value replacing it. The junctions
+  // computed from it keep it, and keep their ranges.
+  void forgetValue(Value *V);
+
 private:
   void setJunction(Value *V, Junction *J);
   void setSymbol(Value *V, Expr *Sym);
 
   Junction *getJunctionForValue(Value *V);
 
+  vector<Junction*> getJunctions() const;
+
+  void  solve();
+  Range evalJunction(Junction *J) const;
+
+  void writeRanges(Module& M, const string& FileName);
+  bool readRanges(Module& M, const string& FileName);
+
   void createConstraintsForFunction(Function *F);
 
   void createConstraintsForInst(Instruction *I);
@@ -360,6 +393,14 @@ private:
 
   DenseMap<Value*, Junction*> JunctionsMap_;
   DenseMap<Value*, Expr*> Symbols_;
+
+  // The ranges of the junctions were computed by solve()
+  bool Solved_;
+
+  // The budgets of solve(): -sra-max-junctions and -sra-time-budget, or
+  // those of a huge module when not given
+  unsigned MaxJunctions_;
+  unsigned TimeBudget_;
 };
 
 } // end namespace llvm
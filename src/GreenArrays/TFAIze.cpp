@@ -1,4 +1,10 @@
-//===------------------------ TFA.cpp --------------------------===//
+//===------------------------ TFAIze.cpp --------------------------===//
+//===----------------------------------------------------------------------===//
+// Tags with "untainted" metadata what the input of the program can't
+// influence: the loads, stores and memory intrinsics whose addresses and
+// lengths aren't tainted, and the integer arithmetic and truncations whose
+// results aren't. -ga-asan-taint and -overflow-sanitizer-taint leave those
+// unchecked.
 //===----------------------------------------------------------------------===//
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/SetVector.h"
@@ -6,6 +12,8 @@
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
@@ -15,7 +23,7 @@
 #include "llvm/Analysis/MemoryBuiltins.h"
 #include "llvm/Target/TargetLibraryInfo.h"
 
-#include "TFA.h"
+#include "../TFA/TFA.h"
 
 #include <chrono>
 #include <iomanip>
@@ -53,6 +61,8 @@ private:
 
   void visitStore(StoreInst *SI);
   void visitLoad(LoadInst *LI);
+  void visitMemIntrinsic(MemIntrinsic *MI);
+  void visitArithmetic(Instruction *I);
 
   LLVMContext *Context_;
   TFA *TFA_;
@@ -61,6 +71,8 @@ private:
   unsigned TotalStores_;
   unsigned SafeLoads_;
   unsigned TotalLoads_;
+  unsigned SafeArithmetic_;
+  unsigned TotalArithmetic_;
 };
 
 void AnnotateTainted::getAnalysisUsage(AnalysisUsage& AU) const {
@@ -77,6 +89,8 @@ bool AnnotateTainted::runOnModule(Module& M) {
   TotalStores_ = 0;
   SafeLoads_   = 0;
   TotalLoads_  = 0;
+  SafeArithmetic_  = 0;
+  TotalArithmetic_ = 0;
 
   for (auto& F : M)
     for (auto& BB : F)
@@ -88,6 +102,15 @@ bool AnnotateTainted::runOnModule(Module& M) {
           case Instruction::Store:
             visitStore(cast<StoreInst>(&I));
             break;
+          case Instruction::Call:
+            if (MemIntrinsic *MI = dyn_cast<MemIntrinsic>(&I))
+              visitMemIntrinsic(MI);
+            break;
+          default:
+            if ((isa<OverflowingBinaryOperator>(I) || isa<TruncInst>(I)) &&
+                I.getType()->isIntegerTy())
+              visitArithmetic(&I);
+            break;
         }
 
   float PercentageSafeLoadsNum = (float)SafeLoads_/(float)TotalLoads_;
@@ -114,18 +137,18 @@ bool AnnotateTainted::runOnModule(Module& M) {
   dbgs() << "==== Number of safe stores:    "  << SafeStores_          << "\n";
   dbgs() << "==== \% of safe stores:         " << PercentageSafeStores << "\n";
   dbgs() << "==== \% of safe accesses:       " << PercentageTotalSafe  << "\n";
+  dbgs() << "==== Number of arithmetic:     "  << TotalArithmetic_     << "\n";
+  dbgs() << "==== Number of safe arithmetic: " << SafeArithmetic_      << "\n";
 
   return false;
 }
 
 void AnnotateTainted::setMetadataOn(Instruction *I) { 
-  I->setMetadata("memsafe", MDNode::get(*Context_,  ArrayRef<Value*>()));
+  I->setMetadata("untainted", MDNode::get(*Context_,  ArrayRef<Value*>()));
 }
 
 void AnnotateTainted::visitStore(StoreInst *SI) {
   TotalStores_++;
-  if (SI->getMetadata("memsafe"))
-    return;
   Value *Ptr = SI->getPointerOperand();
   if (!TFA_->isValueTainted(Ptr)) {
     SafeStores_++;
@@ -135,15 +158,34 @@ void AnnotateTainted::visitStore(StoreInst *SI) {
 
 void AnnotateTainted::visitLoad(LoadInst *LI) {
   TotalLoads_++;
-  if (LI->getMetadata("memsafe"))
-    return;
   Value *Ptr = LI->getPointerOperand();
   if (!TFA_->isValueTainted(Ptr)) {
-    SafeStores_++;
+    SafeLoads_++;
     setMetadataOn(LI);
   }
 }
 
+// Counted with the stores, since it writes its destination
+void AnnotateTainted::visitMemIntrinsic(MemIntrinsic *MI) {
+  TotalStores_++;
+  if (TFA_->isValueTainted(MI->getRawDest()) ||
+      TFA_->isValueTainted(MI->getLength()))
+    return;
+  if (MemTransferInst *MT = dyn_cast<MemTransferInst>(MI))
+    if (TFA_->isValueTainted(MT->getRawSource()))
+      return;
+  SafeStores_++;
+  setMetadataOn(MI);
+}
+
+void AnnotateTainted::visitArithmetic(Instruction *I) {
+  TotalArithmetic_++;
+  if (!TFA_->isValueTainted(I)) {
+    SafeArithmetic_++;
+    setMetadataOn(I);
+  }
+}
+
 char AnnotateTainted::ID = 0;
 static RegisterPass<AnnotateTainted>
   R("tainted-annotate", "Annotate safe-to-dereference values",
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Histogram of the bytes of a pseudo-random buffer, and a running hash of
+// it: byte indexed accesses and integer arithmetic that wraps on purpose.
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 1 << 24;
+  unsigned char *buf = malloc(n);
+  int hist[256] = {0};
+  unsigned hash = 2166136261u;
+  unsigned seed = 1;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    buf[i] = seed >> 24;
+  }
+
+  for (i = 0; i < n; i++) {
+    hist[buf[i]]++;
+    hash = (hash ^ buf[i]) * 16777619u;
+  }
+
+  printf("%d %d %u\n", hist[0], hist[255], hash);
+
+  free(buf);
+  return 0;
+}
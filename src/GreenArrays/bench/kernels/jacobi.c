@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Five-point Jacobi stencil on an n x n grid, for a number of steps.
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 512;
+  int steps = argc > 2 ? atoi(argv[2]) : 50;
+  double *u = malloc(n * n * sizeof(double));
+  double *v = malloc(n * n * sizeof(double));
+  double sum = 0;
+  int i, j, t;
+
+  for (i = 0; i < n * n; i++)
+    u[i] = v[i] = (i % 13) / 13.0;
+
+  for (t = 0; t < steps; t++) {
+    for (i = 1; i < n - 1; i++)
+      for (j = 1; j < n - 1; j++)
+        v[i * n + j] = 0.2 * (u[i * n + j] + u[(i - 1) * n + j] +
+                              u[(i + 1) * n + j] + u[i * n + j - 1] +
+                              u[i * n + j + 1]);
+    double *w = u;
+    u = v;
+    v = w;
+  }
+
+  for (i = 0; i < n * n; i++)
+    sum += u[i];
+  printf("%f\n", sum);
+
+  free(u);
+  free(v);
+  return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Dense matrix product, c = a * b, on n x n integer matrices.
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 256;
+  int *a = malloc(n * n * sizeof(int));
+  int *b = malloc(n * n * sizeof(int));
+  int *c = malloc(n * n * sizeof(int));
+  int i, j, k;
+  long sum = 0;
+
+  for (i = 0; i < n * n; i++) {
+    a[i] = i % 7;
+    b[i] = i % 5;
+  }
+
+  for (i = 0; i < n; i++)
+    for (j = 0; j < n; j++) {
+      int s = 0;
+      for (k = 0; k < n; k++)
+        s += a[i * n + k] * b[k * n + j];
+      c[i * n + j] = s;
+    }
+
+  for (i = 0; i < n * n; i++)
+    sum += c[i];
+  printf("%ld\n", sum);
+
+  free(a);
+  free(b);
+  free(c);
+  return 0;
+}
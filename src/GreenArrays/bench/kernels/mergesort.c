@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Bottom-up merge sort of n pseudo-random integers.
+static void merge(int *src, int *dst, int lo, int mid, int hi) {
+  int i = lo, j = mid, k = lo;
+  while (i < mid && j < hi)
+    dst[k++] = src[i] <= src[j] ? src[i++] : src[j++];
+  while (i < mid)
+    dst[k++] = src[i++];
+  while (j < hi)
+    dst[k++] = src[j++];
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 1 << 20;
+  int *a = malloc(n * sizeof(int));
+  int *b = malloc(n * sizeof(int));
+  unsigned seed = 12345;
+  int width, lo, i;
+  long sum = 0;
+
+  for (i = 0; i < n; i++) {
+    seed = seed * 1103515245u + 12345u;
+    a[i] = seed >> 8;
+  }
+
+  for (width = 1; width < n; width *= 2) {
+    for (lo = 0; lo < n; lo += 2 * width) {
+      int mid = lo + width < n ? lo + width : n;
+      int hi = lo + 2 * width < n ? lo + 2 * width : n;
+      merge(a, b, lo, mid, hi);
+    }
+    int *t = a;
+    a = b;
+    b = t;
+  }
+
+  for (i = 0; i < n; i += n / 16 + 1)
+    sum += a[i];
+  printf("%ld\n", sum);
+
+  free(a);
+  free(b);
+  return 0;
+}
@@ -0,0 +1,35 @@
+#! /usr/bin/env bash
+#
+# Runs every program of build/ REPS times (5 by default) and prints, in tab
+# separated columns: the best wall time in seconds, the size of its code, the
+# number of ga-asan checks it executed (built with -ga-asan-count-checks; "-"
+# for the other variants) and the exit status of its last run. The ArAnot
+# *_incorrect and *_obo/obt tests overflow on purpose: the sanitizers make
+# them fail.
+
+REPS=${REPS:-5}
+
+cd "$(dirname "$0")"
+
+printf "program\tvariant\tseconds\ttext\tchecks\tstatus\n"
+for exe in build/*.exe; do
+  name=$(basename "$exe" .exe)
+  program=${name%.*}
+  variant=${name##*.}
+
+  best=""
+  for ((i = 0; i < REPS; i++)); do
+    start=$(date +%s.%N)
+    "$exe" 2> build/stderr > /dev/null
+    status=$?
+    end=$(date +%s.%N)
+    best=$(awk -v s="$start" -v e="$end" -v b="$best" \
+      'BEGIN { t = e - s; if (b == "" || t < b) b = t; printf "%.4f", b }')
+  done
+
+  text=$(size "$exe" | awk 'NR == 2 { print $1 }')
+  checks=$(sed -n 's/^ga-asan: \([0-9]*\) checks executed$/\1/p' build/stderr)
+
+  printf "%s\t%s\t%s\t%s\t%s\t%s\n" "$program" "$variant" "$best" "$text" \
+    "${checks:--}" "$status"
+done
@@ -0,0 +1,180 @@
+/*
+ * InputSpec.cpp
+ *
+ * Parsing of the input source specification and the built in spec.
+ */
+
+#include "InputSpec.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+
+using namespace llvm;
+
+static cl::list<std::string>
+InputSpecFiles("input-spec", cl::desc("Files with the input sources, see InputSpec.h"),
+		cl::value_desc("file"), cl::CommaSeparated);
+
+static cl::opt<bool>
+InputSpecNoDefaults("input-spec-no-defaults", cl::desc("Only use the input sources of -input-spec"),
+		cl::init(false));
+
+// The C library functions: the readers are sources, the output and
+// conversion functions are safe
+static const char *const DefaultSpec[] = {
+	//input functions (stdio.h, unistd.h, sys/socket.h)
+	"source scanf args 1",
+	"source __isoc99_scanf args 1",
+	"source fscanf args 2",
+	"source __isoc99_fscanf args 2",
+	"source gets arg 0",
+	"source fgets arg 0",
+	"source fread arg 0",
+	"source getwd arg 0",
+	"source getcwd arg 0",
+	"source fgetc ret",
+	"source getc ret",
+	"source getchar ret",
+	"source recv arg 1",
+	"source recvmsg arg 1",
+	"source read arg 1",
+	"source recvfrom arg 1 arg 4",
+
+	//output functions (stdio.h)
+	"safe putc", "safe putchar", "safe puts",
+	"safe fputc", "safe fputs",
+	"safe printf", "safe fprintf", "safe sprintf", "safe snprintf",
+	"safe vfprintf", "safe vprintf", "safe vsprintf",
+
+	//Conversion functions (stdlib.h)
+	"safe abs", "safe labs",
+	"safe atoi", "safe itoa", "safe atol", "safe atoll", "safe atof",
+	"safe div", "safe ldiv", "safe lldiv",
+	"safe strtod", "safe strtof", "safe strtol", "safe strtold",
+	"safe strtoll", "safe strtoul", "safe strtoull"
+};
+
+static bool parseIndex(StringRef Token, unsigned &Index) {
+	return !Token.getAsInteger(10, Index);
+}
+
+bool InputSpec::parse(StringRef Text, StringRef Name, std::string &Err) {
+	unsigned LineNo = 0;
+	while (!Text.empty()) {
+		std::pair<StringRef, StringRef> Split = Text.split('\n');
+		StringRef Line = Split.first.substr(0, Split.first.find('#'));
+		Text = Split.second;
+		++LineNo;
+
+		SmallVector<StringRef, 8> Tokens;
+		SplitString(Line, Tokens);
+		if (Tokens.empty())
+			continue;
+
+		std::string Where = (Name + ":" + Twine(LineNo) + ": ").str();
+		if (Tokens.size() < 2) {
+			Err = Where + "expected a name after '" + Tokens[0].str() + "'";
+			return false;
+		}
+
+		if (Tokens[0] == "global") {
+			if (Tokens.size() != 2) {
+				Err = Where + "'global' takes one name";
+				return false;
+			}
+			Globals[Tokens[1]] = 1;
+			continue;
+		}
+
+		Entry &E = Functions[Tokens[1]];
+		if (Tokens[0] == "safe") {
+			if (Tokens.size() != 2) {
+				Err = Where + "'safe' takes one name";
+				return false;
+			}
+			E.Safe = true;
+			continue;
+		}
+		if (Tokens[0] != "source") {
+			Err = Where + "unknown directive '" + Tokens[0].str() + "'";
+			return false;
+		}
+
+		E.Safe = false;
+		for (unsigned i = 2, e = Tokens.size(); i != e; ++i) {
+			unsigned Index;
+			if (Tokens[i] == "ret") {
+				E.Ret = true;
+			} else if ((Tokens[i] == "arg" || Tokens[i] == "args") && i + 1 != e
+					&& parseIndex(Tokens[i + 1], Index)) {
+				if (Tokens[i] == "arg")
+					E.Args.push_back(Index);
+				else
+					E.ArgsFrom = Index;
+				++i;
+			} else {
+				Err = Where + "expected 'ret', 'arg <index>' or 'args <index>', found '"
+						+ Tokens[i].str() + "'";
+				return false;
+			}
+		}
+		if (!E.isSource()) {
+			Err = Where + "the source '" + Tokens[1].str() + "' defines no value";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool InputSpec::parseFile(StringRef Path, std::string &Err) {
+	OwningPtr<MemoryBuffer> Buffer;
+	if (error_code EC = MemoryBuffer::getFile(Path, Buffer)) {
+		Err = "cannot read the input spec '" + Path.str() + "': " + EC.message();
+		return false;
+	}
+	return parse(Buffer->getBuffer(), Path, Err);
+}
+
+void InputSpec::getSources(CallSite CS, const Entry &E,
+		SmallVectorImpl<Value*> &Values) const {
+	if (E.Safe)
+		return;
+	if (E.Ret && !CS.getType()->isVoidTy())
+		Values.push_back(CS.getInstruction());
+
+	unsigned NumArgs = CS.arg_size();
+	for (unsigned i = 0, e = E.Args.size(); i != e; ++i)
+		if (E.Args[i] < NumArgs && CS.getArgument(E.Args[i])->getType()->isPointerTy())
+			Values.push_back(CS.getArgument(E.Args[i]));
+
+	if (E.ArgsFrom >= 0)
+		for (unsigned i = E.ArgsFrom; i < NumArgs; ++i)
+			if (CS.getArgument(i)->getType()->isPointerTy())
+				Values.push_back(CS.getArgument(i));
+}
+
+void InputSpec::getGlobals(Module &M, SmallVectorImpl<Value*> &Values) const {
+	for (StringMap<char>::const_iterator It = Globals.begin(), E = Globals.end(); It != E; ++It)
+		if (GlobalVariable *GV = M.getGlobalVariable(It->getKey(), true))
+			Values.push_back(GV);
+}
+
+const InputSpec &llvm::getInputSpec() {
+	static InputSpec *Spec = NULL;
+	if (Spec)
+		return *Spec;
+
+	Spec = new InputSpec();
+	std::string Err;
+	if (!InputSpecNoDefaults)
+		for (unsigned i = 0; i != array_lengthof(DefaultSpec); ++i)
+			Spec->parse(DefaultSpec[i], "<default>", Err);
+	for (unsigned i = 0; i != InputSpecFiles.size(); ++i)
+		if (!Spec->parseFile(InputSpecFiles[i], Err))
+			report_fatal_error(Err);
+	return *Spec;
+}
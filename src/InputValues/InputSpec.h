@@ -0,0 +1,80 @@
+/*
+ * InputSpec.h
+ *
+ * The specification of the input sources: which functions produce external
+ * data, through their return value or some of their arguments, which ones
+ * are known not to, and which globals hold external data. It is shared by
+ * InputValues, by the InputDep passes of DepGraph and GreenArrays and, through
+ * them, by TFA.
+ *
+ * A spec file has one directive per line; '#' starts a comment:
+ *
+ *   source <function> [ret] [arg <i>]... [args <i>]
+ *                           the return value, argument i, every pointer
+ *                           argument from i on (variadic readers)
+ *   safe <function>         never a source, even if only declared
+ *   global <name>           the global variable is a source
+ *
+ * Arguments are only sources when they are pointers. The built in spec,
+ * below the files, holds the C library readers and the stdio and stdlib
+ * functions that only output or convert data.
+ */
+
+#ifndef INPUTSPEC_H_
+#define INPUTSPEC_H_
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CallSite.h"
+#include <string>
+
+namespace llvm {
+
+	class InputSpec {
+	public:
+		struct Entry {
+			// Known not to produce external data
+			bool Safe;
+			bool Ret;
+			SmallVector<unsigned, 2> Args;
+			// Every pointer argument from this index on, or -1
+			int ArgsFrom;
+
+			Entry() : Safe(false), Ret(false), ArgsFrom(-1) {}
+			bool isSource() const {
+				return !Safe && (Ret || !Args.empty() || ArgsFrom >= 0);
+			}
+		};
+
+		// Parses the directives of Text, Name being the file it came from.
+		// Returns false and sets Err on a malformed line.
+		bool parse(StringRef Text, StringRef Name, std::string &Err);
+		bool parseFile(StringRef Path, std::string &Err);
+
+		// The spec of a function name, or NULL if the spec doesn't name it
+		const Entry *lookup(StringRef Name) const {
+			StringMap<Entry>::const_iterator It = Functions.find(Name);
+			return It == Functions.end() ? NULL : &It->second;
+		}
+
+		// Appends the values that a call to a source defines
+		void getSources(CallSite CS, const Entry &E,
+				SmallVectorImpl<Value*> &Values) const;
+
+		// Appends the globals of M that the spec names
+		void getGlobals(Module &M, SmallVectorImpl<Value*> &Values) const;
+
+	private:
+		StringMap<Entry> Functions;
+		StringMap<char> Globals;
+	};
+
+	// The spec given on the command line (-input-spec), on top of the built
+	// in one unless -input-spec-no-defaults; loaded on the first call
+	const InputSpec &getInputSpec();
+
+}
+
+#endif /* INPUTSPEC_H_ */
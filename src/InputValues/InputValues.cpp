@@ -22,15 +22,28 @@ void llvm::InputValues::getAnalysisUsage(AnalysisUsage& AU) const {
 	AU.setPreservesAll();
 }
 
-bool llvm::InputValues::isMarkedCallInst(CallInst* CI) {
+/*
+ * A call is marked if it may bring external data. With a spec for its
+ * callee, spec is set and only the values the spec names are inputs;
+ * otherwise everything the call returns or points to is.
+ */
+bool llvm::InputValues::isMarkedCallInst(CallInst* CI, const InputSpec::Entry*& spec) {
 
 	Function* F = CI->getCalledFunction();
+	spec = NULL;
 
 	//CallInst has a dynamic function pointer
 	if (!F) return true;
 
+	DenseMap<Function*, const InputSpec::Entry*>::iterator it = calleeSpecs.find(F);
+	if (it == calleeSpecs.end())
+		it = calleeSpecs.insert(std::make_pair(F, getInputSpec().lookup(F->getName()))).first;
+	spec = it->second;
+
+	if (spec) return !spec->Safe;
+
 	 // Empty functions include externally linked ones (i.e. abort, printf, scanf, ...)
-	if (F->begin() == F->end() && !whiteList.count(F)) return true;
+	if (F->begin() == F->end()) return true;
 
 	return false;
 
@@ -45,10 +58,13 @@ bool llvm::InputValues::runOnModule(Module& M) {
 
 	module = &M;
 
-	initializeWhiteList();
+	calleeSpecs.clear();
 
     collectMainArguments();
 
+	SmallVector<Value*, 8> sources;
+	getInputSpec().getGlobals(M, sources);
+
 	for(Module::iterator Fit = M.begin(), Fend = M.end(); Fit != Fend; Fit++){
 
 		for (Function::iterator BBit = Fit->begin(), BBend = Fit->end(); BBit != BBend; BBit++) {
@@ -57,7 +73,15 @@ bool llvm::InputValues::runOnModule(Module& M) {
 
 				if (CallInst *CI = dyn_cast<CallInst>(Iit)) {
 
-					if (isMarkedCallInst(CI)){
+					const InputSpec::Entry* spec;
+
+					if (isMarkedCallInst(CI, spec)){
+
+						if (spec) {
+							//Only the values named by the spec of the callee
+							getInputSpec().getSources(CI, *spec, sources);
+							continue;
+						}
 
 						//Values returned by marked instructions
 						insertInInputDepValues(CI);
@@ -81,62 +105,15 @@ bool llvm::InputValues::runOnModule(Module& M) {
 
 	}
 
+	for (unsigned i = 0; i < sources.size(); i++)
+		insertInInputDepValues(sources[i]);
+
 	NumInputValues = inputValues.size();
 
 	//We don't modify anything, so we must return false;
 	return false;
 }
 
-void llvm::InputValues::initializeWhiteList() {
-
-	//output functions (stdio.h)
-	insertInWhiteList(module->getFunction("putc"));
-	insertInWhiteList(module->getFunction("putchar"));
-	insertInWhiteList(module->getFunction("puts"));
-
-	insertInWhiteList(module->getFunction("fputc"));
-	insertInWhiteList(module->getFunction("fputs"));
-
-	insertInWhiteList(module->getFunction("printf"));
-	insertInWhiteList(module->getFunction("fprintf"));
-	insertInWhiteList(module->getFunction("sprintf"));
-	insertInWhiteList(module->getFunction("snprintf"));
-
-	insertInWhiteList(module->getFunction("vfprintf"));
-	insertInWhiteList(module->getFunction("vprintf"));
-	insertInWhiteList(module->getFunction("vsprintf"));
-
-
-	//Conversion functions (stdlib.h)
-	insertInWhiteList(module->getFunction("abs"));
-	insertInWhiteList(module->getFunction("labs"));
-
-	insertInWhiteList(module->getFunction("atoi"));
-	insertInWhiteList(module->getFunction("itoa"));
-	insertInWhiteList(module->getFunction("atol"));
-	insertInWhiteList(module->getFunction("atoll"));
-	insertInWhiteList(module->getFunction("atof"));
-
-	insertInWhiteList(module->getFunction("div"));
-	insertInWhiteList(module->getFunction("ldiv"));
-	insertInWhiteList(module->getFunction("lldiv"));
-
-	insertInWhiteList(module->getFunction("strtod"));
-	insertInWhiteList(module->getFunction("strtof"));
-	insertInWhiteList(module->getFunction("strtol"));
-	insertInWhiteList(module->getFunction("strtold"));
-	insertInWhiteList(module->getFunction("strtoll"));
-	insertInWhiteList(module->getFunction("strtoul"));
-	insertInWhiteList(module->getFunction("strtoull"));
-
-}
-
-void llvm::InputValues::insertInWhiteList(Function* F) {
-	if(F && whiteList.count(F) == 0){
-		whiteList.insert(F);
-	}
-}
-
 /*
  * All the arguments of the function main depend on external data.
  *
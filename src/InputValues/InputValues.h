@@ -16,6 +16,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/raw_ostream.h"
+#include "InputSpec.h"
 #include <set>
 #include <string>
 
@@ -28,14 +29,14 @@ namespace llvm {
         private:
 			llvm::Module* module;
 
-			std::set<Function*> whiteList;
 			std::set<Value*> inputValues;
 
-            void initializeWhiteList();
-            void insertInWhiteList(Function* F);
+			// The spec of each callee, looked up by name once
+			DenseMap<Function*, const InputSpec::Entry*> calleeSpecs;
+
             void insertInInputDepValues(Value* V);
 
-            bool isMarkedCallInst(CallInst* CI);
+            bool isMarkedCallInst(CallInst* CI, const InputSpec::Entry*& spec);
 
             void collectMainArguments();
         public:
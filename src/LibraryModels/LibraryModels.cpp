@@ -0,0 +1,130 @@
+#include "LibraryModels.h"
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/system_error.h"
+
+using namespace llvm;
+
+static cl::list<std::string> libModelsFiles("depgraph-lib-models",
+		cl::desc("File with the data flows of more library functions, or of "
+			"the functions of other modules (taint-summary-out)"),
+		cl::value_desc("filename"));
+
+// Same format as the spec files
+static const char* builtinModels[] = {
+	"memcpy 1>0",
+	"memmove 1>0",
+	"memset 1>0",
+	"bcopy 0>1",
+	"strcpy 1>0",
+	"strncpy 1>0",
+	"stpcpy 1>0",
+	"strcat 1>0",
+	"strncat 1>0",
+	"sprintf 2...>0",
+	"snprintf 3...>0"
+};
+
+LibraryModels::LibraryModels() {
+	for (unsigned i = 0; i < array_lengthof(builtinModels); ++i)
+		parseLine(builtinModels[i]);
+}
+
+static bool parseIndex(StringRef s, int& index) {
+	if (s == "ret") {
+		index = LibraryModels::Ret;
+		return true;
+	}
+	unsigned n;
+	if (s.getAsInteger(10, n))
+		return false;
+	index = n;
+	return true;
+}
+
+bool LibraryModels::parseLine(StringRef line) {
+	line = line.split('#').first.trim();
+	if (line.empty())
+		return true;
+
+	SmallVector<StringRef, 8> fields;
+	SplitString(line, fields);
+
+	std::vector<Flow> flows;
+	for (unsigned i = 1; i < fields.size(); ++i) {
+		std::pair<StringRef, StringRef> ends = fields[i].split('>');
+		Flow flow;
+		flow.srcVariadic = ends.first.endswith("...");
+		if (flow.srcVariadic)
+			ends.first = ends.first.drop_back(3);
+		if (!parseIndex(ends.first, flow.src) || flow.src == Ret
+				|| !parseIndex(ends.second, flow.dst))
+			return false;
+		flows.push_back(flow);
+	}
+
+	models[fields[0]] = flows;
+	return true;
+}
+
+bool LibraryModels::loadFile(StringRef path, std::string& error) {
+	OwningPtr<MemoryBuffer> file;
+	if (error_code ec = MemoryBuffer::getFile(path, file)) {
+		error = ec.message();
+		return false;
+	}
+
+	SmallVector<StringRef, 64> lines;
+	file->getBuffer().split(lines, "\n");
+	for (unsigned i = 0; i < lines.size(); ++i)
+		if (!parseLine(lines[i]))
+			errs() << path << ":" << i + 1 << ": malformed library model: "
+					<< lines[i] << "\n";
+	return true;
+}
+
+const std::vector<LibraryModels::Flow>* LibraryModels::lookup(
+		const Function* F) const {
+
+	// The module's own definition is analyzed instead
+	if (!F->isDeclaration())
+		return NULL;
+
+	StringRef name = F->getName();
+	switch (F->getIntrinsicID()) {
+	case Intrinsic::memcpy:
+		name = "memcpy";
+		break;
+	case Intrinsic::memmove:
+		name = "memmove";
+		break;
+	case Intrinsic::memset:
+		name = "memset";
+		break;
+	default:
+		break;
+	}
+
+	StringMap<std::vector<Flow> >::const_iterator it = models.find(name);
+	return it == models.end() ? NULL : &it->second;
+}
+
+const LibraryModels& LibraryModels::get() {
+	static OwningPtr<LibraryModels> instance;
+	if (!instance) {
+		instance.reset(new LibraryModels());
+		for (unsigned i = 0; i < libModelsFiles.size(); ++i) {
+			std::string error;
+			if (!instance->loadFile(libModelsFiles[i], error))
+				errs() << "Error opening file " << libModelsFiles[i] << ": "
+						<< error << "\n";
+		}
+	}
+	return *instance;
+}
@@ -0,0 +1,77 @@
+#ifndef LIBRARYMODELS_H_
+#define LIBRARYMODELS_H_
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+/*
+ * Class LibraryModels
+ *
+ * The data flows of the library functions that the dependence graph can't
+ * see the body of, by name: which argument flows into the memory that
+ * another argument points to, or into the return value. A pointer argument
+ * stands for its memory node, as everywhere in the graph, so "memcpy 1>0"
+ * is the copy of the source buffer into the destination one.
+ *
+ * The built-in table covers the string and memory functions of the C
+ * library; a spec file, one function per line, adds to it or replaces its
+ * entries:
+ *
+ *     # name flow...    with flow = SRC>DST
+ *     memcpy 1>0
+ *     sprintf 2...>0    (the arguments from 2 on)
+ *     strdup 0>ret
+ *
+ * The memory intrinsics take the model of their library function. The
+ * models are shared, in their own library, by the dependence graphs of
+ * DepGraph and GreenArrays, which both read -depgraph-lib-models.
+ *
+ * The summaries that taint-summary-out writes for the functions of a
+ * module are spec files too, so that the modules of a program can be
+ * analyzed apart: each one with the summaries of the others.
+ */
+class LibraryModels {
+public:
+	// An argument index, or the return value of the call
+	static const int Ret = -1;
+
+	struct Flow {
+		int src;
+		// The arguments from src on, for the variadic functions
+		bool srcVariadic;
+		int dst;
+	};
+
+	LibraryModels();
+
+	/*
+	 * Adds the models of the spec file at path. Returns false, with the
+	 * reason in error, if the file can't be read; malformed lines are
+	 * reported and skipped.
+	 */
+	bool loadFile(StringRef path, std::string& error);
+
+	// The flows of calls to F, or NULL if F has no model
+	const std::vector<Flow>* lookup(const Function* F) const;
+
+	/*
+	 * The model of the library functions, with the built-in entries and
+	 * those of the -depgraph-lib-models files, loaded in order on the
+	 * first call.
+	 */
+	static const LibraryModels& get();
+
+private:
+	StringMap<std::vector<Flow> > models;
+
+	bool parseLine(StringRef line);
+};
+
+}
+
+#endif /* LIBRARYMODELS_H_ */
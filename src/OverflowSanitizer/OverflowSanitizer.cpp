@@ -792,6 +792,10 @@ Constant* OverflowSanitizer::getLineNumber(Instruction* I) {
 
 void OverflowSanitizer::getAnalysisUsage(AnalysisUsage &AU) const {
 	AU.addRequired<moduleDepGraph> ();
+	//The instrumentation only touches the functions it checks: the tainted
+	//flow summaries are brought up to date by TaintSummaries::update
+	AU.addPreserved<TaintSummaries> ();
+	AU.addPreserved<AliasSets> ();
 }
 
 char OverflowSanitizer::ID = 0;
@@ -36,8 +36,9 @@
 #include <list>
 #include <stdio.h>
 
-#include "../../Analysis/DepGraph/InputValues.h"
+#include "../../Analysis/InputValues/InputValues.h"
 #include "../../Analysis/DepGraph/DepGraph.h"
+#include "../../Analysis/DepGraph/TaintSummaries.h"
 #include "../uSSA/uSSA.h"
 
 using namespace llvm;
@@ -0,0 +1,174 @@
+#define DEBUG_TYPE "pa-icp"
+
+#include "PADriver.h"
+
+#include "llvm/Support/CommandLine.h"
+
+static cl::opt<unsigned>
+PAICPMaxTargets("pa-icp-max-targets",
+                cl::desc("Most targets of an indirect call that pa-icp compares with (4)"),
+                cl::init(4));
+
+STATISTIC(PAICPCalls, "Number of indirect calls promoted");
+STATISTIC(PAICPTargets, "Number of direct calls added by the promotions");
+STATISTIC(PAICPSingle, "Number of promoted calls with a single target");
+
+/*
+ * Promotes the indirect calls whose called pointer PADriver resolves to a
+ * few functions: each target is compared with the pointer and called
+ * directly, so that it can be inlined, and the original indirect call stays
+ * as the last resort, for the targets the analysis may not see (pointers
+ * from other modules, from integers...). A call
+ *
+ *     r = fp(a)
+ *
+ * with targets f and g becomes
+ *
+ *     if (fp == f) r1 = f(a)
+ *     else if (fp == g) r2 = g(a)
+ *     else r3 = fp(a)
+ *     r = phi(r1, r2, r3)
+ *
+ * Only calls are promoted; invokes are left as they are.
+ */
+class IndirectCallPromotion : public ModulePass {
+        public:
+        static char ID;
+
+        IndirectCallPromotion() : ModulePass(ID) {}
+
+        virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+        virtual bool runOnModule(Module &M);
+
+        private:
+        // The function that each memory block is the body of
+        DenseMap<int, Function*> functionOfBlock;
+
+        void getTargets(PADriver &PD, CallInst *CI, std::vector<Function*>& targets);
+        void promote(CallInst *CI, const std::vector<Function*>& targets);
+};
+
+char IndirectCallPromotion::ID = 0;
+static RegisterPass<IndirectCallPromotion> X("pa-icp",
+                "Promote the indirect calls resolved by PADriver to direct calls");
+
+// ============================= //
+
+void IndirectCallPromotion::getAnalysisUsage(AnalysisUsage &AU) const {
+        AU.addRequired<PADriver>();
+}
+
+// ============================= //
+
+// The functions that CI may call, if there are few enough of them and all
+// can be called with the arguments of CI; empty otherwise
+void IndirectCallPromotion::getTargets(PADriver &PD, CallInst *CI,
+                std::vector<Function*>& targets) {
+        targets.clear();
+
+        Value *callee = CI->getCalledValue();
+        int id = PD.value2int.lookup(callee);
+        if (!id)
+                return;
+
+        SharedPts pts = PD.pointerAnalysis->pointsTo(id);
+        if (pts.empty() || pts.size() > PAICPMaxTargets)
+                return;
+
+        FunctionType *FTy = cast<FunctionType>(callee->getType()->getPointerElementType());
+        for (SharedPts::iterator it = pts.begin(), E = pts.end(); it != E; ++it) {
+                Function *F = functionOfBlock.lookup(*it);
+                if (!F || F->getFunctionType() != FTy ||
+                                F->getCallingConv() != CI->getCallingConv()) {
+                        targets.clear();
+                        return;
+                }
+                targets.push_back(F);
+        }
+}
+
+// ============================= //
+
+void IndirectCallPromotion::promote(CallInst *CI, const std::vector<Function*>& targets) {
+        Value *callee = CI->getCalledValue();
+        BasicBlock *head = CI->getParent();
+        Function *parent = head->getParent();
+
+        // head | fallback: CI | join
+        BasicBlock *fallback = head->splitBasicBlock(CI, "icp.fallback");
+        BasicBlock *join = fallback->splitBasicBlock(++BasicBlock::iterator(CI), "icp.join");
+        head->getTerminator()->eraseFromParent();
+
+        PHINode *phi = 0;
+        if (!CI->getType()->isVoidTy() && !CI->use_empty()) {
+                phi = PHINode::Create(CI->getType(), targets.size() + 1, "", join->begin());
+                CI->replaceAllUsesWith(phi);
+                phi->takeName(CI);
+        }
+
+        BasicBlock *check = head;
+        for (unsigned i = 0; i < targets.size(); i++) {
+                BasicBlock *direct = BasicBlock::Create(CI->getContext(), "icp.direct", parent, fallback);
+                CallInst *call = cast<CallInst>(CI->clone());
+                call->setCalledFunction(targets[i]);
+                direct->getInstList().push_back(call);
+                BranchInst::Create(join, direct);
+                if (phi) phi->addIncoming(call, direct);
+
+                BasicBlock *next = fallback;
+                if (i + 1 < targets.size())
+                        next = BasicBlock::Create(CI->getContext(), "icp.check", parent, fallback);
+
+                Value *isTarget = new ICmpInst(*check, ICmpInst::ICMP_EQ, callee, targets[i], "icp.cmp");
+                BranchInst::Create(direct, next, isTarget, check);
+                check = next;
+        }
+
+        if (phi) phi->addIncoming(CI, fallback);
+}
+
+// ============================= //
+
+bool IndirectCallPromotion::runOnModule(Module &M) {
+        PADriver &PD = getAnalysis<PADriver>();
+
+        // PADriver gives each function a block that only its address
+        // points to
+        functionOfBlock.clear();
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                int id = PD.value2int.lookup(F);
+                if (!id)
+                        continue;
+                SharedPts pts = PD.pointerAnalysis->pointsTo(id);
+                if (pts.size() == 1)
+                        functionOfBlock[*pts.begin()] = F;
+        }
+
+        // The calls are collected first, since promoting one splits its block
+        std::vector<CallInst*> calls;
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+                for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+                        for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I)
+                                if (CallInst *CI = dyn_cast<CallInst>(I))
+                                        if (!CI->getCalledFunction() && !CI->isInlineAsm() &&
+                                                        !isa<Function>(CI->getCalledValue()->stripPointerCasts()))
+                                                calls.push_back(CI);
+
+        bool changed = false;
+        std::vector<Function*> targets;
+        for (unsigned i = 0; i < calls.size(); i++) {
+                getTargets(PD, calls[i], targets);
+                if (targets.empty())
+                        continue;
+
+                DEBUG(dbgs() << "pa-icp: " << *calls[i] << " has " << targets.size() << " targets\n");
+                promote(calls[i], targets);
+                changed = true;
+                PAICPCalls++;
+                PAICPTargets += targets.size();
+                if (targets.size() == 1) PAICPSingle++;
+        }
+
+        functionOfBlock.clear();
+        return changed;
+}
@@ -0,0 +1,456 @@
+#define DEBUG_TYPE "pa-aa"
+
+#include "PADriver.h"
+#include "SparseBitSet.h"
+
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Support/InstIterator.h"
+#include "llvm/ADT/DenseSet.h"
+
+STATISTIC(PAANoAlias, "Number of alias queries answered NoAlias by the points-to sets");
+STATISTIC(PAAForwarded, "Number of alias queries passed to the next alias analysis");
+STATISTIC(PAAKnownPointers, "Number of pointers with a complete points-to set");
+STATISTIC(PAAIncompletePointers, "Number of pointers whose points-to set may miss targets");
+
+/*
+ * An alias analysis that answers NoAlias when the points-to sets that
+ * PADriver found for two pointers don't intersect, and chains to the next
+ * alias analysis for everything else.
+ *
+ * The sets are compared one allocation at a time: the fields of a struct,
+ * which PADriver gives memory blocks of their own, are mapped to the block
+ * of the allocation that holds them, since pointers to a struct and to its
+ * fields overlap whatever the blocks say.
+ *
+ * PADriver leaves parts of the program out - globals, calls to declarations,
+ * functions whose address is taken, selects, casts from integers - so a
+ * points-to set is only used when nothing that feeds the pointer was left
+ * out. Memory is treated as a whole: once a pointer may be stored where the
+ * analysis doesn't see it, no loaded pointer is trusted. Values created
+ * after PADriver ran have no set and are always passed on.
+ */
+class PAAliasAnalysis : public ModulePass, public AliasAnalysis {
+        public:
+        static char ID;
+
+        PAAliasAnalysis() : ModulePass(ID), PD(0), memoryIncomplete(false) {}
+
+        virtual void getAnalysisUsage(AnalysisUsage &AU) const;
+        virtual bool runOnModule(Module &M);
+        virtual void releaseMemory();
+
+        virtual AliasResult alias(const Location &LocA, const Location &LocB);
+        virtual void deleteValue(Value *V);
+
+        // Needed because the pass implements AliasAnalysis through
+        // multiple inheritance
+        virtual void *getAdjustedAnalysisPointer(AnalysisID PI) {
+                if (PI == &AliasAnalysis::ID)
+                        return (AliasAnalysis*)this;
+                return this;
+        }
+
+        private:
+        PADriver *PD;
+
+        // The allocation each memory block belongs to
+        DenseMap<int, int> allocationOf;
+
+        // The allocations each pointer may point to; only pointers whose
+        // points-to set is complete are kept after runOnModule
+        DenseMap<const Value*, SparseBitSet> targets;
+
+        DenseSet<const Value*> incomplete;
+        bool memoryIncomplete;
+
+        // Functions whose parameters PADriver matched with every argument
+        DenseSet<const Function*> matchedParams;
+
+        void mapAllocation(int block, int allocation);
+        void collectTargets(Value *V);
+        const SparseBitSet& getTargets(const Value *V) const;
+
+        bool isIncomplete(const Value *V) const;
+        bool markIncomplete(Value *V);
+        bool flowsInto(Value *Src, Value *Dst) const;
+        bool storesPointers(Value *Stored, Value *Ptr);
+        bool visitCall(CallSite CS);
+        void findIncomplete(Module &M);
+};
+
+char PAAliasAnalysis::ID = 0;
+static RegisterPass<PAAliasAnalysis> X("pa-aa",
+                "Alias analysis backed by the PADriver points-to sets", false, true);
+static RegisterAnalysisGroup<AliasAnalysis> Y(X);
+
+// ============================= //
+
+// Whether values of type Ty may hold a pointer
+static bool mayHoldPointers(Type *Ty) {
+        if (Ty->isPointerTy())
+                return true;
+        if (StructType *STy = dyn_cast<StructType>(Ty)) {
+                for (unsigned i = 0, e = STy->getNumElements(); i != e; ++i)
+                        if (mayHoldPointers(STy->getElementType(i)))
+                                return true;
+                return false;
+        }
+        if (SequentialType *SeqTy = dyn_cast<SequentialType>(Ty))
+                return mayHoldPointers(SeqTy->getElementType());
+        return false;
+}
+
+// Whether the memory that P points to may hold a pointer; untyped bytes may
+static bool pointsToPointers(Value *P) {
+        PointerType *PTy = dyn_cast<PointerType>(P->stripPointerCasts()->getType());
+        if (!PTy)
+                return true;
+        Type *Ty = PTy->getElementType();
+        return Ty->isIntegerTy(8) || mayHoldPointers(Ty);
+}
+
+// ============================= //
+
+void PAAliasAnalysis::getAnalysisUsage(AnalysisUsage &AU) const {
+        AliasAnalysis::getAnalysisUsage(AU);
+        AU.addRequired<PADriver>();
+        AU.setPreservesAll();
+}
+
+// ============================= //
+
+bool PAAliasAnalysis::runOnModule(Module &M) {
+        InitializeAliasAnalysis(this);
+        PD = &getAnalysis<PADriver>();
+
+        // Results read from the PADriver cache have no memory layout, so
+        // the fields can't be mapped to their allocation
+        if (PD->memoryBlock.empty())
+                return false;
+
+        for (DenseMap<Value*, std::vector<int> >::iterator I = PD->memoryBlock.begin(),
+                        E = PD->memoryBlock.end(); I != E; ++I)
+                for (unsigned i = 0; i < I->second.size(); i++)
+                        mapAllocation(I->second[i], I->second[0]);
+
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                if (F->isDeclaration())
+                        continue;
+
+                if (F->hasLocalLinkage()) {
+                        bool matched = true;
+                        for (Value::use_iterator UI = F->use_begin(), UE = F->use_end(); UI != UE; ++UI) {
+                                if (isa<BlockAddress>(*UI)) continue;
+                                CallSite CS(*UI);
+                                if (!CS.getInstruction() || !CS.isCallee(UI) ||
+                                                CS.arg_size() != F->arg_size()) {
+                                        matched = false;
+                                        break;
+                                }
+                        }
+                        if (matched) matchedParams.insert(F);
+                }
+
+                for (Function::arg_iterator A = F->arg_begin(), AE = F->arg_end(); A != AE; ++A)
+                        collectTargets(A);
+                for (inst_iterator I = inst_begin(F), IE = inst_end(F); I != IE; ++I)
+                        collectTargets(&*I);
+        }
+
+        findIncomplete(M);
+
+        for (DenseSet<const Value*>::iterator I = incomplete.begin(), E = incomplete.end(); I != E; ++I)
+                targets.erase(*I);
+        PAAKnownPointers = targets.size();
+        PAAIncompletePointers = incomplete.size();
+
+        // Only the final sets are needed to answer queries
+        incomplete.clear();
+        matchedParams.clear();
+        allocationOf.clear();
+
+        return false;
+}
+
+// ============================= //
+
+void PAAliasAnalysis::releaseMemory() {
+        targets.clear();
+        incomplete.clear();
+        matchedParams.clear();
+        allocationOf.clear();
+        memoryIncomplete = false;
+}
+
+// ============================= //
+
+void PAAliasAnalysis::mapAllocation(int block, int allocation) {
+        if (!allocationOf.insert(std::make_pair(block, allocation)).second)
+                return;
+
+        // The blocks of nested structs
+        DenseMap<int, std::vector<int> >::iterator It = PD->memoryBlock2.find(block);
+        if (It == PD->memoryBlock2.end())
+                return;
+        for (unsigned i = 0; i < It->second.size(); i++)
+                mapAllocation(It->second[i], allocation);
+}
+
+// ============================= //
+
+void PAAliasAnalysis::collectTargets(Value *V) {
+        if (!V->getType()->isPointerTy())
+                return;
+
+        int id = PD->value2int.lookup(V);
+        if (!id)
+                return;
+
+        const SharedPtsMap &pts = PD->pointerAnalysis->allPointsTo();
+        SharedPtsMap::const_iterator It = pts.find(id);
+        if (It == pts.end() || It->second.empty())
+                return;
+
+        SparseBitSet &set = targets[V];
+        for (SharedPts::iterator I = It->second.begin(), E = It->second.end(); I != E; ++I) {
+                DenseMap<int, int>::const_iterator A = allocationOf.find(*I);
+                set.insert(A == allocationOf.end() ? *I : A->second);
+        }
+}
+
+// ============================= //
+
+const SparseBitSet& PAAliasAnalysis::getTargets(const Value *V) const {
+        static const SparseBitSet none;
+
+        DenseMap<const Value*, SparseBitSet>::const_iterator It = targets.find(V);
+        return It == targets.end() ? none : It->second;
+}
+
+// ============================= //
+
+// Whether the points-to set of V may miss some of its targets
+bool PAAliasAnalysis::isIncomplete(const Value *V) const {
+        if (isa<ConstantPointerNull>(V) || isa<UndefValue>(V))
+                return false;
+        if (isa<Instruction>(V) || isa<Argument>(V))
+                return incomplete.count(V);
+        // Globals and constant expressions
+        return true;
+}
+
+// ============================= //
+
+bool PAAliasAnalysis::markIncomplete(Value *V) {
+        if (!V->getType()->isPointerTy())
+                return false;
+        return incomplete.insert(V).second;
+}
+
+// ============================= //
+
+// Whether everything Src points to reached the points-to set of Dst
+bool PAAliasAnalysis::flowsInto(Value *Src, Value *Dst) const {
+        return !isIncomplete(Src) && getTargets(Dst).includes(getTargets(Src));
+}
+
+// ============================= //
+
+// Stored is written through Ptr; returns true if memory just became
+// incomplete
+bool PAAliasAnalysis::storesPointers(Value *Stored, Value *Ptr) {
+        if (memoryIncomplete)
+                return false;
+
+        // PADriver only models the stores of pointers
+        if (Stored->getType()->isPointerTy()) {
+                if (!isIncomplete(Stored) && !isIncomplete(Ptr))
+                        return false;
+        } else if (!mayHoldPointers(Stored->getType())) {
+                Operator *Op = dyn_cast<Operator>(Stored);
+                if (!Op || Op->getOpcode() != Instruction::PtrToInt)
+                        return false;
+        }
+
+        memoryIncomplete = true;
+        return true;
+}
+
+// ============================= //
+
+// Returns true if the call made something incomplete
+bool PAAliasAnalysis::visitCall(CallSite CS) {
+        Instruction *I = CS.getInstruction();
+        Function *Callee = CS.getCalledFunction();
+
+        if (Callee && Callee->isIntrinsic()) {
+                if (isa<MemTransferInst>(I)) {
+                        if (!memoryIncomplete && pointsToPointers(CS.getArgument(1))) {
+                                memoryIncomplete = true;
+                                return true;
+                        }
+                } else if (isa<VAStartInst>(I) || isa<VACopyInst>(I)) {
+                        if (!memoryIncomplete) {
+                                memoryIncomplete = true;
+                                return true;
+                        }
+                }
+                return false;
+        }
+
+        // Only malloc and calloc get a memory block of their own
+        if (Callee && isa<CallInst>(I) &&
+                        (Callee->getName() == "malloc" || Callee->getName() == "calloc"))
+                return false;
+
+        // The values that a defined function returns are bound to its calls,
+        // and its body is analysed
+        if (Callee && !Callee->isDeclaration() && !Callee->mayBeOverridden()) {
+                if (!I->getType()->isPointerTy() || isIncomplete(I))
+                        return false;
+                for (Function::iterator BB = Callee->begin(), E = Callee->end(); BB != E; ++BB)
+                        if (ReturnInst *RI = dyn_cast<ReturnInst>(BB->getTerminator()))
+                                if (!flowsInto(RI->getReturnValue(), I))
+                                        return markIncomplete(I);
+                return false;
+        }
+
+        bool changed = markIncomplete(I);
+
+        // realloc moves the pointers of the old block to the new one
+        if (Callee && Callee->getName() == "realloc") {
+                if (!memoryIncomplete) {
+                        memoryIncomplete = true;
+                        changed = true;
+                }
+                return changed;
+        }
+
+        // The bodies of the other functions are analysed; declarations and
+        // indirect calls may write pointers through their arguments
+        if (Callee && !Callee->isDeclaration())
+                return changed;
+        if (Callee && Callee->getName() == "free")
+                return changed;
+        if (!memoryIncomplete)
+                for (CallSite::arg_iterator A = CS.arg_begin(), AE = CS.arg_end(); A != AE; ++A)
+                        if ((*A)->getType()->isPointerTy() && pointsToPointers(*A)) {
+                                memoryIncomplete = true;
+                                return true;
+                        }
+        return changed;
+}
+
+// ============================= //
+
+// Finds the pointers whose points-to set may be incomplete. The rules only
+// ever add pointers, so they are applied over the module until nothing
+// changes.
+void PAAliasAnalysis::findIncomplete(Module &M) {
+        bool changed = true;
+        while (changed) {
+                changed = false;
+
+                for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                        if (F->isDeclaration())
+                                continue;
+
+                        // Parameters
+                        bool matched = matchedParams.count(F);
+                        unsigned i = 0;
+                        for (Function::arg_iterator A = F->arg_begin(), AE = F->arg_end(); A != AE; ++A, ++i) {
+                                if (!A->getType()->isPointerTy() || isIncomplete(A))
+                                        continue;
+
+                                bool complete = matched;
+                                for (Value::use_iterator UI = F->use_begin(), UE = F->use_end();
+                                                complete && UI != UE; ++UI) {
+                                        CallSite CS(*UI);
+                                        if (CS.getInstruction())
+                                                complete = flowsInto(CS.getArgument(i), A);
+                                }
+                                if (!complete)
+                                        changed |= markIncomplete(A);
+                        }
+
+                        for (inst_iterator It = inst_begin(F), IE = inst_end(F); It != IE; ++It) {
+                                Instruction *I = &*It;
+
+                                switch (I->getOpcode()) {
+                                        case Instruction::Alloca:
+                                                break;
+                                        case Instruction::GetElementPtr:
+                                        case Instruction::BitCast:
+                                                if (!isIncomplete(I) && !flowsInto(I->getOperand(0), I))
+                                                        changed |= markIncomplete(I);
+                                                break;
+                                        case Instruction::PHI:
+                                                {
+                                                        PHINode *Phi = cast<PHINode>(I);
+                                                        if (isIncomplete(Phi))
+                                                                break;
+                                                        for (unsigned j = 0; j < Phi->getNumIncomingValues(); j++)
+                                                                if (!flowsInto(Phi->getIncomingValue(j), Phi)) {
+                                                                        changed |= markIncomplete(Phi);
+                                                                        break;
+                                                                }
+                                                        break;
+                                                }
+                                        case Instruction::Load:
+                                                if (memoryIncomplete || isIncomplete(cast<LoadInst>(I)->getPointerOperand()))
+                                                        changed |= markIncomplete(I);
+                                                break;
+                                        case Instruction::Store:
+                                                {
+                                                        StoreInst *SI = cast<StoreInst>(I);
+                                                        changed |= storesPointers(SI->getValueOperand(), SI->getPointerOperand());
+                                                        break;
+                                                }
+                                        case Instruction::AtomicCmpXchg:
+                                                {
+                                                        AtomicCmpXchgInst *CXI = cast<AtomicCmpXchgInst>(I);
+                                                        changed |= storesPointers(CXI->getNewValOperand(), CXI->getPointerOperand());
+                                                        if (memoryIncomplete || isIncomplete(CXI->getPointerOperand()))
+                                                                changed |= markIncomplete(I);
+                                                        break;
+                                                }
+                                        case Instruction::Call:
+                                        case Instruction::Invoke:
+                                                changed |= visitCall(CallSite(I));
+                                                break;
+                                        default:
+                                                // Selects, casts from integers, va_arg...
+                                                changed |= markIncomplete(I);
+                                                break;
+                                }
+                        }
+                }
+        }
+
+        DEBUG(dbgs() << "pa-aa: " << incomplete.size() << " incomplete pointers"
+                        << (memoryIncomplete ? ", memory incomplete\n" : "\n"));
+}
+
+// ============================= //
+
+AliasAnalysis::AliasResult PAAliasAnalysis::alias(const Location &LocA, const Location &LocB) {
+        const SparseBitSet &A = getTargets(LocA.Ptr);
+        const SparseBitSet &B = getTargets(LocB.Ptr);
+
+        if (!A.empty() && !B.empty() && !A.intersects(B)) {
+                PAANoAlias++;
+                return NoAlias;
+        }
+
+        PAAForwarded++;
+        return AliasAnalysis::alias(LocA, LocB);
+}
+
+// ============================= //
+
+void PAAliasAnalysis::deleteValue(Value *V) {
+        targets.erase(V);
+        AliasAnalysis::deleteValue(V);
+}
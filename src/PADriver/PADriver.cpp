@@ -36,18 +36,291 @@
 //#include <llvm/Support/CommandLine.h>
 
 #include "PADriver.h"
+#include "../PassProfile/ModuleMetrics.h"
+#include "../PassProfile/ModuleWalk.h"
+#include "../PassProfile/PassProfile.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/Support/InstIterator.h"
+
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 
 using namespace llvm;
 
+static cl::opt<bool> PADiffPropagation("pa-diff-propagation",
+                cl::desc("Only propagate the new part of each points-to set"),
+                cl::init(false));
+
+static cl::opt<PointerAnalysis::CycleDetection> PACycles("pa-cycles",
+                cl::desc("Cycle detection used by the points-to solver"),
+                cl::values(
+                        clEnumValN(PointerAnalysis::NoCycleDetection, "none", "No cycle detection"),
+                        clEnumValN(PointerAnalysis::LazyCycleDetection, "lazy", "Lazy cycle detection"),
+                        clEnumValN(PointerAnalysis::HybridCycleDetection, "hybrid", "Offline pass plus lazy cycle detection"),
+                        clEnumValEnd),
+                cl::init(PointerAnalysis::NoCycleDetection));
+
+static cl::opt<PointerAnalysis::WorklistOrder> PAWorklistOrder("pa-worklist",
+                cl::desc("Order in which the points-to solver visits nodes"),
+                cl::values(
+                        clEnumValN(PointerAnalysis::IdOrder, "id", "Rounds in node id order"),
+                        clEnumValN(PointerAnalysis::LRFOrder, "lrf", "Least recently processed node first"),
+                        clEnumValN(PointerAnalysis::TopologicalOrder, "topo", "Rounds in topological order"),
+                        clEnumValN(PointerAnalysis::FIFOOrder, "fifo", "Rounds in insertion order"),
+                        clEnumValEnd),
+                cl::init(PointerAnalysis::IdOrder));
+
+static cl::opt<bool> PAUnify("pa-unify",
+                cl::desc("Solve the points-to constraints by unification, which is faster but coarser"),
+                cl::init(false));
+
+static cl::opt<unsigned> PAUnifyAbove("pa-unify-above",
+                cl::desc("Constraints above which the points-to analysis unifies instead (0 for no limit)"),
+                cl::init(4000000));
+
+static cl::opt<unsigned> PAMemoryBudget("pa-memory-budget",
+                cl::desc("Peak memory, in MB, after which the points-to solver gives up and unifies instead (0 for no limit)"),
+                cl::init(0));
+
+static cl::opt<bool> PAMergeFields("pa-merge-fields",
+                cl::desc("Give the struct fields that no getelementptr addresses one memory block per object"),
+                cl::init(false));
+
+static cl::opt<unsigned> PAMaxFields("pa-max-fields",
+                cl::desc("Memory blocks per struct object with -pa-merge-fields, not counting nested structs (0 for no limit)"),
+                cl::init(0));
+
+static cl::opt<bool> PABenchmark("pa-benchmark",
+                cl::desc("Time every worklist order before running the analysis"),
+                cl::init(false));
+
+static cl::opt<bool> PASubstitution("pa-offline-substitution",
+                cl::desc("Merge pointer-equivalent variables before solving"),
+                cl::init(false));
+
+static cl::opt<std::string> PACacheDir("pa-cache-dir",
+                cl::desc("Directory where points-to results are cached between runs"),
+                cl::init(""));
+
+static cl::opt<std::string> PADumpConstraints("pa-dump-constraints",
+                cl::desc("Write the points-to constraints to the given file, for the solver benchmark"),
+                cl::value_desc("file"), cl::init(""));
+
 STATISTIC(PABaseCt,  "Counts number of base constraints");
 STATISTIC(PAAddrCt,  "Counts number of address constraints");
 STATISTIC(PALoadCt,  "Counts number of load constraints");
 STATISTIC(PAStoreCt, "Counts number of store constraints");
 STATISTIC(PANumVert, "Counts number of vertices");
 STATISTIC(PAMerges,  "Counts number of merged vertices");
+STATISTIC(PASubstituted, "Counts number of vertices merged before solving");
+STATISTIC(PAIterations, "Counts number of nodes processed by the solver");
 STATISTIC(PARemoves, "Counts number of calls to remove cycle");
 STATISTIC(PAMemUsage, "kB of memory");
+STATISTIC(PACacheHits, "Counts number of results read from the cache");
+STATISTIC(PAUnified, "Counts number of modules solved by unification");
+STATISTIC(PAMergedFields, "Counts number of struct fields sharing a memory block");
+
+
+/// Budget the solver of a large module: the options not given on the command
+/// line take hybrid cycle detection and difference propagation, which find the
+/// same points-to sets sooner.
+static void chooseSolver(const ModuleMetrics &metrics,
+                PointerAnalysis::CycleDetection &cycles, bool &diff) {
+        PassProfile::get().counter("estimated constraints", "points-to",
+                        metrics.PointsToConstraints);
+        if (!metrics.isLarge()) return;
+
+        if (PACycles.getNumOccurrences() == 0)
+                cycles = PointerAnalysis::HybridCycleDetection;
+        if (PADiffPropagation.getNumOccurrences() == 0)
+                diff = true;
+        DEBUG(dbgs() << "PADriver: " << metrics.Instructions << " instructions, "
+                        << "solving with cycle detection " << (int)cycles
+                        << " and difference propagation " << diff << "\n");
+}
+
+namespace {
+/// A stream that keeps the FNV-1a hash of what is written to it instead of
+/// the text
+class HashStream : public raw_ostream {
+        uint64_t hash;
+        uint64_t pos;
+
+        void write_impl(const char *ptr, size_t size) {
+                for (size_t i = 0; i < size; i++) {
+                        hash ^= (unsigned char)ptr[i];
+                        hash *= 1099511628211ULL;
+                }
+                pos += size;
+        }
+        uint64_t current_pos() const { return pos; }
+
+public:
+        HashStream() : hash(14695981039346656037ULL), pos(0) {}
+        ~HashStream() { flush(); }
+
+        uint64_t getHash() {
+                flush();
+                return hash;
+        }
+};
+}
+
+/// Hash the module text and the options that affect the analysis, as the
+/// text is printed
+static uint64_t moduleKey(Module &M) {
+        HashStream os;
+        M.print(os, 0);
+        os << (int)PACycles << " " << (int)PADiffPropagation << " " << (int)PASubstitution
+                << " " << (int)PAMergeFields << " " << PAMaxFields;
+        return os.getHash();
+}
+
+/// List every Value constraint generation can give an ID to, in an order
+/// that only depends on the module, so IDs can be matched to Values when
+/// the results are read back
+static void enumerateValues(Module &M, std::vector<Value*>& values) {
+        DenseMap<Value*, unsigned> seen;
+
+        for (Module::global_iterator G = M.global_begin(), E = M.global_end(); G != E; ++G)
+                if (seen.insert(std::make_pair(&*G, values.size())).second)
+                        values.push_back(&*G);
+
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                if (seen.insert(std::make_pair(&*F, values.size())).second)
+                        values.push_back(&*F);
+
+                for (Function::arg_iterator A = F->arg_begin(), AE = F->arg_end(); A != AE; ++A)
+                        if (seen.insert(std::make_pair(&*A, values.size())).second)
+                                values.push_back(&*A);
+
+                for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB) {
+                        for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE; ++I) {
+                                if (seen.insert(std::make_pair(&*I, values.size())).second)
+                                        values.push_back(&*I);
+
+                                for (User::op_iterator O = I->op_begin(), OE = I->op_end(); O != OE; ++O)
+                                        if (seen.insert(std::make_pair(O->get(), values.size())).second)
+                                                values.push_back(O->get());
+                        }
+                }
+        }
+}
+
+/// Layout of a cache file: this header, numValues pairs (ID, position of
+/// the Value in enumerateValues), tablesSize bytes of the memory block
+/// tables of PADriver (see writeTables), then the PointerAnalysis solution
+struct PACacheHeader {
+        char magic[4];
+        uint32_t nextMemoryBlock;
+        uint64_t key;
+        uint32_t numValues;
+        uint32_t currInd;
+        uint32_t tablesSize;
+        uint32_t padding;
+};
+
+static const char PACacheMagic[4] = { 'P', 'A', 'C', '3' };
+
+/// The words of the tables of a cache file
+static void appendWord(std::string &out, uint32_t word) {
+        out.append((const char*)&word, sizeof(word));
+}
+
+static void appendInts(std::string &out, const std::vector<int> &ints) {
+        appendWord(out, ints.size());
+        for (unsigned i = 0; i < ints.size(); i++)
+                appendWord(out, ints[i]);
+}
+
+namespace {
+/// Reads back the words of appendWord; once past the end, every read
+/// fails and gives 0
+class PACacheReader {
+        const char *data;
+        const char *end;
+        bool valid;
+
+public:
+        PACacheReader(const char *data, size_t size) : data(data), end(data + size), valid(true) {}
+
+        bool ok() const { return valid; }
+        bool done() const { return valid && data == end; }
+
+        uint32_t word() {
+                uint32_t word = 0;
+                if (end - data < (ptrdiff_t)sizeof(word)) {
+                        valid = false;
+                        return 0;
+                }
+                memcpy(&word, data, sizeof(word));
+                data += sizeof(word);
+                return word;
+        }
 
+        std::string bytes(uint32_t size) {
+                if ((size_t)(end - data) < size) {
+                        valid = false;
+                        return std::string();
+                }
+                std::string str(data, size);
+                data += size;
+                return str;
+        }
+
+        void ints(std::vector<int> &ints) {
+                uint32_t size = word();
+                if ((size_t)(end - data) / sizeof(uint32_t) < size) {
+                        valid = false;
+                        return;
+                }
+                ints.resize(size);
+                for (uint32_t i = 0; i < size; i++)
+                        ints[i] = word();
+        }
+};
+}
+
+namespace {
+/// What PADriver needs of the instructions before their constraints
+class PADriverCollector : public ModuleWalk::Client {
+        PADriver &driver;
+public:
+        explicit PADriverCollector(PADriver &driver) : driver(driver) {}
+
+        void visit(Instruction &I) {
+                if (PHINode *Phi = dyn_cast<PHINode>(&I))
+                        driver.addPhiValues(Phi);
+                else if (GetElementPtrInst *GEPI = dyn_cast<GetElementPtrInst>(&I))
+                        driver.addAccessedFields(GEPI);
+        }
+};
+}
+
+/// Solve a copy of the constraints with each worklist order and report
+/// the time and the number of processed nodes of each one
+static void benchmarkSolver(const PointerAnalysis& PA) {
+        const char* names[] = { "id", "lrf", "topo", "fifo" };
+        PointerAnalysis::WorklistOrder orders[] = {
+                PointerAnalysis::IdOrder, PointerAnalysis::LRFOrder,
+                PointerAnalysis::TopologicalOrder, PointerAnalysis::FIFOOrder };
+
+        for (unsigned i = 0; i < 4; ++i) {
+                PointerAnalysis copy(PA);
+                clock_t start = clock();
+                copy.solve(PACycles, PADiffPropagation, orders[i]);
+                double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+                errs() << "PA benchmark: " << names[i] << " " << copy.getNumIterations()
+                       << " iterations, " << secs << "s\n";
+        }
+
+}
 
 PADriver::PADriver() : ModulePass(ID) {
                 pointerAnalysis = new PointerAnalysis();
@@ -64,18 +337,84 @@ bool PADriver::runOnModule(Module &M) {
         //getrusage(RUSAGE_SELF, &ru);
         //startTime = ru.ru_utime;
         if (pointerAnalysis == 0) pointerAnalysis = new PointerAnalysis();
+        PassProfileScope scope("PADriver", "points-to");
+
+        // Reuse the results of an earlier run on the same module
+        std::string cacheFile;
+        uint64_t key = 0;
+        if (!PACacheDir.empty()) {
+                key = moduleKey(M);
+                char name[32];
+                snprintf(name, sizeof(name), "/%016llx.pa", (unsigned long long)key);
+                cacheFile = PACacheDir + name;
+                if (readCache(M, cacheFile, key)) {
+                        PACacheHits++;
+                        PANumVert = pointerAnalysis->getNumVertices();
+                        return false;
+                }
+        }
 
-        // Collect information
-        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
-                if (!F->isDeclaration()) {
-                        addConstraints(*F);
-                        matchFormalWithActualParameters(*F);
-                        matchReturnValueWithReturnVariable(*F);
+        // Collect information: the phis that the constraints of the
+        // getelementptrs look through, the fields they address and the
+        // metrics the solver is chosen by, in one walk over the module
+        fieldLayouts.clear();
+        accessedFields.clear();
+        ModuleMetrics metrics;
+        {
+                PassProfileScope scope("collect", "points-to");
+                PADriverCollector collector(*this);
+                ModuleMetrics::Counter counter(metrics);
+                ModuleWalk walk;
+                walk.add(&collector, Instruction::PHI);
+                if (PAMergeFields) walk.add(&collector, Instruction::GetElementPtr);
+                walk.add(&counter);
+                walk.run(M);
+                counter.finish(M);
+        }
+        std::ofstream constraintLog;
+        if (!PADumpConstraints.empty()) {
+                constraintLog.open(PADumpConstraints.c_str());
+                constraintLog << "# " << M.getModuleIdentifier() << "\n";
+                pointerAnalysis->setConstraintLog(&constraintLog);
+        }
+        {
+                PassProfileScope scope("constraints", "points-to");
+                addGlobalConstraints(M);
+                for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                        if (!F->isDeclaration()) {
+                                addConstraints(*F);
+                                matchFormalWithActualParameters(*F);
+                                matchReturnValueWithReturnVariable(*F);
+                        }
                 }
         }
+        pointerAnalysis->setConstraintLog(0);
 
         // Run the analysis
-        pointerAnalysis->solve(false);
+        if (PASubstitution) PASubstituted = pointerAnalysis->substituteVariables();
+        if (PABenchmark) benchmarkSolver(*pointerAnalysis);
+        PointerAnalysis::CycleDetection cycles = PACycles;
+        bool diff = PADiffPropagation;
+        chooseSolver(metrics, cycles, diff);
+        int numConstraints = pointerAnalysis->getNumConstraints();
+        bool unify = PAUnify || (PAUnifyAbove && (unsigned)numConstraints > PAUnifyAbove);
+        if (!unify) {
+                PassProfileScope scope("solve", "points-to");
+                pointerAnalysis->setMemoryBudget((long)PAMemoryBudget * 1024);
+                pointerAnalysis->solve(cycles, diff, PAWorklistOrder);
+                if (pointerAnalysis->isOverMemoryBudget()) {
+                        errs() << "PADriver: over -pa-memory-budget after "
+                                << pointerAnalysis->getNumIterations() << " iterations; unifying instead\n";
+                        unify = true;
+                }
+        } else if (!PAUnify) {
+                errs() << "PADriver: " << numConstraints << " constraints, over -pa-unify-above; unifying instead\n";
+        }
+        if (unify) {
+                PassProfileScope scope("unify", "points-to");
+                pointerAnalysis->solveUnification();
+                PAUnified++;
+        }
         double vmUsage, residentSet;
         process_mem_usage(vmUsage, residentSet);
         PAMemUsage = vmUsage;
@@ -84,6 +423,16 @@ bool PADriver::runOnModule(Module &M) {
         PAMerges = pointerAnalysis->getNumOfMertgedVertices();
         PARemoves = pointerAnalysis->getNumCallsRemove();
         PANumVert = pointerAnalysis->getNumVertices();
+        PAIterations = pointerAnalysis->getNumIterations();
+        PassProfile &profile = PassProfile::get();
+        profile.counter("vertices", "points-to", PANumVert);
+        profile.counter("merged vertices", "points-to", PAMerges);
+        profile.counter("iterations", "points-to", PAIterations);
+        profile.counter("unified", "points-to", isUnified());
+        profile.sampleRSS("points-to");
+
+        // The cache only keeps the precise solutions
+        if (!cacheFile.empty() && !isUnified()) writeCache(M, cacheFile, key);
 
         // Get Time after analysis
         //getrusage(RUSAGE_SELF, &ru);
@@ -120,10 +469,234 @@ int PADriver::getNewMem(std::string name) {
 
 // ============================= //
 
+// Write the names of the memory IDs and the memory blocks of the Values,
+// each Value by its position in enumerateValues, for readTables. False if
+// a Value isn't in the enumeration.
+bool PADriver::writeTables(const DenseMap<Value*, unsigned> &position, std::string &out) const {
+        appendWord(out, nameMap.size());
+        for (std::map<int, std::string>::const_iterator it = nameMap.begin(); it != nameMap.end(); ++it) {
+                appendWord(out, it->first);
+                appendWord(out, it->second.size());
+                out.append(it->second);
+        }
+
+        appendWord(out, memoryBlock.size());
+        for (DenseMap<Value*, std::vector<int> >::const_iterator it = memoryBlock.begin(),
+                        E = memoryBlock.end(); it != E; ++it) {
+                DenseMap<Value*, unsigned>::const_iterator pos = position.find(it->first);
+                if (pos == position.end())
+                        return false;
+                appendWord(out, pos->second);
+                appendInts(out, it->second);
+        }
+
+        appendWord(out, memoryBlock2.size());
+        for (DenseMap<int, std::vector<int> >::const_iterator it = memoryBlock2.begin(),
+                        E = memoryBlock2.end(); it != E; ++it) {
+                appendWord(out, it->first);
+                appendInts(out, it->second);
+        }
+
+        appendWord(out, memoryBlocks.size());
+        for (DenseMap<Value*, std::vector<std::vector<int> > >::const_iterator it = memoryBlocks.begin(),
+                        E = memoryBlocks.end(); it != E; ++it) {
+                DenseMap<Value*, unsigned>::const_iterator pos = position.find(it->first);
+                if (pos == position.end())
+                        return false;
+                appendWord(out, pos->second);
+                appendWord(out, it->second.size());
+                for (unsigned i = 0; i < it->second.size(); i++)
+                        appendInts(out, it->second[i]);
+        }
+        return true;
+}
+
+// ============================= //
+
+// Read the tables of writeTables into the fields, which are left as they
+// were if the tables are malformed
+bool PADriver::readTables(const std::vector<Value*> &values, const char *data, size_t size) {
+        PACacheReader in(data, size);
+        std::map<int, std::string> names;
+        DenseMap<Value*, std::vector<int> > blocks;
+        DenseMap<int, std::vector<int> > blocks2;
+        DenseMap<Value*, std::vector<std::vector<int> > > blockLists;
+
+        for (uint32_t i = 0, n = in.word(); in.ok() && i < n; i++) {
+                int id = in.word();
+                names[id] = in.bytes(in.word());
+        }
+
+        for (uint32_t i = 0, n = in.word(); in.ok() && i < n; i++) {
+                uint32_t pos = in.word();
+                if (pos >= values.size())
+                        return false;
+                in.ints(blocks[values[pos]]);
+        }
+
+        for (uint32_t i = 0, n = in.word(); in.ok() && i < n; i++) {
+                int parent = in.word();
+                in.ints(blocks2[parent]);
+        }
+
+        for (uint32_t i = 0, n = in.word(); in.ok() && i < n; i++) {
+                uint32_t pos = in.word();
+                uint32_t numLists = in.word();
+                if (pos >= values.size() || numLists > size)
+                        return false;
+                std::vector<std::vector<int> > &lists = blockLists[values[pos]];
+                lists.resize(numLists);
+                for (uint32_t j = 0; in.ok() && j < numLists; j++)
+                        in.ints(lists[j]);
+        }
+
+        if (!in.done())
+                return false;
+        nameMap.swap(names);
+        memoryBlock.swap(blocks);
+        memoryBlock2.swap(blocks2);
+        memoryBlocks.swap(blockLists);
+        return true;
+}
+
+// ============================= //
+
+// Read the results of an earlier run from the given cache file: the
+// solution, the IDs of the Values, the names of the memory IDs and the
+// memory blocks, so that the clients see the same PADriver as after a run.
+// Returns false, leaving the pass untouched, if there is no valid entry
+bool PADriver::readCache(Module &M, const std::string& path, uint64_t key) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+                return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PACacheHeader)) {
+                close(fd);
+                return false;
+        }
+
+        void *map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED)
+                return false;
+
+        const char *data = (const char*)map;
+        size_t size = st.st_size;
+        bool ok = false;
+
+        PACacheHeader header;
+        memcpy(&header, data, sizeof(header));
+        size_t pairsSize = (size_t)header.numValues * 2 * sizeof(uint32_t);
+
+        if (!memcmp(header.magic, PACacheMagic, 4) && header.key == key
+                        && size - sizeof(header) >= pairsSize
+                        && size - sizeof(header) - pairsSize >= header.tablesSize) {
+                std::vector<Value*> values;
+                enumerateValues(M, values);
+
+                DenseMap<Value*, int> ids;
+                std::vector<Value*> idValues;
+                const char *pairs = data + sizeof(header);
+                ok = true;
+
+                for (uint32_t i = 0; i < header.numValues; i++) {
+                        uint32_t pair[2];
+                        memcpy(pair, pairs + i * sizeof(pair), sizeof(pair));
+                        if (pair[1] >= values.size()) {
+                                ok = false;
+                                break;
+                        }
+                        if (idValues.size() <= pair[0])
+                                idValues.resize(pair[0] + 1, 0);
+                        idValues[pair[0]] = values[pair[1]];
+                        ids[values[pair[1]]] = pair[0];
+                }
+
+                PointerAnalysis *cached = new PointerAnalysis();
+                const char *tables = pairs + pairsSize;
+                const char *solution = tables + header.tablesSize;
+                if (ok && cached->readSolution(solution, data + size - solution)
+                                && readTables(values, tables, header.tablesSize)) {
+                        delete pointerAnalysis;
+                        pointerAnalysis = cached;
+                        value2int.swap(ids);
+                        int2value.swap(idValues);
+                        nextMemoryBlock = header.nextMemoryBlock;
+                        currInd = header.currInd;
+                } else {
+                        delete cached;
+                        ok = false;
+                }
+        }
+
+        munmap(map, size);
+        return ok;
+}
+
+// ============================= //
+
+// Write the results of this run to the given cache file. The file is
+// written under a temporary name and then renamed, so concurrent runs
+// never see a partial entry
+void PADriver::writeCache(Module &M, const std::string& path, uint64_t key) {
+        std::vector<Value*> values;
+        enumerateValues(M, values);
+
+        DenseMap<Value*, unsigned> position;
+        for (unsigned i = 0; i < values.size(); i++)
+                position[values[i]] = i;
+
+        std::vector<std::pair<uint32_t, uint32_t> > pairs;
+        for (unsigned n = 0; n < int2value.size(); n++) {
+                if (!int2value[n])
+                        continue;
+                DenseMap<Value*, unsigned>::iterator it = position.find(int2value[n]);
+                // A Value the enumeration doesn't know couldn't be mapped back
+                if (it == position.end())
+                        return;
+                pairs.push_back(std::make_pair(n, it->second));
+        }
+
+        std::string tables;
+        if (!writeTables(position, tables))
+                return;
+
+        std::stringstream tmpName;
+        tmpName << path << ".tmp" << getpid();
+        std::ofstream out(tmpName.str().c_str(), std::ios::binary);
+        if (!out)
+                return;
+
+        PACacheHeader header;
+        memcpy(header.magic, PACacheMagic, 4);
+        header.nextMemoryBlock = nextMemoryBlock;
+        header.key = key;
+        header.numValues = pairs.size();
+        header.currInd = currInd;
+        header.tablesSize = tables.size();
+        header.padding = 0;
+        out.write((const char*)&header, sizeof(header));
+
+        for (unsigned i = 0; i < pairs.size(); i++) {
+                uint32_t pair[2] = { pairs[i].first, pairs[i].second };
+                out.write((const char*)pair, sizeof(pair));
+        }
+
+        out.write(tables.data(), tables.size());
+        pointerAnalysis->writeSolution(out);
+        out.close();
+
+        if (!out || rename(tmpName.str().c_str(), path.c_str()) != 0)
+                remove(tmpName.str().c_str());
+}
+
+// ============================= //
+
 void PADriver::print(raw_ostream& O, const Module* M) const {
         std::stringstream dotFileSS;
         DEBUG( pointerAnalysis->print() );
-        pointerAnalysis->printDot(dotFileSS, M->getModuleIdentifier(), nameMap);
+        pointerAnalysis->printDot(dotFileSS, M->getModuleIdentifier(), getNames());
         O << dotFileSS.str();
 }
 
@@ -175,29 +748,105 @@ void PADriver::process_mem_usage(double& vm_usage, double& resident_set) {
 
 // ============================= //
 
-void PADriver::addConstraints(Function &F) {
-        for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
-                for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
-                        if (isa<PHINode>(I)) {
-                                PHINode *Phi = dyn_cast<PHINode>(I);
-                                const Type *Ty = Phi->getType();
+// The base global of a constant pointer, through casts and GEPs, or 0
+static GlobalValue* getConstantBase(Constant *C) {
+        while (ConstantExpr *CE = dyn_cast<ConstantExpr>(C)) {
+                if (CE->getOpcode() != Instruction::GetElementPtr && !CE->isCast())
+                        return 0;
+                C = CE->getOperand(0);
+        }
+        return dyn_cast<GlobalValue>(C);
+}
 
-                                if (Ty->isPointerTy()) {
-                                        unsigned n = Phi->getNumIncomingValues();
-                                        std::vector<Value*> values;
+// ============================= //
 
-                                        for (unsigned i = 0; i < n; i++) {
-                                                Value *v = Phi->getIncomingValue(i);
+// Every global variable and function gets a memory block that its address
+// points to, and the blocks of the globals hold the addresses in their
+// initializers, so function pointers stored in tables reach their calls
+void PADriver::addGlobalConstraints(Module &M) {
+        DenseMap<GlobalValue*, int> blocks;
 
-                                                values.push_back(v);
-                                        }
+        for (Module::global_iterator G = M.global_begin(), E = M.global_end(); G != E; ++G)
+                blocks[G] = getNewMemoryBlock();
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F)
+                blocks[F] = getNewMemoryBlock();
 
-                                        phiValues[I] = values;
-                                }
-                        }
+        for (Module::global_iterator G = M.global_begin(), E = M.global_end(); G != E; ++G) {
+                pointerAnalysis->addAddr(Value2Int(G), blocks[G]);
+                PAAddrCt++;
+        }
+        for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+                pointerAnalysis->addAddr(Value2Int(F), blocks[F]);
+                PAAddrCt++;
+        }
+
+        for (Module::global_iterator G = M.global_begin(), E = M.global_end(); G != E; ++G)
+                if (G->hasInitializer())
+                        addInitializerConstraints(blocks[G], G->getInitializer(), blocks);
+}
+
+// ============================= //
+
+void PADriver::addInitializerConstraints(int block, Constant *C,
+                const DenseMap<GlobalValue*, int>& blocks) {
+        if (C->getType()->isPointerTy()) {
+                GlobalValue *GV = getConstantBase(C);
+                DenseMap<GlobalValue*, int>::const_iterator it = GV ? blocks.find(GV) : blocks.end();
+                if (it != blocks.end()) {
+                        pointerAnalysis->addAddr(block, it->second);
+                        PAAddrCt++;
                 }
+                return;
+        }
+
+        // The fields of a global are not told apart
+        if (isa<ConstantStruct>(C) || isa<ConstantArray>(C) || isa<ConstantVector>(C))
+                for (unsigned i = 0, e = C->getNumOperands(); i != e; ++i)
+                        addInitializerConstraints(block, cast<Constant>(C->getOperand(i)), blocks);
+}
+
+// ============================= //
+
+// A constant expression operand points where its base global does
+void PADriver::addConstantExprConstraints(Instruction *I) {
+        for (User::op_iterator it = I->op_begin(), e = I->op_end(); it != e; ++it) {
+                ConstantExpr *CE = dyn_cast<ConstantExpr>(*it);
+                if (!CE || !CE->getType()->isPointerTy())
+                        continue;
+                GlobalValue *GV = getConstantBase(CE);
+                if (!GV)
+                        continue;
+
+                int a = Value2Int(CE);
+                int b = Value2Int(GV);
+                pointerAnalysis->addBase(a, b);
+                PABaseCt++;
         }
+}
+
+// ============================= //
+
+// The incoming values of a pointer phi, which the constraints of a
+// getelementptr of it look through
+void PADriver::addPhiValues(PHINode *Phi) {
+        if (!Phi->getType()->isPointerTy())
+                return;
+
+        unsigned n = Phi->getNumIncomingValues();
+        std::vector<Value*> values;
+
+        for (unsigned i = 0; i < n; i++) {
+                Value *v = Phi->getIncomingValue(i);
+
+                values.push_back(v);
+        }
+
+        phiValues[Phi] = values;
+}
+
+// ============================= //
 
+void PADriver::addConstraints(Function &F) {
         for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB) {
                 for (BasicBlock::iterator I = BB->begin(), E = BB->end(); I != E; ++I) {
                         if (isa<CallInst>(I)) {
@@ -224,6 +873,8 @@ void PADriver::addConstraints(Function &F) {
                                 }
                         }
 
+                        addConstantExprConstraints(I);
+
                         // Handle special operations
                         switch (I->getOpcode()) {
                                 case Instruction::Alloca:
@@ -714,7 +1365,7 @@ void PADriver::matchReturnValueWithReturnVariable(Function &F) {
 
                 for (std::set<Value*>::iterator it = retVals.begin(), E = retVals.end(); it != E; ++it) {
 
-                        int a = Value2Int(CS.getCalledFunction());
+                        int a = Value2Int(Call);
                         int b = Value2Int(*it);
                         pointerAnalysis->addBase(a, b);
                         PABaseCt++;
@@ -729,35 +1380,23 @@ void PADriver::handleAlloca(Instruction *I) {
         const Type *Ty = AI->getAllocatedType();
 
         std::vector<int> mems;
-        unsigned numElems = 1;
-        bool isStruct = false;
-
-        if (Ty->isStructTy()) { // Handle structs
-                const StructType *StTy = dyn_cast<StructType>(Ty);
-                numElems = StTy->getNumElements();
-                isStruct = true;
-        }
 
         if (!memoryBlock.count(I)) {
-                for (unsigned i = 0; i < numElems; i++) {
+                if (const StructType *StTy = dyn_cast<StructType>(Ty)) // Handle structs
+                        newFieldBlocks(StTy, mems);
+                else
                         mems.push_back(getNewMemoryBlock());
 
-                        if (isStruct) {
-                                const StructType *StTy = dyn_cast<StructType>(Ty);
-
-                                if (StTy->getElementType(i)->isStructTy())
-                                        handleNestedStructs(StTy->getElementType(i), mems[i]);
-                        }
-                }
-
                 memoryBlock[I] = mems;
         } else {
                 mems = memoryBlock[I];
         }
 
-        for (unsigned i = 0; i < mems.size(); i++) {
-                int a = Value2Int(I);
-                pointerAnalysis->addAddr(a, mems[i]);
+        // Merged fields repeat their block
+        std::set<int> blocks(mems.begin(), mems.end());
+        int a = Value2Int(I);
+        for (std::set<int>::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+                pointerAnalysis->addAddr(a, *it);
                 PAAddrCt++;
         }
 }
@@ -766,22 +1405,81 @@ void PADriver::handleAlloca(Instruction *I) {
 
 void PADriver::handleNestedStructs(const Type *Ty, int parent) {
         const StructType *StTy = dyn_cast<StructType>(Ty);
-        unsigned numElems = StTy->getNumElements();
         std::vector<int> mems;
+        newFieldBlocks(StTy, mems);
 
-        for (unsigned i = 0; i < numElems; i++) {
-                mems.push_back(getNewMemoryBlock());
+        memoryBlock2[parent] = mems;
+
+        std::set<int> blocks(mems.begin(), mems.end());
+        for (std::set<int>::iterator it = blocks.begin(); it != blocks.end(); ++it) {
+                pointerAnalysis->addAddr(parent, *it);
+                PAAddrCt++;
+        }
+}
+
+// ============================= //
+
+/// The memory blocks of a new object of type StTy, one per field; the
+/// fields of one slot of its layout share a block. Nested structs get
+/// their own fields in memoryBlock2.
+void PADriver::newFieldBlocks(const StructType *StTy, std::vector<int>& mems) {
+        const FieldLayout& layout = getFieldLayout(StTy);
+
+        std::vector<int> slots(layout.numSlots);
+        for (unsigned s = 0; s < slots.size(); s++)
+                slots[s] = getNewMemoryBlock();
+
+        for (unsigned i = 0; i < layout.slot.size(); i++) {
+                mems.push_back(slots[layout.slot[i]]);
 
                 if (StTy->getElementType(i)->isStructTy())
                         handleNestedStructs(StTy->getElementType(i), mems[i]);
         }
+}
 
-        memoryBlock2[parent] = mems;
+// ============================= //
 
-        for (unsigned i = 0; i < mems.size(); i++) {
-                pointerAnalysis->addAddr(parent, mems[i]);
-                PAAddrCt++;
+/// Which slot each field of StTy takes, computed once per type. By
+/// default every field has its own. With -pa-merge-fields, the fields that
+/// no getelementptr of the module addresses share one, since only pointers
+/// to the whole object reach them, and these point to every field anyway;
+/// past -pa-max-fields slots, the addressed fields share it too. Slots
+/// come in the order of their first field, and nested structs always have
+/// their own, for their fields in memoryBlock2.
+const PADriver::FieldLayout& PADriver::getFieldLayout(const StructType *StTy) {
+        DenseMap<const StructType*, FieldLayout>::iterator it = fieldLayouts.find(StTy);
+        if (it != fieldLayouts.end()) return it->second;
+
+        FieldLayout& layout = fieldLayouts[StTy];
+        unsigned numElems = StTy->getNumElements();
+        layout.slot.resize(numElems);
+        layout.numSlots = 0;
+
+        const std::set<unsigned>& accessed = accessedFields[StTy];
+        int shared = -1;
+        for (unsigned i = 0; i < numElems; i++) {
+                bool own = !PAMergeFields || StTy->getElementType(i)->isStructTy()
+                        || (accessed.count(i) && (!PAMaxFields || layout.numSlots < PAMaxFields));
+                if (own) {
+                        layout.slot[i] = layout.numSlots++;
+                        continue;
+                }
+                if (shared < 0) shared = layout.numSlots++;
+                else PAMergedFields++;
+                layout.slot[i] = shared;
         }
+        return layout;
+}
+
+// ============================= //
+
+/// Record the fields of every struct type that GEPI addresses with a
+/// constant index
+void PADriver::addAccessedFields(GetElementPtrInst *GEPI) {
+        for (gep_type_iterator T = gep_type_begin(GEPI), TE = gep_type_end(GEPI); T != TE; ++T)
+                if (StructType *StTy = dyn_cast<StructType>(*T))
+                        if (ConstantInt *C = dyn_cast<ConstantInt>(T.getOperand()))
+                                accessedFields[StTy].insert(C->getZExtValue());
 }
 
 // ============================= //
@@ -800,29 +1498,50 @@ int PADriver::getNewInt() {
 
 int PADriver::Value2Int(Value *v) {
 
-        int n;
+        std::pair<DenseMap<Value*, int>::iterator, bool> entry =
+                value2int.insert(std::make_pair(v, 0));
+        if (!entry.second)
+                return entry.first->second;
 
-        if (value2int.count(v))
-                return value2int[v];
-
-        n = getNewInt();
-        value2int[v] = n;
+        int n = getNewInt();
+        entry.first->second = n;
+        if ((int)int2value.size() <= n)
+                int2value.resize(n + 1, 0);
         int2value[n] = v;
 //      errs() << "int " << n << "; value " << v << "\n";
 
-        // Also get a name for it
-        if (v->hasName()) {
-                nameMap[n] = v->getName();
-        }
-        else if (isa<Constant>(v)) {
-                nameMap[n] = "constant";
-                //nameMap[n] += intToStr(n);
-        }
-        else {
-                nameMap[n] = "unknown";
+        return n;
+}
+
+// ============================= //
+
+// Get the Value with the given ID, or 0 if it is not a Value
+Value* PADriver::getValue(int id) const {
+        if (id < 0 || id >= (int)int2value.size())
+                return 0;
+        return int2value[id];
+}
+
+// ============================= //
+
+// Build the names of every ID, for printing
+std::map<int, std::string> PADriver::getNames() const {
+        std::map<int, std::string> names(nameMap);
+
+        for (unsigned n = 0; n < int2value.size(); n++) {
+                Value *v = int2value[n];
+                if (!v)
+                        continue;
+
+                if (v->hasName())
+                        names[n] = v->getName().str();
+                else if (isa<Constant>(v))
+                        names[n] = "constant";
+                else
+                        names[n] = "unknown";
         }
 
-        return n;
+        return names;
 }
 
 // ============================= //
@@ -7,15 +7,19 @@
 #include <fstream>
 #include <string>
 #include <iostream>
+#include <set>
+#include <vector>
 
 #include "llvm/Pass.h"
-#include "llvm/Module.h"
-#include "llvm/Instructions.h"
-#include "llvm/InstrTypes.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/InstrTypes.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/CallSite.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/DenseMap.h"
 
 #include "PointerAnalysis.h"
 
@@ -24,20 +28,31 @@ using namespace llvm;
 class PADriver : public ModulePass {
         public:
         // +++++ FIELDS +++++ //
-        // Used to assign a int ID to Values and store names
+        // Used to assign a int ID to Values and store names. IDs are
+        // dense from 1; int2value[id] is 0 for memory blocks
         int currInd;
         int nextMemoryBlock;
-        std::map<Value*, int> value2int;
-        std::map<int, Value*> int2value;
+        DenseMap<Value*, int> value2int;
+        std::vector<Value*> int2value;
 
-        std::map<Value*, int> valMap;
-        std::map<Value*, std::vector<int> > valMem;
+        // Names given by getNewMem; names of Values are only built when
+        // needed (getNames)
         std::map<int, std::string> nameMap;
 
-        std::map<Value*, std::vector<int> > memoryBlock;
-        std::map<int, std::vector<int> > memoryBlock2;
-        std::map<Value*, std::vector<Value*> > phiValues;
-        std::map<Value*, std::vector<std::vector<int> > > memoryBlocks;
+        DenseMap<Value*, std::vector<int> > memoryBlock;
+        DenseMap<int, std::vector<int> > memoryBlock2;
+        DenseMap<Value*, std::vector<Value*> > phiValues;
+        DenseMap<Value*, std::vector<std::vector<int> > > memoryBlocks;
+
+        // The memory block layout of a struct type: fields with the same
+        // slot share a block in every object of the type
+        struct FieldLayout {
+                std::vector<unsigned> slot;
+                unsigned numSlots;
+        };
+        DenseMap<const StructType*, FieldLayout> fieldLayouts;
+        // The fields addressed by a getelementptr, for -pa-merge-fields
+        DenseMap<const StructType*, std::set<unsigned> > accessedFields;
 
         static char ID;
         PointerAnalysis* pointerAnalysis;
@@ -47,19 +62,36 @@ class PADriver : public ModulePass {
         // +++++ METHODS +++++ //
 
         bool runOnModule(Module &M);
+        // Whether the points-to sets come from the unification solver, for
+        // the clients that rely on their precision
+        bool isUnified() const { return pointerAnalysis && pointerAnalysis->isUnified(); }
         int Value2Int(Value* v);
+        Value* getValue(int id) const;
+        std::map<int, std::string> getNames() const;
         int getNewMem(std::string name);
         int getNewInt();
         int getNewMemoryBlock();
         void handleNestedStructs(const Type *Ty, int parent);
         void handleAlloca(Instruction *I);
+        void newFieldBlocks(const StructType *StTy, std::vector<int>& mems);
+        const FieldLayout& getFieldLayout(const StructType *StTy);
+        void addAccessedFields(GetElementPtrInst *GEPI);
+        void addPhiValues(PHINode *Phi);
         //Value* Int2Value(int);
         virtual void print(raw_ostream& O, const Module* M) const;
         std::string intToStr(int v);
         void process_mem_usage(double& vm_usage, double& resident_set);
+        void addGlobalConstraints(Module &M);
+        void addInitializerConstraints(int block, Constant *C,
+                        const DenseMap<GlobalValue*, int>& blocks);
+        void addConstantExprConstraints(Instruction *I);
         void addConstraints(Function &F);
         void matchFormalWithActualParameters(Function &F);
         void matchReturnValueWithReturnVariable(Function &F);
+        bool readCache(Module &M, const std::string& path, uint64_t key);
+        void writeCache(Module &M, const std::string& path, uint64_t key);
+        bool writeTables(const DenseMap<Value*, unsigned> &position, std::string &out) const;
+        bool readTables(const std::vector<Value*> &values, const char *data, size_t size);
 
 };
 
@@ -1,8 +1,8 @@
-#include <list>
 #include <tr1/unordered_set>
 #include <tr1/unordered_map>
-#include <queue>
-#include <stack>
+#include <sys/resource.h>
+#include <vector>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 
@@ -15,12 +15,134 @@ int teste = 1;
 
 // ============================================= //
 
+/// dst = dst U src; returns true if dst changed
+static bool unionPts(PtsSet& dst, const PtsSet& src)
+{
+#ifdef PA_USE_STD_SET
+	if (&dst == &src) return false;
+
+	bool changed = false;
+	for (PtsSet::const_iterator it = src.begin(); it != src.end(); ++it)
+		changed |= dst.insert(*it).second;
+	return changed;
+#else
+	return dst.unionWith(src);
+#endif
+}
+
+// ============================================= //
+
+/// dst = dst - src; returns true if dst changed
+static bool subtractPts(PtsSet& dst, const PtsSet& src)
+{
+#ifdef PA_USE_STD_SET
+	if (&dst == &src) {
+		bool changed = !dst.empty();
+		dst.clear();
+		return changed;
+	}
+
+	bool changed = false;
+	for (PtsSet::const_iterator it = src.begin(); it != src.end(); ++it)
+		changed |= dst.erase(*it) != 0;
+	return changed;
+#else
+	return dst.subtract(src);
+#endif
+}
+
+// ============================================= //
+
+/**
+ * The nodes the solver still has to process, visited in the given order.
+ * All orders but LRF work in rounds: nodes added while a round is being
+ * processed wait for the next one, and a node is only once in each round.
+ */
+class PAWorklist {
+
+    public:
+        PAWorklist(PointerAnalysis::WorklistOrder order) : order(order), clock(0) {}
+
+        bool empty() const { return current.empty() && next.empty(); }
+
+        // True if the current round is over and the next one starts with
+        // the following pop
+        bool roundDone() const { return current.empty(); }
+
+        // Priorities of the nodes for the topological order; lower first
+        void setPriorities(const IntMap& p) { priority = p; }
+
+        void push(int id)
+        {
+            if (order == PointerAnalysis::LRFOrder)
+            {
+                if (queued.insert(id).second)
+                    current.insert(std::make_pair(lastFired[id], id));
+                return;
+            }
+            if (inNext.insert(id).second) next.push_back(id);
+        }
+
+        int pop()
+        {
+            if (current.empty()) startRound();
+
+            int id = current.begin()->second;
+            current.erase(current.begin());
+            if (order == PointerAnalysis::LRFOrder)
+            {
+                queued.erase(id);
+                lastFired[id] = ++clock;
+            }
+            return id;
+        }
+
+    private:
+        void startRound()
+        {
+            for (unsigned i = 0; i < next.size(); ++i)
+            {
+                long long key = next[i];
+                if (order == PointerAnalysis::FIFOOrder) key = i;
+                else if (order == PointerAnalysis::TopologicalOrder) key = priority[next[i]];
+                current.insert(std::make_pair(key, next[i]));
+            }
+            next.clear();
+            inNext.clear();
+        }
+
+        PointerAnalysis::WorklistOrder order;
+
+        // Nodes of the current round, by key
+        std::set<std::pair<long long, int> > current;
+
+        // Nodes of the next round, in the order they were added
+        std::vector<int> next;
+        IntSet inNext;
+
+        IntMap priority;
+
+        // LRF only: when each node was last processed
+        std::tr1::unordered_map<int, long long> lastFired;
+        IntSet queued;
+        long long clock;
+};
+
+// ============================================= //
+
 ///  Default constructor
 PointerAnalysis::PointerAnalysis()
 {
     if (debug) std::cerr << "Initializing Pointer Analysis" << std::endl;
 	numMerged = 0;
 	numCallsRemove = 0;
+	numIterations = 0;
+	frozen = false;
+	unified = false;
+	memoryBudget = 0;
+	overBudget = false;
+	numConstraints = 0;
+	constraintLog = 0;
 }
 
 // ============================================= //
@@ -39,8 +161,11 @@ PointerAnalysis::~PointerAnalysis()
 void PointerAnalysis::addAddr(int A, int B)
 {
     if (debug) std::cerr << "Adding Addr Constraint: " <<  A << " = &" << B << std::endl;
+    if (constraintLog) *constraintLog << "addr " << A << " " << B << "\n";
+	numConstraints++;
 
 	// Ensure nodes A and B exists.
+	thaw();
 	addNode(A);
 	addNode(B);
 
@@ -56,8 +181,11 @@ void PointerAnalysis::addAddr(int A, int B)
 void PointerAnalysis::addBase(int A, int B)
 {
     if (debug) std::cerr << "Adding Base Constraint: " << A << " = " << B << std::endl;
+    if (constraintLog) *constraintLog << "base " << A << " " << B << "\n";
+	numConstraints++;
 
 	// Ensure nodes A and B exists.
+	thaw();
 	addNode(A);
 	addNode(B);
 
@@ -73,8 +201,11 @@ void PointerAnalysis::addBase(int A, int B)
 void PointerAnalysis::addStore(int A, int B)
 {
     if (debug) std::cerr << "Adding Store Constraint: *" << A << " = " << B << std::endl;
+    if (constraintLog) *constraintLog << "store " << A << " " << B << "\n";
+	numConstraints++;
 
 	// Ensure nodes A and B exists.
+	thaw();
 	addNode(A);
 	addNode(B);
 
@@ -90,8 +221,11 @@ void PointerAnalysis::addStore(int A, int B)
 void PointerAnalysis::addLoad(int A, int B)
 {
     if (debug) std::cerr << "Adding Load Constraint: " << A << " = *" << B << std::endl;
+    if (constraintLog) *constraintLog << "load " << A << " " << B << "\n";
+	numConstraints++;
 
 	// Ensure nodes A and B exists.
+	thaw();
 	addNode(A);
 	addNode(B);
 
@@ -101,16 +235,54 @@ void PointerAnalysis::addLoad(int A, int B)
 
 // ============================================= //
 
+/// Write every constraint added from now on to log (0 to stop)
+void PointerAnalysis::setConstraintLog(std::ostream* log)
+{
+	constraintLog = log;
+}
+
+// ============================================= //
+
+/**
+ * Add the constraints of a log written through setConstraintLog, one per
+ * line as "<kind> A B" with kind one of addr, base, store or load. Empty
+ * lines and lines starting with '#' are skipped. Returns false at the
+ * first malformed line.
+ */
+bool PointerAnalysis::readConstraints(std::istream& input)
+{
+	std::string line;
+	while (std::getline(input, line))
+	{
+		if (line.empty() || line[0] == '#') continue;
+
+		std::istringstream fields(line);
+		std::string kind;
+		int A, B;
+		if (!(fields >> kind >> A >> B)) return false;
+
+		if (kind == "addr") addAddr(A, B);
+		else if (kind == "base") addBase(A, B);
+		else if (kind == "store") addStore(A, B);
+		else if (kind == "load") addLoad(A, B);
+		else return false;
+	}
+	return true;
+}
+
+// ============================================= //
+
 /**
  * Return the set of positions pointed by A:
  *   pointsTo(A) = {B1, B2, ...}
  */
-std::set<int> PointerAnalysis::pointsTo(int A)
+SharedPts PointerAnalysis::pointsTo(int A)
 {
     if (debug) std::cerr << "Recovering Points-to-set of "<< A << std::endl;
 
-	int repA = vertices[A];
-	return pointsToSet[repA];
+	freeze();
+	SharedPtsMap::iterator it = solution.find(A);
+	return it != solution.end() ? it->second : SharedPts();
 }
 
 // ============================================= //
@@ -164,189 +336,387 @@ void PointerAnalysis::addToPts(int pointed, int pointee)
 
 // ============================================= //
 
-void PointerAnalysis::cycleSearch(int source, int target) {
+/**
+ * Push the whole points-to set of fromId across the edge fromId->toId.
+ * Used by difference propagation for edges created during the solve,
+ * since the delta of fromId doesn't hold what it pointed to before.
+ * Returns true if pts(toId) changed.
+ */
+bool PointerAnalysis::propagateEdge(int fromId, int toId)
+{
+    if (debug) std::cerr << "Propagating pts(" << fromId << ") to pts(" << toId << ")" << std::endl;
 
-	numCallsRemove++;
+	return unionPts(pointsToSet[toId], pointsToSet[fromId]);
+}
 
-	if (debug) std::cerr << "Looking for path between " << source << " and " << target << std::endl;
-
-	// Tracking vars
-	bool cycleFound = false;
-	std::tr1::unordered_map<int,int> origin;
-	//IntMap origin;
-	std::tr1::unordered_set<int> visited;
-	//IntSet visited;
-	std::list<int> cycle;
-	std::stack<int> queue;
-
-	// Start with source on the queue
-	if (debug) std::cerr << "Starting with " << source << " on the queue" << std::endl;;
-	queue.push(source);
-	origin[source] = target;
-	visited.insert(source);
-
-	// Do a Breadth-First Search
-	while ( !queue.empty() ) {
-		// Pop next vertex
-		int current = queue.top();
-		queue.pop();
-		if (debug) std::cerr << "Popped " << current << " from the queue" << std::endl;;
-
-		// Found a cycle!
-		if (current == target) {
-			if (debug) std::cerr << "Reached Target!!" << std::endl;
-			cycleFound = true;
-			break;
-		}
+// ============================================= //
 
-		// Loop through the neighbours
-		IntSet::iterator n;
-		for (n = from[current].begin(); n != from[current].end(); ++n) {
+/**
+ * Return the current representative of a node, compressing the chain of
+ * merges on the way so later lookups are O(1).
+ */
+int PointerAnalysis::findRep(int id)
+{
+	IntMap::iterator it = vertices.find(id);
+	if (it == vertices.end() || it->second == id) return id;
 
-			// Get the representative
-			int repN = vertices[*n];
+	int rep = findRep(it->second);
+	it->second = rep;
+	return rep;
+}
 
+// ============================================= //
 
-			// Add it to the search queue, if not there yet
-			if (visited.find(repN) == visited.end()) {
-				if (debug) std::cerr << "Add " << repN << " to the queue and marking it visited" << std::endl;
-				queue.push(repN);
-				visited.insert(repN);
+/**
+ * Compute the strongly connected components of a graph given as adjacency
+ * lists over dense indices, starting from the given roots (iterative
+ * Tarjan). On return comp[v] holds the component of v, or -1 if v was not
+ * reached from any root. Returns the number of components.
+ */
+static int findSCCs(const std::vector<std::vector<int> >& succ,
+	const std::vector<int>& roots, std::vector<int>& comp)
+{
+	int n = succ.size();
+	std::vector<int> index(n, -1), low(n, 0);
+	std::vector<int> sccStack;
+	std::vector<std::pair<int, unsigned> > dfsStack;
+	int nextIndex = 0, numComps = 0;
+
+	comp.assign(n, -1);
+
+	for (unsigned r = 0; r < roots.size(); ++r)
+	{
+		if (index[roots[r]] != -1) continue;
 
-				// Mark 'current' as the antecessor of 'n'
-				if (debug) std::cerr << "Mark " << current << " as antecessor of " << *n << std::endl;
-				origin[repN] = current;
+		dfsStack.push_back(std::make_pair(roots[r], 0u));
+		index[roots[r]] = low[roots[r]] = nextIndex++;
+		sccStack.push_back(roots[r]);
+
+		while (!dfsStack.empty())
+		{
+			int v = dfsStack.back().first;
+			unsigned& next = dfsStack.back().second;
+
+			if (next < succ[v].size())
+			{
+				int w = succ[v][next++];
+				if (index[w] == -1)
+				{
+					index[w] = low[w] = nextIndex++;
+					sccStack.push_back(w);
+					dfsStack.push_back(std::make_pair(w, 0u));
+				}
+				else if (comp[w] == -1 && index[w] < low[v])
+				{
+					// w is still on the SCC stack
+					low[v] = index[w];
+				}
+				continue;
+			}
+
+			// All successors visited: close the component if v is a root
+			if (low[v] == index[v])
+			{
+				int w;
+				do {
+					w = sccStack.back();
+					sccStack.pop_back();
+					comp[w] = numComps;
+				} while (w != v);
+				numComps++;
+			}
+
+			dfsStack.pop_back();
+			if (!dfsStack.empty())
+			{
+				int parent = dfsStack.back().first;
+				if (low[v] < low[parent]) low[parent] = low[v];
 			}
 		}
 	}
 
-	// If we found a cycle, build a list with it
+	return numComps;
+}
+
+// ============================================= //
+
+/**
+ * Lazy cycle detection: called when the edge target->source was found to
+ * join two nodes with identical points-to sets. Looks for the cycles in
+ * the part of the graph reachable from source and collapses every one of
+ * them. The search only
+ * walks representatives whose points-to set is the same as target's,
+ * which keeps it local to the region that is about to be collapsed.
+ * @return true if source and target were found in the same cycle
+ */
+bool PointerAnalysis::detectCycle(int source, int target)
+{
+	numCallsRemove++;
+
+	if (debug) std::cerr << "Looking for cycles between " << source << " and " << target << std::endl;
 
-	if (cycleFound) {
-		int current = target;
-		while (current != source) {
-			cycle.push_front(current);
-			current = origin[current];
+	// Collect the region reachable from source with dense indices
+	std::tr1::unordered_map<int, int> index;
+	std::vector<int> nodes;
+	std::vector<std::vector<int> > succ;
+
+	index[source] = 0;
+	nodes.push_back(source);
+	succ.push_back(std::vector<int>());
+
+	for (unsigned i = 0; i < nodes.size(); ++i)
+	{
+		int current = nodes[i];
+		PtsSet::iterator n;
+		for (n = from[current].begin(); n != from[current].end(); ++n)
+		{
+			int repN = findRep(*n);
+			if (repN == current) continue;
+
+			std::tr1::unordered_map<int, int>::iterator it = index.find(repN);
+			int idx;
+			if (it == index.end())
+			{
+				if (repN != target && pointsToSet[repN] != pointsToSet[target])
+					continue;
+
+				idx = nodes.size();
+				index[repN] = idx;
+				nodes.push_back(repN);
+				succ.push_back(std::vector<int>());
+			}
+			else idx = it->second;
+			succ[i].push_back(idx);
 		}
-		cycle.push_front(source);
-
-		int a = cycle.front();
-		cycle.pop_front();
-		while (!cycle.empty()) {
-			int b = cycle.front();
-			cycle.pop_front();
-			merge(a, b);
-			a = b;
+	}
+
+	std::vector<int> comp;
+	std::vector<int> roots(1, 0);
+	int numComps = findSCCs(succ, roots, comp);
+
+	// Merge every component into its heaviest member
+	std::vector<int> compTarget(numComps, -1);
+	std::vector<int> compSize(numComps, 0);
+	std::vector<size_t> targetWeight(numComps, 0);
+	for (unsigned i = 0; i < nodes.size(); ++i)
+	{
+		int c = comp[i];
+		size_t weight = nodeWeight(nodes[i]);
+		compSize[c]++;
+		if (compTarget[c] == -1 || weight > targetWeight[c])
+		{
+			compTarget[c] = nodes[i];
+			targetWeight[c] = weight;
 		}
 	}
 
+	for (unsigned i = 0; i < nodes.size(); ++i)
+	{
+		if (compSize[comp[i]] > 1 && nodes[i] != compTarget[comp[i]])
+			merge(nodes[i], compTarget[comp[i]]);
+	}
+
+	std::tr1::unordered_map<int, int>::iterator it = index.find(target);
+	return it != index.end() && comp[it->second] == comp[0];
 }
 
 // ============================================= //
 
-void PointerAnalysis::removeCycles()
+/**
+ * Offline part of hybrid cycle detection, run once over the initial
+ * constraints. The offline graph has a node for each variable and a ref
+ * node *a for each dereferenced variable, with edges b->a (a = b),
+ * *b->a (a = *b) and b->*a (*a = b).
+ *  - Cycles made only of variables are collapsed right away.
+ *  - Cycles with a single ref node *a will close over every v in pts(a)
+ *    once the loads/stores of a are resolved, so (a, b) is recorded for
+ *    some variable b of the cycle and v is merged with b during solve.
+ * Cycles through several ref nodes are left to lazy detection, since
+ * they only exist if all those dereferences resolve. This keeps the
+ * results exactly the same as without cycle detection.
+ */
+void PointerAnalysis::collapseOfflineCycles()
 {
-    if (debug) std::cerr << "Running cycle removal algorithm" << std::endl;
-
 	numCallsRemove++;
+	hcdTargets.clear();
 
-    // Some needed variables
-    IntMap order;
-    IntMap repr;
-    int i = 0;
-    IntSet current;
-    IntDeque S;
+	// Dense indices: variables first, then ref nodes
+	std::vector<int> ids(activeVertices.begin(), activeVertices.end());
+	std::tr1::unordered_map<int, int> index;
+	for (unsigned i = 0; i < ids.size(); ++i) index[ids[i]] = i;
 
-    // At first, no node is visited and their representatives are themselves
-    if (debug) std::cerr << ">> Initializing structures" << std::endl;
-    IntSet::iterator V;
-    for (V = activeVertices.begin(); V != activeVertices.end(); V++)
+	std::tr1::unordered_map<int, int> refIndex;
+	for (unsigned i = 0; i < ids.size(); ++i)
 	{
-        order[*V] = 0;
-        repr[*V] = *V;
-    }
+		if (!loads[ids[i]].empty() || !stores[ids[i]].empty())
+		{
+			int idx = ids.size() + refIndex.size();
+			refIndex[ids[i]] = idx;
+		}
+	}
+	int numVars = ids.size();
 
-    // Visit all unvisited nodes
-    if (debug) std::cerr << ">> Visiting vertices" << std::endl;
-    for (V = activeVertices.begin(); V != activeVertices.end(); V++)
+	std::vector<std::vector<int> > succ(numVars + refIndex.size());
+	for (int i = 0; i < numVars; ++i)
 	{
-        if (order[*V] == 0)
-		{
-            visit(*V, order, repr, i, current, S);
-        }
-    }
+		int a = ids[i];
+		PtsSet::iterator v;
+
+		for (v = from[a].begin(); v != from[a].end(); ++v)
+			if (index.count(*v)) succ[i].push_back(index[*v]);
+
+		std::tr1::unordered_map<int, int>::iterator ref = refIndex.find(a);
+		if (ref == refIndex.end()) continue;
+
+		// A = *a edges leave *a, *a = B edges reach it
+		for (v = loads[a].begin(); v != loads[a].end(); ++v)
+			if (index.count(*v)) succ[ref->second].push_back(index[*v]);
+		for (v = stores[a].begin(); v != stores[a].end(); ++v)
+			if (index.count(*v)) succ[index[*v]].push_back(ref->second);
+	}
 
-    // Merge those whose representatives are not themselves
-    if (debug) std::cerr << ">> Merging vertices" << std::endl;
-    for (V = activeVertices.begin(); V != activeVertices.end(); )
+	std::vector<int> roots(succ.size());
+	for (unsigned i = 0; i < succ.size(); ++i) roots[i] = i;
+	std::vector<int> comp;
+	int numComps = findSCCs(succ, roots, comp);
+
+	std::vector<int> firstVar(numComps, -1), numRefs(numComps, 0), refOf(numComps, -1);
+	std::vector<int> size(numComps, 0);
+	for (unsigned i = 0; i < succ.size(); ++i) size[comp[i]]++;
+	for (int i = 0; i < numVars; ++i)
+		if (firstVar[comp[i]] == -1) firstVar[comp[i]] = ids[i];
+	for (std::tr1::unordered_map<int, int>::iterator it = refIndex.begin(); it != refIndex.end(); ++it)
 	{
-        IntSet::iterator nextIt = V;
-        nextIt++;
-        if (debug) std::cerr << " * Current V (Before): " << *V << std::endl;
-        if (debug) std::cerr << " * Current nextIt (Before): " << *nextIt << std::endl;
-        if (repr[*V] != *V) 
-		{
-            merge(*V, repr[*V]);
-        }
-        V = nextIt;
-        if (debug) std::cerr << " * Current V (After): " << *V << std::endl;
-        if (debug) std::cerr << " * Current nextIt (After): " << *nextIt << std::endl;
-    }
+		numRefs[comp[it->second]]++;
+		refOf[comp[it->second]] = it->first;
+	}
 
-    if (debug)
-    {
-        std::cerr << ">> Printing active vertices" << std::endl;
-        for (V = activeVertices.begin(); V != activeVertices.end(); V++) 
-        {
-            std::cerr << *V << std::endl;
-        }
-    }
+	for (int c = 0; c < numComps; ++c)
+	{
+		if (size[c] > 1 && numRefs[c] == 1 && firstVar[c] != -1)
+			hcdTargets[refOf[c]] = firstVar[c];
+	}
+
+	for (int i = 0; i < numVars; ++i)
+	{
+		int c = comp[i];
+		if (size[c] > 1 && numRefs[c] == 0 && findRep(ids[i]) != findRep(firstVar[c]))
+			unite(findRep(ids[i]), findRep(firstVar[c]));
+	}
 
+	if (debug) std::cerr << "Offline cycle detection: " << hcdTargets.size() << " ref cycles" << std::endl;
 }
 
 // ============================================= //
 
-void PointerAnalysis::visit(int Node, IntMap& Order, IntMap& Repr,
-	int& idxOrder, IntSet& Curr, IntDeque& Stack)
+/**
+ * Offline variable substitution (hash-based value numbering), meant to run
+ * over the initial constraints before solve. Each variable is labelled with
+ * the set of "sources" its points-to set can come from:
+ *  - a label per address taken, shared by every a = &b with the same b;
+ *  - a label per dereferenced variable b, given to every a = *b;
+ *  - a fresh label for each variable whose address is taken, since stores
+ *    can write to it in ways the offline graph doesn't show;
+ * and labels flow along the copy edges, with copy cycles collapsed first.
+ * Variables that end up with the same label set have the same points-to
+ * set in the final solution (an empty set means they point nowhere), so
+ * each class is merged into a single node.
+ * @return the number of merged variables
+ */
+int PointerAnalysis::substituteVariables()
 {
-    if (debug) std::cerr << "  - Visiting vertex " << Node << std::endl;
+	thaw();
+	int mergedBefore = numMerged;
+
+	std::vector<int> ids(activeVertices.begin(), activeVertices.end());
+	std::tr1::unordered_map<int, int> index;
+	for (unsigned i = 0; i < ids.size(); ++i) index[ids[i]] = i;
+	int numVars = ids.size();
 
-	idxOrder++;
-    Order[Node] = idxOrder;
+	std::vector<PtsSet> labels(numVars);
+	std::tr1::unordered_map<int, int> addrLabels;
+	std::tr1::unordered_map<int, int>::iterator it;
+	IntSet addressTaken;
+	int nextLabel = 0;
 
-    IntSet::iterator w;
-    for (w = from[Node].begin(); w != from[Node].end(); w++)
+	for (int i = 0; i < numVars; ++i)
 	{
-        if (Order[*w] == 0) visit(*w, Order, Repr, idxOrder, Curr, Stack);
-        if (Curr.find(*w) == Curr.end())
+		int a = ids[i];
+		PtsSet::iterator v;
+
+		for (v = pointsToSet[a].begin(); v != pointsToSet[a].end(); ++v)
 		{
-            Repr[Node] = (Order[Repr[Node]] < Order[Repr[*w]]) ?
-                Repr[Node] :
-                Repr[*w]
-            ;
-        }
-    }
+			it = addrLabels.find(*v);
+			if (it == addrLabels.end())
+				it = addrLabels.insert(std::make_pair(*v, nextLabel++)).first;
+			labels[i].insert(it->second);
+			addressTaken.insert(findRep(*v));
+		}
+
+		if (loads[a].empty()) continue;
+		int ref = nextLabel++;
+		for (v = loads[a].begin(); v != loads[a].end(); ++v)
+			if ((it = index.find(findRep(*v))) != index.end())
+				labels[it->second].insert(ref);
+	}
+
+	for (IntSet::iterator A = addressTaken.begin(); A != addressTaken.end(); ++A)
+		if ((it = index.find(*A)) != index.end())
+			labels[it->second].insert(nextLabel++);
 
-    if (Repr[Node] == Node)
+	// Collapse the copy cycles and push the labels down the copy edges
+	std::vector<std::vector<int> > succ(numVars);
+	for (int i = 0; i < numVars; ++i)
 	{
-        Curr.insert(Node);
-        while (!Stack.empty())
+		PtsSet::iterator v;
+		for (v = from[ids[i]].begin(); v != from[ids[i]].end(); ++v)
+			if ((it = index.find(findRep(*v))) != index.end() && it->second != i)
+				succ[i].push_back(it->second);
+	}
+
+	std::vector<int> roots(numVars);
+	for (int i = 0; i < numVars; ++i) roots[i] = i;
+	std::vector<int> comp;
+	int numComps = findSCCs(succ, roots, comp);
+
+	std::vector<PtsSet> compLabels(numComps);
+	std::vector<std::vector<int> > members(numComps);
+	for (int i = 0; i < numVars; ++i)
+	{
+		unionPts(compLabels[comp[i]], labels[i]);
+		members[comp[i]].push_back(i);
+	}
+
+	// Tarjan numbers components in reverse topological order, so every
+	// edge goes from a component to a lower numbered one
+	for (int c = numComps - 1; c >= 0; --c)
+	{
+		for (unsigned m = 0; m < members[c].size(); ++m)
 		{
-            int w = Stack.front();
-            if (Order[w] <= Order[Node]) break;
-            else
-			{
-                Stack.pop_front();
-                Curr.insert(w);
-                Repr[w] = Node;
-            }
-        }
-        // Push(TopologicalOrder, Node)
-    }
-    else
+			const std::vector<int>& next = succ[members[c][m]];
+			for (unsigned k = 0; k < next.size(); ++k)
+				if (comp[next[k]] != c) unionPts(compLabels[comp[next[k]]], compLabels[c]);
+		}
+	}
+
+	// Merge every variable into the first one seen with the same labels
+	std::map<std::vector<int>, int> classes;
+	for (int c = 0; c < numComps; ++c)
 	{
-        Stack.push_front(Node);
-    }
+		std::vector<int> key(compLabels[c].begin(), compLabels[c].end());
+		int first = classes.insert(std::make_pair(key, ids[members[c][0]])).first->second;
+
+		for (unsigned m = 0; m < members[c].size(); ++m)
+		{
+			int repA = findRep(ids[members[c][m]]);
+			int repFirst = findRep(first);
+			if (repA != repFirst) unite(repA, repFirst);
+		}
+	}
+
+	if (debug) std::cerr << "Offline substitution: " << classes.size() << " classes" << std::endl;
+
+	return numMerged - mergedBefore;
 }
 
 // ============================================= //
@@ -368,19 +738,19 @@ void PointerAnalysis::merge(int id, int target)
 
     // Move all edges id->v to target->v
     if (debug) std::cerr << "Outgoing edges..." << std::endl;
-    IntSet::iterator v;
+    PtsSet::iterator v;
+    unionPts(from[target], from[id]);
     for (v = from[id].begin(); v != from[id].end(); v++)
 	{
-        from[target].insert(*v);
         to[*v].erase(id);
         to[*v].insert(target);
     }
 
     // Move all edges v->id to v->target
     if (debug) std::cerr << "Incoming edges..." << std::endl;
+    unionPts(to[target], to[id]);
     for (v = to[id].begin(); v != to[id].end(); v++)
 	{
-        to[target].insert(*v);
         from[*v].erase(id);
         from[*v].insert(target);
     }
@@ -390,28 +760,48 @@ void PointerAnalysis::merge(int id, int target)
     if (debug) std::cerr << "Removing vertice " << id << " from active." << std::endl;
 	activeVertices.erase(id);
 
+    // With difference propagation, what target already propagated stays
+    // valid for its own edges and constraints; the ones coming from id
+    // are kept apart until they see the whole merged set
+    if (propagatedPts.count(target))
+    {
+        unionPts(freshLoads[target], loads[id]);
+        unionPts(freshStores[target], stores[id]);
+        unionPts(freshEdges[target], from[id]);
+        unionPts(freshLoads[target], freshLoads[id]);
+        unionPts(freshStores[target], freshStores[id]);
+        unionPts(freshEdges[target], freshEdges[id]);
+    }
+    propagatedPts.erase(id);
+    freshLoads.erase(id);
+    freshStores.erase(id);
+    freshEdges.erase(id);
+
     // Merge Stores
     if (debug) std::cerr << "Stores..." << std::endl;
-    for (v = stores[id].begin(); v != stores[id].end(); v++)
-	{
-        stores[target].insert(*v);
-    }
+    unionPts(stores[target], stores[id]);
     stores[id].clear(); // Not really needed, I think
 
     // Merge Loads
     if (debug) std::cerr << "Loads..." << std::endl;
-    for (v = loads[id].begin(); v != loads[id].end(); v++)
-	{
-        loads[target].insert(*v);
-    }
+    unionPts(loads[target], loads[id]);
     loads[id].clear();
 
     // Join Points-To set
     if (debug) std::cerr << "Points-to-set..." << std::endl;
-    for (v = pointsToSet[id].begin(); v != pointsToSet[id].end(); v++)
-	{
-        pointsToSet[target].insert(*v);
+    unionPts(pointsToSet[target], pointsToSet[id]);
+
+    // Keep the offline cycle of id, if any
+    IntMap::iterator H = hcdTargets.find(id);
+    if (H != hcdTargets.end())
+    {
+        if (!hcdTargets.count(target)) hcdTargets[target] = H->second;
+        hcdTargets.erase(H);
     }
+
+    // Nothing reaches id's edges anymore
+    from[id].clear();
+    to[id].clear();
     if (debug) std::cerr << "End of merging..." << std::endl;
 
 	// Count this merge
@@ -420,15 +810,70 @@ void PointerAnalysis::merge(int id, int target)
 
 // ============================================= //
 
+/// Amount of constraints and edges a node has to process again after
+/// absorbing another one
+size_t PointerAnalysis::nodeWeight(int id)
+{
+	return loads[id].size() + stores[id].size() + from[id].size();
+}
+
+// ============================================= //
+
+/**
+ * Merge two representatives, keeping the heaviest one so the least work
+ * has to be redone for the merged node.
+ * @return the representative of the merged node
+ */
+int PointerAnalysis::unite(int a, int b)
+{
+	if (nodeWeight(a) > nodeWeight(b)) std::swap(a, b);
+	merge(a, b);
+	return b;
+}
+
+// ============================================= //
+
+/**
+ * Number the representatives in topological order of the copy edges,
+ * with every cycle left in the graph getting a single number.
+ */
+void PointerAnalysis::topologicalOrder(IntMap& priority)
+{
+	std::vector<int> ids(activeVertices.begin(), activeVertices.end());
+	std::tr1::unordered_map<int, int> index;
+	for (unsigned i = 0; i < ids.size(); ++i) index[ids[i]] = i;
+
+	std::vector<std::vector<int> > succ(ids.size());
+	std::tr1::unordered_map<int, int>::iterator it;
+	for (unsigned i = 0; i < ids.size(); ++i)
+	{
+		PtsSet::iterator v;
+		for (v = from[ids[i]].begin(); v != from[ids[i]].end(); ++v)
+			if ((it = index.find(findRep(*v))) != index.end())
+				succ[i].push_back(it->second);
+	}
+
+	std::vector<int> roots(ids.size());
+	for (unsigned i = 0; i < ids.size(); ++i) roots[i] = i;
+	std::vector<int> comp;
+	int numComps = findSCCs(succ, roots, comp);
+
+	// Tarjan closes the sinks first
+	for (unsigned i = 0; i < ids.size(); ++i)
+		priority[ids[i]] = numComps - 1 - comp[i];
+}
+
+// ============================================= //
+
 bool PointerAnalysis::comparePts(int a, int b) {
 
 	if (pointsToSet[a].size() != pointsToSet[b].size())
 		return false;
 
-	IntSet::iterator V;
+	PtsSet::iterator V;
 	for (V = pointsToSet[a].begin(); V != pointsToSet[a].end(); V++) 
 	{
-		if (pointsToSet[b].find(vertices[*V]) == pointsToSet[b].end()) 
+		if (pointsToSet[b].find(findRep(*V)) == pointsToSet[b].end()) 
 			return false;
 	}
 	return true;
@@ -436,27 +881,236 @@ bool PointerAnalysis::comparePts(int a, int b) {
 
 // ============================================= //
 
+/**
+ * Resolve the load and store constraints of a node for the given part of
+ * its points-to set: for V in pts, A = *Node adds V->A and *Node = B adds
+ * B->V. Nodes that must be processed again are added to WorkList.
+ */
+void PointerAnalysis::resolveComplex(const PtsSet& pts, const PtsSet& nodeLoads,
+	const PtsSet& nodeStores, bool withDiffPropagation, PAWorklist& WorkList)
+{
+    PtsSet::iterator V;
+    for (V = pts.begin(); V != pts.end(); V++ )
+		{
+        int reprV = findRep(*V);
+        if (debug)
+        {
+            std::cerr << "   - Current V: " << *V << std::endl;
+            std::cerr << "   - Repr of V: " << reprV << std::endl;
+            std::cerr << "   - Load Constraints" << std::endl;
+        }
+        // For every constraint A = *Node
+        PtsSet::iterator A;
+        for (A=nodeLoads.begin(); A != nodeLoads.end(); A++) 
+        {
+            // If V->A not in Graph
+            // Get the repr of A
+            int reprA = findRep(*A);
+            if (from[reprV].find(reprA) == from[reprV].end()) 
+				{
+                addEdge(reprV, reprA);
+                if (!withDiffPropagation)
+                    WorkList.push(reprV);
+                else if (propagateEdge(reprV, reprA))
+                    WorkList.push(reprA);
+            }
+        }
+
+        if (debug) std::cerr << "   - Store Constraints" << std::endl;
+        // For every constraint *Node = B
+        PtsSet::iterator B;
+        for (B=nodeStores.begin(); B != nodeStores.end(); B++) 
+        {
+            // If B->V not in Graph
+            // Get the repr of B
+            int reprB = findRep(*B);
+            if (from[reprB].find(reprV) == from[reprB].end()) 
+				{
+                addEdge(reprB, reprV);
+                if (!withDiffPropagation)
+                    WorkList.push(reprB);
+                else if (propagateEdge(reprB, reprV))
+                    WorkList.push(reprV);
+            }
+        }
+    }
+}
+
+// ============================================= //
+
+/**
+ * First part of processing a node: apply the hybrid cycle detection step,
+ * then resolve the load and store constraints of the node. With difference
+ * propagation, delta gets the part of pts(Node) not propagated yet.
+ * @return the representative of the node after any merges
+ */
+int PointerAnalysis::prepareNode(int Node, CycleDetection cycles,
+	bool withDiffPropagation, PtsSet& delta, PAWorklist& WorkList)
+{
+    // Hybrid cycle detection: everything Node points to is in a cycle
+    // with the variable recorded by the offline pass
+    IntMap::iterator H;
+    if (cycles == HybridCycleDetection && (H = hcdTargets.find(Node)) != hcdTargets.end())
+    {
+        int target = findRep(H->second);
+        std::vector<int> pointees(pointsToSet[Node].begin(), pointsToSet[Node].end());
+        for (unsigned i = 0; i < pointees.size(); ++i)
+        {
+            int repV = findRep(pointees[i]);
+            if (repV == target) continue;
+            target = unite(repV, target);
+            WorkList.push(target);
+        }
+        Node = findRep(Node);
+    }
+
+    // With difference propagation, only look at what is new in
+    // pts(Node) since the last time it was processed
+    const PtsSet* work = &pointsToSet[Node];
+    if (withDiffPropagation)
+    {
+        delta = pointsToSet[Node];
+        subtractPts(delta, propagatedPts[Node]);
+        propagatedPts[Node] = pointsToSet[Node];
+        work = &delta;
+    }
+
+    // Constraints and edges Node got from merged nodes haven't seen any
+    // of pts(Node) yet
+    if (withDiffPropagation && freshLoads.count(Node))
+    {
+        resolveComplex(pointsToSet[Node], freshLoads[Node], freshStores[Node],
+            true, WorkList);
+        PtsSet::iterator Z;
+        for (Z = freshEdges[Node].begin(); Z != freshEdges[Node].end(); Z++)
+        {
+            int repZ = findRep(*Z);
+            if (repZ != Node && propagateEdge(Node, repZ))
+                WorkList.push(repZ);
+        }
+        freshLoads.erase(Node);
+        freshStores.erase(Node);
+        freshEdges.erase(Node);
+    }
+
+    resolveComplex(*work, loads[Node], stores[Node], withDiffPropagation, WorkList);
+
+    return Node;
+}
+
+// ============================================= //
+
+/**
+ * Second part of processing a node: push work along the copy edges
+ * Node->Z, collapsing the cycles lazy detection finds on the way.
+ */
+void PointerAnalysis::propagateCopies(int Node, const PtsSet& work, CycleDetection cycles,
+	EdgeSet& checkedEdges, PAWorklist& WorkList)
+{
+    if (debug) std::cerr << " - End step" << std::endl;
+    // For Node->Z in Graph
+
+    for  (PtsSet::iterator Z = from[Node].begin(); Z != from[Node].end(); )
+	{
+		int ZVal = *Z++;
+		int repZ = findRep(ZVal);
+		if (repZ == Node) continue;
+
+        if (debug) std::cerr << " - Comparing pts of " << Node << " and " << repZ << std::endl;
+
+		// Lazy cycle detection: Node->Z is likely in a cycle if both
+		// already point to the same places
+		if (cycles != NoCycleDetection && !pointsToSet[Node].empty()
+				&& pointsToSet[repZ] == pointsToSet[Node]
+				&& checkedEdges.insert(((long long)Node << 32) | (unsigned)repZ).second)
+		{
+			if (debug) std::cerr << " - Removing cycles..." << std::endl;
+			if (detectCycle(repZ, Node))
+			{
+				// The cycle was collapsed; its representative must be
+				// processed again for what it got from the merged nodes.
+				// If Node was merged, its remaining edges moved there.
+				int rep = findRep(Node);
+				WorkList.push(rep);
+				if (rep != Node) break;
+				Z = from[Node].upper_bound(ZVal);
+				continue;
+			}
+			if (debug) std::cerr << " - Cycles removed" << std::endl;
+		}
+
+        // Merge the points-To Set
+        if (debug) std::cerr << " - Merging pts" << std::endl;
+        bool changed = unionPts(pointsToSet[repZ], work);
+
+        // Add Z to WorkList if pointsToSet(Z) changed
+        if (changed)
+		{
+            WorkList.push(repZ);
+        }
+
+        if (debug) std::cerr << " - End of step" << std::endl;
+    }
+}
+
+// ============================================= //
+
 /**
  * Execute the pointer analysis
  * TODO: Add info about the analysis
  */
-void PointerAnalysis::solve(bool withCycleRemoval)
+void PointerAnalysis::solve(bool withCycleRemoval, bool withDiffPropagation)
+{
+	solve(withCycleRemoval ? LazyCycleDetection : NoCycleDetection, withDiffPropagation);
+}
+
+// ============================================= //
+
+/**
+ * Execute the pointer analysis with the given kind of cycle detection.
+ *  - LazyCycleDetection searches for cycles when an edge joins two nodes
+ *    that already have the same points-to set (each edge is tried once).
+ *  - HybridCycleDetection also runs the offline pass first, so known
+ *    cycles are collapsed before or as soon as they show up.
+ * Nodes to process are taken from the worklist in the given order.
+ */
+void PointerAnalysis::solve(CycleDetection cycles, bool withDiffPropagation,
+	WorklistOrder order)
 {
+	thaw();
+	overBudget = false;
 	numMerged = 0;
 	numCallsRemove = 0;
-    std::set<std::string> R;
-    IntSet WorkSet = activeVertices;
-    IntSet NewWorkSet;
+	numIterations = 0;
+	propagatedPts.clear();
+    EdgeSet checkedEdges;
+
+    if (cycles == HybridCycleDetection) collapseOfflineCycles();
+
+    PAWorklist WorkList(order);
+    int orderedMerges = 0;
+    for (IntSet::iterator it = activeVertices.begin(); it != activeVertices.end(); ++it)
+        WorkList.push(*it);
 
     if (debug) std::cerr << "Starting the analysis" << std::endl;
 
-    while (!WorkSet.empty()) {
+    while (!WorkList.empty()) {
 
-    	if (debug)  std::cerr << "WorkSet.size: " << WorkSet.size() << "\n";
+        if ((numIterations & 4095) == 0 && checkMemoryBudget()) return;
 
-        int Node = *WorkSet.begin();
-        Node = vertices[Node];
-        WorkSet.erase(WorkSet.begin());
+        // Only renumber the nodes when merges collapsed part of the
+        // graph; new edges alone leave the old order good enough
+        if (order == TopologicalOrder && WorkList.roundDone()
+                && (numIterations == 0 || numMerged != orderedMerges))
+        {
+            IntMap priority;
+            topologicalOrder(priority);
+            WorkList.setPriorities(priority);
+            orderedMerges = numMerged;
+        }
+
+        int Node = findRep(WorkList.pop());
+        numIterations++;
 
         if (debug)
         {
@@ -464,120 +1118,254 @@ void PointerAnalysis::solve(bool withCycleRemoval)
             std::cerr << " - Current Node: " << Node << std::endl;
         }
 
-        // For V in pts(Node)
-        IntSet::iterator V;
-        for (V = pointsToSet[Node].begin(); V != pointsToSet[Node].end(); V++ )
-		{
-            int reprV = vertices[*V];
-            if (debug)
-            {
-                std::cerr << "   - Current V: " << *V << std::endl;
-                std::cerr << "   - Repr of V: " << reprV << std::endl;
-                std::cerr << "   - Load Constraints" << std::endl;
+        PtsSet delta;
+        Node = prepareNode(Node, cycles, withDiffPropagation, delta, WorkList);
+        const PtsSet& work = withDiffPropagation ? delta : pointsToSet[Node];
+        propagateCopies(Node, work, cycles, checkedEdges, WorkList);
+    }
+    finishSolve();
+}
+
+// ============================================= //
+
+/// Drop the solver state and give merged nodes the points-to set of their
+/// representative
+void PointerAnalysis::finishSolve()
+{
+    propagatedPts.clear();
+    freshLoads.clear();
+    freshStores.clear();
+    freshEdges.clear();
+    freeze();
+}
+
+// ============================================= //
+
+/**
+ * Union-find for the unification solver. A class stands for variables and
+ * positions that share one points-to set; pointee[c] is the class of what
+ * they point to, or -1. The classes past the variables are positions that
+ * no variable names.
+ */
+class PAUnifier {
+
+    public:
+        PAUnifier(int size) : parent(size), rank(size, 0), pointee(size, -1) {
+            for (int i = 0; i < size; ++i) parent[i] = i;
+        }
+
+        int find(int c) {
+            while (parent[c] != c) {
+                parent[c] = parent[parent[c]];
+                c = parent[c];
             }
-            // For every constraint A = *Node
-            IntSet::iterator A;
-            for (A=loads[Node].begin(); A != loads[Node].end(); A++) 
-            {
-                // If V->A not in Graph
-                // Get the repr of A
-                int reprA = vertices[*A];
-                if (from[reprV].find(reprA) == from[reprV].end()) 
-				{
-                    addEdge(reprV, reprA);
-                    NewWorkSet.insert(reprV);
-                }
+            return c;
+        }
+
+        // The class c points to, or -1
+        int pointeeOf(int c) {
+            int p = pointee[find(c)];
+            return p < 0 ? -1 : find(p);
+        }
+
+        // The class c points to, a new one if it points nowhere yet
+        int target(int c) {
+            c = find(c);
+            if (pointee[c] < 0) {
+                int fresh = parent.size();
+                parent.push_back(fresh);
+                rank.push_back(0);
+                pointee.push_back(-1);
+                pointee[c] = fresh;
             }
+            return find(pointee[c]);
+        }
 
-            if (debug) std::cerr << "   - Store Constraints" << std::endl;
-            // For every constraint *Node = B
-            IntSet::iterator B;
-            for (B=stores[Node].begin(); B != stores[Node].end(); B++) 
-            {
-                // If B->V not in Graph
-                // Get the repr of B
-                int reprB = vertices[*B];
-                if (from[reprB].find(reprV) == from[reprB].end()) 
-				{
-                    addEdge(reprB, reprV);
-                    NewWorkSet.insert(reprB);
-                }
+        // Join the classes of a and b, then the ones they point to, and so on
+        void join(int a, int b) {
+            work.push_back(std::make_pair(a, b));
+            while (!work.empty()) {
+                a = find(work.back().first);
+                b = find(work.back().second);
+                work.pop_back();
+                if (a == b) continue;
+
+                if (rank[a] < rank[b]) std::swap(a, b);
+                parent[b] = a;
+                if (rank[a] == rank[b]) rank[a]++;
+
+                if (pointee[a] < 0) pointee[a] = pointee[b];
+                else if (pointee[b] >= 0) work.push_back(std::make_pair(pointee[a], pointee[b]));
             }
         }
 
-        if (debug) std::cerr << " - End step" << std::endl;
-        // For Node->Z in Graph
+    private:
+        std::vector<int> parent;
+        std::vector<int> rank;
+        std::vector<int> pointee;
+        std::vector<std::pair<int, int> > work;
+};
 
-        for  (IntSet::iterator Z = from[Node].begin(); Z != from[Node].end(); Z++ )
+/**
+ * Steensgaard's analysis over the constraints, each one visited once:
+ *   A = &B   B is in the class A points to
+ *   A = B    A and B point to the same class
+ *   A = *B   A points to what the class B points to points to
+ *   *A = B   the class A points to points to what B points to
+ * Then every variable points to the positions of its pointee class. Run
+ * after a solve that gave up, the points-to sets found so far are taken
+ * as address constraints, which they are implied by.
+ */
+void PointerAnalysis::solveUnification()
+{
+	thaw();
+	propagatedPts.clear();
+	freshLoads.clear();
+	freshStores.clear();
+	freshEdges.clear();
+	if (vertices.empty()) return;
+
+	PAUnifier classes(vertices.rbegin()->first + 1);
+	for (PtsSetMap::iterator it = pointsToSet.begin(); it != pointsToSet.end(); ++it)
+	{
+		if (findRep(it->first) != it->first) continue;
+		for (PtsSet::const_iterator b = it->second.begin(); b != it->second.end(); ++b)
+			classes.join(classes.target(it->first), findRep(*b));
+	}
+	for (PtsSetMap::iterator it = from.begin(); it != from.end(); ++it)
+		for (PtsSet::const_iterator a = it->second.begin(); a != it->second.end(); ++a)
+			classes.join(classes.target(findRep(*a)), classes.target(findRep(it->first)));
+	for (PtsSetMap::iterator it = loads.begin(); it != loads.end(); ++it)
+		for (PtsSet::const_iterator a = it->second.begin(); a != it->second.end(); ++a)
+			classes.join(classes.target(findRep(*a)),
+				classes.target(classes.target(findRep(it->first))));
+	for (PtsSetMap::iterator it = stores.begin(); it != stores.end(); ++it)
+		for (PtsSet::const_iterator b = it->second.begin(); b != it->second.end(); ++b)
+			classes.join(classes.target(classes.target(findRep(it->first))),
+				classes.target(findRep(*b)));
+
+	// The positions of each class, shared by all the variables pointing to it
+	std::map<int, PtsSet> positions;
+	for (PtsSetMap::iterator it = pointsToSet.begin(); it != pointsToSet.end(); ++it)
+	{
+		if (findRep(it->first) != it->first) continue;
+		for (PtsSet::const_iterator b = it->second.begin(); b != it->second.end(); ++b)
+			positions[classes.find(findRep(*b))].insert(*b);
+	}
+
+	std::map<int, SharedPts> shared;
+	solution.clear();
+	for (IntMap::iterator v = vertices.begin(); v != vertices.end(); ++v)
+	{
+		int pointee = classes.pointeeOf(findRep(v->first));
+		if (pointee < 0) continue;
+		std::map<int, PtsSet>::iterator pos = positions.find(pointee);
+		if (pos == positions.end()) continue;
+
+		SharedPts& handle = shared[pointee];
+		if (handle.empty())
 		{
-            int ZVal = *Z;
-			int repN = vertices[Node];
-			int repZ = vertices[ZVal];
-            std::stringstream sstm;
-            sstm << repN << "->" << repZ;
-            std::string edge = sstm.str();
-
-            if (debug) std::cerr << " - Comparing pts of " << Node << " and " << ZVal << std::endl;
-
-			if (withCycleRemoval) {
-				// Compare points-to sets
-				if (debug) {
-					std::cerr << "    - Reps: " << repN << " and " << repZ << std::endl;
-					std::cerr << "PTS("<<repN<<"): ";
-					//for(int i : pointsToSet[repN]) std::cerr << i << " ";
-					std::cerr << std::endl;
-					std::cerr << "PTS("<<repZ<<"): ";
-					//for(int i : pointsToSet[repZ]) std::cerr << i << " ";
-					std::cerr << std::endl;
-					std::cerr << "PTS == PTS ? " << (pointsToSet[repZ] == pointsToSet[repN]) << std::endl;
-					std::cerr << "ComparePTS : " << comparePts(repZ, repN) << std::endl;
-					std::cerr << "Edge: [" << edge << "] (" << (R.find(edge) == R.end()) << ")" << std::endl;
-				}
-				if ( repZ != repN && pointsToSet[repZ] == pointsToSet[repN]
-						&& R.find(edge) == R.end() )
-				{
-					if (debug) std::cerr << " - Removing cycles..." << std::endl;
-					//removeCycles();
-					cycleSearch(repZ, repN);
-					R.insert(edge);
-					if (debug) std::cerr << " - Cycles removed" << std::endl;
+			PtsSet* copy = new PtsSet();
+			copy->swap(pos->second);
+			handle = SharedPts(std::tr1::shared_ptr<const PtsSet>(copy));
+		}
+		solution.insert(solution.end(), std::make_pair(v->first, handle));
+	}
+
+	frozen = unified = true;
+}
+
+bool PointerAnalysis::isUnified() const
+{
+	return unified;
+}
+
+// ============================================= //
+
+static size_t hashPts(const PtsSet& S)
+{
+#ifdef PA_USE_STD_SET
+	size_t h = S.size();
+	for (PtsSet::const_iterator it = S.begin(); it != S.end(); ++it)
+		h = h * 31 + *it;
+	return h;
+#else
+	return S.hash();
+#endif
+}
+
+/**
+ * Move the points-to sets into the solution, interning them so that the
+ * variables with equal sets share a single copy. Merged vertices get the
+ * set of their representative.
+ */
+void PointerAnalysis::freeze()
+{
+	if (frozen) return;
+
+	typedef std::tr1::shared_ptr<const PtsSet> PtsPtr;
+	std::tr1::unordered_multimap<size_t, PtsPtr> interned;
+	std::tr1::unordered_map<int, SharedPts> repSets;
+
+	solution.clear();
+	for (IntMap::iterator v = vertices.begin(); v != vertices.end(); ++v)
+	{
+		int rep = findRep(v->first);
+		if (rep == v->first && pointsToSet.find(rep) == pointsToSet.end())
+			continue;
+
+		std::tr1::unordered_map<int, SharedPts>::iterator known = repSets.find(rep);
+		if (known == repSets.end())
+		{
+			PtsSet& pts = pointsToSet[rep];
+			size_t h = hashPts(pts);
+			SharedPts handle;
+			std::pair<std::tr1::unordered_multimap<size_t, PtsPtr>::iterator,
+				std::tr1::unordered_multimap<size_t, PtsPtr>::iterator> range =
+				interned.equal_range(h);
+			for ( ; range.first != range.second; ++range.first)
+				if (*range.first->second == pts) {
+					handle = SharedPts(range.first->second);
+					break;
 				}
+			if (handle.empty() && !pts.empty())
+			{
+				PtsSet* copy = new PtsSet();
+				copy->swap(pts);
+				PtsPtr shared(copy);
+				interned.insert(std::make_pair(h, shared));
+				handle = SharedPts(shared);
 			}
+			known = repSets.insert(std::make_pair(rep, handle)).first;
+		}
+		solution.insert(solution.end(), std::make_pair(v->first, known->second));
+	}
 
-            // Merge the points-To Set
-            if (debug) std::cerr << " - Merging pts" << std::endl;
-            bool changed = false;
-            for (V = pointsToSet[Node].begin(); V != pointsToSet[Node].end(); V++)
-			{
-                changed |= pointsToSet[ZVal].insert(*V).second;
-            }
+	pointsToSet.clear();
+	frozen = true;
+}
 
-            // Add Z to WorkSet if pointsToSet(Z) changed
-            if (changed)
-			{
-                NewWorkSet.insert(ZVal);
-            }
+// ============================================= //
 
-            if (debug) std::cerr << " - End of step" << std::endl;
-        }
+/// Give the representatives their points-to sets back, to change the analysis
+void PointerAnalysis::thaw()
+{
+	if (!frozen) return;
 
-        // Swap WorkSets if needed
-        if (WorkSet.empty()) WorkSet.swap(NewWorkSet);
-    }
+	// The points-to sets still hold what solveUnification started from
+	if (unified)
+	{
+		solution.clear();
+		frozen = unified = false;
+		return;
+	}
 
-    // Consolidate Points-To Set
-    IntMap::iterator NodeIt;
-    for (NodeIt = vertices.begin(); NodeIt != vertices.end(); NodeIt++) {
-        // Only have to consolidate if vertex is not active (was merged)
-        // (in other words, when its repr. is not itself)
-        if (NodeIt->first != NodeIt->second) {
-            const IntSet& ptsR = pointsToSet[NodeIt->second];
-            IntSet::iterator V;
-            for (V = ptsR.begin(); V != ptsR.end(); V++) {
-                pointsToSet[NodeIt->first].insert(*V);
-            }
-        }
-    }
+	for (SharedPtsMap::iterator it = solution.begin(); it != solution.end(); ++it)
+		if (findRep(it->first) == it->first)
+			pointsToSet[it->first] = it->second.get();
+
+	solution.clear();
+	frozen = false;
 }
 
 // ============================================= //
@@ -585,6 +1373,7 @@ void PointerAnalysis::solve(bool withCycleRemoval)
 /// Prints the graph to std output
 void PointerAnalysis::print()
 {
+    thaw();
     std::cout << "# of Vertices: ";
     std::cout << vertices.size() << std::endl;
     IntSet::iterator it;
@@ -604,7 +1393,7 @@ void PointerAnalysis::print()
     for (it = activeVertices.begin(); it != activeVertices.end(); it++)
 	{
         std::cout << *it << " -> ";
-        IntSet::iterator n;
+        PtsSet::iterator n;
         for (n = from[*it].begin(); n!= from[*it].end(); n++)
         {
             std::cout << *n << " ";
@@ -619,7 +1408,7 @@ void PointerAnalysis::print()
     for (v = vertices.begin(); v != vertices.end(); v++)
 	{
         std::cout << v->first << " -> {";
-        IntSet::iterator n;
+        PtsSet::iterator n;
         for (n = pointsToSet[v->first].begin(); n != pointsToSet[v->first].end();  n++)
         {
             std::cout << *n << ", ";
@@ -637,6 +1426,8 @@ void PointerAnalysis::print()
 void PointerAnalysis::printDot(std::ostream& output, std::string graphName,
         std::map<int, std::string> names) {
 
+    thaw();
+
     // Used to create the labels
     IntSetMap verticesLabels;
 
@@ -644,6 +1435,7 @@ void PointerAnalysis::printDot(std::ostream& output, std::string graphName,
     IntMap::iterator mapIt;
     IntSet::iterator setIt;
     IntSet::iterator setIt2;
+    PtsSet::iterator ptsIt;
 
     // For each active vertex, build a set with the merged vertices
     // represented by it
@@ -692,9 +1484,9 @@ void PointerAnalysis::printDot(std::ostream& output, std::string graphName,
 
     // Print the Edges
     for (setIt = activeVertices.begin(); setIt != activeVertices.end(); setIt++) {
-        for (setIt2 = from[*setIt].begin(); setIt2 != from[*setIt].end() ; setIt2++) {
-            if (*setIt == *setIt2) continue;
-            output << "    " << *setIt << " -> " << *setIt2 << ";" << std::endl;
+        for (ptsIt = from[*setIt].begin(); ptsIt != from[*setIt].end() ; ptsIt++) {
+            if (*setIt == *ptsIt) continue;
+            output << "    " << *setIt << " -> " << *ptsIt << ";" << std::endl;
         }
     }
 
@@ -706,18 +1498,18 @@ void PointerAnalysis::printDot(std::ostream& output, std::string graphName,
 
         // Print the node with the pointed locations
         output << "    pts" << *setIt << " [label=\"";
-        setIt2 = pointsToSet[*setIt].begin();
-        int n = *(setIt2++);
+        ptsIt = pointsToSet[*setIt].begin();
+        int n = *(ptsIt++);
         if (names.find(n) == names.end()) 
             output << "#" << n;
         else
             output << names[n];
-        for (; setIt2 != pointsToSet[*setIt].end() ; setIt2++) {
-            n = *setIt2;
+        for (; ptsIt != pointsToSet[*setIt].end() ; ptsIt++) {
+            n = *ptsIt;
             if (names.find(n) == names.end()) 
-                output << ", #" << *setIt2;
+                output << ", #" << *ptsIt;
             else
-                output << ", " << names[*setIt2];
+                output << ", " << names[*ptsIt];
         }
         output << "\",color=red,style=dashed,shape=box];" << std::endl;
 
@@ -732,8 +1524,116 @@ void PointerAnalysis::printDot(std::ostream& output, std::string graphName,
 // ============================================= //
 
 /// Returns the points-to map
-std::map<int, std::set<int> > PointerAnalysis::allPointsTo() {
-    return pointsToSet;
+const SharedPtsMap& PointerAnalysis::allPointsTo() {
+    freeze();
+    return solution;
+}
+
+// ============================================= //
+
+/// Write v in 7-bit groups, low first, with the top bit set on all but
+/// the last one
+static void writeVarInt(std::ostream& output, unsigned v)
+{
+	while (v >= 0x80)
+	{
+		output.put((char)(v | 0x80));
+		v >>= 7;
+	}
+	output.put((char)v);
+}
+
+static bool readVarInt(const char*& data, const char* end, unsigned& v)
+{
+	v = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (data == end) return false;
+		unsigned char byte = *data++;
+		v |= (unsigned)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+// ============================================= //
+
+/**
+ * Write the solution as variable-length ints: the number of vertices and
+ * their ids, then the number of points-to sets and, for each one, its
+ * node, its size and its elements. Ids and elements are sorted, so only
+ * the difference to the previous one is written.
+ */
+void PointerAnalysis::writeSolution(std::ostream& output)
+{
+	freeze();
+
+	int last = 0;
+	writeVarInt(output, vertices.size());
+	for (IntMap::iterator v = vertices.begin(); v != vertices.end(); ++v)
+	{
+		writeVarInt(output, v->first - last);
+		last = v->first;
+	}
+
+	last = 0;
+	writeVarInt(output, solution.size());
+	for (SharedPtsMap::iterator it = solution.begin(); it != solution.end(); ++it)
+	{
+		writeVarInt(output, it->first - last);
+		last = it->first;
+
+		int lastElem = 0;
+		writeVarInt(output, it->second.size());
+		for (SharedPts::iterator n = it->second.begin(); n != it->second.end(); ++n)
+		{
+			writeVarInt(output, *n - lastElem);
+			lastElem = *n;
+		}
+	}
+}
+
+// ============================================= //
+
+/**
+ * Read a solution written by writeSolution. Every vertex is its own
+ * representative afterwards, so queries are answered as after solve.
+ */
+bool PointerAnalysis::readSolution(const char* data, size_t size)
+{
+	const char* end = data + size;
+	unsigned numVertices, numSets, delta;
+	int last = 0;
+
+	if (!readVarInt(data, end, numVertices)) return false;
+	for (unsigned i = 0; i < numVertices; ++i)
+	{
+		if (!readVarInt(data, end, delta)) return false;
+		last += delta;
+		vertices.insert(vertices.end(), std::make_pair(last, last));
+		activeVertices.insert(activeVertices.end(), last);
+	}
+
+	last = 0;
+	if (!readVarInt(data, end, numSets)) return false;
+	for (unsigned i = 0; i < numSets; ++i)
+	{
+		unsigned numElems;
+		if (!readVarInt(data, end, delta) || !readVarInt(data, end, numElems))
+			return false;
+		last += delta;
+
+		PtsSet& pts = pointsToSet[last];
+		int elem = 0;
+		for (unsigned e = 0; e < numElems; ++e)
+		{
+			if (!readVarInt(data, end, delta)) return false;
+			elem += delta;
+			pts.insert(elem);
+		}
+	}
+	freeze();
+	return data == end;
 }
 
 // ============================================= //
@@ -756,3 +1656,36 @@ int PointerAnalysis::getNumVertices() {
 }
 
 // ============================================= //
+
+int PointerAnalysis::getNumIterations() {
+	return this->numIterations;
+}
+
+// ============================================= //
+
+int PointerAnalysis::getNumConstraints() const {
+	return numConstraints;
+}
+
+// ============================================= //
+
+void PointerAnalysis::setMemoryBudget(long kb) {
+	memoryBudget = kb;
+}
+
+bool PointerAnalysis::isOverMemoryBudget() const {
+	return overBudget;
+}
+
+/// Whether the peak resident set went over the budget; remembered until
+/// the next solve
+bool PointerAnalysis::checkMemoryBudget() {
+	if (!memoryBudget || overBudget) return overBudget;
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	overBudget = usage.ru_maxrss > memoryBudget;
+	return overBudget;
+}
+
+// ============================================= //
@@ -6,7 +6,14 @@
 #include <set>
 #include <map>
 #include <deque>
+#include <vector>
 #include <ostream>
+#include <istream>
+#include <cstddef>
+#include <tr1/unordered_set>
+#include <tr1/memory>
+
+#include "SparseBitSet.h"
 
 // ============================================= //
 
@@ -14,12 +21,91 @@ typedef std::set<int> IntSet;
 typedef std::map<int, IntSet> IntSetMap;
 typedef std::map<int, int> IntMap;
 typedef std::deque<int> IntDeque;
+typedef std::tr1::unordered_set<long long> EdgeSet;
+
+// Backend for the points-to sets, the graph edges and the complex
+// constraints. Sparse bitvectors by default; build with -DPA_USE_STD_SET
+// to get the old std::set<int> behaviour and cross-check results.
+#ifdef PA_USE_STD_SET
+typedef std::set<int> PtsSet;
+#else
+typedef SparseBitSet PtsSet;
+#endif
+typedef std::map<int, PtsSet> PtsSetMap;
+
+class PAWorklist;
+
+// ============================================= //
+
+/**
+ * Read-only handle to a points-to set of the solution. Solved sets are
+ * hash-consed: all the variables with the same points-to set share one
+ * reference counted copy, so handles are cheap to copy and stay valid
+ * after the analysis is gone. A default handle is the empty set.
+ */
+class SharedPts {
+
+    public:
+        typedef PtsSet::const_iterator iterator;
+        typedef PtsSet::const_iterator const_iterator;
+
+        SharedPts() {}
+        explicit SharedPts(const std::tr1::shared_ptr<const PtsSet>& s) : set(s) {}
+
+        const PtsSet& get() const { return set ? *set : emptySet(); }
+
+        iterator begin() const { return get().begin(); }
+        iterator end() const { return get().end(); }
+        size_t size() const { return get().size(); }
+        bool empty() const { return get().empty(); }
+        size_t count(int x) const { return get().count(x); }
+
+        // Copy the set out
+        IntSet toSet() const { return IntSet(begin(), end()); }
+
+        // The same copy is equal at once; handles of different copies, such
+        // as those of two solutions, compare the elements
+        bool operator==(const SharedPts& other) const {
+            return set == other.set || get() == other.get();
+        }
+        bool operator!=(const SharedPts& other) const { return !(*this == other); }
+
+    private:
+        static const PtsSet& emptySet() { static const PtsSet empty; return empty; }
+
+        std::tr1::shared_ptr<const PtsSet> set;
+};
+
+typedef std::map<int, SharedPts> SharedPtsMap;
 
 // ============================================= //
 
 class PointerAnalysis {
 
     public:
+        // How the solver finds and collapses cycles of the constraint graph
+        enum CycleDetection {
+            NoCycleDetection,
+            // Search for cycles when an edge joins two nodes with the same
+            // points-to set
+            LazyCycleDetection,
+            // Lazy detection plus an offline SCC pass over the initial
+            // constraints
+            HybridCycleDetection
+        };
+
+        // Order in which the solver visits the nodes to be processed
+        enum WorklistOrder {
+            // Rounds in increasing node id order
+            IdOrder,
+            // Least recently processed node first
+            LRFOrder,
+            // Rounds in topological order of the collapsed graph
+            TopologicalOrder,
+            // Rounds in the order the nodes were added
+            FIFOOrder
+        };
+
         PointerAnalysis();
         ~PointerAnalysis();
 
@@ -35,15 +121,56 @@ class PointerAnalysis {
         // Add a constraint of type: A = *B
         void addLoad(int A, int B);
 
-        // Execute the pointer analysis
-        void solve(bool withCycleRemoval = true);
+        // Record the constraints added from now on (0 stops recording), and
+        // add the constraints of such a record. Reading returns false if
+        // the record is malformed.
+        void setConstraintLog(std::ostream* log);
+        bool readConstraints(std::istream& input);
+
+        // Execute the pointer analysis. With difference propagation, each
+        // node only pushes what was added to its points-to set since it
+        // was last processed, instead of the whole set.
+        void solve(bool withCycleRemoval = true, bool withDiffPropagation = false);
+        void solve(CycleDetection cycles, bool withDiffPropagation = false,
+                WorklistOrder order = IdOrder);
+
+        // Execute a unification-based (Steensgaard) analysis of the same
+        // constraints, in almost linear time and space: the positions that
+        // one variable may point to are merged into one, so variables point
+        // to all of it or to none. A sound but coarser solution than solve;
+        // it may follow a solve that gave up on its memory budget.
+        void solveUnification();
+        // Whether the solution is the one of solveUnification
+        bool isUnified() const;
+
+        // Make solve give up once the peak resident set
+        // of the process goes over kb kilobytes (0 for no limit), and tell
+        // whether the last one did. The constraints are left for
+        // solveUnification.
+        void setMemoryBudget(long kb);
+        bool isOverMemoryBudget() const;
+
+        // Number of constraints added so far
+        int getNumConstraints() const;
+
+        // Merge the variables that are bound to end up with the same
+        // points-to set, before solving (offline variable substitution).
+        // Returns the number of merged variables.
+        int substituteVariables();
 
         // Return the set of positions pointed by A:
         //   pointsTo(A) = {B1, B2, ...}
-        std::set<int>  pointsTo(int A);
+        SharedPts pointsTo(int A);
 
-        // Return the points-to map
-        std::map<int, std::set<int> > allPointsTo();
+        // Return the points-to map, with an entry for every variable. The
+        // reference stays valid until the analysis is changed again.
+        const SharedPtsMap& allPointsTo();
+
+        // Write the solution (vertices and points-to sets) in a compact
+        // binary form, and read it back into an empty analysis. Reading
+        // returns false if the data is malformed.
+        void writeSolution(std::ostream& output);
+        bool readSolution(const char* data, size_t size);
 
         // Print the current state (graph, representatives and points-to)
 		void print();
@@ -56,6 +183,8 @@ class PointerAnalysis {
 		int getNumOfMertgedVertices();
 		int getNumCallsRemove();
 		int getNumVertices();
+		// Get the amount of nodes processed by the last solve
+		int getNumIterations();
 
 		void doDummy();
 
@@ -63,31 +192,75 @@ class PointerAnalysis {
 		void addNode(int id);
 		void addEdge(int fromId, int toId);
 		void addToPts(int pointed, int pointee);
+		bool propagateEdge(int fromId, int toId);
+		int prepareNode(int Node, CycleDetection cycles, bool withDiffPropagation,
+			PtsSet& delta, PAWorklist& WorkList);
+		void propagateCopies(int Node, const PtsSet& work, CycleDetection cycles,
+			EdgeSet& checkedEdges, PAWorklist& WorkList);
+		void finishSolve();
+		void freeze();
+		void thaw();
+		void resolveComplex(const PtsSet& pts, const PtsSet& nodeLoads,
+			const PtsSet& nodeStores, bool withDiffPropagation, PAWorklist& NewWorkSet);
 		bool comparePts(int a, int b);
-		void cycleSearch(int source, int target);
+		int findRep(int id);
+		bool detectCycle(int source, int target);
+		void collapseOfflineCycles();
 		void merge(int id, int target);
-		void visit(int Node, IntMap& Order, IntMap& Repr, int& idxOrder,
-			IntSet& Curr, IntDeque& Stack);
-        void removeCycles();
+		int unite(int a, int b);
+		size_t nodeWeight(int id);
+		void topologicalOrder(IntMap& priority);
 
 		// Hold the points-to Set
-		IntSetMap pointsToSet;
+		PtsSetMap pointsToSet;
+
+		// Hold the interned points-to sets of every variable once solved.
+		// While frozen, pointsToSet is empty and the solution is the only
+		// copy; any change to the constraints thaws it back.
+		SharedPtsMap solution;
+		bool frozen;
+		// The solution is the one of solveUnification; thawing just drops it
+		bool unified;
+
+		long memoryBudget;
+		bool overBudget;
+		bool checkMemoryBudget();
+		int numConstraints;
+
+		// Where the added constraints are recorded, if anywhere
+		std::ostream* constraintLog;
+
+		// Hold the part of each points-to set that was already propagated
+		// (only used with difference propagation)
+		PtsSetMap propagatedPts;
+
+		// Hold the constraints and edges a node got from merged nodes,
+		// which still have to see its whole points-to set (difference
+		// propagation only)
+		PtsSetMap freshLoads;
+		PtsSetMap freshStores;
+		PtsSetMap freshEdges;
 
 		// Hold the vertices and their representatives
         IntMap vertices;
+
+		// Hold, for each a found by the offline cycle detection, a variable
+		// every node in pts(a) is in a cycle with
+		IntMap hcdTargets;
 		int numMerged;
 		int numCallsRemove;
+		int numIterations;
 
 		// Hold the active vertices
 		IntSet activeVertices;
 
 		// Hold the graph structure
-        IntSetMap from;
-        IntSetMap to;
+        PtsSetMap from;
+        PtsSetMap to;
 
 		// Hold the complex constraints
-        IntSetMap loads;
-        IntSetMap stores;
+        PtsSetMap loads;
+        PtsSetMap stores;
 };
 
 // ============================================= //
@@ -0,0 +1,382 @@
+#ifndef SPARSE_BIT_SET_H
+#define SPARSE_BIT_SET_H
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <stdint.h>
+
+// ============================================= //
+
+/**
+ * A set of ints stored as a sorted vector of 64-bit words, each one tagged
+ * with the index of the word it represents. Only non-empty words are kept,
+ * so sparse sets stay small and union, difference and comparison work one
+ * word at a time instead of one element at a time.
+ *
+ * The interface mimics the parts of std::set<int> used by the points-to
+ * solver. Iterators remember the element they are on and re-seek when the
+ * word layout changes, so they survive insertions and erasures in the set
+ * they walk, just like std::set iterators do.
+ */
+class SparseBitSet {
+
+    public:
+        class iterator;
+        typedef iterator const_iterator;
+        typedef int value_type;
+
+        SparseBitSet() : layout(0) {}
+
+        // Add x to the set; second is true if it was not there before
+        std::pair<iterator, bool> insert(int x);
+
+        // Remove x from the set; returns the number of removed elements
+        size_t erase(int x);
+
+        iterator find(int x) const;
+        iterator upper_bound(int x) const;
+        size_t count(int x) const;
+        size_t size() const;
+        bool empty() const { return words.empty(); }
+        void clear();
+        void swap(SparseBitSet& other);
+
+        // this = this U other; returns true if this changed
+        bool unionWith(const SparseBitSet& other);
+
+        // this = this - other; returns true if this changed
+        bool subtract(const SparseBitSet& other);
+
+        // this = this & other; returns true if this changed
+        bool intersectWith(const SparseBitSet& other);
+
+        // Whether this and other share an element
+        bool intersects(const SparseBitSet& other) const;
+
+        // Whether every element of other is in this
+        bool includes(const SparseBitSet& other) const;
+
+        // Hash of the contents; equal sets have equal hashes
+        size_t hash() const;
+
+        bool operator==(const SparseBitSet& other) const { return words == other.words; }
+        bool operator!=(const SparseBitSet& other) const { return words != other.words; }
+
+        iterator begin() const;
+        iterator end() const;
+
+        class iterator {
+            public:
+                typedef std::forward_iterator_tag iterator_category;
+                typedef int value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const int* pointer;
+                typedef const int& reference;
+
+                iterator() : set(0), layout(0), word(0), value(0) {}
+
+                const int& operator*() const { return value; }
+
+                iterator& operator++() { advance(); return *this; }
+                iterator operator++(int) { iterator old = *this; advance(); return old; }
+
+                bool operator==(const iterator& other) const {
+                    if (set == 0 || other.set == 0) return set == other.set;
+                    return value == other.value;
+                }
+                bool operator!=(const iterator& other) const { return !(*this == other); }
+
+            private:
+                friend class SparseBitSet;
+
+                iterator(const SparseBitSet* s, size_t w, int v)
+                    : set(s), layout(s->layout), word(w), value(v) {}
+
+                void advance();
+
+                // A null set marks the end iterator
+                const SparseBitSet* set;
+                unsigned layout;
+                size_t word;
+                int value;
+        };
+
+    private:
+        struct Word {
+            int index;
+            uint64_t bits;
+
+            Word(int i, uint64_t b) : index(i), bits(b) {}
+            bool operator==(const Word& other) const {
+                return index == other.index && bits == other.bits;
+            }
+            bool operator!=(const Word& other) const { return !(*this == other); }
+        };
+
+        static int wordIndex(int x) { return x >> 6; }
+        static uint64_t bitMask(int x) { return (uint64_t)1 << (x & 63); }
+
+        // Position of the first word whose index is >= idx
+        size_t lowerBound(int idx) const;
+
+        // First element >= x, starting the search at word w
+        iterator seek(size_t w, int x) const;
+
+        std::vector<Word> words;
+
+        // Bumped whenever words are added or removed, so that live
+        // iterators know their cached word position is stale
+        unsigned layout;
+};
+
+// ============================================= //
+
+inline size_t SparseBitSet::lowerBound(int idx) const
+{
+    size_t lo = 0, hi = words.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (words[mid].index < idx) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+inline SparseBitSet::iterator SparseBitSet::seek(size_t w, int x) const
+{
+    for ( ; w < words.size(); ++w) {
+        if (words[w].index < wordIndex(x)) continue;
+        uint64_t bits = words[w].bits;
+        if (words[w].index == wordIndex(x))
+            bits &= ~(uint64_t)0 << (x & 63);
+        if (bits)
+            return iterator(this, w, words[w].index * 64 + __builtin_ctzll(bits));
+    }
+    return end();
+}
+
+inline std::pair<SparseBitSet::iterator, bool> SparseBitSet::insert(int x)
+{
+    int idx = wordIndex(x);
+    size_t w = lowerBound(idx);
+
+    if (w < words.size() && words[w].index == idx) {
+        bool isNew = (words[w].bits & bitMask(x)) == 0;
+        words[w].bits |= bitMask(x);
+        return std::make_pair(iterator(this, w, x), isNew);
+    }
+
+    words.insert(words.begin() + w, Word(idx, bitMask(x)));
+    layout++;
+    return std::make_pair(iterator(this, w, x), true);
+}
+
+inline size_t SparseBitSet::erase(int x)
+{
+    int idx = wordIndex(x);
+    size_t w = lowerBound(idx);
+
+    if (w == words.size() || words[w].index != idx || !(words[w].bits & bitMask(x)))
+        return 0;
+
+    words[w].bits &= ~bitMask(x);
+    if (words[w].bits == 0) {
+        words.erase(words.begin() + w);
+        layout++;
+    }
+    return 1;
+}
+
+inline SparseBitSet::iterator SparseBitSet::find(int x) const
+{
+    return count(x) ? iterator(this, lowerBound(wordIndex(x)), x) : end();
+}
+
+inline SparseBitSet::iterator SparseBitSet::upper_bound(int x) const
+{
+    if (x == 0x7fffffff) return end();
+    return seek(lowerBound(wordIndex(x + 1)), x + 1);
+}
+
+inline size_t SparseBitSet::count(int x) const
+{
+    size_t w = lowerBound(wordIndex(x));
+    return w < words.size() && words[w].index == wordIndex(x) && (words[w].bits & bitMask(x));
+}
+
+inline size_t SparseBitSet::size() const
+{
+    size_t n = 0;
+    for (size_t w = 0; w < words.size(); ++w)
+        n += __builtin_popcountll(words[w].bits);
+    return n;
+}
+
+inline size_t SparseBitSet::hash() const
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t w = 0; w < words.size(); ++w) {
+        h = (h ^ (uint64_t)(unsigned)words[w].index) * 1099511628211ULL;
+        h = (h ^ words[w].bits) * 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+inline void SparseBitSet::clear()
+{
+    words.clear();
+    layout++;
+}
+
+inline void SparseBitSet::swap(SparseBitSet& other)
+{
+    words.swap(other.words);
+    layout++;
+    other.layout++;
+}
+
+inline bool SparseBitSet::unionWith(const SparseBitSet& other)
+{
+    if (&other == this || other.words.empty()) return false;
+
+    // Fast path: every word of other already has a slot here
+    bool changed = false;
+    size_t i = 0, j = 0;
+    while (j < other.words.size()) {
+        while (i < words.size() && words[i].index < other.words[j].index) i++;
+        if (i == words.size() || words[i].index != other.words[j].index) break;
+        uint64_t merged = words[i].bits | other.words[j].bits;
+        changed |= merged != words[i].bits;
+        words[i].bits = merged;
+        j++;
+    }
+    if (j == other.words.size()) return changed;
+
+    // Slow path: merge both word lists into a new vector
+    std::vector<Word> result;
+    result.reserve(words.size() + other.words.size() - j);
+    i = 0;
+    j = 0;
+    while (i < words.size() || j < other.words.size()) {
+        if (j == other.words.size() || (i < words.size() && words[i].index < other.words[j].index)) {
+            result.push_back(words[i++]);
+        } else if (i == words.size() || other.words[j].index < words[i].index) {
+            result.push_back(other.words[j++]);
+        } else {
+            result.push_back(Word(words[i].index, words[i].bits | other.words[j].bits));
+            i++;
+            j++;
+        }
+    }
+    words.swap(result);
+    layout++;
+    return true;
+}
+
+inline bool SparseBitSet::subtract(const SparseBitSet& other)
+{
+    if (&other == this) {
+        bool changed = !words.empty();
+        clear();
+        return changed;
+    }
+
+    bool changed = false;
+    size_t out = 0, j = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        uint64_t bits = words[i].bits;
+        while (j < other.words.size() && other.words[j].index < words[i].index) j++;
+        if (j < other.words.size() && other.words[j].index == words[i].index)
+            bits &= ~other.words[j].bits;
+        changed |= bits != words[i].bits;
+        if (bits) words[out++] = Word(words[i].index, bits);
+    }
+    if (out != words.size()) {
+        words.erase(words.begin() + out, words.end());
+        layout++;
+    }
+    return changed;
+}
+
+inline bool SparseBitSet::intersectWith(const SparseBitSet& other)
+{
+    if (&other == this) return false;
+
+    bool changed = false;
+    size_t out = 0, j = 0;
+    for (size_t i = 0; i < words.size(); ++i) {
+        while (j < other.words.size() && other.words[j].index < words[i].index) j++;
+        uint64_t bits = 0;
+        if (j < other.words.size() && other.words[j].index == words[i].index)
+            bits = words[i].bits & other.words[j].bits;
+        changed |= bits != words[i].bits;
+        if (bits) words[out++] = Word(words[i].index, bits);
+    }
+    if (out != words.size()) {
+        words.erase(words.begin() + out, words.end());
+        layout++;
+    }
+    return changed;
+}
+
+inline bool SparseBitSet::intersects(const SparseBitSet& other) const
+{
+    size_t i = 0, j = 0;
+    while (i < words.size() && j < other.words.size()) {
+        if (words[i].index < other.words[j].index) i++;
+        else if (other.words[j].index < words[i].index) j++;
+        else if (words[i++].bits & other.words[j++].bits) return true;
+    }
+    return false;
+}
+
+inline bool SparseBitSet::includes(const SparseBitSet& other) const
+{
+    size_t i = 0;
+    for (size_t j = 0; j < other.words.size(); ++j) {
+        while (i < words.size() && words[i].index < other.words[j].index) i++;
+        if (i == words.size() || words[i].index != other.words[j].index) return false;
+        if (other.words[j].bits & ~words[i].bits) return false;
+    }
+    return true;
+}
+
+inline SparseBitSet::iterator SparseBitSet::begin() const
+{
+    if (words.empty()) return end();
+    return iterator(this, 0, words[0].index * 64 + __builtin_ctzll(words[0].bits));
+}
+
+inline SparseBitSet::iterator SparseBitSet::end() const
+{
+    return iterator();
+}
+
+inline void SparseBitSet::iterator::advance()
+{
+    // The set may have gained or lost words since we looked; find our
+    // word again by value in that case
+    if (layout != set->layout) {
+        word = set->lowerBound(wordIndex(value));
+        layout = set->layout;
+    }
+
+    // Stop at the end of the set (the last element can't be incremented)
+    if (value == 0x7fffffff) {
+        set = 0;
+        return;
+    }
+
+    iterator next = set->seek(word, value + 1);
+    if (next.set == 0) set = 0;
+    else {
+        word = next.word;
+        value = next.value;
+    }
+}
+
+// ============================================= //
+
+#endif  /* SPARSE_BIT_SET_H */
@@ -0,0 +1,238 @@
+// Standalone benchmark of the points-to solver. Replays constraint logs
+// written by PADriver (-pa-dump-constraints) or solves synthetic constraint
+// graphs, and reports time, peak memory and solver counters for each run.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "PointerAnalysis.h"
+
+// ============================================= //
+
+struct BenchOptions {
+	unsigned vars;
+	unsigned constraints;
+	double cycles;
+	unsigned seed;
+	unsigned repeat;
+	bool diff;
+	bool substitute;
+	PointerAnalysis::CycleDetection mode;
+	PointerAnalysis::WorklistOrder order;
+	std::vector<std::string> logs;
+};
+
+// ============================================= //
+
+static void usage(const char* prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] [constraint-log ...]\n"
+		"Without logs, a synthetic constraint graph is solved.\n"
+		"  -vars N          variables of the synthetic graph (10000)\n"
+		"  -constraints N   constraints of the synthetic graph (4 x vars)\n"
+		"  -cycles D        fraction of copy edges that may close a cycle (0.1)\n"
+		"  -seed N          seed of the synthetic graph (1)\n"
+		"  -mode M          cycle detection: none, lazy or hybrid (none)\n"
+		"  -order O         worklist order: id, lrf, topo or fifo (id)\n"
+		"  -diff            use difference propagation\n"
+		"  -substitute      run offline variable substitution first\n"
+		"  -repeat N        runs of each workload (1)\n", prog);
+	exit(1);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& opts)
+{
+	opts.vars = 10000;
+	opts.constraints = 0;
+	opts.cycles = 0.1;
+	opts.seed = 1;
+	opts.repeat = 1;
+	opts.diff = false;
+	opts.substitute = false;
+	opts.mode = PointerAnalysis::NoCycleDetection;
+	opts.order = PointerAnalysis::IdOrder;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "-diff") opts.diff = true;
+		else if (arg == "-substitute") opts.substitute = true;
+		else if (arg[0] != '-') opts.logs.push_back(arg);
+		else if (!hasValue) return false;
+		else if (arg == "-vars") opts.vars = atoi(argv[++i]);
+		else if (arg == "-constraints") opts.constraints = atoi(argv[++i]);
+		else if (arg == "-cycles") opts.cycles = atof(argv[++i]);
+		else if (arg == "-seed") opts.seed = atoi(argv[++i]);
+		else if (arg == "-repeat") opts.repeat = atoi(argv[++i]);
+		else if (arg == "-mode")
+		{
+			std::string mode = argv[++i];
+			if (mode == "none") opts.mode = PointerAnalysis::NoCycleDetection;
+			else if (mode == "lazy") opts.mode = PointerAnalysis::LazyCycleDetection;
+			else if (mode == "hybrid") opts.mode = PointerAnalysis::HybridCycleDetection;
+			else return false;
+		}
+		else if (arg == "-order")
+		{
+			std::string order = argv[++i];
+			if (order == "id") opts.order = PointerAnalysis::IdOrder;
+			else if (order == "lrf") opts.order = PointerAnalysis::LRFOrder;
+			else if (order == "topo") opts.order = PointerAnalysis::TopologicalOrder;
+			else if (order == "fifo") opts.order = PointerAnalysis::FIFOOrder;
+			else return false;
+		}
+		else return false;
+	}
+
+	if (opts.vars < 2 || opts.repeat == 0) return false;
+	if (opts.constraints == 0) opts.constraints = 4 * opts.vars;
+	return true;
+}
+
+// ============================================= //
+
+/// xorshift64*, so the synthetic graphs don't depend on the libc rand()
+static uint64_t nextRandom(uint64_t& state)
+{
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
+
+/**
+ * Fill PA with a random constraint graph: a fifth of the constraints are
+ * address-of, half are copies and the rest are loads and stores. Copy
+ * edges go from lower to higher ids, so the graph of copy edges is acyclic,
+ * except for the given fraction of them, which go the other way.
+ */
+static void generateConstraints(const BenchOptions& opts, PointerAnalysis& PA)
+{
+	uint64_t state = opts.seed * 0x9E3779B97F4A7C15ULL + 1;
+	uint64_t cycleThreshold = (uint64_t)(opts.cycles * 1000000);
+
+	for (unsigned i = 0; i < opts.constraints; ++i)
+	{
+		int kind = nextRandom(state) % 20;
+		int A = 1 + nextRandom(state) % opts.vars;
+		int B = 1 + nextRandom(state) % opts.vars;
+
+		if (kind < 4) PA.addAddr(A, B);
+		else if (kind < 14)
+		{
+			if (A == B) continue;
+			bool backwards = nextRandom(state) % 1000000 < cycleThreshold;
+			if ((A < B) != backwards) std::swap(A, B);
+			PA.addBase(A, B);
+		}
+		else if (kind < 17) PA.addLoad(A, B);
+		else PA.addStore(A, B);
+	}
+}
+
+// ============================================= //
+
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/// FNV-1a over the solution, to spot runs that give different results
+static uint64_t solutionHash(PointerAnalysis& PA)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const SharedPtsMap& solution = PA.allPointsTo();
+	for (SharedPtsMap::const_iterator it = solution.begin(); it != solution.end(); ++it)
+	{
+		hash = (hash ^ (uint32_t)it->first) * 1099511628211ULL;
+		for (SharedPts::iterator n = it->second.begin(); n != it->second.end(); ++n)
+			hash = (hash ^ (uint32_t)*n) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Load and solve one workload in a child process, so that the peak memory
+ * reported is the one of this run alone. Returns false if it failed.
+ */
+static bool runWorkload(const BenchOptions& opts, const std::string& log)
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid < 0) return false;
+
+	if (pid == 0)
+	{
+		PointerAnalysis PA;
+		double start = now();
+		if (log.empty()) generateConstraints(opts, PA);
+		else
+		{
+			std::ifstream input(log.c_str());
+			if (!input || !PA.readConstraints(input))
+			{
+				fprintf(stderr, "%s: can't read constraints\n", log.c_str());
+				_exit(1);
+			}
+		}
+		double loaded = now();
+
+		int substituted = opts.substitute ? PA.substituteVariables() : 0;
+		PA.solve(opts.mode, opts.diff, opts.order);
+		double solved = now();
+		uint64_t hash = solutionHash(PA);
+
+		struct rusage ru;
+		getrusage(RUSAGE_SELF, &ru);
+
+		printf("%s: %d vertices, load %.3fs, solve %.3fs, peak %ld kB, "
+			"%d substituted, %d merged, %d cycle searches, %d iterations, hash %016llx\n",
+			log.empty() ? "synthetic" : log.c_str(), PA.getNumVertices(),
+			loaded - start, solved - loaded, ru.ru_maxrss, substituted,
+			PA.getNumOfMertgedVertices(), PA.getNumCallsRemove(),
+			PA.getNumIterations(), (unsigned long long)hash);
+		fflush(stdout);
+		_exit(0);
+	}
+
+	int status;
+	if (waitpid(pid, &status, 0) != pid) return false;
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ============================================= //
+
+int main(int argc, char** argv)
+{
+	BenchOptions opts;
+	if (!parseOptions(argc, argv, opts)) usage(argv[0]);
+
+	std::vector<std::string> workloads = opts.logs;
+	if (workloads.empty())
+	{
+		printf("# synthetic: %u vars, %u constraints, cycle density %g, seed %u\n",
+			opts.vars, opts.constraints, opts.cycles, opts.seed);
+		workloads.push_back("");
+	}
+
+	bool ok = true;
+	for (unsigned w = 0; w < workloads.size(); ++w)
+		for (unsigned r = 0; r < opts.repeat; ++r)
+			ok &= runWorkload(opts, workloads[w]);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,276 @@
+//===------------------------- ModuleMetrics.h ----------------------------===//
+//===----------------------------------------------------------------------===//
+// The size of a module, measured in one linear walk before the expensive
+// analyses run, so that they can pick their algorithms, threads and budgets:
+//
+//   instructions, pointer operations  the loads, stores, GEPs, pointer casts,
+//                                     allocas and memory intrinsics
+//   calls, indirect calls             the call sites with and without a
+//                                     known callee
+//   largest function                  in instructions
+//   largest SCC                       of the call graph of the direct calls,
+//                                     in functions
+//   points-to, range constraints      an estimate of what PADriver and the
+//                                     range analyses will build
+//
+// value-counter reports them. The analyses call ModuleMetrics::compute
+// themselves, since they are built as separate loadable modules, and apply
+// a budget only for the options not given on the command line:
+//
+//   if (depGraphThreads.getNumOccurrences() == 0 && Metrics.isLarge())
+//     Threads = Metrics.suggestedThreads();
+//
+// A pass that walks the module anyway adds a ModuleMetrics::Counter to its
+// ModuleWalk instead, and calls finish() after the walk.
+//
+// Header only and C++03, so that any of the passes can include it.
+//===----------------------------------------------------------------------===//
+#ifndef MODULEMETRICS_H_
+#define MODULEMETRICS_H_
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CallSite.h"
+#include "llvm/Support/raw_ostream.h"
+#include "ModuleWalk.h"
+
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+#include <unistd.h>
+
+namespace llvm {
+
+struct ModuleMetrics {
+  // Modules above these many instructions get the parallel and cheaper
+  // modes of the analyses
+  static const uint64_t LargeModule = 100000;
+  static const uint64_t HugeModule = 1000000;
+
+  uint64_t Functions, Instructions, PointerOps, Calls, IndirectCalls;
+  uint64_t MaxFunctionSize;
+  const Function *LargestFunction;
+  uint64_t LargestSCC, RecursiveSCCs;
+  uint64_t PointsToConstraints, RangeConstraints;
+
+  ModuleMetrics()
+    : Functions(0), Instructions(0), PointerOps(0), Calls(0), IndirectCalls(0),
+      MaxFunctionSize(0), LargestFunction(0), LargestSCC(0), RecursiveSCCs(0),
+      PointsToConstraints(0), RangeConstraints(0) {}
+
+  bool isLarge() const { return Instructions >= LargeModule; }
+  bool isHuge() const { return Instructions >= HugeModule; }
+
+  // The threads worth starting for a large module: the online processors,
+  // up to 8
+  static unsigned suggestedThreads() {
+    long N = sysconf(_SC_NPROCESSORS_ONLN);
+    return N < 1 ? 1 : N > 8 ? 8 : (unsigned)N;
+  }
+
+  // The client of a ModuleWalk that measures the instructions it gets,
+  // which must be every instruction; finish() adds the globals and the call
+  // graph once the walk is over
+  class Counter : public ModuleWalk::Client {
+  public:
+    explicit Counter(ModuleMetrics &R) : R(R), Current(0), Size(0) {}
+
+    virtual void beginFunction(Function &F) {
+      endFunction();
+      Current = &F;
+      Seen.clear();
+      R.Functions++;
+      R.RangeConstraints += F.arg_size();
+    }
+
+    virtual void visit(Instruction &I) {
+      Size++;
+      R.countInstruction(I);
+      // The direct callees of the function, once each
+      ImmutableCallSite CS(&I);
+      if (!CS)
+        return;
+      const Function *Callee = CS.getCalledFunction();
+      if (Callee && !Callee->isDeclaration() && !Seen[Callee]) {
+        Seen[Callee] = true;
+        Callees[Current].push_back(Callee);
+      }
+    }
+
+    void finish(const Module &M) {
+      endFunction();
+      R.countGlobals(M);
+      R.computeSCCs(M, Callees);
+    }
+
+  private:
+    void endFunction() {
+      if (!Current)
+        return;
+      R.Instructions += Size;
+      if (Size > R.MaxFunctionSize) {
+        R.MaxFunctionSize = Size;
+        R.LargestFunction = Current;
+      }
+      Current = 0;
+      Size = 0;
+    }
+
+    ModuleMetrics &R;
+    const Function *Current;
+    uint64_t Size;
+    DenseMap<const Function*, bool> Seen;
+    DenseMap<const Function*, std::vector<const Function*> > Callees;
+  };
+
+  static ModuleMetrics compute(Module &M) {
+    ModuleMetrics R;
+    Counter C(R);
+    ModuleWalk Walk;
+    Walk.add(&C);
+    Walk.run(M);
+    C.finish(M);
+    return R;
+  }
+
+  void print(raw_ostream &OS) const {
+    OS << "==== # of functions:              " << Functions << "\n"
+       << "==== # of instructions:           " << Instructions << "\n"
+       << "==== # of pointer operations:     " << PointerOps << "\n"
+       << "==== # of calls:                  " << Calls << "\n"
+       << "==== # of indirect calls:         " << IndirectCalls << "\n"
+       << "==== largest function:            " << MaxFunctionSize;
+    if (LargestFunction)
+      OS << " (" << LargestFunction->getName() << ")";
+    OS << "\n"
+       << "==== largest call graph SCC:      " << LargestSCC << "\n"
+       << "==== # of recursive SCCs:         " << RecursiveSCCs << "\n"
+       << "==== ~ points-to constraints:     " << PointsToConstraints << "\n"
+       << "==== ~ range constraints:         " << RangeConstraints << "\n";
+  }
+
+private:
+  static bool isPointerOp(const Instruction &I) {
+    return isa<LoadInst>(I) || isa<StoreInst>(I) || isa<GetElementPtrInst>(I) ||
+           isa<AllocaInst>(I) || isa<MemIntrinsic>(I) ||
+           (isa<CastInst>(I) && (I.getType()->isPointerTy() ||
+                                 I.getOperand(0)->getType()->isPointerTy()));
+  }
+
+  // PADriver gives a constraint to each pointer an instruction defines,
+  // reads or writes; the range analyses one to each integer it defines,
+  // and two sigmas to each operand of a conditional branch's comparison
+  void countInstruction(const Instruction &I) {
+    if (isPointerOp(I))
+      PointerOps++;
+
+    if (I.getType()->isPointerTy()) {
+      const PHINode *Phi = dyn_cast<PHINode>(&I);
+      PointsToConstraints += Phi ? Phi->getNumIncomingValues() : 1;
+    } else if (const StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+      if (SI->getValueOperand()->getType()->isPointerTy())
+        PointsToConstraints++;
+    }
+
+    if (I.getType()->isIntegerTy()) {
+      const PHINode *Phi = dyn_cast<PHINode>(&I);
+      RangeConstraints += Phi ? Phi->getNumIncomingValues() : 1;
+    } else if (const BranchInst *BI = dyn_cast<BranchInst>(&I)) {
+      if (BI->isConditional() && isa<ICmpInst>(BI->getCondition()))
+        RangeConstraints += 4;
+    }
+
+    ImmutableCallSite CS(&I);
+    if (!CS || isa<IntrinsicInst>(I))
+      return;
+    Calls++;
+    if (!CS.getCalledFunction())
+      IndirectCalls++;
+    // The actual parameters matched with the formal ones
+    for (ImmutableCallSite::arg_iterator A = CS.arg_begin(),
+         AE = CS.arg_end(); A != AE; ++A) {
+      if ((*A)->getType()->isPointerTy())
+        PointsToConstraints++;
+      if ((*A)->getType()->isIntegerTy())
+        RangeConstraints++;
+    }
+  }
+
+  void countGlobals(const Module &M) {
+    for (Module::const_global_iterator G = M.global_begin(),
+         E = M.global_end(); G != E; ++G) {
+      // The address of the global, and the pointers of its initializer
+      PointsToConstraints++;
+      if (G->hasInitializer() && G->getInitializer()->getType()->isPointerTy())
+        PointsToConstraints++;
+    }
+  }
+
+  // Tarjan's algorithm over the direct calls of Callees, with an explicit
+  // stack so that long call chains don't overflow the native one
+  void computeSCCs(const Module &M,
+      DenseMap<const Function*, std::vector<const Function*> > &Callees) {
+    DenseMap<const Function*, unsigned> Index, Low;
+    DenseMap<const Function*, bool> OnStack;
+    std::vector<const Function*> Stack;
+    // A function and the next of its callees to visit
+    std::vector<std::pair<const Function*, unsigned> > DFS;
+    unsigned Next = 0;
+
+    for (Module::const_iterator Root = M.begin(), E = M.end(); Root != E;
+         ++Root) {
+      if (Root->isDeclaration() || Index.count(Root))
+        continue;
+      DFS.push_back(std::make_pair((const Function*)Root, 0u));
+      while (!DFS.empty()) {
+        const Function *F = DFS.back().first;
+        if (DFS.back().second == 0 && !Index.count(F)) {
+          Index[F] = Low[F] = Next++;
+          Stack.push_back(F);
+          OnStack[F] = true;
+        }
+        std::vector<const Function*> &Succs = Callees[F];
+        if (DFS.back().second < Succs.size()) {
+          const Function *C = Succs[DFS.back().second++];
+          if (!Index.count(C))
+            DFS.push_back(std::make_pair(C, 0u));
+          else if (OnStack[C] && Index[C] < Low[F])
+            Low[F] = Index[C];
+          continue;
+        }
+
+        DFS.pop_back();
+        if (!DFS.empty() && Low[F] < Low[DFS.back().first])
+          Low[DFS.back().first] = Low[F];
+        if (Low[F] != Index[F])
+          continue;
+
+        uint64_t Size = 0;
+        const Function *Member;
+        do {
+          Member = Stack.back();
+          Stack.pop_back();
+          OnStack[Member] = false;
+          Size++;
+        } while (Member != F);
+        if (Size > LargestSCC)
+          LargestSCC = Size;
+        bool SelfCall = false;
+        for (unsigned i = 0; i < Succs.size(); i++)
+          SelfCall |= Succs[i] == F;
+        if (Size > 1 || SelfCall)
+          RecursiveSCCs++;
+      }
+    }
+  }
+};
+
+}
+
+#endif /* MODULEMETRICS_H_ */
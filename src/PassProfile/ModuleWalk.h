@@ -0,0 +1,85 @@
+//===--------------------------- ModuleWalk.h -----------------------------===//
+//===----------------------------------------------------------------------===//
+// One walk over the instructions of a module that feeds several builders,
+// so that a pass needing more than one thing from every instruction reads
+// the IR once instead of once per builder:
+//
+//   ModuleWalk Walk;
+//   Walk.add(&Phis, Instruction::PHI);
+//   Walk.add(&Fields, Instruction::GetElementPtr);
+//   Walk.add(&MetricsCounter);             // every instruction
+//   Walk.run(M);
+//
+// A client gets visit() for the instructions of the opcodes it was added
+// for, in the order of the module, and beginFunction() before the first
+// instruction of each function with a body. The clients of an instruction
+// see it in the order they were added.
+//
+// Header only and C++03, so that any of the passes can include it.
+//===----------------------------------------------------------------------===//
+#ifndef MODULEWALK_H_
+#define MODULEWALK_H_
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace llvm {
+
+class ModuleWalk {
+public:
+  struct Client {
+    virtual ~Client() {}
+    virtual void beginFunction(Function &F) {}
+    virtual void visit(Instruction &I) = 0;
+  };
+
+  ModuleWalk() : ByOpcode(Instruction::OtherOpsEnd) {}
+
+  // C gets the instructions of Opcode
+  void add(Client *C, unsigned Opcode) {
+    addClient(C);
+    ByOpcode[Opcode].push_back(C);
+  }
+
+  // C gets every instruction
+  void add(Client *C) {
+    addClient(C);
+    for (unsigned Op = 0; Op < ByOpcode.size(); ++Op)
+      ByOpcode[Op].push_back(C);
+  }
+
+  bool empty() const { return Clients.empty(); }
+
+  void run(Module &M) {
+    for (Module::iterator F = M.begin(), E = M.end(); F != E; ++F) {
+      if (F->isDeclaration())
+        continue;
+      for (unsigned i = 0; i < Clients.size(); ++i)
+        Clients[i]->beginFunction(*F);
+      for (Function::iterator BB = F->begin(), BE = F->end(); BB != BE; ++BB)
+        for (BasicBlock::iterator I = BB->begin(), IE = BB->end(); I != IE;
+             ++I) {
+          const std::vector<Client*> &Cs = ByOpcode[I->getOpcode()];
+          for (unsigned i = 0; i < Cs.size(); ++i)
+            Cs[i]->visit(*I);
+        }
+    }
+  }
+
+private:
+  void addClient(Client *C) {
+    if (std::find(Clients.begin(), Clients.end(), C) == Clients.end())
+      Clients.push_back(C);
+  }
+
+  std::vector<Client*> Clients;
+  std::vector<std::vector<Client*> > ByOpcode;
+};
+
+}
+
+#endif /* MODULEWALK_H_ */
@@ -0,0 +1,248 @@
+//===------------------------- PassProfile.h ------------------------------===//
+//===----------------------------------------------------------------------===//
+// The instrumentation shared by the passes of this repository: scoped
+// timers, counters and peak resident set samples, kept for the whole opt
+// process and written when it exits.
+//
+//   ECOSOC_PROFILE_JSON=<file>  a JSON summary: the calls and total time of
+//                               each timer, the last value of each counter
+//                               and the peak resident set.
+//   ECOSOC_TRACE=<file>         the timers and counters as Chrome trace
+//                               events (chrome://tracing, Perfetto), one
+//                               timeline for the points-to analysis, the
+//                               dependence graph, the range analyses and the
+//                               instrumentation.
+//
+// Without either variable, timers and counters do nothing but read the
+// environment once. The passes are built as separate loadable modules; opt
+// loads them into the global namespace, so they share the one profile.
+//
+// Usage:
+//   {
+//     PassProfileScope Scope("PADriver::solve", "points-to");
+//     ...
+//   }
+//   PassProfile::get().counter("vertices", "points-to", NumVertices);
+//
+// Header only and C++03, so that any of the passes can include it.
+//===----------------------------------------------------------------------===//
+#ifndef PASSPROFILE_H_
+#define PASSPROFILE_H_
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace llvm {
+
+class PassProfile {
+public:
+  static PassProfile &get() {
+    static PassProfile Profile;
+    return Profile;
+  }
+
+  bool isEnabled() const { return Enabled; }
+
+  // Microseconds since the profile started
+  uint64_t now() const { return wallTime() - Start; }
+
+  // The peak resident set of the process so far, in KB
+  static long peakRSS() {
+    struct rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+    return Usage.ru_maxrss;
+  }
+
+  // A timer of Category named Name ran from Begin to End, in microseconds
+  void addTimer(StringRef Name, StringRef Category, uint64_t Begin,
+                uint64_t End) {
+    if (!Enabled)
+      return;
+    long RSS = peakRSS();
+    Lock L(Mutex);
+    TimerStats &S = Timers[Category.str() + "/" + Name.str()];
+    S.Calls++;
+    S.Total += End - Begin;
+    if (RSS > PeakRSS)
+      PeakRSS = RSS;
+    if (Trace) {
+      Event E = { 'X', Name, Category, Begin, End - Begin, threadID(), RSS };
+      Events.push_back(E);
+    }
+  }
+
+  // Sets the counter Name of Category to Value
+  void counter(StringRef Name, StringRef Category, int64_t Value) {
+    if (!Enabled)
+      return;
+    Lock L(Mutex);
+    Counters[Category.str() + "/" + Name.str()] = Value;
+    if (Trace) {
+      Event E = { 'C', Name, Category, now(), 0, threadID(), Value };
+      Events.push_back(E);
+    }
+  }
+
+  // Records the peak resident set, as a counter of the trace
+  void sampleRSS(StringRef Category) {
+    if (Enabled)
+      counter("peak RSS (KB)", Category, peakRSS());
+  }
+
+  ~PassProfile() {
+    if (!SummaryFile.empty())
+      writeSummary();
+    if (!TraceFile.empty())
+      writeTrace();
+  }
+
+private:
+  struct TimerStats {
+    uint64_t Calls, Total;
+    TimerStats() : Calls(0), Total(0) {}
+  };
+  struct Event {
+    char Phase; // 'X' for a timer, 'C' for a counter
+    std::string Name, Category;
+    uint64_t Begin, Duration;
+    long Thread;
+    int64_t Value; // the counter, or the peak RSS at the end of the timer
+  };
+  struct Lock {
+    pthread_mutex_t &M;
+    Lock(pthread_mutex_t &M) : M(M) { pthread_mutex_lock(&M); }
+    ~Lock() { pthread_mutex_unlock(&M); }
+  };
+
+  bool Enabled, Trace;
+  std::string SummaryFile, TraceFile;
+  uint64_t Start;
+  long PeakRSS;
+  pthread_mutex_t Mutex;
+  std::map<std::string, TimerStats> Timers;
+  std::map<std::string, int64_t> Counters;
+  std::vector<Event> Events;
+
+  PassProfile() : Enabled(false), Trace(false), Start(wallTime()), PeakRSS(0) {
+    pthread_mutex_init(&Mutex, 0);
+    if (const char *File = getenv("ECOSOC_PROFILE_JSON"))
+      SummaryFile = File;
+    if (const char *File = getenv("ECOSOC_TRACE"))
+      TraceFile = File;
+    Trace = !TraceFile.empty();
+    Enabled = Trace || !SummaryFile.empty();
+  }
+
+  static uint64_t wallTime() {
+    struct timeval T;
+    gettimeofday(&T, 0);
+    return (uint64_t)T.tv_sec * 1000000 + T.tv_usec;
+  }
+
+  static long threadID() { return syscall(SYS_gettid); }
+
+  static void writeString(raw_ostream &OS, StringRef S) {
+    OS << '"';
+    for (size_t i = 0, n = S.size(); i != n; i++) {
+      unsigned char C = S[i];
+      if (C == '"' || C == '\\')
+        OS << '\\' << C;
+      else if (C < 0x20)
+        OS << "\\u00" << hexdigit(C >> 4) << hexdigit(C & 15);
+      else
+        OS << C;
+    }
+    OS << '"';
+  }
+
+  static char hexdigit(unsigned X) { return X < 10 ? '0' + X : 'a' + X - 10; }
+
+  void writeSummary() {
+    std::string Error;
+    raw_fd_ostream OS(SummaryFile.c_str(), Error);
+    if (!Error.empty()) {
+      errs() << "Error opening file " << SummaryFile << ": " << Error << "\n";
+      return;
+    }
+    OS << "{\n  \"timers\": {";
+    for (std::map<std::string, TimerStats>::iterator I = Timers.begin(),
+         E = Timers.end(); I != E; ++I) {
+      OS << (I == Timers.begin() ? "\n    " : ",\n    ");
+      writeString(OS, I->first);
+      OS << ": { \"calls\": " << I->second.Calls << ", \"total_us\": "
+         << I->second.Total << " }";
+    }
+    OS << (Timers.empty() ? "}" : "\n  }") << ",\n  \"counters\": {";
+    for (std::map<std::string, int64_t>::iterator I = Counters.begin(),
+         E = Counters.end(); I != E; ++I) {
+      OS << (I == Counters.begin() ? "\n    " : ",\n    ");
+      writeString(OS, I->first);
+      OS << ": " << I->second;
+    }
+    long RSS = peakRSS();
+    OS << (Counters.empty() ? "}" : "\n  }") << ",\n  \"wall_us\": " << now()
+       << ",\n  \"peak_rss_kb\": " << (RSS > PeakRSS ? RSS : PeakRSS)
+       << "\n}\n";
+  }
+
+  void writeTrace() {
+    std::string Error;
+    raw_fd_ostream OS(TraceFile.c_str(), Error);
+    if (!Error.empty()) {
+      errs() << "Error opening file " << TraceFile << ": " << Error << "\n";
+      return;
+    }
+    long PID = getpid();
+    OS << "{ \"traceEvents\": [";
+    for (size_t i = 0, n = Events.size(); i != n; i++) {
+      const Event &E = Events[i];
+      OS << (i ? ",\n" : "\n") << "  { \"name\": ";
+      writeString(OS, E.Name);
+      OS << ", \"cat\": ";
+      writeString(OS, E.Category);
+      OS << ", \"ph\": \"" << E.Phase << "\", \"ts\": " << E.Begin
+         << ", \"pid\": " << PID << ", \"tid\": " << E.Thread;
+      if (E.Phase == 'X')
+        OS << ", \"dur\": " << E.Duration << ", \"args\": { \"peak_rss_kb\": "
+           << E.Value << " } }";
+      else
+        OS << ", \"args\": { \"value\": " << E.Value << " } }";
+    }
+    OS << (Events.empty() ? "]" : "\n]") << ", \"displayTimeUnit\": \"ms\" }\n";
+  }
+};
+
+// Times its scope as a timer of the profile; Name and Category must outlive
+// it, as literals do
+class PassProfileScope {
+public:
+  PassProfileScope(StringRef Name, StringRef Category)
+    : Name(Name), Category(Category),
+      Begin(PassProfile::get().isEnabled() ? PassProfile::get().now() : 0) {}
+
+  ~PassProfileScope() {
+    PassProfile &P = PassProfile::get();
+    if (P.isEnabled())
+      P.addTimer(Name, Category, Begin, P.now());
+  }
+
+private:
+  StringRef Name, Category;
+  uint64_t Begin;
+};
+
+}
+
+#endif /* PASSPROFILE_H_ */
@@ -4,6 +4,10 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Support/CFG.h"
+#include "llvm/Support/GetElementPtrTypeIterator.h"
+#include "llvm/ADT/StringExtras.h"
 
 using namespace llvm;
 
@@ -17,6 +21,8 @@ STATISTIC(NInterestingSets, "Number of alias sets that were divided");
 STATISTIC(NRangedSets, "Number of ranged alias sets found");
 STATISTIC(NNewSets, "Number of alias sets found from the divided");
 STATISTIC(NFinalSets, "Number of final alias sets");
+STATISTIC(NAnnotatedAccesses, "Number of loads and stores tagged with their alias set");
+STATISTIC(NUntaggedSets, "Number of alias sets left untagged, not proven disjoint");
 //Global Variables Declarations
 extern APInt Min;
 extern APInt Max;
@@ -26,32 +32,113 @@ extern APInt Zero;
 * MemRange Support functions
 */
 
-//Finds the MemRange of element in a MemRange set
-RangedAliasSets::MemRange* //Returns
-RangedAliasSets::MemRange::FindByValue //Name
-(Value* element, std::set<MemRange*> MRSet) //Parameters
+//The value of a bound as int64_t, saturating
+int64_t //Returns
+RangedAliasSets::MemRange::toBound //Name
+(const APInt& bound) //Parameters
 {
-	for(std::set<MemRange*>::iterator i = MRSet.begin(), e = MRSet.end(); 
-	i != e;	i++)
-		if(element == (*i)->mem)
-			return *i;
+	if(bound.getMinSignedBits() > 64)
+		return bound.isNegative() ? INT64_MIN : INT64_MAX;
+	return bound.getSExtValue();
+}
+
+bool //Returns
+RangedAliasSets::MemRange::lowerFirst //Name
+(const MemRange* a, const MemRange* b) //Parameters
+{
+	return a->low < b->low;
+}
+
+bool //Returns
+RangedAliasSets::MemRange::higherFirst //Name
+(const MemRange* a, const MemRange* b) //Parameters
+{
+	return a->high < b->high;
+}
+
+//Adds range to a memory range set and to its index
+void //Returns Nothing
+RangedAliasSets::addMemRange //Name
+(std::set<MemRange*>& memSet, llvm::DenseMap<Value*, MemRange*>& memIndex, 
+MemRange* range) //Parameters
+{
+	memSet.insert(range);
+	memIndex[range->mem] = range;
+}
+
+/*
+* Splits the ranges of one memory range set into the elementary intervals
+* that their bounds delimit, from offset 0 on, and adds one ranged alias set
+* per interval with the ranges that cover it. The ranges are swept once in
+* the order of their bounds, so it costs O(n log n) plus the size of the
+* sets it adds.
+*/
+void //Returns Nothing
+RangedAliasSets::splitRanges //Name
+(const std::set<MemRange*>& ranges, int& RangeAliasSets_i) //Parameters
+{
+	//Ranges that end below offset 0 are left out, the others start at 0 at least
+	std::vector<MemRange*> byLower;
+	for (std::set<MemRange*>::const_iterator i = ranges.begin(), e = ranges.end(); 
+	i != e; ++i)
+		if((*i)->high >= 0) byLower.push_back(*i);
+	if(byLower.empty()) return;
+	
+	std::vector<MemRange*> byHigher(byLower);
+	std::sort(byLower.begin(), byLower.end(), MemRange::lowerFirst);
+	std::sort(byHigher.begin(), byHigher.end(), MemRange::higherFirst);
 	
-	return NULL;
+	std::set<MemRange*> active;
+	unsigned next_in = 0, next_out = 0;
+	int64_t lower_range = std::max(byLower[0]->low, (int64_t)0);
+	while(true)
+	{
+		//Ranges that start at lower_range join, ranges that ended leave
+		while(next_in < byLower.size() && byLower[next_in]->low <= lower_range)
+			active.insert(byLower[next_in++]);
+		while(next_out < byHigher.size() && byHigher[next_out]->high < lower_range)
+			active.erase(byHigher[next_out++]);
+		
+		if(active.empty())
+		{
+			//A gap: jump to the next range
+			if(next_in == byLower.size()) break;
+			lower_range = byLower[next_in]->low;
+			continue;
+		}
+		
+		//The interval ends where the first range ends or the next one starts
+		int64_t higher_range = byHigher[next_out]->high;
+		if(next_in < byLower.size() && byLower[next_in]->low - 1 < higher_range)
+			higher_range = byLower[next_in]->low - 1;
+		
+		std::set<MemRange*> rangedMemSet;
+		for (std::set<MemRange*>::iterator ii = active.begin(), ee = active.end(); 
+		ii != ee; ++ii)
+			rangedMemSet.insert(new MemRange((*ii)->mem, APInt(64, lower_range, true), 
+				APInt(64, higher_range, true), (*ii)->aloc));
+		RangeAliasSets[RangeAliasSets_i] = rangedMemSet;
+		RangeAliasSets_i++;
+		
+		if(higher_range == INT64_MAX) break;
+		lower_range = higher_range + 1;
+	}
 }
 
 /*
 * Calculate Primitive Layouts and Number of elements.
 */
 
-//Returns the sum of previous elements of vector
+//Returns the number of primitives before the ith element of a layout
 int 
 RangedAliasSets::getSumBehind
-(std::vector<int> v, int i)
+(const PrimitiveLayout& layout, int i)
 {
-	int s = 0;
-	for(int j = i-1; j >= 0; j--)
-		s += v[j];
-	return s;
+	if(i <= 0)
+		return 0;
+	if(i > layout.count)
+		i = layout.count;
+	return layout.uniform >= 0 ? i * layout.uniform : layout.sums[i];
 }
 
 //Returns the type of the ith element inside type
@@ -76,140 +163,114 @@ int //returns
 RangedAliasSets::getNumPrimitives //Name
 (Type* type) //Parameter
 {
-	//Verifies if this number of primitives was calculated already
-	for(int i = 0; i < NumPrimitives.size(); i++)
-		if(NumPrimitives[i]->type == type)
-			return NumPrimitives[i]->num;
-	
-	//if not
-	int np = 1;
-	if(type->isArrayTy())
-	{
-		int num = type->getArrayNumElements();
-		Type* arrtype = type->getArrayElementType();
-		int arrtypenum = getNumPrimitives(arrtype); 
-		np = num * arrtypenum;
-	}
-	else if(type->isStructTy())
-	{
-		int num = type->getStructNumElements();
-		np = 0;
-		for(int i = 0; i < num; i++)
-		{
-			Type* structelemtype = type->getStructElementType(i);
-			np += getNumPrimitives(structelemtype);
-		}
-	}
-	else if(type->isVectorTy())
-	{
-		int num = type->getVectorNumElements();
-		Type* arrtype = type->getVectorElementType();
-		int arrtypenum = getNumPrimitives(arrtype); 
-		np = num * arrtypenum;
-	}
-	
-	NumPrimitives.insert(NumPrimitives.end(), new NumPrimitive(type, np));
-	return np;
+	return getPrimitiveLayout(type).num;
 }
 
-//Returns a vector with the primitive layout of type
-std::vector<int> //returns
+//Returns the primitive layout of type
+const RangedAliasSets::PrimitiveLayout& //returns
 RangedAliasSets::getPrimitiveLayout //Name
 (Type* type) //Parameter
 {
 	//Verifies if this layout was calculated already
-	for(int i = 0; i < PrimitiveLayouts.size(); i++)
-		if(PrimitiveLayouts[i]->type == type)
-			return PrimitiveLayouts[i]->layout;
+	llvm::DenseMap<Type*, PrimitiveLayout*>::iterator it = PrimitiveLayouts.find(type);
+	if(it != PrimitiveLayouts.end())
+		return *it->second;
 	
-	//if not
-		
-	if(type->isArrayTy())
+	//if not; the layouts of the elements are computed, and cached, first
+	PrimitiveLayout* pl = new PrimitiveLayout();
+	pl->uniform = -1;
+	if(type->isArrayTy() || type->isVectorTy())
 	{
-		int num = type->getArrayNumElements();
-		std::vector<int> pm (num);
-		Type* arrtype = type->getArrayElementType();
-		int arrtypenum = getNumPrimitives(arrtype); 
-		for(int i = 0; i < num; i++)
-			pm[i] = arrtypenum;
-		PrimitiveLayouts.insert(PrimitiveLayouts.end(), new PrimitiveLayout(type, pm));
-		return pm;
+		pl->count = type->isArrayTy() ? type->getArrayNumElements() : 
+			type->getVectorNumElements();
+		Type* elemtype = type->isArrayTy() ? type->getArrayElementType() : 
+			type->getVectorElementType();
+		pl->uniform = getNumPrimitives(elemtype);
+		pl->num = pl->count * pl->uniform;
 	}
 	else if(type->isStructTy())
 	{
-		int num = type->getStructNumElements();
-		std::vector<int> pm (num);
-		for(int i = 0; i < num; i++)
-		{
-			Type* structelemtype = type->getStructElementType(i);
-			pm[i] = getNumPrimitives(structelemtype);
-		}
-		PrimitiveLayouts.insert(PrimitiveLayouts.end(), new PrimitiveLayout(type, pm));
-		return pm;
-	}
-	else if(type->isVectorTy())
-	{
-		int num = type->getVectorNumElements();
-		std::vector<int> pm (num);
-		Type* arrtype = type->getVectorElementType();
-		int arrtypenum = getNumPrimitives(arrtype); 
-		for(int i = 0; i < num; i++)
-			pm[i] = arrtypenum;
-		PrimitiveLayouts.insert(PrimitiveLayouts.end(), new PrimitiveLayout(type, pm));
-		return pm;
+		pl->count = type->getStructNumElements();
+		pl->sums.resize(pl->count + 1, 0);
+		for(int i = 0; i < pl->count; i++)
+			pl->sums[i + 1] = pl->sums[i] + getNumPrimitives(type->getStructElementType(i));
+		pl->num = pl->sums[pl->count];
 	}
 	else
 	{
-		std::vector<int> pm (1);
-		pm[0] = 1;
-		PrimitiveLayouts.insert(PrimitiveLayouts.end(), new PrimitiveLayout(type, pm));
-		return pm;
-	}	
+		pl->count = 1;
+		pl->uniform = 1;
+		pl->num = 1;
+	}
+	
+	PrimitiveLayouts[type] = pl;
+	return *pl;
 }
 
 /*
 * RangedAliasSets Support functions
 */
 
-//Verifies if the instruction verify is present in vector arr
-bool //Returns
-RangedAliasSets::isPresent //Name
-(Instruction* verify, std::vector<Instruction*> arr) //Parameters
+//Numbers the instructions of the module, once
+void //Returns Nothing
+RangedAliasSets::numberInstructions //Name
+(Module* M) //Parameters
 {
-	int i;
-	for(std::vector<Instruction*>::iterator it = arr.begin() ; 
-	it != arr.end(); it++)
-		if(verify == *it) return true;
-	
-	return false;
+	unsigned n = 0;
+	for (Module::iterator F = M->begin(), Fe = M->end(); F != Fe; F++)
+	{
+		if(F->isDeclaration()) continue;
+		
+		//Reverse post order puts definitions before their uses, except
+		//through back edges
+		ReversePostOrderTraversal<Function*> RPOT(F);
+		for (ReversePostOrderTraversal<Function*>::rpo_iterator BB = RPOT.begin(), 
+		BBe = RPOT.end(); BB != BBe; ++BB)
+			for (BasicBlock::iterator I = (*BB)->begin(), E = (*BB)->end(); I != E; ++I)
+				InstructionOrder[I] = n++;
+		
+		//Unreachable blocks go last, in layout order
+		for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+			if(!InstructionOrder.count(&*I))
+				InstructionOrder[&*I] = n++;
+	}
+}
+
+namespace {
+	//Compares instructions by their position in the module
+	struct InstructionOrderLess
+	{
+		const llvm::DenseMap<const Instruction*, unsigned>& order;
+		InstructionOrderLess(const llvm::DenseMap<const Instruction*, unsigned>& o) : order(o) {}
+		bool operator()(const Instruction* a, const Instruction* b) const
+		{
+			return order.lookup(a) < order.lookup(b);
+		}
+	};
 }
 
 //Takes a vector of instructions (ptr) and orders them
 std::vector<Instruction*> //Returns
 RangedAliasSets::orderInstructions //name
-(std::vector<Instruction*> unordered, Module* M) //Parameters
+(const std::vector<Instruction*>& unordered, Module* M) //Parameters
 {
-	std::vector<Instruction*> ordered(unordered.size());
-	int i = 0;
-	for (Module::iterator F = M->begin(), Fe = M->end(); F != Fe; F++)
-		for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
-			if(isPresent(&(*I), unordered)){
-				ordered[i] = &(*I);
-				i++;
-			}
+	if(InstructionOrder.empty())
+		numberInstructions(M);
 	
+	std::vector<Instruction*> ordered(unordered);
+	std::sort(ordered.begin(), ordered.end(), InstructionOrderLess(InstructionOrder));
 	return ordered;
 }
 
 //methods that return the persistent maps
-llvm::DenseMap<int, std::set<RangedAliasSets::MemRange*> > //Returns
+const llvm::DenseMap<int, std::set<RangedAliasSets::MemRange*> >& //Returns
 RangedAliasSets::getRangedAliasSets //Name
 () //No parameters
 {
 	return RangeAliasSets;
 }
 
-llvm::DenseMap<int, std::set<Value*> > //Returns 
+const llvm::DenseMap<int, std::set<Value*> >& //Returns 
 RangedAliasSets::getAliasSets //Name
 () //No parameters
 {
@@ -242,13 +303,13 @@ RangedAliasSets::printRangeAnalysis //Name
 
 void //Returns Nothing 
 RangedAliasSets::printAliasSets //Name
-(llvm::DenseMap<int, std::set<Value*> > *AliasSets) //Parameters
+(const llvm::DenseMap<int, std::set<Value*> > *AliasSets) //Parameters
 {
 	errs() << "Alias Sets:" << "\n";
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = AliasSets->begin(), e = AliasSets->end(); 
+	for (llvm::DenseMap<int, std::set<Value*> >::const_iterator i = AliasSets->begin(), e = AliasSets->end(); 
 	i != e; ++i) {
 		  errs() << "Set " << i->first << " : size? "<< i->second.size() <<"\n";
-        for (std::set<Value*>::iterator ii = i->second.begin(), ee = i->second.end(); 
+        for (std::set<Value*>::const_iterator ii = i->second.begin(), ee = i->second.end(); 
         ii != ee; ++ii) {
 
             errs() << "	" << **ii <<"  inst? " << isa<Instruction>(**ii) << "\n";
@@ -262,13 +323,13 @@ RangedAliasSets::printAliasSets //Name
 
 void //Returns Nothing 
 RangedAliasSets::printInterestingSets //Name
-(llvm::DenseMap<int, std::set<Value*> > *InterestingSets) //Parameters
+(llvm::DenseMap<int, const std::set<Value*>*> *InterestingSets) //Parameters
 {
 	errs() << "Insteresting Sets:" << "\n";	
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = InterestingSets->begin(), e = InterestingSets->end(); 
+	for (llvm::DenseMap<int, const std::set<Value*>*>::iterator i = InterestingSets->begin(), e = InterestingSets->end(); 
 	i != e; ++i) {
         errs() << "Set " << i->first << "\n";
-        for (std::set<Value*>::iterator ii = i->second.begin(), ee = i->second.end(); 
+        for (std::set<Value*>::const_iterator ii = i->second->begin(), ee = i->second->end(); 
         ii != ee; ++ii) {
 
             errs() << "	" << **ii << "\n";
@@ -353,14 +414,15 @@ RangedAliasSets::printNewAliasSets //Name
 
 void //Returns Nothing 
 RangedAliasSets::printPrimitiveLayouts //Name
-(std::vector<PrimitiveLayout*> PrimitiveLayouts) //Parameters
+() //No parameters
 {
 	errs() << "\n-------------------------\nPrimitive Layouts:" << "\n";
-	for(int i = 0; i < PrimitiveLayouts.size(); i++)
+	for (llvm::DenseMap<Type*, PrimitiveLayout*>::iterator i = PrimitiveLayouts.begin(), 
+	e = PrimitiveLayouts.end(); i != e; ++i)
 	{
-		errs() << *(PrimitiveLayouts[i]->type) << ":\n";
-		for(int j = 0; j < PrimitiveLayouts[i]->layout.size(); j++)
-			errs() << PrimitiveLayouts[i]->layout[j] << "  ";
+		errs() << *(i->first) << ":\n";
+		for(int j = 0; j < i->second->count; j++)
+			errs() << getSumBehind(*i->second, j + 1) - getSumBehind(*i->second, j) << "  ";
 		errs() << "\n";
 	}
 	
@@ -392,9 +454,9 @@ RangedAliasSets::runOnModule //Name
 	*/
 	
 	AliasSets &AS = getAnalysis<AliasSets>();
-	llvm::DenseMap<int, std::set<Value*> > AliasSets = AS.getValueSets();
+	const llvm::DenseMap<int, std::set<Value*> > &AliasSets = AS.getValueSets();
 	NAliasSets = 0;//statistics
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = AliasSets.begin(), e = AliasSets.end(); 
+	for (llvm::DenseMap<int, std::set<Value*> >::const_iterator i = AliasSets.begin(), e = AliasSets.end(); 
 	i != e; ++i) if(i->second.size() > 0) NAliasSets++;
 	DEBUG(printAliasSets(&AliasSets));
 		
@@ -404,11 +466,12 @@ RangedAliasSets::runOnModule //Name
 	* element, all it's elements must be Instructions	.
 	*/	
 	
-	llvm::DenseMap<int, std::set<Value*> > InterestingSets;
+	//The interesting sets, pointing into AliasSets
+	llvm::DenseMap<int, const std::set<Value*>*> InterestingSets;
 	int set_number = 0;
 	
 	//Checking for apropriate sets for each alias set
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = AliasSets.begin(), 
+	for (llvm::DenseMap<int, std::set<Value*> >::const_iterator i = AliasSets.begin(), 
 	e = AliasSets.end(); i != e; ++i){
 		//if size of set less or equal to 1 element, not interesting set
 		if(i->second.size() <= 1) continue;
@@ -416,7 +479,7 @@ RangedAliasSets::runOnModule //Name
 		int alloca_count = 0;
 		bool non_valid = false;
 		//foreach element of the set
-		for (std::set<Value*>::iterator ii = i->second.begin(), 
+		for (std::set<Value*>::const_iterator ii = i->second.begin(), 
 		ee = i->second.end(); ii != ee; ++ii){
 			//if element is no an Instruction
 			if(!isa<Instruction>(**ii)){
@@ -439,7 +502,7 @@ RangedAliasSets::runOnModule //Name
 		//if all rules are valid, this is an interesting set
 		if(alloca_count == 1 and non_valid == false){
     	set_number++;
-    	InterestingSets[set_number] = i->second;
+    	InterestingSets[set_number] = &i->second;
     }
 	}
 	DEBUG(printInterestingSets(&InterestingSets));
@@ -451,11 +514,11 @@ RangedAliasSets::runOnModule //Name
 	llvm::DenseMap<int, std::vector<Instruction*> > InterestingVectors;
 	int InterestingVectors_i = 1;
 	
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = InterestingSets.begin(), 
+	for (llvm::DenseMap<int, const std::set<Value*>*>::iterator i = InterestingSets.begin(), 
 	e = InterestingSets.end(); i != e; ++i){
-		std::vector<Instruction*> unordered(i->second.size());
+		std::vector<Instruction*> unordered(i->second->size());
 		int vector_i = 0;
-		for (std::set<Value*>::iterator ii = i->second.begin(), ee = i->second.end(); 
+		for (std::set<Value*>::const_iterator ii = i->second->begin(), ee = i->second->end(); 
       ii != ee; ++ii){ 
       	unordered[vector_i] = (Instruction*) *ii;
       	vector_i++;
@@ -479,6 +542,8 @@ RangedAliasSets::runOnModule //Name
 	{
 		bool error = false;
 		std::set<MemRange*> memSet;
+		//The MemRange of each value in memSet
+		llvm::DenseMap<Value*, MemRange*> memIndex;
 		Value * base_aloc;
 		Type * base_type;
 		//For each instruction in the current interesting vector
@@ -491,7 +556,7 @@ RangedAliasSets::runOnModule //Name
 	   		//Mem Range [0,0]
 	   		base_aloc = *ii;
 	   		base_type = base_aloc->getType();
-     		memSet.insert(new MemRange(*ii, Zero, Zero, base_aloc));
+     		addMemRange(memSet, memIndex, new MemRange(*ii, Zero, Zero, base_aloc));
       }
 			else if(isa<CallInst>(**ii))
 			{
@@ -501,14 +566,14 @@ RangedAliasSets::runOnModule //Name
    			{
 	 				base_aloc = *ii;
 	   			base_type = base_aloc->getType();
-	 				memSet.insert(new MemRange(*ii, Zero, Zero, base_aloc));
+	 				addMemRange(memSet, memIndex, new MemRange(*ii, Zero, Zero, base_aloc));
 				}
 			}
 			else if(isa<GetElementPtrInst>(**ii))
 			{
       	//Mem Range basePtrMemRange + indexes range
        	Value* base_ptr = ((GetElementPtrInst*)*ii)->getPointerOperand();
-       	MemRange* base_range = MemRange::FindByValue(base_ptr, memSet);
+       	MemRange* base_range = memIndex.lookup(base_ptr);
        	if(base_range == NULL)
        	{
        		error = true;
@@ -523,7 +588,7 @@ RangedAliasSets::runOnModule //Name
        	* 
        	if(base_ptr->getType() != base_type)
        	{
-       		memSet.insert(new MemRange(*ii,base_range->lower,base_range->higher, base_aloc));
+       		addMemRange(memSet, memIndex, new MemRange(*ii,base_range->lower,base_range->higher, base_aloc));
        		continue;
        	}
        	/*-----------------------------------------------------------------*/
@@ -601,7 +666,7 @@ RangedAliasSets::runOnModule //Name
        	{
        		//Calculating Primitive Layout
        		base_ptr_type = getTypeInside(base_ptr_type, index.getSExtValue());
-     			std::vector<int> base_ptr_primitive_layout = getPrimitiveLayout(base_ptr_type);
+     			const PrimitiveLayout& base_ptr_primitive_layout = getPrimitiveLayout(base_ptr_type);
      			
      			Value* indx = idx->get();
         	if(isa<ConstantInt>(*indx))
@@ -662,13 +727,18 @@ RangedAliasSets::runOnModule //Name
 		     	}
        	}
          	
-      	memSet.insert(new MemRange(*ii,lower_range,higher_range, base_aloc));
+      	addMemRange(memSet, memIndex, new MemRange(*ii,lower_range,higher_range, base_aloc));
 			}
       else if(isa<BitCastInst>(**ii))
       {
        	Value* base_ptr = (*ii)->getOperand(0);
-       	MemRange* base_range = MemRange::FindByValue(base_ptr, memSet);
-       	memSet.insert(new MemRange(*ii,base_range->lower,base_range->higher, base_aloc));
+       	MemRange* base_range = memIndex.lookup(base_ptr);
+       	if(base_range == NULL)
+       	{
+       		error = true;
+       		break;
+       	}
+       	addMemRange(memSet, memIndex, new MemRange(*ii,base_range->lower,base_range->higher, base_aloc));
       }
       else //Any other instruction
       {
@@ -695,57 +765,7 @@ RangedAliasSets::runOnModule //Name
 	int RangeAliasSets_i = 1;
 	for (llvm::DenseMap<int, std::set<MemRange*> >::iterator i = MemRangeSets.begin(), e = MemRangeSets.end(); 
 	i != e; ++i)
-	{
-		APInt MinusOne = Zero;
-		MinusOne--;
-		APInt One = Zero;
-		One++;
-		APInt lower_range = MinusOne;
-		APInt higher_range = MinusOne;
-		while(true)
-		{
-			std::set<MemRange*> rangedMemSet;
-			//Calculating new lower range
-			APInt new_lower_range = Max;
-			for (std::set<MemRange*>::iterator ii = i->second.begin(), ee = i->second.end(); 
-	    ii != ee; ++ii)
-	    {
-	     	if((*ii)->higher.sle(higher_range)){
-	     		i->second.erase(*ii);
-	     		continue;
-	     	}
-	     	else{
-	     		if((*ii)->lower.sle(higher_range)) new_lower_range = higher_range + One;
-	     		else if((*ii)->lower.slt(new_lower_range)) new_lower_range = (*ii)->lower;
-	     	}
-	    }
-	    lower_range = new_lower_range;
-	    //Calculating new higher range
-	    APInt new_higher_range1 = Max;
-			APInt new_higher_range2 = Max;
-			for (std::set<MemRange*>::iterator ii = i->second.begin(), ee = i->second.end(); 
-	    ii != ee; ++ii)
-	    {
-	     	if((*ii)->higher.slt(new_higher_range1))new_higher_range1 = (*ii)->higher;
-	      	
-	     	if((*ii)->lower.sgt(lower_range) and (*ii)->lower.slt(new_higher_range2)) 
-	     		new_higher_range2 = (*ii)->lower - One;
-	    }
-	    higher_range = new_higher_range1.slt(new_higher_range2) ? new_higher_range1 : new_higher_range2;
-	    if(i->second.empty()) break;
-	    //Add members
-			for (std::set<MemRange*>::iterator ii = i->second.begin(), ee = i->second.end(); 
-      ii != ee; ++ii)
-      {
-      	if((*ii)->lower.sle(higher_range))
-      	{
-      		rangedMemSet.insert(new MemRange((*ii)->mem, lower_range, higher_range,(*ii)->aloc) );		
-      	}
-      }
-      RangeAliasSets[RangeAliasSets_i] = rangedMemSet;
-      RangeAliasSets_i++;
-    }
- 	}
+		splitRanges(i->second, RangeAliasSets_i);
  	NRangedSets = RangeAliasSets.size();//statistics
 	DEBUG(printRangeAliasSets(&RangeAliasSets));
 	
@@ -781,30 +801,31 @@ RangedAliasSets::runOnModule //Name
 	}
 	NNewSets = NewAliasSets.size();//statistics
 	////adding undivided sets
-	for(int i = 1; i <= InterestingSets.size(); i++)
-	{
-		for(int j = 1; j <= AliasSets.size(); j++)
-		{
-			if(InterestingSets[i] == AliasSets[j])
-				AliasSets.erase(j);
-		}
-	}
+	std::set<const std::set<Value*>*> DividedSets;
+	for (llvm::DenseMap<int, const std::set<Value*>*>::iterator i = InterestingSets.begin(), 
+	e = InterestingSets.end(); i != e; ++i)
+		DividedSets.insert(i->second);
 	
-	for(int i = 1; i <= AliasSets.size(); i++)
+	for(int i = 1; i <= (int)AliasSets.size(); i++)
 	{
-		if(!AliasSets[i].empty())
+		llvm::DenseMap<int, std::set<Value*> >::const_iterator Set = AliasSets.find(i);
+		if(Set != AliasSets.end() && !Set->second.empty() && !DividedSets.count(&Set->second))
 		{
 			newi++;
-			NewAliasSets[newi] = AliasSets[i];
+			NewAliasSets[newi] = Set->second;
 		}
 	}
 	NFinalSets = NewAliasSets.size();//statistics
 	DEBUG(printNewAliasSets(&NewAliasSets));
 
+	//For the clients of AliasSets that can use the split sets, such as the
+	//dependence graph with -depgraph-split-mem
+	AS.setRangedSets(NewAliasSets);
+
 	/*
 	* Done, end of analysis
 	*/
-	DEBUG(printPrimitiveLayouts(PrimitiveLayouts));
+	DEBUG(printPrimitiveLayouts());
 	
 }
 
@@ -822,4 +843,201 @@ RangedAliasSets::getAnalysisUsage //Name
 }
 char RangedAliasSets::ID = 0;
 static RegisterPass<RangedAliasSets> X("ranged-alias-sets",
-"Get alias sets with memory range from pointer analysis pass", false, false);
\ No newline at end of file
+"Get alias sets with memory range from pointer analysis pass", false, false);
+/*
+* Annotation of the loads and stores
+*/
+
+//Walks Ptr back through GEPs and bitcasts to its allocation, adding the
+//DataLayout offset of every index; for the indexes that aren't constant it
+//takes the range from the range analysis
+bool //Returns
+RangedAliasAnnotate::getByteRange //Name
+(Value* Ptr, uint64_t Size, const DataLayout& DL, 
+InterProceduralRA<Cousot>& ra, Value*& Base, int64_t& Lo, int64_t& Hi) //Parameters
+{
+	//Larger indexes, element sizes and offsets count as unknown, so the sums
+	//below can't overflow
+	const int64_t IndexBound = INT64_C(1) << 31;
+	const int64_t OffsetBound = INT64_C(1) << 40;
+	
+	Lo = 0;
+	Hi = 0;
+	Value* V = Ptr;
+	while(true)
+	{
+		if(isa<BitCastInst>(V))
+		{
+			V = cast<BitCastInst>(V)->getOperand(0);
+			continue;
+		}
+		GetElementPtrInst* GEP = dyn_cast<GetElementPtrInst>(V);
+		if(GEP == NULL) break;
+		
+		for (gep_type_iterator T = gep_type_begin(GEP), TE = gep_type_end(GEP); T != TE; ++T)
+		{
+			Value* indx = T.getOperand();
+			if(StructType* STy = dyn_cast<StructType>(*T))
+			{
+				int64_t offset = DL.getStructLayout(STy)->getElementOffset(
+					cast<ConstantInt>(indx)->getZExtValue());
+				Lo += offset;
+				Hi += offset;
+			}
+			else
+			{
+				APInt rl, ru;
+				if(isa<ConstantInt>(indx))
+					rl = ru = cast<ConstantInt>(indx)->getValue();
+				else
+				{
+					Range r = ra.getRange(indx);
+					if(r.isUnknown()) return false;
+					rl = r.getLower();
+					ru = r.getUpper();
+				}
+				//Also catches the infinite bounds
+				if(rl.getMinSignedBits() > 32 || ru.getMinSignedBits() > 32) return false;
+				int64_t size = DL.getTypeAllocSize(T.getIndexedType());
+				if(size > IndexBound) return false;
+				Lo += size * rl.getSExtValue();
+				Hi += size * ru.getSExtValue();
+			}
+			if(Lo < -OffsetBound || Hi > OffsetBound) return false;
+		}
+		V = GEP->getPointerOperand();
+	}
+	
+	//The allocations that RangedAliasSets starts its ranges at
+	if(isa<CallInst>(V))
+	{
+		Function* F = cast<CallInst>(V)->getCalledFunction();
+		if(F == NULL or (F->getName() != "malloc" and F->getName() != "calloc" 
+		and F->getName() != "realloc"))
+			return false;
+	}
+	else if(!isa<AllocaInst>(V) and !isa<GlobalVariable>(V))
+		return false;
+	
+	Base = V;
+	Hi += Size;
+	return true;
+}
+
+bool //Returns
+RangedAliasAnnotate::runOnModule //Name
+(Module &M) //Parameters
+{
+	//Byte offsets need the target layout
+	DataLayout* DL = getAnalysisIfAvailable<DataLayout>();
+	if(DL == NULL) return false;
+	
+	RangedAliasSets &RAS = getAnalysis<RangedAliasSets>();
+	InterProceduralRA<Cousot> &ra = getAnalysis<InterProceduralRA<Cousot> >();
+	const llvm::DenseMap<int, std::set<Value*> > &Sets = RAS.getAliasSets();
+	if(Sets.size() < 2) return false;
+	
+	//The set of each value, or -1 if it is in more than one
+	llvm::DenseMap<Value*, int> SetOf;
+	for (llvm::DenseMap<int, std::set<Value*> >::const_iterator i = Sets.begin(), e = Sets.end(); 
+	i != e; ++i)
+		for (std::set<Value*>::const_iterator ii = i->second.begin(), ee = i->second.end(); 
+		ii != ee; ++ii)
+		{
+			std::pair<llvm::DenseMap<Value*, int>::iterator, bool> it = 
+				SetOf.insert(std::make_pair(*ii, i->first));
+			if(!it.second && it.first->second != i->first)
+				it.first->second = -1;
+		}
+	
+	//The accesses of the sets, and the bytes they touch in each allocation
+	std::vector<std::pair<Instruction*, int> > Accesses;
+	llvm::DenseMap<Value*, std::vector<ByteRange> > RangesOf;
+	//Sets that aren't proven disjoint from the others
+	std::set<int> Untagged;
+	for (Module::iterator F = M.begin(), Fe = M.end(); F != Fe; ++F)
+		for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I)
+		{
+			Value *Ptr;
+			Type *AccessType;
+			if(LoadInst *LI = dyn_cast<LoadInst>(&*I))
+			{
+				Ptr = LI->getPointerOperand();
+				AccessType = LI->getType();
+			}
+			else if(StoreInst *SI = dyn_cast<StoreInst>(&*I))
+			{
+				Ptr = SI->getPointerOperand();
+				AccessType = SI->getValueOperand()->getType();
+			}
+			else
+				continue;
+			
+			if(I->getMetadata(LLVMContext::MD_tbaa)) continue;
+			llvm::DenseMap<Value*, int>::iterator it = SetOf.find(Ptr);
+			if(it == SetOf.end() || it->second < 0) continue;
+			
+			Value *Base;
+			ByteRange R;
+			R.set = it->second;
+			if(!getByteRange(Ptr, DL->getTypeStoreSize(AccessType), *DL, ra, Base, R.lo, R.hi))
+			{
+				Untagged.insert(R.set);
+				continue;
+			}
+			RangesOf[Base].push_back(R);
+			Accesses.push_back(std::make_pair(&*I, R.set));
+		}
+	
+	//Sets whose bytes overlap in an allocation
+	for (llvm::DenseMap<Value*, std::vector<ByteRange> >::iterator i = RangesOf.begin(), 
+	e = RangesOf.end(); i != e; ++i)
+	{
+		const std::vector<ByteRange> &Ranges = i->second;
+		for (unsigned a = 0; a < Ranges.size(); a++)
+			for (unsigned b = a + 1; b < Ranges.size(); b++)
+				if(Ranges[a].set != Ranges[b].set 
+				&& Ranges[a].lo < Ranges[b].hi && Ranges[b].lo < Ranges[a].hi)
+				{
+					Untagged.insert(Ranges[a].set);
+					Untagged.insert(Ranges[b].set);
+				}
+	}
+	NUntaggedSets += Untagged.size();
+	
+	//One TBAA type per set; siblings under the same root don't alias
+	LLVMContext &C = M.getContext();
+	MDNode *Root = MDNode::get(C, MDString::get(C, "ranged alias sets"));
+	llvm::DenseMap<int, MDNode*> Tags;
+	
+	bool changed = false;
+	for (std::vector<std::pair<Instruction*, int> >::iterator i = Accesses.begin(), 
+	e = Accesses.end(); i != e; ++i)
+	{
+		if(Untagged.count(i->second)) continue;
+		
+		MDNode *&Tag = Tags[i->second];
+		if(!Tag)
+		{
+			Value *Ops[] = { MDString::get(C, "set " + utostr(i->second)), Root };
+			Tag = MDNode::get(C, Ops);
+		}
+		i->first->setMetadata(LLVMContext::MD_tbaa, Tag);
+		NAnnotatedAccesses++;
+		changed = true;
+	}
+	
+	return changed;
+}
+
+void //Returns nothing
+RangedAliasAnnotate::getAnalysisUsage //Name
+(AnalysisUsage &AU) const //Parameters
+{
+	AU.addRequired<RangedAliasSets>();
+	AU.addRequired<InterProceduralRA<Cousot> >();
+	AU.setPreservesCFG();
+}
+char RangedAliasAnnotate::ID = 0;
+static RegisterPass<RangedAliasAnnotate> Y("ranged-alias-annotate",
+"Tag loads and stores with TBAA metadata of their ranged alias set", false, false);
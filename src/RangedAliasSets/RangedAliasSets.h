@@ -4,11 +4,15 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/DataLayout.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/STLExtras.h"
 #include <set>
+#include <algorithm>
+#include <stdint.h>
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
@@ -21,41 +25,35 @@ namespace llvm {
 
 class RangedAliasSets: public ModulePass{
 	private:
-	//Verifies if the instruction verify is present in vector arr
-	bool 
-		isPresent
-			(Instruction* verify, std::vector<Instruction*> arr);
+	//Position of every instruction of the module: functions in module
+	//order, blocks in reverse post order, then instructions in their block
+	llvm::DenseMap<const Instruction*, unsigned> InstructionOrder;
+	void 
+		numberInstructions
+			(Module* M);
 	//Takes a vector of instructions (ptr) and orders them
 	std::vector<Instruction*>
 		orderInstructions
-			(std::vector<Instruction*> unordered, Module* M);
-	//Holds a Primitive Layout for a determined Type
+			(const std::vector<Instruction*>& unordered, Module* M);
+	//Holds the Primitive Layout of a determined Type: how many primitive
+	//elements it flattens to, and how many come before each of its elements
 	struct PrimitiveLayout
 	{
-		Type * type;
-		std::vector<int> layout;
-		PrimitiveLayout(Type* ty, std::vector<int> lay)
-		{
-			type = ty;
-			layout = lay;
-		}
-	};
-	struct NumPrimitive
-	{
-		Type * type;
 		int num;
-		NumPrimitive(Type* ty, int n)
-		{
-			type = ty;
-			num = n;
-		}
+		//Number of elements: 1 for a primitive
+		int count;
+		//Primitives of each element of an array or vector, or -1
+		int uniform;
+		//Prefix sums of the element sizes of a struct: sums[i] primitives
+		//come before element i
+		std::vector<int> sums;
 	};
-	std::vector<PrimitiveLayout*> PrimitiveLayouts;
-	std::vector<NumPrimitive*> NumPrimitives;
-	std::vector<int> getPrimitiveLayout(Type* type);
+	//Computed once per type, for the whole module
+	llvm::DenseMap<Type*, PrimitiveLayout*> PrimitiveLayouts;
+	const PrimitiveLayout& getPrimitiveLayout(Type* type);
 	int getNumPrimitives(Type* type);
 	llvm::Type* getTypeInside(Type* type, int i);
-	int getSumBehind(std::vector<int> v, int i);
+	int getSumBehind(const PrimitiveLayout& layout, int i);
 	//Holds a memory range for a determined Value
 	struct MemRange 
 	{
@@ -63,13 +61,23 @@ class RangedAliasSets: public ModulePass{
 		Value* aloc;
 		APInt lower;
 		APInt higher;
+		//The bounds as int64_t, saturating, for the overlap sweep
+		int64_t low;
+		int64_t high;
 		MemRange(Value* Mem, APInt Lower, APInt Higher, Value* Aloc){
 			mem = Mem; lower = Lower; higher = Higher; aloc = Aloc;
+			low = toBound(lower); high = toBound(higher);
 		}
-		//Finds the MemRange of element in a MemRange set
-		static MemRange* 
-			FindByValue
-				(Value* element, std::set<MemRange*> MRSet);
+		static int64_t
+			toBound
+				(const APInt& bound);
+		//Orders by lower and by higher bound
+		static bool
+			lowerFirst
+				(const MemRange* a, const MemRange* b);
+		static bool
+			higherFirst
+				(const MemRange* a, const MemRange* b);
 	};
 	//Persistent maps
 	llvm::DenseMap<int, std::set<MemRange*> > MemRangeSets;
@@ -77,23 +85,63 @@ class RangedAliasSets: public ModulePass{
 	llvm::DenseMap<int, std::set<Value*> > NewAliasSets;
 	//Methods for debugging
 	void printRangeAnalysis(InterProceduralRA<Cousot> *ra, Module *M);
-	void printAliasSets(llvm::DenseMap<int, std::set<Value*> > *AliasSets);
-	void printInterestingSets(llvm::DenseMap<int, std::set<Value*> > *InterestingSets);
+	void printAliasSets(const llvm::DenseMap<int, std::set<Value*> > *AliasSets);
+	void printInterestingSets(llvm::DenseMap<int, const std::set<Value*>*> *InterestingSets);
 	void printInterestingVectors(llvm::DenseMap<int, std::vector<Instruction*> > *InterestingVectors);
 	void printMemRanges(llvm::DenseMap<int, std::set<MemRange*> > *MemRangeSets);
 	void printRangeAliasSets(llvm::DenseMap<int, std::set<MemRange*> > *RangedAliasSets);
 	void printNewAliasSets(llvm::DenseMap<int, std::set<Value*> > *NewAliasSets);
-	void printPrimitiveLayouts(std::vector<PrimitiveLayout*> PrimitiveLayouts);
+	void printPrimitiveLayouts();
+	//Adds range to a memory range set and to its index by value
+	static void addMemRange(std::set<MemRange*>& memSet, 
+		llvm::DenseMap<Value*, MemRange*>& memIndex, MemRange* range);
+	//Splits a memory range set into the sets of RangeAliasSets
+	void splitRanges(const std::set<MemRange*>& ranges, int& RangeAliasSets_i);
 	
 	public:
 	//LLVM framework methods and atributes
 	static char ID;
 	RangedAliasSets() : ModulePass(ID) {}
+	~RangedAliasSets() { DeleteContainerSeconds(PrimitiveLayouts); }
 	bool runOnModule(Module &M);
 	void getAnalysisUsage(AnalysisUsage &AU) const;
 	//methods that return the persistent maps
-	llvm::DenseMap<int, std::set<MemRange*> > getRangedAliasSets();
-	llvm::DenseMap<int, std::set<Value*> > getAliasSets();
+	const llvm::DenseMap<int, std::set<MemRange*> >& getRangedAliasSets();
+	const llvm::DenseMap<int, std::set<Value*> >& getAliasSets();
+};
+
+/*
+* Tags the loads and stores whose pointer lies in exactly one of the final
+* ranged alias sets with a TBAA node of its own, one per set, all siblings
+* under one root: the alias analyses that read TBAA, and through them LICM,
+* GVN and the loop vectorizer, then take accesses of different sets as
+* disjoint. Accesses that already have a TBAA tag keep it.
+* The ranges of RangedAliasSets count primitives and keep the range of the
+* base for unknown indexes, so a set is tagged only if every access of it
+* has a known range of bytes, with DataLayout offsets and the size of the
+* access, inside its allocation, and none of these ranges overlaps a range
+* of another tagged set.
+*/
+class RangedAliasAnnotate: public ModulePass{
+	private:
+	//Bytes that the accesses of a set touch in one allocation
+	struct ByteRange
+	{
+		int set;
+		int64_t lo;
+		int64_t hi;
+	};
+	//Bytes [Lo, Hi) that an access of Size bytes through Ptr may touch
+	//inside the allocation Base; false if any of them is unknown
+	bool
+		getByteRange
+			(Value* Ptr, uint64_t Size, const DataLayout& DL, 
+			InterProceduralRA<Cousot>& ra, Value*& Base, int64_t& Lo, int64_t& Hi);
+	public:
+	static char ID;
+	RangedAliasAnnotate() : ModulePass(ID) {}
+	bool runOnModule(Module &M);
+	void getAnalysisUsage(AnalysisUsage &AU) const;
 };
 
 }
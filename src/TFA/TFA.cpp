@@ -1,6 +1,8 @@
 #include "TFA.h"
+#include "../PassProfile/PassProfile.h"
 #define DEBUG_TYPE "TFA"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InstIterator.h"
 
 STATISTIC(NumTaintedNodes, "The number of nodes marked as tainted in the dep graph");
 STATISTIC(NumNodes, "The number of nodes in the dep graph");
@@ -12,11 +14,19 @@ static cl::opt<llvm::cl::boolOrDefault>
 						"Specify if every value from libraries should be treated as tainted. Default is true."),
 				cl::value_desc("Input description"));
 
+static cl::opt<bool>
+		UseSummaries(
+				"tfa-summaries",
+				cl::desc(
+						"Propagate the taint with function summaries instead of the module dependence graph (data flow only)"),
+				cl::init(false));
+
 TFA::TFA() :
-	ModulePass(ID) {
+	ModulePass(ID), depGraph(NULL), summaries(NULL) {
 
 }
 bool TFA::runOnModule(Module &M) {
+	PassProfileScope scope("TFA", "taint");
 	if (Input.getValue() == llvm::cl::BOU_UNSET || Input.getValue()
 			== llvm::cl::BOU_TRUE) {
 		InputValues &IV = getAnalysis<InputValues> ();
@@ -25,29 +35,38 @@ bool TFA::runOnModule(Module &M) {
 		InputDep &IV = getAnalysis<InputDep> ();
 		inputDepValues = IV.getInputDepValues();
 	}
-	bSSA &bssa = getAnalysis<bSSA> ();
-	depGraph = bssa.newGraph;
-	DEBUG( // display dependence graph
-	string Error;
-	std::string tmp = M.getModuleIdentifier();
-	replace(tmp.begin(), tmp.end(), '\\', '_');
-	std::string Filename = "/tmp/" + tmp + ".dot";
+	if (UseSummaries) {
+		//No module graph: each function graph lives while it is visited.
+		//If an earlier stage preserved the summaries, only the functions
+		//it changed are analyzed again.
+		summaries = &getAnalysis<TaintSummaries> ();
+		summaries->update(M);
+		summaries->taint(inputDepValues);
+		NumTaintedNodes = summaries->getNumTaintedValues();
+	} else {
+		bSSA &bssa = getAnalysis<bSSA> ();
+		depGraph = bssa.newGraph;
+		DEBUG( // display dependence graph
+		string Error;
+		std::string tmp = M.getModuleIdentifier();
+		replace(tmp.begin(), tmp.end(), '\\', '_');
+		std::string Filename = "/tmp/" + tmp + ".dot";
 
-	//Print dependency graph (in dot format)
-	depGraph->toDot(M.getModuleIdentifier(), Filename);
-	DisplayGraph(Filename, true, GraphProgram::DOT);
-	);
-	tainted = depGraph->getDepValues(inputDepValues);
-	NumTaintedNodes = tainted.size();
-	NumNodes = depGraph->getNodes().size();
+		//Print dependency graph (in dot format)
+		depGraph->toDot(M.getModuleIdentifier(), Filename);
+		DisplayGraph(Filename, true, GraphProgram::DOT);
+		);
+		tainted.clear();
+		NumTaintedNodes = depGraph->getDepValues(inputDepValues, tainted);
+		NumNodes = depGraph->getNodes().size();
+	}
 
 	DEBUG( // If debug mode is enabled, add metadata to easily identify tainted values in the llvm IR
 	for (Module::iterator F = M.begin(), endF = M.end(); F != endF; ++F) {
 		for (Function::iterator BB = F->begin(), endBB = F->end(); BB != endBB; ++BB) {
 			for (BasicBlock::iterator I = BB->begin(), endI = BB->end(); I
 					!= endI; ++I) {
-				GraphNode* g = depGraph->findNode(I);
-				if (tainted.count(g)) {
+				if (isValueTainted(I)) {
 					LLVMContext& C = I->getContext();
 					MDNode* N = MDNode::get(C, MDString::get(C, "TFA"));
 					I->setMetadata("tainted", N);
@@ -60,17 +79,60 @@ bool TFA::runOnModule(Module &M) {
 }
 
 bool TFA::isValueTainted(Value* v) {
+	if (summaries)
+		return summaries->isTainted(v);
 	GraphNode* g = depGraph->findNode(v);
-	return tainted.count(g);
+	if (!g)
+		return false;
+	unsigned index = Graph::getNodeIndex(g);
+	return index < tainted.size() && tainted.test(index);
+}
+
+void TFA::addInputDepValues(const std::set<Value*>& sources) {
+	inputDepValues.insert(sources.begin(), sources.end());
+	if (summaries) {
+		summaries->taint(sources);
+		NumTaintedNodes = summaries->getNumTaintedValues();
+		return;
+	}
+	NumTaintedNodes += depGraph->getDepValues(sources, tainted);
+}
+
+void TFA::print(raw_ostream& O, const Module* M) const {
+	TFA* self = const_cast<TFA*> (this);
+	for (Module::const_global_iterator G = M->global_begin(), E =
+			M->global_end(); G != E; ++G)
+		if (self->isValueTainted(const_cast<GlobalVariable*> (&*G)))
+			O << "tainted @" << G->getName() << "\n";
+
+	for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F) {
+		for (Function::const_arg_iterator A = F->arg_begin(), AE = F->arg_end(); A
+				!= AE; ++A)
+			if (A->hasName() && self->isValueTainted(const_cast<Argument*> (&*A)))
+				O << "tainted " << F->getName() << ":%" << A->getName() << "\n";
+		for (const_inst_iterator I = inst_begin(*F), IE = inst_end(*F); I != IE; ++I)
+			if (I->hasName()
+					&& self->isValueTainted(const_cast<Instruction*> (&*I)))
+				O << "tainted " << F->getName() << ":%" << I->getName() << "\n";
+	}
 }
 
 std::set<GraphNode*> TFA::getTaintedValues() {
-	return tainted;
+	std::set<GraphNode*> nodes;
+	if (!depGraph)
+		return nodes;
+	for (int i = tainted.find_first(); i != -1; i = tainted.find_next(i))
+		if (GraphNode* g = depGraph->getNodeByIndex(i))
+			nodes.insert(g);
+	return nodes;
 }
 
 void TFA::getAnalysisUsage(AnalysisUsage &AU) const {
 	AU.setPreservesAll();
-	AU.addRequired<bSSA> ();
+	if (UseSummaries)
+		AU.addRequired<TaintSummaries> ();
+	else
+		AU.addRequired<bSSA> ();
 	AU.addRequired<InputValues> ();
 	AU.addRequired<InputDep> ();
 
@@ -2,27 +2,29 @@
 #define __VUL_ARRAYS_H__
 
 #include "llvm/Pass.h"
-#include "llvm/Function.h"
-#include "llvm/BasicBlock.h"
-#include "llvm/Instruction.h"
-#include "llvm/User.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/User.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/ADT/ilist.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SetVector.h"
-#include "llvm/Instructions.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/ADT/SmallPtrSet.h"
-#include "llvm/Metadata.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/PassAnalysisSupport.h"
-#include "llvm/Function.h"
+#include "llvm/IR/Function.h"
 #include "llvm/DebugInfo.h"
 #include "llvm/ADT/StringRef.h"
 #include "../DepGraph/DepGraph.h"
-#include "../DepGraph/InputValues.h"
+#include "../InputValues/InputValues.h"
 #include "../DepGraph/InputDep.h"
 #include "../DepGraph/AddStore.h"
+#include "../DepGraph/TaintSummaries.h"
 #include "../bSSA/bSSA.h"
 #include<set>
 #include<utility>
@@ -36,12 +38,22 @@ class TFA : public ModulePass {
 		std::set<Value*> inputDepValues;
 		bool runOnModule(Module &M);
 		bool isValueInpDep(Value* V);
-		std::set<GraphNode*> tainted;
+		// The tainted nodes, by dense index in the dependence graph
+		BitVector tainted;
+		// With -tfa-summaries, holds the taint; depGraph and tainted are unused
+		TaintSummaries* summaries;
 	public:
 		static char ID;
 		void getAnalysisUsage(AnalysisUsage &AU) const;
+		// The tainted nodes of the dependence graph; empty with -tfa-summaries
 		std::set<GraphNode*> getTaintedValues();
 		bool isValueTainted(Value* v);
+		// Taints what the new sources reach, searching only past the nodes
+		// that are not tainted yet
+		void addInputDepValues(const std::set<Value*>& sources);
+		// Lists the tainted globals, arguments and instructions that have
+		// a name, one per line, for -analyze
+		void print(raw_ostream& O, const Module* M) const;
 		TFA();
 
 };
@@ -0,0 +1,112 @@
+//===- InfluenceRegion.h - The influence regions of the branches of a function ------------------*- C++ -*-===//
+#ifndef LLVM_INFLUENCEREGION_H
+#define LLVM_INFLUENCEREGION_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+	// The influence region of a block ending in a branch: the blocks reached
+	// from its successors before one of its post dominators. The walk gives,
+	// in the order the old recursive flooding gated them, the blocks of the
+	// region and the post dominators it stopped at, whose PHIs are gated.
+	//
+	// The blocks are numbered once per function and a visited mark is the
+	// number of the walk that set it, so starting a walk clears nothing: a
+	// region costs its blocks and their edges, whatever the function size.
+	class InfluenceRegions {
+	public:
+		// A reached block, and whether it is a post dominator the walk stopped at
+		typedef std::pair<BasicBlock *, bool> ReachedBB;
+		typedef SmallVector<ReachedBB, 32> RegionTy;
+
+		InfluenceRegions(Function &F, PostDominatorTree &PD) : PD(*PD.DT), Walk(0) {
+			init(F);
+		}
+
+		// For a post dominator tree built outside the pass manager
+		InfluenceRegions(Function &F, DominatorTreeBase<BasicBlock> &PD) : PD(PD), Walk(0) {
+			init(F);
+		}
+
+		// Fills Region with the influence region of BB. With StopAtGated, the
+		// walk does not go past a block ending in a conditional branch that an
+		// earlier walk of the function gated: the region of that branch
+		// already covers what follows it.
+		void compute(BasicBlock *BB, RegionTy &Region, bool StopAtGated = false) {
+			Region.clear();
+			if (++Walk == 0) {
+				std::fill(Visited.begin(), Visited.end(), 0);
+				std::fill(Inside.begin(), Inside.end(), 0);
+				Walk = 1;
+			}
+			//Iterative depth first walk: a block and the next successor to visit
+			SmallVector<std::pair<BasicBlock *, unsigned>, 32> Stack;
+			Stack.push_back(std::make_pair(BB, 0u));
+			while (!Stack.empty()) {
+				TerminatorInst *ti = Stack.back().first->getTerminator();
+				if (Stack.back().second == ti->getNumSuccessors()) {
+					Stack.pop_back();
+					continue;
+				}
+				BasicBlock *Succ = ti->getSuccessor(Stack.back().second++);
+				unsigned N = Numbers[Succ];
+
+				//If the basic block has been processed, do not advance
+				if (Visited[N] == Walk)
+					continue;
+				Visited[N] = Walk;
+
+				//A post dominator that is not the start basic block ends the walk
+				if (Succ != BB && PD.dominates(Succ, BB)) {
+					Region.push_back(std::make_pair(Succ, true));
+					continue;
+				}
+				Region.push_back(std::make_pair(Succ, false));
+				Inside[N] = Walk;
+
+				bool Stop = false;
+				if (StopAtGated && Gated[N]) {
+					BranchInst *bi = dyn_cast<BranchInst>(Succ->getTerminator());
+					Stop = bi && bi->isConditional();
+				}
+				Gated[N] = true;
+				if (!Stop)
+					Stack.push_back(std::make_pair(Succ, 0u));
+			}
+		}
+
+		// Whether BB is in the last region computed, post dominators excluded
+		bool isInside(BasicBlock *BB) {
+			DenseMap<BasicBlock *, unsigned>::iterator It = Numbers.find(BB);
+			return It != Numbers.end() && Inside[It->second] == Walk;
+		}
+
+	private:
+		DominatorTreeBase<BasicBlock> &PD;
+		DenseMap<BasicBlock *, unsigned> Numbers;
+		unsigned Walk;
+		std::vector<unsigned> Visited;
+		std::vector<unsigned> Inside;
+		std::vector<bool> Gated;
+
+		void init(Function &F) {
+			unsigned N = 0;
+			for (Function::iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
+				Numbers[BB] = N++;
+			Visited.resize(N, 0);
+			Inside.resize(N, 0);
+			Gated.resize(N, false);
+		}
+	};
+
+}
+
+#endif
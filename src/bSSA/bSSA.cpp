@@ -4,7 +4,12 @@
 
 using namespace llvm;
 
-std::vector<BasicBlock *> ProcessedBB;
+static cl::opt<bool>
+		ReportLeaks(
+				"bssa-leaks",
+				cl::desc(
+						"Report the subgraphs from the address sources to the output calls; every block of a function starts a region, and a PHI of the post dominator is gated only if one of its operands comes from the region"),
+				cl::init(false));
 
 //Receive a predicate and include it on predicate attribute
 Pred::Pred(Value *p) {
@@ -67,10 +72,11 @@ bool Pred::isGated (Instruction *op) {
 void bSSA::getAnalysisUsage(AnalysisUsage &AU) const {
 
 		AU.addRequired<PostDominatorTree>();
+		AU.addRequired<DominatorTree>();
 		AU.addRequired<moduleDepGraph>();
 
-        // This pass will modifies the program, but not the CFG
-        AU.setPreservesCFG();
+        // This pass will not modify the program nor the CFG
+        AU.setPreservesAll();
 
 }
 
@@ -82,21 +88,39 @@ bool bSSA::runOnModule(Module &M) {
 		//Getting dependency graph
 		Graph *g = DepGraph.depGraph;
 
-		//src stores the instructions which are source of secret information
-		//dst stores the instructions  which are public output channel like printf()
-		std::vector<Value *> src, dst;
-
 		for (Module::iterator Mit = M.begin(), Mend = M.end(); Mit != Mend; ++Mit) {
 			F = Mit;
-			// Iterate over all Basic Blocks of the Function
-			for (Function::iterator Fit = F->begin(), Fend = F->end(); Fit != Fend; ++Fit) {
-				makeTable(Fit, F); //Creating in memory the table with predicates and gated instructions
+			if (F->isDeclaration())
+				continue;
+			InfluenceRegions IR(*F, getAnalysis<PostDominatorTree>(*F));
+			if (ReportLeaks) {
+				// Iterate over all Basic Blocks of the Function
+				for (Function::iterator Fit = F->begin(), Fend = F->end(); Fit != Fend; ++Fit)
+					makeTable(Fit, IR); //Creating in memory the table with predicates and gated instructions
+				continue;
 			}
-			
+			//The blocks are visited in post order of the dominator tree, so the flooding does not go past
+			//a conditional branch whose basic block has been gated: its IR has been processed
+			DominatorTree &DT = getAnalysis<DominatorTree>(*F);
+			for (po_iterator<DomTreeNode*> Fit = po_begin(DT.getRootNode()),
+					Fend = po_end(DT.getRootNode()); Fit != Fend; Fit++)
+				makeTable(Fit->getBlock(), IR);
 		}
 
 		//Including control edges into dependence graph.
 		incGraph (g);
+		newGraph = g;
+
+		if (ReportLeaks)
+			reportLeaks(M, g);
+		return false;
+}
+
+//Dump the subgraphs from the address sources to the output calls, with their stats
+void bSSA::reportLeaks (Module &M, Graph *g) {
+		//src stores the instructions which are source of secret information
+		//dst stores the instructions  which are public output channel like printf()
+		std::vector<Value *> src, dst;
 
 		//Stats from dependence graph
 		errs()<<"Var Nodes " << g->getNumVarNodes()<<" \n";
@@ -183,14 +207,12 @@ bool bSSA::runOnModule(Module &M) {
 		int c=0;
 		for (unsigned int i=0; i<src.size(); i++) {
 			for (unsigned int j=0; j<dst.size(); j++) {
-				Graph subG = g->generateSubGraph(src[i], dst[j]);
-				Graph::iterator gIt = subG.begin();
-				Graph::iterator gIte = subG.end();
-				if (gIt != gIte) {
+				Graph::SubGraph subG = g->getSubGraph(src[i], dst[j]);
+				if (!subG.empty()) {
 					totalControlEdges += subG.getNumControlEdges();
 					totalDataEdges +=subG.getNumDataEdges();
 					countWarning++;
-					totalNodes += subG.getNumOpNodes()+subG.getNumVarNodes()+subG.getNumMemNodes();
+					totalNodes += subG.size();
 					ostringstream ss;
 					ss << "/tmp/subgrafo" << c <<".dot"; c++;
 					subG.toDot("SubGrafo", ss.str()); //Make one file .dot for each tainted subgraph.
@@ -224,8 +246,6 @@ bool bSSA::runOnModule(Module &M) {
 		//std::string Filename = "/tmp/grafo.dot";
         //Print dependency graph (in dot format);
         //g->toDot("Grafo", Filename);
-
-        return false;
 }
 
 
@@ -275,73 +295,55 @@ void bSSA::incGraph (Graph *g) {
 
 
 //It receives a BasicBLock and makes table of predicates and its respective gated instructions
-void bSSA::makeTable (BasicBlock *BB, Function *F) {
-	    Value *condition;
+void bSSA::makeTable (BasicBlock *BB, InfluenceRegions &IR) {
   		TerminatorInst *ti = BB->getTerminator();
         BranchInst *bi = NULL;
         SwitchInst *si=NULL;
-
-        PostDominatorTree &PD = getAnalysis<PostDominatorTree>(*F);
-
-        ProcessedBB.clear();
-        if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) { //If the terminator instruction is a conditional branch
-            condition = bi->getCondition();
-            //Including the predicate on the predicatesVector
-            predicatesVector.push_back(new Pred(condition));
-            //Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
-            for (unsigned int i=0; i<bi->getNumSuccessors(); i++) {
-                 findIR (BB, bi->getSuccessor(i),PD);
-            }
-        }else if ((si = dyn_cast<SwitchInst>(ti))) {
-        	condition = si->getCondition();
-		    //Including the predicate on the predicatesVector
-		    predicatesVector.push_back(new Pred(condition));
-		    //Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
-		    for (unsigned int i=0; i<si->getNumSuccessors(); i++) {
-		        findIR (BB, si->getSuccessor(i),PD);
-		    }
-        }
+        Pred *p;
+
+        if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) //If the terminator instruction is a conditional branch
+            p = new Pred(bi->getCondition());
+        else if ((si = dyn_cast<SwitchInst>(ti)))
+            p = new Pred(si->getCondition());
+        else
+            return;
+
+        //Including the predicate on the predicatesVector
+        predicatesVector.push_back(p);
+        //Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
+        InfluenceRegions::RegionTy Region;
+        IR.compute(BB, Region, !ReportLeaks);
+        gateRegion(IR, Region, p);
 }
 
 
-//Flooding until reach a posdominator node
-void bSSA::findIR (BasicBlock *bBOring, BasicBlock *bBSuss, PostDominatorTree &PD) {
-
-	Pred *p;
-	TerminatorInst *ti = bBSuss->getTerminator();
-
-
-	//If the basic block has been processed, do not advance
-	for (unsigned int x=0; x<ProcessedBB.size(); x++) {
-		if (ProcessedBB[x] == bBSuss) {
-			return;
-		}
-	}
+//Gate the instructions of the blocks found by the flooding until reach a posdominator node
+void bSSA::gateRegion (InfluenceRegions &IR, InfluenceRegions::RegionTy &Region, Pred *p) {
 
-	//Including the basic block in the processed vector
-	ProcessedBB.push_back(bBSuss);
+	for (unsigned int x=0; x<Region.size(); x++) {
+		BasicBlock *bBSuss = Region[x].first;
 
-	//If the basic block is a posdominator and is not the start basic block, just gate the PHI instructions
-	if (PD.dominates(bBSuss, bBOring) && bBSuss != bBOring) {
-		//Find PHI instructions
-		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end(); bBIt != bBEnd; ++bBIt) {
-			if (dyn_cast<Instruction>(bBIt)->getOpcode()==Instruction::PHI) {
+		//If the basic block is a posdominator, just gate the PHI instructions
+		if (Region[x].second) {
+			for (BasicBlock::iterator bBIt = bBSuss->begin(); isa<PHINode>(bBIt); ++bBIt) {
+				if (!ReportLeaks) {
+					p->addInst(bBIt);
+					continue;
+				}
 				//if there is a PHI's argument gated, gate the PHI instruction
-				p = predicatesVector.back();
-				for (unsigned int k=0; k<dyn_cast<Instruction>(bBIt)->getNumOperands(); k++) {
-					if (p->isGated(dyn_cast<Instruction>(dyn_cast<Instruction>(bBIt)->getOperand(k)))) {
+				for (unsigned int k=0; k<bBIt->getNumOperands(); k++) {
+					Instruction *I = dyn_cast<Instruction>(bBIt->getOperand(k));
+					if (I && IR.isInside(I->getParent())) {
 						p->addInst(bBIt);
 						break;
 					}
 				}
 			}
+			continue;
 		}
-		return;
-	}else { //Advance the flooding
+
 		//Instruction will be gated whit the bBOring predicate
 		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end(); bBIt != bBEnd; ++bBIt) {
-			p = predicatesVector.back();
-
 			//If is a function call which is defined on the same module
 			if (CallInst *CI = dyn_cast<CallInst>(&(*bBIt))) {
 				Function *F = CI->getCalledFunction();
@@ -354,10 +356,6 @@ void bSSA::findIR (BasicBlock *bBOring, BasicBlock *bBSuss, PostDominatorTree &P
 			//Gate the other instructions
 			p->addInst(bBIt);
 		}
-		//If there is successor, go there
-		for (unsigned int i=0; i<ti->getNumSuccessors(); i++) {
-			findIR (bBOring, ti->getSuccessor(i), PD);
-		}
 	}
 
 }
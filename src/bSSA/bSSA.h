@@ -12,12 +12,15 @@
 #include "llvm/Assembly/Writer.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Support/CFG.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include <deque>
 #include <algorithm>
 #include <vector>
 #include <string>
 #include "../DepGraph/DepGraph.h"
+#include "InfluenceRegion.h"
 #include <sstream>
 
 #ifndef DEBUG_TYPE
@@ -50,15 +53,17 @@ namespace llvm {
 	class bSSA : public ModulePass {
 	public:
         	static char ID;
-        	bSSA() : ModulePass(ID) {}
+        	bSSA() : ModulePass(ID), newGraph(NULL) {}
         	void getAnalysisUsage(AnalysisUsage &AU) const;
         	bool runOnModule(Module&);
         	void printGate ();	//Print the predicates and its respective gated instructions
         	void incGraph (Graph *g); //Increase graph including control edges
+        	Graph *newGraph; //The dependence graph with the control edges
 	private:
+        	void reportLeaks (Module &M, Graph *g); //Dump the subgraphs from the address sources to the output calls
         	std::vector<Pred *> predicatesVector;	//Vector of predicates objects
-        	void makeTable (BasicBlock *b, Function *F);
-        	void findIR (BasicBlock *borigin, BasicBlock *bdst, PostDominatorTree &PD);	//Run on Influence Region of basic block borigin gated all instructions
+        	void makeTable (BasicBlock *b, InfluenceRegions &IR);
+        	void gateRegion (InfluenceRegions &IR, InfluenceRegions::RegionTy &Region, Pred *p);	//Gate all instructions of the Influence Region of a basic block
         	void gateFunction (Function *F, Pred *p);
 	};
 
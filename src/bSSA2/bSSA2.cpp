@@ -1,20 +1,47 @@
 #include "bSSA2.h"
+#include "llvm/ADT/StringExtras.h"
 
 using namespace llvm;
 
+static cl::list<std::string> LeakSinks("bssa2-sinks", cl::CommaSeparated,
+		cl::desc("Functions whose arguments are public channels (default: the printf and write families)"));
+
+static cl::list<std::string> LeakSources("bssa2-sources", cl::CommaSeparated,
+		cl::desc("Functions whose results are secret addresses (default: the allocators)"));
+
+static cl::opt<std::string> LeaksJSON("bssa2-leaks-json",
+		cl::desc("Write every leak, one JSON object per line, to this file"));
+
+static cl::opt<bool> LeakWitness("bssa2-witness",
+		cl::desc("Include the path from the source in -bssa2-leaks-json"));
+
+static const char *const DefaultSinks[] = { "printf", "fiprintf", "fprintf", "iprintf", "vfprintf",
+		"vprintf", "fputc", "fputs", "putc", "putchar", "puts", "fwrite", "pwrite", "write" };
+
+static const char *const DefaultSources[] = { "malloc", "calloc", "realloc", "realloccf", "valloc" };
+
 //Receive a predicate and include it on predicate attribute
-Pred::Pred(Value *p) {
+Pred::Pred(Value *p, unsigned index) {
 	predicate = p;
+	this->index = index;
 }
 
-//Receive a instruction and include it on insts vector
+//Receive a instruction and include it on insts vector, if it is not gated yet
 void Pred::addInst(Instruction *i) {
-	insts.push_back(i);
+	if (instSet.insert(i).second)
+		insts.push_back(i);
+}
+
+//Receive a basic block and include it on blocks vector, if it is not gated yet
+void Pred::addBlock(BasicBlock *BB) {
+	if (blockSet.insert(BB))
+		blocks.push_back(BB);
 }
 
-//Receive a function pointer and include it on funcs vector
+//Receive a function pointer and include it on funcs vector, if it is not gated yet
 void Pred::addFunc(Function *f) {
-	funcs.push_back(f);
+	if (funcSet.insert(f))
+		funcs.push_back(f);
 }
 
 //Return the total instruction count
@@ -26,6 +53,14 @@ int Pred::getNumFunctions() {
 	return (funcs.size());
 }
 
+int Pred::getNumBlocks() {
+	return (blocks.size());
+}
+
+unsigned Pred::getIndex() {
+	return (index);
+}
+
 //Return the predicate
 Value *Pred::getPred() {
 	return (predicate);
@@ -39,6 +74,13 @@ Instruction *Pred::getInst(int i) {
 		return NULL;
 }
 
+BasicBlock *Pred::getBlock(int i) {
+	if (i < (signed int) blocks.size())
+		return (blocks[i]);
+	else
+		return NULL;
+}
+
 Function *Pred::getFunc(int i) {
 	if (i < (signed int) funcs.size())
 		return (funcs[i]);
@@ -46,25 +88,13 @@ Function *Pred::getFunc(int i) {
 		return NULL;
 }
 
-//Return true of *op instruction is gated (if it is stored on insts vector) for the predicate
+//Return true of *op instruction is gated (if it or its basic block is stored) for the predicate
 bool Pred::isGated(Instruction *op) {
-	unsigned int i;
-
-	for (i = 0; i < insts.size(); i++) {
-		if (op == insts[i])
-			return true;
-	}
-
-	return false;
+	return instSet.count(op) || blockSet.count(op->getParent());
 }
 
 bool Pred::isFGated(Function *f) {
-	unsigned int i;
-	for (i = 0; i < funcs.size(); i++) {
-		if (f == funcs[i])
-			return true;
-	}
-	return false;
+	return funcSet.count(f);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -81,31 +111,24 @@ void bSSA2::getAnalysisUsage(AnalysisUsage &AU) const {
 
 }
 
-//Return a set of all tainted nodes
+//Return a set of all tainted values
 std::set<Value *> bSSA2::getLeakedValues() {
 	std::set<Value *> s;
 	OpNode *op;
 	VarNode *va;
 	MemNode *mem;
 	std::set<Value*> aliases;
-	for (Graph::iterator gS = this->newGraph->begin(), gE =
-			this->newGraph->end(); gS != gE; ++gS) {
-
-		if ((*gS)->tainted) {
-			if ((op = dyn_cast<OpNode>((*gS)))) {
-				if (op->tainted)
-					s.insert(op->getValue());
-			} else if ((va = dyn_cast<VarNode>((*gS)))) {
-				if (va->tainted)
-					s.insert(va->getValue());
-			} else if ((mem = dyn_cast<MemNode>((*gS)))) {
-				if (mem->tainted) {
-					aliases = mem->getAliases();
-					for (std::set<Value *>::iterator mIt = aliases.begin(), mE =
-							aliases.end(); mIt != mE; ++mIt) {
-						s.insert((*mIt));
-					}
-				}
+	const std::set<GraphNode *> &nodes = leaks->getLeakedNodes();
+	for (std::set<GraphNode *>::const_iterator gS = nodes.begin(), gE = nodes.end(); gS != gE; ++gS) {
+		if ((op = dyn_cast<OpNode>((*gS)))) {
+			s.insert(op->getValue());
+		} else if ((va = dyn_cast<VarNode>((*gS)))) {
+			s.insert(va->getValue());
+		} else if ((mem = dyn_cast<MemNode>((*gS)))) {
+			aliases = mem->getAliases();
+			for (std::set<Value *>::iterator mIt = aliases.begin(), mE =
+					aliases.end(); mIt != mE; ++mIt) {
+				s.insert((*mIt));
 			}
 		}
 	}
@@ -113,39 +136,158 @@ std::set<Value *> bSSA2::getLeakedValues() {
 	return (s);
 }
 
-//Return a vector of pair (print instruction, parameter vector)
+//Return a vector of pair (print instruction, leaked parameters)
 std::vector<std::pair<Instruction*, std::vector<Value*> > > bSSA2::getPrintfLeaks() {
 
 	std::vector<std::pair<Instruction*, std::vector<Value*> > > v;
 
-	std::vector<Value *> args;
+	const std::vector<LeakQueries::Leak> &l = leaks->getLeaks();
+	for (unsigned int i = 0; i < l.size(); i++) {
+		if (v.empty() || v.back().first != l[i].sink)
+			v.push_back(std::pair<Instruction*, std::vector<Value*> >(l[i].sink, std::vector<Value*>()));
+		v.back().second.push_back(cast<CallInst>(l[i].sink)->getArgOperand(l[i].arg));
+	}
+	return (v);
+}
 
-	for (std::vector<Value *>::iterator dstIt = dst.begin(), dstE = dst.end();
-			dstIt != dstE; ++dstIt) {
-		if (Instruction *I = dyn_cast<Instruction>(*dstIt)) {
-			if (CallInst *cI = dyn_cast<CallInst>(*dstIt)) {
-				for (unsigned int i = 0; i < cI->getNumArgOperands(); i++) {
-					args.push_back(cI->getArgOperand(i));
-				}
-				v.push_back(
-						std::pair<Instruction*, std::vector<Value*> >(I, args));
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//Leak queries
+LeakQueries::LeakQueries(Graph *g, const std::vector<Value *> &src, const std::vector<Value *> &dst) :
+		g(g), sources(src.begin(), src.end()), paths(g->getDependencyPaths(sources, false)),
+		leakedNodesDone(false) {
+
+	//Every argument of every sink is a query; all of them are answered by the same search
+	for (unsigned int i = 0; i < dst.size(); i++) {
+		CallInst *cI = dyn_cast<CallInst>(dst[i]);
+		if (cI == NULL)
+			continue;
+		for (unsigned int j = 0; j < cI->getNumArgOperands(); j++) {
+			Value *arg = cI->getArgOperand(j);
+			sinkArgs.insert(arg);
+			if (!paths.hasDependency(arg))
+				continue;
+			Leak leak;
+			leak.sink = cI;
+			leak.arg = j;
+			leak.source = paths.getSource(arg);
+			leak.distance = paths.getDistance(arg);
+			leaks.push_back(leak);
+		}
+	}
+}
+
+const std::vector<LeakQueries::Leak> &LeakQueries::getLeaks() {
+	return (leaks);
+}
+
+std::vector<GraphNode *> LeakQueries::getWitness(const Leak &leak) {
+	return (paths.getPath(cast<CallInst>(leak.sink)->getArgOperand(leak.arg)));
+}
+
+//The nodes that depend on a source and that a sink argument depends on
+const std::set<GraphNode *> &LeakQueries::getLeakedNodes() {
+	if (!leakedNodesDone) {
+		std::set<GraphNode *> forward = g->getDepValues(sources, true);
+		std::set<GraphNode *> backward = g->getDepValues(sinkArgs, false);
+		std::set_intersection(forward.begin(), forward.end(), backward.begin(), backward.end(),
+				std::inserter(leakedNodes, leakedNodes.end()));
+		leakedNodesDone = true;
+	}
+	return (leakedNodes);
+}
+
+static void printJSONString(raw_ostream &OS, StringRef S) {
+	OS << '"';
+	for (size_t i = 0, n = S.size(); i != n; i++) {
+		unsigned char Ch = S[i];
+		if (Ch == '"' || Ch == '\\')
+			OS << '\\' << Ch;
+		else if (Ch < 0x20)
+			OS << "\\u00" << hexdigit(Ch >> 4) << hexdigit(Ch & 15);
+		else
+			OS << Ch;
+	}
+	OS << '"';
+}
+
+//One line per leak, written as it is visited, so that no report is built in memory
+void LeakQueries::writeJSON(raw_ostream &OS, bool witness) {
+	for (unsigned int i = 0; i < leaks.size(); i++) {
+		CallInst *cI = cast<CallInst>(leaks[i].sink);
+		OS << "{\"sink\":";
+		printJSONString(OS, cI->getCalledFunction() ? cI->getCalledFunction()->getName() : "");
+		OS << ",\"function\":";
+		printJSONString(OS, cI->getParent()->getParent()->getName());
+		if (MDNode *N = cI->getMetadata("dbg")) {
+			DILocation Loc(N);
+			OS << ",\"file\":";
+			printJSONString(OS, Loc.getFilename());
+			OS << ",\"line\":" << Loc.getLineNumber();
+		}
+		OS << ",\"arg\":" << leaks[i].arg << ",\"source\":";
+		printJSONString(OS, leaks[i].source->getLabel());
+		OS << ",\"distance\":" << leaks[i].distance;
+		if (witness) {
+			std::vector<GraphNode *> path = getWitness(leaks[i]);
+			OS << ",\"path\":[";
+			for (unsigned int j = 0; j < path.size(); j++) {
+				if (j)
+					OS << ",";
+				printJSONString(OS, path[j]->getLabel());
 			}
+			OS << "]";
 		}
+		OS << "}\n";
 	}
-	return (v);
 }
 
 //find and return the predicated used to gate the inst parameter.
 Pred * bSSA2::getPredFromInst(Instruction *inst) {
+	//The first predicate which gates the whole basic block of inst
+	DenseMap<BasicBlock *, BitVector>::iterator It = blockPreds.find(inst->getParent());
+	if (It != blockPreds.end() && It->second.any())
+		return (predicatesVector[firstPred[inst->getParent()->getParent()] + It->second.find_first()]);
+
+	//Or the first one which gates inst alone
 	for (unsigned int i = 0; i < predicatesVector.size(); i++) {
-		for (unsigned int j = 0; j < predicatesVector[i]->insts.size(); j++) {
-			if (predicatesVector[i]->insts[j] == inst)
-				return (predicatesVector[i]);
-		}
+		if (predicatesVector[i]->isGated(inst))
+			return (predicatesVector[i]);
 	}
 	return NULL;
 }
 
+//Create a predicate and include it on predicatesVector
+Pred *bSSA2::addPred(Value *condition) {
+	Pred *p = new Pred(condition, predicatesVector.size());
+	predicatesVector.push_back(p);
+	return (p);
+}
+
+//Gate all instructions of BB, and the functions called there, with the predicate p
+void bSSA2::gateBlock(BasicBlock *BB, Pred *p) {
+	for (BasicBlock::iterator bBIt = BB->begin(), bBEnd = BB->end();
+			bBIt != bBEnd; ++bBIt) {
+		//If is a function call which is defined on the same module
+		if (CallInst *CI = dyn_cast<CallInst>(&(*bBIt))) {
+			Function *F = CI->getCalledFunction();
+			if (F != NULL)
+				if (!F->isDeclaration() && !F->isIntrinsic()) {
+					//Gate just if this predicate not yet dominates this call
+					if (!p->isFGated(F))
+						gateFunction(F, p);
+				}
+		}
+	}
+	p->addBlock(BB);
+
+	//Set the bit of p over the predicates of the function
+	BitVector &preds = blockPreds[BB];
+	unsigned bit = p->getIndex() - firstPred[BB->getParent()];
+	if (preds.size() <= bit)
+		preds.resize(bit + 1);
+	preds.set(bit);
+}
+
 
 //For each module, this method is executed
 bool bSSA2::runOnModule(Module &M) {
@@ -161,6 +303,7 @@ bool bSSA2::runOnModule(Module &M) {
 		F = Mit;
 		if (F->begin() != F->end()) {
 			hammock &checkHammock = getAnalysis<hammock>(*Mit);
+			firstPred[F] = predicatesVector.size();
 
 			if (checkHammock.functionIsHammock || IsOptimized) { //If user wants optimized version without hammock verification or if hammock verification returns true
 				// Iterate over all Basic Blocks of the Function
@@ -177,9 +320,10 @@ bool bSSA2::runOnModule(Module &M) {
 				// Iterate over all Basic Blocks of the Function
 				if (F->begin() != F->end()) {
 					PostDominatorTree &PD = getAnalysis<PostDominatorTree>(*F);
+					InfluenceRegions IR(*F, PD);
 					for (Function::iterator Fit = F->begin(), Fend = F->end();
 							Fit != Fend; ++Fit) {
-						makeTable(Fit, PD); //Creating in memory the table with predicates and gated instructions
+						makeTable(Fit, IR); //Creating in memory the table with predicates and gated instructions
 					}
 				}
 
@@ -191,6 +335,19 @@ bool bSSA2::runOnModule(Module &M) {
 	//Including control edges into dependence graph.
 	incGraph(g);
 
+	//The functions which are sinks and sources of secret information
+	StringSet<> sinkNames, sourceNames;
+	if (LeakSinks.empty())
+		for (unsigned int i = 0; i < array_lengthof(DefaultSinks); i++)
+			sinkNames.insert(DefaultSinks[i]);
+	for (unsigned int i = 0; i < LeakSinks.size(); i++)
+		sinkNames.insert(LeakSinks[i]);
+	if (LeakSources.empty())
+		for (unsigned int i = 0; i < array_lengthof(DefaultSources); i++)
+			sourceNames.insert(DefaultSources[i]);
+	for (unsigned int i = 0; i < LeakSources.size(); i++)
+		sourceNames.insert(LeakSources[i]);
+
 	//Interates on all source code in order to get the sources of address (secret information) and sinks (instructions like printf)
 	for (Module::iterator F = M.begin(), eM = M.end(); F != eM; ++F) {
 		for (Function::iterator BB = F->begin(), e = F->end(); BB != e; ++BB) {
@@ -210,49 +367,12 @@ bool bSSA2::runOnModule(Module &M) {
 					if (Callee) {
 						StringRef Name = Callee->getName();
 						//if is a print function
-						if (Name.equals("printf")) {
-							dst.push_back(I);
-						} else if (Name.equals("fiprintf")) {
-							dst.push_back(I);
-						} else if (Name.equals("fprintf")) {
-							dst.push_back(I);
-						} else if (Name.equals("iprintf")) {
-							dst.push_back(I);
-						} else if (Name.equals("vfprintf")) {
-							dst.push_back(I);
-						} else if (Name.equals("vprintf")) {
-							dst.push_back(I);
-						} else if (Name.equals("fputc")) {
-							dst.push_back(I);
-						} else if (Name.equals("fputs")) {
-							dst.push_back(I);
-						} else if (Name.equals("putc")) {
+						if (sinkNames.count(Name))
 							dst.push_back(I);
-						} else if (Name.equals("putchar")) {
-							dst.push_back(I);
-						} else if (Name.equals("puts")) {
-							dst.push_back(I);
-						} else if (Name.equals("fwrite")) {
-							dst.push_back(I);
-						} else if (Name.equals("pwrite")) {
-							dst.push_back(I);
-						} else if (Name.equals("write")) {
-							dst.push_back(I);
-						}
 
 						//If is a source of address
-						if (Name.equals("malloc")) {
-							src.push_back(I);
-						} else if (Name.equals("calloc")) {
-							src.push_back(I);
-						} else if (Name.equals("realloc")) {
-							src.push_back(I);
-						} else if (Name.equals("realloccf")) {
-							src.push_back(I);
-						}
-						if (Name.equals("valloc")) {
+						if (sourceNames.count(Name))
 							src.push_back(I);
-						}
 					}
 				}
 			}
@@ -268,10 +388,19 @@ bool bSSA2::runOnModule(Module &M) {
 	unsigned int totalControlEdges = 0, totalDataEdges = 0;
 	unsigned int totalNodes = 0;
 
-	g->findTaintedNodes(src, dst);
-
-	numDirtyNodes = g->countTaintedNodes();
+	//All the leak queries are answered by the same traversals
 	this->newGraph = g;
+	leaks = new LeakQueries(g, src, dst);
+	numDirtyNodes = leaks->getLeakedNodes().size();
+
+	if (!LeaksJSON.empty()) {
+		std::string ErrorInfo;
+		raw_fd_ostream File(LeaksJSON.c_str(), ErrorInfo);
+		if (!ErrorInfo.empty())
+			errs() << "ERROR: file " << LeaksJSON << " can't be opened!\n";
+		else
+			leaks->writeJSON(File, LeakWitness);
+	}
 
 	/*
 	 Graph::Guider * guider = new Graph::Guider(g);
@@ -334,7 +463,7 @@ void bSSA2::processNode(BasicBlock * node, DominatorTree &DT,
 	if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) { //If the terminator instruction is a conditional branch
 		condition = bi->getCondition();
 		//Including the predicate on the predicatesVector
-		predicatesVector.push_back(new Pred(condition));
+		addPred(condition);
 		//Gate childrens in the dominance tree
 		for (unsigned int i = 0; i < nodeTemp->getNumChildren(); i++) {
 			gateChildren(node, nodeTemp->getChildren()[i]->getBlock(),
@@ -344,7 +473,7 @@ void bSSA2::processNode(BasicBlock * node, DominatorTree &DT,
 	} else if ((si = dyn_cast<SwitchInst>(ti))) { //If the termination instruction is a switch instruction
 		condition = si->getCondition();
 		//Including the predicate on the predicatesVector
-		predicatesVector.push_back(new Pred(condition));
+		addPred(condition);
 		//Gate childrens in the dominance tree
 		for (unsigned int i = 0; i < nodeTemp->getNumChildren(); i++) {
 			gateChildren(node, nodeTemp->getChildren()[i]->getBlock(),
@@ -392,23 +521,7 @@ void bSSA2::gateChildren(BasicBlock *father, BasicBlock *child, Pred *p,
 
 	} else {
 		//Instruction will be gated whit the bBOring predicate
-		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end();
-				bBIt != bBEnd; ++bBIt) {
-			//If is a function call which is defined on the same module
-			if (CallInst *CI = dyn_cast<CallInst>(&(*bBIt))) {
-				Function *F = CI->getCalledFunction();
-				if (F != NULL)
-					if (!F->isDeclaration() && !F->isIntrinsic()) {
-						//Gate function just if it has not gated by this predicate
-						if (!p->isFGated(F))
-							gateFunction(F, p);
-					}
-			}
-
-			//Gate the other instructions
-			p->addInst(bBIt);
-
-		}
+		gateBlock(bBSuss, p);
 	}
 }
 
@@ -417,10 +530,31 @@ void bSSA2::incGraph(Graph *g) {
 	unsigned int i;
 	int j;
 
+	//Locates the predicates (icmp instrutions) Localiza os predicados (instruções icmp) from the graph
+	std::vector<GraphNode *> predNodes(predicatesVector.size());
+	for (i = 0; i < predicatesVector.size(); i++)
+		predNodes[i] = g->findNode(predicatesVector[i]->getPred());
+
+	//For each gated basic block, look its instructions up once and link them to all of its predicates
+	for (DenseMap<BasicBlock *, BitVector>::iterator bIt = blockPreds.begin(), bE = blockPreds.end();
+			bIt != bE; ++bIt) {
+		BitVector &preds = bIt->second;
+		unsigned first = firstPred[bIt->first->getParent()];
+		for (BasicBlock::iterator bBIt = bIt->first->begin(), bBEnd = bIt->first->end();
+				bBIt != bBEnd; ++bBIt) {
+			GraphNode *instNode = g->findNode(bBIt);
+			if (instNode == NULL)
+				continue;
+			for (int k = preds.find_first(); k != -1; k = preds.find_next(k)) {
+				if (GraphNode *predNode = predNodes[first + k])	//If the instruction is on the graph, make a edge
+					g->addEdge(predNode, instNode, etControl);
+			}
+		}
+	}
+
 	//For all predicates in predicatesVector
 	for (i = 0; i < predicatesVector.size(); i++) {
-		//Locates the predicate (icmp instrution) Localiza o predicado (instrução icmp) from the graph
-		GraphNode *predNode = g->findNode(predicatesVector[i]->getPred());
+		GraphNode *predNode = predNodes[i];
 
 		//For each predicate, iterates on the list of gated INSTRUCTIONS
 		for (j = 0; j < predicatesVector[i]->getNumInstrucoes(); j++) {
@@ -458,98 +592,45 @@ void bSSA2::incGraph(Graph *g) {
 }
 
 //It receives a BasicBLock and makes table of predicates and its respective gated instructions
-void bSSA2::makeTable(BasicBlock *BB, PostDominatorTree &PD) {
-	Value *condition;
+void bSSA2::makeTable(BasicBlock *BB, InfluenceRegions &IR) {
 	TerminatorInst *ti = BB->getTerminator();
 	BranchInst *bi = NULL;
 	SwitchInst *si = NULL;
 	Pred *predicate;
 
-	ProcessedBB.clear();
-	if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) { //If the terminator instruction is a conditional branch
-		condition = bi->getCondition();
-		//Including the predicate on the predicatesVector
-		predicate = new Pred(condition);
-		predicatesVector.push_back(predicate);
-		//Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
-		for (unsigned int i = 0; i < bi->getNumSuccessors(); i++) {
-			findIR(BB, bi->getSuccessor(i), PD, predicate);
-		}
-	} else if ((si = dyn_cast<SwitchInst>(ti))) {
-		condition = si->getCondition();
-		//Including the predicate on the predicatesVector
-		predicate = new Pred(condition);
-		predicatesVector.push_back(predicate);
-		//Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
-		for (unsigned int i = 0; i < si->getNumSuccessors(); i++) {
-			findIR(BB, si->getSuccessor(i), PD, predicate);
-		}
-	}
-}
-
-//Flooding until reach a posdominator node
-void bSSA2::findIR(BasicBlock *bBOring, BasicBlock *bBSuss,
-		PostDominatorTree &PD, Pred *p) {
-	BasicBlock *temp;
-	TerminatorInst *ti = bBSuss->getTerminator();
+	//Including the predicate on the predicatesVector
+	if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) //If the terminator instruction is a conditional branch
+		predicate = addPred(bi->getCondition());
+	else if ((si = dyn_cast<SwitchInst>(ti)))
+		predicate = addPred(si->getCondition());
+	else
+		return;
 
 	//Existe caso onde uma instrução de comparação é na verdade uma constante e neste caso ela não está ligada à nenhum BasicBlock. Fica como toDO
-	if (dyn_cast<Instruction>(p->getPred()) != NULL)
-		temp = dyn_cast<Instruction>(p->getPred())->getParent();
-	else
+	if (!isa<Instruction>(predicate->getPred()))
 		return;
 
-	//If the basic block has been processed, do not advance
-	for (unsigned int x = 0; x < ProcessedBB.size(); x++) {
-		if (ProcessedBB[x] == bBSuss) {
-			return;
-		}
-	}
+	//Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
+	InfluenceRegions::RegionTy Region;
+	IR.compute(BB, Region);
+	gateRegion(Region, predicate);
+}
 
-	//Including the basic block in the processed vector
-	ProcessedBB.push_back(bBSuss);
+//Gate the instructions of the blocks found by the flooding until reach a posdominator node
+void bSSA2::gateRegion(InfluenceRegions::RegionTy &Region, Pred *p) {
+	for (unsigned int x = 0; x < Region.size(); x++) {
+		BasicBlock *bBSuss = Region[x].first;
 
-	//If the basic block is a post dominator and is not the start basic block, just return
-	if (PD.dominates(bBSuss, bBOring) && bBSuss != bBOring) {
-		//Find PHI instructions
-		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end();
-				bBIt != bBEnd; ++bBIt) {
-			if (dyn_cast<Instruction>(bBIt)->getOpcode() == Instruction::PHI) {
-				//if there is a PHI's argument gated, gate the PHI instruction
-				//for (unsigned int k=0; k<dyn_cast<Instruction>(bBIt)->getNumOperands(); k++) {
-				//if (p->isGated(dyn_cast<Instruction>(dyn_cast<Instruction>(bBIt)->getOperand(k)))) {
+		//If the basic block is a post dominator, just gate the PHI instructions
+		if (Region[x].second) {
+			for (BasicBlock::iterator bBIt = bBSuss->begin(); isa<PHINode>(bBIt); ++bBIt)
 				p->addInst(bBIt);
-				//break;
-				//}
-				//}
-			}
+			continue;
 		}
-		return;
-	} else { //Advance the flooding
-		//Instruction will be gated whit the bBOring predicate
-		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end();
-				bBIt != bBEnd; ++bBIt) {
 
-			//If is a function call which is defined on the same module
-			if (CallInst *CI = dyn_cast<CallInst>(&(*bBIt))) {
-				Function *F = CI->getCalledFunction();
-				if (F != NULL)
-					if (!F->isDeclaration() && !F->isIntrinsic()) {
-						//Gate just if this predicate not yet dominates this call
-						if (!p->isFGated(F))
-							gateFunction(F, p);
-					}
-			}
-
-			//Gate the other instructions
-			p->addInst(bBIt);
-		}
-		//If there is successor, go there
-		for (unsigned int i = 0; i < ti->getNumSuccessors(); i++) {
-			findIR(bBOring, ti->getSuccessor(i), PD, p);
-		}
+		//Instruction will be gated whit the bBOring predicate
+		gateBlock(bBSuss, p);
 	}
-
 }
 
 //All instrutions of function F are gated with predicate p
@@ -561,6 +642,11 @@ void bSSA2::gateFunction(Function *F, Pred *p) {
 void bSSA2::printGate() {
 	for (unsigned int i = 0; i < predicatesVector.size(); i++) {
 		errs() << "\n\n" << predicatesVector[i]->getPred()->getName() << "\n";
+		for (int j = 0; j < predicatesVector[i]->getNumBlocks(); j++) {
+			BasicBlock *BB = predicatesVector[i]->getBlock(j);
+			for (BasicBlock::iterator bBIt = BB->begin(), bBEnd = BB->end(); bBIt != bBEnd; ++bBIt)
+				errs() << "  " << bBIt->getOpcodeName() << "\n";
+		}
 		for (int j = 0; j < predicatesVector[i]->getNumInstrucoes(); j++) {
 			errs() << "  " << predicatesVector[i]->getInst(j)->getOpcodeName()
 					<< "\n";
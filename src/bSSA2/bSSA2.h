@@ -27,11 +27,16 @@
 #include "llvm/Operator.h"
 #include "llvm/Constant.h"
 #include "llvm/Constants.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/DebugInfo.h"
+#include "llvm/Support/raw_ostream.h"
 #include "../hammock/hammock.h"
+#include "../bSSA/InfluenceRegion.h"
 #include <stack>
-
-// Global variables
-std::vector<BasicBlock *> ProcessedBB; //Stores processed basic block used in makeTable and findIR methods
+#include <iterator>
 
 
 
@@ -48,8 +53,8 @@ namespace llvm {
 
 
 	// Auxiliar class for store one predicate and its gated instructions
-	// This Class is used just for non-optimized version of algorithm. It find the IR for each basic block in CFG, using a flooding approach and gate the respective instructions
-	// with basic block's predicate.
+	// The instructions of a basic block in the IR of the predicate are gated with the whole block; the instructions
+	// stored one by one are the PHIs of the post dominators where the IR ends. Membership is hashed.
 	class Pred {
 
 		public:
@@ -58,6 +63,11 @@ namespace llvm {
 			// \param i Instruction to be stored
 			void addInst (Instruction *i);
 
+			// \brief Gate all instructions of a basic block
+			//
+			// \param BB Basic block to be stored
+			void addBlock (BasicBlock *BB);
+
 			// \brief Return the respective stored predicate
 			//
 			// \return A value relate the predicate
@@ -80,15 +90,30 @@ namespace llvm {
 			// \param The function
 			void addFunc (Function *f);
 
-			// \brief Return the number of gated instructions
+			// \brief Return the number of gated instructions, gated blocks excluded
 			//
 			// \return The numer of gated instructions
 			int getNumInstrucoes ();
 
+			// \brief Return the gated basic block indexed by param i
+			//
+			// \param i index
+			// \return The basic block
+			BasicBlock *getBlock (int i);
+
+			// \brief Return the number of gated basic blocks
+			//
+			// \return The number of gated basic blocks
+			int getNumBlocks ();
+
+			// \brief Return the index of the predicate in predicatesVector
+			unsigned getIndex ();
+
 			// \brief Constructor of the class.
 			//
 			// \param p The predicate
-			Pred(Value *p);
+			// \param index The index of the predicate in predicatesVector
+			Pred(Value *p, unsigned index);
 
 			// \brief Return the gated function indexed by param i
 			//
@@ -101,24 +126,77 @@ namespace llvm {
 			// \return The number of gated functions
 			int getNumFunctions ();
 
-			// Vector for store gated instructions
-			std::vector<Instruction *> insts;
+			// \brief Check if the instruction is gated
+			//
+			// \param i Instruction
+			// \return True if yes, false if not
+			bool isGated (Instruction *i);
+
 		private:
 
 			// Store the predicate
 			Value *predicate;
 
+			// Index of the predicate in predicatesVector
+			unsigned index;
+
+			// Store the gated instructions and basic blocks, in the order they were gated, and their sets
+			std::vector<Instruction *> insts;
+			std::vector<BasicBlock *> blocks;
+			DenseSet<Instruction *> instSet;
+			SmallPtrSet<BasicBlock *, 16> blockSet;
+
 			// Store the gated functions
 			std::vector<Function *> funcs;
+			SmallPtrSet<Function *, 8> funcSet;
 
-			// \brief Check if the instruction is gated
+	};
+
+
+
+	// Answers the leak queries of all sinks at once. A single breadth first search from every source together
+	// (Graph::getDependencyPaths) tells, for each argument of a sink, whether it depends on a secret, its nearest
+	// source and the path from it, which is only rebuilt when asked. The leaked values, the ones on a path from
+	// a source to a sink argument, take one forward and one backward traversal.
+	class LeakQueries {
+
+		public:
+			// A sink argument which depends on a source
+			struct Leak {
+				Instruction *sink;
+				unsigned arg;
+				GraphNode *source;
+				int distance;
+			};
+
+			// \brief Run the traversal from the sources
 			//
-			// \param i Instruction
-			// \return True if yes, false if not
-			bool isGated (Instruction *i);
+			// \param g The dependence graph
+			// \param src The sources of secret information
+			// \param dst The sink calls, whose arguments are queried
+			LeakQueries (Graph *g, const std::vector<Value *> &src, const std::vector<Value *> &dst);
 
-	};
+			// \brief Return the leaks, in the order of the sinks and of their arguments
+			const std::vector<Leak> &getLeaks ();
+
+			// \brief Return the path from the source of a leak to the sink argument, source first
+			std::vector<GraphNode *> getWitness (const Leak &leak);
 
+			// \brief Return the nodes on a path from a source to a sink argument
+			const std::set<GraphNode *> &getLeakedNodes ();
+
+			// \brief Write the leaks, one JSON object per line, with their paths if witness is set
+			void writeJSON (raw_ostream &OS, bool witness);
+
+		private:
+			Graph *g;
+			std::set<Value *> sources;
+			std::set<Value *> sinkArgs;
+			Graph::DependencyPaths paths;
+			std::vector<Leak> leaks;
+			std::set<GraphNode *> leakedNodes;
+			bool leakedNodesDone;
+	};
 
 
 	class bSSA2 : public ModulePass {
@@ -129,7 +207,7 @@ namespace llvm {
 				bool runOnModule(Module&);
 
 				//Method constructor
-				bSSA2() : ModulePass(ID) {optimized = IsOptimized;}
+				bSSA2() : ModulePass(ID), leaks(NULL) {optimized = IsOptimized;}
 
 				//Pass identification
 				static char ID;
@@ -157,6 +235,9 @@ namespace llvm {
 				// Complete depGraph including data and control edges
 				Graph *newGraph;
 
+				// The leak queries on newGraph
+				LeakQueries *leaks;
+
 
 				// \brief Return a set of all tainted values
 				//
@@ -172,18 +253,34 @@ namespace llvm {
 				// Vector of predicates objects
 				std::vector<Pred *> predicatesVector;
 
+				// The predicates that gate all instructions of a basic block, as bits over the predicates of its function
+				DenseMap<BasicBlock *, BitVector> blockPreds;
+
+				// Index in predicatesVector of the first predicate of each function
+				DenseMap<Function *, unsigned> firstPred;
+
+				// \brief Create a predicate and include it on predicatesVector
+				//
+				// \param condition The condition of the branch
+				// \return The predicate
+				Pred *addPred (Value *condition);
+
+				// \brief Gate all instructions of a basic block and the functions it calls with p predicate
+				//
+				// \param BB The basic block
+				// \param p The predicate
+				void gateBlock (BasicBlock *BB, Pred *p);
+
 				// \brief It receives a BasicBLock and makes table of predicates and its respective gated instructions
 				// \param b the initial BasicBlock
-				// \param PD PostDominator Tree
-				void makeTable (BasicBlock *b,  PostDominatorTree& PD );
+				// \param IR Influence regions of the function of b
+				void makeTable (BasicBlock *b, InfluenceRegions &IR);
 
-				// \brief Flooding until reach a posDominator node and gate all instruction with p predicate
+				// \brief Gate all instructions of an influence region with p predicate
 				//
-				// \param borigin Start Basic Block
-				// \param bdst Successor basic block
-				// \para PD PostDominator tree in order to know the imediate post dominator
-				// zpara p Predicate which is used to gate instructions found on IR
-				void findIR (BasicBlock *borigin, BasicBlock *bdst, PostDominatorTree &PD, Pred *p);
+				// \param Region The blocks of the region and the post dominators it stops at
+				// \param p Predicate which is used to gate instructions found on IR
+				void gateRegion (InfluenceRegions::RegionTy &Region, Pred *p);
 
 				// \brief All instrutions of function F are gated with predicate p
 				//
@@ -4,8 +4,9 @@
 
 using namespace llvm;
 
-std::vector<BasicBlock *> ProcessedBB;
-
+static cl::opt<unsigned> flowTrackingThreads("flowtracking-threads",
+		cl::desc("Threads finding the control edges of flowTracking (1)"),
+		cl::init(1));
 
 //Receive a predicate and include it on predicate attribute
 Pred::Pred(Value *p) {
@@ -67,7 +68,6 @@ bool Pred::isGated (Instruction *op) {
 //Passes which are used by bSSA pass
 void bSSA::getAnalysisUsage(AnalysisUsage &AU) const {
 
-		AU.addRequired<PostDominatorTree>();
 		AU.addRequired<moduleDepGraph>();
 
         // This pass will modifies the program, but not the CFG
@@ -81,7 +81,6 @@ void bSSA::getAnalysisUsage(AnalysisUsage &AU) const {
 //For each module, this method is executed
 bool bSSA::runOnModule(Module &M) {
 		moduleDepGraph& DepGraph = getAnalysis<moduleDepGraph>();
-		Function *F;
 		//Getting dependency graph
 		Graph *g = DepGraph.depGraph;
 
@@ -91,17 +90,8 @@ bool bSSA::runOnModule(Module &M) {
 		std::vector<StringRef> srcFileName, dstFileName;
 		std::vector<unsigned> srcLine, dstLine;
 
-		for (Module::iterator Mit = M.begin(), Mend = M.end(); Mit != Mend; ++Mit) {
-			F = Mit;
-			// Iterate over all Basic Blocks of the Function
-			for (Function::iterator Fit = F->begin(), Fend = F->end(); Fit != Fend; ++Fit) {
-				makeTable(Fit, F); //Creating in memory the table with predicates and gated instructions
-			}
-			
-		}
-
-		//Including control edges into dependence graph.
-		incGraph (g);
+		//Creating in memory the table with predicates and gated instructions, and including control edges into dependence graph.
+		incGraph (M, g);
 
 		Instruction *A;
 		StringRef File;
@@ -271,36 +261,107 @@ bool bSSA::runOnModule(Module &M) {
 
 
 //Increase graph including control edges
-void bSSA::incGraph (Graph *g) {
+/// Shared state of the threads finding control edges; each thread claims
+/// the next function until none is left
+struct ControlEdgeTask {
+	bSSA *pass;
+	Graph *g;
+	std::vector<Function *> *functions;
+	std::vector<FunctionGates> *gates;
+	volatile long next;
+};
+
+static void *runControlEdgeJobs(void *arg) {
+	ControlEdgeTask *task = (ControlEdgeTask *) arg;
+	long numFunctions = task->functions->size();
+
+	while (true) {
+		long i = __sync_fetch_and_add(&task->next, 1);
+		if (i >= numFunctions)
+			break;
+		task->pass->findControlEdges((*task->functions)[i], task->g, (*task->gates)[i]);
+	}
+	return 0;
+}
+
+void bSSA::incGraph (Module &M, Graph *g) {
+	std::vector<Function *> functions;
+	for (Module::iterator Mit = M.begin(), Mend = M.end(); Mit != Mend; ++Mit)
+		if (!Mit->isDeclaration())
+			functions.push_back(Mit);
+
+	std::vector<FunctionGates> gates(functions.size());
+
+	ControlEdgeTask task;
+	task.pass = this;
+	task.g = g;
+	task.functions = &functions;
+	task.gates = &gates;
+	task.next = 0;
+
+	std::vector<pthread_t> threads(flowTrackingThreads > 1 ? flowTrackingThreads - 1 : 0);
+	for (unsigned t = 0; t < threads.size(); ++t) {
+		if (pthread_create(&threads[t], 0, runControlEdgeJobs, &task) != 0) {
+			threads.resize(t);
+			break;
+		}
+	}
+	runControlEdgeJobs(&task);
+	for (unsigned t = 0; t < threads.size(); ++t)
+		pthread_join(threads[t], 0);
+
+	//Merge in the order of the module, so the result doesn't depend on
+	//how the functions were scheduled, and insert all edges at once
+	std::vector<std::pair<GraphNode *, GraphNode *> > edges;
+	for (unsigned i = 0; i < gates.size(); i++) {
+		predicatesVector.insert(predicatesVector.end(), gates[i].preds.begin(), gates[i].preds.end());
+		edges.insert(edges.end(), gates[i].edges.begin(), gates[i].edges.end());
+	}
+	g->addEdges(edges, etControl);
+}
+
+//Gate the Influence Regions of the branches of F and list the control edges of its predicates.
+//It only reads the graph and the IR, so the functions can be processed concurrently.
+void bSSA::findControlEdges (Function *F, Graph *g, FunctionGates &gates) {
 	unsigned int i;
-    int j;
+	int j;
 
+	//The pass manager can't be asked for the post dominator tree from several threads
+	DominatorTreeBase<BasicBlock> PD(true);
+	PD.recalculate(*F);
+	InfluenceRegions IR(*F, PD);
 
+	// Iterate over all Basic Blocks of the Function
+	for (Function::iterator Fit = F->begin(), Fend = F->end(); Fit != Fend; ++Fit) {
+		makeTable(Fit, IR, gates.preds);
+	}
 
-	//For all predicates in predicatesVector
-	for (i=0; i<predicatesVector.size(); i++) {
+	//For all predicates of the function
+	for (i=0; i<gates.preds.size(); i++) {
 		//Locates the predicate (icmp instrution) Localiza o predicado (instrução icmp) from the graph
-		GraphNode *predNode = g->findNode(predicatesVector[i]->getPred());
+		GraphNode *predNode = g->findNode(gates.preds[i]->getPred());
+		if (predNode == NULL)
+			continue;
 
 		//For each predicate, iterates on the list of gated INSTRUCTIONS
-		for (j=0; j<predicatesVector[i]->getNumInstrucoes(); j++) {
-			GraphNode *instNode = g->findNode(predicatesVector[i]->getInst(j));
-			if (predNode != NULL && instNode != NULL) {//If the instruction is on the graph, make a edge
-				g->addEdge(predNode, instNode, etControl);
+		for (j=0; j<gates.preds[i]->getNumInstrucoes(); j++) {
+			GraphNode *instNode = g->findNode(gates.preds[i]->getInst(j));
+			if (instNode != NULL) {//If the instruction is on the graph, make a edge
+				gates.edges.push_back(std::make_pair(predNode, instNode));
 			}
 		}
 
 
 		//For each predicate, iterates on the list of gated FUNCTIONS
-		for (j=0; j<predicatesVector[i]->getNumFunctions(); j++) {
-			Function *F = predicatesVector[i]->getFunc(j);
+		for (j=0; j<gates.preds[i]->getNumFunctions(); j++) {
+			Function *G = gates.preds[i]->getFunc(j);
 			//For each function, iterates on its basic blocks
-			for (Function::iterator Fit = F->begin(), Fend = F->end(); Fit != Fend; ++Fit) {
+			for (Function::iterator Fit = G->begin(), Fend = G->end(); Fit != Fend; ++Fit) {
 				//For each basic block, iterates on its instructions
 				for (BasicBlock::iterator bBIt = Fit->begin(), bBEnd = Fit->end(); bBIt != bBEnd; ++bBIt) {
 					GraphNode *instNode = g->findNode(bBIt);
-					if (predNode != NULL && instNode != NULL)
-						g->addEdge(predNode, instNode, etControl);
+					if (instNode != NULL)
+						gates.edges.push_back(std::make_pair(predNode, instNode));
 				}
 			}
 		}
@@ -314,73 +375,51 @@ void bSSA::incGraph (Graph *g) {
 
 
 //It receives a BasicBLock and makes table of predicates and its respective gated instructions
-void bSSA::makeTable (BasicBlock *BB, Function *F) {
-	    Value *condition;
+void bSSA::makeTable (BasicBlock *BB, InfluenceRegions &IR, std::vector<Pred *> &preds) {
   		TerminatorInst *ti = BB->getTerminator();
         BranchInst *bi = NULL;
         SwitchInst *si=NULL;
-
-        PostDominatorTree &PD = getAnalysis<PostDominatorTree>(*F);
-
-        ProcessedBB.clear();
-        if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) { //If the terminator instruction is a conditional branch
-            condition = bi->getCondition();
-            //Including the predicate on the predicatesVector
-            predicatesVector.push_back(new Pred(condition));
-            //Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
-            for (unsigned int i=0; i<bi->getNumSuccessors(); i++) {
-                 findIR (BB, bi->getSuccessor(i),PD);
-            }
-        }else if ((si = dyn_cast<SwitchInst>(ti))) {
-        	condition = si->getCondition();
-		    //Including the predicate on the predicatesVector
-		    predicatesVector.push_back(new Pred(condition));
-		    //Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
-		    for (unsigned int i=0; i<si->getNumSuccessors(); i++) {
-		        findIR (BB, si->getSuccessor(i),PD);
-		    }
-        }
+        Pred *p;
+
+        if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) //If the terminator instruction is a conditional branch
+            p = new Pred(bi->getCondition());
+        else if ((si = dyn_cast<SwitchInst>(ti)))
+            p = new Pred(si->getCondition());
+        else
+            return;
+
+        //Including the predicate on the predicates of the function
+        preds.push_back(p);
+        //Make a "Flooding" on each sucessor gated the instruction on Influence Region of the predicate
+        InfluenceRegions::RegionTy Region;
+        IR.compute(BB, Region);
+        gateRegion(IR, Region, p);
 }
 
 
-//Flooding until reach a posdominator node
-void bSSA::findIR (BasicBlock *bBOring, BasicBlock *bBSuss, PostDominatorTree &PD) {
-
-	Pred *p;
-	TerminatorInst *ti = bBSuss->getTerminator();
-
-
-	//If the basic block has been processed, do not advance
-	for (unsigned int x=0; x<ProcessedBB.size(); x++) {
-		if (ProcessedBB[x] == bBSuss) {
-			return;
-		}
-	}
+//Gate the instructions of the blocks found by the flooding until reach a posdominator node
+void bSSA::gateRegion (InfluenceRegions &IR, InfluenceRegions::RegionTy &Region, Pred *p) {
 
-	//Including the basic block in the processed vector
-	ProcessedBB.push_back(bBSuss);
+	for (unsigned int x=0; x<Region.size(); x++) {
+		BasicBlock *bBSuss = Region[x].first;
 
-	//If the basic block is a posdominator and is not the start basic block, just gate the PHI instructions
-	if (PD.dominates(bBSuss, bBOring) && bBSuss != bBOring) {
-		//Find PHI instructions
-		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end(); bBIt != bBEnd; ++bBIt) {
-			if (dyn_cast<Instruction>(bBIt)->getOpcode()==Instruction::PHI) {
+		//If the basic block is a posdominator, just gate the PHI instructions
+		if (Region[x].second) {
+			for (BasicBlock::iterator bBIt = bBSuss->begin(); isa<PHINode>(bBIt); ++bBIt) {
 				//if there is a PHI's argument gated, gate the PHI instruction
-				p = predicatesVector.back();
-				for (unsigned int k=0; k<dyn_cast<Instruction>(bBIt)->getNumOperands(); k++) {
-					if (p->isGated(dyn_cast<Instruction>(dyn_cast<Instruction>(bBIt)->getOperand(k)))) {
+				for (unsigned int k=0; k<bBIt->getNumOperands(); k++) {
+					Instruction *I = dyn_cast<Instruction>(bBIt->getOperand(k));
+					if (I && IR.isInside(I->getParent())) {
 						p->addInst(bBIt);
 						break;
 					}
 				}
 			}
+			continue;
 		}
-		return;
-	}else { //Advance the flooding
+
 		//Instruction will be gated whit the bBOring predicate
 		for (BasicBlock::iterator bBIt = bBSuss->begin(), bBEnd = bBSuss->end(); bBIt != bBEnd; ++bBIt) {
-			p = predicatesVector.back();
-
 			//If is a function call which is defined on the same module
 			if (CallInst *CI = dyn_cast<CallInst>(&(*bBIt))) {
 				Function *F = CI->getCalledFunction();
@@ -393,10 +432,6 @@ void bSSA::findIR (BasicBlock *bBOring, BasicBlock *bBSuss, PostDominatorTree &P
 			//Gate the other instructions
 			p->addInst(bBIt);
 		}
-		//If there is successor, go there
-		for (unsigned int i=0; i<ti->getNumSuccessors(); i++) {
-			findIR (bBOring, ti->getSuccessor(i), PD);
-		}
 	}
 
 }
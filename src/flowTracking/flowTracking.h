@@ -18,8 +18,11 @@
 #include <vector>
 #include <string>
 #include "../DepGraph/DepGraph.h"
+#include "../bSSA/InfluenceRegion.h"
 #include <sstream>
 #include "llvm/DebugInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include <pthread.h>
 
 #ifndef DEBUG_TYPE
 #define DEBUG_TYPE "bSSA"
@@ -48,6 +51,12 @@ namespace llvm {
 
 
 
+	// The predicates of a function and the control edges they add to the graph
+	struct FunctionGates {
+		std::vector<Pred *> preds;
+		std::vector<std::pair<GraphNode *, GraphNode *> > edges;
+	};
+
 	class bSSA : public ModulePass {
 	public:
         	static char ID;
@@ -55,11 +64,12 @@ namespace llvm {
         	void getAnalysisUsage(AnalysisUsage &AU) const;
         	bool runOnModule(Module&);
         	void printGate ();	//Print the predicates and its respective gated instructions
-        	void incGraph (Graph *g); //Increase graph including control edges
+        	void incGraph (Module &M, Graph *g); //Increase graph including control edges, found for the functions in parallel
+        	void findControlEdges (Function *F, Graph *g, FunctionGates &gates); //Gate the Influence Regions of F and list their control edges; run by several threads
 	private:
         	std::vector<Pred *> predicatesVector;	//Vector of predicates objects
-        	void makeTable (BasicBlock *b, Function *F);
-        	void findIR (BasicBlock *borigin, BasicBlock *bdst, PostDominatorTree &PD);	//Run on Influence Region of basic block borigin gated all instructions
+        	void makeTable (BasicBlock *b, InfluenceRegions &IR, std::vector<Pred *> &preds);
+        	void gateRegion (InfluenceRegions &IR, InfluenceRegions::RegionTy &Region, Pred *p);	//Gate all instructions of the Influence Region of a basic block
         	void gateFunction (Function *F, Pred *p);
 	};
 
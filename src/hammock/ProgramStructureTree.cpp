@@ -0,0 +1,368 @@
+#define DEBUG_TYPE "pst"
+
+#include "ProgramStructureTree.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CFG.h"
+#include <algorithm>
+#include <utility>
+
+using namespace llvm;
+
+STATISTIC(numRegions, "Number of canonical SESE regions");
+
+namespace {
+
+	// An edge of the undirected graph the classes are computed on. The back
+	// edges are also the brackets, so each one has its links in the bracket
+	// list of the node being processed.
+	struct Edge {
+		unsigned U, V;
+		int Class;
+		unsigned RecentSize;
+		int RecentClass;
+		int Prev, Next;
+
+		Edge(unsigned U, unsigned V) : U(U), V(V), Class(-1), RecentSize(0),
+				RecentClass(-1), Prev(-1), Next(-1) {}
+	};
+
+	// Doubly linked list of brackets, through the links of the edges: push,
+	// delete, top and concatenation take constant time
+	struct BracketList {
+		int Head, Tail;
+		unsigned Size;
+
+		BracketList() : Head(-1), Tail(-1), Size(0) {}
+
+		void push(std::vector<Edge> &Edges, unsigned E) {
+			Edges[E].Prev = -1;
+			Edges[E].Next = Head;
+			if (Head >= 0)
+				Edges[Head].Prev = E;
+			else
+				Tail = E;
+			Head = E;
+			++Size;
+		}
+
+		void remove(std::vector<Edge> &Edges, unsigned E) {
+			if (Edges[E].Prev >= 0)
+				Edges[Edges[E].Prev].Next = Edges[E].Next;
+			else
+				Head = Edges[E].Next;
+			if (Edges[E].Next >= 0)
+				Edges[Edges[E].Next].Prev = Edges[E].Prev;
+			else
+				Tail = Edges[E].Prev;
+			--Size;
+		}
+
+		void concat(std::vector<Edge> &Edges, BracketList &Other) {
+			if (Other.Size == 0)
+				return;
+			if (Size == 0) {
+				*this = Other;
+				return;
+			}
+			Edges[Tail].Next = Other.Head;
+			Edges[Other.Head].Prev = Tail;
+			Tail = Other.Tail;
+			Size += Other.Size;
+		}
+	};
+
+}
+
+void ProgramStructureTree::getAnalysisUsage(AnalysisUsage &AU) const {
+	AU.setPreservesAll();
+}
+
+bool ProgramStructureTree::runOnFunction(Function &F) {
+	releaseMemory();
+
+	//Directed depth first preorder of the reachable blocks, and the tree
+	std::vector<BasicBlock *> Blocks;
+	std::vector<unsigned> Parents;
+	SmallVector<std::pair<BasicBlock *, succ_iterator>, 32> Stack;
+	BasicBlock *Entry = &F.getEntryBlock();
+	Numbers[Entry] = 0;
+	Blocks.push_back(Entry);
+	Parents.push_back(0);
+	Stack.push_back(std::make_pair(Entry, succ_begin(Entry)));
+	while (!Stack.empty()) {
+		BasicBlock *BB = Stack.back().first;
+		if (Stack.back().second == succ_end(BB)) {
+			Stack.pop_back();
+			continue;
+		}
+		BasicBlock *Succ = *Stack.back().second++;
+		if (Numbers.count(Succ))
+			continue;
+		Numbers[Succ] = Blocks.size();
+		Blocks.push_back(Succ);
+		Parents.push_back(Numbers[BB]);
+		Stack.push_back(std::make_pair(Succ, succ_begin(Succ)));
+	}
+
+	findClasses(F, Blocks);
+	buildTree(Blocks, Parents);
+	return false;
+}
+
+// Cycle equivalence classes of the block edges, by the bracket list
+// algorithm of Johnson, Pearson and Pingali. Node 0 is the exit, block i
+// has the nodes 2i+1 (in) and 2i+2 (out).
+void ProgramStructureTree::findClasses(Function &F,
+		std::vector<BasicBlock *> &Blocks) {
+	unsigned N = Blocks.size(), NumNodes = 2 * N + 1;
+	std::vector<Edge> Edges;
+	std::vector<std::vector<unsigned> > Adj(NumNodes);
+	std::vector<unsigned> BlockEdge(N);
+
+#define ADD_EDGE(A, B) do { \
+		Adj[A].push_back(Edges.size()); Adj[B].push_back(Edges.size()); \
+		Edges.push_back(Edge(A, B)); } while (0)
+
+	for (unsigned i = 0; i < N; ++i) {
+		BlockEdge[i] = Edges.size();
+		ADD_EDGE(2 * i + 1, 2 * i + 2);
+		for (succ_iterator SI = succ_begin(Blocks[i]), SE = succ_end(Blocks[i]);
+				SI != SE; ++SI)
+			ADD_EDGE(2 * i + 2, 2 * Numbers[*SI] + 1);
+	}
+
+	//The blocks without successors go to the exit. So do the blocks that
+	//can't reach one, stuck in an infinite loop.
+	std::vector<bool> ReachesExit(N, false);
+	std::vector<unsigned> WorkList;
+	for (unsigned i = 0; i < N; ++i)
+		if (succ_begin(Blocks[i]) == succ_end(Blocks[i])) {
+			ReachesExit[i] = true;
+			WorkList.push_back(i);
+		}
+	for (unsigned Next = 0, Stuck = N; ; ) {
+		while (Next < WorkList.size()) {
+			BasicBlock *BB = Blocks[WorkList[Next++]];
+			for (pred_iterator PI = pred_begin(BB), PE = pred_end(BB); PI != PE; ++PI) {
+				DenseMap<BasicBlock *, unsigned>::iterator It = Numbers.find(*PI);
+				if (It != Numbers.end() && !ReachesExit[It->second]) {
+					ReachesExit[It->second] = true;
+					WorkList.push_back(It->second);
+				}
+			}
+		}
+		//Link the last block of the preorder that can't, and go on from it
+		while (Stuck > 0 && ReachesExit[Stuck - 1])
+			--Stuck;
+		if (Stuck == 0)
+			break;
+		--Stuck;
+		ReachesExit[Stuck] = true;
+		WorkList.push_back(Stuck);
+		ADD_EDGE(2 * Stuck + 2, 0u);
+	}
+	for (unsigned i = 0; i < N; ++i)
+		if (succ_begin(Blocks[i]) == succ_end(Blocks[i]))
+			ADD_EDGE(2 * i + 2, 0u);
+	ADD_EDGE(0u, 1u);
+
+#undef ADD_EDGE
+
+	//Undirected depth first search from the exit. A non tree edge always
+	//joins a node and one of its ancestors: it is a back edge.
+	std::vector<int> DfsNum(NumNodes, -1), ParentEdge(NumNodes, -1);
+	std::vector<unsigned> Order;
+	std::vector<std::vector<unsigned> > Children(NumNodes), BackUp(NumNodes),
+			BackDown(NumNodes), CappingDown(NumNodes);
+	SmallVector<std::pair<unsigned, unsigned>, 32> Stack;
+	DfsNum[0] = 0;
+	Order.push_back(0);
+	Stack.push_back(std::make_pair(0u, 0u));
+	while (!Stack.empty()) {
+		unsigned Node = Stack.back().first;
+		if (Stack.back().second == Adj[Node].size()) {
+			Stack.pop_back();
+			continue;
+		}
+		unsigned E = Adj[Node][Stack.back().second++];
+		if ((int) E == ParentEdge[Node])
+			continue;
+		unsigned Other = Edges[E].U == Node ? Edges[E].V : Edges[E].U;
+		if (DfsNum[Other] < 0) {
+			DfsNum[Other] = Order.size();
+			Order.push_back(Other);
+			ParentEdge[Other] = E;
+			Children[Node].push_back(Other);
+			Stack.push_back(std::make_pair(Other, 0u));
+		} else if (DfsNum[Other] < DfsNum[Node]) {
+			BackUp[Node].push_back(E);
+			BackDown[Other].push_back(E);
+		}
+	}
+
+	//Bottom up, the brackets of a node are the back edges from its subtree
+	//over it. A tree edge is equivalent to the edges with the same brackets,
+	//told apart by the top bracket and the size of the list.
+	std::vector<unsigned> Hi(NumNodes);
+	std::vector<BracketList> Lists(NumNodes);
+	int NumClasses = 0;
+	for (unsigned k = Order.size(); k-- > 0; ) {
+		unsigned Node = Order[k];
+
+		unsigned Hi0 = NumNodes;
+		for (unsigned i = 0; i < BackUp[Node].size(); ++i) {
+			Edge &E = Edges[BackUp[Node][i]];
+			Hi0 = std::min(Hi0, (unsigned) DfsNum[E.U == Node ? E.V : E.U]);
+		}
+		unsigned Hi1 = NumNodes, Hi2 = NumNodes;
+		int HiChild = -1;
+		for (unsigned i = 0; i < Children[Node].size(); ++i)
+			if (Hi[Children[Node][i]] < Hi1) {
+				Hi1 = Hi[Children[Node][i]];
+				HiChild = Children[Node][i];
+			}
+		for (unsigned i = 0; i < Children[Node].size(); ++i)
+			if ((int) Children[Node][i] != HiChild)
+				Hi2 = std::min(Hi2, Hi[Children[Node][i]]);
+		Hi[Node] = std::min(Hi0, Hi1);
+
+		BracketList &List = Lists[Node];
+		for (unsigned i = 0; i < Children[Node].size(); ++i)
+			List.concat(Edges, Lists[Children[Node][i]]);
+		for (unsigned i = 0; i < CappingDown[Node].size(); ++i)
+			List.remove(Edges, CappingDown[Node][i]);
+		for (unsigned i = 0; i < BackDown[Node].size(); ++i) {
+			List.remove(Edges, BackDown[Node][i]);
+			if (Edges[BackDown[Node][i]].Class < 0)
+				Edges[BackDown[Node][i]].Class = NumClasses++;
+		}
+		for (unsigned i = 0; i < BackUp[Node].size(); ++i)
+			List.push(Edges, BackUp[Node][i]);
+		if (Hi2 < Hi0) {
+			//Capping back edge, so the brackets of the other children don't
+			//make this node's tree edge look equivalent to an outer one
+			unsigned Capping = Edges.size();
+			Edges.push_back(Edge(Node, Order[Hi2]));
+			CappingDown[Order[Hi2]].push_back(Capping);
+			List.push(Edges, Capping);
+		}
+
+		if (ParentEdge[Node] < 0)
+			continue;
+		Edge &Tree = Edges[ParentEdge[Node]];
+		if (List.Size == 0) {
+			Tree.Class = NumClasses++;
+			continue;
+		}
+		Edge &Top = Edges[List.Head];
+		if (Top.RecentSize != List.Size) {
+			Top.RecentSize = List.Size;
+			Top.RecentClass = NumClasses++;
+		}
+		Tree.Class = Top.RecentClass;
+		if (Top.RecentSize == 1)
+			Top.Class = Tree.Class;
+	}
+
+	BlockClass.resize(N);
+	for (unsigned i = 0; i < N; ++i)
+		BlockClass[i] = Edges[BlockEdge[i]].Class;
+}
+
+// The blocks of a class are ordered by dominance, so taken in preorder any
+// two consecutive ones bound a canonical region. A block is in the region
+// its tree parent is in, after it leaves the region it is the exit of and
+// enters the region it is the entry of.
+void ProgramStructureTree::buildTree(std::vector<BasicBlock *> &Blocks,
+		std::vector<unsigned> &Parents) {
+	unsigned N = Blocks.size();
+	DenseMap<unsigned, unsigned> Last;
+	std::vector<Region *> EntryOf(N, (Region *) 0), ExitOf(N, (Region *) 0);
+	for (unsigned i = 0; i < N; ++i) {
+		DenseMap<unsigned, unsigned>::iterator It = Last.find(BlockClass[i]);
+		if (It != Last.end()) {
+			Region *R = new Region();
+			R->Entry = Blocks[It->second];
+			R->Exit = Blocks[i];
+			R->Parent = 0;
+			R->Depth = 0;
+			Regions.push_back(R);
+			EntryOf[It->second] = R;
+			ExitOf[i] = R;
+		}
+		Last[BlockClass[i]] = i;
+	}
+	numRegions += Regions.size();
+
+	BlockRegion.resize(N);
+	for (unsigned i = 0; i < N; ++i) {
+		Region *R = i == 0 ? &Top : BlockRegion[Parents[i]];
+		if (ExitOf[i]) {
+			while (R != &Top && R != ExitOf[i])
+				R = R->Parent;
+			if (R == ExitOf[i])
+				R = R->Parent;
+		}
+		if (Region *Inner = EntryOf[i]) {
+			Inner->Parent = R;
+			Inner->Depth = R->Depth + 1;
+			R->Children.push_back(Inner);
+			R = Inner;
+		}
+		BlockRegion[i] = R;
+	}
+}
+
+void ProgramStructureTree::releaseMemory() {
+	for (unsigned i = 0; i < Regions.size(); ++i)
+		delete Regions[i];
+	Regions.clear();
+	Numbers.clear();
+	BlockClass.clear();
+	BlockRegion.clear();
+	Top.Entry = Top.Exit = 0;
+	Top.Parent = 0;
+	Top.Depth = 0;
+	Top.Children.clear();
+}
+
+ProgramStructureTree::Region *ProgramStructureTree::getRegionFor(BasicBlock *BB) {
+	DenseMap<BasicBlock *, unsigned>::iterator It = Numbers.find(BB);
+	return It == Numbers.end() ? &Top : BlockRegion[It->second];
+}
+
+bool ProgramStructureTree::contains(Region *R, BasicBlock *BB) {
+	for (Region *S = getRegionFor(BB); S; S = S->Parent)
+		if (S == R)
+			return true;
+	return false;
+}
+
+bool ProgramStructureTree::isSESE(BasicBlock *Entry, BasicBlock *Exit) {
+	DenseMap<BasicBlock *, unsigned>::iterator EntryIt = Numbers.find(Entry),
+			ExitIt = Numbers.find(Exit);
+	if (EntryIt == Numbers.end() || ExitIt == Numbers.end())
+		return false;
+	return BlockClass[EntryIt->second] == BlockClass[ExitIt->second]
+			&& EntryIt->second < ExitIt->second;
+}
+
+void ProgramStructureTree::printRegion(raw_ostream &OS, const Region *R) const {
+	OS.indent(2 * R->Depth) << "[" << R->Depth << "] ";
+	if (R == &Top)
+		OS << "function\n";
+	else
+		OS << R->Entry->getName() << " => " << R->Exit->getName() << "\n";
+	for (unsigned i = 0; i < R->Children.size(); ++i)
+		printRegion(OS, R->Children[i]);
+}
+
+void ProgramStructureTree::print(raw_ostream &OS, const Module *) const {
+	printRegion(OS, &Top);
+}
+
+char ProgramStructureTree::ID = 0;
+static RegisterPass<ProgramStructureTree> X("pst",
+		"Program structure tree (SESE regions)", false, true);
@@ -0,0 +1,74 @@
+//===- ProgramStructureTree.h - SESE regions of a function ------------------*- C++ -*-===//
+#ifndef LLVM_PROGRAMSTRUCTURETREE_H
+#define LLVM_PROGRAMSTRUCTURETREE_H
+
+#include "llvm/Pass.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Function.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+namespace llvm {
+
+	// The program structure tree of a function: its canonical single entry,
+	// single exit regions and how they nest (Johnson, Pearson and Pingali,
+	// PLDI'94). Every block is split in an in and an out node linked by a
+	// "block edge", and the CFG gets an edge from its exits back to the
+	// entry. Two block edges are cycle equivalent when every cycle through
+	// one goes through the other; then the first block dominates the second
+	// and the second post dominates the first, and the blocks between them
+	// form a SESE region. One undirected depth first search with bracket
+	// lists finds the classes of all edges, so the tree takes linear time.
+	//
+	// A region holds its entry block and the blocks up to, not including,
+	// its exit block, like the regions of RegionInfo. The top region is the
+	// whole function and has no entry nor exit.
+	class ProgramStructureTree : public FunctionPass {
+
+	public:
+		struct Region {
+			BasicBlock *Entry;
+			BasicBlock *Exit;
+			Region *Parent;
+			unsigned Depth;
+			std::vector<Region *> Children;
+		};
+
+		static char ID;
+		ProgramStructureTree() : FunctionPass(ID) {}
+
+		bool runOnFunction(Function &F);
+		void getAnalysisUsage(AnalysisUsage &AU) const;
+		void releaseMemory();
+		void print(raw_ostream &OS, const Module *) const;
+
+		Region *getTopRegion() { return &Top; }
+
+		// The innermost region of BB; the top region for the unreachable blocks
+		Region *getRegionFor(BasicBlock *BB);
+
+		// Whether R holds BB, directly or in a nested region
+		bool contains(Region *R, BasicBlock *BB);
+
+		// Whether the blocks from Entry up to Exit form a SESE region: a
+		// canonical one or a sequence of canonical siblings
+		bool isSESE(BasicBlock *Entry, BasicBlock *Exit);
+
+	private:
+		Region Top;
+		std::vector<Region *> Regions;
+		// Directed depth first preorder of the reachable blocks
+		DenseMap<BasicBlock *, unsigned> Numbers;
+		// Cycle equivalence class of the block edge of each of those blocks
+		std::vector<unsigned> BlockClass;
+		std::vector<Region *> BlockRegion;
+
+		void findClasses(Function &F, std::vector<BasicBlock *> &Blocks);
+		void buildTree(std::vector<BasicBlock *> &Blocks,
+				std::vector<unsigned> &Parents);
+		void printRegion(raw_ostream &OS, const Region *R) const;
+	};
+
+}
+
+#endif
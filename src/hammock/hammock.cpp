@@ -7,6 +7,7 @@ using namespace llvm;
 
 void hammock::getAnalysisUsage(AnalysisUsage &AU) const {
 		AU.addRequired<PostDominatorTree>();
+		AU.addRequired<ProgramStructureTree>();
         // This pass will not modifies the program nor CFG
         AU.setPreservesAll();
 
@@ -18,93 +19,31 @@ bool hammock::runOnFunction(Function &F) {
 		functionIsHammock = true;
 
 		PostDominatorTree &PD = getAnalysis<PostDominatorTree>();
+		ProgramStructureTree &PST = getAnalysis<ProgramStructureTree>();
 		for (Function::iterator Fit = F.begin(), Fend = F.end(); Fit != Fend; ++Fit) {
-			//Mark BasicBlock
-			bBlocks.insert(Fit);
-			//Find Influence Region of the BasicBlock
-			processNode(Fit, PD);
+			TerminatorInst *ti = Fit->getTerminator();
+			if (ti->getNumSuccessors() < 2)
+				continue;
 			//Check if some unmarked basic block goes to influence region
-			if (checkHammock(F)) {
+			if (checkHammock(Fit, PD, PST)) {
 					++numHammock;
 
 			} else {
 					++numNonHammock;
 					functionIsHammock = false;
 			}
-			//Unmark all nodes
-			bBlocks.empty();
 		}
 
 	return false;
 }
 
-//Return true if the subgraph denoted by bBlocks set attribute is a hammock graph
-bool hammock::checkHammock (Function &F) {
-	//For each basicBlock
-	for (Function::iterator Fit = F.begin(), Fend = F.end(); Fit != Fend; ++Fit) {
-		TerminatorInst *ti = Fit->getTerminator();
-
-		if (bBlocks.count(Fit)==0) { //If it is out of subgraph
-			//Check if some respective successor is marked
-			for (unsigned int i=0; i<ti->getNumSuccessors(); i++) {
-				if (bBlocks.count(ti->getSuccessor(i))>0) {
-					return false;
-				}
-			}
-		}else { /*//If it is in subgrah
-			//Check if some respective successor is NOT marked
-			for (unsigned int i=0; i<ti->getNumSuccessors(); i++) {
-				if (bBlocks.count(ti->getSuccessor(i))==0) {
-					return false;
-				}
-			}*/
-		}
-	}
-
-	return true;
-}
-
-//Start findIR method
-void hammock::processNode (BasicBlock *BB,  PostDominatorTree &PD ) {
-
-  		TerminatorInst *ti = BB->getTerminator();
-        BranchInst *bi = NULL;
-        SwitchInst *si=NULL;
-
-
-        if ((bi = dyn_cast<BranchInst>(ti)) && bi->isConditional()) { //If the terminator instruction is a conditional branch
-            for (unsigned int i=0; i<bi->getNumSuccessors(); i++) {
-                 findIR (BB, bi->getSuccessor(i),PD);
-            }
-        }else if ((si = dyn_cast<SwitchInst>(ti))) {
-		    for (unsigned int i=0; i<si->getNumSuccessors(); i++) {
-		        findIR (BB, si->getSuccessor(i),PD);
-		    }
-        }
-}
-
-void hammock::findIR (BasicBlock *bBOring, BasicBlock *bBSuss, PostDominatorTree &PD) {
-
-	TerminatorInst *ti = bBSuss->getTerminator();
-
-
-	if (bBlocks.count(bBSuss)>0) {
-		return;
-	}
-
-	//Mark BasicBlock
-	bBlocks.insert(bBSuss);
-
-	//If the basic block is a posdominator and is not the start basic block, just return
-	if (PD.dominates(bBSuss, bBOring) && bBSuss != bBOring) {
-		return;
-	}else { //Advance the flooding
-		//If there is successor, go there
-		for (unsigned int i=0; i<ti->getNumSuccessors(); i++) {
-			findIR (bBOring, ti->getSuccessor(i), PD);
-		}
-	}
-
+//Return true if the influence region of the branch of BB, up to its immediate post dominator, is a hammock graph:
+//the SESE region from BB to the post dominator, that no block out of it jumps into
+bool hammock::checkHammock (BasicBlock *BB, PostDominatorTree &PD, ProgramStructureTree &PST) {
+	DomTreeNode *node = PD.getNode(BB);
+	if (node == NULL || node->getIDom() == NULL || node->getIDom()->getBlock() == NULL)
+		return false;
+	return PST.isSESE(BB, node->getIDom()->getBlock());
 }
 
 char hammock::ID = 0;
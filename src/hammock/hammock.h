@@ -28,6 +28,7 @@
 #include "llvm/Operator.h"
 #include "llvm/Constant.h"
 #include "llvm/Constants.h"
+#include "ProgramStructureTree.h"
 
 
 namespace llvm {
@@ -46,11 +47,8 @@ namespace llvm {
 
 
 	private:
-        	bool checkHammock (Function &f); //return true if the subgraph denoted by bBlocks set, is a hammock graph
         	void getAnalysisUsage(AnalysisUsage &AU) const;
-        	std::set<BasicBlock*> bBlocks;	//set which contains basic blocks in the influence region of an basic block
-        	void processNode(BasicBlock *BB,  PostDominatorTree &PD); //start findIR
-        	void findIR(BasicBlock *bBOring, BasicBlock *bBSuss, PostDominatorTree &PD); //create a subgraph in bBlocks set from an initial basic block
+        	bool checkHammock (BasicBlock *BB, PostDominatorTree &PD, ProgramStructureTree &PST); //return true if the influence region of the branch of BB is a hammock graph
 
 
  	};
@@ -24,6 +24,7 @@
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 #include "../../AliasSets/AliasSets.h"
 #include <set>
@@ -39,6 +40,13 @@ STATISTIC(NNoAlias, "Number of no alias results");
 STATISTIC(NMayAlias, "Number of may alias results");
 STATISTIC(NPartialAlias, "Number of partial alias results");
 STATISTIC(NMustAlias, "Number of must alias results");
+STATISTIC(NCacheHits, "Number of alias queries answered by the cache");
+STATISTIC(NCacheMisses, "Number of alias queries computed");
+
+static cl::opt<unsigned>
+SEAACacheSize("seaa-cache-size",
+  cl::desc("Alias query results cached per function; 0 disables the cache"),
+  cl::init(4096));
 
 namespace {
   /// ScalarEvolutionAliasAnalysis - This is a simple alias analysis
@@ -47,9 +55,22 @@ namespace {
                                        public AliasAnalysis {
     ScalarEvolution *SE;
 
+    // Results of the queries of the current function, keyed by both
+    // locations. Emptied for every function, when a value is deleted and
+    // when it holds SEAACacheSize results.
+    typedef std::pair<std::pair<const Value*, const Value*>,
+                      std::pair<std::pair<uint64_t, uint64_t>,
+                                std::pair<const MDNode*, const MDNode*> > >
+      QueryKey;
+    DenseMap<QueryKey, AliasResult> QueryCache;
+
+    // The module wide counts are taken on the first function
+    bool CountedSets;
+
   public:
     static char ID; // Class identification, replacement for typeinfo
-    ScalarEvolutionAliasAnalysis() : FunctionPass(ID), SE(0) {
+    ScalarEvolutionAliasAnalysis() : FunctionPass(ID), SE(0),
+                                     CountedSets(false) {
       initializeScalarEvolutionAliasAnalysisPass(
         *PassRegistry::getPassRegistry());
         NInterestingSets = 0;
@@ -75,6 +96,9 @@ namespace {
     virtual void getAnalysisUsage(AnalysisUsage &AU) const;
     virtual bool runOnFunction(Function &F);
     virtual AliasResult alias(const Location &LocA, const Location &LocB);
+    virtual void deleteValue(Value *V);
+
+    AliasResult computeAlias(const Location &LocA, const Location &LocB);
 
     Value *GetBaseValue(const SCEV *S);
   };
@@ -107,44 +131,30 @@ bool
 ScalarEvolutionAliasAnalysis::runOnFunction(Function &F) {
   InitializeAliasAnalysis(this);
   SE = &getAnalysis<ScalarEvolution>();
+  QueryCache.clear();
   
   AliasSets &AS = getAnalysis<AliasSets>();
-  llvm::DenseMap<int, std::set<Value*> > AliasSets = AS.getValueSets();
+  if (!CountedSets) {
+  	CountedSets = true;
+  	const llvm::DenseMap<int, std::set<Value*> > &AliasSets = AS.getValueSets();
   	////////Our Alias Sets
   	NAliasSets = 0;//AliasSets.size();//statistics
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = AliasSets.begin(), e = AliasSets.end(); 
+	for (llvm::DenseMap<int, std::set<Value*> >::const_iterator i = AliasSets.begin(), e = AliasSets.end(); 
 	i != e; ++i) if(i->second.size() > 0) NAliasSets++;
-	////////Finding interesting sets
-	llvm::DenseMap<int, std::set<Value*> > InterestingSets;
-	int ISi = 0;
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator aai = AliasSets.begin(), aae = AliasSets.end(); 
-	aai != aae; ++aai){
-		bool mark = true;
-		for(std::set<Value*>::iterator si = aai->second.begin(), se = aai->second.end(); si != se; si++){
-			bool mark2 = false;
-			for(Function::iterator bb = F.begin(), bbEnd = F.end(); bb != bbEnd; ++bb){
-				for(BasicBlock::iterator I = bb->begin(), IEnd = bb->end(); I != IEnd; ++I){
-					if((*si) == I) mark2 = true;
-				}
-			}
-			if(mark2 == false){
-				mark = false;
-				break;
-			}
-		}
-		if((mark == true)&&(aai->second.size() > 1)){
-				ISi++;
-				InterestingSets[ISi] = aai->second;
-		}
-	}
+  }
+	////////Finding interesting sets: those of more than one value, all of
+	////////them instructions of F. AliasSets indexes them for the whole
+	////////module on the first query.
+	const std::vector<int> &InterestingSets = AS.getLocalSets(&F);
+	int ISi = InterestingSets.size();
 	NInterestingSets += InterestingSets.size();
 	
 	/*//printing interesting sets
 	errs() << "Insteresting Sets" << "\n";	
-	for (llvm::DenseMap<int, std::set<Value*> >::iterator i = InterestingSets.begin(), e = InterestingSets.end(); 
-	i != e; ++i) {
-        errs() << "Set " << i->first << "\n";
-        for (std::set<Value*>::iterator ii = i->second.begin(), ee = i->second.end(); 
+	for (unsigned i = 0; i < InterestingSets.size(); ++i) {
+        errs() << "Set " << InterestingSets[i] << "\n";
+        const std::set<Value*> &Set = AS.getValueSet(InterestingSets[i]);
+        for (std::set<Value*>::const_iterator ii = Set.begin(), ee = Set.end(); 
         ii != ee; ++ii) {
 
             errs() << "	" << **ii << "\n";
@@ -153,13 +163,11 @@ ScalarEvolutionAliasAnalysis::runOnFunction(Function &F) {
         errs() << "\n";
 	}*/
 	
-	llvm::DenseMap<int, std::set<Value*> >::iterator i = InterestingSets.begin();
-	
 	llvm::DenseMap<int, Value* > list;
 	int iii = 0;
 	if(ISi > 0)
-	for (std::set<Value*>::iterator ii = i->second.begin(), ee = i->second.end(); 
-   ii != ee; ++ii) {
+	for (std::set<Value*>::const_iterator ii = AS.getValueSet(InterestingSets[0]).begin(),
+   ee = AS.getValueSet(InterestingSets[0]).end(); ii != ee; ++ii) {
 		errs() << **ii << "\n";
 		list[iii] = *ii;
 		iii++;
@@ -206,6 +214,36 @@ ScalarEvolutionAliasAnalysis::GetBaseValue(const SCEV *S) {
 AliasAnalysis::AliasResult
 ScalarEvolutionAliasAnalysis::alias(const Location &LocA,
                                     const Location &LocB) {
+  if (SEAACacheSize == 0)
+    return computeAlias(LocA, LocB);
+
+  QueryKey Key(std::make_pair(LocA.Ptr, LocB.Ptr),
+               std::make_pair(std::make_pair(LocA.Size, LocB.Size),
+                              std::make_pair(LocA.TBAATag, LocB.TBAATag)));
+  DenseMap<QueryKey, AliasResult>::iterator It = QueryCache.find(Key);
+  if (It != QueryCache.end()) {
+    NCacheHits++;
+    return It->second;
+  }
+
+  NCacheMisses++;
+  AliasResult R = computeAlias(LocA, LocB);
+  // computeAlias may have filled the cache with the queries it forwarded
+  if (QueryCache.size() >= SEAACacheSize)
+    QueryCache.clear();
+  QueryCache[Key] = R;
+  return R;
+}
+
+void ScalarEvolutionAliasAnalysis::deleteValue(Value *V) {
+  // A new value may take the address of the deleted one
+  QueryCache.clear();
+  AliasAnalysis::deleteValue(V);
+}
+
+AliasAnalysis::AliasResult
+ScalarEvolutionAliasAnalysis::computeAlias(const Location &LocA,
+                                           const Location &LocB) {
   // If either of the memory references is empty, it doesn't matter what the
   // pointer values are. This allows the code below to ignore this special
   // case.
@@ -0,0 +1,165 @@
+#! /usr/bin/env python3
+#
+# Writes a synthetic C program of a given shape, for the scalability sweeps
+# of sweep.py: clang and the pipeline of the Makefile turn it into the
+# module the analyses run on. The program is never run, only analyzed.
+#
+#   gen_module.py --functions 200 --statements 50 --loop-depth 2 \
+#       --scc-size 4 --pointer-density 0.4 --fan-out 3 -o prog.c
+#
+# Each function takes an integer and a pointer, keeps a few integer and
+# pointer locals, and runs its statements inside --loop-depth nested loops:
+#
+#   --statements       statements of each function
+#   --pointer-density  fraction of them that are pointer operations (copies,
+#                      selects, arithmetic, loads, stores, mallocs), the
+#                      rest being integer arithmetic and comparisons
+#   --scc-size         the functions make recursive cycles of this size,
+#                      each calling the next one of its cycle
+#   --fan-out          calls of each function to functions of later cycles,
+#                      so the call graph between cycles stays acyclic
+#
+# The same arguments and --seed give the same program.
+
+import argparse
+import random
+import sys
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Write a synthetic C program of a given shape')
+    parser.add_argument('--functions', type=int, default=100)
+    parser.add_argument('--statements', type=int, default=50)
+    parser.add_argument('--loop-depth', type=int, default=1)
+    parser.add_argument('--scc-size', type=int, default=1)
+    parser.add_argument('--pointer-density', type=float, default=0.3)
+    parser.add_argument('--fan-out', type=int, default=2)
+    parser.add_argument('--locals', type=int, default=8,
+                        help='integer and pointer locals of each function')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('-o', '--output', default='-')
+    return parser.parse_args()
+
+
+class Function:
+    def __init__(self, args, rng, index):
+        self.args = args
+        self.rng = rng
+        self.index = index
+
+    def int_var(self):
+        return 'x%d' % self.rng.randrange(self.args.locals)
+
+    def ptr_var(self):
+        return 'q%d' % self.rng.randrange(self.args.locals)
+
+    def pointer_statement(self):
+        rng = self.rng
+        kind = rng.randrange(6)
+        if kind == 0:
+            return '%s = %s;' % (self.ptr_var(), self.ptr_var())
+        if kind == 1:
+            return '%s = (%s & 1) ? %s : %s;' % (
+                self.ptr_var(), self.int_var(), self.ptr_var(), self.ptr_var())
+        if kind == 2:
+            return '%s = %s + (%s & 7);' % (
+                self.ptr_var(), self.ptr_var(), self.int_var())
+        if kind == 3:
+            return '%s = *%s;' % (self.int_var(), self.ptr_var())
+        if kind == 4:
+            return '*%s = %s;' % (self.ptr_var(), self.int_var())
+        return '%s = (int*)malloc(sizeof(int) * %d);' % (
+            self.ptr_var(), rng.randrange(1, 64))
+
+    def int_statement(self):
+        rng = self.rng
+        kind = rng.randrange(4)
+        if kind == 0:
+            return '%s = %s + %s;' % (self.int_var(), self.int_var(),
+                                     self.int_var())
+        if kind == 1:
+            return '%s = %s * %d - %s;' % (self.int_var(), self.int_var(),
+                                          rng.randrange(1, 9), self.int_var())
+        if kind == 2:
+            return 'if (%s < %s) %s = %s - 1;' % (
+                self.int_var(), self.int_var(), self.int_var(), self.int_var())
+        return '%s = %s %% %d;' % (self.int_var(), self.int_var(),
+                                   rng.randrange(2, 17))
+
+    def statement(self):
+        if self.rng.random() < self.args.pointer_density:
+            return self.pointer_statement()
+        return self.int_statement()
+
+    def write(self, out, callees):
+        args = self.args
+        out.write('int f%d(int a, int* p) {\n' % self.index)
+        for v in range(args.locals):
+            out.write('  int x%d = a + %d;\n' % (v, v))
+            out.write('  int* q%d = p;\n' % v)
+
+        indent = '  '
+        for d in range(args.loop_depth):
+            out.write('%sfor (int i%d = 0; i%d < a; i%d++) {\n' % (
+                indent, d, d, d))
+            indent += '  '
+            out.write('%sx%d += i%d;\n' % (indent, d % args.locals, d))
+        for s in range(args.statements):
+            out.write('%s%s\n' % (indent, self.statement()))
+        for d in range(args.loop_depth):
+            indent = indent[:-2]
+            out.write('%s}\n' % indent)
+
+        for callee, recursive in callees:
+            x, q = self.int_var(), self.ptr_var()
+            if recursive:
+                out.write('  if (a > 0)\n  ')
+                out.write('  %s = f%d(a - 1, %s);\n' % (x, callee, q))
+            else:
+                out.write('  %s = f%d(%s, %s);\n' % (x, callee, x, q))
+        out.write('  return %s;\n}\n\n' % self.int_var())
+
+
+def main():
+    args = parse_args()
+    args.locals = max(args.locals, 1)
+    args.scc_size = max(args.scc_size, 1)
+    rng = random.Random(args.seed)
+    out = sys.stdout if args.output == '-' else open(args.output, 'w')
+
+    n = args.functions
+    out.write('/* gen_module.py --functions %d --statements %d --loop-depth %d '
+              '--scc-size %d --pointer-density %g --fan-out %d --locals %d '
+              '--seed %d */\n' % (
+                  n, args.statements, args.loop_depth, args.scc_size,
+                  args.pointer_density, args.fan_out, args.locals, args.seed))
+    out.write('#include <stdlib.h>\n\n')
+    for i in range(n):
+        out.write('int f%d(int a, int* p);\n' % i)
+    out.write('\n')
+
+    for i in range(n):
+        cycle = i // args.scc_size
+        first = cycle * args.scc_size
+        last = min(first + args.scc_size, n)
+        callees = []
+        if last - first > 1:
+            callees.append((first + (i - first + 1) % (last - first), True))
+        if last < n:
+            for c in range(args.fan_out):
+                callees.append((rng.randrange(last, n), False))
+        Function(args, rng, i).write(out, callees)
+
+    out.write('int main(int argc, char** argv) {\n')
+    out.write('  int* p = (int*)malloc(sizeof(int) * argc);\n  int r = 0;\n')
+    for first in range(0, n, args.scc_size):
+        out.write('  r += f%d(argc, p);\n' % first)
+    out.write('  return r;\n}\n')
+
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
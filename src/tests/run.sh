@@ -0,0 +1,197 @@
+#! /usr/bin/env bash
+#
+# Runs the analyses over the bitcode of build/, as the Makefile builds it:
+#
+#   run.sh check   region-analysis on reg/, sra on sra/ and ra-check-elim on
+#                  rce/, against their .sym files; every analysis on every
+#                  program against expected/<analysis>.<program>, when it
+#                  exists. Prints one line per run and fails if any output
+#                  differs.
+#   run.sh bless   writes expected/<analysis>.<program> from the current
+#                  outputs, for the analyses a later change must not alter.
+#   run.sh bench   runs every analysis on every program, the scaled
+#                  variants included, and adds to history.tsv, in tab
+#                  separated columns: the date, the commit, the analysis, the
+#                  program, the wall time in seconds, the peak RSS in KB and
+#                  whether the output matched (ok, diff, new or failed).
+#   run.sh validate
+#                  runs each analysis of VARIANTS twice on every program,
+#                  with the flags of its reference engine and with those of
+#                  the candidate one, and compares the two outputs. Prints
+#                  the times, the speedup and the ratio of peak RSS of the
+#                  candidate, and fails if any output differs; the diff is
+#                  left in build/out/<analysis>.<program>.diff. REF_FLAGS
+#                  and NEW_FLAGS replace the flags of every variant, and
+#                  ONLY=<analysis>,... picks the analyses.
+#
+# The output of an analysis is what opt -analyze prints for it: the
+# points-to sets of pa, the ranges of every value of ra, sra and region,
+# the tainted values of tfa, the comparisons that rce folds; and -stats for
+# depgraph, which prints nothing, so that a change that alters the results
+# shows up as a diff.
+# Lines are sorted before comparing them: the order the analyses print in
+# is not part of their result.
+
+MODE=${1:-check}
+OPT=${OPT:-opt}
+SO_DIR=${SO_DIR:-../obj}
+GA_SO=${GA_SO:-$SO_DIR/MemorySafetyOpt.so}
+
+cd "$(dirname "$0")"
+
+CORE="-load $SO_DIR/PADriver.so -load $SO_DIR/AliasSets.so"
+INPUT="-load $SO_DIR/InputValues.so -load $SO_DIR/LibraryModels.so -load $SO_DIR/DepGraph.so"
+TAINT="$INPUT -load $SO_DIR/bSSA.so -load $SO_DIR/TFA.so"
+
+# analysis name, opt arguments
+ANALYSES=(
+  "pa:$CORE -pa -analyze"
+  "depgraph:$CORE -load $SO_DIR/LibraryModels.so -load $SO_DIR/DepGraph.so -moduleDepGraph -stats"
+  "tfa:$CORE $TAINT -tfa -analyze"
+  "ra:-load $SO_DIR/ArAnot.so -ra-inter-cousot -analyze"
+  "rce:-load $SO_DIR/ArAnot.so -ra-check-elim -analyze"
+  "sra:$CORE $TAINT -load $GA_SO -sra -analyze"
+  "region:$CORE $TAINT -load $GA_SO -region-analysis -analyze"
+)
+
+# analysis name|flags of the reference engine|flags of the candidate, for
+# validate: the engines that must give the same results
+VARIANTS=(
+  "pa|-pa-cycles=none|-pa-cycles=hybrid -pa-diff-propagation -pa-offline-substitution"
+  "depgraph|-depgraph-threads=1|-depgraph-threads=4"
+  "tfa|-depgraph-threads=1|-depgraph-threads=4 -depgraph-reach-index"
+  "ra|-ra-threads=1|-ra-threads=4 -ra-batch-eval"
+  "sra|-sra-worklist=false|-sra-worklist"
+)
+
+# The result lines of an output, sorted: the lines "x = range" of the range
+# and region analyses, every line but the banners for the others
+normalize() {
+  case $1 in
+    sra|region|rce) grep ' = ' "$2" | sort ;;
+    *) grep -v '^Printing analysis\|^====\|^$\|Statistics Collected\|^---' "$2" |
+         sed 's/^ *//' | sort ;;
+  esac
+}
+
+# The opt arguments of an analysis
+analysis_args() {
+  for entry in "${ANALYSES[@]}"; do
+    [ "${entry%%:*}" = "$1" ] && echo "${entry#*:}"
+  done
+}
+
+# Runs opt with the arguments after the first two on bitcode $1, output
+# to $2; sets status, seconds and rss
+run_opt() {
+  local bc=$1 out=$2
+  shift 2
+  /usr/bin/time -f "%e %M" -o build/out/time $OPT "$@" "$bc" \
+    -o /dev/null > "$out" 2>&1
+  status=$?
+  read seconds rss < <(tail -n 1 build/out/time)
+}
+
+FAILED=0
+COMMIT=$(git rev-parse --short HEAD 2> /dev/null || echo -)
+DATE=$(date +%Y-%m-%dT%H:%M:%S)
+mkdir -p expected build/out
+if [ "$MODE" = bench ] && [ ! -f history.tsv ]; then
+  printf "date\tcommit\tanalysis\tprogram\tseconds\tpeak_rss_kb\tresult\n" \
+    > history.tsv
+fi
+
+if [ "$MODE" = validate ]; then
+  printf "%-8s %-32s %9s %9s %8s %8s  %s\n" analysis program reference \
+    candidate speedup rss result
+  for bc in build/*.bc; do
+    program=$(basename "$bc" .bc)
+    case $program in *.O0|*.main|*.copy*|*.x[0-9]*) continue ;; esac
+
+    for variant in "${VARIANTS[@]}"; do
+      IFS='|' read analysis ref new <<< "$variant"
+      [ -n "$ONLY" ] && [[ ",$ONLY," != *",$analysis,"* ]] && continue
+      [ -n "$REF_FLAGS" ] && ref=$REF_FLAGS
+      [ -n "$NEW_FLAGS" ] && new=$NEW_FLAGS
+      args=$(analysis_args $analysis)
+      out=build/out/$analysis.$program
+
+      run_opt "$bc" $out.ref $args $ref
+      ref_status=$status ref_seconds=$seconds ref_rss=$rss
+      run_opt "$bc" $out.new $args $new
+
+      speedup=- ratio=-
+      if [ $ref_status != 0 ] || [ $status != 0 ]; then
+        result=failed
+      elif diff <(normalize $analysis $out.ref) <(normalize $analysis $out.new) \
+          > $out.diff; then
+        result=same
+        rm -f $out.diff
+      else
+        result=diff
+      fi
+      if [ $result != failed ]; then
+        speedup=$(awk -v r=$ref_seconds -v n=$seconds \
+          'BEGIN { if (n > 0) printf "%.2fx", r / n; else printf "-" }')
+        ratio=$(awk -v r=$ref_rss -v n=$rss \
+          'BEGIN { if (r > 0) printf "%.2f", n / r; else printf "-" }')
+      fi
+      case $result in failed|diff) FAILED=1 ;; esac
+      printf "%-8s %-32s %8ss %8ss %8s %8s  %s\n" $analysis $program \
+        $ref_seconds $seconds $speedup $ratio $result
+    done
+  done
+  exit $FAILED
+fi
+
+for bc in build/*.bc; do
+  program=$(basename "$bc" .bc)
+  case $program in *.O0|*.main|*.copy*) continue ;; esac
+  scaled=0
+  case $program in *.x[0-9]*) scaled=1 ;; esac
+  # The scaled variants are only timed
+  [ "$MODE" != bench ] && [ $scaled = 1 ] && continue
+
+  for entry in "${ANALYSES[@]}"; do
+    analysis=${entry%%:*}
+    args=${entry#*:}
+
+    # The .sym files hold the results of the region analysis for reg/, of
+    # the symbolic range analysis for sra/ and of ra-check-elim for rce/
+    sym=""
+    case $analysis:$program in
+      region:reg.*) sym=reg/${program#reg.}.sym ;;
+      sra:sra.*) sym=sra/${program#sra.}.sym ;;
+      rce:rce.*) sym=rce/${program#rce.}.sym ;;
+    esac
+    golden=expected/$analysis.$program
+    [ -n "$sym" ] && golden=$sym
+
+    out=build/out/$analysis.$program
+    run_opt "$bc" "$out" $args
+
+    if [ $status != 0 ]; then
+      result=failed
+    elif [ "$MODE" = bless ] && [ -z "$sym" ]; then
+      normalize $analysis "$out" > "$golden"
+      result=blessed
+    elif [ ! -f "$golden" ]; then
+      result=new
+    elif diff -q <(normalize $analysis "$golden") \
+        <(normalize $analysis "$out") > /dev/null; then
+      result=ok
+    else
+      result=diff
+    fi
+
+    case $result in failed|diff) FAILED=1 ;; esac
+    if [ "$MODE" = bench ]; then
+      printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\n" "$DATE" "$COMMIT" "$analysis" \
+        "$program" "$seconds" "$rss" "$result" >> history.tsv
+    fi
+    printf "%-8s %-40s %8ss %8sKB  %s\n" "$analysis" "$program" "$seconds" \
+      "$rss" "$result"
+  done
+done
+
+exit $FAILED
@@ -0,0 +1,139 @@
+#! /usr/bin/env python3
+#
+# Joins the site reports of ga-asan (-ga-asan-site-counts) and of the
+# overflow sanitizer (-overflow-sanitizer-site-counts) with the counts their
+# sites got at run time (see GreenArrays/SiteCounters.h), to see where the
+# checks that are left cost, and whether the checks removed were hot:
+#
+#   opt ... -ga-asan -ga-asan-asi -ga-asan-site-counts=prog.sites.json ...
+#   ./prog < input
+#   site_counts.py prog.sites.json --top 20 --output prog.sites.tsv
+#
+# For each tool and reason, the sites, the sites executed and their
+# executions; then the checked sites that ran the most, the candidates for a
+# new proof, and the removed sites that ran the most, those whose proof pays
+# off. The counts files are found where the reports say, or, as at run time,
+# in $GA_SITE_COUNTS (--counts-dir). --output keeps every site, one tab
+# separated line each.
+
+import argparse
+import json
+import os
+import struct
+import sys
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Rank the sites of the sanitizers by their run-time counts')
+    parser.add_argument('reports', nargs='+',
+                        help='the site reports written at compile time')
+    parser.add_argument('--counts-dir',
+                        default=os.environ.get('GA_SITE_COUNTS'),
+                        help='the directory of the counts files')
+    parser.add_argument('--top', type=int, default=10,
+                        help='sites listed in each ranking')
+    parser.add_argument('--output', default=None)
+    return parser.parse_args()
+
+
+def read_sites(path, counts_dir):
+    """The sites of a report, each with the count of its run-time file;
+    None if the file isn't the one of this report."""
+    with open(path) as f:
+        report = json.load(f)
+    sites = report['sites']
+    counts = report['counts']
+    if counts_dir:
+        counts = os.path.join(counts_dir, os.path.basename(counts))
+
+    values = [0] * len(sites)
+    if not os.path.exists(counts):
+        sys.stderr.write('%s: no counts in %s; was the program run?\n' % (
+            path, counts))
+    else:
+        with open(counts, 'rb') as f:
+            data = f.read()
+        if len(data) != 8 * len(sites):
+            sys.stderr.write('%s: %s has %d counts, for %d sites; rebuilt '
+                             'since?\n' % (path, counts, len(data) // 8,
+                                           len(sites)))
+            return None
+        values = struct.unpack('=%dQ' % len(sites), data)
+
+    for site, count in zip(sites, values):
+        site['tool'] = report['tool']
+        site['count'] = count
+    return sites
+
+
+def location(site):
+    if not site['file']:
+        return site['function']
+    return '%s (%s:%d:%d)' % (site['function'], site['file'], site['line'],
+                              site['column'])
+
+
+def print_ranking(title, sites, top):
+    sites = sorted((s for s in sites if s['count']),
+                   key=lambda s: s['count'], reverse=True)
+    total = sum(s['count'] for s in sites)
+    print('\n%s: %d executions' % (title, total))
+    if not total:
+        return
+    cumulative = 0
+    for s in sites[:top]:
+        cumulative += s['count']
+        print('%14d %6.2f%% %6.2f%%  %-18s %-12s %-8s %s' % (
+            s['count'], 100.0 * s['count'] / total,
+            100.0 * cumulative / total, s['tool'], s['reason'], s['access'],
+            location(s)))
+
+
+def main():
+    args = parse_args()
+    sites = []
+    for path in args.reports:
+        report = read_sites(path, args.counts_dir)
+        if report is not None:
+            sites.extend(report)
+    if not sites:
+        return 1
+
+    # (tool, reason, checked) -> [sites, sites executed, executions]
+    reasons = {}
+    for s in sites:
+        r = reasons.setdefault((s['tool'], s['reason'], s['checked']),
+                               [0, 0, 0])
+        r[0] += 1
+        r[1] += 1 if s['count'] else 0
+        r[2] += s['count']
+    total = sum(r[2] for r in reasons.values())
+
+    print('%-18s %-12s %-8s %8s %8s %14s %7s' % (
+        'tool', 'reason', 'checked', 'sites', 'executed', 'executions',
+        'share'))
+    for (tool, reason, checked), r in sorted(reasons.items()):
+        print('%-18s %-12s %-8s %8d %8d %14d %6.2f%%' % (
+            tool, reason, 'yes' if checked else 'no', r[0], r[1], r[2],
+            100.0 * r[2] / total if total else 0))
+
+    print_ranking('Checks kept', [s for s in sites if s['checked']],
+                  args.top)
+    print_ranking('Checks removed', [s for s in sites if not s['checked']],
+                  args.top)
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write('tool\tsite\tfunction\tfile\tline\tcolumn\taccess\t'
+                    'reason\tchecked\tcount\n')
+            for s in sites:
+                f.write('%s\t%d\t%s\t%s\t%d\t%d\t%s\t%s\t%d\t%d\n' % (
+                    s['tool'], s['site'], s['function'], s['file'],
+                    s['line'], s['column'], s['access'], s['reason'],
+                    s['checked'], s['count']))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
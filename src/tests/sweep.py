@@ -0,0 +1,202 @@
+#! /usr/bin/env python3
+#
+# Runs the analyses over a sweep of synthetic modules (gen_module.py) that
+# grow in one parameter, and fits the time of each analysis and of each of
+# its profiled phases to a power of the size of the module, so that a phase
+# that grows faster than linearly shows up on small modules already.
+#
+#   sweep.py --vary functions --values 50,100,200,400,800 \
+#       --gen "--statements 40 --pointer-density 0.4" \
+#       --so-dir ../obj --ga-so ../obj/MemorySafetyOpt.so --output sweep.tsv
+#
+# The size of a module is its number of instructions, after the pipeline of
+# the Makefile. Each run has ECOSOC_PROFILE_JSON set (see PassProfile.h), so
+# the phases timed there get a curve of their own: PADriver's solve, the
+# range analyses' findIntervals, the taint's getDepValues, and so on. The
+# curves are printed as time ~ c * n^k, and flagged when k passes
+# --superlinear. --output keeps every measure, one tab separated line each.
+
+import argparse
+import json
+import math
+import os
+import shlex
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+# analysis name, opt arguments, as in run.sh
+def analyses(so, ga_so):
+    core = ['-load', so + '/PADriver.so', '-load', so + '/AliasSets.so']
+    inputs = ['-load', so + '/InputValues.so']
+    models = ['-load', so + '/LibraryModels.so']
+    depgraph = models + ['-load', so + '/DepGraph.so']
+    taint = depgraph + ['-load', so + '/bSSA.so', '-load', so + '/TFA.so']
+    return [
+        ('pa', core + ['-pa']),
+        ('depgraph', core + depgraph + ['-moduleDepGraph']),
+        ('tfa', core + inputs + taint + ['-tfa']),
+        ('ra', ['-load', so + '/ArAnot.so', '-ra-inter-cousot']),
+        ('sra', core + inputs + taint + ['-load', ga_so, '-sra']),
+    ]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Fit the time of the analyses to the size of the module')
+    parser.add_argument('--vary', default='functions',
+                        help='the parameter of gen_module.py that grows')
+    parser.add_argument('--values', default='25,50,100,200,400',
+                        help='its values, separated by commas')
+    parser.add_argument('--gen', default='',
+                        help='the other arguments of gen_module.py')
+    parser.add_argument('--only', default='',
+                        help='the analyses to run, separated by commas')
+    parser.add_argument('--clang', default='clang')
+    parser.add_argument('--opt', default='opt')
+    parser.add_argument('--so-dir', default=os.path.join(HERE, '..', 'obj'))
+    parser.add_argument('--ga-so', default=None)
+    parser.add_argument('--reps', type=int, default=1,
+                        help='runs of each analysis; the best one is kept')
+    parser.add_argument('--superlinear', type=float, default=1.3,
+                        help='exponent above which a curve is flagged')
+    parser.add_argument('--min-seconds', type=float, default=0.005,
+                        help='shorter times are left out of the fits')
+    parser.add_argument('--output', default=None)
+    parser.add_argument('--work-dir', default=None)
+    return parser.parse_args()
+
+
+def run(cmd, env=None):
+    p = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                       universal_newlines=True, env=env)
+    if p.returncode != 0:
+        raise RuntimeError(' '.join(cmd) + '\n' + p.stdout)
+    return p.stdout
+
+
+def build(args, value, work):
+    """Generates and compiles the module of one value; returns its bitcode
+    and its number of instructions."""
+    base = os.path.join(work, '%s%s' % (args.vary, value))
+    gen = [sys.executable, os.path.join(HERE, 'gen_module.py')]
+    run(gen + shlex.split(args.gen) +
+        ['--' + args.vary, str(value), '-o', base + '.c'])
+    run([args.clang, '-x', 'c', '-g', '-O0', '-emit-llvm', '-c',
+         base + '.c', '-o', base + '.O0.bc'])
+    run([args.opt, '-mem2reg', '-instnamer',
+         '-load', args.so_dir + '/PADriver.so',
+         '-load', args.so_dir + '/AliasSets.so',
+         '-load', args.so_dir + '/InputValues.so',
+         '-load', args.so_dir + '/LibraryModels.so',
+         '-load', args.so_dir + '/DepGraph.so',
+         '-load', args.so_dir + '/bSSA.so',
+         '-load', args.so_dir + '/TFA.so', '-load', args.ga_so,
+         '-mergereturn', '-redef', '-ptr-redef',
+         base + '.O0.bc', '-o', base + '.bc'])
+
+    # The lines of the instructions: indented, and not only a comment
+    size = 0
+    for line in run([args.opt, '-S', base + '.bc', '-o', '-']).split('\n'):
+        if line.startswith('  ') and not line.lstrip().startswith(';'):
+            size += 1
+    return base + '.bc', size
+
+
+def measure(args, cmd, bitcode, work):
+    """Runs an analysis --reps times; returns the best wall time, the peak
+    RSS of that run and the total time of each profiled phase."""
+    best = None
+    for r in range(args.reps):
+        profile = os.path.join(work, 'profile.json')
+        times = os.path.join(work, 'time')
+        if os.path.exists(profile):
+            os.remove(profile)
+        env = dict(os.environ, ECOSOC_PROFILE_JSON=profile)
+        run(['/usr/bin/time', '-f', '%e %M', '-o', times, args.opt] + cmd +
+            [bitcode, '-o', os.devnull], env)
+        with open(times) as f:
+            seconds, rss = f.read().split('\n')[-2].split()
+        phases = {}
+        if os.path.exists(profile):
+            with open(profile) as f:
+                for name, t in json.load(f)['timers'].items():
+                    phases[name] = t['total_us'] / 1e6
+        if best is None or float(seconds) < best[0]:
+            best = (float(seconds), int(rss), phases)
+    return best
+
+
+def fit(points, min_seconds):
+    """Least squares fit of log(t) = log(c) + k log(n); returns (c, k), or
+    None with fewer than two usable points."""
+    points = [(n, t) for n, t in points if n > 0 and t >= min_seconds]
+    if len(points) < 2:
+        return None
+    xs = [math.log(n) for n, t in points]
+    ys = [math.log(t) for n, t in points]
+    mx, my = sum(xs) / len(xs), sum(ys) / len(ys)
+    sxx = sum((x - mx) ** 2 for x in xs)
+    if sxx == 0:
+        return None
+    k = sum((x - mx) * (y - my) for x, y in zip(xs, ys)) / sxx
+    return math.exp(my - k * mx), k
+
+
+def main():
+    args = parse_args()
+    if args.ga_so is None:
+        args.ga_so = os.path.join(args.so_dir, 'MemorySafetyOpt.so')
+    only = set(args.only.split(',')) if args.only else None
+    work = args.work_dir or tempfile.mkdtemp(prefix='sweep.')
+    os.makedirs(work, exist_ok=True)
+
+    # (analysis, phase) -> [(size, seconds)]; the phase of the whole run is
+    # "total"
+    curves = {}
+    rows = []
+    for value in [int(v) for v in args.values.split(',')]:
+        bitcode, size = build(args, value, work)
+        for name, cmd in analyses(args.so_dir, args.ga_so):
+            if only and name not in only:
+                continue
+            try:
+                seconds, rss, phases = measure(args, cmd, bitcode, work)
+            except RuntimeError as e:
+                sys.stderr.write('%s failed on %s=%d:\n%s\n' % (
+                    name, args.vary, value, e))
+                continue
+            phases['total'] = seconds
+            for phase, t in sorted(phases.items()):
+                curves.setdefault((name, phase), []).append((size, t))
+                rows.append((args.vary, value, size, name, phase, t, rss))
+            sys.stderr.write('%s=%d: %d instructions, %s %.3fs %dKB\n' % (
+                args.vary, value, size, name, seconds, rss))
+
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write('parameter\tvalue\tinstructions\tanalysis\tphase\t'
+                    'seconds\tpeak_rss_kb\n')
+            for row in rows:
+                f.write('%s\t%d\t%d\t%s\t%s\t%.6f\t%d\n' % row)
+
+    print('%-10s %-40s %10s %6s' % ('analysis', 'phase', 'c', 'k'))
+    flagged = False
+    for (name, phase), points in sorted(curves.items()):
+        result = fit(points, args.min_seconds)
+        if result is None:
+            continue
+        c, k = result
+        mark = ''
+        if k > args.superlinear:
+            mark = '  superlinear'
+            flagged = True
+        print('%-10s %-40s %10.3g %6.2f%s' % (name, phase, c, k, mark))
+    return 1 if flagged else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
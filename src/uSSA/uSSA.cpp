@@ -14,8 +14,20 @@ bool getTruncInstrumentation(){
 	return TruncInstrumentation;
 }
 
+namespace {
+	// A node of the dominator tree, the next child to visit and the size of
+	// the log of sites when the node was entered
+	struct Frame {
+		DomTreeNode *Node;
+		DomTreeNode::iterator Child;
+		unsigned LogSize;
+	};
+}
+
+STATISTIC(NumNewDefs, "Number of new definitions inserted");
+STATISTIC(NumUnusedSites, "Number of sites left without a new definition because no use is renamed");
+
 void uSSA::getAnalysisUsage(AnalysisUsage &AU) const {
-	AU.addRequiredTransitive<DominanceFrontier>();
 	AU.addRequiredTransitive<DominatorTree>();
 	
 	// This pass modifies the program, but not the CFG
@@ -24,117 +36,148 @@ void uSSA::getAnalysisUsage(AnalysisUsage &AU) const {
 
 bool uSSA::runOnFunction(Function &F) {
 	DT_ = &getAnalysis<DominatorTree>();
-	DF_ = &getAnalysis<DominanceFrontier>();
 	
-	// Iterate over all Basic Blocks of the Function, calling the function that creates sigma functions, if needed
-	for (Function::iterator Fit = F.begin(), Fend = F.end(); Fit != Fend; ++Fit) {
-		createNewDefs(Fit);
-	}
+	createNewDefs(F);
 	
 	return false;
 }
 
-void uSSA::createNewDefs(BasicBlock *BB)
+// The value that I may give a new name to: the non-constant first operand
+// of an add, sub or mul by a nonzero constant, or of a trunc when those are
+// instrumented
+Value *uSSA::getNewDefSite(Instruction *I)
 {
-	for (BasicBlock::iterator BBit = BB->begin(), BBend = BB->end(); BBit != BBend; ++BBit) {
-		Instruction *I = BBit;
-		Value *op = NULL;
-		ConstantInt *ci = NULL;
-		
-		BasicBlock::iterator next = BBit;
-		++next;
+	Value *op = NULL;
+	ConstantInt *ci = NULL;
+	
+	switch (I->getOpcode()) {
+		case Instruction::Sub:
+		case Instruction::Mul:
+		case Instruction::Add:
+			// Check if first operand is non-constant AND second operand is a constant
+			op = I->getOperand(0);
+			ci = dyn_cast<ConstantInt>(I->getOperand(1));
+			
+			if (!isa<ConstantInt>(op) && ci && (ci->getValue() != 0))
+				return op;
+			break;
 		
-		switch (I->getOpcode()) {
-			case Instruction::Sub:
-			case Instruction::Mul:
-			case Instruction::Add:
-				// Check if first operand is non-constant AND second operand is a constant
-				op = I->getOperand(0);
-				ci = dyn_cast<ConstantInt>(I->getOperand(1));
-				
-				if (!isa<ConstantInt>(op) && ci && (ci->getValue() != 0)) {
-					std::string newname = op->getName().str() + newdefstr;
-					
-					BinaryOperator *newdef = BinaryOperator::Create(Instruction::Add, op, ConstantInt::get(op->getType(), 0), Twine(newname), next);					
-					newdef->setMetadata("new-inst", MDNode::get(BB->getParent()->getContext(), llvm::ArrayRef<Value*>()));
-					
-					renameNewDefs(newdef);
-					
-					// Skip the instruction that has just been created
-					++BBit;
-				}
-				
-				break;
+		case Instruction::Trunc:
+			// Here we don't have a constant, only an interval due to the truncation number of bits
+			// Check if first operand is non-constant
+			op = I->getOperand(0);
 			
-			case Instruction::Trunc:
-				
-				if (TruncInstrumentation){
-					// Here we don't have a constant, only an interval due to the truncation number of bits
-					// Check if first operand is non-constant
-					op = I->getOperand(0);
-					
-					if (!isa<ConstantInt>(op)) {
-						std::string newname = op->getName().str() + newdefstr;
+			if (TruncInstrumentation && !isa<ConstantInt>(op))
+				return op;
+			break;
+	}
+	return NULL;
+}
 
-						BinaryOperator *newdef = BinaryOperator::Create(Instruction::Add, op, ConstantInt::get(op->getType(), 0), Twine(newname), next);
-						newdef->setMetadata("new-inst", MDNode::get(BB->getParent()->getContext(), llvm::ArrayRef<Value*>()));
-						
-						renameNewDefs(newdef);
+// Inserts the new definition of a site the first time a use needs it
+Instruction *uSSA::getNewDef(NewDef &ND)
+{
+	if (ND.Def)
+		return ND.Def;
+	
+	// The operand of the site may already be the new name of an earlier site
+	Value *op = ND.Site->getOperand(0);
+	std::string newname = op->getName().str() + newdefstr;
+	
+	BinaryOperator *newdef = BinaryOperator::Create(Instruction::Add, op, ConstantInt::get(op->getType(), 0), Twine(newname));
+	newdef->insertAfter(ND.Site);
+	newdef->setMetadata("new-inst", MDNode::get(ND.Site->getContext(), llvm::ArrayRef<Value*>()));
+	
+	ND.Def = newdef;
+	++NumNewDefs;
+	return newdef;
+}
 
-						// Skip the instruction that has just been created
-						++BBit;
-					}
-				}
-				break;
-		}
-	}
+// Renames operand OpNo of U to the innermost new name of its value in scope
+void uSSA::renameUse(Instruction *U, unsigned OpNo)
+{
+	if (isa<GetElementPtrInst>(U))
+		return;
+	
+	DenseMap<Value*, SmallVector<NewDef, 4> >::iterator it = Defs.find(U->getOperand(OpNo));
+	if (it == Defs.end() || it->second.empty())
+		return;
+	
+	U->setOperand(OpNo, getNewDef(it->second.back()));
 }
 
-void uSSA::renameNewDefs(Instruction *newdef)
+// Walks the dominator tree once, in preorder, keeping for each value the
+// sites met on the way from the root: the uses reached are those the
+// innermost site dominates. A site gets its new definition only when one of
+// them is renamed, and the name goes out of scope with the subtree of its
+// block.
+void uSSA::createNewDefs(Function &F)
 {
-	// This vector of Instruction* points to the uses of V.
-	// This auxiliary vector of pointers is used because the use_iterators are invalidated when we do the renaming
-	Value *V = newdef->getOperand(0);
-	SmallVector<Instruction*, 25> usepointers;
-	unsigned i = 0, n = V->getNumUses();
-	usepointers.resize(n);
-	BasicBlock *BB = newdef->getParent();
+	SmallVector<Frame, 32> Stack;
+	SmallVector<Value*, 32> Log;
 	
-	for (Value::use_iterator uit = V->use_begin(), uend = V->use_end(); uit != uend; ++uit, ++i)
-		usepointers[i] = dyn_cast<Instruction>(*uit);
+	Defs.clear();
 	
-	for (i = 0; i < n; ++i) {
-		if (usepointers[i] ==  NULL) {
-			continue;
-		}
-		if (usepointers[i] == newdef) {
-			continue;
-		}
-		if (isa<GetElementPtrInst>(usepointers[i])) {
-			continue;
-		}
-		
-		BasicBlock *BB_user = usepointers[i]->getParent();
-		BasicBlock::iterator newdefit(newdef);
-		BasicBlock::iterator useit(usepointers[i]);
+	DomTreeNode *Root = DT_->getRootNode();
+	Frame Entry = { Root, Root->begin(), 0 };
+	Stack.push_back(Entry);
+	
+	bool first = true;
+	while (!Stack.empty()) {
+		Frame &Top = Stack.back();
 		
-		// Check if the use is in the dominator tree of newdef(V)
-		if (DT_->dominates(BB, BB_user)) {
-			// If in the same basicblock, only rename if the use is posterior to the newdef
-			if (BB_user == BB) {
-				int dist1 = std::distance(BB->begin(), useit);
-				int dist2 = std::distance(BB->begin(), newdefit);
-				int offset = dist1 - dist2;
+		if (first) {
+			BasicBlock *BB = Top.Node->getBlock();
+			
+			for (BasicBlock::iterator BBit = BB->begin(), BBend = BB->end(); BBit != BBend; ++BBit) {
+				Instruction *I = BBit;
 				
-				if (offset > 0) {
-					usepointers[i]->replaceUsesOfWith(V, newdef);
+				// The operands of PHIs are renamed at the end of their incoming blocks
+				if (isa<PHINode>(I))
+					continue;
+				
+				Value *V = getNewDefSite(I);
+				
+				for (unsigned i = 0, e = I->getNumOperands(); i != e; ++i)
+					renameUse(I, i);
+				
+				if (V) {
+					NewDef ND = { I, NULL };
+					Defs[V].push_back(ND);
+					Log.push_back(V);
 				}
 			}
-			else {
-				usepointers[i]->replaceUsesOfWith(V, newdef);
+			
+			for (succ_iterator sit = succ_begin(BB), send = succ_end(BB); sit != send; ++sit) {
+				for (BasicBlock::iterator PHIit = (*sit)->begin(); PHINode *phi = dyn_cast<PHINode>(PHIit); ++PHIit) {
+					for (unsigned i = 0, e = phi->getNumIncomingValues(); i != e; ++i)
+						if (phi->getIncomingBlock(i) == BB)
+							renameUse(phi, PHINode::getOperandNumForIncomingValue(i));
+				}
 			}
 		}
+		
+		if (Top.Child != Top.Node->end()) {
+			DomTreeNode *Child = *Top.Child++;
+			Frame Next = { Child, Child->begin(), Log.size() };
+			Stack.push_back(Next);
+			first = true;
+			continue;
+		}
+		
+		// Leaving the subtree: its sites go out of scope
+		while (Log.size() > Top.LogSize) {
+			SmallVector<NewDef, 4> &S = Defs[Log.back()];
+			if (!S.back().Def)
+				++NumUnusedSites;
+			S.pop_back();
+			Log.pop_back();
+		}
+		Stack.pop_back();
+		first = false;
 	}
+	
+	Defs.clear();
 }
 
 char uSSA::ID = 0;
@@ -4,7 +4,8 @@
  *
  *	These new definitions are inserted right after the use site, and
  *	all remaining uses dominated by this new definition are renamed
- *	properly.
+ *	properly. A new definition is only inserted when there is such a
+ *	use, and all the renaming is done in one walk of the dominator tree.
 */
 
 #include "llvm/Metadata.h"
@@ -12,9 +13,9 @@
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/Dominators.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/CFG.h"
 #include "llvm/IR/Instructions.h"
-#include "llvm/Analysis/DominanceFrontier.h"
 #include "llvm/IR/Constants.h"
 #include <deque>
 #include <algorithm>
@@ -28,13 +29,24 @@ public:
 	void getAnalysisUsage(AnalysisUsage &AU) const;
 	bool runOnFunction(Function&);
 	
-	void createNewDefs(BasicBlock *BB);
-	void renameNewDefs(Instruction *newdef);
+	void createNewDefs(Function &F);
 
 private:
 	// Variables always live
 	DominatorTree *DT_;
-	DominanceFrontier *DF_;
+
+	// A site that may define a new name for the original value V, and that
+	// name once it has been inserted
+	struct NewDef {
+		Instruction *Site;
+		Instruction *Def;
+	};
+	// The new names in scope of each original value, innermost last
+	DenseMap<Value*, SmallVector<NewDef, 4> > Defs;
+
+	Value *getNewDefSite(Instruction *I);
+	Instruction *getNewDef(NewDef &ND);
+	void renameUse(Instruction *U, unsigned OpNo);
 };
 
 }